@@ -0,0 +1,219 @@
+#ifndef ADAPTIVE_CONTROL_H
+#define ADAPTIVE_CONTROL_H
+
+// Controlador adaptativo de rendimiento (litros por kWh)
+//
+// Ajusta en línea cuatro umbrales del control por punto de rocío: desplazamiento del
+// setpoint, banda muerta y offsets de encendido/apagado del ventilador del evaporador.
+// Método: perturbación y observación por coordenadas. Cada parámetro se evalúa en dos
+// ventanas consecutivas (base + delta y base - delta, alternando el orden en cada
+// iteración para cancelar la deriva lineal del ambiente) y la base avanza un paso hacia
+// la ventana más eficiente. Después se pasa al siguiente parámetro.
+//
+// Eficiencia de una ventana = litros producidos / kWh consumidos. Para comparar ventanas
+// se normaliza por la humedad absoluta media, de modo que una mañana húmeda no se confunda
+// con un mejor ajuste. Una ventana se descarta si la bomba funcionó, si el contador de
+// energía retrocedió (RESET_ENERGY) o si el volumen bajó (extracción manual).
+//
+// Los tiempos mínimo apagado / máximo encendido los sigue aplicando processControl();
+// aquí solo se mueven umbrales dentro de límites fijos. Sin dependencias de Arduino:
+// puede evaluarse en host contra un modelo de planta alimentando update() con volumen,
+// energía y humedad simulados.
+
+#include <math.h>
+#include <stdint.h>
+
+// Duración de las ventanas de evaluación
+#define ADAPT_WINDOW_MIN_MS 3600000UL    // Duración mínima de ventana (ms, 60 min)
+#define ADAPT_WINDOW_MAX_MS 10800000UL   // Ventana sin energía suficiente se descarta (ms, 3 h)
+#define ADAPT_WINDOW_MIN_KWH 0.15f       // Energía mínima para cerrar ventana (kWh)
+#define ADAPT_VOLUME_DROP_TOL 0.2f       // Caída de volumen tolerada por ruido del sensor (L)
+#define ADAPT_VOLUME_ALPHA 0.1f          // Suavizado del volumen (el retardo es igual en todas las ventanas y se cancela)
+#define ADAPT_MIN_IMPROVEMENT 0.03f      // Diferencia relativa mínima para mover un parámetro
+#define ADAPT_EFFICIENCY_ALPHA 0.3f      // Suavizado de la eficiencia publicada
+#define ADAPT_MIN_ENERGY_ESTIMATE 0.005f // Energía mínima para estimar la ventana en curso (kWh)
+
+enum AdaptParam : uint8_t {
+  ADAPT_SETPOINT_OFFSET = 0,  // Desplazamiento del centro de histéresis respecto al punto de rocío (°C)
+  ADAPT_DEADBAND,             // Banda muerta del compresor (°C)
+  ADAPT_FAN_ON_OFFSET,        // Offset de encendido del ventilador evaporador (°C)
+  ADAPT_FAN_OFF_OFFSET,       // Offset de apagado del ventilador evaporador (°C)
+  ADAPT_PARAM_COUNT
+};
+
+// Límites y tamaño de perturbación de cada parámetro
+static const float ADAPT_PARAM_MIN[ADAPT_PARAM_COUNT] = { -3.0f, 1.0f, 0.0f, 0.0f };
+static const float ADAPT_PARAM_MAX[ADAPT_PARAM_COUNT] = { 2.0f, 6.0f, 3.0f, 2.0f };
+static const float ADAPT_PARAM_DELTA[ADAPT_PARAM_COUNT] = { 0.5f, 0.5f, 0.3f, 0.3f };
+
+enum AdaptEvent : uint8_t {
+  ADAPT_EVT_NONE = 0,         // Ventana en curso
+  ADAPT_EVT_WINDOW_REJECTED,  // Ventana descartada, se repite la medición
+  ADAPT_EVT_WINDOW_DONE,      // Primera mitad de la comparación completada
+  ADAPT_EVT_PARAMS_UPDATED    // Iteración completada (la base pudo moverse): persistir
+};
+
+class AdaptiveController {
+public:
+  // Inicia con los parámetros base (recortados a sus límites) y la eficiencia aprendida
+  void begin(const float base[ADAPT_PARAM_COUNT], float efficiency = NAN, uint32_t iterations = 0) {
+    for (int i = 0; i < ADAPT_PARAM_COUNT; i++) {
+      base_[i] = clampParam(i, base[i]);
+    }
+    efficiency_ = efficiency;
+    iterations_ = iterations;
+    activeParam_ = (uint8_t)(iterations % ADAPT_PARAM_COUNT);
+    firstSign_ = (iterations & 1) ? -1 : 1;
+    phase_ = 0;
+    rejectedWindows_ = 0;
+    lastReject_ = "";
+    windowOpen_ = false;
+    volumeFiltered_ = NAN;
+    applyPerturbation();
+  }
+
+  // Descarta la ventana en curso (cambio de modo, protección del compresor, etc.)
+  void restartWindow() { windowOpen_ = false; }
+
+  // Alimentar en cada muestreo del control. volumeL y energyKWh pueden ser NAN (sensor caído)
+  AdaptEvent update(uint32_t nowMs, float volumeL, float energyKWh, float absHumidity, bool pumpOn) {
+    if (isnan(volumeL) || isnan(energyKWh)) return ADAPT_EVT_NONE;
+    // Un salto mayor que la tolerancia (bomba, extracción) reinicia el filtro en vez de arrastrarse
+    if (isnan(volumeFiltered_) || fabsf(volumeL - volumeFiltered_) > 4.0f * ADAPT_VOLUME_DROP_TOL) {
+      volumeFiltered_ = volumeL;
+    } else {
+      volumeFiltered_ += ADAPT_VOLUME_ALPHA * (volumeL - volumeFiltered_);
+    }
+    volumeL = volumeFiltered_;
+    if (!windowOpen_) {
+      openWindow(nowMs, volumeL, energyKWh, pumpOn);
+      return ADAPT_EVT_NONE;
+    }
+
+    if (pumpOn) pumpSeen_ = true;
+    if (energyKWh < startEnergy_) return reject(nowMs, volumeL, energyKWh, pumpOn, "energy_reset");
+    if (volumeL < startVolume_ - ADAPT_VOLUME_DROP_TOL) return reject(nowMs, volumeL, energyKWh, pumpOn, "volume_drop");
+    if (!isnan(absHumidity) && absHumidity > 0.0f) {
+      ahSum_ += absHumidity;
+      ahCount_++;
+    }
+    lastVolume_ = volumeL;
+    lastEnergy_ = energyKWh;
+
+    uint32_t elapsed = nowMs - startMs_;
+    float dE = energyKWh - startEnergy_;
+    if (elapsed < ADAPT_WINDOW_MIN_MS || dE < ADAPT_WINDOW_MIN_KWH) {
+      if (elapsed >= ADAPT_WINDOW_MAX_MS) return reject(nowMs, volumeL, energyKWh, pumpOn, "low_energy");
+      return ADAPT_EVT_NONE;
+    }
+    if (pumpSeen_) return reject(nowMs, volumeL, energyKWh, pumpOn, "pump");
+
+    // Ventana completa
+    float eta = (volumeL - startVolume_) / dE;
+    efficiency_ = isnan(efficiency_) ? eta : ADAPT_EFFICIENCY_ALPHA * eta + (1.0f - ADAPT_EFFICIENCY_ALPHA) * efficiency_;
+    score_[phase_] = (ahCount_ > 0) ? eta / (ahSum_ / ahCount_) : eta;
+
+    if (phase_ == 0) {
+      phase_ = 1;
+      applyPerturbation();
+      openWindow(nowMs, volumeL, energyKWh, pumpOn);
+      return ADAPT_EVT_WINDOW_DONE;
+    }
+
+    // Comparar ambas mitades: score_[0] con firstSign_, score_[1] con el signo opuesto
+    float plus = (firstSign_ > 0) ? score_[0] : score_[1];
+    float minus = (firstSign_ > 0) ? score_[1] : score_[0];
+    float ref = 0.5f * (fabsf(plus) + fabsf(minus));
+    if (ref > 1e-6f) {
+      float rel = (plus - minus) / ref;
+      if (fabsf(rel) >= ADAPT_MIN_IMPROVEMENT) {
+        float step = (rel > 0.0f) ? ADAPT_PARAM_DELTA[activeParam_] : -ADAPT_PARAM_DELTA[activeParam_];
+        base_[activeParam_] = clampParam(activeParam_, base_[activeParam_] + step);
+      }
+    }
+
+    iterations_++;
+    activeParam_ = (uint8_t)((activeParam_ + 1) % ADAPT_PARAM_COUNT);
+    firstSign_ = (int8_t)-firstSign_;
+    phase_ = 0;
+    applyPerturbation();
+    openWindow(nowMs, volumeL, energyKWh, pumpOn);
+    return ADAPT_EVT_PARAMS_UPDATED;
+  }
+
+  // Valor a aplicar ahora (base con la perturbación de la ventana en curso)
+  float param(AdaptParam p) const { return applied_[p]; }
+  // Valor aprendido (sin perturbación), el que se persiste
+  float base(AdaptParam p) const { return base_[p]; }
+
+  // Eficiencia suavizada de las ventanas válidas (L/kWh), NAN si aún no hay ninguna
+  float efficiency() const { return efficiency_; }
+
+  // Estimación de la ventana en curso (L/kWh), NAN si la energía acumulada es insuficiente
+  float windowEfficiency() const {
+    if (!windowOpen_) return NAN;
+    float dE = lastEnergy_ - startEnergy_;
+    if (dE < ADAPT_MIN_ENERGY_ESTIMATE) return NAN;
+    return (lastVolume_ - startVolume_) / dE;
+  }
+
+  uint8_t activeParam() const { return activeParam_; }
+  int8_t perturbSign() const { return phase_ == 0 ? firstSign_ : (int8_t)-firstSign_; }
+  uint32_t iterations() const { return iterations_; }
+  uint16_t rejectedWindows() const { return rejectedWindows_; }
+  const char* lastRejectReason() const { return lastReject_; }
+
+private:
+  float base_[ADAPT_PARAM_COUNT] = { 0 };
+  float applied_[ADAPT_PARAM_COUNT] = { 0 };
+  float score_[2] = { 0, 0 };
+  float efficiency_ = NAN;
+  float volumeFiltered_ = NAN;
+  uint32_t iterations_ = 0;
+  uint8_t activeParam_ = 0;
+  int8_t firstSign_ = 1;
+  uint8_t phase_ = 0;
+  uint16_t rejectedWindows_ = 0;
+  const char* lastReject_ = "";
+
+  // Ventana en curso
+  bool windowOpen_ = false;
+  bool pumpSeen_ = false;
+  uint32_t startMs_ = 0;
+  float startVolume_ = 0, startEnergy_ = 0;
+  float lastVolume_ = 0, lastEnergy_ = 0;
+  float ahSum_ = 0;
+  uint32_t ahCount_ = 0;
+
+  static float clampParam(int i, float v) {
+    if (isnan(v)) return 0.5f * (ADAPT_PARAM_MIN[i] + ADAPT_PARAM_MAX[i]);
+    if (v < ADAPT_PARAM_MIN[i]) return ADAPT_PARAM_MIN[i];
+    if (v > ADAPT_PARAM_MAX[i]) return ADAPT_PARAM_MAX[i];
+    return v;
+  }
+
+  void applyPerturbation() {
+    for (int i = 0; i < ADAPT_PARAM_COUNT; i++) applied_[i] = base_[i];
+    applied_[activeParam_] = clampParam(activeParam_, base_[activeParam_] + perturbSign() * ADAPT_PARAM_DELTA[activeParam_]);
+  }
+
+  void openWindow(uint32_t nowMs, float volumeL, float energyKWh, bool pumpOn) {
+    windowOpen_ = true;
+    pumpSeen_ = pumpOn;
+    startMs_ = nowMs;
+    startVolume_ = lastVolume_ = volumeL;
+    startEnergy_ = lastEnergy_ = energyKWh;
+    ahSum_ = 0;
+    ahCount_ = 0;
+  }
+
+  // Repite la misma mitad de la comparación desde el punto actual
+  AdaptEvent reject(uint32_t nowMs, float volumeL, float energyKWh, bool pumpOn, const char* reason) {
+    rejectedWindows_++;
+    lastReject_ = reason;
+    openWindow(nowMs, volumeL, energyKWh, pumpOn);
+    return ADAPT_EVT_WINDOW_REJECTED;
+  }
+};
+
+#endif  // ADAPTIVE_CONTROL_H
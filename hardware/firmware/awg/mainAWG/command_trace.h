@@ -0,0 +1,299 @@
+#ifndef COMMAND_TRACE_H
+#define COMMAND_TRACE_H
+
+// Trazas de latencia de comandos: id de correlación, acuse y histogramas por etapa
+//
+// Un comando puede llevar delante "@<cid>[:<ts>] ": cid de 1-16 caracteres [A-Za-z0-9_-] y,
+// opcional, la marca de tiempo del cliente (hasta 20 dígitos, en sus unidades). Con el
+// prefijo, processCommand() publica un acuse en dropster/<id>/ack que devuelve ambos tal
+// cual, así el cliente mide la ida y vuelta sin guardar estado; sin él, el comando se
+// procesa como siempre y no hay acuse.
+//
+//   {"cid":"a1","ts":1767225600123,"result":"ok","poll_us":812,"gate_us":95,"act_us":140,
+//    "done_us":2310,"up_ms":123456}
+//
+// Tiempos en µs desde la llegada (entrada al callback de MQTT):
+//   poll_us  desde la llamada anterior a mqttClient.loop(): cota de lo que el mensaje pudo
+//            esperar en el socket mientras el loop hacía otra cosa (lecturas, sueño ligero)
+//   gate_us  hasta el despacho: copia, parseo, debounce y bloqueo de comando crítico
+//   act_us   hasta la primera escritura de relé (solo comandos que actúan)
+//   done_us  hasta el fin de processCommand(), con publishState() incluido
+// Un comando rechazado lleva "result":"rejected" y "reason" (debounce, locked,
+// compressor_temp, tank_full, pump_low, unknown) y no tiene gate_us ni act_us.
+//
+// Los comandos que llegan por MQTT alimentan además histogramas por etapa y contadores por
+// resultado, que CMD_STATS publica en el mismo tópico. Los histogramas son log-lineales (4
+// sub-buckets por potencia de dos, memoria fija): el percentil sale como cota superior de su
+// bucket, a menos de un 25 % del valor real hasta 16 s.
+//
+// Sin dependencias de Arduino: el llamador pasa micros(), de modo que puede probarse en host
+// (tools/simulator responde los mismos acuses).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CMD_CID_MAX 16
+#define CMD_TS_MAX 20
+#define CMD_HIST_SUB_BITS 2
+#define CMD_HIST_MAX_BITS 24    // 2^24 µs = 16,8 s; lo que pase va al último bucket
+#define CMD_HIST_BUCKETS ((1 << CMD_HIST_SUB_BITS) + (CMD_HIST_MAX_BITS - CMD_HIST_SUB_BITS) * (1 << CMD_HIST_SUB_BITS))
+#define CMD_ACK_MAX 224         // Acuse serializado
+#define CMD_STATS_MAX 640       // CMD_STATS serializado
+
+enum CommandStage : uint8_t {
+  CMD_STAGE_POLL = 0,
+  CMD_STAGE_GATE,
+  CMD_STAGE_ACT,
+  CMD_STAGE_DONE,
+  CMD_STAGE_COUNT
+};
+
+enum CommandResult : uint8_t {
+  CMD_RESULT_OK = 0,
+  CMD_REJECT_DEBOUNCE,       // Mismo comando dentro de COMMAND_DEBOUNCE
+  CMD_REJECT_LOCKED,         // Comando crítico anterior sin terminar (COMMAND_TIMEOUT)
+  CMD_REJECT_COMPRESSOR_TEMP,
+  CMD_REJECT_TANK_FULL,
+  CMD_REJECT_PUMP_LOW,       // Bomba sin agua suficiente
+  CMD_REJECT_SAFETY,         // Enclavado por el supervisor de seguridad (safety_supervisor.h)
+  CMD_REJECT_UNKNOWN,        // Comando no reconocido
+  CMD_RESULT_COUNT
+};
+
+static const char* const CMD_STAGE_NAME[CMD_STAGE_COUNT] = { "poll", "gate", "act", "done" };
+static const char* const CMD_RESULT_NAME[CMD_RESULT_COUNT] = { "ok", "debounce", "locked", "compressor_temp",
+                                                               "tank_full", "pump_low", "safety", "unknown" };
+
+// Histograma de una etapa: cuentas por bucket, total y máximo
+struct StageHistogram {
+  uint32_t counts[CMD_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+
+  void reset() { memset(this, 0, sizeof(*this)); }
+
+  static int bucketOf(uint32_t us) {
+    const uint32_t sub = 1u << CMD_HIST_SUB_BITS;
+    if (us < sub) return (int)us;
+    int octave = 31 - __builtin_clz(us);  // us >= sub: octave >= CMD_HIST_SUB_BITS
+    if (octave >= CMD_HIST_MAX_BITS) return CMD_HIST_BUCKETS - 1;
+    int shift = octave - CMD_HIST_SUB_BITS;
+    return (int)(sub + (uint32_t)shift * sub + ((us >> shift) & (sub - 1)));
+  }
+
+  // Mayor valor que cae en el bucket
+  static uint32_t upperBound(int bucket) {
+    const uint32_t sub = 1u << CMD_HIST_SUB_BITS;
+    if (bucket < (int)sub) return (uint32_t)bucket;
+    uint32_t shift = (uint32_t)(bucket - (int)sub) / sub;
+    uint32_t mantissa = sub + (uint32_t)(bucket - (int)sub) % sub;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  void add(uint32_t us) {
+    counts[bucketOf(us)]++;
+    count++;
+    if (us > max) max = us;
+  }
+
+  // Cota superior del percentil p (0-100), acotada por el máximo
+  uint32_t percentile(float p) const {
+    if (count == 0) return 0;
+    uint32_t rank = (uint32_t)(p / 100.0f * (float)count + 0.999f);
+    if (rank < 1) rank = 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < CMD_HIST_BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+        if (i == CMD_HIST_BUCKETS - 1) return max;  // Desborde: sin cota propia
+        uint32_t bound = upperBound(i);
+        return bound < max ? bound : max;
+      }
+    }
+    return max;
+  }
+};
+
+// Un comando trazado, listo para serializar el acuse
+struct CommandAck {
+  char cid[CMD_CID_MAX + 1];
+  char ts[CMD_TS_MAX + 1];  // Vacío si el cliente no la envió
+  uint8_t result;
+  bool dispatched;
+  bool acted;
+  uint32_t pollUs;
+  uint32_t gateUs;
+  uint32_t actUs;
+  uint32_t doneUs;
+  uint32_t uptimeMs;
+
+  size_t toJson(char* out, size_t size) const {
+    int len = snprintf(out, size, "{\"cid\":\"%s\"", cid);
+    if (ts[0]) len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"ts\":%s", ts);
+    if (result == CMD_RESULT_OK) {
+      len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"result\":\"ok\"");
+    } else {
+      len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"result\":\"rejected\",\"reason\":\"%s\"",
+                      CMD_RESULT_NAME[result]);
+    }
+    len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"poll_us\":%lu", (unsigned long)pollUs);
+    if (dispatched) len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"gate_us\":%lu", (unsigned long)gateUs);
+    if (acted) len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"act_us\":%lu", (unsigned long)actUs);
+    len += snprintf(out + len, size > (size_t)len ? size - len : 0, ",\"done_us\":%lu,\"up_ms\":%lu}",
+                    (unsigned long)doneUs, (unsigned long)uptimeMs);
+    return len > 0 && (size_t)len < size ? (size_t)len : 0;  // 0 = no entró en el buffer
+  }
+};
+
+class CommandTracer {
+ public:
+  CommandTracer() { resetStats(); }
+
+  // Llegada por MQTT, antes de processCommand(): traza el próximo comando
+  void arrived(uint32_t nowUs, uint32_t pollGapUs) {
+    armed_ = true;
+    rxUs_ = nowUs;
+    pollUs_ = pollGapUs;
+  }
+
+  // Entrada a processCommand(). Las llamadas anidadas (comandos generados por otro) no cuentan
+  void begin(uint32_t nowUs) {
+    if (depth_++ > 0) return;
+    traced_ = armed_;
+    armed_ = false;
+    if (!traced_) {
+      rxUs_ = nowUs;
+      pollUs_ = 0;
+    }
+    cid_[0] = '\0';
+    ts_[0] = '\0';
+    result_ = CMD_RESULT_OK;
+    dispatched_ = false;
+    acted_ = false;
+  }
+
+  // "@<cid>[:<ts>] <comando>": guarda cid y ts y devuelve cuántos caracteres quitar del
+  // comando (0 si no hay prefijo válido: el comando sigue como llegó)
+  size_t takeEnvelope(const char* cmd) {
+    if (depth_ != 1 || cmd[0] != '@') return 0;
+    size_t i = 1, cidLen = 0;
+    while (cidLen < CMD_CID_MAX && isCidChar(cmd[i])) cid_[cidLen++] = cmd[i++];
+    if (cidLen == 0 || isCidChar(cmd[i])) return clearEnvelope();
+    cid_[cidLen] = '\0';
+    if (cmd[i] == ':') {
+      i++;
+      size_t tsLen = 0;
+      while (tsLen < CMD_TS_MAX && cmd[i] >= '0' && cmd[i] <= '9') ts_[tsLen++] = cmd[i++];
+      if (tsLen == 0 || (cmd[i] >= '0' && cmd[i] <= '9')) return clearEnvelope();
+      ts_[tsLen] = '\0';
+    }
+    if (cmd[i] != ' ') return clearEnvelope();
+    while (cmd[i] == ' ') i++;
+    return i;
+  }
+
+  // Pasó el debounce y el bloqueo: empieza la ejecución
+  void dispatch(uint32_t nowUs) {
+    if (depth_ != 1 || dispatched_) return;
+    dispatched_ = true;
+    gateUs_ = nowUs - rxUs_;
+  }
+
+  // Primera escritura de relé del comando
+  void actuate(uint32_t nowUs) {
+    if (depth_ == 0 || acted_) return;
+    acted_ = true;
+    actUs_ = nowUs - rxUs_;
+  }
+
+  void reject(uint8_t result) {
+    if (depth_ == 1 && result_ == CMD_RESULT_OK) result_ = result;
+  }
+
+  // Salida de processCommand(). true si el comando traía cid: *ack queda listo para publicar
+  bool end(uint32_t nowUs, uint32_t uptimeMs, CommandAck* ack) {
+    if (depth_ == 0 || --depth_ > 0) return false;
+    uint32_t doneUs = nowUs - rxUs_;
+    if (result_ != CMD_RESULT_OK) {
+      dispatched_ = false;  // Un rechazo no llega a ejecutarse
+      acted_ = false;
+    }
+    if (traced_) {
+      results_[result_]++;
+      stages_[CMD_STAGE_POLL].add(pollUs_);
+      if (dispatched_) stages_[CMD_STAGE_GATE].add(gateUs_);
+      if (acted_) stages_[CMD_STAGE_ACT].add(actUs_);
+      stages_[CMD_STAGE_DONE].add(doneUs);
+    }
+    if (cid_[0] == '\0') return false;
+    memcpy(ack->cid, cid_, sizeof(cid_));
+    memcpy(ack->ts, ts_, sizeof(ts_));
+    ack->result = result_;
+    ack->dispatched = dispatched_;
+    ack->acted = acted_;
+    ack->pollUs = pollUs_;
+    ack->gateUs = gateUs_;
+    ack->actUs = actUs_;
+    ack->doneUs = doneUs;
+    ack->uptimeMs = uptimeMs;
+    return true;
+  }
+
+  const StageHistogram& stage(int s) const { return stages_[s]; }
+  uint32_t results(int r) const { return results_[r]; }
+
+  void resetStats() {
+    for (int s = 0; s < CMD_STAGE_COUNT; s++) stages_[s].reset();
+    memset(results_, 0, sizeof(results_));
+  }
+
+  // {"type":"cmd_stats","n":..,"results":{..},"poll":{"p50":..,"p99":..,"max":..},...} (µs)
+  size_t statsJson(char* out, size_t size) const {
+    uint32_t total = 0;
+    for (int r = 0; r < CMD_RESULT_COUNT; r++) total += results_[r];
+    int len = snprintf(out, size, "{\"type\":\"cmd_stats\",\"n\":%lu,\"results\":{", (unsigned long)total);
+    for (int r = 0; r < CMD_RESULT_COUNT; r++) {
+      len += snprintf(out + len, size > (size_t)len ? size - len : 0, "%s\"%s\":%lu", r ? "," : "", CMD_RESULT_NAME[r],
+                      (unsigned long)results_[r]);
+    }
+    len += snprintf(out + len, size > (size_t)len ? size - len : 0, "}");
+    for (int s = 0; s < CMD_STAGE_COUNT; s++) {
+      const StageHistogram& h = stages_[s];
+      len += snprintf(out + len, size > (size_t)len ? size - len : 0,
+                      ",\"%s\":{\"n\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}", CMD_STAGE_NAME[s],
+                      (unsigned long)h.count, (unsigned long)h.percentile(50), (unsigned long)h.percentile(90),
+                      (unsigned long)h.percentile(99), (unsigned long)h.max);
+    }
+    len += snprintf(out + len, size > (size_t)len ? size - len : 0, "}");
+    return len > 0 && (size_t)len < size ? (size_t)len : 0;
+  }
+
+ private:
+  StageHistogram stages_[CMD_STAGE_COUNT];
+  uint32_t results_[CMD_RESULT_COUNT];
+  uint8_t depth_ = 0;
+  bool armed_ = false;
+  bool traced_ = false;
+  char cid_[CMD_CID_MAX + 1] = "";
+  char ts_[CMD_TS_MAX + 1] = "";
+  uint8_t result_ = CMD_RESULT_OK;
+  bool dispatched_ = false;
+  bool acted_ = false;
+  uint32_t rxUs_ = 0;
+  uint32_t pollUs_ = 0;
+  uint32_t gateUs_ = 0;
+  uint32_t actUs_ = 0;
+
+  static bool isCidChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+  }
+
+  size_t clearEnvelope() {
+    cid_[0] = '\0';
+    ts_[0] = '\0';
+    return 0;
+  }
+};
+
+#endif  // COMMAND_TRACE_H
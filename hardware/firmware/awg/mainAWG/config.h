@@ -6,15 +6,43 @@
 #define MQTT_PORT 1883
 #define MQTT_USER ""
 #define MQTT_PASS ""
-#define MQTT_CLIENT_ID "Dropster_AWG"
-
-// Tópicos organizados (deben coincidir con Dropster App)
-#define MQTT_TOPIC_DATA "dropster/data"           // Datos de sensores (JSON, QoS 0)
-#define MQTT_TOPIC_STATUS "dropster/status"       // Estados actuadores + modo (JSON, QoS 1, retained)
-#define MQTT_TOPIC_CONTROL "dropster/control"     // Comandos app → dispositivo (control + configuración)
-#define MQTT_TOPIC_ALERTS "dropster/alerts"       // Alertas específicas
-#define MQTT_TOPIC_ERRORS "dropster/errors"       // Mensajes de error
-#define MQTT_TOPIC_SYSTEM "dropster/system"       // Estado general del sistema
+#define MQTT_CLIENT_ID "Dropster_AWG"  // Prefijo del client id: "Dropster_AWG_<id del equipo>"
+
+// Tópicos (deben coincidir con Dropster App): MQTT_TOPIC_ROOT/<id del equipo>/<hoja>, ver
+// mqtt_topics.h. Con MQTT_LEGACY_TOPICS_DEFAULT true los equipos sin configuración guardada
+// usan los tópicos planos de versiones anteriores (dropster/data, dropster/status...). Un
+// equipo actualizado que ya tenía broker guardado sigue en legacy hasta SET_MQTT_LEGACY OFF.
+// Con MQTT_SHARED_CONTROL true los equipos con tópicos por equipo también aceptan comandos
+// en dropster/control, el de las apps anteriores. Vuelve a entregar cada comando (OTA y
+// críticos incluidos) a todos los equipos del broker: solo para una migración controlada
+#define MQTT_TOPIC_ROOT "dropster"
+#define MQTT_LEGACY_TOPICS_DEFAULT false
+#define MQTT_SHARED_CONTROL false
+
+// Actualización de firmware (OTA), ver ota_package.h y tools/ota. Clave pública Ed25519 de
+// "dropster-ota keygen"; en cero el AWG rechaza todos los paquetes (OTA deshabilitado).
+// Requiere un esquema de particiones con dos slots de app (ota_0/ota_1, el "Default" de Arduino)
+#define FIRMWARE_VERSION "1.0"
+#define OTA_SIGNING_PUBLIC_KEY {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, \
+                                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+#define OTA_CHECKPOINT_EVERY_BYTES 65536UL   // Imagen escrita entre puntos de control en NVS
+#define OTA_PULL_RETRY_MIN_MS 2000UL         // Backoff de la descarga HTTP tras un corte
+#define OTA_PULL_RETRY_MAX_MS 30000UL
+#define OTA_PULL_MAX_STALLED 8               // Intentos seguidos sin escribir un bloque antes de abandonar
+#define OTA_PULL_TIMEOUT_MS 15000UL          // Conexión sin datos
+#define OTA_PULL_TASK_STACK 8192
+#define OTA_MQTT_CHUNK 2048                  // Datos por mensaje de OTA_PUSH (más 4 bytes de offset)
+#define OTA_MQTT_BUFFER_SIZE 2560            // Buffer de PubSubClient durante OTA_PUSH (tópico + trozo)
+#define OTA_MQTT_IDLE_TIMEOUT_MS 60000UL     // OTA_PUSH sin trozos: se suspende (sigue desde el punto de control)
+#define OTA_REBOOT_MAX_WAIT_MS 1800000UL     // Espera máxima a que pare el compresor para reiniciar (30 min)
+#define OTA_HEALTH_MIN_UPTIME_MS 60000UL     // Imagen nueva: tiempo mínimo funcionando antes de validarla
+#define OTA_HEALTH_TIMEOUT_MS 300000UL       // Sin validar en este tiempo: vuelve a la imagen anterior
+#define OTA_MAX_PENDING_BOOTS 3              // Reinicios de una imagen sin validar antes de revertir
+#define OTA_DISPLAY_FRAME 1024               // Datos por trama UART hacia la pantalla
+#define OTA_DISPLAY_ACK_TIMEOUT_MS 2000UL
+#define OTA_DISPLAY_MAX_RETRIES 5
+#define OTA_DISPLAY_BOOT_TIMEOUT_MS 120000UL // La pantalla debe reportar la versión nueva en este tiempo
+#define OTA_PROGRESS_INTERVAL_MS 2000UL      // Avance publicado en status durante la descarga
 
 // Intervalos de operación (ms) - Optimizados para estabilidad UART
 #define SENSOR_READ_INTERVAL 2000  // Reducido para lecturas más frecuentes
@@ -22,6 +50,7 @@
 #define MQTT_TRANSMIT_INTERVAL 5000
 #define HEARTBEAT_INTERVAL 30000     // Reducido a 30s para mejor keep-alive
 #define WIFI_CHECK_INTERVAL 10000
+#define MQTT_PING_INTERVAL 45000UL   // Ping MQTT para mantener la conexión viva
 #define MQTT_RECONNECT_DELAY 3000    // Reducido para reconexión más rápida
 #define CONFIG_BUTTON_TIMEOUT 5000
 
@@ -29,10 +58,7 @@
 #define MAX_CALIBRATION_POINTS 30
 
 // Constantes para cálculos
-#define Rv 461.5
-#define L 2.5e6
 #define ZERO_CELSIUS 273.15
-#define A_MAGNUS 611.2
 
 // Constantes del termistor NTC
 #define BETA 3950.0                    // Coeficiente Beta estándar
@@ -140,6 +166,8 @@
 // Configuración del modo automático por tiempo
 #define TIME_MODE_COMPRESSOR_ON_TIME_DEFAULT 900   // Tiempo encendido del compresor (s, 15 min)
 #define TIME_MODE_COMPRESSOR_OFF_TIME_DEFAULT 450  // Tiempo apagado del compresor (s, 7.5 min)
+#define DUTY_BUDGET_HOURS_DEFAULT 16.0f            // Horas diarias de compresor a repartir (equivale al ciclo 900/450)
+#define DUTY_SAMPLE_INTERVAL 10000UL               // Intervalo de muestreo del perfil horario (ms)
 
 // Configuración del display
 #define SCREEN_TIMEOUT_DEFAULT 0         // Timeout de pantalla por defecto (segundos, 0 = deshabilitado)
@@ -156,6 +184,8 @@
 
 // Configuración MQTT adicional - Mejorada para estabilidad
 #define MQTT_MAX_BACKOFF 300000UL   // Máximo 5 minutos de backoff
+#define MQTT_STABLE_SESSION_MS 60000UL  // Una sesión que dura esto reinicia el backoff
+#define MQTT_BACKOFF_JITTER_PCT 25      // Jitter de cada espera: la flota no reintenta a la vez tras caer el broker
 
 // Constantes de algoritmos
 #define PZEM_INIT_ATTEMPTS 3
@@ -168,8 +198,9 @@
 
 // Tamaños de buffers JSON
 #define STATUS_JSON_SIZE 200
-#define DATA_JSON_SIZE 300
+#define DATA_JSON_SIZE 512  // Incluye tasa de producción e incertidumbre del nivel
 #define CONFIG_JSON_SIZE 2048
+#define ROLLUP_JSON_SIZE 640
 
 // Constantes de algoritmos
 #define CALIBRATION_DISTANCE_TOLERANCE 2.0f    // Tolerancia para distancia en calibración
@@ -198,16 +229,39 @@
 // Constantes de timing adicionales
 #define STARTUP_DELAY 1000                     // Delay de inicio (ms)
 #define STATS_SAVE_INTERVAL 300000UL           // Intervalo para guardar estadísticas (ms, 5 min)
+#define ROLLUP_SAVE_INTERVAL 600000UL          // Intervalo para guardar los agregados abiertos (ms, 10 min)
 #define CONFIG_ASSEMBLE_TIMEOUT 10000          // Timeout para ensamblaje de config (ms)
 
+// Perfil de memoria (mem_profile.h)
+#define MEM_SAMPLE_INTERVAL_MS 10000UL         // Lectura del heap y de su mínimo por intervalo
+#define MEM_REPORT_INTERVAL_MS 300000UL        // Resumen en dropster/<id>/system (5 min)
+#define MEM_TREND_INTERVAL_MS 3600000UL        // Muestra de tendencia guardada en NVS (1 h)
+#define MEM_STACK_WARN_BYTES 512               // Margen de pila que se avisa como crítico
+
 // Protección del compresor
 #define COMPRESSOR_PROTECTION_TIME 30000UL     // Tiempo de monitoreo inicial (ms, 30 segundos)
 #define COMPRESSOR_MIN_CURRENT 1.75f           // Corriente mínima para considerar arranque exitoso (A)
 #define COMPRESSOR_RETRY_DELAY 60000UL         // Retraso antes de reintentar arranque (ms, 1 min)
 #define CONFIG_PORTAL_MAX_TIMEOUT 120000UL     // Máximo tiempo de portal de configuración (ms, 2 minutos)
+#define PORTAL_CONNECT_TIMEOUT 5               // Espera al probar credenciales del portal (s); acota el bloqueo del loop
+#define LOOP_STALL_WARN_MS 1000UL              // Iteración del loop considerada bloqueo (ms)
+
+// Supervisor de seguridad (safety_supervisor.h)
+#define SAFETY_PERIOD_MS 200UL                 // Período fijo de la tarea: cota del tiempo de reacción
+#define SAFETY_TASK_STACK 3072
+#define SAFETY_TASK_PRIORITY 20                // Sobre el loop (1) y lwIP (18), debajo de la tarea WiFi (23)
+#define SAFETY_TASK_CORE 1                     // El del loop: lo desaloja aunque gire sin ceder
+#define SAFETY_STALE_MS 30000UL                // Muestra de sensores más vieja: se apaga lo encendido
+#define SAFETY_LOOP_STALL_MS 60000UL           // Loop sin latir: se deja de alimentar el watchdog
+#define SAFETY_WDT_TIMEOUT_S 10                // Watchdog de tareas tras dejar de alimentarlo (s)
+#define SAFETY_MAX_ON_GRACE_MS 60000UL         // Margen sobre control_max_on: el corte normal es del loop
+#define SAFETY_TEMP_HYSTERESIS_C 5.0f          // Temperatura del compresor para liberar el enclavamiento
+#define SAFETY_TANK_HYSTERESIS_PCT 2.0f        // Nivel bajo el umbral de lleno para liberar
+#define SAFETY_PUMP_HYSTERESIS_L 0.5f          // Agua sobre el mínimo de la bomba para liberar
 
 // Constantes para arrays y contadores
 #define CONFIG_FRAGMENT_COUNT 4                 // Número de fragmentos de configuración
+#define UART1_RX_BUFFER_SIZE 1024               // Buffer de recepción del UART de pantalla (JSON completo mientras el loop reposa)
 
 // Otras constantes
 #define WATER_PERCENT_MIN 0.0f                  // Porcentaje mínimo de agua
@@ -0,0 +1,301 @@
+#ifndef DUTY_SCHEDULER_H
+#define DUTY_SCHEDULER_H
+
+// Planificador de ciclo de trabajo por hora del día para MODE_AUTO_TIME
+//
+// Mantiene un perfil móvil de 24 franjas horarias con la humedad absoluta media y el
+// rendimiento observado (litros por hora de compresor). Con ese perfil reparte un
+// presupuesto diario de horas de compresor hacia las franjas más productivas: cada hora
+// restante del día recibe una puntuación (rendimiento esperado / peso de tarifa) y el
+// presupuesto pendiente se asigna de mayor a menor puntuación hasta DUTY_MAX_FRACTION
+// de cada hora. El plan se recalcula en cada cambio de hora con el presupuesto restante.
+//
+// El planificador solo decide la fracción de trabajo; los enclavamientos (tanque lleno,
+// protección térmica, tiempo mínimo apagado) los sigue aplicando processControl().
+// Sin dependencias de Arduino: la hora del día la entrega el llamador, de modo que puede
+// evaluarse en host reproduciendo trazas meteorológicas de varios días.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DUTY_HOURS 24
+#define DUTY_TARIFF_SLOTS 3                // Ventanas de tarifa configurables
+#define DUTY_MAX_FRACTION 0.85f            // Fracción máxima de cada hora con compresor encendido
+#define DUTY_MIN_FRACTION 0.01f            // Por debajo (restos del presupuesto) la hora no arranca
+#define DUTY_MAX_OFF_SEC 86400.0f          // Tope del apagado derivado; el plan se rehace cada hora
+#define DUTY_PROFILE_ALPHA 0.3f            // Peso de cada día nuevo en el perfil horario
+#define DUTY_MIN_PROFILED_HOURS 24         // Franjas con datos necesarias antes de planificar
+#define DUTY_MIN_RUNTIME_FOR_YIELD 300.0f  // Segundos de compresor en la hora para medir rendimiento
+#define DUTY_VOLUME_JUMP 1.0f              // Salto de volumen que se considera bombeo/extracción (L)
+#define DUTY_PROFILE_VERSION 1
+
+// Perfil persistente (se guarda como blob en NVS)
+struct DutyProfile {
+  uint8_t version = DUTY_PROFILE_VERSION;
+  float absHumidity[DUTY_HOURS];  // Humedad absoluta media por hora (g/m3), NAN sin datos
+  float yieldRate[DUTY_HOURS];    // Litros por hora de compresor, NAN sin datos
+  DutyProfile() {
+    for (int h = 0; h < DUTY_HOURS; h++) {
+      absHumidity[h] = NAN;
+      yieldRate[h] = NAN;
+    }
+  }
+};
+
+struct DutyTariff {
+  uint8_t startHour = 0;  // Inicio de la ventana (incluido)
+  uint8_t endHour = 0;    // Fin de la ventana (excluido); admite cruzar medianoche
+  float weight = 0.0f;    // Multiplicador de coste (> 1 encarece, 0 = ventana deshabilitada)
+};
+
+class DutyScheduler {
+public:
+  void begin(float budgetHours, const DutyProfile* profile = nullptr) {
+    setBudgetHours(budgetHours);
+    if (profile && profile->version == DUTY_PROFILE_VERSION) profile_ = *profile;
+    currentHour_ = -1;
+    currentDay_ = UINT32_MAX;
+    lastVolume_ = NAN;
+    resetHourAccumulators();
+  }
+
+  void setBudgetHours(float hours) {
+    if (isnan(hours) || hours < 0.0f) hours = 0.0f;
+    if (hours > DUTY_HOURS * DUTY_MAX_FRACTION) hours = DUTY_HOURS * DUTY_MAX_FRACTION;
+    budgetSec_ = hours * 3600.0f;
+    planDirty_ = true;
+  }
+  float budgetHours() const { return budgetSec_ / 3600.0f; }
+
+  bool setTariff(uint8_t slot, uint8_t startHour, uint8_t endHour, float weight) {
+    if (slot >= DUTY_TARIFF_SLOTS || startHour >= DUTY_HOURS || endHour > DUTY_HOURS || weight < 0.0f) return false;
+    tariffs_[slot].startHour = startHour;
+    tariffs_[slot].endHour = endHour;
+    tariffs_[slot].weight = weight;
+    planDirty_ = true;
+    return true;
+  }
+  const DutyTariff& tariff(uint8_t slot) const { return tariffs_[slot < DUTY_TARIFF_SLOTS ? slot : 0]; }
+
+  // Alimentar en cada muestreo. secondOfDay y day vienen del RTC; dtSec es el tiempo desde
+  // la muestra anterior. Devuelve true cuando se cerró una hora (momento de persistir).
+  bool sample(uint32_t secondOfDay, uint32_t day, float dtSec, float absHumidity, float volumeL, bool compressorOn, bool pumpOn) {
+    secondOfDay %= 86400UL;
+    int hour = (int)(secondOfDay / 3600UL);
+    bool hourClosed = false;
+
+    if (day != currentDay_) {
+      if (currentDay_ != UINT32_MAX) {
+        if (currentHour_ >= 0) closeHour();
+        hourClosed = true;
+        lastDayExpected_ = expectedToday();
+        lastDayAchieved_ = achievedToday_;
+      }
+      currentDay_ = day;
+      currentHour_ = hour;
+      runtimeTodaySec_ = 0;
+      achievedToday_ = 0;
+      resetHourAccumulators();
+      planDirty_ = true;
+    } else if (hour != currentHour_) {
+      if (currentHour_ >= 0) closeHour();
+      hourClosed = true;
+      currentHour_ = hour;
+      resetHourAccumulators();
+      planDirty_ = true;
+    }
+
+    if (dtSec > 0.0f && dtSec < 600.0f) {
+      if (compressorOn) {
+        runtimeTodaySec_ += dtSec;
+        hourRuntimeSec_ += dtSec;
+      }
+      if (pumpOn) hourPumpSeen_ = true;
+    }
+    if (!isnan(absHumidity) && absHumidity > 0.0f) {
+      hourAhSum_ += absHumidity;
+      hourAhCount_++;
+    }
+    // Variación neta (el ruido se cancela); saltos grandes o con bomba activa no son producción
+    if (!isnan(volumeL)) {
+      if (!isnan(lastVolume_)) {
+        float dv = volumeL - lastVolume_;
+        if (fabsf(dv) < DUTY_VOLUME_JUMP && !pumpOn) {
+          hourWater_ += dv;
+          achievedToday_ += dv;
+        }
+      }
+      lastVolume_ = volumeL;
+    }
+
+    if (planDirty_) replan(secondOfDay);
+    return hourClosed;
+  }
+
+  // Perfil suficiente para planificar; si no, el llamador mantiene el ciclo fijo
+  bool ready() const { return profiledHours() >= DUTY_MIN_PROFILED_HOURS; }
+
+  int profiledHours() const {
+    int n = 0;
+    for (int h = 0; h < DUTY_HOURS; h++) {
+      if (!isnan(profile_.absHumidity[h])) n++;
+    }
+    return n;
+  }
+
+  // Fracción de trabajo asignada a la hora en curso (0 si el presupuesto del día se agotó)
+  float currentDuty() const {
+    if (currentHour_ < 0 || runtimeTodaySec_ >= budgetSec_) return 0.0f;
+    return plan_[currentHour_];
+  }
+  float plannedDuty(int hour) const { return (hour >= 0 && hour < DUTY_HOURS) ? plan_[hour] : 0.0f; }
+
+  // Tiempo de apagado que realiza la fracción actual con ciclos de onSec. UINT32_MAX si no debe
+  // arrancar; acotado para que la conversión a entero no desborde con fracciones residuales
+  uint32_t offTimeSec(uint32_t onSec, uint32_t minOffSec) const {
+    float duty = currentDuty();
+    if (!(duty >= DUTY_MIN_FRACTION)) return UINT32_MAX;
+    float off = onSec * (1.0f - duty) / duty;
+    if (off > DUTY_MAX_OFF_SEC) off = DUTY_MAX_OFF_SEC;
+    return off < minOffSec ? minOffSec : (uint32_t)off;
+  }
+
+  // Litros esperados hoy: lo ya producido más el plan restante por el rendimiento de cada hora
+  float expectedToday() const {
+    float expected = achievedToday_;
+    for (int h = (currentHour_ < 0 ? 0 : currentHour_); h < DUTY_HOURS; h++) {
+      float rate = yieldEstimate(h);
+      if (isnan(rate)) continue;
+      float hours = plan_[h] * ((h == currentHour_) ? planFirstHourFraction_ : 1.0f);
+      expected += hours * rate;
+    }
+    return expected;
+  }
+  float achievedToday() const { return achievedToday_; }
+  float lastDayExpected() const { return lastDayExpected_; }
+  float lastDayAchieved() const { return lastDayAchieved_; }
+  float runtimeTodayHours() const { return runtimeTodaySec_ / 3600.0f; }
+  int currentHour() const { return currentHour_; }
+  const DutyProfile& profile() const { return profile_; }
+
+  // Rendimiento esperado (L por hora de compresor) de una franja; sin medición propia se
+  // estima escalando la humedad absoluta con la relación rendimiento/humedad global
+  float yieldEstimate(int h) const {
+    if (!isnan(profile_.yieldRate[h])) return profile_.yieldRate[h];
+    float ratio = yieldPerHumidity();
+    if (isnan(ratio) || isnan(profile_.absHumidity[h])) return NAN;
+    return ratio * profile_.absHumidity[h];
+  }
+
+private:
+  DutyProfile profile_;
+  DutyTariff tariffs_[DUTY_TARIFF_SLOTS];
+  float plan_[DUTY_HOURS] = { 0 };
+  float planFirstHourFraction_ = 1.0f;
+  bool planDirty_ = true;
+  float budgetSec_ = 0;
+
+  int currentHour_ = -1;
+  uint32_t currentDay_ = UINT32_MAX;
+  float runtimeTodaySec_ = 0;
+  float achievedToday_ = 0;
+  float lastDayExpected_ = NAN;
+  float lastDayAchieved_ = NAN;
+  float lastVolume_ = NAN;
+
+  // Acumuladores de la hora en curso
+  float hourAhSum_ = 0;
+  uint32_t hourAhCount_ = 0;
+  float hourRuntimeSec_ = 0;
+  float hourWater_ = 0;
+  bool hourPumpSeen_ = false;
+
+  void resetHourAccumulators() {
+    hourAhSum_ = 0;
+    hourAhCount_ = 0;
+    hourRuntimeSec_ = 0;
+    hourWater_ = 0;
+    hourPumpSeen_ = false;
+  }
+
+  static float blend(float oldValue, float sample) {
+    return isnan(oldValue) ? sample : DUTY_PROFILE_ALPHA * sample + (1.0f - DUTY_PROFILE_ALPHA) * oldValue;
+  }
+
+  void closeHour() {
+    int h = currentHour_;
+    if (hourAhCount_ > 0) profile_.absHumidity[h] = blend(profile_.absHumidity[h], hourAhSum_ / hourAhCount_);
+    if (hourRuntimeSec_ >= DUTY_MIN_RUNTIME_FOR_YIELD && !hourPumpSeen_) {
+      profile_.yieldRate[h] = blend(profile_.yieldRate[h], hourWater_ / (hourRuntimeSec_ / 3600.0f));
+    }
+  }
+
+  float yieldPerHumidity() const {
+    float y = 0, a = 0;
+    for (int h = 0; h < DUTY_HOURS; h++) {
+      if (!isnan(profile_.yieldRate[h]) && !isnan(profile_.absHumidity[h])) {
+        y += profile_.yieldRate[h];
+        a += profile_.absHumidity[h];
+      }
+    }
+    return a > 0.0f ? y / a : NAN;
+  }
+
+  float tariffWeight(int h) const {
+    float w = 1.0f;
+    for (int i = 0; i < DUTY_TARIFF_SLOTS; i++) {
+      const DutyTariff& t = tariffs_[i];
+      if (t.weight <= 0.0f || t.startHour == t.endHour) continue;
+      bool inside = (t.startHour < t.endHour) ? (h >= t.startHour && h < t.endHour) : (h >= t.startHour || h < t.endHour);
+      if (inside) w *= t.weight;
+    }
+    return w;
+  }
+
+  // Puntuación de una franja: rendimiento esperado (o humedad si aún no hay rendimiento) / tarifa
+  float score(int h) const {
+    float s = yieldEstimate(h);
+    if (isnan(s)) s = profile_.absHumidity[h];
+    if (isnan(s)) s = 0.0f;
+    return s / tariffWeight(h);
+  }
+
+  void replan(uint32_t secondOfDay) {
+    planDirty_ = false;
+    for (int h = 0; h < DUTY_HOURS; h++) plan_[h] = 0.0f;
+    if (currentHour_ < 0) return;
+
+    planFirstHourFraction_ = 1.0f - (float)(secondOfDay % 3600UL) / 3600.0f;
+    float remaining = budgetSec_ - runtimeTodaySec_;
+    if (remaining <= 0.0f) return;
+
+    // Ordenar por puntuación las horas que quedan (inserción: como mucho 24 elementos)
+    uint8_t order[DUTY_HOURS];
+    float scores[DUTY_HOURS];
+    int n = 0;
+    for (int h = currentHour_; h < DUTY_HOURS; h++) {
+      float s = score(h);
+      int i = n++;
+      while (i > 0 && scores[i - 1] < s) {
+        scores[i] = scores[i - 1];
+        order[i] = order[i - 1];
+        i--;
+      }
+      scores[i] = s;
+      order[i] = (uint8_t)h;
+    }
+
+    for (int i = 0; i < n && remaining > 0.0f; i++) {
+      int h = order[i];
+      // La hora en curso solo dispone del tiempo que le queda
+      float span = (h == currentHour_) ? 3600.0f * planFirstHourFraction_ : 3600.0f;
+      float capacity = DUTY_MAX_FRACTION * span;
+      float take = remaining < capacity ? remaining : capacity;
+      plan_[h] = span > 0.0f ? take / span : 0.0f;
+      remaining -= take;
+    }
+  }
+};
+
+#endif  // DUTY_SCHEDULER_H
@@ -0,0 +1,206 @@
+#ifndef LEVEL_ESTIMATOR_H
+#define LEVEL_ESTIMATOR_H
+
+// Estimador de nivel del tanque y tasa de producción (filtro de Kalman de 2 estados)
+//
+// Estado: x = [volumen (L), tasa de producción (L/h)]. Los relés se usan como entradas
+// conocidas del modelo:
+//  - Compresor encendido: la tasa evoluciona como caminata aleatoria (la producción cambia
+//    despacio con el ambiente).
+//  - Compresor apagado: la tasa decae a cero con constante LEVEL_RATE_DECAY_S (el
+//    evaporador sigue goteando unos minutos tras apagar).
+//  - Bomba encendida: el volumen baja al caudal de bomba aprendido y se abre la varianza
+//    del volumen por la incertidumbre de ese caudal.
+//
+// Medición: volumen obtenido de la mediana de LEVEL_PINGS_PER_ESTIMATE pings convertida con
+// la curva de calibración. La mediana elimina ecos sueltos; lo que pase se rechaza por
+// compuerta de innovación (NIS > LEVEL_GATE_CHI2). Si se rechazan LEVEL_MAX_REJECTS
+// mediciones seguidas el nivel cambió de verdad (extracción o llenado manual) y el filtro
+// se reinicia en la medición. Un ping fallido solo propaga el modelo.
+//
+// Sin dependencias de Arduino: puede evaluarse en host con trazas sintéticas o grabadas.
+
+#include <math.h>
+#include <stdint.h>
+
+#define LEVEL_PINGS_PER_ESTIMATE 3        // Pings por estimación (mediana)
+#define LEVEL_DISTANCE_SIGMA_CM 0.3f      // Ruido de la mediana de distancia (cm, 1σ)
+#define LEVEL_MEAS_VAR_FLOOR 0.0025f      // Varianza mínima de la medición de volumen (L², 0.05 L)
+#define LEVEL_RATE_NOISE 0.5f             // Densidad de ruido de la tasa ((L/h)/√h)
+#define LEVEL_VOLUME_NOISE 0.02f          // Densidad de ruido del volumen (L/√h): evaporación, oleaje
+#define LEVEL_RATE_DECAY_S 600.0f         // Constante de decaimiento de la tasa con compresor apagado (s)
+#define LEVEL_PUMP_FLOW_DEFAULT 120.0f    // Caudal de bomba inicial (L/h)
+#define LEVEL_PUMP_FLOW_SIGMA 60.0f       // Incertidumbre del caudal de bomba (L/h, 1σ)
+#define LEVEL_PUMP_FLOW_MIN 10.0f         // Caudal de bomba plausible mínimo (L/h)
+#define LEVEL_PUMP_FLOW_MAX 1000.0f       // Caudal de bomba plausible máximo (L/h)
+#define LEVEL_PUMP_FLOW_ALPHA 0.3f        // Suavizado del caudal aprendido en cada ciclo de bomba
+#define LEVEL_PUMP_MIN_LEARN_S 10.0f      // Duración mínima de bombeo para aprender el caudal (s)
+#define LEVEL_PUMP_SETTLE_S 30.0f         // Espera tras el bombeo antes de medir la caída (s)
+#define LEVEL_GATE_CHI2 9.0f              // Compuerta de innovación (3σ)
+#define LEVEL_MAX_REJECTS 5               // Rechazos consecutivos antes de reiniciar en la medición
+#define LEVEL_INITIAL_RATE_VAR 4.0f       // Varianza inicial de la tasa ((L/h)², 2 L/h)
+#define LEVEL_MAX_DT_S 600.0f             // Paso máximo de propagación (s); más largo reinicia
+
+class LevelEstimator {
+public:
+  void begin(float pumpFlowLph = LEVEL_PUMP_FLOW_DEFAULT) {
+    pumpFlow_ = (pumpFlowLph >= LEVEL_PUMP_FLOW_MIN && pumpFlowLph <= LEVEL_PUMP_FLOW_MAX) ? pumpFlowLph : LEVEL_PUMP_FLOW_DEFAULT;
+    rejectedTotal_ = 0;
+    resets_ = 0;
+    reset();
+  }
+
+  // Olvida el estado (recalibración del tanque, sensor caído mucho tiempo)
+  void reset() {
+    initialized_ = false;
+    consecutiveRejects_ = 0;
+    pumpWasOn_ = false;
+    pumpSeconds_ = 0;
+    settleSeconds_ = -1.0f;
+    v_ = 0;
+    r_ = 0;
+    p00_ = p01_ = p11_ = 0;
+  }
+
+  // Propaga el estado dtSec segundos con los relés como entradas conocidas
+  void predict(float dtSec, bool compressorOn, bool pumpOn) {
+    if (!initialized_ || !(dtSec > 0.0f)) return;
+    if (dtSec > LEVEL_MAX_DT_S) {
+      reset();
+      return;
+    }
+    trackPump(dtSec, pumpOn);
+
+    float h = dtSec / 3600.0f;
+    // Matriz de transición F = [[1, f01], [0, f11]]
+    float f01 = h, f11 = 1.0f;
+    if (!compressorOn) {
+      float tauH = LEVEL_RATE_DECAY_S / 3600.0f;
+      f11 = expf(-dtSec / LEVEL_RATE_DECAY_S);
+      f01 = tauH * (1.0f - f11);
+    }
+    v_ += f01 * r_;
+    r_ *= f11;
+    if (pumpOn) v_ -= pumpFlow_ * h;
+
+    // P = F P Fᵀ + Q
+    float n00 = p00_ + 2.0f * f01 * p01_ + f01 * f01 * p11_;
+    float n01 = f11 * (p01_ + f01 * p11_);
+    float n11 = f11 * f11 * p11_;
+    float qr = LEVEL_RATE_NOISE * LEVEL_RATE_NOISE;
+    n00 += qr * h * h * h / 3.0f + LEVEL_VOLUME_NOISE * LEVEL_VOLUME_NOISE * h;
+    n01 += qr * h * h / 2.0f;
+    n11 += qr * h;
+    if (pumpOn) {
+      float sv = LEVEL_PUMP_FLOW_SIGMA * h;
+      n00 += sv * sv;
+    }
+    p00_ = n00;
+    p01_ = n01;
+    p11_ = n11;
+  }
+
+  // Incorpora una medición de volumen (L) con varianza measVar (L²). Devuelve false si la
+  // compuerta la rechaza; la primera medición (o un reinicio por rechazos) inicializa el estado
+  bool update(float measVolume, float measVar) {
+    if (isnan(measVolume)) return false;
+    if (!(measVar > LEVEL_MEAS_VAR_FLOOR)) measVar = LEVEL_MEAS_VAR_FLOOR;
+    if (!initialized_) {
+      initialize(measVolume, measVar);
+      return true;
+    }
+
+    float y = measVolume - v_;
+    float s = p00_ + measVar;
+    if (y * y > LEVEL_GATE_CHI2 * s) {
+      rejectedTotal_++;
+      if (++consecutiveRejects_ >= LEVEL_MAX_REJECTS) {
+        resets_++;
+        initialize(measVolume, measVar);
+        return true;
+      }
+      return false;
+    }
+    consecutiveRejects_ = 0;
+
+    float k0 = p00_ / s;
+    float k1 = p01_ / s;
+    v_ += k0 * y;
+    r_ += k1 * y;
+    // P = (I - K H) P
+    float n00 = (1.0f - k0) * p00_;
+    float n01 = (1.0f - k0) * p01_;
+    float n11 = p11_ - k1 * p01_;
+    p00_ = n00;
+    p01_ = n01;
+    p11_ = n11 > 0.0f ? n11 : 0.0f;
+    return true;
+  }
+
+  bool initialized() const { return initialized_; }
+  float volume() const { return initialized_ ? v_ : NAN; }
+  // Tasa de producción (L/h), sin contar el drenaje de la bomba
+  float rate() const { return initialized_ ? r_ : NAN; }
+  float volumeStdDev() const { return initialized_ ? sqrtf(p00_) : NAN; }
+  float rateStdDev() const { return initialized_ ? sqrtf(p11_) : NAN; }
+  float pumpFlow() const { return pumpFlow_; }
+  uint32_t rejectedTotal() const { return rejectedTotal_; }
+  uint16_t resets() const { return resets_; }
+
+private:
+  bool initialized_ = false;
+  float v_ = 0, r_ = 0;
+  float p00_ = 0, p01_ = 0, p11_ = 0;
+  float pumpFlow_ = LEVEL_PUMP_FLOW_DEFAULT;
+  uint8_t consecutiveRejects_ = 0;
+  uint32_t rejectedTotal_ = 0;
+  uint16_t resets_ = 0;
+
+  // Ciclo de bomba en curso, para aprender el caudal
+  bool pumpWasOn_ = false;
+  float pumpSeconds_ = 0;
+  float pumpStartVolume_ = 0;
+  float settleSeconds_ = -1.0f;  // Espera tras el bombeo (<0: nada pendiente)
+
+  void initialize(float measVolume, float measVar) {
+    initialized_ = true;
+    consecutiveRejects_ = 0;
+    pumpWasOn_ = false;
+    pumpSeconds_ = 0;
+    settleSeconds_ = -1.0f;
+    v_ = measVolume;
+    r_ = 0;
+    p00_ = measVar;
+    p01_ = 0;
+    p11_ = LEVEL_INITIAL_RATE_VAR;
+  }
+
+  // Terminado un bombeo espera LEVEL_PUMP_SETTLE_S a que el filtro alcance al nivel real y
+  // compara el volumen antes y después para corregir el caudal
+  void trackPump(float dtSec, bool pumpOn) {
+    if (pumpOn) {
+      if (!pumpWasOn_) {
+        pumpStartVolume_ = v_;
+        pumpSeconds_ = 0;
+      }
+      pumpSeconds_ += dtSec;
+      settleSeconds_ = -1.0f;
+    } else if (pumpWasOn_) {
+      settleSeconds_ = (pumpSeconds_ >= LEVEL_PUMP_MIN_LEARN_S) ? 0.0f : -1.0f;
+    } else if (settleSeconds_ >= 0.0f) {
+      settleSeconds_ += dtSec;
+      if (settleSeconds_ >= LEVEL_PUMP_SETTLE_S) {
+        // Lo producido mientras tanto también entró al tanque
+        float drop = pumpStartVolume_ - v_ + r_ * (pumpSeconds_ + settleSeconds_) / 3600.0f;
+        float flow = drop / (pumpSeconds_ / 3600.0f);
+        if (flow >= LEVEL_PUMP_FLOW_MIN && flow <= LEVEL_PUMP_FLOW_MAX) {
+          pumpFlow_ += LEVEL_PUMP_FLOW_ALPHA * (flow - pumpFlow_);
+        }
+        settleSeconds_ = -1.0f;
+      }
+    }
+    pumpWasOn_ = pumpOn;
+  }
+};
+
+#endif  // LEVEL_ESTIMATOR_H
@@ -16,7 +16,31 @@
 #include <esp32-hal-ledc.h>   // Control PWM LEDC para
 #include <driver/ledc.h>      // Control PWM LEDC directo para LED RGB
 #include <nvs_flash.h>        // Inicialización de NVS para evitar errores de calibración RF
+#include <esp_pm.h>           // Gestor de energía (DFS y sueño ligero automático)
+#include <esp_sleep.h>        // Fuentes de despertar del sueño ligero
+#include <driver/gpio.h>      // Despertar por GPIO (UART de pantalla y botón)
+#include <driver/uart.h>      // Despertar por UART0
 #include "config.h"           // Archivo de configuración con pines y constantes
+#include "psychrometrics.h"   // Cálculos psicrométricos en precisión simple
+#include "adaptive_control.h"  // Control adaptativo de rendimiento (L/kWh)
+#include "duty_scheduler.h"    // Reparto horario del ciclo de trabajo en modo tiempo
+#include "level_estimator.h"   // Filtro de Kalman de nivel y tasa de producción
+#include "rollup.h"            // Agregados por minuto, hora y día
+#include "power_manager.h"     // Sueño ligero y escalado de frecuencia entre trabajos periódicos
+#include "mqtt_topics.h"       // Id del equipo y tópicos dropster/<id>/...
+#include "ota_package.h"       // Paquetes de firmware firmados (OTA)
+#include "command_trace.h"      // Id de correlación, acuses y latencia de comandos
+#include "mem_profile.h"        // Heap por subsistema y tendencia entre reinicios
+#include "safety_supervisor.h"  // Límites del compresor y la bomba fuera de loop()
+#include <esp_heap_caps.h>     // Heap libre y mayor bloque
+#include <esp_system.h>        // Causa del último reinicio
+#include <esp_timer.h>         // Uptime de 64 bits (millis() da la vuelta a los 49,7 días)
+#include <esp_idf_version.h>   // API del watchdog de tareas según la versión del SDK
+#include <esp_task_wdt.h>      // Watchdog de tareas alimentado por el supervisor
+#include <esp_ota_ops.h>       // Particiones de app A/B y reversión
+#include <esp_partition.h>     // Escritura directa de la partición inactiva
+#include <HTTPClient.h>        // Descarga OTA con Range
+#include <rom/crc.h>           // CRC-32 de las tramas OTA a la pantalla
 
 // 2. INSTANCIAS GLOBALES Y CONFIGURACIÓN INICIAL
 // Gestión de conectividad
@@ -40,10 +64,25 @@ bool firstDistanceReading = true;
 bool offlineMode = false;
 bool portalActive = false;
 bool sensorFailure = false;
-bool configPortalForceActive = false;
+unsigned long lastLoopStart = 0;       // Inicio de la iteración anterior del loop (ms)
+unsigned long loopMaxStallMs = 0;      // Mayor tiempo entre iteraciones del loop
+unsigned long portalMaxStallMs = 0;    // Mayor tiempo entre iteraciones con el portal abierto
+unsigned long loopStallCount = 0;      // Iteraciones que superaron LOOP_STALL_WARN_MS
 volatile bool isProcessingCommand = false;
 unsigned long lastCommandTime = 0;
 String lastProcessedCommand = "";
+CommandTracer commandTracer;           // Acuses y latencia por etapa de los comandos (dropster/<id>/ack)
+unsigned long mqttPollUs = 0;          // Inicio de la llamada actual a mqttClient.loop() (µs)
+unsigned long mqttPrevPollUs = 0;      // Inicio de la llamada anterior
+MemProfiler memProfiler;               // Heap retenido por subsistema (mem_profile.h)
+MemTrend memTrend;                     // Mínimos de heap por intervalo, persistidos entre arranques
+TaskHandle_t memLoopTask = NULL;       // Tarea del loop: solo sus asignaciones se atribuyen
+SafetySupervisor safety;               // Límites con período fijo, independiente del loop
+portMUX_TYPE safetyMux = portMUX_INITIALIZER_UNLOCKED;  // Serializa loop y tarea del supervisor
+volatile uint32_t safetyLoopBeatMs = 0;  // Inicio de la última iteración del loop
+volatile bool safetyWatchdogActive = false;
+TaskHandle_t safetyTaskHandle = NULL;
+uint8_t memResetReason = 0;            // esp_reset_reason() de este arranque
 String configFragments[CONFIG_FRAGMENT_COUNT];
 bool fragmentsReceived[CONFIG_FRAGMENT_COUNT] = {false, false, false, false};
 unsigned long configAssembleTimeout = 0;
@@ -55,11 +94,14 @@ unsigned int wifiReconnectCount = 0;
 unsigned long lastSensorRecoveryCheck = 0;
 String mqttBroker = MQTT_BROKER;
 int mqttPort = MQTT_PORT;
+String mqttDeviceId = "";                            // Id estable del equipo (NVS o MAC), ver mqtt_topics.h
+bool mqttLegacyTopics = MQTT_LEGACY_TOPICS_DEFAULT;  // Tópicos planos dropster/<hoja> (compatibilidad)
+MqttTopics mqttTopics;                               // Se arman en loadMqttConfig()
 
 // Modos de operación
-enum OperationMode { MODE_MANUAL = 0, MODE_AUTO_PID = 1, MODE_AUTO_TIME = 2 };
+enum OperationMode { MODE_MANUAL = 0, MODE_AUTO_PID = 1, MODE_AUTO_TIME = 2, MODE_AUTO_ADAPTIVE = 3 };
 OperationMode operationMode = MODE_MANUAL;
-enum SelectedAutoMode { AUTO_MODE_PID = 0, AUTO_MODE_TIME = 1 };
+enum SelectedAutoMode { AUTO_MODE_PID = 0, AUTO_MODE_TIME = 1, AUTO_MODE_ADAPTIVE = 2 };
 SelectedAutoMode selectedAutoMode = AUTO_MODE_TIME;
 bool forceStartOnModeSwitch = false;
 
@@ -70,6 +112,9 @@ int control_max_on = CONTROL_MAX_ON_DEFAULT;
 int control_sampling = CONTROL_SAMPLING_DEFAULT;
 float control_alpha = CONTROL_ALPHA_DEFAULT;
 
+// Control adaptativo: ajusta umbrales para maximizar litros por kWh
+AdaptiveController adaptiveController;
+
 // Configuración de alertas
 struct AlertConfig {
   bool enabled;
@@ -107,6 +152,32 @@ int timeModeCompressorOffTime = TIME_MODE_COMPRESSOR_OFF_TIME_DEFAULT;  // Tiemp
 unsigned long timeModeCycleStart = 0; // Timestamp de inicio del ciclo actual en modo tiempo
 bool timeModeCompressorState = false; // Estado deseado del compresor en modo tiempo
 
+// Planificación horaria del modo tiempo según humedad y rendimiento por hora del día
+DutyScheduler dutyScheduler;
+bool dutySchedulerEnabled = true;          // Con RTC y perfil suficiente; si no, ciclo fijo
+float dutyBudgetHours = DUTY_BUDGET_HOURS_DEFAULT;  // Horas de compresor por día
+unsigned long lastDutySample = 0;           // Último muestreo del planificador (ms)
+
+// Nivel del tanque filtrado y tasa de producción
+LevelEstimator levelEstimator;
+unsigned long lastLevelEstimate = 0;        // Última propagación del estimador (ms)
+
+// Agregados por minuto, hora y día (tablas de tamaño fijo)
+RollupEngine rollupEngine;
+unsigned long lastRollupSave = 0;           // Último guardado de los intervalos abiertos (ms)
+
+// Gestión de energía entre trabajos periódicos
+PowerManager powerManager;
+bool powerSaveEnabled = true;               // Sueño ligero, DFS y modem sleep
+bool powerPmActive = false;                 // esp_pm_configure aceptado (si no, setCpuFrequencyMhz)
+bool powerLightSleep = false;               // El firmware permite sueño ligero automático
+esp_pm_lock_handle_t powerCpuLock = nullptr;    // CPU a la frecuencia del gobernador mientras el loop trabaja
+esp_pm_lock_handle_t powerAwakeLock = nullptr;  // Impide el sueño ligero (portal, pantalla, comandos)
+bool powerCpuLockHeld = false;
+bool powerAwakeLockHeld = false;
+unsigned long powerLoopStartUs = 0;         // Inicio de la parte ocupada de la iteración (µs)
+unsigned long lastSerialActivity = 0;       // Último byte recibido por Serial o Serial1 (ms)
+
 // Control de timing del compresor
 unsigned long compressorOnStart = 0;   // Timestamp cuando se encendió el compresor
 unsigned long compressorOffStart = 0;  // Timestamp cuando se apagó el compresor
@@ -140,6 +211,8 @@ unsigned long lastWiFiCheck = 0;                            // Última verificac
 unsigned long lastMqttAttempt = 0;                          // Último intento de reconexión MQTT
 unsigned long lastMqttPing = 0;                             // Último ping MQTT para mantener conexión
 unsigned long mqttReconnectBackoff = MQTT_RECONNECT_DELAY;  // Backoff para reconexión MQTT
+unsigned int mqttReconnectStreak = 0;                       // Intentos desde la última sesión estable
+unsigned long mqttSessionStart = 0;                         // Inicio de la sesión MQTT actual
 
 // Variables para rastrear últimos estados enviados al display (para envío eficiente)
 static bool lastSentCompOn = false;
@@ -156,17 +229,33 @@ float compressorMaxCurrent = 0.0f;              // Corriente máxima medida dura
 unsigned long compressorRetryDelayStart = 0;    // Timestamp de inicio del retraso de reintento
 bool compressorTempProtectionActive = false;    // Flag de protección por temperatura activa
 
+// Firmware de la pantalla ("DISPLAY_FW <versión>" al arrancar; vacío si no lo informó)
+String displayFirmwareVersion = "";
+
 // 4. DECLARACIONES ANTICIPADAS DE FUNCIONES
 // Configuración del sistema
 void setupWiFi();
 void setupMQTT();
 void connectMQTT();
 void reconnectSystem();
+void startCustomConfigPortal();
+void serviceConfigPortal();
 void loadMqttConfig();
+void reconnectWithNewTopics();
 void loadAlertConfig();
 void loadSystemStats();
 void saveSystemStats();
 void saveAlertConfig();
+void loadAdaptiveState();
+void saveAdaptiveState();
+void loadDutyProfile();
+void saveDutyProfile();
+void loadRollups();
+void saveRollups(uint8_t tables);
+void setupPower();
+void applyPowerConfig();
+void powerLoopBegin();
+void managePower();
 void saveWiFiCredentials(String ssid, String password);
 bool loadWiFiCredentials(String& ssid, String& password);
 
@@ -175,6 +264,32 @@ void onMqttMessage(char* topic, byte* payload, unsigned int length);
 void awgLog(int level, const String& message);
 String getSystemStateJSON();
 
+// Actualización de firmware (OTA)
+bool otaActive();
+bool otaDisplayRelayActive();
+void otaBootCheck();
+void otaService();
+void otaCommand(const String& raw);
+void otaHandleChunk(const uint8_t* payload, unsigned int length);
+void otaDisplayReported(const String& version);
+void otaRollback(const char* reason);
+
+// Perfil de memoria
+void memInit();
+void memService();
+void memReport(bool full);
+void memReportTrend();
+void memResetStats();
+
+// Supervisor de seguridad
+void safetyInit();
+void safetyPublishSample();
+void safetyService();
+void safetyReport();
+bool safetyCompressorAllowed();
+bool safetyPumpAllowed();
+bool startCompressorRelay();
+
 // Control de actuadores
 void setVentiladorState(bool newState);
 void setCompressorFanState(bool newState);
@@ -186,6 +301,7 @@ void handleCompressorProtection();
 void sendAlert(String type, String message, float value);
 void checkAlerts();
 bool ensureMqttConnected(); // Función helper para asegurar conexión MQTT
+unsigned long mqttBackoffFor(unsigned int streak);
 void initRelays();          // Función para inicializar pines de relés
 
 // Funciones helper para logs comunes
@@ -251,7 +367,7 @@ void sendAlert(String type, String message, float value) {
   char buffer[200];
   size_t len = serializeJson(doc, buffer, sizeof(buffer));
   if (len > 0) {
-    mqttClient.publish(MQTT_TOPIC_ALERTS, buffer, true);  // QoS 1 para asegurar entrega
+    mqttClient.publish(mqttTopics.alerts, buffer, true);  // QoS 1 para asegurar entrega
     mqttClient.loop();  // Procesar MQTT para asegurar envío inmediato
   } else {
     logError( "Error al serializar JSON de alerta: " + type);
@@ -266,7 +382,7 @@ void publishImmediateUpdate(const char* key, int value) {
   char buffer[20];
   size_t len = serializeJson(doc, buffer, sizeof(buffer));
   if (len > 0 && len < sizeof(buffer)) {
-    mqttClient.publish(MQTT_TOPIC_DATA, buffer, false);
+    mqttClient.publish(mqttTopics.data, buffer, false);
   }
 }
 
@@ -283,8 +399,10 @@ void publishState() {
    if (operationMode == MODE_MANUAL) modeStr = "MANUAL";
    else modeStr = "AUTO";  // Mostrar simplemente "AUTO" para ambos modos automáticos
 
-   // Enviar por UART al display solo si cambió (envío eficiente)
-   if (compOn != lastSentCompOn) {
+   // Enviar por UART al display solo si cambió (envío eficiente). Durante el relevo OTA la
+   // UART lleva tramas de firmware: los cambios se envían al terminar
+   bool uartFree = !otaDisplayRelayActive();
+   if (uartFree && compOn != lastSentCompOn) {
      String compMsg = String("COMP:") + (compOn ? "ON" : "OFF");
      if (Serial1.availableForWrite() >= compMsg.length() + 1) {
        Serial1.println(compMsg);
@@ -293,7 +411,7 @@ void publishState() {
        logWarning("⚠️ Buffer UART lleno - COMP no enviado");
      }
    }
-   if (ventOn != lastSentVentOn) {
+   if (uartFree && ventOn != lastSentVentOn) {
      String ventMsg = String("VENT:") + (ventOn ? "ON" : "OFF");
      if (Serial1.availableForWrite() >= ventMsg.length() + 1) {
        Serial1.println(ventMsg);
@@ -302,7 +420,7 @@ void publishState() {
        logWarning("⚠️ Buffer UART lleno - VENT no enviado");
      }
    }
-   if (compFanOn != lastSentCompFanOn) {
+   if (uartFree && compFanOn != lastSentCompFanOn) {
      String cfanMsg = String("CFAN:") + (compFanOn ? "ON" : "OFF");
      if (Serial1.availableForWrite() >= cfanMsg.length() + 1) {
        Serial1.println(cfanMsg);
@@ -311,7 +429,7 @@ void publishState() {
        logWarning("⚠️ Buffer UART lleno - CFAN no enviado");
      }
    }
-   if (pumpOn != lastSentPumpOn) {
+   if (uartFree && pumpOn != lastSentPumpOn) {
      String pumpMsg = String("PUMP:") + (pumpOn ? "ON" : "OFF");
      if (Serial1.availableForWrite() >= pumpMsg.length() + 1) {
        Serial1.println(pumpMsg);
@@ -320,7 +438,7 @@ void publishState() {
        logWarning("⚠️ Buffer UART lleno - PUMP no enviado");
      }
    }
-   if (modeStr != lastSentMode) {
+   if (uartFree && modeStr != lastSentMode) {
      String modeMsg = String("MODE:") + modeStr;
      if (Serial1.availableForWrite() >= modeMsg.length() + 1) {
        Serial1.println(modeMsg);
@@ -341,24 +459,35 @@ void publishState() {
      char statusBuffer[200];
      size_t statusLen = serializeJson(statusDoc, statusBuffer, sizeof(statusBuffer));
      if (statusLen > 0 && statusLen < sizeof(statusBuffer)) {
-       mqttClient.publish(MQTT_TOPIC_STATUS, statusBuffer, true);  // QoS 1, retained
+       mqttClient.publish(mqttTopics.status, statusBuffer, true);  // QoS 1, retained
        logDebug( "📊 Estado actuadores publicado: " + String(statusBuffer));
      }
    }
 }
 
-// Función helper para asegurar conexión MQTT
+// Indica si se puede publicar. No reconecta: de eso se encarga loop() respetando el backoff
+// (reconectar desde cada publicación intentaba conectar cada 2 s con el broker caído)
 bool ensureMqttConnected() {
-  if (WiFi.status() != WL_CONNECTED) {
-    logWarning( "WiFi no conectado - no se puede asegurar MQTT");
-    return false;
-  }
-  if (!mqttClient.connected()) {
-    logInfo("MQTT desconectado - intentando reconectar...");
-    connectMQTT();
-    return mqttClient.connected();
+  if (WiFi.status() != WL_CONNECTED) return false;
+  return mqttClient.connected();
+}
+
+// Espera antes del siguiente intento: 3/6/12 s los primeros, luego 24 s duplicando hasta
+// MQTT_MAX_BACKOFF. Siempre con jitter para que una flota no reintente sincronizada
+unsigned long mqttBackoffFor(unsigned int streak) {
+  unsigned long base;
+  if (streak <= 3) {
+    base = MQTT_RECONNECT_DELAY;
+  } else if (streak <= 7) {
+    base = MQTT_RECONNECT_DELAY * 2;
+  } else if (streak <= 12) {
+    base = MQTT_RECONNECT_DELAY * 4;
+  } else {
+    unsigned int doublings = min(streak - 13, 8U);
+    base = min((unsigned long)MQTT_RECONNECT_DELAY * 8UL << doublings, MQTT_MAX_BACKOFF);
   }
-  return true;
+  unsigned long jitter = random(0, base * MQTT_BACKOFF_JITTER_PCT / 100 + 1);
+  return min(base + jitter, MQTT_MAX_BACKOFF);
 }
 
 // Función para inicializar pines de relés
@@ -401,6 +530,54 @@ void logWiFiConnected() {
   logInfo("✅ WiFi CONECTADO! IP: " + WiFi.localIP().toString());
 }
 
+// Acuse de un comando con id de correlación (QoS 0, no retenido: el cliente lo espera en línea)
+void publishCommandAck(const CommandAck& ack) {
+  if (!mqttClient.connected()) return;
+  char buffer[CMD_ACK_MAX];
+  if (ack.toJson(buffer, sizeof(buffer)) > 0) {
+    mqttClient.publish(mqttTopics.ack, buffer, false);
+  }
+}
+
+// Marca entrada y salida de processCommand() para el trazador: cubre todos los retornos
+struct CommandTraceScope {
+  CommandTraceScope() { commandTracer.begin(micros()); }
+  ~CommandTraceScope() {
+    CommandAck ack;
+    if (commandTracer.end(micros(), millis(), &ack)) publishCommandAck(ack);
+  }
+};
+
+// Heap retenido por un subsistema mientras dura el bloque. Fuera de la tarea del loop (la
+// descarga OTA también escribe logs) no cuenta: la pila de entradas es de una sola tarea
+struct MemScope {
+  bool active;
+  explicit MemScope(uint8_t subsystem) : active(xTaskGetCurrentTaskHandle() == memLoopTask) {
+    if (active) memProfiler.enter(subsystem, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+  }
+  ~MemScope() {
+    if (active) memProfiler.leave(heap_caps_get_free_size(MALLOC_CAP_8BIT));
+  }
+};
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+// Ganchos del heap del SDK (solo si se compiló con CONFIG_HEAP_USE_HOOKS): asignaciones y
+// bytes pedidos por subsistema. Corren en cualquier tarea o interrupción y con el heap
+// tomado: solo suman contadores
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  (void)ptr;
+  (void)caps;
+  bool loopTask = !xPortInIsrContext() && xTaskGetCurrentTaskHandle() == memLoopTask;
+  memProfiler.onAlloc(loopTask ? memProfiler.current() : MEM_SYS_OTHER, (uint32_t)size);
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void* ptr) {
+  (void)ptr;
+  bool loopTask = !xPortInIsrContext() && xTaskGetCurrentTaskHandle() == memLoopTask;
+  memProfiler.onFree(loopTask ? memProfiler.current() : MEM_SYS_OTHER);
+}
+#endif
+
 // 6. GESTIÓN DE SENSORES - CLASE AWGSensorManager
 class AWGSensorManager {
 private:
@@ -418,6 +595,10 @@ private:
     float distance = 0;
     float voltage = 0, current = 0, power = 0, energy = 0;
     float dewPoint = 0, absHumidity = 0, waterVolume = 0;
+    float productionRate = NAN, volumeStdDev = NAN;  // Tasa de producción (L/h) e incertidumbre del volumen (L)
+    float wetBulb = 0, vaporPressure = 0, enthalpy = 0;
+    PsyStatus psyStatus = PSY_INVALID_INPUT;
+    uint32_t secondOfDay = 0, day = 0;  // Hora local del RTC (segundos desde medianoche, días desde epoch)
     float compressorTemp = 0;
     int compressorState = 0;
     int ventiladorState = 0;
@@ -529,16 +710,33 @@ private:
     timeModeCompressorOnTime = preferences.getInt("timeModeOnTime", timeModeCompressorOnTime);
     timeModeCompressorOffTime = preferences.getInt("timeModeOffTime", timeModeCompressorOffTime);
 
+    // Cargar planificación horaria del modo tiempo (presupuesto y ventanas de tarifa)
+    dutySchedulerEnabled = preferences.getBool("dutySched", dutySchedulerEnabled);
+    powerSaveEnabled = preferences.getBool("powerSave", powerSaveEnabled);
+    dutyBudgetHours = preferences.getFloat("dutyBudget", dutyBudgetHours);
+    dutyScheduler.setBudgetHours(dutyBudgetHours);
+    for (int i = 0; i < DUTY_TARIFF_SLOTS; i++) {
+      char keyStart[12], keyEnd[12], keyWeight[12];
+      snprintf(keyStart, sizeof(keyStart), "tarStart%d", i);
+      snprintf(keyEnd, sizeof(keyEnd), "tarEnd%d", i);
+      snprintf(keyWeight, sizeof(keyWeight), "tarWeight%d", i);
+      dutyScheduler.setTariff(i, preferences.getUChar(keyStart, 0), preferences.getUChar(keyEnd, 0), preferences.getFloat(keyWeight, 0.0f));
+    }
+
     // Cargar modo automático seleccionado
     int savedSelectedMode = preferences.getInt("selectedAutoMode", (int)selectedAutoMode);
-    selectedAutoMode = (savedSelectedMode == AUTO_MODE_TIME) ? AUTO_MODE_TIME : AUTO_MODE_PID;
+    if (savedSelectedMode == AUTO_MODE_TIME) selectedAutoMode = AUTO_MODE_TIME;
+    else if (savedSelectedMode == AUTO_MODE_ADAPTIVE) selectedAutoMode = AUTO_MODE_ADAPTIVE;
+    else selectedAutoMode = AUTO_MODE_PID;
 
-    // Cargar modo guardado (0=MANUAL,1=AUTO_PID,2=AUTO_TIME)
+    // Cargar modo guardado (0=MANUAL,1=AUTO_PID,2=AUTO_TIME,3=AUTO_ADAPTIVE)
     int storedMode = preferences.getInt("mode", (int)operationMode);
     if (storedMode == MODE_AUTO_PID) {
       operationMode = MODE_AUTO_PID;
     } else if (storedMode == MODE_AUTO_TIME) {
       operationMode = MODE_AUTO_TIME;
+    } else if (storedMode == MODE_AUTO_ADAPTIVE) {
+      operationMode = MODE_AUTO_ADAPTIVE;
     } else {
       operationMode = MODE_MANUAL;
     }
@@ -581,6 +779,7 @@ private:
   }
 
   void saveCalibration() {
+    levelEstimator.reset();  // La curva pudo cambiar: el volumen filtrado deja de ser comparable
     // Guardar configuración principal
     preferences.begin("awg-config", false);
     preferences.putFloat("offset", sensorOffset);
@@ -677,6 +876,16 @@ public:
     return (waterPercent >= alertTankFull.threshold);
   }
 
+  // Muestra para el supervisor de seguridad, con los mismos criterios de validez que el loop
+  SafetySample safetySample() {
+    SafetySample sample;
+    sample.atMs = millis();
+    sample.compressorTemp = data.compressorTemp > 0 ? data.compressorTemp : NAN;  // Como checkAlerts()
+    sample.tankPercent = (isCalibrated && !isnan(data.waterVolume)) ? calculateWaterPercent(data.distance, data.waterVolume) : NAN;
+    sample.waterLiters = data.waterVolume;
+    return sample;
+  }
+
   // Función de monitoreo automático de estado de sensores (simplificada)
   void monitorSensorStatus() {
     // Verificar estado actual de cada sensor
@@ -808,6 +1017,8 @@ public:
   void readSensors() {
     if (rtcOnline) {      // Obtener timestamp si RTC está disponible
       DateTime now = rtc.now();
+      data.secondOfDay = (uint32_t)now.hour() * 3600UL + (uint32_t)now.minute() * 60UL + now.second();
+      data.day = now.unixtime() / 86400UL;
       data.timestamp = String(now.year()) + "-" + String(now.month()) + "-" + String(now.day()) + " " + String(now.hour()) + ":" + String(now.minute()) + ":" + String(now.second());
     } else {
       data.timestamp = "00-00-00 00:00:00";
@@ -843,14 +1054,15 @@ public:
         data.sht1Hum = NAN;
       }
 
-    // Sensor ultrasónico con promediado y manejo de errores
-    float rawDistance = getAverageDistance(5);
+    // Sensor ultrasónico: mediana de pocos pings, el estimador de nivel filtra el volumen
+    float rawDistance = getMedianDistance(LEVEL_PINGS_PER_ESTIMATE);
     if (rawDistance >= 0) {
-      data.distance = getSmoothedDistance(5);
+      data.distance = smoothDistance(rawDistance);
       lastValidDistance = rawDistance;
     } else {
       data.distance = lastValidDistance;
     }
+    updateLevelEstimate(rawDistance);  // Antes de releer los relés: su estado previo rigió el intervalo
 
     // Leer PZEM si está disponible o intentar detectar periódicamente
     if (pzemOnline && millis() - lastPZEMRead > 2000) {
@@ -954,9 +1166,13 @@ public:
     data.pumpState = digitalRead(PUMP_RELAY_PIN) == LOW ? 1 : 0;
 
     // Cálculos
-    data.dewPoint = calculateDewPoint(data.bmeTemp, data.bmeHum);
-    data.absHumidity = calculateAbsoluteHumidity(data.bmeTemp, data.bmeHum, data.bmePres);
-    data.waterVolume = calculateWaterVolume(data.distance);
+    PsyState psy = psyCompute(data.bmeTemp, data.bmeHum, data.bmePres);
+    data.psyStatus = psy.status;
+    data.dewPoint = psy.dewPoint;  // NAN si la lectura del BME280 no es válida
+    data.absHumidity = psy.absHumidity;
+    data.wetBulb = psy.wetBulb;
+    data.vaporPressure = psy.vaporPressure;
+    data.enthalpy = psy.enthalpy;
     this->checkAlerts();  // Verificar alertas
   }
 
@@ -999,7 +1215,61 @@ public:
     return sum / validSamples;  // Media simple
   }
 
+  // Mediana de las lecturas válidas: descarta ecos sueltos con menos pings que el promedio
+  float getMedianDistance(int samples) {
+    const int maxSamples = 7;
+    if (samples > maxSamples) samples = maxSamples;
+    float readings[maxSamples];
+    int validSamples = 0;
+
+    for (int i = 0; i < samples; i++) {
+      float distance = getDistance();
+      if (distance >= 0) {
+        int j = validSamples++;
+        for (; j > 0 && readings[j - 1] > distance; j--) readings[j] = readings[j - 1];  // Inserción ordenada
+        readings[j] = distance;
+      }
+      if (i < samples - 1) delay(60);
+    }
+    if (validSamples == 0) return -1.0;
+    if (validSamples % 2 == 1) return readings[validSamples / 2];
+    return 0.5f * (readings[validSamples / 2 - 1] + readings[validSamples / 2]);
+  }
+
+  // Propaga el estimador con los relés como entradas y corrige con la medición si la hay
+  void updateLevelEstimate(float rawDistance) {
+    if (!(isCalibrated && numCalibrationPoints >= 2)) {
+      data.waterVolume = calculateWaterVolume(data.distance);
+      data.productionRate = NAN;
+      data.volumeStdDev = NAN;
+      return;
+    }
+
+    unsigned long now = millis();
+    if (lastLevelEstimate != 0) {
+      levelEstimator.predict((now - lastLevelEstimate) / 1000.0f, data.compressorState == 1, data.pumpState == 1);
+    }
+    lastLevelEstimate = now;
+    if (rawDistance >= 0) {
+      // Varianza de la medición: ruido en distancia por la pendiente local de la curva (L/cm)
+      float slope = fabsf(calculateWaterVolume(rawDistance + 0.5f) - calculateWaterVolume(rawDistance - 0.5f));
+      float sigma = slope * LEVEL_DISTANCE_SIGMA_CM;
+      levelEstimator.update(calculateWaterVolume(rawDistance), sigma * sigma);
+    }
+
+    if (levelEstimator.initialized()) {
+      data.waterVolume = levelEstimator.volume();
+      data.productionRate = levelEstimator.rate();
+      data.volumeStdDev = levelEstimator.volumeStdDev();
+    } else {
+      data.waterVolume = calculateWaterVolume(data.distance);
+      data.productionRate = NAN;
+      data.volumeStdDev = NAN;
+    }
+  }
+
   void transmitData() {
+      if (otaDisplayRelayActive()) return;  // UART ocupada por el relevo OTA
       // Asegurar que los valores críticos nunca sean negativos para las gráficas
       float safeWaterVolume = max(WATER_VOLUME_MIN, data.waterVolume);  // Agua nunca negativa
       float safeEnergy = max(WATER_VOLUME_MIN, data.energy);            // Energía nunca negativa
@@ -1008,7 +1278,9 @@ public:
       float waterPercent = calculateWaterPercent(data.distance, safeWaterVolume);
       int len = snprintf(txBuffer, sizeof(txBuffer),
                          "%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d,%d,%d,%.2f\n",
-                         data.bmeTemp, data.bmePres, data.bmeHum, data.absHumidity, data.dewPoint,
+                         data.bmeTemp, data.bmePres, data.bmeHum,
+                         isnan(data.absHumidity) ? 0.0f : data.absHumidity,
+                         isnan(data.dewPoint) ? 0.0f : data.dewPoint,
                          data.sht1Temp, data.sht1Hum, data.compressorTemp,
                          maxCompressorTemp, data.voltage, data.current, data.power, safeEnergy,
                          data.compressorState, data.ventiladorState, data.compressorFanState, data.pumpState,
@@ -1023,6 +1295,69 @@ public:
       }
   }
 
+  // Agregados por minuto/hora/día; sin RTC los intervalos no pueden alinearse
+  void updateRollups() {
+    if (!rtcOnline) return;
+    RollupSample s;
+    s.values[ROLLUP_TEMP] = bmeOnline ? data.bmeTemp : NAN;
+    s.values[ROLLUP_HUM] = bmeOnline ? data.bmeHum : NAN;
+    s.values[ROLLUP_ABS_HUM] = data.absHumidity;
+    s.values[ROLLUP_VOLUME] = (isCalibrated && numCalibrationPoints >= 2) ? data.waterVolume : NAN;
+    s.values[ROLLUP_POWER] = pzemOnline ? data.power : NAN;
+    s.energyKWh = pzemOnline ? data.energy : NAN;
+    s.productionRate = data.productionRate;
+    s.compressorOn = (data.compressorState == 1);
+    uint8_t closed = rollupEngine.sample(data.day * 86400UL + data.secondOfDay, s);
+
+    for (uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+      if (closed & (1 << level)) publishRollup(level, *rollupEngine.latest(level), "live", 0, 0);
+    }
+    // Horas y días se guardan al cerrarse; los intervalos abiertos, cada ROLLUP_SAVE_INTERVAL
+    uint8_t tables = closed & ((1 << ROLLUP_HOUR) | (1 << ROLLUP_DAY));
+    if (tables || millis() - lastRollupSave >= ROLLUP_SAVE_INTERVAL) {
+      saveRollups(tables);
+      lastRollupSave = millis();
+    }
+  }
+
+  // Publica un intervalo en el tópico rollup. total > 0 indica respuesta a STATS_QUERY
+  void publishRollup(uint8_t level, const RollupRecord& r, const char* source, int index, int total) {
+    if (!mqttClient.connected()) return;
+    StaticJsonDocument<ROLLUP_JSON_SIZE> doc;
+    doc["lvl"] = ROLLUP_LEVEL_NAME[level];
+    doc["src"] = source;
+    if (total > 0) {
+      doc["qi"] = index;
+      doc["qn"] = total;
+    }
+    doc["ts"] = r.start;
+    doc["n"] = r.samples;
+    doc["duty"] = roundf(r.duty / 10.0f) / 1000.0f;       // Fracción con compresor encendido
+    doc["e"] = roundf(r.energyKWh * 1000.0f) / 1000.0f;   // Energía del intervalo (kWh)
+    doc["wp"] = roundf(r.waterL * 1000.0f) / 1000.0f;     // Agua producida (L)
+    for (uint8_t m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+      if (r.meanV[m] == ROLLUP_NO_VALUE) continue;
+      JsonArray stats = doc.createNestedArray(ROLLUP_METRIC_KEY[m]);  // [mín, máx, media, último]
+      stats.add(rollupDecode(r.minV[m], m));
+      stats.add(rollupDecode(r.maxV[m], m));
+      stats.add(rollupDecode(r.meanV[m], m));
+      stats.add(rollupDecode(r.lastV[m], m));
+    }
+    size_t len = serializeJson(doc, mqttBuffer, sizeof(mqttBuffer));
+    if (len > 0 && len < sizeof(mqttBuffer)) {
+      mqttClient.publish(mqttTopics.rollup, mqttBuffer, false);
+    }
+  }
+
+  void printRollupRecord(const RollupRecord& r, bool open) {
+    DateTime start(r.start);
+    Serial.printf("  %04d-%02d-%02d %02d:%02d%s %5u %6.1f%% %7.3f %7.3f %7.2f %7.2f %7.2f\n",
+                  start.year(), start.month(), start.day(), start.hour(), start.minute(), open ? "*" : " ",
+                  r.samples, r.duty / 100.0f, r.energyKWh, r.waterL,
+                  rollupDecode(r.meanV[ROLLUP_TEMP], ROLLUP_TEMP), rollupDecode(r.meanV[ROLLUP_HUM], ROLLUP_HUM),
+                  rollupDecode(r.lastV[ROLLUP_VOLUME], ROLLUP_VOLUME));
+  }
+
   void transmitMQTTData() {
     if (!ensureMqttConnected()) {
       return;
@@ -1048,6 +1383,10 @@ public:
       doc["p"] = floatToString2Decimals(data.bmePres);  // presion atmosferica ambiente
     }
     doc["w"] = floatToString2Decimals(safeWaterVolume);  // Agua almacenada
+    if (!isnan(data.productionRate)) {
+      doc["wr"] = floatToString2Decimals(max(0.0f, data.productionRate));  // Tasa de producción (L/h)
+      doc["wu"] = floatToString2Decimals(data.volumeStdDev);               // Incertidumbre del volumen (L, 1σ)
+    }
 
     if (sht1Online) {
       doc["te"] = floatToString2Decimals(data.sht1Temp);  // Temperatura del evaporador
@@ -1055,8 +1394,8 @@ public:
     }
 
     doc["tc"] = floatToString2Decimals(data.compressorTemp);
-    doc["dp"] = floatToString2Decimals(data.dewPoint);
-    doc["ha"] = floatToString2Decimals(data.absHumidity);
+    if (!isnan(data.dewPoint)) doc["dp"] = floatToString2Decimals(data.dewPoint);
+    if (!isnan(data.absHumidity)) doc["ha"] = floatToString2Decimals(data.absHumidity);
 
     if (pzemOnline) {
       if (data.voltage > 0) doc["v"] = floatToString2Decimals(data.voltage);
@@ -1068,7 +1407,7 @@ public:
     // Información de conectividad MQTT para la pantalla de conectividad de la app
     doc["mqtt_broker"] = mqttBroker;
     doc["mqtt_port"] = mqttPort;
-    doc["mqtt_topic"] = MQTT_TOPIC_DATA;
+    doc["mqtt_topic"] = (const char*)mqttTopics.data;  // Puntero: el tópico vive en mqttTopics
     doc["mqtt_connected"] = true;         // Si estamos transmitiendo, estamos conectados
     doc["tank_capacity"] = floatToString2Decimals(tankCapacityLiters);
 
@@ -1081,7 +1420,7 @@ public:
     size_t jsonSize = serializeJson(doc, mqttBuffer, sizeof(mqttBuffer));
 
     if (jsonSize > 0 && jsonSize < sizeof(mqttBuffer)) {
-      mqttClient.publish(MQTT_TOPIC_DATA, mqttBuffer, true);  // QoS 1 para asegurar entrega
+      mqttClient.publish(mqttTopics.data, mqttBuffer, true);  // QoS 1 para asegurar entrega
     }
   }
 
@@ -1158,12 +1497,8 @@ public:
     }
   }
 
-  float getSmoothedDistance(int samples) {
-    float rawDistance = getAverageDistance(samples);
-    if (rawDistance < 0) {
-      return smoothedDistance;  // Devolver último valor válido
-    }
-
+  // Suavizado de la distancia mostrada (porcentaje); el volumen lo filtra el estimador de nivel
+  float smoothDistance(float rawDistance) {
     if (firstDistanceReading) {
       smoothedDistance = rawDistance;
       firstDistanceReading = false;
@@ -1217,6 +1552,7 @@ public:
   }
 
   void handleCommands() {
+    if (otaDisplayRelayActive()) return;  // otaDisplayService() lee Serial1 durante el relevo
     // Buffer ampliado para comandos provenientes del UART1 (pantalla) - ahora 1024 bytes para JSON completo
     static char cmdBuf1[1024];
     static size_t cmdIdx1 = 0;
@@ -1224,6 +1560,7 @@ public:
       char c = (char)Serial1.read();
       // Registrar actividad de pantalla y encender backlight si está apagado
       lastScreenActivity = millis();
+      lastSerialActivity = lastScreenActivity;
       if (!backlightOn) {
         digitalWrite(BACKLIGHT_PIN, HIGH);
         backlightOn = true;
@@ -1253,6 +1590,7 @@ public:
     static size_t cmdIdx0 = 0;
     while (Serial.available()) {
       char c = (char)Serial.read();
+      lastSerialActivity = millis();
       if (c == '\n') {
         cmdBuf0[cmdIdx0] = '\0';
         if (cmdIdx0 > 0) {
@@ -1313,21 +1651,8 @@ public:
   return (hum >= WATER_PERCENT_MIN && hum <= WATER_PERCENT_MAX) ? hum : 0.0;
   }
 
-  float calculateDewPoint(float temp, float hum) {
-    const float a = 17.62, b = 243.12;
-    float factor = log(hum / 100.0) + (a * temp) / (b + temp);
-    return (b * factor) / (a - factor);
-  }
-
-  float calculateAbsoluteHumidity(float temp, float hum, float pres) {
-    float presPa = pres * 100.0;
-    float Pws = A_MAGNUS * exp((L / Rv) * (1.0 / ZERO_CELSIUS - 1.0 / (temp + ZERO_CELSIUS)));
-    float Pw = (hum / 100.0) * Pws;
-    float mixRatio = 0.622 * (Pw / (presPa - Pw));
-    return (mixRatio * presPa * 1000.0) / (Rv * (temp + ZERO_CELSIUS));
-  }
-
   void processUnifiedConfig(String jsonPayload) {
+    MemScope memScope(MEM_SYS_JSON);
     // Verificar que el JSON esté completo (debe terminar con '}')
     if (!jsonPayload.endsWith("}")) {
       logError( "JSON incompleto - no termina con '}' - Longitud: " + String(jsonPayload.length()));
@@ -1373,6 +1698,7 @@ public:
         preferences.begin("awg-mqtt", false);
         preferences.putString("broker", newBroker);
         preferences.putInt("port", newPort);
+        preferences.putBool("legacy", mqttLegacyTopics);  // Ver loadMqttConfig()
         preferences.end();
         mqttBroker = newBroker;
         mqttPort = newPort;
@@ -1678,8 +2004,6 @@ public:
       // Publicar estado de conexión actualizado
       if (mqttClient.connected()) {
         logDebug( "✅ Reconexión MQTT exitosa - Broker actual: " + mqttBroker + ":" + String(mqttPort));
-        mqttClient.publish(MQTT_TOPIC_SYSTEM, "AWG_ONLINE", true);
-        mqttClient.subscribe(MQTT_TOPIC_CONTROL); // Re-suscribirse a los topics después de reconectar
       } else {
         logError( "Reconexión MQTT fallida - Broker configurado: " + mqttBroker + ":" + String(mqttPort));
       }
@@ -1736,7 +2060,7 @@ public:
         char ackBuffer[50];
         size_t ackLen = serializeJson(ackDoc, ackBuffer, sizeof(ackBuffer));
         if (ackLen > 0) {
-          mqttClient.publish(MQTT_TOPIC_STATUS, ackBuffer, false);
+          mqttClient.publish(mqttTopics.status, ackBuffer, false);
           logDebug( "📤 Confirmación MQTT enviada a la app");
         }
       }
@@ -1749,6 +2073,9 @@ public:
   }
 
   void processCommand(String& cmd) {
+    CommandTraceScope trace;  // Antes de cualquier retorno: consume la llegada marcada por MQTT
+    MemScope memScope(MEM_SYS_COMMAND);
+
     // Validación básica del comando
     if (cmd.length() == 0) {
       return;
@@ -1759,16 +2086,39 @@ public:
       return;
     }
 
+    // "@<cid>[:<ts>] " opcional: se quita aquí y el acuse sale al terminar, haya o no retorno
+    size_t envelope = commandTracer.takeEnvelope(cmd.c_str());
+    if (envelope > 0) {
+      cmd.remove(0, envelope);
+      if (cmd.length() == 0) {
+        commandTracer.reject(CMD_REJECT_UNKNOWN);
+        return;
+      }
+    }
+
     // IGNORAR MENSAJES DE CONFIRMACIÓN DE CONFIGURACIÓN (ACK) - SON RESPUESTAS AUTOMÁTICAS
     if (cmd.indexOf("\"type\":\"config_ack\"") != -1) {
       return;  // Salir sin procesar
     }
 
+    // OTA_* antes de pasar a minúsculas: la ruta de OTA_URL las distingue
+    if (cmd.length() > 4 && cmd.substring(0, 4).equalsIgnoreCase("ota_")) {
+      otaCommand(cmd);
+      return;
+    }
+
     cmd.toLowerCase();             // Hacer comandos case-insensitive
+    if (cmd.startsWith("display_fw ")) {
+      String version = cmd.substring(11);
+      version.trim();
+      otaDisplayReported(version);
+      return;
+    }
     unsigned long now = millis();  // Sistema de manejo de concurrencia mejorado
 
     // Verificar debounce para evitar comandos duplicados
     if (cmd == lastProcessedCommand && (now - lastCommandTime) < COMMAND_DEBOUNCE) {
+      commandTracer.reject(CMD_REJECT_DEBOUNCE);
       return;
     }
 
@@ -1776,6 +2126,7 @@ public:
     if (isProcessingCommand) {
       if (now - lastCommandTime < COMMAND_TIMEOUT) {
         logWarning( "Comando ignorado - Procesando comando crítico anterior: " + lastProcessedCommand);
+        commandTracer.reject(CMD_REJECT_LOCKED);
         return;
       } else {
         logWarning( "⏰ Timeout de comando crítico anterior, procesando nuevo comando");
@@ -1867,34 +2218,50 @@ public:
       lastProcessedCommand = cmd;
       lastCommandTime = now;
     }
+    // Libera el bloqueo en cualquier salida: los rechazos de seguridad de ON y los errores de
+    // UPDATE_CONFIG retornan antes del final y lo dejaban tomado hasta COMMAND_TIMEOUT
+    struct CommandLock {
+      bool held;
+      ~CommandLock() { if (held) isProcessingCommand = false; }
+    } commandLock = { isCriticalCommand };
+    commandTracer.dispatch(micros());
     String cmdToProcess = cmd; // Procesar el comando directamente
 
     if (cmdToProcess == "on") {
       // Verificar temperatura del compresor antes de encender
       if (data.compressorTemp >= alertCompressorTemp.threshold) {
         logError( "🚫 SEGURIDAD: Compresor NO encendido - Temperatura alta: " + String(data.compressorTemp, 1) + "°C (máx: " + String(alertCompressorTemp.threshold, 1) + "°C)");
+        commandTracer.reject(CMD_REJECT_COMPRESSOR_TEMP);
         return;
       }
       // Verificar si el tanque está lleno antes de encender
       if (this->isTankFull()) {
         float waterPercent = this->calculateWaterPercent(data.distance, data.waterVolume);
         logError( "🚫 SEGURIDAD: Compresor NO encendido - Tanque lleno: " + String(waterPercent, 1) + "% (umbral: " + String(alertTankFull.threshold, 1) + "%)");
+        commandTracer.reject(CMD_REJECT_TANK_FULL);
+        return;
+      }
+      if (!safetyCompressorAllowed()) {
+        logError( "🚫 SEGURIDAD: Compresor NO encendido - Enclavado por el supervisor (SAFETY_STATUS)");
+        commandTracer.reject(CMD_REJECT_SAFETY);
         return;
       }
       operationMode = MODE_MANUAL;
-      digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+      startCompressorRelay();
+      commandTracer.actuate(micros());
       logDebug( "Compresor ON");
       if (mqttClient.connected()) {
-        mqttClient.publish(MQTT_TOPIC_STATUS, "COMP_ON");
+        mqttClient.publish(mqttTopics.status, "COMP_ON");
       }
       publishState();
     } else if (cmdToProcess == "off") {
     compressorProtectionActive = false;  // Reset protección al apagar manualmente
       operationMode = MODE_MANUAL;
       digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
+      commandTracer.actuate(micros());
       logDebug( "Compresor OFF");
       if (mqttClient.connected()) {
-        mqttClient.publish(MQTT_TOPIC_STATUS, "COMP_OFF");
+        mqttClient.publish(mqttTopics.status, "COMP_OFF");
       }
       publishState();
     } else if (cmdToProcess == "onv") {
@@ -1918,6 +2285,10 @@ public:
       if (selectedAutoMode == AUTO_MODE_TIME) {
         operationMode = MODE_AUTO_TIME;
         logDebug( "Modo cambiado a AUTO_TIME (seleccionado)");
+      } else if (selectedAutoMode == AUTO_MODE_ADAPTIVE) {
+        operationMode = MODE_AUTO_ADAPTIVE;
+        adaptiveController.restartWindow();
+        logDebug( "Modo cambiado a AUTO_ADAPTIVE (seleccionado)");
       } else {
         operationMode = MODE_AUTO_PID;
         logDebug( "Modo cambiado a AUTO_PID (seleccionado)");
@@ -1926,13 +2297,16 @@ public:
       preferences.putInt("mode", (int)operationMode);
       preferences.end();
 
-      String modeStr = (operationMode == MODE_AUTO_TIME) ? "MODE_AUTO_TIME" : "MODE_AUTO_PID";
-      if (mqttClient.connected()) mqttClient.publish(MQTT_TOPIC_STATUS, modeStr.c_str());
+      String modeStr;
+      if (operationMode == MODE_AUTO_TIME) modeStr = "MODE_AUTO_TIME";
+      else if (operationMode == MODE_AUTO_ADAPTIVE) modeStr = "MODE_AUTO_ADAPTIVE";
+      else modeStr = "MODE_AUTO_PID";
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, modeStr.c_str());
 
       if (operationMode == MODE_AUTO_TIME) {
         // ACTIVAR AUTOMÁTICAMENTE COMPRESOR AL CAMBIAR A MODO TIEMPO (ventiladores siempre encendido)
         logDebug( "🔄 Activando automáticamente compresor para modo cíclico");
-        digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+        startCompressorRelay();
         logDebug( "Compresor ON");
         setVentiladorState(true);  // Ventilador siempre encendido en modo tiempo
         setCompressorFanState(true);  // Ventilador compresor siempre encendido en modo automático
@@ -1941,7 +2315,7 @@ public:
       } else {
         // ACTIVAR AUTOMÁTICAMENTE COMPRESOR Y VENTILADORES AL CAMBIAR A MODO PID
         logDebug( "🔄 Activando automáticamente compresor y ventiladores para control PID");
-        digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+        startCompressorRelay();
         logDebug( "Compresor ON");
         setVentiladorState(true);
         setCompressorFanState(true);  // Ventilador compresor siempre encendido en modo automático
@@ -1959,11 +2333,32 @@ public:
       preferences.putInt("selectedAutoMode", (int)selectedAutoMode);
       preferences.end();
 
-      if (mqttClient.connected()) mqttClient.publish(MQTT_TOPIC_STATUS, "MODE_AUTO_PID");
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, "MODE_AUTO_PID");
 
       // ACTIVAR AUTOMÁTICAMENTE COMPRESOR Y VENTILADORES AL CAMBIAR A MODO PID
       logDebug( "🔄 Activando automáticamente compresor y ventiladores para control PID");
-      digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+      startCompressorRelay();
+      logDebug( "Compresor ON");
+      setVentiladorState(true);
+      setCompressorFanState(true);  // Ventilador compresor siempre encendido en modo automático
+      forceStartOnModeSwitch = true;  // Forzar una evaluación inmediata del controlador (one-shot)
+
+      // Publicar estados actuales inmediatamente para sincronización
+      publishState();
+    } else if (cmdToProcess == "mode auto_adaptive" || cmdToProcess == "mode_auto_adaptive" || cmdToProcess == "mode:auto_adaptive") {
+      operationMode = MODE_AUTO_ADAPTIVE;
+      selectedAutoMode = AUTO_MODE_ADAPTIVE;
+      adaptiveController.restartWindow();  // La ventana en curso no corresponde a este modo
+      logDebug( "Modo cambiado a AUTO_ADAPTIVE");
+      preferences.begin("awg-config", false);
+      preferences.putInt("mode", (int)operationMode);
+      preferences.putInt("selectedAutoMode", (int)selectedAutoMode);
+      preferences.end();
+
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, "MODE_AUTO_ADAPTIVE");
+
+      // Mismo arranque que el modo PID: el adaptativo solo cambia los umbrales
+      startCompressorRelay();
       logDebug( "Compresor ON");
       setVentiladorState(true);
       setCompressorFanState(true);  // Ventilador compresor siempre encendido en modo automático
@@ -1980,11 +2375,11 @@ public:
       preferences.putInt("selectedAutoMode", (int)selectedAutoMode);
       preferences.end();
 
-      if (mqttClient.connected()) mqttClient.publish(MQTT_TOPIC_STATUS, "MODE_AUTO_TIME");
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, "MODE_AUTO_TIME");
 
       // ACTIVAR AUTOMÁTICAMENTE COMPRESOR AL CAMBIAR A MODO TIEMPO (ventiladores siempre encendido)
       logDebug( "🔄 Activando automáticamente compresor para modo cíclico");
-      digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+      startCompressorRelay();
       logDebug( "Compresor ON");
       setVentiladorState(true);  // Ventilador siempre encendido en modo tiempo
       setCompressorFanState(true);  // Ventilador compresor siempre encendido en modo automático
@@ -1999,7 +2394,7 @@ public:
       preferences.begin("awg-config", false);
       preferences.putInt("mode", (int)operationMode);
       preferences.end();
-      if (mqttClient.connected()) mqttClient.publish(MQTT_TOPIC_STATUS, "MODE_MANUAL");
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, "MODE_MANUAL");
       // Cancelar cualquier forceStart pendiente
       forceStartOnModeSwitch = false;
       publishState();
@@ -2041,7 +2436,7 @@ public:
         Serial1.println("SET_CTRL: ERR");
       }
 }
-       else if (cmd.startsWith("set_mqtt")) {
+       else if (cmd.startsWith("set_mqtt") && !cmd.startsWith("set_mqtt_legacy")) {
          String payload = cmd.substring(8);
          payload.trim();
          if (payload.length() > 0 && (payload[0] == ':' || payload[0] == '=' || payload[0] == ' ')) {
@@ -2068,6 +2463,7 @@ public:
          preferences.begin("awg-mqtt", false);
          preferences.putString("broker", newBroker);
          preferences.putInt("port", newPort);
+         preferences.putBool("legacy", mqttLegacyTopics);  // Ver loadMqttConfig()
          preferences.end();
          // Actualizar variables globales
          mqttBroker = newBroker;
@@ -2083,6 +2479,47 @@ public:
            logWarning( "No se reconectará a MQTT porque no hay conexión WiFi");
          }
        }
+       else if (cmd.startsWith("set_device_id")) {
+         String newId = cmd.substring(13);
+         newId.trim();
+         if (newId.length() > 0 && (newId[0] == ':' || newId[0] == '=')) newId = newId.substring(1);
+         newId.trim();
+         // "mac" borra el id provisionado y vuelve al derivado de la MAC
+         bool useMac = (newId == "mac");
+         if (!useMac && !mqttDeviceIdValid(newId.c_str())) {
+           logWarning( "SET_DEVICE_ID inválido. Uso: SET_DEVICE_ID id (1-32 caracteres a-z 0-9 _ -) o SET_DEVICE_ID MAC");
+           Serial1.println("SET_DEVICE_ID: ERR");
+           return;
+         }
+         preferences.begin("awg-mqtt", false);
+         if (useMac) {
+           preferences.remove("device_id");
+         } else {
+           preferences.putString("device_id", newId);
+         }
+         preferences.end();
+         Serial1.println("SET_DEVICE_ID: OK");
+         reconnectWithNewTopics();
+       }
+       else if (cmd.startsWith("set_mqtt_legacy")) {
+         String value = cmd.substring(15);
+         value.trim();
+         bool legacy;
+         if (value == "on" || value == "1") {
+           legacy = true;
+         } else if (value == "off" || value == "0") {
+           legacy = false;
+         } else {
+           logWarning( "SET_MQTT_LEGACY formato inválido. Uso: SET_MQTT_LEGACY ON/OFF");
+           Serial1.println("SET_MQTT_LEGACY: ERR");
+           return;
+         }
+         preferences.begin("awg-mqtt", false);
+         preferences.putBool("legacy", legacy);
+         preferences.end();
+         Serial1.println("SET_MQTT_LEGACY: OK");
+         reconnectWithNewTopics();
+       }
        else if (cmd == "test") {
        testSensor();
        }
@@ -2091,6 +2528,14 @@ public:
          totalUptime = 0;
          mqttReconnectCount = 0;
          wifiReconnectCount = 0;
+         loopMaxStallMs = 0;
+         portalMaxStallMs = 0;
+         loopStallCount = 0;
+         powerManager.resetStats();
+         memResetStats();
+         portENTER_CRITICAL(&safetyMux);
+         safety.resetStats();
+         portEXIT_CRITICAL(&safetyMux);
          saveSystemStats();
          logInfo( "✅ Estadísticas del sistema reseteadas");
        }
@@ -2256,19 +2701,7 @@ public:
     }
     else if (cmd == "wifi_config") {
       logDebug( "🔧 Comando WIFI_CONFIG recibido del display - iniciando configuración WiFi/AP");
-      portalActive = true;
-      currentLedState = LED_WHITE;    // Cambiar LED a Blanco
-      setLedColor(COLOR_WHITE_R, COLOR_WHITE_G, COLOR_WHITE_B);
-      startCustomConfigPortal();
-      setupWiFi();
-      if (WiFi.status() == WL_CONNECTED) {
-        logInfo( "🔄 WiFi conectado, configurando MQTT...");
-        setupMQTT();
-      } else {
-        logWarning( "❌ WiFi no conectado después del portal, saltando configuración MQTT");
-      }
-      portalActive = false;
-      updateLedState();       // Restaurar LED según estado actual
+      startCustomConfigPortal();  // No bloqueante: se cierra solo al guardar o por timeout
     }
     else if (cmd == "reconnect") {
       logDebug( "Comando RECONNECT recibido del display");
@@ -2364,6 +2797,18 @@ public:
       preferences.begin("awg-calib", false);
       preferences.clear();
       preferences.end();
+      // Reset control adaptativo
+      preferences.begin("awg-adapt", false);
+      preferences.clear();
+      preferences.end();
+      // Reset perfil horario del modo tiempo
+      preferences.begin("awg-duty", false);
+      preferences.clear();
+      preferences.end();
+      // Reset agregados por minuto/hora/día
+      preferences.begin("awg-rollup", false);
+      preferences.clear();
+      preferences.end();
       logInfo( "✅ Reset de fábrica completado. Reiniciando...");
       delay(1000);
       ESP.restart();
@@ -2389,6 +2834,41 @@ public:
     else if (cmd.indexOf("\"type\":\"config_ack\"") != -1) { // Ignorar mensajes de confirmación de configuración (ACK) - no procesar como comandos
       return;
     }
+    else if (cmd == "adapt_status") {
+      static const char* paramNames[ADAPT_PARAM_COUNT] = { "Offset setpoint", "Banda muerta", "Offset vent. ON", "Offset vent. OFF" };
+      Serial.println("=== CONTROL ADAPTATIVO (L/kWh) ===");
+      Serial.println("  Activo: " + String(operationMode == MODE_AUTO_ADAPTIVE ? "SI" : "NO"));
+      Serial.println("  Eficiencia: " + String(adaptiveController.efficiency(), 3) + " L/kWh");
+      Serial.println("  Ventana en curso: " + String(adaptiveController.windowEfficiency(), 3) + " L/kWh");
+      Serial.println("  Iteraciones: " + String(adaptiveController.iterations()) + "  Ventanas descartadas: " + String(adaptiveController.rejectedWindows()) +
+                     " (última: " + String(adaptiveController.lastRejectReason()) + ")");
+      for (int i = 0; i < ADAPT_PARAM_COUNT; i++) {
+        Serial.printf("  %-17s base=%.2f°C aplicado=%.2f°C%s\n", paramNames[i],
+                      adaptiveController.base((AdaptParam)i), adaptiveController.param((AdaptParam)i),
+                      adaptiveController.activeParam() == i ? (adaptiveController.perturbSign() > 0 ? "  [+]" : "  [-]") : "");
+      }
+    }
+    else if (cmd == "adapt_reset") {
+      preferences.begin("awg-adapt", false);
+      preferences.clear();
+      preferences.end();
+      loadAdaptiveState();  // Reinicia desde los parámetros del control PID
+      logInfo( "✅ Control adaptativo reiniciado desde los parámetros del modo PID");
+    }
+    else if (cmd == "power_status") {
+      Serial.println("=== GESTIÓN DE ENERGÍA ===");
+      Serial.println("  Habilitada: " + String(powerSaveEnabled ? "SI" : "NO") + "  Sueño ligero: " + String(powerLightSleep ? "SI" : "NO") +
+                     "  DFS: " + String(powerPmActive ? "SI" : "NO") + "  Despierto forzado: " + String(powerAwakeLockHeld ? "SI" : "NO"));
+      Serial.println("  CPU: " + String(ESP.getCpuFreqMHz()) + " MHz  Máximo del gobernador: " + String(powerManager.freqMhz()) +
+                     " MHz  Carga: " + String(powerManager.load() * 100.0f, 1) + "%  Cambios: " + String(powerManager.freqChanges()));
+      Serial.println("  Tiempo: ocupado " + String(powerManager.busyFraction() * 100.0f, 1) + "%  reposo " + String(powerManager.idleFraction() * 100.0f, 1) +
+                     "%  sueño ligero " + String(powerManager.sleepFraction() * 100.0f, 1) + "%");
+      Serial.println("  Corriente media estimada (ESP32): " + String(powerManager.averageCurrentMa(), 1) + " mA");
+      Serial.println("  Latencia de despertar: media " + String(powerManager.wakeLatencyAvgUs()) + " us  máx " + String(powerManager.wakeLatencyMaxUs()) +
+                     " us (" + String(powerManager.wakeCount()) + " reposos)");
+      Serial.println("  Plazos perdidos: " + String(powerManager.missedDeadlines()) + " de " + String(powerManager.jobRuns()) +
+                     " ejecuciones (>" + String(POWER_DEADLINE_TOLERANCE_MS) + " ms)  Retraso máx: " + String(powerManager.maxLatenessMs()) + " ms");
+    }
     else if (cmd == "system_status") {
       unsigned long currentUptime = (millis() - systemStartTime) / 1000;
       unsigned long totalUptimeHours = (totalUptime + currentUptime) / 3600;
@@ -2403,9 +2883,13 @@ public:
       if (operationMode == MODE_MANUAL) modeStr = "MANUAL";
       else if (operationMode == MODE_AUTO_PID) modeStr = "AUTO_PID";
       else if (operationMode == MODE_AUTO_TIME) modeStr = "AUTO_TIME";
+      else if (operationMode == MODE_AUTO_ADAPTIVE) modeStr = "AUTO_ADAPTIVE";
       else modeStr = "UNKNOWN";
       Serial.printf("║   • Modo operación: %s\n", modeStr.c_str());
-      String selectedModeStr = (selectedAutoMode == AUTO_MODE_PID) ? "PID" : "TIME";
+      String selectedModeStr;
+      if (selectedAutoMode == AUTO_MODE_PID) selectedModeStr = "PID";
+      else if (selectedAutoMode == AUTO_MODE_ADAPTIVE) selectedModeStr = "ADAPTIVE";
+      else selectedModeStr = "TIME";
       Serial.printf("║   • Modo automático seleccionado: %s\n", selectedModeStr.c_str());
       Serial.printf("║   • Calibración tanque: %s\n", isCalibrated ? "COMPLETA" : "PENDIENTE");
       Serial.printf("║   • Tiempo encendido compresor (modo time): %d s\n", timeModeCompressorOnTime);
@@ -2432,6 +2916,7 @@ public:
       Serial.printf("║   • WiFi: %s\n", WiFi.status() == WL_CONNECTED ? "CONECTADO" : "DESCONECTADO");
       Serial.printf("║   • MQTT: %s\n", mqttClient.connected() ? "CONECTADO" : "DESCONECTADO");
       Serial.printf("║   • Broker: %s:%d\n", mqttBroker.c_str(), mqttPort);
+      Serial.printf("║   • Id del equipo: %s (%s)\n", mqttDeviceId.c_str(), mqttLegacyTopics ? "tópicos planos legacy" : mqttTopics.data);
       Serial.println("║");
 
       // CONFIGURACIÓN DE CONTROL
@@ -2459,12 +2944,23 @@ public:
       Serial.printf("║   • Uptime total: %lu h\n", totalUptimeHours);
       Serial.printf("║   • Reconexiones WiFi: %d\n", wifiReconnectCount);
       Serial.printf("║   • Reconexiones MQTT: %d\n", mqttReconnectCount);
+      Serial.printf("║   • Bloqueo máximo del loop: %lu ms (con portal: %lu ms, >%lu ms: %lu veces)\n",
+                    loopMaxStallMs, portalMaxStallMs, (unsigned long)LOOP_STALL_WARN_MS, loopStallCount);
+      Serial.printf("║   • Portal de configuración: %s\n", portalActive ? "ACTIVO" : "INACTIVO");
+      Serial.printf("║   • Supervisor de seguridad: %s, watchdog %s\n", safetyTaskHandle ? "ACTIVO" : "INACTIVO",
+                    safetyWatchdogActive ? "ACTIVO" : "INACTIVO");
+      Serial.printf("║   • Energía: %s, %.1f mA estimados, %lu plazos perdidos\n", powerSaveEnabled ? (powerLightSleep ? "SUEÑO LIGERO" : "DFS") : "DESHABILITADA",
+                    powerManager.averageCurrentMa(), (unsigned long)powerManager.missedDeadlines());
       Serial.println("║");
 
       // HARDWARE
       Serial.println("║ 💻 INFORMACIÓN DEL HARDWARE:");
       Serial.printf("║   • Memoria libre: %d bytes\n", ESP.getFreeHeap());
       Serial.printf("║   • Memoria mínima: %d bytes\n", ESP.getMinFreeHeap());
+      Serial.printf("║   • Mayor bloque libre: %u bytes (fragmentación %u%%)\n",
+                    (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                    (unsigned)MemProfiler::fragmentationPct(heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                                                            heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)));
       Serial.printf("║   • CPU Freq: %d MHz\n", ESP.getCpuFreqMHz());
       Serial.printf("║   • Firmware: v1.0\n", ESP.getCpuFreqMHz());
       Serial.println("║");
@@ -2483,6 +2979,14 @@ public:
            Serial.println("  Temperatura: " + String(data.bmeTemp, 2) + " °C");
            Serial.println("  Humedad: " + String(data.bmeHum, 2) + " %");
            Serial.println("  Presión: " + String(data.bmePres, 2) + " hPa");
+           Serial.println("  Punto de rocío: " + String(data.dewPoint, 2) + " °C");
+           Serial.println("  Humedad absoluta: " + String(data.absHumidity, 2) + " g/m³");
+           Serial.println("  Bulbo húmedo: " + String(data.wetBulb, 2) + " °C");
+           Serial.println("  Presión de vapor: " + String(data.vaporPressure, 2) + " hPa");
+           Serial.println("  Entalpía: " + String(data.enthalpy, 2) + " kJ/kg");
+           if (data.psyStatus == PSY_OUT_OF_ENVELOPE) {
+             Serial.println("  ⚠️ Condiciones fuera de la envolvente psicrométrica calibrada");
+           }
          } else {
            Serial.println("  Lecturas: NO DISPONIBLES");
          }
@@ -2526,6 +3030,12 @@ public:
          Serial.println("  Offset aplicado: " + String(sensorOffset, 2) + " cm");
          if (isCalibrated) {
            Serial.println("  Volumen calculado: " + String(data.waterVolume, 2) + " L");
+           if (levelEstimator.initialized()) {
+             Serial.println("  Incertidumbre: ±" + String(data.volumeStdDev, 2) + " L");
+             Serial.println("  Tasa de producción: " + String(data.productionRate, 2) + " ± " + String(levelEstimator.rateStdDev(), 2) + " L/h");
+             Serial.println("  Caudal de bomba aprendido: " + String(levelEstimator.pumpFlow(), 1) + " L/h");
+             Serial.println("  Lecturas rechazadas: " + String(levelEstimator.rejectedTotal()) + " (reinicios: " + String(levelEstimator.resets()) + ")");
+           }
            Serial.println("  Porcentaje: " + String(calculateWaterPercent(data.distance, data.waterVolume), 1) + " %");
          } else {
            Serial.println("  Calibración: PENDIENTE");
@@ -2588,6 +3098,148 @@ public:
          logWarning( "Tiempo apagado inválido. Use: 30-3600 segundos");
          Serial1.println("SET_CYCLE_OFF: ERR");
        }
+     } else if (cmd.startsWith("set_duty_budget")) {
+       String hoursStr = cmd.substring(15);
+       hoursStr.trim();
+       float newBudget = hoursStr.toFloat();
+       if (newBudget >= 1.0f && newBudget <= DUTY_HOURS * DUTY_MAX_FRACTION) {
+         dutyBudgetHours = newBudget;
+         dutyScheduler.setBudgetHours(dutyBudgetHours);
+         preferences.begin("awg-config", false);
+         preferences.putFloat("dutyBudget", dutyBudgetHours);
+         preferences.end();
+         logInfo( "✅ Presupuesto diario del compresor ajustado a: " + String(dutyBudgetHours, 1) + " h");
+         Serial1.println("SET_DUTY_BUDGET: OK");
+       } else {
+         logWarning( "Presupuesto inválido. Use: 1-" + String(DUTY_HOURS * DUTY_MAX_FRACTION, 1) + " horas");
+         Serial1.println("SET_DUTY_BUDGET: ERR");
+       }
+     } else if (cmd.startsWith("set_duty_sched")) {
+       String valueStr = cmd.substring(14);
+       valueStr.trim();
+       valueStr.toUpperCase();
+       if (valueStr == "ON" || valueStr == "OFF") {
+         dutySchedulerEnabled = (valueStr == "ON");
+         preferences.begin("awg-config", false);
+         preferences.putBool("dutySched", dutySchedulerEnabled);
+         preferences.end();
+         logInfo( "✅ Planificación horaria del modo tiempo: " + valueStr);
+         Serial1.println("SET_DUTY_SCHED: OK");
+       } else {
+         logWarning( "Valor inválido. Use: SET_DUTY_SCHED ON u OFF");
+         Serial1.println("SET_DUTY_SCHED: ERR");
+       }
+     } else if (cmd.startsWith("set_power_save")) {
+       String valueStr = cmd.substring(14);
+       valueStr.trim();
+       valueStr.toUpperCase();
+       if (valueStr == "ON" || valueStr == "OFF") {
+         powerSaveEnabled = (valueStr == "ON");
+         preferences.begin("awg-config", false);
+         preferences.putBool("powerSave", powerSaveEnabled);
+         preferences.end();
+         applyPowerConfig();
+         logInfo( "✅ Gestión de energía: " + valueStr);
+         Serial1.println("SET_POWER_SAVE: OK");
+       } else {
+         logWarning( "Valor inválido. Use: SET_POWER_SAVE ON u OFF");
+         Serial1.println("SET_POWER_SAVE: ERR");
+       }
+     } else if (cmd.startsWith("set_tariff")) {
+       // Formato: SET_TARIFF idx,inicio,fin,peso (peso 0 deshabilita la ventana)
+       String params = cmd.substring(10);
+       params.trim();
+       int c1 = params.indexOf(',');
+       int c2 = params.indexOf(',', c1 + 1);
+       int c3 = params.indexOf(',', c2 + 1);
+       bool ok = false;
+       if (c1 > 0 && c2 > c1 && c3 > c2) {
+         int slot = params.substring(0, c1).toInt();
+         int startHour = params.substring(c1 + 1, c2).toInt();
+         int endHour = params.substring(c2 + 1, c3).toInt();
+         float weight = params.substring(c3 + 1).toFloat();
+         if (slot >= 0 && startHour >= 0 && endHour >= 0 && dutyScheduler.setTariff(slot, startHour, endHour, weight)) {
+           char keyStart[12], keyEnd[12], keyWeight[12];
+           snprintf(keyStart, sizeof(keyStart), "tarStart%d", slot);
+           snprintf(keyEnd, sizeof(keyEnd), "tarEnd%d", slot);
+           snprintf(keyWeight, sizeof(keyWeight), "tarWeight%d", slot);
+           preferences.begin("awg-config", false);
+           preferences.putUChar(keyStart, (uint8_t)startHour);
+           preferences.putUChar(keyEnd, (uint8_t)endHour);
+           preferences.putFloat(keyWeight, weight);
+           preferences.end();
+           logInfo( "✅ Tarifa " + String(slot) + ": " + String(startHour) + "h-" + String(endHour) + "h peso=" + String(weight, 2));
+           ok = true;
+         }
+       }
+       if (!ok) logWarning( "Formato inválido. Use: SET_TARIFF idx(0-" + String(DUTY_TARIFF_SLOTS - 1) + "),inicio(0-23),fin(0-24),peso");
+       Serial1.println(ok ? "SET_TARIFF: OK" : "SET_TARIFF: ERR");
+     } else if (cmd == "duty_status") {
+       Serial.println("=== PLANIFICACIÓN HORARIA (MODO TIEMPO) ===");
+       Serial.println("  Habilitada: " + String(dutySchedulerEnabled ? "SI" : "NO") + "  RTC: " + String(rtcOnline ? "ONLINE" : "OFFLINE") +
+                      "  Perfil: " + String(dutyScheduler.profiledHours()) + "/" + String(DUTY_HOURS) + " h" +
+                      (dutyScheduler.ready() ? "" : " (ciclo fijo hasta completar perfil)"));
+       Serial.println("  Presupuesto: " + String(dutyScheduler.budgetHours(), 1) + " h/día  Consumido hoy: " + String(dutyScheduler.runtimeTodayHours(), 2) + " h");
+       Serial.println("  Hoy: esperado " + String(dutyScheduler.expectedToday(), 2) + " L  logrado " + String(dutyScheduler.achievedToday(), 2) + " L");
+       Serial.println("  Ayer: esperado " + String(dutyScheduler.lastDayExpected(), 2) + " L  logrado " + String(dutyScheduler.lastDayAchieved(), 2) + " L");
+       for (int i = 0; i < DUTY_TARIFF_SLOTS; i++) {
+         const DutyTariff& t = dutyScheduler.tariff(i);
+         if (t.weight > 0.0f) Serial.printf("  Tarifa %d: %02d-%02d h peso %.2f\n", i, t.startHour, t.endHour, t.weight);
+       }
+       Serial.println("  Hora  HA(g/m3)  L/h comp  Trabajo");
+       const DutyProfile& profile = dutyScheduler.profile();
+       for (int h = 0; h < DUTY_HOURS; h++) {
+         Serial.printf("  %02d%s  %7.2f  %8.3f  %5.0f%%\n", h, h == dutyScheduler.currentHour() ? "*" : " ",
+                       profile.absHumidity[h], dutyScheduler.yieldEstimate(h), dutyScheduler.plannedDuty(h) * 100.0f);
+       }
+     } else if (cmd.startsWith("stats_query")) {
+       // Formato: STATS_QUERY nivel[,desde[,hasta]] con epoch local del RTC; desde<0 = últimos N
+       String params = cmd.substring(11);
+       params.trim();
+       int c1 = params.indexOf(',');
+       int c2 = (c1 >= 0) ? params.indexOf(',', c1 + 1) : -1;
+       String levelStr = (c1 >= 0) ? params.substring(0, c1) : params;
+       levelStr.trim();
+       int level = -1;
+       for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+         if (levelStr == ROLLUP_LEVEL_NAME[l]) level = l;
+       }
+       if (level < 0) {
+         logWarning( "Uso: STATS_QUERY minute|hour|day[,desde[,hasta]] (desde<0: últimos N intervalos)");
+       } else {
+         long from = 0;
+         uint32_t to = UINT32_MAX;
+         if (c1 >= 0) from = (c2 >= 0 ? params.substring(c1 + 1, c2) : params.substring(c1 + 1)).toInt();
+         if (c2 >= 0) to = strtoul(params.substring(c2 + 1).c_str(), nullptr, 10);
+         uint16_t count = rollupEngine.count(level);
+         uint16_t first = 0;
+         if (from < 0) {
+           first = (-from < count) ? (uint16_t)(count + from) : 0;
+           from = 0;
+         }
+         int total = 0;
+         for (uint16_t i = first; i < count; i++) {
+           uint32_t start = rollupEngine.record(level, i).start;
+           if (start >= (uint32_t)from && start <= to) total++;
+         }
+         RollupRecord open;
+         bool hasOpen = rollupEngine.openRecord(level, open) && open.start >= (uint32_t)from && open.start <= to;
+         if (hasOpen) total++;
+
+         Serial.println("=== AGREGADOS POR " + levelStr + ": " + String(total) + " intervalos (* = en curso) ===");
+         Serial.println("  Inicio                 n  Trabajo     kWh  Agua L  T media HR media  Vol L");
+         int index = 0;
+         for (uint16_t i = first; i < count; i++) {
+           const RollupRecord& r = rollupEngine.record(level, i);
+           if (r.start < (uint32_t)from || r.start > to) continue;
+           printRollupRecord(r, false);
+           publishRollup(level, r, "query", index++, total);
+         }
+         if (hasOpen) {
+           printRollupRecord(open, true);
+           publishRollup(level, open, "open", index++, total);
+         }
+       }
      } else if (cmd.startsWith("set_auto_mode")) {
        // Parsing más robusto: encontrar el espacio después de "set_auto_mode"
        int spaceIndex = cmd.indexOf(' ', 13); // Buscar espacio después de "set_auto_mode" (13 chars)
@@ -2613,11 +3265,39 @@ public:
          preferences.end();
          logInfo( "✅ Modo automático seleccionado: TIME (control por tiempo cíclico)");
          Serial1.println("SET_AUTO_MODE: TIME");
+       } else if (modeStr == "ADAPTIVE") {
+         selectedAutoMode = AUTO_MODE_ADAPTIVE;
+         preferences.begin("awg-config", false);
+         preferences.putInt("selectedAutoMode", (int)selectedAutoMode);
+         preferences.end();
+         logInfo( "✅ Modo automático seleccionado: ADAPTIVE (optimización de litros por kWh)");
+         Serial1.println("SET_AUTO_MODE: ADAPTIVE");
        } else {
-         logWarning( "Modo automático inválido: '" + modeStr + "'. Use: SET_AUTO_MODE PID o SET_AUTO_MODE TIME");
+         logWarning( "Modo automático inválido: '" + modeStr + "'. Use: SET_AUTO_MODE PID, TIME o ADAPTIVE");
          Serial1.println("SET_AUTO_MODE: ERR");
        }
      }
+    else if (cmdToProcess == "mem_stats") {
+      // Por separado: cada reporte arma su documento y su buffer en la pila (~2 KB), y
+      // memReportTrend() dentro de memReport() los tenía vivos a la vez
+      memReport(true);
+      memReportTrend();
+    }
+    else if (cmdToProcess == "safety_status") {
+      safetyReport();
+    }
+    else if (cmdToProcess == "cmd_stats") {
+      // Latencia por etapa y resultados de los comandos recibidos por MQTT
+      char buffer[CMD_STATS_MAX];
+      if (commandTracer.statsJson(buffer, sizeof(buffer)) > 0) {
+        if (mqttClient.connected()) mqttClient.publish(mqttTopics.ack, buffer, false);
+        Serial.println(buffer);
+      }
+    }
+    else if (cmdToProcess == "cmd_stats_reset") {
+      commandTracer.resetStats();
+      logInfo("Estadísticas de comandos reiniciadas");
+    }
     else if (cmdToProcess == "help") {
       printHelp();
     }
@@ -2640,11 +3320,11 @@ public:
     }
     else if (cmdToProcess.length() > 0) {
       logWarning( "Comando no reconocido: " + cmdToProcess);
+      commandTracer.reject(CMD_REJECT_UNKNOWN);
     }
 
-    // Liberar bloqueo de comando crítico si fue establecido
+    // commandLock libera el bloqueo al salir
     if (isCriticalCommand) {
-      isProcessingCommand = false;
       logDebug( "🔓 Comando crítico completado: " + cmd);
     }
   }
@@ -2659,21 +3339,28 @@ public:
     help += "║   • ONV/OFFV: Encender/Apagar ventilador.\n";
     help += "║   • ONCF/OFFCF: Encender/Apagar ventilador compresor.\n";
     help += "║   • MODE MANUAL: Cambiar a modo manual.\n";
-    help += "║   • MODE AUTO: Cambiar al modo automático seleccionado (PID o TIME).\n";
+    help += "║   • MODE AUTO: Cambiar al modo automático seleccionado (PID, TIME o ADAPTIVE).\n";
     help += "║   • MODE AUTO_PID: Cambiar a modo automático PID.\n";
     help += "║   • MODE AUTO_TIME: Cambiar a modo automático por tiempo.\n";
-    help += "║   • SET_AUTO_MODE PID/TIME: Seleccionar qué modo usar con MODE AUTO.\n";
+    help += "║   • MODE AUTO_ADAPTIVE: Cambiar a modo adaptativo (maximiza L/kWh).\n";
+    help += "║   • SET_AUTO_MODE PID/TIME/ADAPTIVE: Seleccionar qué modo usar con MODE AUTO.\n";
     help += "║\n";
     help += "║ ⚙️ CONFIGURACIÓN:\n";
     help += "║   • SET_MQTT broker puerto: Cambiar configuración MQTT.\n";
+    help += "║   • SET_DEVICE_ID id|MAC: Id del equipo en los tópicos dropster/<id>/... (MAC = derivado del chip).\n";
+    help += "║   • SET_MQTT_LEGACY ON/OFF: Tópicos planos dropster/<hoja> de versiones anteriores.\n";
     help += "║   • SET_OFFSET X.X: Ajustar offset del sensor ultrasónico (cm).\n";
     help += "║   • SET_TANK_CAPACITY X.X: Ajustar capacidad del tanque (litros).\n";
     help += "║   • SET_MAX_TEMP X.X: Ajustar temperatura máxima del compresor (°C).\n";
     help += "║   • SET_TIME YYYY-MM-DD HH:MM:SS: Ajustar fecha y hora del RTC.\n";
     help += "║   • SET_CYCLE_ON X: Ajustar tiempo encendido modo time (30-3600 seg).\n";
     help += "║   • SET_CYCLE_OFF X: Ajustar tiempo apagado modo time (30-3600 seg).\n";
+    help += "║   • SET_DUTY_SCHED ON/OFF: Reparto horario del modo time según humedad.\n";
+    help += "║   • SET_DUTY_BUDGET X.X: Horas diarias de compresor a repartir (modo time).\n";
+    help += "║   • SET_TARIFF idx,ini,fin,peso: Ventana de tarifa (peso>1 encarece, 0=off).\n";
     help += "║   • SET_CTRL d,mnOff,mxOn,samp,alpha: Ajustar parámetros (°C,seg,seg,seg,0-1).\n";
     help += "║   • SET_SCREEN_TIMEOUT X: Timeout pantalla reposo en seg (0=deshabilitado).\n";
+    help += "║   • SET_POWER_SAVE ON/OFF: Sueño ligero y escalado de CPU entre tareas.\n";
     help += "║   • SET_LOG_LEVEL X: Nivel logs (0=ERROR,1=WARNING,2=INFO,3=DEBUG).\n";
     help += "║\n";
     help += "║ 📊 MONITOREO:\n";
@@ -2681,6 +3368,15 @@ public:
     help += "║   • SYSTEM_STATUS: Estado completo del sistema.\n";
     help += "║   • SENSOR_STATUS sensor: Estado detallado de sensor específico\n";
     help += "║     (BME280, SHT31, PZEM, RTC, TERMISTOR, ULTRASONICO).\n";
+    help += "║   • ADAPT_STATUS: Estado del control adaptativo (eficiencia y umbrales).\n";
+    help += "║   • DUTY_STATUS: Perfil horario, plan y litros esperados vs logrados.\n";
+    help += "║   • STATS_QUERY nivel[,desde[,hasta]]: Agregados minute/hour/day\n";
+    help += "║     (epoch local; desde<0 = últimos N). También en dropster/rollup.\n";
+    help += "║   • POWER_STATUS: Consumo estimado, latencia de despertar y plazos perdidos.\n";
+    help += "║   • MEM_STATS: Heap, fragmentación, pila por tarea, heap por subsistema y tendencia.\n";
+    help += "║   • SAFETY_STATUS: Supervisor de seguridad: enclavamientos, cortes y tiempos de reacción.\n";
+    help += "║   • CMD_STATS: Latencia de comandos por etapa (p50/p90/p99) y rechazos, en dropster/<id>/ack.\n";
+    help += "║     Un comando \"@id[:ts] CMD\" recibe su acuse en el mismo tópico.\n";
     help += "║\n";
     help += "║ 🪣 CALIBRACIÓN:\n";
     help += "║   • CALIBRATE: Iniciar calibración automática (tanque vacío).\n";
@@ -2697,6 +3393,8 @@ public:
     help += "║   • RESET_ENERGY: Reinicia la energía acumulada medida por el PZEM.\n";
     help += "║   • RESET_FACTORY: Reset completo de fábrica (valores predeterminados).\n";
     help += "║   • RESET_STATS: Resetear estadísticas del sistema.\n";
+    help += "║   • ADAPT_RESET: Descartar lo aprendido por el control adaptativo.\n";
+    help += "║   • CMD_STATS_RESET: Reiniciar las estadísticas de latencia de comandos.\n";
     help += "║\n";
     help += "║ ❓ AYUDA:\n";
     help += "║   • HELP: Mostrar esta ayuda\n";
@@ -2767,17 +3465,17 @@ static const unsigned long LED_BLINK_INTERVAL = 500; // ms
 void ledInit() {
   // Configurar timer (usar TIMER 0)
   ledc_timer_config_t ledc_timer = {};
-  ledc_timer.speed_mode = LEDC_HIGH_SPEED_MODE;
+  ledc_timer.speed_mode = LEDC_LOW_SPEED_MODE;
   ledc_timer.duty_resolution = (ledc_timer_bit_t)LEDC_RES; // bits
   ledc_timer.timer_num = LEDC_TIMER_0;
   ledc_timer.freq_hz = LEDC_FREQ;
-  ledc_timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer.clk_cfg = LEDC_USE_RTC8M_CLK;  // Reloj RTC de 8 MHz: el PWM sigue activo durante el sueño ligero
   ledc_timer_config(&ledc_timer);
 
   // Configurar canales R,G,B en el mismo timer
   ledc_channel_config_t ch = {};
   ch.gpio_num = LED_R_PIN;
-  ch.speed_mode = LEDC_HIGH_SPEED_MODE;
+  ch.speed_mode = LEDC_LOW_SPEED_MODE;
   ch.channel = (ledc_channel_t)LEDC_CHANNEL_R;
   ch.intr_type = LEDC_INTR_DISABLE;
   ch.timer_sel = LEDC_TIMER_0;
@@ -2800,12 +3498,12 @@ void setLedColor(uint8_t r, uint8_t g, uint8_t b) {
   uint32_t dutyR = (uint32_t)r * maxDuty / 255UL;
   uint32_t dutyG = (uint32_t)g * maxDuty / 255UL;
   uint32_t dutyB = (uint32_t)b * maxDuty / 255UL;
-  ledc_set_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_R, dutyR);
-  ledc_update_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_R);
-  ledc_set_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_G, dutyG);
-  ledc_update_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_G);
-  ledc_set_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_B, dutyB);
-  ledc_update_duty(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_B);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_R, dutyR);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_R);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_G, dutyG);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_G);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_B, dutyB);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_B);
 }
 
 // Actualiza el estado del LED según prioridades del sistema
@@ -2890,9 +3588,21 @@ void updateLedState() {
 
 /* Control automático: mantiene temp evaporador cerca del punto de rocío (PID o cíclico) */
 void AWGSensorManager::processControl() {
-  if (operationMode != MODE_AUTO_PID && operationMode != MODE_AUTO_TIME) return;  // Solo ejecutar en modos automáticos
   unsigned long now = millis();
 
+  // Perfil horario de humedad y rendimiento: se aprende en cualquier modo si hay RTC
+  if (rtcOnline && now - lastDutySample >= DUTY_SAMPLE_INTERVAL) {
+    float dtSec = (lastDutySample == 0) ? 0.0f : (now - lastDutySample) / 1000.0f;
+    lastDutySample = now;
+    bool compOn = (digitalRead(COMPRESSOR_RELAY_PIN) == LOW);
+    bool pumpOn = (digitalRead(PUMP_RELAY_PIN) == LOW);
+    if (dutyScheduler.sample(data.secondOfDay, data.day, dtSec, data.absHumidity, data.waterVolume, compOn, pumpOn)) {
+      saveDutyProfile();
+    }
+  }
+
+  if (operationMode != MODE_AUTO_PID && operationMode != MODE_AUTO_TIME && operationMode != MODE_AUTO_ADAPTIVE) return;  // Solo ejecutar en modos automáticos
+
   // Verificar recuperación automática de protección por temperatura
   if (compressorTempProtectionActive) {
     if (data.compressorTemp <= maxCompressorTemp - 20.0f) {
@@ -2914,17 +3624,37 @@ void AWGSensorManager::processControl() {
       setCompressorFanState(true);
     }
 
+    // Con perfil horario el tiempo apagado se deriva de la fracción asignada a la hora actual
+    bool scheduled = dutySchedulerEnabled && rtcOnline && dutyScheduler.ready();
+    unsigned long offTimeMs = (unsigned long)timeModeCompressorOffTime * 1000UL;
+    if (scheduled) {
+      uint32_t offSec = dutyScheduler.offTimeSec(timeModeCompressorOnTime, control_min_off);
+      // Hora sin asignación: permanecer apagado. Un mínimo apagado enorme tampoco debe desbordar ×1000
+      offTimeMs = (offSec >= UINT32_MAX / 1000UL) ? UINT32_MAX : offSec * 1000UL;
+    }
+
     // Control cíclico del compresor
     if (timeModeCycleStart == 0) {
       // Iniciar primer ciclo
       timeModeCycleStart = now;
+      if (scheduled && offTimeMs == UINT32_MAX) {
+        timeModeCompressorState = false;  // Hora sin asignación: empezar apagado
+        if (digitalRead(COMPRESSOR_RELAY_PIN) == LOW) {
+          digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
+          compressorProtectionActive = false;
+          compressorOffStart = now;
+          compressorOnStart = 0;
+          publishState();
+        }
+        return;
+      }
       timeModeCompressorState = true;  // Empezar encendido
       // Verificar si el tanque está lleno antes de encender
       if (this->isTankFull()) {
         logWarning( "🚫 SEGURIDAD: Compresor NO encendido en modo tiempo - Tanque lleno");
         return;  // Salir sin encender el compresor
       }
-      digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+      if (!startCompressorRelay()) return;
       logDebug( "Modo tiempo: Iniciando ciclo - Compresor ON");
       publishState();
       compressorOnStart = now;
@@ -2936,7 +3666,7 @@ void AWGSensorManager::processControl() {
       unsigned long cycleElapsed = now - timeModeCycleStart;
       unsigned long targetTime = timeModeCompressorState ?
         (unsigned long)timeModeCompressorOnTime * 1000UL :
-        (unsigned long)timeModeCompressorOffTime * 1000UL;
+        offTimeMs;
 
       if (cycleElapsed >= targetTime) {
         // Cambiar estado del compresor
@@ -2950,7 +3680,7 @@ void AWGSensorManager::processControl() {
             logWarning( "🚫 SEGURIDAD: Compresor NO encendido en modo tiempo - Tanque lleno");
             return;  // Salir sin encender el compresor
           }
-          digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+          if (!startCompressorRelay()) return;
           logDebug( "Modo tiempo: Compresor ON - Ciclo: " + String(timeModeCompressorOnTime) + "s ON");
           publishState();
           compressorOnStart = now;
@@ -2961,13 +3691,18 @@ void AWGSensorManager::processControl() {
           compressorProtectionActive = false;  // Reset protección al apagar en modo tiempo
           // Apagar compresor
           digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
-          logDebug( "Modo tiempo: Compresor OFF - Ciclo: " + String(timeModeCompressorOffTime) + "s OFF");
+          if (offTimeMs == UINT32_MAX) {
+            logDebug( "Modo tiempo: Compresor OFF - Sin asignación en esta hora");
+          } else {
+            logDebug( "Modo tiempo: Compresor OFF - Ciclo: " + String(offTimeMs / 1000UL) + "s OFF");
+          }
           publishState();
           compressorOffStart = now;
           compressorOnStart = 0;
         }
       }
     }
+    return;  // El ciclo por tiempo gobierna el compresor: la histéresis PID no debe reencenderlo
   }
 
   // Modo automático PID
@@ -2995,11 +3730,34 @@ void AWGSensorManager::processControl() {
   } else {
     evapSmoothed = CONTROL_SMOOTHING_ALPHA * rawTemp + (1.0f - CONTROL_SMOOTHING_ALPHA) * evapSmoothed;
   }
+  // Sin punto de rocío válido (BME caído) no hay referencia: se omiten la histéresis y los
+  // umbrales del ventilador, pero el tiempo máximo encendido y el mínimo apagado siguen
   float dew = data.dewPoint;
+  bool dewValid = !isnan(dew);
+
+  // Umbrales: fijos en modo PID, aprendidos en modo adaptativo
+  float deadband = control_deadband;
+  float fanOnOffset = evapFanTempOnOffset;
+  float fanOffOffset = evapFanTempOffOffset;
+  if (dewValid && operationMode == MODE_AUTO_ADAPTIVE) {
+    float energy = pzemOnline ? data.energy : NAN;  // Sin PZEM no hay medida de consumo
+    bool pumpOn = (digitalRead(PUMP_RELAY_PIN) == LOW);
+    AdaptEvent evt = adaptiveController.update(now, data.waterVolume, energy, data.absHumidity, pumpOn);
+    if (evt == ADAPT_EVT_PARAMS_UPDATED) {
+      saveAdaptiveState();
+      logInfo( "Control adaptativo: iteración " + String(adaptiveController.iterations()) + " eficiencia=" + String(adaptiveController.efficiency(), 2) + " L/kWh");
+    } else if (evt == ADAPT_EVT_WINDOW_REJECTED) {
+      logDebug( "Control adaptativo: ventana descartada (" + String(adaptiveController.lastRejectReason()) + ")");
+    }
+    dew += adaptiveController.param(ADAPT_SETPOINT_OFFSET);
+    deadband = adaptiveController.param(ADAPT_DEADBAND);
+    fanOnOffset = adaptiveController.param(ADAPT_FAN_ON_OFFSET);
+    fanOffOffset = adaptiveController.param(ADAPT_FAN_OFF_OFFSET);
+  }
 
   // Banda diferencial (histeresis simétrica alrededor del punto de rocío)
-  float onThreshold = dew + (control_deadband / 2.0f);
-  float offThreshold = dew - (control_deadband / 2.0f);
+  float onThreshold = dew + (deadband / 2.0f);
+  float offThreshold = dew - (deadband / 2.0f);
   bool compressorOn = (digitalRead(COMPRESSOR_RELAY_PIN) == LOW);
   unsigned long nowMs = now;
 
@@ -3014,7 +3772,7 @@ void AWGSensorManager::processControl() {
       compressorOffStart = nowMs;
       compressorOnStart = 0;
       compressorProtectionActive = false;  // Reset protección al apagar por histeresis
-    } else if (evapSmoothed <= offThreshold) {
+    } else if (dewValid && evapSmoothed <= offThreshold) {
       // Apagar por histeresis cuando temperatura cae suficientemente debajo del punto de rocío
       digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
       publishState();
@@ -3029,14 +3787,14 @@ void AWGSensorManager::processControl() {
     if (forceStartOnModeSwitch) {
       minOffElapsed = true;
     }
-    if (minOffElapsed && compressorRetryDelayStart == 0) {  // No permitir arranque si hay retraso de reintento
+    if (dewValid && minOffElapsed && compressorRetryDelayStart == 0) {  // No permitir arranque si hay retraso de reintento
       if (evapSmoothed >= onThreshold) {
         // Verificar si el tanque está lleno antes de encender
         if (this->isTankFull()) {
           logWarning( "🚫 SEGURIDAD: Compresor NO encendido en modo PID - Tanque lleno");
           return;  // Salir sin encender el compresor
         }
-        digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+        if (!startCompressorRelay()) return;
         publishState();
         compressorOnStart = nowMs;
         compressorOffStart = 0;
@@ -3053,13 +3811,15 @@ void AWGSensorManager::processControl() {
   bool evapFanOn = (digitalRead(VENTILADOR_RELAY_PIN) == LOW);
 
   // Histeresis temperatura: enciende frío, apaga caliente
-  if (evapFanOn) {
-    if (evapSmoothed >= (dew + evapFanTempOffOffset)) {
+  if (!dewValid) {
+    // Sin referencia el ventilador mantiene su estado
+  } else if (evapFanOn) {
+    if (evapSmoothed >= (dew + fanOffOffset)) {
       // Apagar cuando temperatura sube suficientemente por encima del punto de rocío
       setVentiladorState(false);
     }
   } else {
-    if (evapSmoothed <= (dew - evapFanTempOnOffset)) {
+    if (evapSmoothed <= (dew - fanOnOffset)) {
       // Encender cuando temperatura cae suficientemente por debajo del punto de rocío
       setVentiladorState(true);
     }
@@ -3069,7 +3829,7 @@ void AWGSensorManager::processControl() {
   char buf[64];
   snprintf(buf, sizeof(buf), "CTRL: evap=%.2f dew=%.2f mode=AUTO comp=%s\n",
            evapSmoothed, dew, compressorOn ? "ON" : "OFF");
-  Serial1.print(buf);
+  if (!otaDisplayRelayActive()) Serial1.print(buf);
 }
 
 // Función para manejar la protección del compresor
@@ -3094,7 +3854,7 @@ void handleCompressorProtection() {
         digitalWrite(COMPRESSOR_RELAY_PIN, HIGH); // Arranque fallido - apagar compresor y programar reintento
         logWarning( "Protección del compresor: Arranque fallido - corriente máxima: " + String(compressorMaxCurrent, 2) + "A");
         if (mqttClient.connected()) {
-          mqttClient.publish(MQTT_TOPIC_STATUS, "COMP_OFF");
+          mqttClient.publish(mqttTopics.status, "COMP_OFF");
         }
         publishState();
         compressorOffStart = now;
@@ -3187,7 +3947,7 @@ if (alertTankFull.enabled && data.waterVolume >= 0) {
        // Apagar compresor inmediatamente por seguridad
        digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
        if (mqttClient.connected()) {
-         mqttClient.publish(MQTT_TOPIC_STATUS, "COMP_OFF");
+         mqttClient.publish(mqttTopics.status, "COMP_OFF");
        }
        // Actualizar display con el nuevo estado
        publishState();  // Publicar estados actualizados inmediatamente
@@ -3198,6 +3958,7 @@ if (alertTankFull.enabled && data.waterVolume >= 0) {
 }
 
 void awgLog(int level, const String& message) {
+  MemScope memScope(MEM_SYS_LOG);
   if (level <= logLevel) {
     const char* levelStr = "LOG";
     switch (level) {
@@ -3236,22 +3997,32 @@ void awgLog(int level, const String& message) {
 }
 
 void onMqttMessage(char* topic, byte* payload, unsigned int length) {
+  unsigned long rxUs = micros();  // Llegada: origen de los tiempos del acuse
+  MemScope memScope(MEM_SYS_MQTT);
   // Validación robusta del mensaje
   if (length == 0 || payload == nullptr) {
     logWarning( "Mensaje MQTT vacío o inválido recibido");
     return;
   }
 
+  // Trozos de firmware: binarios y a ritmo de ventana, sin pasar por String
+  if (strcmp(topic, mqttTopics.ota) == 0) {
+    otaHandleChunk(payload, length);
+    return;
+  }
+
   try {
     String message;
+    message.reserve(length);  // Una asignación en vez de una por byte
     for (unsigned int i = 0; i < length; i++) {
       message += (char)payload[i];
     }
     String topicStr = String(topic);
 
     // Procesar mensaje según el topic
-    if (topicStr == MQTT_TOPIC_CONTROL) {
+    if (topicStr == mqttTopics.control || (mqttTopics.sharedControl[0] && topicStr == mqttTopics.sharedControl)) {
       logDebug( "🎛️ Comando recibido: " + message);
+      commandTracer.arrived(rxUs, rxUs - mqttPrevPollUs);
       sensorManager.processCommand(message);
       logDebug( "✅ Comando procesado");
     } else {
@@ -3264,12 +4035,14 @@ void onMqttMessage(char* topic, byte* payload, unsigned int length) {
 
 void setVentiladorState(bool newState) {
   digitalWrite(VENTILADOR_RELAY_PIN, newState ? LOW : HIGH);
+  commandTracer.actuate(micros());
   logDebug( "Ventilador " + String(newState ? "ON" : "OFF"));
   publishState();
 }
 
 void setCompressorFanState(bool newState) {
   digitalWrite(COMPRESSOR_FAN_RELAY_PIN, newState ? LOW : HIGH);
+  commandTracer.actuate(micros());
   logDebug( "Ventilador compresor " + String(newState ? "ON" : "OFF"));
   publishState();
 }
@@ -3282,10 +4055,18 @@ void setPumpState(bool newState) {
     if (sensorData.waterVolume < alertPumpLow.threshold) {
       logError("SEGURIDAD: Bomba NO encendida - Nivel de agua insuficiente: " + String(sensorData.waterVolume, 1) + "L (min: " + String(alertPumpLow.threshold, 1) + "L)");
       publishImmediateUpdate("ps", 0);
+      commandTracer.reject(CMD_REJECT_PUMP_LOW);
+      return;
+    }
+    if (!safetyPumpAllowed()) {
+      logError("SEGURIDAD: Bomba NO encendida - Enclavada por el supervisor (SAFETY_STATUS)");
+      publishImmediateUpdate("ps", 0);
+      commandTracer.reject(CMD_REJECT_SAFETY);
       return;
     }
   }
   digitalWrite(PUMP_RELAY_PIN, newState ? LOW : HIGH);
+  commandTracer.actuate(micros());
   logDebug("Bomba " + String(newState ? "ON" : "OFF"));
   publishState();
 }
@@ -3293,7 +4074,7 @@ void setPumpState(bool newState) {
 // Publica estado consolidado del sistema con información de conectividad
 void publishConsolidatedStatus() {
   if (!ensureMqttConnected()) return;
-  StaticJsonDocument<300> statusDoc;
+  StaticJsonDocument<512> statusDoc;
   statusDoc["type"] = "system_status";
   statusDoc["status"] = "online";
   statusDoc["compressor"] = digitalRead(COMPRESSOR_RELAY_PIN) == LOW ? 1 : 0;
@@ -3304,6 +4085,7 @@ void publishConsolidatedStatus() {
   if (operationMode == MODE_MANUAL) modeStr = "MANUAL";
   else if (operationMode == MODE_AUTO_PID) modeStr = "AUTO_PID";
   else if (operationMode == MODE_AUTO_TIME) modeStr = "AUTO_TIME";
+  else if (operationMode == MODE_AUTO_ADAPTIVE) modeStr = "AUTO_ADAPTIVE";
   else modeStr = "UNKNOWN";
   statusDoc["mode"] = modeStr;
   statusDoc["tank_capacity"] = tankCapacityLiters;
@@ -3312,13 +4094,28 @@ void publishConsolidatedStatus() {
   // Información de conectividad
   statusDoc["broker"] = mqttBroker;
   statusDoc["port"] = mqttPort;
-  statusDoc["topic"] = MQTT_TOPIC_STATUS;
+  statusDoc["topic"] = (const char*)mqttTopics.status;
+  statusDoc["device_id"] = mqttDeviceId.c_str();
   statusDoc["wifi_connected"] = (WiFi.status() == WL_CONNECTED);
+  statusDoc["fw"] = FIRMWARE_VERSION;
+  if (displayFirmwareVersion.length() > 0) statusDoc["display_fw"] = displayFirmwareVersion.c_str();
+
+  // Eficiencia estimada por el control adaptativo (L/kWh)
+  float efficiency = adaptiveController.efficiency();
+  if (!isnan(efficiency)) statusDoc["efficiency"] = roundf(efficiency * 100.0f) / 100.0f;
+  float windowEfficiency = adaptiveController.windowEfficiency();
+  if (operationMode == MODE_AUTO_ADAPTIVE && !isnan(windowEfficiency)) statusDoc["efficiency_live"] = roundf(windowEfficiency * 100.0f) / 100.0f;
+
+  // Litros esperados vs logrados hoy según la planificación horaria
+  if (sensorManager.getRtcOnline()) {
+    statusDoc["expected_lpd"] = roundf(dutyScheduler.expectedToday() * 100.0f) / 100.0f;
+    statusDoc["achieved_lpd"] = roundf(dutyScheduler.achievedToday() * 100.0f) / 100.0f;
+  }
 
-  char statusBuffer[300];
+  char statusBuffer[512];  // Con tópicos por dispositivo el id aparece dos veces
   size_t statusLen = serializeJson(statusDoc, statusBuffer, sizeof(statusBuffer));
   if (statusLen > 0 && statusLen < sizeof(statusBuffer)) {
-    mqttClient.publish(MQTT_TOPIC_STATUS, statusBuffer, true);  // QoS 1 para asegurar entrega
+    mqttClient.publish(mqttTopics.status, statusBuffer, true);  // QoS 1 para asegurar entrega
   }
 }
 
@@ -3335,6 +4132,7 @@ String getSystemStateJSON() {
   if (operationMode == MODE_MANUAL) modeStr = "MANUAL";
   else if (operationMode == MODE_AUTO_PID) modeStr = "AUTO_PID";
   else if (operationMode == MODE_AUTO_TIME) modeStr = "AUTO_TIME";
+  else if (operationMode == MODE_AUTO_ADAPTIVE) modeStr = "AUTO_ADAPTIVE";
   else modeStr = "UNKNOWN";
   doc["mode"] = modeStr;
   doc["tank_capacity"] = tankCapacityLiters;
@@ -3418,12 +4216,14 @@ void connectMQTT() {
   }
   logInfo( "🔌 Iniciando conexión MQTT...");
   logInfo( "🎯 BROKER MQTT OBJETIVO: " + mqttBroker + ":" + String(mqttPort));
-  logInfo( "📝 TOPIC MQTT OBJETIVO: " + String(MQTT_TOPIC_DATA));
-  String clientId = String(MQTT_CLIENT_ID) + "_" + String(random(1000, 9999));  // Client ID único para evitar conflictos
+  logInfo( "📝 TOPIC MQTT OBJETIVO: " + String(mqttTopics.data));
+  // Client ID estable: un id al azar por intento dejaba sesiones huérfanas en el broker y,
+  // con muchos equipos, colisiones que se expulsaban entre sí
+  String clientId = String(MQTT_CLIENT_ID) + "_" + mqttDeviceId;
 
   // Mensaje que el broker publicará si el cliente se desconecta inesperadamente
-  const char* willTopic = MQTT_TOPIC_SYSTEM;
-  const char* willMessage = "AWG_OFFLINE";
+  const char* willTopic = mqttTopics.willTopic();
+  const char* willMessage = mqttTopics.willMessage();
   const uint8_t willQos = 1;
   const bool willRetain = true;
 
@@ -3443,8 +4243,15 @@ void connectMQTT() {
   if (connected) {
     logInfo( "✅ CONEXIÓN MQTT EXITOSA!");
     // Suscribirse a todos los topics necesarios
-    mqttClient.subscribe(MQTT_TOPIC_CONTROL);
-    mqttClient.publish(MQTT_TOPIC_SYSTEM, "AWG_ONLINE", true);  // Publicar estado online (retained)
+    mqttClient.subscribe(mqttTopics.control);
+    if (MQTT_SHARED_CONTROL && mqttTopics.sharedControl[0]) mqttClient.subscribe(mqttTopics.sharedControl);  // Apps anteriores
+    if (otaActive()) mqttClient.subscribe(mqttTopics.ota);  // OTA_PUSH a medias: el emisor sigue tras reconectar
+    if (mqttTopics.legacy) {
+      mqttClient.publish(mqttTopics.system, "AWG_ONLINE", true);  // Publicar estado online (retained)
+    } else {
+      mqttClient.publish(mqttTopics.presence, MQTT_PRESENCE_ONLINE, true);  // Reemplaza al last will retenido
+    }
+    mqttSessionStart = millis();
     logInfo( "📤 Estado online publicado");
     logInfo( "✅ Dispositivo Dropster AWG listo para operar!");
     systemReady = true;
@@ -3490,8 +4297,27 @@ void loadMqttConfig() {
   preferences.begin("awg-mqtt", true);
   String savedBroker = preferences.getString("broker", "");
   int savedPort = preferences.getInt("port", 0);
-  preferences.end();
+  String savedDeviceId = preferences.getString("device_id", "");
   bool hasSavedConfig = (savedBroker.length() > 0 && savedPort > 0);  // Determinar si usar configuración guardada o valores por defecto
+  // Sin preferencia explícita, un equipo que ya tenía broker guardado viene de un firmware con
+  // tópicos planos: sigue en legacy para no dejar de ver a la app que lo usaba
+  // (este firmware guarda "legacy" junto con el broker, así que la clave solo falta en esos)
+  mqttLegacyTopics = preferences.getBool("legacy", hasSavedConfig ? true : MQTT_LEGACY_TOPICS_DEFAULT);
+  preferences.end();
+
+  // Id del equipo: el provisionado (SET_DEVICE_ID) o el derivado de la MAC base del chip
+  if (mqttDeviceIdValid(savedDeviceId.c_str())) {
+    mqttDeviceId = savedDeviceId;
+  } else {
+    uint64_t efuseMac = ESP.getEfuseMac();
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)(efuseMac >> (8 * i));
+    char macId[MQTT_DEVICE_ID_MAX + 1];
+    mqttDeviceIdFromMac(mac, macId);
+    mqttDeviceId = macId;
+  }
+  mqttTopics.build(MQTT_TOPIC_ROOT, mqttDeviceId.c_str(), mqttLegacyTopics);
+  logInfo( "🆔 Id MQTT: " + mqttDeviceId + (mqttLegacyTopics ? String(" (tópicos planos legacy)") : " - tópicos " + String(MQTT_TOPIC_ROOT) + "/" + mqttDeviceId + "/..."));
 
   if (hasSavedConfig) {
     mqttBroker = savedBroker;
@@ -3505,86 +4331,976 @@ void loadMqttConfig() {
   }
 }
 
+// Aplica un id o un modo de tópicos nuevo: el last will y la suscripción dependen de ellos,
+// así que hace falta una sesión nueva
+void reconnectWithNewTopics() {
+  loadMqttConfig();
+  if (mqttClient.connected()) mqttClient.disconnect();
+  if (WiFi.status() == WL_CONNECTED) {
+    connectMQTT();
+  } else {
+    logWarning( "No se reconectará a MQTT porque no hay conexión WiFi");
+  }
+}
+
+// Portal de configuración no bloqueante (AP+STA): serviceConfigPortal() lo atiende desde
+// loop(), de modo que lecturas, control, protección y pantalla siguen funcionando
+WiFiManager portalManager;
+WiFiManagerParameter portalMqttBroker("broker", "MQTT Broker", "", 40);
+WiFiManagerParameter portalMqttPort("port", "MQTT Port", "", 6);
+bool portalParamsAdded = false;
+bool portalParamsSaved = false;
+
+void onPortalParamsSaved() {
+  portalParamsSaved = true;
+}
+
 void startCustomConfigPortal() {
-  WiFiManager wifiManager;  // Instancia local para evitar duplicados de parámetros
-  // Crear parámetros personalizados dentro de la función para evitar duplicados
-  WiFiManagerParameter custom_mqtt_broker("broker", "MQTT Broker", mqttBroker.c_str(), 40);
-  WiFiManagerParameter custom_mqtt_port("port", "MQTT Port", String(mqttPort).c_str(), 6);
-
-  // Agregar parámetros personalizados al WiFiManager
-  wifiManager.addParameter(&custom_mqtt_broker);
-  wifiManager.addParameter(&custom_mqtt_port);
-  wifiManager.setConfigPortalTimeout(WIFI_CONFIG_PORTAL_TIMEOUT);  // Configurar timeout del portal
-
-  // Iniciar portal de configuración personalizado
-  bool success = false;
-  configPortalForceActive = true;  // Marcar que el portal debe permanecer activo
-  portalStartTime = millis();      // Guardar tiempo de inicio
-
-  // Asegurarse de que el dispositivo esté completamente listo antes de iniciar el AP
-  logInfo( "🔧 Preparando portal de configuración WiFi/AP...");
-  WiFi.mode(WIFI_OFF);
-  delay(500);
-  WiFi.mode(WIFI_AP);
-  delay(500);
-  logInfo( "🔧 Modo WiFi cambiado a AP");
-
-  // Bucle para mantener el portal activo hasta guardar o timeout
-  while (configPortalForceActive && (millis() - portalStartTime < CONFIG_PORTAL_MAX_TIMEOUT)) {
-    logInfo( "🚀 Iniciando portal de configuración AP 'DropsterAWG_WiFiConfig'...");
-    unsigned long portalAttemptStart = millis();
-    success = wifiManager.startConfigPortal("DropsterAWG_WiFiConfig");    // Iniciar portal de configuración
-
-    if (success) {
-      // Guardar credenciales WiFi si están disponibles
-      String configuredSSID = WiFi.SSID();
-      String configuredPass = WiFi.psk();
-      if (configuredSSID.length() > 0) {
-        saveWiFiCredentials(configuredSSID, configuredPass);
-      } else {
-        logWarning( "❌ No se obtuvieron credenciales WiFi válidas del portal");
-      }
+  if (portalActive) {
+    logInfo( "🔧 Portal de configuración ya activo");
+    return;
+  }
+  if (!portalParamsAdded) {
+    portalManager.addParameter(&portalMqttBroker);
+    portalManager.addParameter(&portalMqttPort);
+    portalParamsAdded = true;
+  }
+  portalMqttBroker.setValue(mqttBroker.c_str(), 40);
+  portalMqttPort.setValue(String(mqttPort).c_str(), 6);
+  portalManager.setConfigPortalBlocking(false);
+  portalManager.setConfigPortalTimeout(WIFI_CONFIG_PORTAL_TIMEOUT);
+  portalManager.setConnectTimeout(PORTAL_CONNECT_TIMEOUT);  // Acota el bloqueo al probar credenciales nuevas
+  portalManager.setSaveParamsCallback(onPortalParamsSaved);
+  portalParamsSaved = false;
+
+  // AP+STA: la conexión actual se mantiene, así que MQTT y la telemetría no se interrumpen
+  logInfo( "🚀 Iniciando portal de configuración AP 'DropsterAWG_WiFiConfig' (no bloqueante)...");
+  WiFi.mode(WIFI_AP_STA);
+  portalManager.startConfigPortal("DropsterAWG_WiFiConfig");
+  portalActive = true;
+  portalStartTime = millis();
+  portalMaxStallMs = 0;
+  currentLedState = LED_WHITE;
+  setLedColor(COLOR_WHITE_R, COLOR_WHITE_G, COLOR_WHITE_B);
+}
 
-      // Guardar configuración MQTT si cambió
-      String newBroker = custom_mqtt_broker.getValue();
-      String newPortStr = custom_mqtt_port.getValue();
-      int newPort = newPortStr.toInt();
-      logInfo( "📡 Configuración MQTT del portal - Broker: '" + newBroker + "', Port: '" + newPortStr + "' (parsed: " + String(newPort) + ")");
+// Aplica broker/puerto del formulario. Devuelve true si cambiaron
+bool applyPortalMqttParams() {
+  String newBroker = portalMqttBroker.getValue();
+  String newPortStr = portalMqttPort.getValue();
+  int newPort = newPortStr.toInt();
+  logInfo( "📡 Configuración MQTT del portal - Broker: '" + newBroker + "', Port: '" + newPortStr + "' (parsed: " + String(newPort) + ")");
 
-      if (newBroker.length() > 0 && newPort > 0 && newPort <= 65535) {
-        if (newBroker != mqttBroker || newPort != mqttPort) {
-          preferences.begin("awg-mqtt", false);
-          preferences.putString("broker", newBroker);
-          preferences.putInt("port", newPort);
-          preferences.end();
-          mqttBroker = newBroker;
-          mqttPort = newPort;
-          logInfo( "✅ Configuración MQTT guardada desde portal:");
-          logInfo( "  📡 Broker: " + mqttBroker + ":" + String(mqttPort));
-        } else {
-          logInfo( " Configuración MQTT sin cambios");
+  if (newBroker.length() == 0 || newPort <= 0 || newPort > 65535) {
+    logWarning( "❌ Configuración MQTT inválida desde portal - usando valores anteriores");
+    return false;
+  }
+  if (newBroker == mqttBroker && newPort == mqttPort) {
+    logInfo( " Configuración MQTT sin cambios");
+    return false;
+  }
+  preferences.begin("awg-mqtt", false);
+  preferences.putString("broker", newBroker);
+  preferences.putInt("port", newPort);
+  preferences.putBool("legacy", mqttLegacyTopics);  // Ver loadMqttConfig()
+  preferences.end();
+  mqttBroker = newBroker;
+  mqttPort = newPort;
+  logInfo( "✅ Configuración MQTT guardada desde portal:");
+  logInfo( "  📡 Broker: " + mqttBroker + ":" + String(mqttPort));
+  return true;
+}
+
+void stopConfigPortal(const char* reason) {
+  portalManager.stopConfigPortal();
+  WiFi.mode(WIFI_STA);  // Apagar el AP; la conexión STA (si la hay) continúa
+  portalActive = false;
+  logInfo( "🔧 Portal de configuración cerrado (" + String(reason) + ") - bloqueo máximo del loop con portal: " + String(portalMaxStallMs) + " ms");
+  updateLedState();
+}
+
+// Llamar en cada iteración del loop. Solo bloquea al probar credenciales nuevas (PORTAL_CONNECT_TIMEOUT)
+void serviceConfigPortal() {
+  if (!portalActive) return;
+  bool connected = portalManager.process();
+
+  if (connected) {
+    // Credenciales nuevas probadas con éxito
+    String configuredSSID = WiFi.SSID();
+    String configuredPass = WiFi.psk();
+    if (configuredSSID.length() > 0) {
+      saveWiFiCredentials(configuredSSID, configuredPass);
+    } else {
+      logWarning( "❌ No se obtuvieron credenciales WiFi válidas del portal");
+    }
+    applyPortalMqttParams();
+    portalParamsSaved = false;
+    stopConfigPortal("guardado");
+    offlineMode = false;
+    mqttClient.disconnect();
+    setupMQTT();  // Red o broker nuevos
+    return;
+  }
+  if (portalParamsSaved) {
+    // Solo se guardaron parámetros MQTT: reconectar si cambiaron
+    portalParamsSaved = false;
+    if (applyPortalMqttParams() && WiFi.status() == WL_CONNECTED) {
+      mqttClient.disconnect();
+      setupMQTT();
+    }
+  }
+  if (!portalManager.getConfigPortalActive() || millis() - portalStartTime >= CONFIG_PORTAL_MAX_TIMEOUT) {
+    stopConfigPortal("timeout");
+  }
+}
+
+// Gestión de energía: fuentes de despertar y configuración inicial del gestor de ESP-IDF
+void setupPower() {
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);  // Reloj del PWM del LED durante el sueño ligero
+  // El primer flanco de un comando despierta al chip: UART0 por su pin nativo, pantalla y botón por GPIO
+  uart_set_wakeup_threshold(UART_NUM_0, 3);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  gpio_wakeup_enable((gpio_num_t)RX1_PIN, GPIO_INTR_LOW_LEVEL);
+  gpio_wakeup_enable((gpio_num_t)CONFIG_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "awg-loop", &powerCpuLock) != ESP_OK) powerCpuLock = nullptr;
+  if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awg-awake", &powerAwakeLock) != ESP_OK) powerAwakeLock = nullptr;
+  powerManager.begin();
+  applyPowerConfig();
+  logInfo( "🔋 Gestión de energía: " + String(!powerSaveEnabled ? "DESHABILITADA" : powerLightSleep ? "sueño ligero + DFS" : powerPmActive ? "solo DFS" : "solo frecuencia fija"));
+}
+
+// Aplica el escalón del gobernador. Si el firmware no admite sueño ligero automático (sin
+// tickless idle) se intenta solo DFS, y sin gestor de energía se fija la frecuencia a mano
+void applyPowerConfig() {
+  uint16_t maxMhz = powerSaveEnabled ? powerManager.freqMhz() : POWER_FREQ_STEPS_MHZ[POWER_FREQ_STEP_COUNT - 1];
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = maxMhz;
+  pm.min_freq_mhz = powerSaveEnabled ? POWER_FREQ_STEPS_MHZ[0] : maxMhz;
+  pm.light_sleep_enable = powerSaveEnabled;
+  esp_err_t err = esp_pm_configure(&pm);
+  powerLightSleep = (err == ESP_OK) && powerSaveEnabled;
+  if (err != ESP_OK && powerSaveEnabled) {
+    pm.light_sleep_enable = false;
+    err = esp_pm_configure(&pm);
+  }
+  powerPmActive = (err == ESP_OK);
+  if (!powerPmActive) setCpuFrequencyMhz(maxMhz);
+  if (powerSaveEnabled) WiFi.setSleep(true);  // Modem sleep: la radio despierta en cada DTIM y el socket MQTT sigue abierto
+}
+
+// Inicio de la parte ocupada del loop: CPU a la frecuencia máxima del gobernador
+void powerLoopBegin() {
+  powerLoopStartUs = micros();
+  if (powerPmActive && powerCpuLock && !powerCpuLockHeld) {
+    esp_pm_lock_acquire(powerCpuLock);
+    powerCpuLockHeld = true;
+  }
+}
+
+// Final del loop: contabiliza la iteración, gobierna la frecuencia y reposa hasta el próximo
+// plazo. Sin gestión de energía el loop sigue girando sin ceder la CPU, como antes
+void managePower() {
+  unsigned long now = millis();
+  bool mqttUp = mqttClient.connected();
+  PowerJob jobs[] = {
+    { lastRead, SENSOR_READ_INTERVAL, true },
+    { lastSensorStatusCheck, SENSOR_STATUS_CHECK_INTERVAL, true },
+    { lastTransmit, UART_TRANSMIT_INTERVAL, true },
+    { lastLedUpdate, LED_UPDATE_INTERVAL, true },
+    { lastMQTTTransmit, MQTT_TRANSMIT_INTERVAL, mqttUp },
+    { lastHeartbeat, HEARTBEAT_INTERVAL, mqttUp },
+    { lastMqttPing, MQTT_PING_INTERVAL, mqttUp },
+    { lastWiFiCheck, WIFI_CHECK_INTERVAL, WiFi.status() != WL_CONNECTED },
+  };
+  const uint8_t jobCount = sizeof(jobs) / sizeof(jobs[0]);
+  powerManager.trackJobs(jobs, jobCount);
+  powerManager.accountBusy(now, micros() - powerLoopStartUs);
+  if (powerManager.govern(now) && powerSaveEnabled) applyPowerConfig();
+
+  if (powerCpuLockHeld) {
+    esp_pm_lock_release(powerCpuLock);
+    powerCpuLockHeld = false;
+  }
+  if (!powerSaveEnabled) return;
+
+  // Actividad en los puertos serie, portal o calibración: sin sueño ligero. El sueño ligero
+  // pierde los primeros bytes que llegan por UART (solo sirven para despertar); la pantalla
+  // tiene su propio MCU y en cada toque envía antes una línea vacía, así que encendida no
+  // necesita mantener despierto al AWG
+  bool serialActive = now - lastSerialActivity < POWER_UART_HOLD_MS;
+  bool stayAwake = serialActive || portalActive || sensorManager.isInCalibrationMode() || otaActive();
+  if (powerAwakeLock && stayAwake != powerAwakeLockHeld) {
+    if (stayAwake) {
+      esp_pm_lock_acquire(powerAwakeLock);
+    } else {
+      esp_pm_lock_release(powerAwakeLock);
+    }
+    powerAwakeLockHeld = stayAwake;
+  }
+
+  if (Serial.available() || Serial1.available() || otaActive()) return;  // OTA: trozos y tramas sin pausa
+  uint32_t idleMs = PowerManager::idleBudget(now, jobs, jobCount, (serialActive || portalActive) ? POWER_ACTIVE_IDLE_MS : POWER_MAX_IDLE_MS);
+  if (idleMs == 0) return;
+  unsigned long idleStart = micros();
+  delay(idleMs);
+  powerManager.accountIdle(idleMs, micros() - idleStart, powerLightSleep && !stayAwake);
+}
+
+// Actualización de firmware (OTA), ver ota_package.h y tools/ota (dropster-ota)
+//
+// El paquete firmado llega por HTTP (OTA_URL + OTA_PULL: tarea en el núcleo 0 que pide
+// "Range: bytes=<punto de control>-" y reintenta con backoff) o por MQTT (OTA_PUSH: trozos
+// con offset en el tópico ota). OtaSession verifica la firma con el encabezado, antes de
+// tocar la flash, y escribe la imagen bloque a bloque en la partición de app inactiva; el
+// punto de control en NVS permite seguir tras un corte o un reinicio. Con la imagen completa
+// y su SHA-256 verificado:
+//   - destino AWG: se marca la partición para el próximo arranque y se reinicia (con el
+//     compresor parado). La imagen nueva arranca pendiente: otaHealthService() la valida si
+//     funciona (sensores, MQTT) o vuelve a la anterior; también tras OTA_MAX_PENDING_BOOTS
+//     reinicios sin validar
+//   - destino pantalla: la imagen queda en la partición inactiva y se releva por Serial1
+//     con tramas numeradas y CRC; la pantalla la instala, reinicia y reporta su versión
+//
+// La sesión la usa un solo contexto a la vez (la tarea de descarga o el loop); mientras
+// descarga, el loop solo lee el avance y es quien lo publica por MQTT.
+
+enum OtaMode : uint8_t { OTA_MODE_IDLE = 0, OTA_MODE_PULL, OTA_MODE_PUSH, OTA_MODE_DISPLAY };
+
+// Flash de la partición inactiva y punto de control en NVS (espacio "awg-ota")
+class OtaFlashSink : public OtaSink {
+ public:
+  const esp_partition_t* partition = nullptr;
+  uint32_t lastSaved = 0;  // Imagen cubierta por el último punto de control guardado
+
+  bool writeBlock(uint32_t offset, const uint8_t* data, size_t len) override {
+    size_t eraseLen = (len + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    if (partition == nullptr || offset + eraseLen > partition->size) return false;
+    if (esp_partition_erase_range(partition, offset, eraseLen) != ESP_OK) return false;
+    return esp_partition_write(partition, offset, data, len) == ESP_OK;
+  }
+
+  // Preferences propio: puede llamarse desde la tarea de descarga mientras el loop usa el global
+  void checkpoint(const OtaCheckpoint& cp) override {
+    if (cp.imageOffset - lastSaved < OTA_CHECKPOINT_EVERY_BYTES) return;
+    Preferences prefs;
+    prefs.begin("awg-ota", false);
+    prefs.putBytes("ckpt", &cp, sizeof(cp));
+    prefs.end();
+    lastSaved = cp.imageOffset;
+  }
+};
+
+const uint8_t otaPublicKey[ED25519_KEY_SIZE] = OTA_SIGNING_PUBLIC_KEY;
+OtaSession otaSession;
+OtaFlashSink otaSink;
+uint8_t* otaBuffer = nullptr;              // OTA_MAX_BLOCK_SIZE solo mientras dura una actualización
+volatile uint8_t otaMode = OTA_MODE_IDLE;
+uint8_t otaTarget = OTA_TARGET_AWG;
+String otaUrl = "";                        // OTA_URL (NVS); no cambia con una descarga en curso
+unsigned long otaStartMs = 0;
+unsigned long otaLastProgressMs = 0;
+uint32_t otaLastReported = 0;
+char otaLastError[24] = "";
+
+// Descarga HTTP (tarea del núcleo 0)
+TaskHandle_t otaPullHandle = NULL;
+volatile bool otaPullDone = false;
+volatile bool otaAbortRequested = false;
+volatile uint8_t otaPullResult = OTA_CONTINUE;
+volatile uint16_t otaPullAttempts = 0;
+
+// OTA_PUSH por MQTT
+bool otaPushRequested = false;             // Se atiende en el loop, fuera del callback de PubSubClient
+uint8_t otaPushTarget = OTA_TARGET_AWG;
+char otaPushSha[9] = "";                   // Primeros 4 bytes del SHA-256 de la imagen, en hex
+unsigned long otaLastChunkMs = 0;
+uint32_t otaAckedOffset = 0;
+bool otaNakSent = false;                   // Un solo nak por hueco: los trozos en vuelo también fallan
+bool otaNakPending = false;
+uint8_t otaPushResult = OTA_CONTINUE;
+
+// Reinicio tras una imagen AWG lista
+bool otaRebootPending = false;
+unsigned long otaRebootRequestMs = 0;
+unsigned long otaDownloadMs = 0;
+
+// Imagen nueva en verificación (arranque tras una actualización)
+bool otaPendingVerify = false;
+uint8_t otaExpectedSensors = 0;            // Sensores en línea con la imagen anterior
+String otaPendingVersion = "";
+uint32_t otaUpdateT0 = 0;                  // Hora unix del reinicio (RTC), 0 sin RTC
+uint32_t otaPendingDownloadMs = 0;
+unsigned long otaConnectedMs = 0;          // millis() al recuperar MQTT tras el arranque
+String otaBootReport = "";                 // "ok" o "rolled_back" pendiente de publicar
+String otaBootReason = "";
+
+// Relevo a la pantalla por Serial1
+enum OtaRelayPhase : uint8_t { RELAY_BEGIN, RELAY_FRAME, RELAY_END };
+uint8_t otaRelayPhase = RELAY_BEGIN;
+uint32_t otaRelayOffset = 0;
+unsigned long otaRelaySentMs = 0;
+uint8_t otaRelayRetries = 0;
+char otaRelayBuf[64];
+size_t otaRelayLineLen = 0;
+uint8_t otaRelayFrame[7 + OTA_DISPLAY_FRAME + 4];
+String otaDisplayExpected = "";            // Versión esperada tras el relevo
+unsigned long otaDisplayDeadline = 0;
+
+// Arduino valida la imagen al arrancar salvo que esto devuelva true: lo hace otaHealthService()
+bool verifyRollbackLater() {
+  return true;
+}
+
+bool otaActive() {
+  return otaMode != OTA_MODE_IDLE || otaRebootPending;
+}
+
+bool otaDisplayRelayActive() {
+  return otaMode == OTA_MODE_DISPLAY;
+}
+
+bool otaKeyConfigured() {
+  for (int i = 0; i < ED25519_KEY_SIZE; i++) {
+    if (otaPublicKey[i] != 0) return true;
+  }
+  return false;
+}
+
+uint8_t otaSensorMask() {
+  return (sensorManager.getBmeOnline() ? 1 : 0) | (sensorManager.getSht1Online() ? 2 : 0) |
+         (sensorManager.getPzemOnline() ? 4 : 0) | (sensorManager.getRtcOnline() ? 8 : 0);
+}
+
+uint32_t otaUnixTime() {
+  return rtcAvailable ? rtc.now().unixtime() : 0;
+}
+
+// {"type":"ota","state":...} en status, sin retener (el retenido es el estado del equipo)
+void otaPublish(const char* state, const char* reason = nullptr) {
+  if (!mqttClient.connected()) return;
+  StaticJsonDocument<384> doc;
+  doc["type"] = "ota";
+  doc["state"] = state;
+  doc["target"] = otaTarget == OTA_TARGET_DISPLAY ? "display" : "awg";
+  if (otaMode == OTA_MODE_DISPLAY) {
+    doc["offset"] = otaRelayOffset;
+    doc["size"] = otaSession.info().imageSize;
+  } else if (otaSession.headerVerified()) {
+    doc["offset"] = otaSession.resumeOffset();
+    doc["size"] = otaSession.packageSize();
+    doc["version"] = (const char*)otaSession.info().version;
+  } else {
+    doc["offset"] = 0;
+  }
+  if (reason) doc["reason"] = reason;
+  if (otaMode == OTA_MODE_PULL) doc["attempts"] = otaPullAttempts;
+  if (otaStartMs) doc["elapsed_ms"] = millis() - otaStartMs;
+  char buffer[384];
+  size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  if (len > 0 && len < sizeof(buffer)) mqttClient.publish(mqttTopics.status, buffer, false);
+}
+
+void otaClearCheckpoint() {
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  prefs.remove("ckpt");
+  prefs.remove("ckpt_src");
+  prefs.end();
+}
+
+// Prepara la sesión sobre la partición inactiva y retoma el punto de control si corresponde
+// a la misma fuente (URL o hash del paquete), destino y partición
+bool otaBegin(uint8_t mode, uint8_t target, const String& source) {
+  if (!otaKeyConfigured()) {
+    otaPublish("error", "no_key");
+    return false;
+  }
+  if (otaPendingVerify) {
+    otaPublish("error", "pending_verify");  // La partición inactiva guarda la imagen anterior
+    return false;
+  }
+  const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+  if (partition == nullptr) {
+    otaPublish("error", "no_partition");  // Esquema de particiones sin slot OTA
+    return false;
+  }
+  if (otaBuffer == nullptr) otaBuffer = (uint8_t*)malloc(OTA_MAX_BLOCK_SIZE);
+  if (otaBuffer == nullptr) {
+    otaPublish("error", "memory");
+    return false;
+  }
+  otaSink.partition = partition;
+  otaSink.lastSaved = 0;
+  otaTarget = target;
+  otaSession.begin(&otaSink, otaPublicKey, target, partition->size, otaBuffer);
+
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  OtaCheckpoint cp;
+  String savedSource = prefs.getString("ckpt_src", "");
+  String savedPartition = prefs.getString("ckpt_part", "");
+  bool resumed = false;
+  if (prefs.getBytesLength("ckpt") == sizeof(cp) && savedSource == source && savedPartition == partition->label) {
+    prefs.getBytes("ckpt", &cp, sizeof(cp));
+    resumed = cp.header[5] == target && otaSession.restore(cp);
+    if (resumed) otaSink.lastSaved = cp.imageOffset;
+  }
+  if (!resumed) {
+    prefs.remove("ckpt");
+    prefs.putString("ckpt_src", source);
+    prefs.putString("ckpt_part", partition->label);
+  }
+  prefs.end();
+
+  otaMode = mode;
+  otaStartMs = millis();
+  otaLastProgressMs = otaStartMs;
+  otaLastReported = otaSession.resumeOffset();
+  otaLastError[0] = '\0';
+  logInfo("⬇️ OTA " + String(target == OTA_TARGET_DISPLAY ? "pantalla" : "AWG") + " en " + String(partition->label) +
+          (resumed ? " desde el byte " + String(otaSession.resumeOffset()) : String("")));
+  return true;
+}
+
+void otaEnd() {
+  if (otaMode == OTA_MODE_PUSH) {
+    mqttClient.unsubscribe(mqttTopics.ota);
+    mqttClient.setBufferSize(1024);
+  }
+  otaMode = OTA_MODE_IDLE;
+  otaStartMs = 0;
+  if (otaBuffer) {
+    free(otaBuffer);
+    otaBuffer = nullptr;
+  }
+}
+
+// Descarga con reanudación, igual que PullClient de tools/ota: cada intento pide desde el
+// último bloque escrito; un intento con avance reinicia el backoff
+void otaPullTask(void* arg) {
+  (void)arg;
+  HTTPClient http;
+  const char* headerKeys[] = {"Content-Range"};
+  static uint8_t buf[1460];
+  unsigned long backoff = OTA_PULL_RETRY_MIN_MS;
+  int stalled = 0;
+  OtaResult result = OTA_CONTINUE;
+  while (!otaAbortRequested) {
+    uint32_t start = otaSession.resumeOffset();
+    otaPullAttempts++;
+    http.setReuse(false);
+    http.setTimeout(OTA_PULL_TIMEOUT_MS);
+    if (http.begin(otaUrl)) {
+      http.collectHeaders(headerKeys, 1);
+      if (start > 0) http.addHeader("Range", "bytes=" + String(start) + "-");
+      int code = http.GET();
+      uint32_t skip = 0;
+      bool ok = code == 200;
+      if (code == 200) {
+        skip = start;  // El servidor ignoró el Range
+      } else if (code == 206) {
+        String range = http.header("Content-Range");  // "bytes N-M/T"
+        ok = range.startsWith("bytes ") && strtoul(range.c_str() + 6, nullptr, 10) == start;
+        if (!ok) result = OTA_ERR_OFFSET;
+      }
+      if (ok) {
+        WiFiClient* stream = http.getStreamPtr();
+        unsigned long lastData = millis();
+        while (!otaAbortRequested && result == OTA_CONTINUE) {
+          int avail = stream->available();
+          if (avail <= 0) {
+            if (!stream->connected() || millis() - lastData > OTA_PULL_TIMEOUT_MS) break;
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+          }
+          int n = stream->read(buf, avail < (int)sizeof(buf) ? avail : (int)sizeof(buf));
+          if (n <= 0) continue;
+          lastData = millis();
+          const uint8_t* p = buf;
+          size_t len = (size_t)n;
+          if (skip > 0) {
+            size_t drop = skip < len ? skip : len;
+            skip -= drop;
+            p += drop;
+            len -= drop;
+          }
+          if (len > 0) result = otaSession.feed(p, len);
         }
-      } else {
-        logWarning( "❌ Configuración MQTT inválida desde portal - usando valores anteriores");
       }
-
-      // Salir del bucle si el portal se cerró exitosamente
-      configPortalForceActive = false;
+      http.end();
+    }
+    if (result != OTA_CONTINUE || otaAbortRequested) break;
+    otaSession.rewind();
+    if (otaSession.resumeOffset() > start) {
+      stalled = 0;
+      backoff = OTA_PULL_RETRY_MIN_MS;
+    } else if (++stalled >= OTA_PULL_MAX_STALLED) {
       break;
+    }
+    for (unsigned long waited = 0; waited < backoff && !otaAbortRequested; waited += 100) vTaskDelay(pdMS_TO_TICKS(100));
+    backoff = min(backoff * 2, (unsigned long)OTA_PULL_RETRY_MAX_MS);
+  }
+  otaPullResult = result;
+  otaPullDone = true;
+  otaPullHandle = NULL;
+  vTaskDelete(NULL);
+}
+
+void otaStartPull(uint8_t target) {
+  if (otaActive()) {
+    otaPublish("error", "busy");
+    return;
+  }
+  if (otaUrl.length() == 0 || WiFi.status() != WL_CONNECTED) {
+    otaPublish("error", otaUrl.length() == 0 ? "no_url" : "no_wifi");
+    return;
+  }
+  if (!otaBegin(OTA_MODE_PULL, target, otaUrl)) return;
+  otaPullDone = false;
+  otaAbortRequested = false;
+  otaPullAttempts = 0;
+  if (xTaskCreatePinnedToCore(otaPullTask, "ota_pull", OTA_PULL_TASK_STACK, NULL, 1, &otaPullHandle, 0) != pdPASS) {
+    otaEnd();
+    otaPublish("error", "task");
+    return;
+  }
+  otaPublish("downloading");
+}
+
+// "OTA_PUSH [awg|display] [sha]": el envío por MQTT arranca en el loop (buffer y suscripción)
+void otaRequestPush(const String& args) {
+  String rest = args;
+  rest.trim();
+  otaPushTarget = OTA_TARGET_AWG;
+  if (rest.startsWith("display")) {
+    otaPushTarget = OTA_TARGET_DISPLAY;
+    rest = rest.substring(7);
+  } else if (rest.startsWith("awg")) {
+    rest = rest.substring(3);
+  }
+  rest.trim();
+  strlcpy(otaPushSha, rest.c_str(), sizeof(otaPushSha));
+  otaPushRequested = true;
+}
+
+void otaStartPush() {
+  otaPushRequested = false;
+  if (otaMode == OTA_MODE_PUSH) {
+    // El emisor volvió a conectarse: sigue desde el último bloque escrito
+    otaSession.rewind();
+  } else {
+    if (otaActive()) {
+      otaPublish("error", "busy");
+      return;
+    }
+    if (!otaBegin(OTA_MODE_PUSH, otaPushTarget, String("push:") + otaPushSha)) return;
+    if (!mqttClient.setBufferSize(OTA_MQTT_BUFFER_SIZE)) {
+      otaEnd();
+      otaPublish("error", "memory");
+      return;
+    }
+  }
+  mqttClient.subscribe(mqttTopics.ota);
+  otaLastChunkMs = millis();
+  otaAckedOffset = otaSession.resumeOffset();
+  otaNakSent = false;
+  otaNakPending = false;
+  otaPushResult = OTA_CONTINUE;
+  otaAbortRequested = false;
+  otaPublish("ready");
+}
+
+// Trozo de OTA_PUSH: offset u32 little-endian + datos. Corre dentro del callback de MQTT,
+// así que solo alimenta la sesión; las respuestas salen de otaService()
+void otaHandleChunk(const uint8_t* payload, unsigned int length) {
+  if (otaMode != OTA_MODE_PUSH || otaPushResult != OTA_CONTINUE || length < 4) return;
+  otaLastChunkMs = millis();
+  uint32_t offset = otaReadU32(payload);
+  OtaResult result = otaSession.feedAt(offset, payload + 4, length - 4);
+  if (result == OTA_ERR_OFFSET && otaSession.result() == OTA_CONTINUE) {
+    // Hueco (trozo perdido, QoS 0): se descarta el bloque a medias y se pide desde el último escrito
+    otaSession.rewind();
+    if (!otaNakSent) {
+      otaNakSent = true;
+      otaNakPending = true;
+    }
+    return;
+  }
+  if (offset <= otaSession.position()) otaNakSent = false;
+  otaPushResult = result;
+}
+
+// Imagen AWG lista: arranque desde la partición nueva y estado pendiente para verificarla
+void otaApplyAwgImage() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_err_t err = esp_ota_set_boot_partition(otaSink.partition);  // Verifica además el formato de la imagen
+  if (err != ESP_OK) {
+    otaPublish("error", "boot_partition");
+    otaClearCheckpoint();
+    otaEnd();
+    return;
+  }
+  otaDownloadMs = millis() - otaStartMs;
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  prefs.remove("ckpt");
+  prefs.putBool("pending", true);
+  prefs.putString("part", otaSink.partition->label);
+  prefs.putString("prev", running->label);
+  prefs.putString("version", otaSession.info().version);
+  prefs.putUChar("sensors", otaSensorMask());
+  prefs.putUInt("dl_ms", otaDownloadMs);
+  prefs.putUChar("boots", 0);
+  prefs.end();
+  otaPublish("done");
+  otaEnd();
+  otaRebootPending = true;
+  otaRebootRequestMs = millis();
+  logInfo("✅ OTA AWG lista (" + String(otaDownloadMs) + " ms); reinicio con el compresor parado");
+}
+
+// Reinicio diferido: el compresor no se corta a mitad de un ciclo salvo tras OTA_REBOOT_MAX_WAIT_MS
+void otaServiceReboot() {
+  bool compressorOn = digitalRead(COMPRESSOR_RELAY_PIN) == LOW;
+  if (compressorOn && millis() - otaRebootRequestMs < OTA_REBOOT_MAX_WAIT_MS) return;
+  digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
+  digitalWrite(VENTILADOR_RELAY_PIN, HIGH);
+  digitalWrite(COMPRESSOR_FAN_RELAY_PIN, HIGH);
+  digitalWrite(PUMP_RELAY_PIN, HIGH);
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  prefs.putUInt("t0", otaUnixTime());
+  prefs.end();
+  saveSystemStats();
+  logInfo("🔄 Reiniciando con el firmware nuevo");
+  mqttClient.loop();
+  delay(200);
+  ESP.restart();
+}
+
+void otaStartDisplayRelay() {
+  otaAbortRequested = false;
+  if (otaMode == OTA_MODE_PUSH) {
+    mqttClient.unsubscribe(mqttTopics.ota);
+    mqttClient.setBufferSize(1024);
+  }
+  otaMode = OTA_MODE_DISPLAY;
+  otaRelayPhase = RELAY_BEGIN;
+  otaRelayOffset = 0;
+  otaRelayRetries = 0;
+  otaRelaySentMs = 0;
+  otaRelayLineLen = 0;
+  otaClearCheckpoint();  // La imagen ya está completa en la partición
+  otaPublish("staged");
+}
+
+void otaRelayFail(const char* reason) {
+  Serial1.println("OTA_ABORT");
+  otaPublish("error", reason);
+  strlcpy(otaLastError, reason, sizeof(otaLastError));
+  otaEnd();
+  logError("❌ Relevo OTA a la pantalla: " + String(reason));
+}
+
+// Trama: 0xA5, longitud u16, offset u32, datos, CRC-32 de longitud+offset+datos (LE)
+void otaRelaySend() {
+  const OtaPackageInfo& info = otaSession.info();
+  if (otaRelayPhase == RELAY_BEGIN) {
+    char shaHex[SHA256_DIGEST_SIZE * 2 + 1];
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) snprintf(shaHex + 2 * i, 3, "%02x", info.imageSha256[i]);
+    Serial1.printf("OTA_BEGIN %u %s\n", (unsigned)info.imageSize, shaHex);
+  } else {
+    uint32_t left = info.imageSize - otaRelayOffset;
+    uint16_t len = otaRelayPhase == RELAY_END ? 0 : (uint16_t)(left < OTA_DISPLAY_FRAME ? left : OTA_DISPLAY_FRAME);
+    otaRelayFrame[0] = 0xA5;
+    otaRelayFrame[1] = (uint8_t)len;
+    otaRelayFrame[2] = (uint8_t)(len >> 8);
+    otaWriteU32(otaRelayFrame + 3, otaRelayOffset);
+    if (len > 0 && esp_partition_read(otaSink.partition, otaRelayOffset, otaRelayFrame + 7, len) != ESP_OK) {
+      otaRelayFail("read");
+      return;
+    }
+    otaWriteU32(otaRelayFrame + 7 + len, crc32_le(0, otaRelayFrame + 1, 6 + len));
+    Serial1.write(otaRelayFrame, 7 + len + 4);
+  }
+  otaRelaySentMs = millis();
+}
+
+void otaRelayLine(const char* line) {
+  const OtaPackageInfo& info = otaSession.info();
+  if (strncmp(line, "OTA_READY", 9) == 0 || strncmp(line, "OTA_ACK ", 8) == 0 || strncmp(line, "OTA_NAK ", 8) == 0) {
+    bool nak = line[4] == 'N';
+    uint32_t offset = strncmp(line, "OTA_READY", 9) == 0 ? 0 : strtoul(line + 8, nullptr, 10);
+    if (offset > info.imageSize) return;
+    if (nak || offset == otaRelayOffset) {
+      otaRelayRetries++;
     } else {
-      logWarning( "❌ Portal de configuración falló o timeout, reintentando...");
+      otaRelayRetries = 0;
+    }
+    if (otaRelayRetries > OTA_DISPLAY_MAX_RETRIES) {
+      otaRelayFail("display_nak");
+      return;
+    }
+    otaRelayOffset = offset;
+    otaRelayPhase = offset == info.imageSize ? RELAY_END : RELAY_FRAME;
+    otaRelaySend();
+    if (millis() - otaLastProgressMs >= OTA_PROGRESS_INTERVAL_MS) {
+      otaLastProgressMs = millis();
+      otaPublish("display");
+    }
+  } else if (strcmp(line, "OTA_DONE") == 0) {
+    // La pantalla verificó el SHA-256 y reinicia: confirma con DISPLAY_FW al validarse
+    otaDisplayExpected = String(info.version);
+    otaDisplayExpected.toLowerCase();
+    otaDisplayDeadline = millis() + OTA_DISPLAY_BOOT_TIMEOUT_MS;
+    otaPublish("display_installed");
+    otaEnd();
+  } else if (strncmp(line, "OTA_FAIL", 8) == 0) {
+    otaRelayFail(line[8] ? line + 9 : "display_fail");
+  } else if (line[0] != '\0') {
+    String cmd(line);
+    sensorManager.processCommand(cmd);  // Comandos de la pantalla durante el relevo
+  }
+}
 
-      // Verificar si se alcanzó el timeout máximo
-      if (millis() - portalStartTime >= CONFIG_PORTAL_MAX_TIMEOUT) {
-        logWarning( "⏰ Timeout máximo de portal de configuración alcanzado (2 minutos)");
-        configPortalForceActive = false;
-        break;
+// Relevo paso a paso desde el loop: reemplaza a handleCommands() en Serial1 mientras dura
+void otaDisplayService() {
+  while (Serial1.available()) {
+    char c = (char)Serial1.read();
+    lastSerialActivity = millis();
+    if (c == '\n') {
+      otaRelayBuf[otaRelayLineLen] = '\0';
+      otaRelayLineLen = 0;
+      otaRelayLine(otaRelayBuf);
+      if (otaMode != OTA_MODE_DISPLAY) return;
+    } else if (c != '\r' && otaRelayLineLen < sizeof(otaRelayBuf) - 1) {
+      otaRelayBuf[otaRelayLineLen++] = c;
+    }
+  }
+  unsigned long timeout = otaRelayPhase == RELAY_BEGIN ? 5000UL : OTA_DISPLAY_ACK_TIMEOUT_MS;
+  if (otaRelaySentMs == 0 || millis() - otaRelaySentMs >= timeout) {
+    if (otaRelaySentMs != 0 && ++otaRelayRetries > OTA_DISPLAY_MAX_RETRIES) {
+      otaRelayFail("display_timeout");
+      return;
+    }
+    otaRelaySend();
+  }
+}
+
+// Resultado de una descarga o de un envío por MQTT
+void otaComplete(OtaResult result) {
+  if (result == OTA_DONE) {
+    if (otaTarget == OTA_TARGET_AWG) {
+      otaApplyAwgImage();
+    } else {
+      otaStartDisplayRelay();
+    }
+    return;
+  }
+  const char* reason = result == OTA_CONTINUE ? (otaAbortRequested ? "aborted" : "stalled") : otaResultName(result);
+  strlcpy(otaLastError, reason, sizeof(otaLastError));
+  // Paquete inválido: el punto de control no sirve. Corte o abandono: se retoma después
+  if (result != OTA_CONTINUE) otaClearCheckpoint();
+  otaPublish("error", reason);
+  logError("❌ OTA: " + String(reason));
+  otaEnd();
+}
+
+// Arranque: imagen nueva pendiente de verificar, reversión por reinicios repetidos o aviso de
+// que se volvió a la anterior. Antes de leer sensores o conectar
+void otaBootCheck() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  otaUrl = prefs.getString("url", "");
+  if (prefs.getBool("pending", false)) {
+    otaPendingVersion = prefs.getString("version", "");
+    if (prefs.getString("part", "") != running->label) {
+      // Arrancó la imagen anterior: reversión del bootloader o de otaRollback()
+      otaBootReport = "rolled_back";
+      otaBootReason = prefs.getString("rb_reason", "bootloader");
+      prefs.putBool("pending", false);
+      prefs.remove("rb_reason");
+    } else {
+      uint8_t boots = prefs.getUChar("boots", 0) + 1;
+      prefs.putUChar("boots", boots);
+      otaPendingVerify = true;
+      otaExpectedSensors = prefs.getUChar("sensors", 0);
+      otaUpdateT0 = prefs.getUInt("t0", 0);
+      otaPendingDownloadMs = prefs.getUInt("dl_ms", 0);
+      if (boots > OTA_MAX_PENDING_BOOTS) {
+        prefs.end();
+        otaRollback("crash_loop");
+        return;
       }
-      delay(1000);
     }
   }
-  configPortalForceActive = false;  // Asegurar que el flag se resetee
-  WiFi.mode(WIFI_STA);              // Cambiar de vuelta a modo station para reconectar
+  prefs.end();
+  // Imagen sin actualización pendiente (flasheada por cable o ya validada)
+  if (!otaPendingVerify) esp_ota_mark_app_valid_cancel_rollback();
+}
+
+// Vuelve a la imagen anterior. Sin soporte de reversión en el bootloader, cambia la partición
+// de arranque a mano
+void otaRollback(const char* reason) {
+  logError("↩️ OTA: volviendo al firmware anterior (" + String(reason) + ")");
+  Preferences prefs;
+  prefs.begin("awg-ota", false);
+  prefs.putString("rb_reason", reason);
+  String prev = prefs.getString("prev", "");
+  prefs.end();
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+  const esp_partition_t* previous = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev.c_str());
+  if (previous != nullptr && esp_ota_set_boot_partition(previous) == ESP_OK) ESP.restart();
+  logError("❌ OTA: no hay imagen anterior a la que volver");
+}
+
+// Imagen nueva: válida cuando lleva OTA_HEALTH_MIN_UPTIME_MS funcionando, con los sensores que
+// tenía la anterior y MQTT conectado. Sin eso en OTA_HEALTH_TIMEOUT_MS, se revierte
+void otaHealthService() {
+  unsigned long up = millis();
+  bool mqttUp = mqttClient.connected();
+  if (mqttUp && otaConnectedMs == 0) otaConnectedMs = up;
+  bool sensorsOk = (otaSensorMask() & otaExpectedSensors) == otaExpectedSensors;
+  if (up >= OTA_HEALTH_MIN_UPTIME_MS && sensorsOk && mqttUp) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    Preferences prefs;
+    prefs.begin("awg-ota", false);
+    prefs.putBool("pending", false);
+    prefs.putUChar("boots", 0);
+    prefs.end();
+    otaPendingVerify = false;
+    otaBootReport = "ok";
+    logInfo("✅ OTA: firmware " + otaPendingVersion + " validado");
+    return;
+  }
+  if (up >= OTA_HEALTH_TIMEOUT_MS) otaRollback(!mqttUp ? "health_mqtt" : sensorsOk ? "health" : "health_sensors");
+}
+
+void otaPublishBootReport() {
+  StaticJsonDocument<256> doc;
+  doc["type"] = "ota";
+  doc["state"] = otaBootReport.c_str();
+  doc["target"] = "awg";
+  doc["version"] = otaBootReport == "ok" ? otaPendingVersion.c_str() : FIRMWARE_VERSION;
+  if (otaBootReport == "ok") {
+    // Corte de servicio: del reinicio a MQTT de vuelta (con RTC) y descarga previa
+    uint32_t now = otaUnixTime();
+    if (otaUpdateT0 > 0 && now >= otaUpdateT0) doc["downtime_s"] = now - otaUpdateT0 - (millis() - otaConnectedMs) / 1000;
+    doc["boot_to_mqtt_ms"] = otaConnectedMs;
+    doc["download_ms"] = otaPendingDownloadMs;
+  } else {
+    doc["reason"] = otaBootReason.c_str();
+  }
+  char buffer[256];
+  size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  if (len > 0 && len < sizeof(buffer) && mqttClient.publish(mqttTopics.status, buffer, false)) otaBootReport = "";
+}
+
+// Una vez por iteración del loop
+void otaService() {
+  if (otaPendingVerify) otaHealthService();
+  if (otaBootReport.length() > 0 && !otaPendingVerify && mqttClient.connected()) otaPublishBootReport();
+  if (otaRebootPending) {
+    otaServiceReboot();
+    return;
+  }
+  if (otaPushRequested && mqttClient.connected()) otaStartPush();
+
+  if (otaMode == OTA_MODE_PULL && otaPullDone) {
+    otaComplete((OtaResult)otaPullResult);
+  } else if (otaMode == OTA_MODE_PUSH) {
+    if (otaAbortRequested) {
+      otaPublish("error", "aborted");
+      strlcpy(otaLastError, "aborted", sizeof(otaLastError));
+      otaEnd();
+    } else if (otaNakPending) {
+      otaNakPending = false;
+      otaPublish("nak");
+    } else if (otaPushResult != OTA_CONTINUE) {
+      otaComplete((OtaResult)otaPushResult);
+      return;
+    } else if (otaSession.resumeOffset() != otaAckedOffset) {
+      otaAckedOffset = otaSession.resumeOffset();
+      otaPublish("receiving");  // Confirma cada bloque: el emisor avanza su ventana
+    } else if (millis() - otaLastChunkMs >= OTA_MQTT_IDLE_TIMEOUT_MS) {
+      otaPublish("error", "timeout");  // El punto de control queda para un OTA_PUSH posterior
+      strlcpy(otaLastError, "timeout", sizeof(otaLastError));
+      otaEnd();
+    }
+  } else if (otaMode == OTA_MODE_DISPLAY) {
+    if (otaAbortRequested) {
+      otaRelayFail("aborted");
+    } else {
+      otaDisplayService();
+    }
+  }
+
+  if (otaMode == OTA_MODE_PULL && millis() - otaLastProgressMs >= OTA_PROGRESS_INTERVAL_MS &&
+      otaSession.resumeOffset() != otaLastReported) {
+    otaLastProgressMs = millis();
+    otaLastReported = otaSession.resumeOffset();
+    otaPublish("downloading");
+  }
+  if (otaDisplayDeadline != 0 && (long)(millis() - otaDisplayDeadline) >= 0) {
+    otaDisplayDeadline = 0;
+    otaTarget = OTA_TARGET_DISPLAY;
+    otaPublish("error", "display_no_boot");
+  }
+}
+
+// "DISPLAY_FW <versión>": la pantalla arrancó (y, tras un relevo, validó su imagen)
+void otaDisplayReported(const String& version) {
+  displayFirmwareVersion = version;
+  if (otaDisplayDeadline == 0) return;
+  otaDisplayDeadline = 0;
+  otaTarget = OTA_TARGET_DISPLAY;
+  if (version == otaDisplayExpected) {
+    otaPublish("done");
+  } else {
+    otaPublish("error", "display_rolled_back");
+  }
+}
+
+// Comandos OTA_* (por MQTT, Serial o la pantalla). Llegan sin pasar a minúsculas: la ruta
+// de OTA_URL las distingue
+void otaCommand(const String& raw) {
+  int space = raw.indexOf(' ');
+  String name = space < 0 ? raw : raw.substring(0, space);
+  String arg = space < 0 ? String("") : raw.substring(space + 1);
+  name.toLowerCase();
+  arg.trim();
+  if (name != "ota_url") arg.toLowerCase();
+
+  if (name == "ota_url") {
+    if (otaMode == OTA_MODE_PULL || !(arg.startsWith("http://") || arg.length() == 0)) {
+      otaPublish("error", otaMode == OTA_MODE_PULL ? "busy" : "url");
+      return;
+    }
+    otaUrl = arg;
+    preferences.begin("awg-ota", false);
+    preferences.putString("url", otaUrl);
+    preferences.end();
+    otaClearCheckpoint();
+    logInfo("🔗 OTA_URL: " + (otaUrl.length() ? otaUrl : String("(ninguna)")));
+  } else if (name == "ota_pull") {
+    otaStartPull(arg == "display" ? OTA_TARGET_DISPLAY : OTA_TARGET_AWG);
+  } else if (name == "ota_push") {
+    otaRequestPush(arg);
+  } else if (name == "ota_abort") {
+    // Lo cierra otaService(): puede llegar dentro del callback de MQTT, que no admite cambiar
+    // el buffer de PubSubClient
+    if (otaMode != OTA_MODE_IDLE) otaAbortRequested = true;
+  } else if (name == "ota_status") {
+    const char* state = otaMode == OTA_MODE_PULL      ? "downloading"
+                        : otaMode == OTA_MODE_PUSH    ? "receiving"
+                        : otaMode == OTA_MODE_DISPLAY ? "display"
+                        : otaPendingVerify            ? "verifying"
+                        : otaLastError[0]             ? "error"
+                                                      : "idle";
+    otaPublish(state, strcmp(state, "error") == 0 ? otaLastError : nullptr);
+  }
 }
 
 void loadAlertConfig() {
@@ -3601,6 +5317,366 @@ void loadAlertConfig() {
   preferences.end();
 }
 
+// Perfil de memoria: heap, pila por tarea y tendencia entre arranques (mem_profile.h)
+#define MEM_TASKS_MAX 8
+#define MEM_TREND_PUBLISH 16  // Muestras por mensaje (buffer de PubSubClient de 1024)
+
+// Nombres cortos de esp_reset_reason_t
+const char* memResetReasonName(uint8_t reason) {
+  static const char* const names[] = { "unknown", "poweron", "ext", "sw", "panic", "int_wdt",
+                                       "task_wdt", "wdt", "deepsleep", "brownout", "sdio" };
+  return reason < sizeof(names) / sizeof(names[0]) ? names[reason] : "unknown";
+}
+
+void memSaveTrend() {
+  preferences.begin("awg-mem", false);
+  preferences.putBytes("trend", &memTrend, sizeof(memTrend));
+  preferences.end();
+}
+
+void memInit() {
+  memLoopTask = xTaskGetCurrentTaskHandle();
+  memResetReason = (uint8_t)esp_reset_reason();
+  preferences.begin("awg-mem", true);
+  size_t len = preferences.getBytes("trend", &memTrend, sizeof(memTrend));
+  preferences.end();
+  if (len != sizeof(memTrend) || !memTrend.valid()) memTrend.reset();
+  memTrend.boot++;
+  memSaveTrend();
+  logInfo("🧠 Arranque #" + String(memTrend.boot) + " (reinicio: " + memResetReasonName(memResetReason) +
+          "), heap libre " + String(heap_caps_get_free_size(MALLOC_CAP_8BIT)) + " bytes");
+}
+
+void memResetStats() {
+  uint16_t boot = memTrend.boot;
+  memProfiler.resetCounters();
+  memTrend.reset();
+  memTrend.boot = boot;
+  memSaveTrend();
+}
+
+// Margen mínimo de pila (bytes) del loop, de la descarga OTA, del supervisor y de las tareas del SDK que existan
+int memStackMarks(const char* names[MEM_TASKS_MAX], uint32_t marks[MEM_TASKS_MAX]) {
+  static const char* const sdkTasks[] = { "wifi", "tiT", "sys_evt", "arduino_events", "esp_timer" };
+  int count = 0;
+  names[count] = "loop";
+  marks[count++] = uxTaskGetStackHighWaterMark(memLoopTask);
+  TaskHandle_t ota = otaPullHandle;
+  if (ota != NULL && !otaPullDone) {
+    names[count] = "ota_pull";
+    marks[count++] = uxTaskGetStackHighWaterMark(ota);
+  }
+  if (safetyTaskHandle != NULL) {
+    names[count] = "safety";
+    marks[count++] = uxTaskGetStackHighWaterMark(safetyTaskHandle);
+  }
+  for (size_t i = 0; i < sizeof(sdkTasks) / sizeof(sdkTasks[0]) && count < MEM_TASKS_MAX; i++) {
+    TaskHandle_t handle = xTaskGetHandle(sdkTasks[i]);
+    if (handle == NULL) continue;
+    names[count] = sdkTasks[i];
+    marks[count++] = uxTaskGetStackHighWaterMark(handle);
+  }
+  return count;
+}
+
+// Resumen en system. full (MEM_STATS): además pila por tarea y subsistemas, y copia por Serial.
+// La tendencia la publica memReportTrend(), que MEM_STATS llama después de este
+void memReport(bool full) {
+  uint32_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  const char* taskNames[MEM_TASKS_MAX];
+  uint32_t taskMarks[MEM_TASKS_MAX];
+  int tasks = memStackMarks(taskNames, taskMarks);
+  int lowest = 0;
+  for (int i = 1; i < tasks; i++) {
+    if (taskMarks[i] < taskMarks[lowest]) lowest = i;
+  }
+  if (taskMarks[lowest] < MEM_STACK_WARN_BYTES) {
+    logWarning("⚠️ Pila casi agotada en " + String(taskNames[lowest]) + ": " + String(taskMarks[lowest]) + " bytes libres");
+  }
+
+  StaticJsonDocument<1024> doc;
+  doc["type"] = "mem";
+  doc["free"] = freeBytes;
+  doc["largest"] = largest;
+  doc["min_free"] = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  doc["frag"] = MemProfiler::fragmentationPct(freeBytes, largest);
+  doc["leak_bph"] = roundf(memTrend.leakBytesPerHour(memTrend.boot));
+  doc["boot"] = memTrend.boot;
+  doc["reset"] = memResetReasonName(memResetReason);
+  doc["uptime"] = millis() / 1000;
+  JsonObject stackMin = doc.createNestedObject("stack_min");
+  stackMin["task"] = taskNames[lowest];
+  stackMin["bytes"] = taskMarks[lowest];
+  if (full) {
+    JsonObject stacks = doc.createNestedObject("stacks");
+    for (int i = 0; i < tasks; i++) stacks[taskNames[i]] = taskMarks[i];
+    JsonObject subsystems = doc.createNestedObject("subsystems");
+    for (int i = 0; i < MEM_SYS_COUNT; i++) {
+      const MemSubsystemStats& st = memProfiler.stats(i);
+      JsonObject sub = subsystems.createNestedObject(MEM_SYS_NAME[i]);
+      sub["n"] = st.scopes;
+      sub["net"] = st.netBytes;
+      sub["worst"] = st.worstBytes;
+#ifdef CONFIG_HEAP_USE_HOOKS
+      sub["allocs"] = st.allocs;
+      sub["bytes"] = st.allocBytes;
+      sub["frees"] = st.frees;
+#endif
+    }
+  }
+  char buffer[900];
+  size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  bool fits = len > 0 && len < sizeof(buffer);
+  if (fits && mqttClient.connected()) mqttClient.publish(mqttTopics.system, buffer, false);
+  if (full && fits) Serial.println(buffer);
+}
+
+// Tendencia: [arranque, causa, uptime min, heap libre mín, mayor bloque mín, frag %], de la
+// más antigua a la más reciente; por MQTT solo las últimas MEM_TREND_PUBLISH
+void memReportTrend() {
+  Serial.println("=== TENDENCIA DE HEAP (arranque, causa, uptime, libre mín, bloque mín, frag) ===");
+  for (int i = 0; i < memTrend.count; i++) {
+    const MemTrendSample& sample = memTrend.at(i);
+    Serial.printf("  #%u %-9s %6lu min  %7lu B  %7lu B  %3u%%\n", (unsigned)sample.boot,
+                  memResetReasonName(sample.resetReason), (unsigned long)sample.uptimeMin, (unsigned long)sample.freeMin, (unsigned long)sample.largestMin,
+                  (unsigned)sample.fragPct);
+  }
+  StaticJsonDocument<1024> trendDoc;
+  trendDoc["type"] = "mem_trend";
+  trendDoc["interval_min"] = MEM_TREND_INTERVAL_MS / 60000UL;
+  JsonArray samples = trendDoc.createNestedArray("samples");
+  int first = memTrend.count > MEM_TREND_PUBLISH ? memTrend.count - MEM_TREND_PUBLISH : 0;
+  for (int i = first; i < memTrend.count; i++) {
+    const MemTrendSample& sample = memTrend.at(i);
+    JsonArray row = samples.createNestedArray();
+    row.add(sample.boot);
+    row.add(memResetReasonName(sample.resetReason));
+    row.add(sample.uptimeMin);
+    row.add(sample.freeMin);
+    row.add(sample.largestMin);
+    row.add(sample.fragPct);
+  }
+  char buffer[900];
+  size_t len = serializeJson(trendDoc, buffer, sizeof(buffer));
+  if (len > 0 && len < sizeof(buffer) && mqttClient.connected()) mqttClient.publish(mqttTopics.system, buffer, false);
+}
+
+// Desde loop(): lectura del heap, muestra de tendencia y resumen periódico
+void memService() {
+  static unsigned long lastSample = 0;
+  static unsigned long lastTrend = 0;
+  static unsigned long lastReport = 0;
+  unsigned long now = millis();
+  if (now - lastSample >= MEM_SAMPLE_INTERVAL_MS) {
+    lastSample = now;
+    memProfiler.observe(heap_caps_get_free_size(MALLOC_CAP_8BIT), heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  }
+  if (now - lastTrend >= MEM_TREND_INTERVAL_MS) {
+    lastTrend = now;
+    MemTrendSample sample;
+    // Minutos desde el reloj de 64 bits: con millis() la pendiente se rompería a los 49,7 días
+    uint32_t uptimeMin = (uint32_t)(esp_timer_get_time() / 60000000LL);
+    if (memProfiler.closeWindow(memTrend.boot, memResetReason, uptimeMin, &sample)) {
+      memTrend.push(sample);
+      memSaveTrend();
+    }
+  }
+  if (now - lastReport >= MEM_REPORT_INTERVAL_MS) {
+    lastReport = now;
+    memReport(false);
+  }
+}
+
+// ---------------------------------------------------------------------------------------
+// Supervisor de seguridad (safety_supervisor.h)
+//
+// Una tarea de prioridad alta con período fijo SAFETY_PERIOD_MS compara la última muestra
+// del loop y los relés con los límites y abre los relés por su cuenta. No un timer por
+// interrupción: digitalRead/digitalWrite sí, pero el registro y MQTT no son seguros ahí, y
+// el loop los hace al drenar las intervenciones en safetyService().
+
+// Límites vigentes: se recalculan con cada muestra, así siguen a SET_* y a la configuración
+SafetyLimits safetyLimits() {
+  bool autoMode = operationMode == MODE_AUTO_PID || operationMode == MODE_AUTO_TIME || operationMode == MODE_AUTO_ADAPTIVE;
+  uint32_t maxOnS = (uint32_t)max(control_max_on, timeModeCompressorOnTime);
+  SafetyLimits limits;
+  limits.compressorTempMax = maxCompressorTemp;  // Límite duro: vale aunque la alerta esté deshabilitada
+  limits.tempHysteresis = SAFETY_TEMP_HYSTERESIS_C;
+  limits.tankFullPct = alertTankFull.threshold;  // Mismo umbral que isTankFull()
+  limits.tankHysteresisPct = SAFETY_TANK_HYSTERESIS_PCT;
+  limits.maxOnMs = autoMode ? maxOnS * 1000UL + SAFETY_MAX_ON_GRACE_MS : 0;  // En manual decide el operador
+  limits.restartDelayMs = (uint32_t)control_min_off * 1000UL;
+  limits.pumpMinLiters = alertPumpLow.enabled ? alertPumpLow.threshold : NAN;
+  limits.pumpHysteresisLiters = SAFETY_PUMP_HYSTERESIS_L;
+  limits.staleMs = SAFETY_STALE_MS;
+  limits.loopStallMs = SAFETY_LOOP_STALL_MS;
+  return limits;
+}
+
+// El watchdog de tareas vigila al supervisor; el supervisor solo lo alimenta si el loop avanza
+void safetyWatchdogBegin() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_task_wdt_config_t config = { SAFETY_WDT_TIMEOUT_S * 1000, 1 << 0, true };  // Sigue vigilando el idle del núcleo 0
+  if (esp_task_wdt_reconfigure(&config) == ESP_ERR_INVALID_STATE) esp_task_wdt_init(&config);
+#else
+  esp_task_wdt_init(SAFETY_WDT_TIMEOUT_S, true);  // Ya iniciado por el core: solo cambia el plazo
+#endif
+  safetyWatchdogActive = esp_task_wdt_add(NULL) == ESP_OK;
+}
+
+// Solo lectura y escritura de pines: nada de String, registro ni MQTT desde esta tarea
+void safetyTask(void* arg) {
+  safetyWatchdogBegin();
+  TickType_t wake = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(SAFETY_PERIOD_MS));
+    SafetyInputs in;
+    in.nowMs = millis();
+    in.loopBeatMs = safetyLoopBeatMs;
+    in.compressorOn = digitalRead(COMPRESSOR_RELAY_PIN) == LOW;
+    in.pumpOn = digitalRead(PUMP_RELAY_PIN) == LOW;
+    portENTER_CRITICAL(&safetyMux);
+    SafetyActions actions = safety.tick(in);
+    portEXIT_CRITICAL(&safetyMux);
+    if (actions.compressorOff) digitalWrite(COMPRESSOR_RELAY_PIN, HIGH);
+    if (actions.pumpOff) digitalWrite(PUMP_RELAY_PIN, HIGH);
+    if (actions.feedWatchdog && safetyWatchdogActive) esp_task_wdt_reset();
+  }
+}
+
+// Al final de setup(): antes, los relés siguen apagados por initRelays()
+void safetyInit() {
+  safetyLoopBeatMs = millis();
+  safetyPublishSample();
+  if (xTaskCreatePinnedToCore(safetyTask, "safety", SAFETY_TASK_STACK, NULL, SAFETY_TASK_PRIORITY, &safetyTaskHandle,
+                              SAFETY_TASK_CORE) != pdPASS) {
+    logError("❌ Supervisor de seguridad: no se pudo crear la tarea");
+    return;
+  }
+  logInfo("🛡️ Supervisor de seguridad activo: período " + String(SAFETY_PERIOD_MS) + " ms, watchdog " + String(SAFETY_WDT_TIMEOUT_S) + " s");
+}
+
+// Desde loop(), tras cada lectura de sensores
+void safetyPublishSample() {
+  SafetyLimits limits = safetyLimits();
+  SafetySample sample = sensorManager.safetySample();
+  portENTER_CRITICAL(&safetyMux);
+  safety.configure(limits);
+  safety.publish(sample);
+  portEXIT_CRITICAL(&safetyMux);
+}
+
+bool safetyCompressorAllowed() {
+  portENTER_CRITICAL(&safetyMux);
+  bool allowed = safety.compressorAllowed();
+  portEXIT_CRITICAL(&safetyMux);
+  return allowed;
+}
+
+bool safetyPumpAllowed() {
+  portENTER_CRITICAL(&safetyMux);
+  bool allowed = safety.pumpAllowed();
+  portEXIT_CRITICAL(&safetyMux);
+  return allowed;
+}
+
+// Enciende el compresor salvo que el supervisor lo tenga enclavado. El aviso sale una vez
+// por enclavamiento: el control lo reintenta en cada lectura
+bool startCompressorRelay() {
+  static uint32_t refusedMask = 0;
+  portENTER_CRITICAL(&safetyMux);
+  uint32_t mask = safety.latchedMask() & SAFETY_COMPRESSOR_TRIPS;
+  portEXIT_CRITICAL(&safetyMux);
+  if (mask) {
+    if (mask != refusedMask) {
+      String reasons;
+      for (uint8_t trip = 0; trip < SAFETY_TRIP_COUNT; trip++) {
+        if (mask & (1u << trip)) reasons += String(reasons.length() ? "," : "") + SAFETY_TRIP_NAME[trip];
+      }
+      logWarning("🚫 SEGURIDAD: Compresor NO encendido - Enclavado por el supervisor: " + reasons);
+    }
+    refusedMask = mask;
+    return false;
+  }
+  refusedMask = 0;
+  digitalWrite(COMPRESSOR_RELAY_PIN, LOW);
+  return true;
+}
+
+// Desde loop(): registra cada intervención con su tiempo de reacción y deja el estado del
+// control como si el loop mismo hubiera apagado
+void safetyService() {
+  SafetyEvent event;
+  for (;;) {
+    portENTER_CRITICAL(&safetyMux);
+    bool pending = safety.popEvent(&event);
+    portEXIT_CRITICAL(&safetyMux);
+    if (!pending) break;
+    const char* trip = SAFETY_TRIP_NAME[event.trip];
+    const char* actuator = SAFETY_ACTUATOR_NAME[event.actuator];
+    logWarning("🛑 SUPERVISOR: " + String(event.actuator == SAFETY_COMPRESSOR ? "Compresor" : "Bomba") + " apagado por " + trip +
+               " (valor " + String(event.value, 1) + ") - reacción " + String(event.reactionMs) + " ms");
+    if (event.actuator == SAFETY_COMPRESSOR) {
+      compressorProtectionActive = false;  // Sin corriente por el corte, no por un arranque fallido
+      compressorOnStart = 0;
+      if (mqttClient.connected()) mqttClient.publish(mqttTopics.status, "COMP_OFF");
+    }
+    StaticJsonDocument<192> doc;
+    doc["type"] = "safety_trip";
+    doc["trip"] = trip;
+    doc["actuator"] = actuator;
+    doc["value"] = event.value;
+    doc["reaction_ms"] = event.reactionMs;
+    doc["uptime_ms"] = event.atMs;
+    char buffer[192];
+    size_t len = serializeJson(doc, buffer, sizeof(buffer));
+    if (len > 0 && len < sizeof(buffer) && mqttClient.connected()) mqttClient.publish(mqttTopics.system, buffer, false);
+    publishState();
+  }
+}
+
+// SAFETY_STATUS: enclavamientos, intervenciones y tiempos de reacción por límite
+void safetyReport() {
+  SafetySupervisor snapshot;
+  portENTER_CRITICAL(&safetyMux);
+  snapshot = safety;
+  portEXIT_CRITICAL(&safetyMux);
+  StaticJsonDocument<768> doc;
+  doc["type"] = "safety_status";
+  doc["period_ms"] = SAFETY_PERIOD_MS;
+  doc["running"] = safetyTaskHandle != NULL;
+  doc["watchdog"] = (bool)safetyWatchdogActive;
+  doc["ticks"] = snapshot.ticks();
+  doc["max_tick_gap_ms"] = snapshot.maxTickGapMs();
+  doc["loop_stall_max_ms"] = snapshot.loopStallMaxMs();
+  doc["wdt_held_ticks"] = snapshot.watchdogHeldTicks();
+  doc["dropped"] = snapshot.droppedEvents();
+  doc["compressor_allowed"] = snapshot.compressorAllowed();
+  doc["pump_allowed"] = snapshot.pumpAllowed();
+  JsonObject trips = doc.createNestedObject("trips");
+  Serial.printf("Supervisor de seguridad: %s, período %lu ms, %lu ticks, mayor intervalo %lu ms\n",
+                safetyTaskHandle ? "ACTIVO" : "INACTIVO", (unsigned long)SAFETY_PERIOD_MS,
+                (unsigned long)snapshot.ticks(), (unsigned long)snapshot.maxTickGapMs());
+  Serial.printf("  Watchdog: %s, loop sin latir hasta %lu ms, %lu ticks sin alimentarlo\n",
+                safetyWatchdogActive ? "ACTIVO" : "INACTIVO", (unsigned long)snapshot.loopStallMaxMs(),
+                (unsigned long)snapshot.watchdogHeldTicks());
+  for (uint8_t trip = 0; trip < SAFETY_TRIP_COUNT; trip++) {
+    const SafetyTripStats& s = snapshot.stats(trip);
+    JsonObject t = trips.createNestedObject(SAFETY_TRIP_NAME[trip]);
+    t["latched"] = snapshot.latched(trip);
+    t["count"] = s.count;
+    t["last_ms"] = s.lastReactionMs;
+    t["max_ms"] = s.maxReactionMs;
+    Serial.printf("  %-10s %s  intervenciones %lu, reacción última %lu ms, máx %lu ms\n", SAFETY_TRIP_NAME[trip],
+                  snapshot.latched(trip) ? "ENCLAVADO" : "libre    ", (unsigned long)s.count,
+                  (unsigned long)s.lastReactionMs, (unsigned long)s.maxReactionMs);
+  }
+  char buffer[768];
+  size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  if (len > 0 && len < sizeof(buffer) && mqttClient.connected()) mqttClient.publish(mqttTopics.system, buffer, false);
+}
+
 void loadSystemStats() {
   preferences.begin("awg-stats", true);
   rebootCount = preferences.getUInt("rebootCount", 0);
@@ -3633,6 +5709,80 @@ void saveAlertConfig() {
   preferences.end();
 }
 
+// Parámetros aprendidos por el control adaptativo; sin datos parte de los del modo PID
+void loadAdaptiveState() {
+  float base[ADAPT_PARAM_COUNT];
+  preferences.begin("awg-adapt", true);
+  base[ADAPT_SETPOINT_OFFSET] = preferences.getFloat("setpoint", 0.0f);
+  base[ADAPT_DEADBAND] = preferences.getFloat("deadband", control_deadband);
+  base[ADAPT_FAN_ON_OFFSET] = preferences.getFloat("fanOn", evapFanTempOnOffset);
+  base[ADAPT_FAN_OFF_OFFSET] = preferences.getFloat("fanOff", evapFanTempOffOffset);
+  float efficiency = preferences.getFloat("efficiency", NAN);
+  uint32_t iterations = preferences.getUInt("iterations", 0);
+  preferences.end();
+  adaptiveController.begin(base, efficiency, iterations);
+}
+
+void saveAdaptiveState() {
+  preferences.begin("awg-adapt", false);
+  preferences.putFloat("setpoint", adaptiveController.base(ADAPT_SETPOINT_OFFSET));
+  preferences.putFloat("deadband", adaptiveController.base(ADAPT_DEADBAND));
+  preferences.putFloat("fanOn", adaptiveController.base(ADAPT_FAN_ON_OFFSET));
+  preferences.putFloat("fanOff", adaptiveController.base(ADAPT_FAN_OFF_OFFSET));
+  preferences.putFloat("efficiency", adaptiveController.efficiency());
+  preferences.putUInt("iterations", adaptiveController.iterations());
+  preferences.end();
+}
+
+// Perfil horario del modo tiempo (blob único para no ocupar 48 claves)
+void loadDutyProfile() {
+  DutyProfile profile;
+  preferences.begin("awg-duty", true);
+  size_t len = preferences.getBytes("profile", &profile, sizeof(profile));
+  preferences.end();
+  dutyScheduler.begin(dutyBudgetHours, len == sizeof(profile) ? &profile : nullptr);
+}
+
+void saveDutyProfile() {
+  preferences.begin("awg-duty", false);
+  preferences.putBytes("profile", &dutyScheduler.profile(), sizeof(DutyProfile));
+  preferences.end();
+}
+
+// Agregados: tablas de horas y días más los intervalos abiertos (los minutos solo en RAM)
+void loadRollups() {
+  rollupEngine.begin();
+  preferences.begin("awg-rollup", true);
+  for (uint8_t level = ROLLUP_HOUR; level < ROLLUP_LEVEL_COUNT; level++) {
+    const char* key = ROLLUP_LEVEL_NAME[level];
+    String headerKey = String(key) + "Hdr";
+    RollupTableHeader header;
+    if (preferences.getBytes(headerKey.c_str(), &header, sizeof(header)) == sizeof(header) &&
+        preferences.getBytes(key, rollupEngine.tableData(level), rollupEngine.tableBytes(level)) == rollupEngine.tableBytes(level)) {
+      rollupEngine.restoreTable(header);
+    }
+  }
+  RollupAccumulator acc[ROLLUP_LEVEL_COUNT];
+  if (preferences.getBytes("open", acc, sizeof(acc)) == sizeof(acc)) {
+    rollupEngine.restoreAccumulators(acc);
+  }
+  preferences.end();
+}
+
+void saveRollups(uint8_t tables) {
+  preferences.begin("awg-rollup", false);
+  for (uint8_t level = ROLLUP_HOUR; level < ROLLUP_LEVEL_COUNT; level++) {
+    if (!(tables & (1 << level))) continue;
+    const char* key = ROLLUP_LEVEL_NAME[level];
+    String headerKey = String(key) + "Hdr";
+    RollupTableHeader header = rollupEngine.header(level);
+    preferences.putBytes(headerKey.c_str(), &header, sizeof(header));
+    preferences.putBytes(key, rollupEngine.tableData(level), rollupEngine.tableBytes(level));
+  }
+  preferences.putBytes("open", rollupEngine.accumulators(), rollupEngine.accumulatorBytes());
+  preferences.end();
+}
+
 // Función para guardar credenciales WiFi en preferencias
 void saveWiFiCredentials(String ssid, String password) {
   preferences.begin("awg-wifi", false);
@@ -3695,10 +5845,12 @@ void initNVS() {
 void setup() {
    initNVS(); // Inicializar NVS de forma robusta antes de cualquier operación que lo requiera
    Serial.begin(115200);
+   Serial1.setRxBufferSize(UART1_RX_BUFFER_SIZE);  // Antes de begin(): el loop puede reposar hasta POWER_MAX_IDLE_MS
    Serial1.begin(115200, SERIAL_8N1, RX1_PIN, TX1_PIN);
    delay(500);
    logInfo("🚀 Iniciando sistema AWG...");
-   logInfo("📋 Versión del firmware: v1.0");
+   logInfo("📋 Versión del firmware: v" FIRMWARE_VERSION);
+   otaBootCheck();  // Imagen recién actualizada: pendiente de verificar o reversión
    pinMode(CONFIG_BUTTON_PIN, INPUT_PULLUP);
 
    // Configurar pin de backlight y encender por defecto
@@ -3707,6 +5859,7 @@ void setup() {
    backlightOn = true;
    lastScreenActivity = millis();
    loadSystemStats();              // Cargar estadísticas del sistema
+   memInit();                      // Tendencia de heap de arranques anteriores
    Serial1.println("AWG_INIT:OK"); // Test UART communication
 
   // Cargar configuración MQTT antes de inicializar sensores
@@ -3714,17 +5867,34 @@ void setup() {
   loadAlertConfig();
   logInfo( "🔧 Inicializando componentes del sistema...");
   ledInit(); // Inicializar LED RGB
+  levelEstimator.begin();
   sensorManager.begin();
+  loadAdaptiveState();  // Después de begin(): parte de los parámetros PID cargados de NVS
+  loadDutyProfile();
+  loadRollups();
   reconnectSystem(); // Conectar WiFi y MQTT de forma eficiente (igual que el comando RECONNECT)
   publishState();   // Enviar estados iniciales al display
   // Registrar inicio del sistema
   systemStartTime = millis();
   rebootCount++;
+  setupPower();
+  safetyInit();  // Último: setup() puede bloquear conectando y el loop aún no late
 }
 
 void loop() {
   unsigned long now = millis();
 
+  // Tiempo entre iteraciones: el peor caso con el portal abierto se registra aparte
+  if (lastLoopStart != 0) {
+    unsigned long stall = now - lastLoopStart;
+    if (stall > loopMaxStallMs) loopMaxStallMs = stall;
+    if (portalActive && stall > portalMaxStallMs) portalMaxStallMs = stall;
+    if (stall >= LOOP_STALL_WARN_MS) loopStallCount++;
+  }
+  lastLoopStart = now;
+  safetyLoopBeatMs = now;  // Progreso del loop: sin él el supervisor deja de alimentar el watchdog
+  powerLoopBegin();
+
   // Verificar timeout de ensamblaje de configuración fragmentada
   if (configAssembleTimeout > 0 && now > configAssembleTimeout) {
     logWarning( "⏰ Timeout de ensamblaje de configuración fragmentada - cancelando");
@@ -3741,16 +5911,8 @@ void loop() {
     // Botón recién presionado
     if (now - configPortalTimeout > CONFIG_BUTTON_TIMEOUT) {
       configPortalTimeout = now;
-      portalActive = true; // Abrir portal de configuración
-      currentLedState = LED_WHITE;
-      setLedColor(COLOR_WHITE_R, COLOR_WHITE_G, COLOR_WHITE_B);
       logInfo( "Iniciando portal de configuración...");
-      startCustomConfigPortal();
-      // Después de configurar, reconectar
-      setupWiFi();
-      setupMQTT();
-      portalActive = false;
-      updateLedState();  // Restaurar LED según estado actual
+      startCustomConfigPortal();  // No bloqueante: se cierra solo al guardar o por timeout
     }
   }
   buttonPressedLast = buttonPressed;
@@ -3760,6 +5922,8 @@ void loop() {
 
   if (now - lastRead >= SENSOR_READ_INTERVAL) {
     sensorManager.readSensors();
+    safetyPublishSample();  // Antes del control: el supervisor ve la lectura aunque lo que sigue se trabe
+    sensorManager.updateRollups();
     lastRead = now;
     sensorManager.processControl();  // Ejecutar control automático NO-BLOQUEANTE inmediatamente después de nuevas lecturas
     handleCompressorProtection();    // Manejar protección del compresor
@@ -3783,30 +5947,26 @@ void loop() {
       if (millis() - lastMqttAttempt >= mqttReconnectBackoff) {
         lastMqttAttempt = millis();
         mqttReconnectCount++;
-        logInfo( "🔄 Intentando reconexión MQTT #" + String(mqttReconnectCount) + " (backoff: " + String(mqttReconnectBackoff/1000) + "s)");
-
-        // Backoff exponencial mejorado con jitter para evitar thundering herd
-        if (mqttReconnectCount <= 3) {
-          mqttReconnectBackoff = MQTT_RECONNECT_DELAY;  // 3 segundos para primeros intentos
-        } else if (mqttReconnectCount <= 7) {
-          mqttReconnectBackoff = MQTT_RECONNECT_DELAY * 2;  // 6 segundos
-        } else if (mqttReconnectCount <= 12) {
-          mqttReconnectBackoff = MQTT_RECONNECT_DELAY * 4;  // 12 segundos
-        } else {
-          // Backoff exponencial con jitter para evitar sincronización
-          unsigned long baseDelay = MQTT_RECONNECT_DELAY * 8UL;  // Base de 24 segundos
-          unsigned long jitter = random(0, baseDelay / 4);  // Jitter del 25%
-          mqttReconnectBackoff = min(baseDelay + jitter, MQTT_MAX_BACKOFF);
-        }
+        mqttReconnectStreak++;
+        mqttReconnectBackoff = mqttBackoffFor(mqttReconnectStreak);
+        logInfo( "🔄 Intentando reconexión MQTT #" + String(mqttReconnectStreak) + " (próximo intento en " + String(mqttReconnectBackoff/1000) + "s)");
         connectMQTT();
       }
     } else {
-      mqttReconnectBackoff = MQTT_RECONNECT_DELAY;  // Reset backoff cuando está conectado
+      // El backoff se reinicia solo tras una sesión estable: un equipo expulsado una y otra
+      // vez (id duplicado, enlace inestable) sigue espaciando sus intentos
+      if (mqttReconnectStreak > 0 && now - mqttSessionStart >= MQTT_STABLE_SESSION_MS) {
+        mqttReconnectStreak = 0;
+        mqttReconnectBackoff = MQTT_RECONNECT_DELAY;
+      }
+      // PubSubClient lee un paquete por llamada: lo que llega espera a la siguiente
+      mqttPrevPollUs = mqttPollUs;
+      mqttPollUs = micros();
       mqttClient.loop();
 
       // Ping MQTT periódico para mantener conexión viva (cada 45 segundos)
-      if (now - lastMqttPing >= 45000) {
-        if (mqttClient.publish(MQTT_TOPIC_SYSTEM, "PING", false)) {
+      if (now - lastMqttPing >= MQTT_PING_INTERVAL) {
+        if (mqttClient.publish(mqttTopics.system, "PING", false)) {
           // Ping exitoso, no loguear
         } else {
           logError( "❌ Error enviando ping MQTT - posible desconexión");
@@ -3839,8 +5999,9 @@ void loop() {
       wifiReconnectCount = 0;  // Reset contador en conexión exitosa
     }
 
-    // Solo intentar reconectar si está completamente desconectado y no está en modo local
-    if (!offlineMode && (currentStatus == WL_DISCONNECTED || currentStatus == WL_IDLE_STATUS || currentStatus == WL_NO_SSID_AVAIL)) {
+    // Solo intentar reconectar si está completamente desconectado y no está en modo local.
+    // Con el portal activo la radio sirve el AP: WiFi.disconnect()/begin() lo tirarían
+    if (!portalActive && !offlineMode && (currentStatus == WL_DISCONNECTED || currentStatus == WL_IDLE_STATUS || currentStatus == WL_NO_SSID_AVAIL)) {
       wifiReconnectCount++;
       if (wifiReconnectCount <= 3) {
         // Primeros intentos: reconectar rápido
@@ -3868,7 +6029,7 @@ void loop() {
     lastWiFiCheck = now;
   }
   // Gestionar timeout de pantalla (reposo/backlight) - enviar comandos al display
-  if (screenTimeoutSec > 0) {
+  if (screenTimeoutSec > 0 && !otaDisplayRelayActive()) {
     if (backlightOn && (now - lastScreenActivity >= (unsigned long)screenTimeoutSec * 1000UL)) {
       Serial1.println("BACKLIGHT:OFF");
       digitalWrite(BACKLIGHT_PIN, LOW);
@@ -3877,6 +6038,10 @@ void loop() {
   }
   sensorManager.handleCommands();
   sensorManager.handleSerialCommands();
+  serviceConfigPortal();
+  otaService();
+  memService();
+  safetyService();
 
   // Guardar estadísticas periódicamente (cada 5 minutos)
   static unsigned long lastStatsSave = 0;
@@ -3886,4 +6051,5 @@ void loop() {
     lastStatsSave = now;
   }
   updateLedState(); // Actualizar LED RGB según estado del sistema
+  managePower();    // Ceder la CPU hasta el próximo trabajo periódico
 }
\ No newline at end of file
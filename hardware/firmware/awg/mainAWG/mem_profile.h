@@ -0,0 +1,192 @@
+#ifndef MEM_PROFILE_H
+#define MEM_PROFILE_H
+
+// Perfil de memoria: heap por subsistema y tendencia entre reinicios
+//
+// El firmware usa String y DynamicJsonDocument en caminos frecuentes (logs, comandos, el
+// mensaje MQTT armado byte a byte, la configuración). Con semanas de uptime el heap puede
+// fragmentarse hasta que una asignación grande falla aunque quede memoria libre. Este módulo
+// lleva las cuentas; el firmware las lee del heap y las publica (MEM_STATS, dropster/<id>/system).
+//
+// Atribución por subsistema (mqtt, command, log, json; other = el resto):
+// - Siempre: cada entrada a un subsistema (MemScope en mainAWG.ino) mide el heap libre antes y
+//   después. La diferencia es lo que quedó retenido. Las entradas anidadas se descuentan de
+//   la exterior, y las tareas del SDK (WiFi, lwIP) que asignan en paralelo la ensucian un poco.
+// - Con los ganchos del heap del SDK (CONFIG_HEAP_USE_HOOKS), además el número de
+//   asignaciones y los bytes pedidos, que miden el recambio aunque todo se libere.
+//
+// Tendencia: cada MEM_TREND_INTERVAL_MS se guarda el mínimo de heap libre y del mayor bloque
+// de ese intervalo, con el número de arranque y la causa del último reinicio. El anillo vive
+// en NVS, así una fuga lenta o una fragmentación que termina en reinicio se ve en varios
+// arranques seguidos. leakBytesPerHour() ajusta una recta a las muestras del arranque actual.
+//
+// Sin dependencias de Arduino para poder probarse en host.
+
+#include <stdint.h>
+#include <string.h>
+
+#define MEM_SCOPE_DEPTH 4
+#define MEM_TREND_SLOTS 48       // Muestras persistidas (48 h con el intervalo por defecto)
+#define MEM_TREND_VERSION 1
+#define MEM_LEAK_MIN_SAMPLES 3   // Menos muestras no dan una pendiente útil
+
+enum MemSubsystem : uint8_t {
+  MEM_SYS_OTHER = 0,
+  MEM_SYS_MQTT,     // mqttClient.loop() y el callback de mensajes
+  MEM_SYS_COMMAND,  // processCommand()
+  MEM_SYS_LOG,      // awgLog()
+  MEM_SYS_JSON,     // Configuración (DynamicJsonDocument)
+  MEM_SYS_COUNT
+};
+
+static const char* const MEM_SYS_NAME[MEM_SYS_COUNT] = { "other", "mqtt", "command", "log", "json" };
+
+struct MemSubsystemStats {
+  uint32_t scopes;      // Entradas al subsistema
+  int32_t netBytes;     // Heap retenido acumulado (negativo: liberó más de lo que tomó)
+  int32_t worstBytes;   // Mayor retención en una sola entrada
+  uint32_t allocs;      // Solo con ganchos del heap
+  uint32_t allocBytes;
+  uint32_t frees;
+};
+
+struct MemTrendSample {
+  uint16_t boot;         // Número de arranque (MemTrend::boot al tomarla)
+  uint8_t resetReason;   // esp_reset_reason() de ese arranque
+  uint8_t fragPct;       // Fragmentación al cerrar el intervalo
+  uint32_t uptimeMin;
+  uint32_t freeMin;      // Mínimo del heap libre en el intervalo
+  uint32_t largestMin;   // Mínimo del mayor bloque libre en el intervalo
+};
+
+// Anillo persistido tal cual como blob en NVS
+struct MemTrend {
+  uint16_t version;
+  uint16_t count;
+  uint16_t head;   // Próxima posición a escribir
+  uint16_t boot;
+  MemTrendSample samples[MEM_TREND_SLOTS];
+
+  void reset() {
+    memset(this, 0, sizeof(*this));
+    version = MEM_TREND_VERSION;
+  }
+
+  bool valid() const { return version == MEM_TREND_VERSION && count <= MEM_TREND_SLOTS && head < MEM_TREND_SLOTS; }
+
+  void push(const MemTrendSample& sample) {
+    samples[head] = sample;
+    head = (uint16_t)((head + 1) % MEM_TREND_SLOTS);
+    if (count < MEM_TREND_SLOTS) count++;
+  }
+
+  // i = 0 es la más antigua
+  const MemTrendSample& at(int i) const {
+    int oldest = (head + MEM_TREND_SLOTS - count) % MEM_TREND_SLOTS;
+    return samples[(oldest + i) % MEM_TREND_SLOTS];
+  }
+
+  // Pendiente del heap libre mínimo en el arranque `bootNumber` (bytes/h, positiva = se pierde
+  // memoria). 0 con menos de MEM_LEAK_MIN_SAMPLES muestras
+  float leakBytesPerHour(uint16_t bootNumber) const {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < count; i++) {
+      const MemTrendSample& s = at(i);
+      if (s.boot != bootNumber) continue;
+      double x = s.uptimeMin / 60.0;
+      double y = (double)s.freeMin;
+      n++;
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    double den = n * sxx - sx * sx;
+    if (n < MEM_LEAK_MIN_SAMPLES || den <= 0) return 0.0f;
+    return (float)(-(n * sxy - sx * sy) / den);
+  }
+};
+
+class MemProfiler {
+ public:
+  MemProfiler() { resetCounters(); }
+
+  // Entrada y salida de un subsistema con el heap libre en ese momento
+  void enter(uint8_t subsystem, uint32_t freeBytes) {
+    if (depth_ < MEM_SCOPE_DEPTH) {
+      stack_[depth_].subsystem = subsystem;
+      stack_[depth_].freeBefore = freeBytes;
+      stats_[subsystem].scopes++;
+    }
+    depth_++;
+  }
+
+  void leave(uint32_t freeBytes) {
+    if (depth_ == 0) return;
+    depth_--;
+    if (depth_ >= MEM_SCOPE_DEPTH) return;
+    Frame& frame = stack_[depth_];
+    int32_t retained = (int32_t)(frame.freeBefore - freeBytes);
+    MemSubsystemStats& s = stats_[frame.subsystem];
+    s.netBytes += retained;
+    if (retained > s.worstBytes) s.worstBytes = retained;
+    // Lo retenido aquí ya está contado: la entrada exterior no lo suma otra vez
+    if (depth_ > 0) stack_[depth_ - 1].freeBefore -= (uint32_t)retained;
+  }
+
+  uint8_t current() const {
+    if (depth_ == 0) return MEM_SYS_OTHER;
+    return stack_[(depth_ <= MEM_SCOPE_DEPTH ? depth_ : MEM_SCOPE_DEPTH) - 1].subsystem;
+  }
+
+  // Desde los ganchos del heap: no asignar ni bloquear aquí
+  void onAlloc(uint8_t subsystem, uint32_t bytes) {
+    stats_[subsystem].allocs++;
+    stats_[subsystem].allocBytes += bytes;
+  }
+  void onFree(uint8_t subsystem) { stats_[subsystem].frees++; }
+
+  // Lectura periódica del heap: mínimos del intervalo de tendencia en curso
+  void observe(uint32_t freeBytes, uint32_t largestBytes) {
+    if (!windowOpen_ || freeBytes < windowFreeMin_) windowFreeMin_ = freeBytes;
+    if (!windowOpen_ || largestBytes < windowLargestMin_) windowLargestMin_ = largestBytes;
+    windowOpen_ = true;
+  }
+
+  // Cierra el intervalo en una muestra de tendencia. false si no hubo lecturas
+  bool closeWindow(uint16_t boot, uint8_t resetReason, uint32_t uptimeMin, MemTrendSample* out) {
+    if (!windowOpen_) return false;
+    out->boot = boot;
+    out->resetReason = resetReason;
+    out->uptimeMin = uptimeMin;
+    out->freeMin = windowFreeMin_;
+    out->largestMin = windowLargestMin_;
+    out->fragPct = fragmentationPct(windowFreeMin_, windowLargestMin_);
+    windowOpen_ = false;
+    return true;
+  }
+
+  const MemSubsystemStats& stats(int subsystem) const { return stats_[subsystem]; }
+
+  void resetCounters() { memset(stats_, 0, sizeof(stats_)); }
+
+  // Porcentaje del heap libre que no está en el mayor bloque
+  static uint8_t fragmentationPct(uint32_t freeBytes, uint32_t largestBytes) {
+    if (freeBytes == 0 || largestBytes >= freeBytes) return 0;
+    return (uint8_t)(100u - (uint32_t)((uint64_t)largestBytes * 100u / freeBytes));
+  }
+
+ private:
+  struct Frame {
+    uint8_t subsystem;
+    uint32_t freeBefore;
+  };
+  Frame stack_[MEM_SCOPE_DEPTH];
+  uint8_t depth_ = 0;
+  MemSubsystemStats stats_[MEM_SYS_COUNT];
+  bool windowOpen_ = false;
+  uint32_t windowFreeMin_ = 0;
+  uint32_t windowLargestMin_ = 0;
+};
+
+#endif  // MEM_PROFILE_H
@@ -0,0 +1,114 @@
+#ifndef MQTT_TOPICS_H
+#define MQTT_TOPICS_H
+
+// Identidad MQTT del equipo y tópicos derivados de ella
+//
+// Cada AWG tiene un identificador estable: el guardado en NVS (SET_DEVICE_ID) o, si no hay
+// uno válido, "awg-" más la MAC base del chip en hexadecimal. De él salen el client id
+// (MQTT_CLIENT_ID "_" id, igual en cada reconexión) y los tópicos:
+//
+//   dropster/<id>/data | status | control | alerts | errors | system | rollup | presence | ota | ack
+//
+// Con el id siempre en el segundo nivel, un consumidor de flota se suscribe con comodines
+// fijos (dropster/+/data, $share/<grupo>/dropster/+/data) y una app con el tópico de un
+// solo equipo. presence es retenido: "online" al conectar y "offline" como last will.
+//
+// Modo de compatibilidad (legacy): tópicos planos dropster/<hoja> como en las versiones
+// anteriores, last will AWG_OFFLINE en dropster/system y sin presence. El client id sigue
+// siendo el estable. Fuera de legacy, sharedControl es el dropster/control plano: durante
+// la migración el equipo puede escucharlo además del suyo (MQTT_SHARED_CONTROL).
+//
+// Sin dependencias de Arduino para poder probarse en host.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MQTT_DEVICE_ID_MAX 32      // Caracteres del id, sin el terminador
+#define MQTT_TOPIC_MAX 64          // raíz + '/' + id + '/' + hoja + terminador
+#define MQTT_DEVICE_ID_PREFIX "awg-"
+
+#define MQTT_LEAF_DATA "data"          // Datos de sensores (JSON, QoS 0)
+#define MQTT_LEAF_STATUS "status"      // Estados actuadores + modo (JSON, retenido)
+#define MQTT_LEAF_CONTROL "control"    // Comandos app → dispositivo (control + configuración)
+#define MQTT_LEAF_ALERTS "alerts"      // Alertas específicas
+#define MQTT_LEAF_ERRORS "errors"      // Mensajes de error
+#define MQTT_LEAF_SYSTEM "system"      // Estado general del sistema y PING
+#define MQTT_LEAF_ROLLUP "rollup"      // Agregados minuto/hora/día y respuestas a STATS_QUERY
+#define MQTT_LEAF_PRESENCE "presence"  // online/offline retenido (last will)
+#define MQTT_LEAF_OTA "ota"            // Trozos de firmware (OTA_PUSH): offset u32 + datos
+#define MQTT_LEAF_ACK "ack"            // Acuses de comandos con id de correlación y CMD_STATS
+
+#define MQTT_PRESENCE_ONLINE "online"
+#define MQTT_PRESENCE_OFFLINE "offline"
+#define MQTT_LEGACY_WILL_MESSAGE "AWG_OFFLINE"
+
+// Id válido: 1-32 caracteres de [a-z0-9_-]. Excluye '/', '+' y '#', que romperían los
+// comodines, y las mayúsculas, porque processCommand() recibe los comandos en minúsculas
+inline bool mqttDeviceIdValid(const char* id) {
+  if (id == nullptr) return false;
+  size_t len = strlen(id);
+  if (len == 0 || len > MQTT_DEVICE_ID_MAX) return false;
+  for (size_t i = 0; i < len; i++) {
+    char c = id[i];
+    bool ok = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+    if (!ok) return false;
+  }
+  return true;
+}
+
+// "awg-" + los 6 bytes de la MAC: único por chip y estable entre reinicios y flasheos
+inline void mqttDeviceIdFromMac(const uint8_t mac[6], char out[MQTT_DEVICE_ID_MAX + 1]) {
+  snprintf(out, MQTT_DEVICE_ID_MAX + 1, MQTT_DEVICE_ID_PREFIX "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2],
+           mac[3], mac[4], mac[5]);
+}
+
+struct MqttTopics {
+  char data[MQTT_TOPIC_MAX];
+  char status[MQTT_TOPIC_MAX];
+  char control[MQTT_TOPIC_MAX];
+  char alerts[MQTT_TOPIC_MAX];
+  char errors[MQTT_TOPIC_MAX];
+  char system[MQTT_TOPIC_MAX];
+  char rollup[MQTT_TOPIC_MAX];
+  char presence[MQTT_TOPIC_MAX];  // Vacío en modo legacy
+  char ota[MQTT_TOPIC_MAX];
+  char ack[MQTT_TOPIC_MAX];
+  char sharedControl[MQTT_TOPIC_MAX];  // Vacío en modo legacy (control ya es el plano)
+  bool legacy;
+
+  // Tópico del last will y su mensaje (retenido, QoS 1)
+  const char* willTopic() const { return legacy ? system : presence; }
+  const char* willMessage() const { return legacy ? MQTT_LEGACY_WILL_MESSAGE : MQTT_PRESENCE_OFFLINE; }
+
+  void build(const char* root, const char* deviceId, bool legacyTopics) {
+    legacy = legacyTopics;
+    compose(data, root, deviceId, MQTT_LEAF_DATA);
+    compose(status, root, deviceId, MQTT_LEAF_STATUS);
+    compose(control, root, deviceId, MQTT_LEAF_CONTROL);
+    compose(alerts, root, deviceId, MQTT_LEAF_ALERTS);
+    compose(errors, root, deviceId, MQTT_LEAF_ERRORS);
+    compose(system, root, deviceId, MQTT_LEAF_SYSTEM);
+    compose(rollup, root, deviceId, MQTT_LEAF_ROLLUP);
+    compose(ota, root, deviceId, MQTT_LEAF_OTA);
+    compose(ack, root, deviceId, MQTT_LEAF_ACK);
+    if (legacy) {
+      presence[0] = '\0';
+      sharedControl[0] = '\0';
+    } else {
+      compose(presence, root, deviceId, MQTT_LEAF_PRESENCE);
+      snprintf(sharedControl, MQTT_TOPIC_MAX, "%s/%s", root, MQTT_LEAF_CONTROL);
+    }
+  }
+
+ private:
+  void compose(char* out, const char* root, const char* deviceId, const char* leaf) const {
+    if (legacy) {
+      snprintf(out, MQTT_TOPIC_MAX, "%s/%s", root, leaf);
+    } else {
+      snprintf(out, MQTT_TOPIC_MAX, "%s/%s/%s", root, deviceId, leaf);
+    }
+  }
+};
+
+#endif  // MQTT_TOPICS_H
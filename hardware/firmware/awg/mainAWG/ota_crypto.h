@@ -0,0 +1,531 @@
+#ifndef OTA_CRYPTO_H
+#define OTA_CRYPTO_H
+
+// SHA-256, SHA-512 y Ed25519 para verificar paquetes OTA
+//
+// SHA-256 cubre la imagen descomprimida: su estado es un struct plano que se guarda en NVS
+// con el punto de reanudación, así una descarga cortada sigue sin releer lo ya escrito.
+// Ed25519 (RFC 8032) firma el encabezado del paquete, que incluye ese SHA-256; la clave
+// pública son 32 bytes en config.h. La aritmética de curva sigue a TweetNaCl (dominio
+// público): lenta pero compacta, y solo corre una vez por actualización (~0,3 s en el ESP32).
+// sign() y publicKey() solo los usa la herramienta de escritorio que arma los paquetes.
+//
+// Sin dependencias de Arduino para poder probarse en host.
+
+#include <stdint.h>
+#include <string.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA512_DIGEST_SIZE 64
+#define ED25519_KEY_SIZE 32
+#define ED25519_SIGNATURE_SIZE 64
+
+struct Sha256 {
+  uint32_t state[8];
+  uint64_t length;  // Bytes procesados
+  uint8_t block[64];
+  uint32_t fill;
+
+  void begin() {
+    static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    memcpy(state, init, sizeof(state));
+    length = 0;
+    fill = 0;
+  }
+
+  void update(const uint8_t* data, size_t len) {
+    length += len;
+    while (len > 0) {
+      size_t n = 64 - fill < len ? 64 - fill : len;
+      memcpy(block + fill, data, n);
+      fill += n;
+      data += n;
+      len -= n;
+      if (fill == 64) {
+        compress(block);
+        fill = 0;
+      }
+    }
+  }
+
+  void finish(uint8_t out[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = length * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (fill != 56) update(&pad, 1);
+    uint8_t be[8];
+    for (int i = 0; i < 8; i++) be[i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(be, 8);
+    for (int i = 0; i < 8; i++) {
+      out[4 * i] = (uint8_t)(state[i] >> 24);
+      out[4 * i + 1] = (uint8_t)(state[i] >> 16);
+      out[4 * i + 2] = (uint8_t)(state[i] >> 8);
+      out[4 * i + 3] = (uint8_t)state[i];
+    }
+  }
+
+ private:
+  static uint32_t ror(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+  void compress(const uint8_t* p) {
+    static const uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+      w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) | ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+      uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+  }
+};
+
+struct Sha512 {
+  uint64_t state[8];
+  uint64_t length;
+  uint8_t block[128];
+  uint32_t fill;
+
+  void begin() {
+    static const uint64_t init[8] = { 0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+                                      0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+                                      0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL };
+    memcpy(state, init, sizeof(state));
+    length = 0;
+    fill = 0;
+  }
+
+  void update(const uint8_t* data, size_t len) {
+    length += len;
+    while (len > 0) {
+      size_t n = 128 - fill < len ? 128 - fill : len;
+      memcpy(block + fill, data, n);
+      fill += n;
+      data += n;
+      len -= n;
+      if (fill == 128) {
+        compress(block);
+        fill = 0;
+      }
+    }
+  }
+
+  void finish(uint8_t out[SHA512_DIGEST_SIZE]) {
+    uint64_t bits = length * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (fill != 112) update(&pad, 1);
+    uint8_t be[16] = { 0 };  // Longitud de 128 bits: los 64 altos son cero
+    for (int i = 0; i < 8; i++) be[8 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(be, 16);
+    for (int i = 0; i < 8; i++) {
+      for (int j = 0; j < 8; j++) out[8 * i + j] = (uint8_t)(state[i] >> (56 - 8 * j));
+    }
+  }
+
+ private:
+  static uint64_t ror(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+  void compress(const uint8_t* p) {
+    static const uint64_t k[80] = {
+      0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+      0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+      0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+      0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+      0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+      0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+      0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+      0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+      0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+      0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+      0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+      0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+      0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+      0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+      0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+      0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+      0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+      0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+      0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+      0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL };
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = 0;
+      for (int j = 0; j < 8; j++) w[i] = (w[i] << 8) | p[8 * i + j];
+    }
+    for (int i = 16; i < 80; i++) {
+      uint64_t s0 = ror(w[i - 15], 1) ^ ror(w[i - 15], 8) ^ (w[i - 15] >> 7);
+      uint64_t s1 = ror(w[i - 2], 19) ^ ror(w[i - 2], 61) ^ (w[i - 2] >> 6);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 80; i++) {
+      uint64_t t1 = h + (ror(e, 14) ^ ror(e, 18) ^ ror(e, 41)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+      uint64_t t2 = (ror(a, 28) ^ ror(a, 34) ^ ror(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+  }
+};
+
+class Ed25519 {
+ public:
+  // Firma de `len` bytes con la clave pública `publicKey`. Rechaza firmas no canónicas (S >= L)
+  static bool verify(const uint8_t signature[ED25519_SIGNATURE_SIZE], const uint8_t* message, size_t len,
+                     const uint8_t publicKey[ED25519_KEY_SIZE]) {
+    if (!scalarCanonical(signature + 32)) return false;
+    Gf q[4];
+    if (!unpackNeg(q, publicKey)) return false;
+    uint8_t h[SHA512_DIGEST_SIZE];
+    Sha512 sha;
+    sha.begin();
+    sha.update(signature, 32);
+    sha.update(publicKey, ED25519_KEY_SIZE);
+    sha.update(message, len);
+    sha.finish(h);
+    reduce(h);
+    Gf p[4];
+    scalarMult(p, q, h);
+    scalarBase(q, signature + 32);
+    add(p, q);
+    uint8_t t[32];
+    pack(t, p);
+    uint8_t diff = 0;
+    for (int i = 0; i < 32; i++) diff |= (uint8_t)(t[i] ^ signature[i]);
+    return diff == 0;
+  }
+
+  // Clave pública de una semilla de 32 bytes
+  static void publicKey(const uint8_t seed[ED25519_KEY_SIZE], uint8_t publicKey[ED25519_KEY_SIZE]) {
+    uint8_t d[SHA512_DIGEST_SIZE];
+    expandSeed(seed, d);
+    Gf p[4];
+    scalarBase(p, d);
+    pack(publicKey, p);
+  }
+
+  static void sign(uint8_t signature[ED25519_SIGNATURE_SIZE], const uint8_t* message, size_t len,
+                   const uint8_t seed[ED25519_KEY_SIZE]) {
+    uint8_t d[SHA512_DIGEST_SIZE], pk[ED25519_KEY_SIZE], r[SHA512_DIGEST_SIZE], h[SHA512_DIGEST_SIZE];
+    expandSeed(seed, d);
+    publicKey(seed, pk);
+    Sha512 sha;
+    sha.begin();
+    sha.update(d + 32, 32);
+    sha.update(message, len);
+    sha.finish(r);
+    reduce(r);
+    Gf p[4];
+    scalarBase(p, r);
+    pack(signature, p);
+    sha.begin();
+    sha.update(signature, 32);
+    sha.update(pk, ED25519_KEY_SIZE);
+    sha.update(message, len);
+    sha.finish(h);
+    reduce(h);
+    int64_t x[64] = { 0 };
+    for (int i = 0; i < 32; i++) x[i] = r[i];
+    for (int i = 0; i < 32; i++) {
+      for (int j = 0; j < 32; j++) x[i + j] += (int64_t)h[i] * d[j];
+    }
+    modL(signature + 32, x);
+  }
+
+ private:
+  typedef int64_t Gf[16];  // Elemento de GF(2^255 - 19) en 16 limbs de 16 bits
+
+  static const int64_t* constant(int which) {
+    static const int64_t table[6][16] = {
+      { 0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+        0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203 },  // d
+      { 0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+        0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406 },  // 2d
+      { 0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+        0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169 },  // x del punto base
+      { 0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+        0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666 },  // y del punto base
+      { 0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+        0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83 },  // sqrt(-1)
+      { 1 } };
+    return table[which];
+  }
+  enum { K_D, K_D2, K_X, K_Y, K_I, K_ONE };
+
+  // Orden del grupo L = 2^252 + 27742317777372353535851937790883648493, little-endian
+  static const uint8_t* orderL() {
+    static const uint8_t l[32] = { 0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7,
+                                   0xa2, 0xde, 0xf9, 0xde, 0x14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10 };
+    return l;
+  }
+
+  static void expandSeed(const uint8_t seed[ED25519_KEY_SIZE], uint8_t d[SHA512_DIGEST_SIZE]) {
+    Sha512 sha;
+    sha.begin();
+    sha.update(seed, ED25519_KEY_SIZE);
+    sha.finish(d);
+    d[0] &= 248;
+    d[31] &= 127;
+    d[31] |= 64;
+  }
+
+  static bool scalarCanonical(const uint8_t s[32]) {
+    const uint8_t* l = orderL();
+    for (int i = 31; i >= 0; i--) {
+      if (s[i] < l[i]) return true;
+      if (s[i] > l[i]) return false;
+    }
+    return false;
+  }
+
+  static void set(Gf r, const int64_t* a) { for (int i = 0; i < 16; i++) r[i] = a[i]; }
+  static void zero(Gf r) { for (int i = 0; i < 16; i++) r[i] = 0; }
+
+  static void carry(Gf o) {
+    for (int i = 0; i < 16; i++) {
+      o[i] += (int64_t)1 << 16;
+      int64_t c = o[i] >> 16;
+      o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+      o[i] -= c << 16;
+    }
+  }
+
+  static void select(Gf p, Gf q, int b) {
+    int64_t c = ~(int64_t)(b - 1);
+    for (int i = 0; i < 16; i++) {
+      int64_t t = c & (p[i] ^ q[i]);
+      p[i] ^= t;
+      q[i] ^= t;
+    }
+  }
+
+  static void pack25519(uint8_t* o, const Gf n) {
+    Gf m, t;
+    set(t, n);
+    carry(t);
+    carry(t);
+    carry(t);
+    for (int j = 0; j < 2; j++) {
+      m[0] = t[0] - 0xffed;
+      for (int i = 1; i < 15; i++) {
+        m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+        m[i - 1] &= 0xffff;
+      }
+      m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+      int b = (int)((m[15] >> 16) & 1);
+      m[14] &= 0xffff;
+      select(t, m, 1 - b);
+    }
+    for (int i = 0; i < 16; i++) {
+      o[2 * i] = (uint8_t)(t[i] & 0xff);
+      o[2 * i + 1] = (uint8_t)(t[i] >> 8);
+    }
+  }
+
+  static bool differ(const Gf a, const Gf b) {
+    uint8_t c[32], d[32];
+    pack25519(c, a);
+    pack25519(d, b);
+    return memcmp(c, d, 32) != 0;
+  }
+
+  static uint8_t parity(const Gf a) {
+    uint8_t d[32];
+    pack25519(d, a);
+    return d[0] & 1;
+  }
+
+  static void unpack25519(Gf o, const uint8_t* n) {
+    for (int i = 0; i < 16; i++) o[i] = n[2 * i] + ((int64_t)n[2 * i + 1] << 8);
+    o[15] &= 0x7fff;
+  }
+
+  static void addF(Gf o, const Gf a, const Gf b) { for (int i = 0; i < 16; i++) o[i] = a[i] + b[i]; }
+  static void subF(Gf o, const Gf a, const Gf b) { for (int i = 0; i < 16; i++) o[i] = a[i] - b[i]; }
+
+  static void mul(Gf o, const Gf a, const Gf b) {
+    int64_t t[31];
+    for (int i = 0; i < 31; i++) t[i] = 0;
+    for (int i = 0; i < 16; i++) {
+      for (int j = 0; j < 16; j++) t[i + j] += a[i] * b[j];
+    }
+    for (int i = 0; i < 15; i++) t[i] += 38 * t[i + 16];
+    for (int i = 0; i < 16; i++) o[i] = t[i];
+    carry(o);
+    carry(o);
+  }
+
+  static void square(Gf o, const Gf a) { mul(o, a, a); }
+
+  static void invert(Gf o, const Gf i) {
+    Gf c;
+    set(c, i);
+    for (int a = 253; a >= 0; a--) {
+      square(c, c);
+      if (a != 2 && a != 4) mul(c, c, i);
+    }
+    set(o, c);
+  }
+
+  static void pow2523(Gf o, const Gf i) {
+    Gf c;
+    set(c, i);
+    for (int a = 250; a >= 0; a--) {
+      square(c, c);
+      if (a != 1) mul(c, c, i);
+    }
+    set(o, c);
+  }
+
+  // Suma de puntos en coordenadas extendidas: p += q
+  static void add(Gf p[4], Gf q[4]) {
+    Gf a, b, c, d, t, e, f, g, h;
+    subF(a, p[1], p[0]);
+    subF(t, q[1], q[0]);
+    mul(a, a, t);
+    addF(b, p[0], p[1]);
+    addF(t, q[0], q[1]);
+    mul(b, b, t);
+    mul(c, p[3], q[3]);
+    mul(c, c, constant(K_D2));
+    mul(d, p[2], q[2]);
+    addF(d, d, d);
+    subF(e, b, a);
+    subF(f, d, c);
+    addF(g, d, c);
+    addF(h, b, a);
+    mul(p[0], e, f);
+    mul(p[1], h, g);
+    mul(p[2], g, f);
+    mul(p[3], e, h);
+  }
+
+  static void swap(Gf p[4], Gf q[4], uint8_t b) {
+    for (int i = 0; i < 4; i++) select(p[i], q[i], b);
+  }
+
+  static void pack(uint8_t* r, Gf p[4]) {
+    Gf tx, ty, zi;
+    invert(zi, p[2]);
+    mul(tx, p[0], zi);
+    mul(ty, p[1], zi);
+    pack25519(r, ty);
+    r[31] ^= (uint8_t)(parity(tx) << 7);
+  }
+
+  static void scalarMult(Gf p[4], Gf q[4], const uint8_t* s) {
+    zero(p[0]);
+    set(p[1], constant(K_ONE));
+    set(p[2], constant(K_ONE));
+    zero(p[3]);
+    for (int i = 255; i >= 0; --i) {
+      uint8_t b = (s[i / 8] >> (i & 7)) & 1;
+      swap(p, q, b);
+      add(q, p);
+      add(p, p);
+      swap(p, q, b);
+    }
+  }
+
+  static void scalarBase(Gf p[4], const uint8_t* s) {
+    Gf q[4];
+    set(q[0], constant(K_X));
+    set(q[1], constant(K_Y));
+    set(q[2], constant(K_ONE));
+    mul(q[3], constant(K_X), constant(K_Y));
+    scalarMult(p, q, s);
+  }
+
+  static void modL(uint8_t* r, int64_t x[64]) {
+    const uint8_t* l = orderL();
+    int64_t c;
+    for (int i = 63; i >= 32; --i) {
+      c = 0;
+      int j;
+      for (j = i - 32; j < i - 12; ++j) {
+        x[j] += c - 16 * x[i] * l[j - (i - 32)];
+        c = (x[j] + 128) >> 8;
+        x[j] -= c * 256;
+      }
+      x[j] += c;
+      x[i] = 0;
+    }
+    c = 0;
+    for (int j = 0; j < 32; j++) {
+      x[j] += c - (x[31] >> 4) * l[j];
+      c = x[j] >> 8;
+      x[j] &= 255;
+    }
+    for (int j = 0; j < 32; j++) x[j] -= c * l[j];
+    for (int i = 0; i < 32; i++) {
+      x[i + 1] += x[i] >> 8;
+      r[i] = (uint8_t)(x[i] & 255);
+    }
+  }
+
+  static void reduce(uint8_t* r) {
+    int64_t x[64];
+    for (int i = 0; i < 64; i++) x[i] = r[i];
+    for (int i = 0; i < 64; i++) r[i] = 0;
+    modL(r, x);
+  }
+
+  // Descomprime -A (el negado de la clave pública); false si no es un punto de la curva
+  static bool unpackNeg(Gf r[4], const uint8_t p[32]) {
+    Gf t, chk, num, den, den2, den4, den6;
+    set(r[2], constant(K_ONE));
+    unpack25519(r[1], p);
+    square(num, r[1]);
+    mul(den, num, constant(K_D));
+    subF(num, num, r[2]);
+    addF(den, r[2], den);
+    square(den2, den);
+    square(den4, den2);
+    mul(den6, den4, den2);
+    mul(t, den6, num);
+    mul(t, t, den);
+    pow2523(t, t);
+    mul(t, t, num);
+    mul(t, t, den);
+    mul(t, t, den);
+    mul(r[0], t, den);
+    square(chk, r[0]);
+    mul(chk, chk, den);
+    if (differ(chk, num)) mul(r[0], r[0], constant(K_I));
+    square(chk, r[0]);
+    mul(chk, chk, den);
+    if (differ(chk, num)) return false;
+    Gf zeroF;
+    zero(zeroF);
+    if (parity(r[0]) == (p[31] >> 7)) subF(r[0], zeroF, r[0]);
+    mul(r[3], r[0], r[1]);
+    return true;
+  }
+};
+
+#endif  // OTA_CRYPTO_H
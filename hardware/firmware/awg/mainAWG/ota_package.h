@@ -0,0 +1,385 @@
+#ifndef OTA_PACKAGE_H
+#define OTA_PACKAGE_H
+
+// Paquete OTA firmado y comprimido, y la sesión que lo recibe por partes
+//
+// Formato (enteros little-endian):
+//
+//   encabezado (148 bytes)
+//     0   "DOTA"           magic
+//     4   formato (1), destino (AWG/pantalla), compresión, reservado
+//     8   tamaño de la imagen (lo que se escribe en la partición)
+//     12  tamaño del payload (bloques que siguen al encabezado)
+//     16  bytes de imagen por bloque (múltiplo de 4096, máximo OTA_MAX_BLOCK_SIZE)
+//     20  versión (32 bytes, terminada en cero)
+//     52  SHA-256 de la imagen
+//     84  firma Ed25519 de los bytes 0-83
+//   bloques: u32 (bits 0-23 longitud almacenada, bit 31 = sin comprimir) + datos
+//
+// Cada bloque se comprime por separado (LZSS, ventana de 4 KB dentro del bloque), así que
+// al terminar uno la imagen hasta ahí queda escrita y el progreso cabe en un punto de
+// control chico: offset del payload, offset de la imagen y el estado del SHA-256. Una
+// conexión cortada pierde como mucho el bloque en curso; con el punto de control en NVS,
+// también un reinicio. La firma se comprueba con el encabezado, antes de tocar la flash, y
+// el SHA-256 al escribir el último bloque.
+//
+// LZSS: un byte de banderas por cada 8 elementos (bit en 1 = literal, en 0 = referencia de
+// 2 bytes: offset 1-4096 en 12 bits y longitud 3-18 en 4 bits).
+//
+// Sin dependencias de Arduino: la flash y la persistencia las aporta OtaSink, de modo que
+// la herramienta de escritorio prueba la misma sesión contra un servidor HTTP local.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ota_crypto.h"
+
+#define OTA_PACKAGE_MAGIC "DOTA"
+#define OTA_PACKAGE_FORMAT 1
+#define OTA_HEADER_SIZE 148
+#define OTA_SIGNED_SIZE 84            // Bytes del encabezado cubiertos por la firma
+#define OTA_VERSION_MAX 32
+#define OTA_SECTOR_SIZE 4096
+#define OTA_MAX_BLOCK_SIZE 16384      // Buffer de salida de la sesión
+#define OTA_BLOCK_RAW_FLAG 0x80000000UL
+#define OTA_BLOCK_LENGTH_MASK 0x00FFFFFFUL
+#define OTA_LZSS_WINDOW 4096
+#define OTA_LZSS_MIN_MATCH 3
+#define OTA_LZSS_MAX_MATCH 18
+
+enum OtaTarget : uint8_t {
+  OTA_TARGET_AWG = 1,
+  OTA_TARGET_DISPLAY = 2
+};
+
+enum OtaCompression : uint8_t {
+  OTA_COMPRESSION_NONE = 0,
+  OTA_COMPRESSION_LZSS = 1
+};
+
+enum OtaResult : uint8_t {
+  OTA_CONTINUE = 0,    // Faltan bytes
+  OTA_DONE,            // Imagen completa y verificada
+  OTA_ERR_HEADER,      // Magic, formato o campos fuera de rango
+  OTA_ERR_TARGET,      // Paquete para el otro microcontrolador
+  OTA_ERR_TOO_LARGE,   // No cabe en la partición
+  OTA_ERR_NO_KEY,      // Sin clave pública configurada
+  OTA_ERR_SIGNATURE,
+  OTA_ERR_CORRUPT,     // Bloque mal formado
+  OTA_ERR_HASH,        // SHA-256 de la imagen distinto
+  OTA_ERR_WRITE,       // La flash rechazó el bloque
+  OTA_ERR_OFFSET       // Bytes que no continúan donde la sesión espera
+};
+
+inline const char* otaResultName(OtaResult result) {
+  switch (result) {
+    case OTA_CONTINUE: return "continue";
+    case OTA_DONE: return "done";
+    case OTA_ERR_HEADER: return "header";
+    case OTA_ERR_TARGET: return "target";
+    case OTA_ERR_TOO_LARGE: return "too_large";
+    case OTA_ERR_NO_KEY: return "no_key";
+    case OTA_ERR_SIGNATURE: return "signature";
+    case OTA_ERR_CORRUPT: return "corrupt";
+    case OTA_ERR_HASH: return "hash";
+    case OTA_ERR_WRITE: return "write";
+    case OTA_ERR_OFFSET: return "offset";
+  }
+  return "unknown";
+}
+
+inline uint32_t otaReadU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void otaWriteU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+struct OtaPackageInfo {
+  uint8_t target;
+  uint8_t compression;
+  uint32_t imageSize;
+  uint32_t payloadSize;
+  uint32_t blockSize;
+  char version[OTA_VERSION_MAX + 1];
+  uint8_t imageSha256[SHA256_DIGEST_SIZE];
+
+  // Campos y rangos; la firma la comprueba OtaSession
+  bool parse(const uint8_t header[OTA_HEADER_SIZE]) {
+    if (memcmp(header, OTA_PACKAGE_MAGIC, 4) != 0 || header[4] != OTA_PACKAGE_FORMAT) return false;
+    target = header[5];
+    compression = header[6];
+    imageSize = otaReadU32(header + 8);
+    payloadSize = otaReadU32(header + 12);
+    blockSize = otaReadU32(header + 16);
+    memcpy(version, header + 20, OTA_VERSION_MAX);
+    version[OTA_VERSION_MAX] = '\0';
+    memcpy(imageSha256, header + 52, SHA256_DIGEST_SIZE);
+    if (target != OTA_TARGET_AWG && target != OTA_TARGET_DISPLAY) return false;
+    if (compression != OTA_COMPRESSION_NONE && compression != OTA_COMPRESSION_LZSS) return false;
+    if (blockSize == 0 || blockSize > OTA_MAX_BLOCK_SIZE || blockSize % OTA_SECTOR_SIZE != 0) return false;
+    if (imageSize == 0 || header[20 + OTA_VERSION_MAX - 1] != '\0') return false;
+    uint32_t blocks = (imageSize + blockSize - 1) / blockSize;
+    return payloadSize >= blocks * 5 && payloadSize <= imageSize + blocks * 4;
+  }
+};
+
+// Punto de control: todo lo necesario para seguir tras un corte o un reinicio. Struct plano
+// para guardarlo tal cual en NVS
+struct OtaCheckpoint {
+  uint32_t format;                 // OTA_PACKAGE_FORMAT; otro valor = sin punto de control
+  uint8_t header[OTA_HEADER_SIZE];
+  uint32_t payloadOffset;          // Payload consumido hasta el último bloque escrito
+  uint32_t imageOffset;            // Imagen escrita
+  Sha256 sha;                      // SHA-256 de imagen[0, imageOffset)
+};
+
+// Flash y persistencia de la sesión
+class OtaSink {
+ public:
+  virtual ~OtaSink() {}
+  // Escribe un bloque de la imagen; offset múltiplo del tamaño de bloque. Debe borrar los
+  // sectores antes de escribir: tras reanudar pueden tener datos del intento anterior
+  virtual bool writeBlock(uint32_t offset, const uint8_t* data, size_t len) = 0;
+  // Bloque completo: el llamador decide cada cuánto lo guarda
+  virtual void checkpoint(const OtaCheckpoint& cp) { (void)cp; }
+};
+
+class OtaSession {
+ public:
+  // buffer: OTA_MAX_BLOCK_SIZE bytes para el bloque en curso. maxImageSize: la partición
+  void begin(OtaSink* sink, const uint8_t publicKey[ED25519_KEY_SIZE], uint8_t target, uint32_t maxImageSize,
+             uint8_t* buffer) {
+    sink_ = sink;
+    memcpy(publicKey_, publicKey, ED25519_KEY_SIZE);
+    target_ = target;
+    maxImageSize_ = maxImageSize;
+    out_ = buffer;
+    memset(&cp_, 0, sizeof(cp_));
+    headerFill_ = 0;
+    headerOk_ = false;
+    result_ = OTA_CONTINUE;
+    rewind();
+  }
+
+  // Sigue desde un punto de control guardado (mismo destino y encabezado válido)
+  bool restore(const OtaCheckpoint& cp) {
+    if (cp.format != OTA_PACKAGE_FORMAT) return false;
+    memcpy(header_, cp.header, OTA_HEADER_SIZE);
+    headerFill_ = OTA_HEADER_SIZE;
+    if (checkHeader() != OTA_CONTINUE) {
+      headerFill_ = 0;
+      headerOk_ = false;
+      return false;
+    }
+    if (cp.imageOffset > info_.imageSize || cp.payloadOffset > info_.payloadSize || cp.imageOffset % info_.blockSize) {
+      headerFill_ = 0;
+      headerOk_ = false;
+      return false;
+    }
+    cp_ = cp;
+    result_ = OTA_CONTINUE;
+    rewind();
+    return true;
+  }
+
+  // Descarta el bloque a medias y vuelve al último punto de control: tras un corte los
+  // bytes deben retomarse desde resumeOffset()
+  void rewind() {
+    if (!headerOk_) headerFill_ = 0;
+    payloadPos_ = cp_.payloadOffset;
+    imagePos_ = cp_.imageOffset;
+    sha_ = cp_.sha;
+    blockHeaderFill_ = 0;
+    inBlock_ = false;
+    if (result_ != OTA_DONE) result_ = OTA_CONTINUE;
+  }
+
+  // Offset del paquete desde el que hacen falta bytes
+  uint32_t resumeOffset() const { return headerOk_ ? OTA_HEADER_SIZE + cp_.payloadOffset : 0; }
+  // Offset del próximo byte que espera feed()
+  uint32_t position() const { return headerOk_ ? OTA_HEADER_SIZE + payloadPos_ : headerFill_; }
+  uint32_t packageSize() const { return headerOk_ ? OTA_HEADER_SIZE + info_.payloadSize : 0; }
+  uint32_t imageWritten() const { return cp_.imageOffset; }
+  bool headerVerified() const { return headerOk_; }
+  const OtaPackageInfo& info() const { return info_; }
+  const OtaCheckpoint& checkpointState() const { return cp_; }
+  OtaResult result() const { return result_; }
+
+  // Bytes consecutivos del paquete a partir de position()
+  OtaResult feed(const uint8_t* data, size_t len) {
+    while (len > 0 && result_ == OTA_CONTINUE) {
+      if (!headerOk_) {
+        size_t n = OTA_HEADER_SIZE - headerFill_ < len ? OTA_HEADER_SIZE - headerFill_ : len;
+        memcpy(header_ + headerFill_, data, n);
+        headerFill_ += n;
+        data += n;
+        len -= n;
+        if (headerFill_ == OTA_HEADER_SIZE) {
+          result_ = checkHeader();
+          if (result_ == OTA_CONTINUE) {
+            memcpy(cp_.header, header_, OTA_HEADER_SIZE);
+            cp_.format = OTA_PACKAGE_FORMAT;
+            cp_.sha.begin();
+            sha_ = cp_.sha;
+          }
+        }
+        continue;
+      }
+      if (payloadPos_ >= info_.payloadSize) return result_ = OTA_ERR_OFFSET;
+      uint8_t b = *data++;
+      len--;
+      payloadPos_++;
+      if (!inBlock_) {
+        blockHeader_[blockHeaderFill_++] = b;
+        if (blockHeaderFill_ == 4) startBlock();
+      } else if (blockRaw_) {
+        out_[outLen_++] = b;
+        blockLeft_--;
+      } else {
+        decode(b);
+        blockLeft_--;
+      }
+      if (result_ == OTA_CONTINUE && inBlock_ && blockLeft_ == 0) finishBlock();
+    }
+    return result_;
+  }
+
+  // feed() con el offset absoluto del trozo (MQTT). Un trozo repetido ya consumido se
+  // ignora; uno que deja un hueco devuelve OTA_ERR_OFFSET sin cambiar la sesión
+  OtaResult feedAt(uint32_t offset, const uint8_t* data, size_t len) {
+    uint32_t pos = position();
+    if (offset > pos) return OTA_ERR_OFFSET;
+    if (offset + len <= pos) return result_;
+    size_t skip = pos - offset;
+    return feed(data + skip, len - skip);
+  }
+
+ private:
+  OtaSink* sink_ = nullptr;
+  uint8_t publicKey_[ED25519_KEY_SIZE];
+  uint8_t target_ = 0;
+  uint32_t maxImageSize_ = 0;
+  uint8_t* out_ = nullptr;
+
+  uint8_t header_[OTA_HEADER_SIZE];
+  size_t headerFill_ = 0;
+  bool headerOk_ = false;
+  OtaPackageInfo info_;
+  OtaCheckpoint cp_;
+  OtaResult result_ = OTA_CONTINUE;
+
+  // Bloque en curso
+  uint32_t payloadPos_ = 0;
+  uint32_t imagePos_ = 0;
+  Sha256 sha_;
+  uint8_t blockHeader_[4];
+  size_t blockHeaderFill_ = 0;
+  bool inBlock_ = false;
+  bool blockRaw_ = false;
+  uint32_t blockLeft_ = 0;    // Bytes almacenados por consumir
+  uint32_t blockExpect_ = 0;  // Bytes de imagen que debe dar el bloque
+  uint32_t outLen_ = 0;
+  // Decodificador LZSS
+  uint8_t flags_ = 0;
+  uint8_t flagBits_ = 0;
+  uint8_t pending_ = 0;
+  bool havePending_ = false;
+
+  OtaResult checkHeader() {
+    if (!info_.parse(header_)) return OTA_ERR_HEADER;
+    if (info_.target != target_) return OTA_ERR_TARGET;
+    if (info_.imageSize > maxImageSize_) return OTA_ERR_TOO_LARGE;
+    bool keySet = false;
+    for (int i = 0; i < ED25519_KEY_SIZE; i++) keySet |= publicKey_[i] != 0;
+    if (!keySet) return OTA_ERR_NO_KEY;
+    if (!Ed25519::verify(header_ + OTA_SIGNED_SIZE, header_, OTA_SIGNED_SIZE, publicKey_)) return OTA_ERR_SIGNATURE;
+    headerOk_ = true;
+    return OTA_CONTINUE;
+  }
+
+  void startBlock() {
+    uint32_t word = otaReadU32(blockHeader_);
+    blockHeaderFill_ = 0;
+    blockRaw_ = (word & OTA_BLOCK_RAW_FLAG) != 0 || info_.compression == OTA_COMPRESSION_NONE;
+    blockLeft_ = word & OTA_BLOCK_LENGTH_MASK;
+    uint32_t remaining = info_.imageSize - imagePos_;
+    blockExpect_ = remaining < info_.blockSize ? remaining : info_.blockSize;
+    bool ok = blockExpect_ > 0 && blockLeft_ > 0 && blockLeft_ <= blockExpect_ + blockExpect_ / 8 + 1 &&
+              (!blockRaw_ || blockLeft_ == blockExpect_) && payloadPos_ + blockLeft_ <= info_.payloadSize;
+    if (!ok) {
+      result_ = OTA_ERR_CORRUPT;
+      return;
+    }
+    inBlock_ = true;
+    outLen_ = 0;
+    flagBits_ = 0;
+    havePending_ = false;
+  }
+
+  void decode(uint8_t b) {
+    if (flagBits_ == 0) {
+      flags_ = b;
+      flagBits_ = 8;
+      return;
+    }
+    if (flags_ & 1) {
+      if (outLen_ >= blockExpect_) {
+        result_ = OTA_ERR_CORRUPT;
+        return;
+      }
+      out_[outLen_++] = b;
+    } else if (!havePending_) {
+      pending_ = b;
+      havePending_ = true;
+      return;
+    } else {
+      uint32_t offset = ((((uint32_t)b & 0xF0) << 4) | pending_) + 1;
+      uint32_t length = (b & 0x0F) + OTA_LZSS_MIN_MATCH;
+      havePending_ = false;
+      if (offset > outLen_ || outLen_ + length > blockExpect_) {
+        result_ = OTA_ERR_CORRUPT;
+        return;
+      }
+      for (uint32_t i = 0; i < length; i++, outLen_++) out_[outLen_] = out_[outLen_ - offset];  // Puede solaparse
+    }
+    flags_ >>= 1;
+    flagBits_--;
+  }
+
+  void finishBlock() {
+    inBlock_ = false;
+    if (outLen_ != blockExpect_ || havePending_) {
+      result_ = OTA_ERR_CORRUPT;
+      return;
+    }
+    if (!sink_->writeBlock(imagePos_, out_, outLen_)) {
+      result_ = OTA_ERR_WRITE;
+      return;
+    }
+    sha_.update(out_, outLen_);
+    imagePos_ += outLen_;
+    cp_.payloadOffset = payloadPos_;
+    cp_.imageOffset = imagePos_;
+    cp_.sha = sha_;
+    if (imagePos_ == info_.imageSize) {
+      uint8_t digest[SHA256_DIGEST_SIZE];
+      Sha256 final = sha_;
+      final.finish(digest);
+      if (payloadPos_ != info_.payloadSize) {
+        result_ = OTA_ERR_CORRUPT;
+      } else if (memcmp(digest, info_.imageSha256, SHA256_DIGEST_SIZE) != 0) {
+        result_ = OTA_ERR_HASH;
+      } else {
+        result_ = OTA_DONE;
+      }
+    }
+    if (result_ == OTA_CONTINUE || result_ == OTA_DONE) sink_->checkpoint(cp_);
+  }
+};
+
+#endif  // OTA_PACKAGE_H
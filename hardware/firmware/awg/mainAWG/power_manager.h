@@ -0,0 +1,227 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+// Gestión de energía en reposo: sueño ligero y escalado de frecuencia entre trabajos
+//
+// El loop es un conjunto de trabajos periódicos (sensores cada 2 s, UART y MQTT cada 5 s,
+// LED cada 200 ms...) y entre ellos solo sondea el botón y los puertos serie. Al final de
+// cada iteración se calcula el plazo del próximo trabajo y el loop cede la CPU hasta
+// entonces (acotado a POWER_MAX_IDLE_MS para que el botón y los comandos sigan respondiendo).
+// Con el gestor de energía de ESP-IDF, ese tiempo cedido se convierte en sueño ligero
+// automático y el WiFi queda en modem sleep despertando en cada DTIM, así que la conexión
+// MQTT sigue viva.
+//
+// Gobernador de frecuencia: mide la fracción de tiempo que el loop pasa ocupado en una
+// ventana de POWER_LOAD_WINDOW_MS y sube o baja un escalón de POWER_FREQ_STEPS_MHZ con
+// histéresis. El mínimo es 80 MHz: por debajo cambia el reloj APB y con él los baudios del UART.
+//
+// Métricas: corriente media estimada a partir del tiempo en cada estado y corrientes
+// típicas de la hoja de datos (el ESP32 no mide su propio consumo, el PZEM mide el equipo
+// completo), latencia de despertar (retraso sobre el fin de reposo previsto) y plazos
+// perdidos (un trabajo ejecutado más de POWER_DEADLINE_TOLERANCE_MS tarde).
+//
+// Sin dependencias de Arduino: el cálculo de plazos, el gobernador y las métricas pueden
+// evaluarse en host con trazas de tiempos simuladas.
+
+#include <stdint.h>
+
+#define POWER_MAX_JOBS 8                  // Trabajos periódicos registrables
+#define POWER_MAX_IDLE_MS 50              // Reposo máximo por iteración (latencia del botón y del UART)
+#define POWER_ACTIVE_IDLE_MS 5            // Reposo máximo con actividad reciente en los puertos serie
+#define POWER_MIN_IDLE_MS 2               // Por debajo no compensa ceder la CPU
+#define POWER_UART_HOLD_MS 3000UL         // Tras recibir por UART se evita el sueño ligero (ms)
+#define POWER_DEADLINE_TOLERANCE_MS 100   // Retraso a partir del cual un trabajo cuenta como plazo perdido
+#define POWER_LOAD_WINDOW_MS 10000UL      // Ventana de medición de carga del gobernador (ms)
+#define POWER_LOAD_HIGH 0.50f             // Carga sobre la que se sube un escalón de frecuencia
+#define POWER_LOAD_LOW 0.15f              // Carga bajo la que se baja un escalón (histéresis)
+
+// Escalones de frecuencia de CPU (MHz), de menor a mayor
+#define POWER_FREQ_STEP_COUNT 3
+static const uint16_t POWER_FREQ_STEPS_MHZ[POWER_FREQ_STEP_COUNT] = { 80, 160, 240 };
+
+// Corrientes típicas del ESP32 con WiFi en modem sleep (mA), para estimar el consumo medio
+static const float POWER_CURRENT_ACTIVE_MA[POWER_FREQ_STEP_COUNT] = { 28.0f, 40.0f, 55.0f };
+#define POWER_CURRENT_IDLE_MA 20.0f       // CPU detenida en espera, sin sueño ligero
+#define POWER_CURRENT_SLEEP_MA 3.0f       // Sueño ligero, promediando los despertares por DTIM
+
+// Trabajo periódico: última ejecución (millis) e intervalo. Un trabajo deshabilitado (p. ej.
+// publicación MQTT sin conexión) no cuenta para el plazo ni para los plazos perdidos
+struct PowerJob {
+  uint32_t last;
+  uint32_t interval;
+  bool enabled;
+};
+
+class PowerManager {
+public:
+  void begin(uint8_t freqStep = POWER_FREQ_STEP_COUNT - 1) {
+    freqStep_ = freqStep < POWER_FREQ_STEP_COUNT ? freqStep : POWER_FREQ_STEP_COUNT - 1;
+    for (uint8_t i = 0; i < POWER_MAX_JOBS; i++) tracked_[i] = false;
+    windowStartMs_ = 0;
+    windowBusyUs_ = 0;
+    windowOpen_ = false;
+    load_ = 0.0f;
+    resetStats();
+  }
+
+  void resetStats() {
+    for (uint8_t i = 0; i < POWER_FREQ_STEP_COUNT; i++) busyUs_[i] = 0;
+    idleUs_ = 0;
+    sleepUs_ = 0;
+    wakeCount_ = 0;
+    wakeLatencySumUs_ = 0;
+    wakeLatencyMaxUs_ = 0;
+    jobRuns_ = 0;
+    missedDeadlines_ = 0;
+    maxLatenessMs_ = 0;
+    freqChanges_ = 0;
+  }
+
+  // Milisegundos que el loop puede ceder antes del próximo plazo (0 si algún trabajo ya venció)
+  static uint32_t idleBudget(uint32_t nowMs, const PowerJob* jobs, uint8_t count, uint32_t maxIdleMs = POWER_MAX_IDLE_MS) {
+    uint32_t budget = maxIdleMs;
+    for (uint8_t i = 0; i < count; i++) {
+      if (!jobs[i].enabled) continue;
+      uint32_t elapsed = nowMs - jobs[i].last;
+      if (elapsed >= jobs[i].interval) return 0;
+      uint32_t remaining = jobs[i].interval - elapsed;
+      if (remaining < budget) budget = remaining;
+    }
+    return budget < POWER_MIN_IDLE_MS ? 0 : budget;
+  }
+
+  // Detecta qué trabajos se ejecutaron desde la llamada anterior (cambió su marca de tiempo)
+  // y cuánto tarde respecto a su plazo. Llamar una vez por iteración con la misma tabla
+  void trackJobs(const PowerJob* jobs, uint8_t count) {
+    if (count > POWER_MAX_JOBS) count = POWER_MAX_JOBS;
+    for (uint8_t i = 0; i < count; i++) {
+      if (!jobs[i].enabled) {
+        tracked_[i] = false;  // Al rehabilitarse no se le cobra el tiempo deshabilitado
+        continue;
+      }
+      if (!tracked_[i]) {
+        tracked_[i] = true;
+        lastSeen_[i] = jobs[i].last;
+        continue;
+      }
+      if (jobs[i].last == lastSeen_[i]) continue;
+      int32_t lateness = (int32_t)(jobs[i].last - (lastSeen_[i] + jobs[i].interval));
+      if (lateness > 0 && (uint32_t)lateness > maxLatenessMs_) maxLatenessMs_ = (uint32_t)lateness;
+      if (lateness > POWER_DEADLINE_TOLERANCE_MS) missedDeadlines_++;
+      jobRuns_++;
+      lastSeen_[i] = jobs[i].last;
+    }
+  }
+
+  // Tiempo ocupado de una iteración (µs) a la frecuencia vigente
+  void accountBusy(uint32_t nowMs, uint32_t busyUs) {
+    busyUs_[freqStep_] += busyUs;
+    if (!windowOpen_) {
+      windowOpen_ = true;
+      windowStartMs_ = nowMs;
+      windowBusyUs_ = 0;
+    }
+    windowBusyUs_ += busyUs;
+  }
+
+  // Reposo previsto (ms) frente al medido (µs). sleepAllowed indica si pudo haber sueño ligero
+  void accountIdle(uint32_t plannedMs, uint32_t actualUs, bool sleepAllowed) {
+    if (sleepAllowed) {
+      sleepUs_ += actualUs;
+    } else {
+      idleUs_ += actualUs;
+    }
+    uint32_t plannedUs = plannedMs * 1000UL;
+    uint32_t latency = actualUs > plannedUs ? actualUs - plannedUs : 0;
+    wakeCount_++;
+    wakeLatencySumUs_ += latency;
+    if (latency > wakeLatencyMaxUs_) wakeLatencyMaxUs_ = latency;
+  }
+
+  // Cierra la ventana de carga si corresponde y devuelve true si cambió el escalón de frecuencia
+  bool govern(uint32_t nowMs) {
+    if (!windowOpen_) return false;
+    uint32_t span = nowMs - windowStartMs_;
+    if (span < POWER_LOAD_WINDOW_MS) return false;
+    load_ = (float)windowBusyUs_ / ((float)span * 1000.0f);
+    if (load_ > 1.0f) load_ = 1.0f;
+    windowOpen_ = false;
+
+    uint8_t step = freqStep_;
+    if (load_ > POWER_LOAD_HIGH && step + 1 < POWER_FREQ_STEP_COUNT) {
+      step++;
+    } else if (load_ < POWER_LOAD_LOW && step > 0) {
+      step--;
+    }
+    if (step == freqStep_) return false;
+    freqStep_ = step;
+    freqChanges_++;
+    return true;
+  }
+
+  uint16_t freqMhz() const { return POWER_FREQ_STEPS_MHZ[freqStep_]; }
+  uint8_t freqStep() const { return freqStep_; }
+  float load() const { return load_; }
+
+  // Corriente media estimada del ESP32 desde resetStats() (mA)
+  float averageCurrentMa() const {
+    double totalUs = (double)idleUs_ + (double)sleepUs_;
+    double charge = (double)idleUs_ * POWER_CURRENT_IDLE_MA + (double)sleepUs_ * POWER_CURRENT_SLEEP_MA;
+    for (uint8_t i = 0; i < POWER_FREQ_STEP_COUNT; i++) {
+      totalUs += (double)busyUs_[i];
+      charge += (double)busyUs_[i] * POWER_CURRENT_ACTIVE_MA[i];
+    }
+    return totalUs > 0.0 ? (float)(charge / totalUs) : 0.0f;
+  }
+
+  // Fracciones del tiempo total (0-1)
+  float busyFraction() const { return fraction(busyTotalUs()); }
+  float sleepFraction() const { return fraction(sleepUs_); }
+  float idleFraction() const { return fraction(idleUs_); }
+
+  uint32_t wakeLatencyAvgUs() const { return wakeCount_ > 0 ? (uint32_t)(wakeLatencySumUs_ / wakeCount_) : 0; }
+  uint32_t wakeLatencyMaxUs() const { return wakeLatencyMaxUs_; }
+  uint32_t wakeCount() const { return wakeCount_; }
+  uint32_t jobRuns() const { return jobRuns_; }
+  uint32_t missedDeadlines() const { return missedDeadlines_; }
+  uint32_t maxLatenessMs() const { return maxLatenessMs_; }
+  uint32_t freqChanges() const { return freqChanges_; }
+
+private:
+  uint8_t freqStep_ = POWER_FREQ_STEP_COUNT - 1;
+
+  // Seguimiento de trabajos
+  bool tracked_[POWER_MAX_JOBS] = { false };
+  uint32_t lastSeen_[POWER_MAX_JOBS] = { 0 };
+
+  // Ventana de carga del gobernador
+  bool windowOpen_ = false;
+  uint32_t windowStartMs_ = 0;
+  uint32_t windowBusyUs_ = 0;
+  float load_ = 0.0f;
+
+  // Estadísticas
+  uint64_t busyUs_[POWER_FREQ_STEP_COUNT] = { 0 };
+  uint64_t idleUs_ = 0;
+  uint64_t sleepUs_ = 0;
+  uint32_t wakeCount_ = 0;
+  uint64_t wakeLatencySumUs_ = 0;
+  uint32_t wakeLatencyMaxUs_ = 0;
+  uint32_t jobRuns_ = 0;
+  uint32_t missedDeadlines_ = 0;
+  uint32_t maxLatenessMs_ = 0;
+  uint32_t freqChanges_ = 0;
+
+  uint64_t busyTotalUs() const {
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < POWER_FREQ_STEP_COUNT; i++) total += busyUs_[i];
+    return total;
+  }
+
+  float fraction(uint64_t part) const {
+    uint64_t total = busyTotalUs() + idleUs_ + sleepUs_;
+    return total > 0 ? (float)((double)part / (double)total) : 0.0f;
+  }
+};
+
+#endif  // POWER_MANAGER_H
@@ -0,0 +1,267 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+// Agregados en línea por minuto, hora y día
+//
+// Cada muestra actualiza un acumulador abierto por resolución (mín/máx/media/último de
+// cada métrica, energía consumida, agua producida y fracción de compresor encendido).
+// Cuando la hora del RTC cruza el límite del intervalo, el acumulador se cierra en un
+// registro compacto (valores escalados a int16) que entra en una tabla circular de tamaño
+// fijo; el registro más antiguo se sobrescribe. La memoria queda fijada en compilación:
+// (60 + 48 + 31) registros de 56 bytes más tres acumuladores, unos 8 KB.
+//
+// Energía: diferencia del contador acumulado del PZEM (un retroceso por RESET_ENERGY no
+// suma). Agua: integral de la tasa de producción del estimador de nivel, de modo que el
+// bombeo y las extracciones no cuentan. Un salto de reloj mayor que ROLLUP_MAX_GAP_S
+// (reinicio, SET_TIME) no acumula energía, agua ni tiempo.
+//
+// Sin dependencias de Arduino: la hora (s desde epoch) la entrega el llamador, de modo que
+// la aritmética de agregación puede probarse en host.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ROLLUP_MINUTE_BUCKETS 60   // Última hora en minutos
+#define ROLLUP_HOUR_BUCKETS 48     // Últimos dos días en horas
+#define ROLLUP_DAY_BUCKETS 31      // Último mes en días
+#define ROLLUP_MAX_GAP_S 300UL     // Paso máximo entre muestras que aún se integra (s)
+#define ROLLUP_STORE_VERSION 1
+#define ROLLUP_NO_VALUE INT16_MIN  // Métrica sin muestras válidas en el intervalo
+
+enum RollupLevel : uint8_t {
+  ROLLUP_MINUTE = 0,
+  ROLLUP_HOUR,
+  ROLLUP_DAY,
+  ROLLUP_LEVEL_COUNT
+};
+
+enum RollupMetric : uint8_t {
+  ROLLUP_TEMP = 0,   // Temperatura ambiente (°C)
+  ROLLUP_HUM,        // Humedad relativa (%)
+  ROLLUP_ABS_HUM,    // Humedad absoluta (g/m3)
+  ROLLUP_VOLUME,     // Agua almacenada (L)
+  ROLLUP_POWER,      // Potencia (W)
+  ROLLUP_METRIC_COUNT
+};
+
+static const uint32_t ROLLUP_PERIOD_S[ROLLUP_LEVEL_COUNT] = { 60UL, 3600UL, 86400UL };
+static const uint16_t ROLLUP_CAPACITY[ROLLUP_LEVEL_COUNT] = { ROLLUP_MINUTE_BUCKETS, ROLLUP_HOUR_BUCKETS, ROLLUP_DAY_BUCKETS };
+static const char* const ROLLUP_LEVEL_NAME[ROLLUP_LEVEL_COUNT] = { "minute", "hour", "day" };
+static const char* const ROLLUP_METRIC_KEY[ROLLUP_METRIC_COUNT] = { "t", "h", "ha", "w", "po" };
+// Escala de almacenamiento (resolución = 1/escala): 0.01 °C, 0.01 %, 0.01 g/m3, 0.1 L, 1 W
+static const float ROLLUP_SCALE[ROLLUP_METRIC_COUNT] = { 100.0f, 100.0f, 100.0f, 10.0f, 1.0f };
+
+// Intervalo cerrado tal como se guarda en las tablas y en NVS
+struct RollupRecord {
+  uint32_t start;       // Inicio del intervalo (s desde epoch, hora local del RTC)
+  uint16_t samples;     // Muestras agregadas
+  uint16_t duty;        // Fracción con compresor encendido (0-10000)
+  float energyKWh;      // Energía consumida en el intervalo
+  float waterL;         // Agua producida en el intervalo
+  int16_t minV[ROLLUP_METRIC_COUNT];
+  int16_t maxV[ROLLUP_METRIC_COUNT];
+  int16_t meanV[ROLLUP_METRIC_COUNT];
+  int16_t lastV[ROLLUP_METRIC_COUNT];
+};
+
+// Entradas de una muestra; NAN en una métrica = sensor no disponible
+struct RollupSample {
+  float values[ROLLUP_METRIC_COUNT];
+  float energyKWh;       // Contador acumulado (kWh)
+  float productionRate;  // Tasa de producción (L/h)
+  bool compressorOn;
+};
+
+// Intervalo abierto (también se persiste para no perder el día en curso al reiniciar)
+struct RollupAccumulator {
+  uint32_t start;
+  bool open;
+  uint32_t samples;
+  float elapsedSec, compressorSec;
+  float energyKWh, waterL;
+  float minV[ROLLUP_METRIC_COUNT];
+  float maxV[ROLLUP_METRIC_COUNT];
+  float sum[ROLLUP_METRIC_COUNT];
+  float lastV[ROLLUP_METRIC_COUNT];
+  uint32_t count[ROLLUP_METRIC_COUNT];
+};
+
+// Cabecera de una tabla persistida
+struct RollupTableHeader {
+  uint8_t version;
+  uint8_t level;
+  uint16_t head;   // Índice del registro más antiguo
+  uint16_t count;  // Registros válidos
+};
+
+static inline float rollupDecode(int16_t raw, uint8_t metric) {
+  return raw == ROLLUP_NO_VALUE ? NAN : raw / ROLLUP_SCALE[metric];
+}
+
+static inline int16_t rollupEncode(float value, uint8_t metric) {
+  if (isnan(value)) return ROLLUP_NO_VALUE;
+  float scaled = roundf(value * ROLLUP_SCALE[metric]);
+  if (scaled > 32767.0f) return 32767;
+  if (scaled < -32767.0f) return -32767;
+  return (int16_t)scaled;
+}
+
+class RollupEngine {
+public:
+  void begin() {
+    memset(records_, 0, sizeof(records_));
+    for (int l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+      head_[l] = 0;
+      count_[l] = 0;
+      clearAccumulator(acc_[l]);
+    }
+    lastEpoch_ = 0;
+    lastEnergy_ = NAN;
+  }
+
+  // Agrega una muestra. Devuelve una máscara (1 << nivel) con los intervalos cerrados
+  uint8_t sample(uint32_t epoch, const RollupSample& s) {
+    if (epoch == 0) return 0;
+    float dt = 0.0f;
+    if (lastEpoch_ != 0 && epoch > lastEpoch_ && epoch - lastEpoch_ <= ROLLUP_MAX_GAP_S) dt = (float)(epoch - lastEpoch_);
+    lastEpoch_ = epoch;
+
+    float dE = 0.0f;
+    if (!isnan(s.energyKWh)) {
+      if (dt > 0.0f && !isnan(lastEnergy_) && s.energyKWh >= lastEnergy_) dE = s.energyKWh - lastEnergy_;
+      lastEnergy_ = s.energyKWh;
+    }
+    float dW = (!isnan(s.productionRate) && s.productionRate > 0.0f) ? s.productionRate * dt / 3600.0f : 0.0f;
+
+    uint8_t closed = 0;
+    for (uint8_t l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+      RollupAccumulator& a = acc_[l];
+      uint32_t bucketStart = epoch - epoch % ROLLUP_PERIOD_S[l];
+      if (a.open && a.start != bucketStart) {
+        push(l, a);
+        closed |= (uint8_t)(1 << l);
+      }
+      if (!a.open) {
+        clearAccumulator(a);
+        a.open = true;
+        a.start = bucketStart;
+      }
+      a.samples++;
+      a.elapsedSec += dt;
+      if (s.compressorOn) a.compressorSec += dt;
+      a.energyKWh += dE;
+      a.waterL += dW;
+      for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+        float v = s.values[m];
+        if (isnan(v)) continue;
+        if (a.count[m] == 0 || v < a.minV[m]) a.minV[m] = v;
+        if (a.count[m] == 0 || v > a.maxV[m]) a.maxV[m] = v;
+        a.sum[m] += v;
+        a.lastV[m] = v;
+        a.count[m]++;
+      }
+    }
+    return closed;
+  }
+
+  uint16_t count(uint8_t level) const { return count_[level]; }
+
+  // Registro i de la tabla, del más antiguo (0) al más reciente (count - 1)
+  const RollupRecord& record(uint8_t level, uint16_t i) const {
+    return slot(level)[(head_[level] + i) % ROLLUP_CAPACITY[level]];
+  }
+
+  const RollupRecord* latest(uint8_t level) const {
+    return count_[level] ? &record(level, count_[level] - 1) : nullptr;
+  }
+
+  // Vista del intervalo en curso con el mismo formato que un registro cerrado
+  bool openRecord(uint8_t level, RollupRecord& out) const {
+    if (!acc_[level].open) return false;
+    out = toRecord(acc_[level]);
+    return true;
+  }
+
+  // Persistencia: cada tabla es una cabecera más el bloque de registros. Para restaurar se
+  // leen los registros directamente sobre tableData() y luego se valida la cabecera
+  RollupTableHeader header(uint8_t level) const {
+    RollupTableHeader h;
+    h.version = ROLLUP_STORE_VERSION;
+    h.level = level;
+    h.head = head_[level];
+    h.count = count_[level];
+    return h;
+  }
+  RollupRecord* tableData(uint8_t level) { return slot(level); }
+  size_t tableBytes(uint8_t level) const { return ROLLUP_CAPACITY[level] * sizeof(RollupRecord); }
+
+  bool restoreTable(const RollupTableHeader& h) {
+    if (h.version != ROLLUP_STORE_VERSION || h.level >= ROLLUP_LEVEL_COUNT) return false;
+    if (h.count > ROLLUP_CAPACITY[h.level] || h.head >= ROLLUP_CAPACITY[h.level]) return false;
+    head_[h.level] = h.head;
+    count_[h.level] = h.count;
+    return true;
+  }
+
+  const RollupAccumulator* accumulators() const { return acc_; }
+  size_t accumulatorBytes() const { return sizeof(acc_); }
+
+  // Un acumulador restaurado que ya no es el intervalo actual se cierra en la próxima muestra
+  void restoreAccumulators(const RollupAccumulator* acc) {
+    for (uint8_t l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+      acc_[l] = acc[l];
+      if (acc_[l].open && acc_[l].start % ROLLUP_PERIOD_S[l] != 0) clearAccumulator(acc_[l]);
+    }
+  }
+
+private:
+  RollupRecord records_[ROLLUP_MINUTE_BUCKETS + ROLLUP_HOUR_BUCKETS + ROLLUP_DAY_BUCKETS];
+  uint16_t head_[ROLLUP_LEVEL_COUNT] = { 0 };
+  uint16_t count_[ROLLUP_LEVEL_COUNT] = { 0 };
+  RollupAccumulator acc_[ROLLUP_LEVEL_COUNT];
+  uint32_t lastEpoch_ = 0;
+  float lastEnergy_ = NAN;
+
+  RollupRecord* slot(uint8_t level) {
+    return records_ + (level > 0 ? ROLLUP_MINUTE_BUCKETS : 0) + (level > 1 ? ROLLUP_HOUR_BUCKETS : 0);
+  }
+  const RollupRecord* slot(uint8_t level) const {
+    return records_ + (level > 0 ? ROLLUP_MINUTE_BUCKETS : 0) + (level > 1 ? ROLLUP_HOUR_BUCKETS : 0);
+  }
+
+  static void clearAccumulator(RollupAccumulator& a) {
+    memset(&a, 0, sizeof(a));
+  }
+
+  static RollupRecord toRecord(const RollupAccumulator& a) {
+    RollupRecord r;
+    r.start = a.start;
+    r.samples = a.samples > 65535UL ? 65535 : (uint16_t)a.samples;
+    r.duty = a.elapsedSec > 0.0f ? (uint16_t)roundf(10000.0f * a.compressorSec / a.elapsedSec) : 0;
+    r.energyKWh = a.energyKWh;
+    r.waterL = a.waterL;
+    for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+      bool any = a.count[m] > 0;
+      r.minV[m] = any ? rollupEncode(a.minV[m], m) : ROLLUP_NO_VALUE;
+      r.maxV[m] = any ? rollupEncode(a.maxV[m], m) : ROLLUP_NO_VALUE;
+      r.meanV[m] = any ? rollupEncode(a.sum[m] / a.count[m], m) : ROLLUP_NO_VALUE;
+      r.lastV[m] = any ? rollupEncode(a.lastV[m], m) : ROLLUP_NO_VALUE;
+    }
+    return r;
+  }
+
+  void push(uint8_t level, RollupAccumulator& a) {
+    uint16_t cap = ROLLUP_CAPACITY[level];
+    uint16_t idx = (head_[level] + count_[level]) % cap;
+    slot(level)[idx] = toRecord(a);
+    if (count_[level] < cap) {
+      count_[level]++;
+    } else {
+      head_[level] = (uint16_t)((head_[level] + 1) % cap);
+    }
+    a.open = false;
+  }
+};
+
+#endif  // ROLLUP_H
@@ -0,0 +1,300 @@
+#ifndef SAFETY_SUPERVISOR_H
+#define SAFETY_SUPERVISOR_H
+
+// Supervisor de seguridad: límites del compresor y la bomba con tiempo de reacción acotado
+//
+// Las protecciones de loop() (checkAlerts, processControl, handleCompressorProtection) solo
+// actúan cuando el loop llega a ellas: una conexión al broker, el portal o una lectura Modbus
+// trabada las demoran segundos. El supervisor corre en su propia tarea con período fijo
+// (SAFETY_PERIOD_MS en mainAWG.ino) y decide solo con lo que recibe:
+//
+// - publish(): la última muestra de sensores, que el loop entrega tras cada lectura
+// - tick(): el estado real de los relés y el último latido del loop, en cada período
+//
+// Cada límite superado queda enclavado hasta que la condición se recupera con histéresis.
+// Mientras haya un enclavamiento del compresor o de la bomba, tick() pide apagarlo y
+// compressorAllowed()/pumpAllowed() impiden que el loop lo vuelva a encender:
+//
+//   over_temp   temperatura del compresor >= máximo             compresor
+//   tank_full   tanque >= umbral de lleno                       compresor
+//   max_on      compresor encendido más de maxOnMs              compresor (y restartDelayMs apagado)
+//   pump_dry    agua <= mínimo de la bomba                      bomba
+//   stale       muestra más vieja que staleMs con algo encendido  ambos
+//
+// Una lectura NaN no dispara ni libera nada: el termistor suelto o el tanque sin calibrar
+// dejan el enclavamiento como estaba y, si el loop deja de medir, actúa stale.
+//
+// Tiempo de reacción: desde que el límite se pudo ver (la muestra que lo mostró, el
+// vencimiento de maxOnMs o de staleMs, o el encendido del relé si fue posterior) hasta el
+// período que pidió el apagado. Con el loop vivo queda por debajo de un período.
+//
+// Watchdog: feedWatchdog solo si el loop latió hace menos de loopStallMs. Si el loop se
+// traba, el supervisor apaga lo que corresponda por stale y deja que el watchdog reinicie.
+//
+// Sin dependencias de Arduino para poder probarse en host. Sin bloqueos propios: mainAWG.ino
+// serializa las llamadas de las dos tareas.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SAFETY_EVENT_SLOTS 8  // Intervenciones pendientes de registrar por el loop
+
+enum SafetyTrip : uint8_t {
+  SAFETY_TRIP_OVER_TEMP = 0,
+  SAFETY_TRIP_TANK_FULL,
+  SAFETY_TRIP_MAX_ON,
+  SAFETY_TRIP_PUMP_DRY,
+  SAFETY_TRIP_STALE,
+  SAFETY_TRIP_COUNT
+};
+
+static const char* const SAFETY_TRIP_NAME[SAFETY_TRIP_COUNT] = { "over_temp", "tank_full", "max_on", "pump_dry",
+                                                                 "stale" };
+
+enum SafetyActuator : uint8_t { SAFETY_COMPRESSOR = 0, SAFETY_PUMP, SAFETY_ACTUATOR_COUNT };
+
+static const char* const SAFETY_ACTUATOR_NAME[SAFETY_ACTUATOR_COUNT] = { "compressor", "pump" };
+
+#define SAFETY_COMPRESSOR_TRIPS ((1u << SAFETY_TRIP_OVER_TEMP) | (1u << SAFETY_TRIP_TANK_FULL) | \
+                                 (1u << SAFETY_TRIP_MAX_ON) | (1u << SAFETY_TRIP_STALE))
+#define SAFETY_PUMP_TRIPS ((1u << SAFETY_TRIP_PUMP_DRY) | (1u << SAFETY_TRIP_STALE))
+
+struct SafetyLimits {
+  float compressorTempMax;     // °C; NaN = sin límite
+  float tempHysteresis;        // Se libera en compressorTempMax - tempHysteresis
+  float tankFullPct;           // NaN = sin límite
+  float tankHysteresisPct;
+  uint32_t maxOnMs;            // 0 = sin límite
+  uint32_t restartDelayMs;     // Tras max_on, compresor apagado al menos esto
+  float pumpMinLiters;         // NaN = sin límite
+  float pumpHysteresisLiters;
+  uint32_t staleMs;            // Edad máxima de la muestra con un actuador encendido
+  uint32_t loopStallMs;        // Sin latido del loop: no se alimenta el watchdog
+};
+
+// Lo que el loop midió; NaN donde no hay lectura válida
+struct SafetySample {
+  uint32_t atMs;
+  float compressorTemp;
+  float tankPercent;
+  float waterLiters;
+};
+
+struct SafetyInputs {
+  uint32_t nowMs;
+  uint32_t loopBeatMs;   // Último inicio de loop()
+  bool compressorOn;     // Relés leídos en el pin, no lo que el loop cree
+  bool pumpOn;
+};
+
+struct SafetyActions {
+  bool compressorOff;
+  bool pumpOff;
+  bool feedWatchdog;
+};
+
+// Una intervención: el supervisor apagó un actuador encendido
+struct SafetyEvent {
+  uint8_t trip;
+  uint8_t actuator;
+  uint32_t atMs;
+  uint32_t reactionMs;
+  float value;  // °C, %, s encendido, L o s sin muestra según trip
+};
+
+struct SafetyTripStats {
+  uint32_t count;
+  uint32_t lastReactionMs;
+  uint32_t maxReactionMs;
+};
+
+class SafetySupervisor {
+ public:
+  SafetySupervisor() { reset(); }
+
+  void reset() {
+    memset(&limits_, 0, sizeof(limits_));
+    configured_ = false;
+    hasSample_ = false;
+    started_ = false;
+    startMs_ = 0;
+    latched_ = 0;
+    compressorSeenOn_ = pumpSeenOn_ = false;
+    compressorOnSinceMs_ = compressorOffSinceMs_ = pumpOnSinceMs_ = 0;
+    eventHead_ = eventCount_ = 0;
+    resetStats();
+  }
+
+  void configure(const SafetyLimits& limits) {
+    limits_ = limits;
+    configured_ = true;
+  }
+
+  void publish(const SafetySample& sample) {
+    sample_ = sample;
+    hasSample_ = true;
+  }
+
+  SafetyActions tick(const SafetyInputs& in) {
+    uint32_t now = in.nowMs;
+    if (!started_) {
+      started_ = true;
+      startMs_ = now;
+    } else {
+      uint32_t gap = elapsed(now, lastTickMs_);
+      if (gap > maxTickGapMs_) maxTickGapMs_ = gap;
+    }
+    lastTickMs_ = now;
+    ticks_++;
+
+    // Tiempo encendido según los pines
+    if (in.compressorOn && !compressorSeenOn_) compressorOnSinceMs_ = now;
+    if (!in.compressorOn && compressorSeenOn_) compressorOffSinceMs_ = now;
+    if (in.pumpOn && !pumpSeenOn_) pumpOnSinceMs_ = now;
+    compressorSeenOn_ = in.compressorOn;
+    pumpSeenOn_ = in.pumpOn;
+
+    uint32_t loopAge = elapsed(now, in.loopBeatMs);
+    if (loopAge > loopStallMaxMs_) loopStallMaxMs_ = loopAge;
+    SafetyActions out = { false, false, !configured_ || loopAge < limits_.loopStallMs };
+    if (!out.feedWatchdog) watchdogHeldTicks_++;
+    if (!configured_) return out;
+
+    uint32_t sampleAtMs = hasSample_ ? sample_.atMs : startMs_;
+    uint32_t sampleAge = elapsed(now, sampleAtMs);
+    bool fresh = hasSample_ && sampleAge <= limits_.staleMs;
+
+    if (fresh) {
+      evaluate(SAFETY_TRIP_OVER_TEMP, sample_.compressorTemp, limits_.compressorTempMax, limits_.tempHysteresis,
+               true);
+      evaluate(SAFETY_TRIP_TANK_FULL, sample_.tankPercent, limits_.tankFullPct, limits_.tankHysteresisPct, true);
+      evaluate(SAFETY_TRIP_PUMP_DRY, sample_.waterLiters, limits_.pumpMinLiters, limits_.pumpHysteresisLiters,
+               false);
+      latched_ &= ~(1u << SAFETY_TRIP_STALE);
+    } else if (in.compressorOn || in.pumpOn) {
+      latch(SAFETY_TRIP_STALE, sampleAtMs + limits_.staleMs, sampleAge / 1000.0f);
+    }
+
+    if (limits_.maxOnMs > 0 && in.compressorOn && elapsed(now, compressorOnSinceMs_) >= limits_.maxOnMs) {
+      latch(SAFETY_TRIP_MAX_ON, compressorOnSinceMs_ + limits_.maxOnMs, elapsed(now, compressorOnSinceMs_) / 1000.0f);
+    } else if (!in.compressorOn && elapsed(now, compressorOffSinceMs_) >= limits_.restartDelayMs) {
+      latched_ &= ~(1u << SAFETY_TRIP_MAX_ON);
+    }
+
+    if (in.compressorOn && (latched_ & SAFETY_COMPRESSOR_TRIPS)) {
+      out.compressorOff = true;
+      intervene(SAFETY_COMPRESSOR, SAFETY_COMPRESSOR_TRIPS, compressorOnSinceMs_, now);
+    }
+    if (in.pumpOn && (latched_ & SAFETY_PUMP_TRIPS)) {
+      out.pumpOff = true;
+      intervene(SAFETY_PUMP, SAFETY_PUMP_TRIPS, pumpOnSinceMs_, now);
+    }
+    return out;
+  }
+
+  bool compressorAllowed() const { return (latched_ & SAFETY_COMPRESSOR_TRIPS) == 0; }
+  bool pumpAllowed() const { return (latched_ & SAFETY_PUMP_TRIPS) == 0; }
+  bool latched(uint8_t trip) const { return (latched_ & (1u << trip)) != 0; }
+  uint32_t latchedMask() const { return latched_; }
+
+  // Intervenciones en orden de llegada, para registrarlas desde el loop
+  bool popEvent(SafetyEvent* out) {
+    if (eventCount_ == 0) return false;
+    *out = events_[(eventHead_ + SAFETY_EVENT_SLOTS - eventCount_) % SAFETY_EVENT_SLOTS];
+    eventCount_--;
+    return true;
+  }
+
+  const SafetyTripStats& stats(int trip) const { return stats_[trip]; }
+  uint32_t ticks() const { return ticks_; }
+  uint32_t maxTickGapMs() const { return maxTickGapMs_; }
+  uint32_t loopStallMaxMs() const { return loopStallMaxMs_; }
+  uint32_t watchdogHeldTicks() const { return watchdogHeldTicks_; }
+  uint32_t droppedEvents() const { return droppedEvents_; }
+
+  void resetStats() {
+    memset(stats_, 0, sizeof(stats_));
+    ticks_ = 0;
+    lastTickMs_ = 0;
+    maxTickGapMs_ = 0;
+    loopStallMaxMs_ = 0;
+    watchdogHeldTicks_ = 0;
+    droppedEvents_ = 0;
+  }
+
+  // Diferencia de millis() que tolera el desborde y marcas apenas posteriores a `now`
+  // (el loop puede escribirlas entre la lectura del reloj y el tick)
+  static uint32_t elapsed(uint32_t now, uint32_t then) {
+    int32_t d = (int32_t)(now - then);
+    return d > 0 ? (uint32_t)d : 0;
+  }
+
+ private:
+  SafetyLimits limits_;
+  SafetySample sample_;
+  bool configured_;
+  bool hasSample_;
+  bool started_;
+  uint32_t startMs_;
+  uint32_t latched_;
+  uint32_t onsetMs_[SAFETY_TRIP_COUNT];  // Desde cuándo se pudo ver cada límite enclavado
+  float value_[SAFETY_TRIP_COUNT];
+  bool compressorSeenOn_;
+  bool pumpSeenOn_;
+  uint32_t compressorOnSinceMs_;
+  uint32_t compressorOffSinceMs_;
+  uint32_t pumpOnSinceMs_;
+  SafetyEvent events_[SAFETY_EVENT_SLOTS];
+  uint8_t eventHead_;
+  uint8_t eventCount_;
+  SafetyTripStats stats_[SAFETY_TRIP_COUNT];
+  uint32_t ticks_;
+  uint32_t lastTickMs_;
+  uint32_t maxTickGapMs_;
+  uint32_t loopStallMaxMs_;
+  uint32_t watchdogHeldTicks_;
+  uint32_t droppedEvents_;
+
+  void latch(uint8_t trip, uint32_t onsetMs, float value) {
+    if (latched_ & (1u << trip)) return;
+    latched_ |= 1u << trip;
+    onsetMs_[trip] = onsetMs;
+    value_[trip] = value;
+  }
+
+  // Límite superior (above) o inferior con histéresis; NaN no cambia nada
+  void evaluate(uint8_t trip, float value, float limit, float hysteresis, bool above) {
+    if (isnan(value) || isnan(limit)) return;
+    bool tripped = above ? value >= limit : value <= limit;
+    bool recovered = above ? value <= limit - hysteresis : value > limit + hysteresis;
+    if (tripped) {
+      latch(trip, sample_.atMs, value);
+    } else if (recovered) {
+      latched_ &= ~(1u << trip);
+    }
+  }
+
+  // El primer enclavamiento del actuador (en el orden de SafetyTrip) se lleva la intervención
+  void intervene(uint8_t actuator, uint32_t mask, uint32_t actuatorOnSinceMs, uint32_t now) {
+    uint8_t trip = 0;
+    while (!(latched_ & mask & (1u << trip))) trip++;
+    uint32_t visibleMs = onsetMs_[trip];
+    // Encendido después de enclavarse (escritura directa del pin): se cuenta desde el encendido
+    if (elapsed(actuatorOnSinceMs, visibleMs) > 0) visibleMs = actuatorOnSinceMs;
+    SafetyEvent event = { trip, actuator, now, elapsed(now, visibleMs), value_[trip] };
+    SafetyTripStats& s = stats_[trip];
+    s.count++;
+    s.lastReactionMs = event.reactionMs;
+    if (event.reactionMs > s.maxReactionMs) s.maxReactionMs = event.reactionMs;
+    if (eventCount_ == SAFETY_EVENT_SLOTS) {
+      droppedEvents_++;
+      eventCount_--;  // Se pisa la más vieja
+    }
+    events_[eventHead_] = event;
+    eventHead_ = (uint8_t)((eventHead_ + 1) % SAFETY_EVENT_SLOTS);
+    eventCount_++;
+  }
+};
+
+#endif  // SAFETY_SUPERVISOR_H
@@ -9,6 +9,15 @@
 #include <TFT_eSPI.h>
 #include <XPT2046_Touchscreen.h>
 #include <math.h>
+#include <Update.h>       // Escritura de la imagen nueva (OTA relevada por el AWG)
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <rom/crc.h>
+#include "ui_mailbox.h"  // Buzón sin bloqueos entre la tarea UART y LVGL
+#include "trend_store.h" // Series de tendencia de 2 h y 24 h en memoria fija
+
+#define DISPLAY_FIRMWARE_VERSION "1.0"  // Versión que se informa al AWG (DISPLAY_FW)
 
 // Pines para el táctil
 #define XPT2046_IRQ 36
@@ -37,6 +46,64 @@ bool pumpState = false;
 bool backlightOn = true;
 unsigned long lastActivityTime = 0;
 unsigned int screenTimeoutSec = 0;  // Timeout en segundos, 0 = deshabilitado
+unsigned long lastAwgWake = 0;      // Última línea vacía enviada para despertar al AWG
+
+// Recepción UART en el núcleo 0, LVGL en el núcleo 1 (loop de Arduino)
+#define UART_TASK_CORE 0
+#define UART_TASK_PRIORITY 5
+#define UART_TASK_STACK 8192             // Holgura para Update y SHA-256 durante una OTA
+#define UART_RX_BUFFER_SIZE 2048        // Buffer del driver UART: cubre ráfagas mientras la tarea espera
+#define UART_WAIT_MS 50                 // Espera máxima de la tarea sin evento de recepción
+#define UI_MAX_WAIT_MS 5                // Espera máxima entre llamadas a LVGL con la pantalla encendida
+#define DARK_POLL_MS 50                 // Sondeo del táctil con la pantalla apagada (sin renderizar)
+#define UI_STATS_INTERVAL_MS 60000UL    // Reporte de latencia UART -> píxel por USB
+#define AWG_WAKE_INTERVAL_MS 2000UL     // Línea de despertar al AWG por toque (su sueño ligero se inhibe 3 s tras cada byte)
+LatestMailbox<DisplayState> uiMailbox;
+UiLineParser uiParser(uiMailbox);
+TaskHandle_t uartTaskHandle = NULL;
+uint32_t appliedSeq[UI_FIELD_COUNT];    // Última secuencia aplicada por campo
+bool renderPending = false;             // Hay cambios aplicados sin dibujar
+uint32_t pendingRxUs = 0;               // Recepción del cambio más antiguo sin dibujar
+LatencyStats uartToPixel;
+unsigned long lastStatsReport = 0;
+
+// Actualización de firmware relevada por el AWG (ver la sección OTA de mainAWG.ino):
+// "OTA_BEGIN <tamaño> <sha256>", tramas 0xA5 | largo u16 | offset u32 | datos | CRC-32 (LE),
+// una trama vacía al final. Cada trama se confirma con OTA_ACK/OTA_NAK <offset esperado>
+#define OTA_FRAME_MAX 1024
+#define OTA_IDLE_TIMEOUT_MS 10000UL     // Sin bytes del AWG: se descarta la imagen a medias
+#define OTA_HEALTH_MIN_UPTIME_MS 10000UL
+#define OTA_HEALTH_TIMEOUT_MS 60000UL   // Sin líneas válidas del AWG: vuelta a la imagen anterior
+#define OTA_MAX_PENDING_BOOTS 3
+enum OtaRxState : uint8_t { OTA_RX_IDLE, OTA_RX_SYNC, OTA_RX_HEADER, OTA_RX_BODY };
+volatile OtaRxState otaRxState = OTA_RX_IDLE;  // Lo escribe la tarea UART; el loop solo lo consulta
+uint8_t otaFrame[6 + OTA_FRAME_MAX + 4];
+size_t otaFrameFill = 0;
+size_t otaFrameNeed = 0;
+uint32_t otaImageSize = 0;
+uint32_t otaImageOffset = 0;
+uint8_t otaExpectedSha[32];
+mbedtls_sha256_context otaSha;
+unsigned long otaLastByteMs = 0;
+char otaLine[96];                       // Líneas de control, en paralelo con uiParser
+size_t otaLineLen = 0;
+bool otaPendingVerify = false;          // Imagen recién instalada, pendiente de validar
+volatile bool otaReportVersion = true;  // Enviar DISPLAY_FW con la próxima línea válida del AWG
+
+// Gráficas de tendencia
+TrendStore trendStore;
+uint32_t trendSampleSeq = 0;            // Última trama CSV registrada en las tendencias
+lv_obj_t *main_screen;
+lv_obj_t *trend_screen;
+lv_obj_t *trend_chart;
+lv_obj_t *trend_title;
+lv_obj_t *trend_summary;
+lv_chart_series_t *trend_ser_max;
+lv_chart_series_t *trend_ser_min;
+uint8_t trendChannel = TREND_HUM_AMB;
+uint8_t trendLevel = TREND_LEVEL_2H;
+uint32_t trendChartClosed = 0;          // Intervalos del nivel ya dibujados en la gráfica
+
 lv_obj_t *labels[13];
 lv_obj_t *agua_label;
 
@@ -66,6 +133,23 @@ void log_print(lv_log_level_t level, const char * buf) {
   LV_UNUSED(level);
 }
 
+// Toque en pantalla: reinicia el timer de actividad y enciende el backlight si estaba apagado
+void wake_backlight() {
+  unsigned long now = millis();
+  lastActivityTime = now;
+  if (!backlightOn) {
+    digitalWrite(TFT_BACKLIGHT_PIN, HIGH);
+    backlightOn = true;
+    Serial.println("BACKLIGHT:ON");  // Notificar al dispositivo
+  }
+  // Línea vacía: despierta al AWG del sueño ligero antes del comando que dispare el toque (la ignora).
+  // El AWG duerme aun con la pantalla encendida, así que se repite en cada toque espaciado
+  if (now - lastAwgWake >= AWG_WAKE_INTERVAL_MS) {
+    lastAwgWake = now;
+    Serial1.println();
+  }
+}
+
 // Touchscreen para LVGL
 void touchscreen_read(lv_indev_t * indev, lv_indev_data_t * data) {
    if(touchscreen.tirqTouched() && touchscreen.touched()) {
@@ -76,13 +160,7 @@ void touchscreen_read(lv_indev_t * indev, lv_indev_data_t * data) {
      data->point.x = x;
      data->point.y = y;
 
-     // Reset timer de actividad cuando hay toque en pantalla
-     lastActivityTime = millis();
-     if (!backlightOn) {
-       digitalWrite(TFT_BACKLIGHT_PIN, HIGH);
-       backlightOn = true;
-       Serial.println("BACKLIGHT:ON");  // Notificar al dispositivo
-     }
+     wake_backlight();  // Reset timer de actividad cuando hay toque en pantalla
    } else {
      data->state = LV_INDEV_STATE_RELEASED;
    }
@@ -229,6 +307,165 @@ static void event_handler_reset_energy(lv_event_t * e) {
    Serial1.println("reset_energy");  // Comando para resetear energía
 }
 
+// Registra la última trama CSV en las tendencias (también con la pantalla apagada)
+void trend_record() {
+    const DisplayState &st = uiMailbox.front();
+    if (st.seq[UI_FIELD_VALUES] == trendSampleSeq) return;
+    trendSampleSeq = st.seq[UI_FIELD_VALUES];
+    float v[TREND_CHANNEL_COUNT];
+    v[TREND_TEMP_AMB] = st.vals[0];
+    v[TREND_HUM_AMB] = st.vals[2];
+    v[TREND_TEMP_EVAP] = st.vals[5];
+    v[TREND_WATER] = st.vals[17];
+    v[TREND_POWER] = st.vals[11];
+    trendStore.sample(millis(), v);
+}
+
+// Rango del eje Y y resumen (máx/mín de la ventana y último intervalo) a partir de lo almacenado
+void trend_update_range() {
+    TrendChannel ch = (TrendChannel)trendChannel;
+    int16_t lo = INT16_MAX, hi = INT16_MIN, lastMin = TREND_INVALID, lastMax = TREND_INVALID;
+    uint16_t n = trendStore.count(trendLevel);
+    for (uint16_t i = 0; i < n; i++) {
+        const TrendBucket &b = trendStore.bucket(trendLevel, i);
+        if (b.min[ch] == TREND_INVALID) continue;
+        if (b.min[ch] < lo) lo = b.min[ch];
+        if (b.max[ch] > hi) hi = b.max[ch];
+        lastMin = b.min[ch];
+        lastMax = b.max[ch];
+    }
+    if (lo > hi) {
+        lv_chart_set_range(trend_chart, LV_CHART_AXIS_PRIMARY_Y, 0, 100);
+        lv_label_set_text(trend_summary, "Sin datos todavia");
+        return;
+    }
+    int32_t margin = (hi - lo) / 10 + 1;
+    lv_chart_set_range(trend_chart, LV_CHART_AXIS_PRIMARY_Y, lo - margin, hi + margin);
+    const char *unit = TREND_CHANNEL_UNIT[ch];
+    lv_label_set_text_fmt(trend_summary, "Max %.1f %s  Min %.1f %s  Ult %.1f-%.1f",
+                          TrendStore::toValue(ch, hi), unit, TrendStore::toValue(ch, lo), unit,
+                          TrendStore::toValue(ch, lastMin), TrendStore::toValue(ch, lastMax));
+}
+
+// Añade un intervalo al final de la gráfica (modo desplazamiento: el más antiguo sale)
+void trend_append(const TrendBucket &b) {
+    TrendChannel ch = (TrendChannel)trendChannel;
+    lv_chart_set_next_value(trend_chart, trend_ser_max, b.max[ch] == TREND_INVALID ? LV_CHART_POINT_NONE : b.max[ch]);
+    lv_chart_set_next_value(trend_chart, trend_ser_min, b.min[ch] == TREND_INVALID ? LV_CHART_POINT_NONE : b.min[ch]);
+}
+
+// Redibujo completo: al abrir la pantalla o cambiar de canal o de rango
+void trend_reload() {
+    lv_label_set_text_fmt(trend_title, "%s - %s", TREND_CHANNEL_NAME[trendChannel], TREND_LEVEL_NAME[trendLevel]);
+    lv_chart_set_all_value(trend_chart, trend_ser_max, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(trend_chart, trend_ser_min, LV_CHART_POINT_NONE);
+    uint16_t n = trendStore.count(trendLevel);
+    for (uint16_t i = 0; i < n; i++) trend_append(trendStore.bucket(trendLevel, i));
+    trendChartClosed = trendStore.closed(trendLevel);
+    trend_update_range();
+    lv_chart_refresh(trend_chart);
+}
+
+// Con la gráfica visible solo se añaden los intervalos nuevos; si faltan demasiados se recarga
+void trend_sync() {
+    if (lv_screen_active() != trend_screen) return;
+    trendStore.advance(millis());  // Cerrar intervalos vacíos si el AWG dejó de enviar
+    uint32_t pending = trendStore.closed(trendLevel) - trendChartClosed;
+    if (pending == 0) return;
+    if (pending > TREND_POINTS / 4) {
+        trend_reload();
+        return;
+    }
+    uint16_t n = trendStore.count(trendLevel);
+    for (uint16_t i = n - pending; i < n; i++) trend_append(trendStore.bucket(trendLevel, i));
+    trendChartClosed = trendStore.closed(trendLevel);
+    trend_update_range();
+}
+
+static void event_handler_trends(lv_event_t * e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
+    trend_reload();
+    lv_screen_load(trend_screen);
+}
+
+static void event_handler_trend_channel(lv_event_t * e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
+    trendChannel = (trendChannel + 1) % TREND_CHANNEL_COUNT;
+    trend_reload();
+}
+
+static void event_handler_trend_range(lv_event_t * e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
+    trendLevel = (trendLevel + 1) % TREND_LEVEL_COUNT;
+    trend_reload();
+}
+
+static void event_handler_trend_back(lv_event_t * e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
+    lv_screen_load(main_screen);
+}
+
+lv_obj_t *create_trend_button(lv_obj_t *parent, const char *text, lv_event_cb_t cb) {
+    lv_obj_t *btn = lv_button_create(parent);
+    lv_obj_set_size(btn, 90, 30);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_set_style_bg_color(btn, COLOR_SECONDARY, 0);
+    lv_obj_set_style_radius(btn, 16, 0);
+    lv_obj_set_style_shadow_color(btn, lv_color_darken(COLOR_SECONDARY, 20), 0);
+    lv_obj_set_style_shadow_width(btn, 10, 0);
+    lv_obj_set_style_shadow_ofs_y(btn, 1, 0);
+
+    lv_obj_t *lbl = lv_label_create(btn);
+    lv_label_set_text(lbl, text);
+    lv_obj_set_style_text_color(lbl, COLOR_DARK, 0);
+    lv_obj_set_style_text_font(lbl, &lv_font_montserrat_12, 0);
+    lv_obj_center(lbl);
+    return btn;
+}
+
+// Pantalla de tendencias: banda máx/mín del canal elegido en la ventana de 2 h o 24 h
+void lv_create_trend_screen(void) {
+    trend_screen = lv_obj_create(NULL);
+    lv_obj_set_style_bg_color(trend_screen, COLOR_PRIMARY, 0);
+    lv_obj_set_style_bg_opa(trend_screen, LV_OPA_COVER, 0);
+
+    trend_title = lv_label_create(trend_screen);
+    lv_obj_set_style_text_color(trend_title, COLOR_DARK, 0);
+    lv_obj_set_style_text_font(trend_title, &lv_font_montserrat_14, 0);
+    lv_obj_align(trend_title, LV_ALIGN_TOP_MID, 0, 8);
+
+    trend_summary = lv_label_create(trend_screen);
+    lv_obj_set_style_text_color(trend_summary, COLOR_ACCENT1, 0);
+    lv_obj_set_style_text_font(trend_summary, &lv_font_montserrat_12, 0);
+    lv_obj_align(trend_summary, LV_ALIGN_TOP_MID, 0, 30);
+
+    trend_chart = lv_chart_create(trend_screen);
+    lv_obj_set_size(trend_chart, LV_PCT(94), LV_PCT(58));
+    lv_obj_align(trend_chart, LV_ALIGN_TOP_MID, 0, 50);
+    lv_chart_set_type(trend_chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_point_count(trend_chart, TREND_POINTS);
+    lv_chart_set_update_mode(trend_chart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_div_line_count(trend_chart, 4, 6);
+    lv_obj_set_style_bg_color(trend_chart, COLOR_PANEL, 0);
+    lv_obj_set_style_border_color(trend_chart, lv_color_lighten(COLOR_ACCENT1, 20), 0);
+    lv_obj_set_style_radius(trend_chart, 10, 0);
+    lv_obj_set_style_size(trend_chart, 0, 0, LV_PART_INDICATOR);  // Sin marcadores: 120 puntos
+    trend_ser_max = lv_chart_add_series(trend_chart, COLOR_ACCENT1, LV_CHART_AXIS_PRIMARY_Y);
+    trend_ser_min = lv_chart_add_series(trend_chart, COLOR_DARK, LV_CHART_AXIS_PRIMARY_Y);
+
+    lv_obj_t *row = lv_obj_create(trend_screen);
+    lv_obj_set_size(row, LV_PCT(100), 46);
+    lv_obj_align(row, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_obj_set_flex_flow(row, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(row, LV_FLEX_ALIGN_SPACE_EVENLY, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    lv_obj_set_style_bg_opa(row, LV_OPA_0, 0);
+    lv_obj_set_style_border_width(row, 0, 0);
+    lv_obj_set_scrollbar_mode(row, LV_SCROLLBAR_MODE_OFF);
+    create_trend_button(row, "CANAL", event_handler_trend_channel);
+    create_trend_button(row, "2H / 24H", event_handler_trend_range);
+    create_trend_button(row, "VOLVER", event_handler_trend_back);
+}
+
 const char* names[13] = {
     "Temperatura:", "Presion ATM:", "Humedad Relativa:", "Humedad Abs:", "Pto Rocio:",
     "Temperatura:", "Humedad Relativa:",
@@ -244,6 +481,7 @@ const char* formats[13] = {
 
 void lv_create_main_gui(void) {
     lv_obj_t * bg = lv_screen_active();
+    main_screen = bg;
     lv_obj_set_style_bg_color(bg, COLOR_PRIMARY, 0);
     lv_obj_set_style_bg_opa(bg, LV_OPA_COVER, 0);
 
@@ -370,6 +608,23 @@ void lv_create_main_gui(void) {
     lv_obj_center(reset_energy_label);
     lv_obj_align_to(reset_energy_btn, reconnect_btn, LV_ALIGN_OUT_BOTTOM_MID, 0, 15);
 
+    // Botón para ver las gráficas de tendencia
+    lv_obj_t *trends_btn = lv_button_create(bg);
+    lv_obj_set_size(trends_btn, 180, 30);
+    lv_obj_add_event_cb(trends_btn, event_handler_trends, LV_EVENT_CLICKED, NULL);
+    lv_obj_set_style_bg_color(trends_btn, COLOR_SECONDARY, 0);
+    lv_obj_set_style_radius(trends_btn, 16, 0);
+    lv_obj_set_style_shadow_color(trends_btn, lv_color_darken(COLOR_SECONDARY, 20), 0);
+    lv_obj_set_style_shadow_width(trends_btn, 10, 0);
+    lv_obj_set_style_shadow_ofs_y(trends_btn, 1, 0);
+
+    lv_obj_t *trends_label = lv_label_create(trends_btn);
+    lv_label_set_text(trends_label, "TENDENCIAS");
+    lv_obj_set_style_text_color(trends_label, COLOR_DARK, 0);
+    lv_obj_set_style_text_font(trends_label, &lv_font_montserrat_14, 0);
+    lv_obj_center(trends_label);
+    lv_obj_align_to(trends_btn, reset_energy_btn, LV_ALIGN_OUT_BOTTOM_MID, 0, 15);
+
     // Subtítulo 1: VALORES AMBIENTALES (sin Agua almac)
     lv_obj_t *sub1 = lv_label_create(data_panel);
     lv_label_set_text(sub1, "VALORES AMBIENTALES");
@@ -572,7 +827,7 @@ void lv_create_main_gui(void) {
     lv_obj_center(label_pump);
 }
 
-void update_labels(float vals[18]) {
+void update_labels(const float vals[18]) {
     // Valores ambientales (0..4). Mantener último valor válido si nuevo es NAN.
     for (int i = 0; i <= 4; i++) {
         if (!isnan(vals[i])) {
@@ -670,11 +925,399 @@ void update_agua_almacenada(float agua) {
     lv_label_set_text_fmt(agua_label, "%.2f L", agua);
 }
 
+// Estado del modo informado por el AWG
+void apply_mode(bool autoMode) {
+    uiModeAuto = autoMode;
+    if (autoMode) {
+        if (mode_btn_small) {
+          lv_obj_t *lbl = lv_obj_get_child(mode_btn_small, 0);
+          if (lbl) lv_label_set_text(lbl, "MODO AUTO");
+          lv_obj_set_style_bg_color(mode_btn_small, lv_color_hex(0x64B5F6), 0);
+        }
+        if (ui_btn_comp) lv_obj_add_state(ui_btn_comp, LV_STATE_DISABLED);
+        if (ui_btn_vent) lv_obj_add_state(ui_btn_vent, LV_STATE_DISABLED);
+        if (ui_btn_comp_fan) lv_obj_add_state(ui_btn_comp_fan, LV_STATE_DISABLED);
+        if (ui_btn_pump) lv_obj_add_state(ui_btn_pump, LV_STATE_DISABLED);
+    } else {
+        if (mode_btn_small) {
+          lv_obj_t *lbl = lv_obj_get_child(mode_btn_small, 0);
+          if (lbl) lv_label_set_text(lbl, "MODO MANUAL");
+          lv_obj_set_style_bg_color(mode_btn_small, COLOR_SECONDARY, 0);
+        }
+        if (ui_btn_comp) lv_obj_clear_state(ui_btn_comp, LV_STATE_DISABLED);
+        if (ui_btn_vent) lv_obj_clear_state(ui_btn_vent, LV_STATE_DISABLED);
+        if (ui_btn_comp_fan) lv_obj_clear_state(ui_btn_comp_fan, LV_STATE_DISABLED);
+        if (ui_btn_pump) lv_obj_clear_state(ui_btn_pump, LV_STATE_DISABLED);
+    }
+}
+
+// Estado del compresor informado por el AWG
+void apply_comp(bool on) {
+    ledState = on;  // Mantener la variable local en sincronía con el estado real del compresor
+    if (ui_btn_comp) {
+        lv_obj_t *lbl = lv_obj_get_child(ui_btn_comp, 0);
+        if (on) {
+            lv_label_set_text(lbl, "APAGAR AWG");
+            lv_obj_set_style_bg_color(ui_btn_comp, COLOR_ACCENT1, 0);
+            lv_obj_set_style_shadow_color(ui_btn_comp, lv_color_darken(COLOR_ACCENT1, 30), 0);
+        } else {
+            lv_label_set_text(lbl, "ENCENDER AWG");
+            lv_obj_set_style_bg_color(ui_btn_comp, COLOR_SECONDARY, 0);
+            lv_obj_set_style_shadow_color(ui_btn_comp, lv_color_darken(COLOR_SECONDARY, 30), 0);
+        }
+    }
+}
+
+// Botón de relé simple (ventiladores, bomba): texto y color según el estado
+void apply_relay_button(lv_obj_t *btn, bool on, const char *onText, const char *offText) {
+    if (!btn) return;
+    lv_obj_t *lbl = lv_obj_get_child(btn, 0);
+    lv_label_set_text(lbl, on ? onText : offText);
+    lv_obj_set_style_bg_color(btn, on ? COLOR_ACCENT1 : COLOR_SECONDARY, 0);
+}
+
+// Registra el cambio de un campo y devuelve true si hay que aplicarlo
+bool take_field(const DisplayState &st, UiField f) {
+    if (st.seq[f] == appliedSeq[f]) return false;
+    appliedSeq[f] = st.seq[f];
+    if (!renderPending || (int32_t)(st.rxUs[f] - pendingRxUs) < 0) pendingRxUs = st.rxUs[f];
+    renderPending = true;
+    return true;
+}
+
+// Aplica la instantánea más reciente del buzón. Backlight y timeout se atienden siempre; con
+// la pantalla apagada los widgets quedan pendientes y se actualizan de una vez al despertar
+void apply_mailbox() {
+    const DisplayState &st = uiMailbox.front();
+    if (st.seq[UI_FIELD_BACKLIGHT] != appliedSeq[UI_FIELD_BACKLIGHT]) {
+        appliedSeq[UI_FIELD_BACKLIGHT] = st.seq[UI_FIELD_BACKLIGHT];
+        digitalWrite(TFT_BACKLIGHT_PIN, st.backlight ? HIGH : LOW);
+        backlightOn = st.backlight;
+        if (st.backlight) lastActivityTime = millis();
+    }
+    if (st.seq[UI_FIELD_SCREEN_TIMEOUT] != appliedSeq[UI_FIELD_SCREEN_TIMEOUT]) {
+        appliedSeq[UI_FIELD_SCREEN_TIMEOUT] = st.seq[UI_FIELD_SCREEN_TIMEOUT];
+        screenTimeoutSec = st.screenTimeoutSec;
+        lastActivityTime = millis();  // Reset timer al cambiar configuración
+    }
+    if (!backlightOn) return;
+
+    bool valuesChanged = take_field(st, UI_FIELD_VALUES);
+    if (valuesChanged) update_labels(st.vals);
+    // "A:" y la trama CSV escriben la misma etiqueta: prevalece la más reciente
+    if (take_field(st, UI_FIELD_AGUA) && (!valuesChanged || (int32_t)(st.rxUs[UI_FIELD_AGUA] - st.rxUs[UI_FIELD_VALUES]) >= 0)) {
+        update_agua_almacenada(st.agua);
+    }
+    if (take_field(st, UI_FIELD_MODE)) apply_mode(st.modeAuto);
+    if (take_field(st, UI_FIELD_COMP)) apply_comp(st.comp);
+    if (take_field(st, UI_FIELD_VENT)) {
+        ventState = st.vent;
+        apply_relay_button(ui_btn_vent, st.vent, "APAGAR EFAN", "ENCENDER EFAN");
+    }
+    if (take_field(st, UI_FIELD_CFAN)) {
+        compFanState = st.cfan;
+        apply_relay_button(ui_btn_comp_fan, st.cfan, "APAGAR CFAN", "ENCENDER CFAN");
+    }
+    if (take_field(st, UI_FIELD_PUMP)) {
+        pumpState = st.pump;
+        apply_relay_button(ui_btn_pump, st.pump, "APAGAR BOMB", "ENCENDER BOMB");
+    }
+}
+
+// Fin de un refresco de LVGL (el flush de TFT_eSPI es síncrono): los cambios aplicados ya están en pantalla
+static void on_refresh_ready(lv_event_t * e) {
+    LV_UNUSED(e);
+    if (!renderPending) return;
+    uartToPixel.add(micros() - pendingRxUs);
+    renderPending = false;
+}
+
+// Evento de recepción de la UART: despierta a la tarea de ingesta
+void on_uart_receive() {
+    if (uartTaskHandle) xTaskNotifyGive(uartTaskHandle);
+}
+
+// Respuesta de una línea al AWG (una sola escritura: no se mezcla con los comandos del loop)
+void ota_reply(const char* fmt, uint32_t value) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), fmt, (unsigned long)value);
+    Serial1.write((const uint8_t*)buf, len);
+}
+
+void ota_rx_abort(const char* reason) {
+    if (otaRxState != OTA_RX_IDLE) Update.abort();
+    otaRxState = OTA_RX_IDLE;
+    Serial.printf("OTA: abortada (%s)\n", reason);
+}
+
+int ota_hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "OTA_BEGIN <tamaño> <sha256>": un OTA_BEGIN repetido (OTA_READY perdido) vuelve a empezar
+void ota_rx_begin(const char* args) {
+    char* end;
+    uint32_t size = strtoul(args, &end, 10);
+    while (*end == ' ') end++;
+    bool ok = size > 0 && strlen(end) >= 64;
+    for (int i = 0; ok && i < 32; i++) {
+        int hi = ota_hex(end[2 * i]), lo = ota_hex(end[2 * i + 1]);
+        ok = hi >= 0 && lo >= 0;
+        otaExpectedSha[i] = (uint8_t)(hi << 4 | lo);
+    }
+    if (otaRxState != OTA_RX_IDLE) Update.abort();
+    otaRxState = OTA_RX_IDLE;
+    if (!ok || otaPendingVerify || !Update.begin(size)) {
+        Serial1.println(otaPendingVerify ? "OTA_FAIL pending_verify" : ok ? "OTA_FAIL space" : "OTA_FAIL args");
+        return;
+    }
+    mbedtls_sha256_init(&otaSha);
+    mbedtls_sha256_starts(&otaSha, 0);
+    otaImageSize = size;
+    otaImageOffset = 0;
+    otaRxState = OTA_RX_SYNC;
+    otaLastByteMs = millis();
+    Serial.printf("OTA: recibiendo %lu bytes\n", (unsigned long)size);
+    ota_reply("OTA_READY %lu\n", 0);
+}
+
+// Imagen completa: SHA-256 de lo escrito contra el anunciado, partición de arranque y reinicio.
+// La imagen nueva queda pendiente hasta que ota_health() la valide
+void ota_rx_finish() {
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&otaSha, digest);
+    mbedtls_sha256_free(&otaSha);
+    otaRxState = OTA_RX_IDLE;
+    if (memcmp(digest, otaExpectedSha, sizeof(digest)) != 0) {
+        Update.abort();
+        Serial1.println("OTA_FAIL hash");
+        return;
+    }
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
+    if (!Update.end(true) || next == NULL) {
+        Serial1.println("OTA_FAIL image");
+        return;
+    }
+    Preferences prefs;
+    prefs.begin("disp-ota", false);
+    prefs.putBool("pending", true);
+    prefs.putString("part", next->label);
+    prefs.putString("prev", running->label);
+    prefs.putUChar("boots", 0);
+    prefs.end();
+    Serial1.println("OTA_DONE");
+    Serial1.flush();
+    Serial.println("OTA: imagen instalada, reiniciando");
+    delay(100);
+    ESP.restart();
+}
+
+// Trama completa en otaFrame: CRC, orden y escritura. Responde con el offset esperado
+void ota_rx_frame() {
+    uint16_t len = otaFrame[0] | (otaFrame[1] << 8);
+    uint32_t offset = otaFrame[2] | (otaFrame[3] << 8) | ((uint32_t)otaFrame[4] << 16) | ((uint32_t)otaFrame[5] << 24);
+    const uint8_t* tail = otaFrame + 6 + len;
+    uint32_t crc = tail[0] | (tail[1] << 8) | ((uint32_t)tail[2] << 16) | ((uint32_t)tail[3] << 24);
+    if (crc32_le(0, otaFrame, 6 + len) != crc || offset > otaImageOffset) {
+        ota_reply("OTA_NAK %lu\n", otaImageOffset);
+        return;
+    }
+    if (offset < otaImageOffset) {
+        ota_reply("OTA_ACK %lu\n", otaImageOffset);  // Repetida: el ACK anterior se perdió
+        return;
+    }
+    if (len == 0) {
+        if (otaImageOffset == otaImageSize) {
+            ota_rx_finish();
+        } else {
+            ota_reply("OTA_NAK %lu\n", otaImageOffset);
+        }
+        return;
+    }
+    if (otaImageOffset + len > otaImageSize || Update.write(otaFrame + 6, len) != len) {
+        ota_rx_abort("escritura");
+        Serial1.println("OTA_FAIL write");
+        return;
+    }
+    mbedtls_sha256_update(&otaSha, otaFrame + 6, len);
+    otaImageOffset += len;
+    ota_reply("OTA_ACK %lu\n", otaImageOffset);
+}
+
+// Bytes de la UART durante la recepción: sincroniza con 0xA5 y arma las tramas
+void ota_rx_feed(const uint8_t* data, size_t n) {
+    otaLastByteMs = millis();
+    for (size_t i = 0; i < n && otaRxState != OTA_RX_IDLE; i++) {
+        uint8_t b = data[i];
+        if (otaRxState == OTA_RX_SYNC) {
+            // Fuera de trama solo interesa OTA_ABORT; el resto (respuestas a comandos) se descarta
+            if (b == 0xA5) {
+                otaRxState = OTA_RX_HEADER;
+                otaFrameFill = 0;
+                otaFrameNeed = 6;
+            } else if (b == '\n') {
+                otaLine[otaLineLen] = '\0';
+                otaLineLen = 0;
+                if (strcmp(otaLine, "OTA_ABORT") == 0) ota_rx_abort("AWG");
+            } else if (b != '\r' && otaLineLen < sizeof(otaLine) - 1) {
+                otaLine[otaLineLen++] = (char)b;
+            }
+            continue;
+        }
+        otaFrame[otaFrameFill++] = b;
+        if (otaFrameFill < otaFrameNeed) continue;
+        if (otaRxState == OTA_RX_HEADER) {
+            uint16_t len = otaFrame[0] | (otaFrame[1] << 8);
+            if (len > OTA_FRAME_MAX) {
+                otaRxState = OTA_RX_SYNC;  // Falso 0xA5: esperar la retransmisión
+                continue;
+            }
+            otaRxState = OTA_RX_BODY;
+            otaFrameNeed = 6 + len + 4;
+            continue;
+        }
+        otaRxState = OTA_RX_SYNC;
+        otaLineLen = 0;
+        ota_rx_frame();
+    }
+}
+
+// Líneas de control fuera de una recepción (uiParser recibe los mismos bytes)
+void ota_scan_lines(const uint8_t* data, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        char c = (char)data[i];
+        if (c == '\n') {
+            otaLine[otaLineLen] = '\0';
+            otaLineLen = 0;
+            if (strncmp(otaLine, "OTA_BEGIN ", 10) == 0) {
+                ota_rx_begin(otaLine + 10);
+                // El resto del trozo ya son tramas
+                if (otaRxState != OTA_RX_IDLE) ota_rx_feed(data + i + 1, n - i - 1);
+                return;
+            }
+            if (strcmp(otaLine, "AWG_INIT:OK") == 0) otaReportVersion = true;  // El AWG reinició
+        } else if (c != '\r' && otaLineLen < sizeof(otaLine) - 1) {
+            otaLine[otaLineLen++] = c;
+        }
+    }
+}
+
+// Vuelve a la imagen anterior (sin soporte del bootloader, cambia la partición a mano)
+void ota_rollback() {
+    Serial.println("OTA: volviendo al firmware anterior");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    Preferences prefs;
+    prefs.begin("disp-ota", true);
+    String prev = prefs.getString("prev", "");
+    prefs.end();
+    const esp_partition_t* previous = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev.c_str());
+    if (previous != NULL && esp_ota_set_boot_partition(previous) == ESP_OK) ESP.restart();
+}
+
+// Arduino valida la imagen al arrancar salvo que esto devuelva true: lo hace ota_health()
+bool verifyRollbackLater() {
+    return true;
+}
+
+// Arranque: imagen nueva pendiente, reinicios repetidos sin validarla o reversión ya hecha
+void ota_boot_check() {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    Preferences prefs;
+    prefs.begin("disp-ota", false);
+    if (prefs.getBool("pending", false)) {
+        if (prefs.getString("part", "") != running->label) {
+            prefs.putBool("pending", false);  // Ya se revirtió: el AWG lo ve por DISPLAY_FW
+        } else {
+            uint8_t boots = prefs.getUChar("boots", 0) + 1;
+            prefs.putUChar("boots", boots);
+            otaPendingVerify = true;
+            if (boots > OTA_MAX_PENDING_BOOTS) {
+                prefs.end();
+                ota_rollback();
+                return;
+            }
+        }
+    }
+    prefs.end();
+    if (!otaPendingVerify) esp_ota_mark_app_valid_cancel_rollback();
+}
+
+// Imagen nueva válida cuando recibe líneas válidas del AWG tras OTA_HEALTH_MIN_UPTIME_MS.
+// DISPLAY_FW se envía con la imagen ya validada (y tras cada arranque del AWG)
+void ota_health(unsigned long now) {
+    bool awgSeen = uiParser.lines() > 0;
+    if (otaPendingVerify) {
+        if (awgSeen && now >= OTA_HEALTH_MIN_UPTIME_MS) {
+            esp_ota_mark_app_valid_cancel_rollback();
+            Preferences prefs;
+            prefs.begin("disp-ota", false);
+            prefs.putBool("pending", false);
+            prefs.end();
+            otaPendingVerify = false;
+            Serial.println("OTA: firmware " DISPLAY_FIRMWARE_VERSION " validado");
+        } else if (now >= OTA_HEALTH_TIMEOUT_MS) {
+            ota_rollback();
+        }
+        return;
+    }
+    if (otaReportVersion && awgSeen && otaRxState == OTA_RX_IDLE) {
+        otaReportVersion = false;
+        Serial1.println();  // Despierta al AWG del sueño ligero (la línea vacía se ignora)
+        Serial1.println("DISPLAY_FW " DISPLAY_FIRMWARE_VERSION);
+    }
+}
+
+// Tarea de ingesta (núcleo 0): vacía el driver UART, interpreta las líneas y publica una sola
+// instantánea por ráfaga. Nunca toca LVGL
+void uart_task(void *arg) {
+    LV_UNUSED(arg);
+    uint8_t chunk[128];
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UART_WAIT_MS));
+        bool changed = false;
+        int avail;
+        while ((avail = Serial1.available()) > 0) {
+            uint32_t rxUs = micros();
+            size_t n = Serial1.read(chunk, avail < (int)sizeof(chunk) ? (size_t)avail : sizeof(chunk));
+            if (otaRxState != OTA_RX_IDLE) {
+                ota_rx_feed(chunk, n);  // Firmware en curso: los bytes son tramas, no líneas de estado
+                continue;
+            }
+            if (uiParser.feed(chunk, n, rxUs)) changed = true;
+            ota_scan_lines(chunk, n);
+        }
+        if (changed) uiParser.publish();
+        if (otaRxState != OTA_RX_IDLE && millis() - otaLastByteMs > OTA_IDLE_TIMEOUT_MS) ota_rx_abort("sin datos");
+    }
+}
+
+static uint32_t ui_tick(void) {
+    return millis();
+}
+
+// Reporte periódico por USB de la latencia UART -> píxel y del buzón
+void report_ui_stats(unsigned long now) {
+    if (now - lastStatsReport < UI_STATS_INTERVAL_MS) return;
+    lastStatsReport = now;
+    Serial.printf("UI_STATS: lat_us ult=%lu med=%lu max=%lu n=%lu lineas=%lu descartadas=%lu publicadas=%lu combinadas=%lu\n",
+                  (unsigned long)uartToPixel.last, (unsigned long)uartToPixel.average(), (unsigned long)uartToPixel.max,
+                  (unsigned long)uartToPixel.count, (unsigned long)uiParser.lines(), (unsigned long)uiParser.droppedLines(),
+                  (unsigned long)uiMailbox.published(), (unsigned long)uiMailbox.coalesced());
+    uartToPixel.reset();
+}
+
 void setup() {
     Serial.begin(115200);
+    ota_boot_check();
+    Serial1.setRxBufferSize(UART_RX_BUFFER_SIZE);
     Serial1.begin(115200, SERIAL_8N1, 35, 22);  // RX=35 (de AWG TX=4), TX=22 (a AWG RX=0)
     delay(100);  // Esperar estabilización UART
     lv_init();
+    lv_tick_set_cb(ui_tick);  // Tick desde millis(): el loop ya no itera a ritmo fijo
     lv_log_register_print_cb(log_print);
 
     // Configurar pin del backlight
@@ -690,219 +1333,30 @@ void setup() {
     lv_display_t * disp;
     disp = lv_tft_espi_create(SCREEN_WIDTH, SCREEN_HEIGHT, draw_buf, sizeof(draw_buf));
     lv_display_set_rotation(disp, LV_DISPLAY_ROTATION_270);
+    lv_display_add_event_cb(disp, on_refresh_ready, LV_EVENT_REFR_READY, NULL);
 
     lv_indev_t * indev = lv_indev_create();
     lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
     lv_indev_set_read_cb(indev, touchscreen_read);
     lv_create_main_gui();
+    lv_create_trend_screen();
+    trendStore.begin(millis());
 
     // Inicializar últimos valores válidos
     for (int i = 0; i < 19; i++) {
         lastValidVals[i] = NAN;
     }
+
+    // Ingesta UART en el otro núcleo, despertada por el evento de recepción
+    xTaskCreatePinnedToCore(uart_task, "uart_rx", UART_TASK_STACK, NULL, UART_TASK_PRIORITY, &uartTaskHandle, UART_TASK_CORE);
+    Serial1.onReceive(on_uart_receive);
 }
 
 void loop() {
-    // Buffer fijo
-    static char buffer[256];
-    static size_t buf_idx = 0;
-    const size_t BUF_MAX = sizeof(buffer) - 1;
-    const int MAX_BYTES_PER_LOOP = 256; // limitar bytes procesados por iteración para mantener la UI responsiva
-    int processed = 0;
-
-    while (Serial1.available() && processed < MAX_BYTES_PER_LOOP) {
-        char c = (char)Serial1.read();
-        processed++;
-
-        if (c == '\r') continue;
-        if (c == '\n') {
- 
-            buffer[buf_idx] = '\0';
- 
-            // Trim inicial
-            char *msg = buffer;
-            while (*msg == ' ' || *msg == '\t') msg++;
- 
-            // Mensaje rápido de agua almacenada: "A:23.5"
-            if (buf_idx >= 2 && msg[0] == 'A' && msg[1] == ':') {
-                char *endptr = NULL;
-                float agua = (float)strtod(&msg[2], &endptr);
-                if (endptr != &msg[2]) {
-                    update_agua_almacenada(agua);
-                }
-            }
-            // Mensaje de inicialización desde AWG
-            else if (strncmp(msg, "AWG_INIT:", 9) == 0) {
-            }
-            // Mensajes de estado o control desde AWG: MODE:, COMP:, VENT:, PUMP:, CTRL:
-            else if (strncmp(msg, "MODE:", 5) == 0) {
-                char *modeVal = msg + 5;
-                while (*modeVal == ' ' || *modeVal == '\t') modeVal++;
-                if (strstr(modeVal, "AUTO") != NULL) {
-                    uiModeAuto = true;
-                    if (mode_btn_small) {
-                      lv_obj_t *lbl = lv_obj_get_child(mode_btn_small, 0);
-                      if (lbl) lv_label_set_text(lbl, "MODO AUTO");
-                      lv_obj_set_style_bg_color(mode_btn_small, lv_color_hex(0x64B5F6), 0);
-                    }
-                    if (ui_btn_comp) lv_obj_add_state(ui_btn_comp, LV_STATE_DISABLED);
-                    if (ui_btn_vent) lv_obj_add_state(ui_btn_vent, LV_STATE_DISABLED);
-                    if (ui_btn_comp_fan) lv_obj_add_state(ui_btn_comp_fan, LV_STATE_DISABLED);
-                    if (ui_btn_pump) lv_obj_add_state(ui_btn_pump, LV_STATE_DISABLED);
-                } else {
-                    uiModeAuto = false;
-                    if (mode_btn_small) {
-                      lv_obj_t *lbl = lv_obj_get_child(mode_btn_small, 0);
-                      if (lbl) lv_label_set_text(lbl, "MODO MANUAL");
-                      lv_obj_set_style_bg_color(mode_btn_small, COLOR_SECONDARY, 0);
-                    }
-                    if (ui_btn_comp) lv_obj_clear_state(ui_btn_comp, LV_STATE_DISABLED);
-                    if (ui_btn_vent) lv_obj_clear_state(ui_btn_vent, LV_STATE_DISABLED);
-                    if (ui_btn_comp_fan) lv_obj_clear_state(ui_btn_comp_fan, LV_STATE_DISABLED);
-                    if (ui_btn_pump) lv_obj_clear_state(ui_btn_pump, LV_STATE_DISABLED);
-                }
-            }
-            else if (strncmp(msg, "COMP:", 5) == 0) {
-                char *v = msg + 5;
-                while (*v == ' ' || *v == '\t') v++;
-                bool on = (strstr(v, "ON") != NULL);
-
-                // Mantener la variable local en sincronía con el estado real del compresor
-                ledState = on;
-
-                if (ui_btn_comp) {
-                    lv_obj_t *lbl = lv_obj_get_child(ui_btn_comp, 0);
-                    if (on) {
-                        lv_label_set_text(lbl, "APAGAR AWG");
-                        lv_obj_set_style_bg_color(ui_btn_comp, COLOR_ACCENT1, 0);
-                        lv_obj_set_style_shadow_color(ui_btn_comp, lv_color_darken(COLOR_ACCENT1, 30), 0);
-                    } else {
-                        lv_label_set_text(lbl, "ENCENDER AWG");
-                        lv_obj_set_style_bg_color(ui_btn_comp, COLOR_SECONDARY, 0);
-                        lv_obj_set_style_shadow_color(ui_btn_comp, lv_color_darken(COLOR_SECONDARY, 30), 0);
-                    }
-                }
-            }
-            else if (strncmp(msg, "VENT:", 5) == 0) {
-                char *v = msg + 5;
-                while (*v == ' ' || *v == '\t') v++;
-                bool on = (strstr(v, "ON") != NULL);
-
-                // Sincronizar estado local del ventilador
-                ventState = on;
-
-                if (ui_btn_vent) {
-                    lv_obj_t *lbl = lv_obj_get_child(ui_btn_vent, 0);
-                    if (on) {
-                        lv_label_set_text(lbl, "APAGAR EFAN");
-                        lv_obj_set_style_bg_color(ui_btn_vent, COLOR_ACCENT1, 0);
-                    } else {
-                        lv_label_set_text(lbl, "ENCENDER EFAN");
-                        lv_obj_set_style_bg_color(ui_btn_vent, COLOR_SECONDARY, 0);
-                    }
-                }
-            }
-            else if (strncmp(msg, "CFAN:", 5) == 0) {
-                char *v = msg + 5;
-                while (*v == ' ' || *v == '\t') v++;
-                bool on = (strstr(v, "ON") != NULL);
-
-                // Sincronizar estado local del ventilador del compresor
-                compFanState = on;
-
-                if (ui_btn_comp_fan) {
-                    lv_obj_t *lbl = lv_obj_get_child(ui_btn_comp_fan, 0);
-                    if (on) {
-                        lv_label_set_text(lbl, "APAGAR CFAN");
-                        lv_obj_set_style_bg_color(ui_btn_comp_fan, COLOR_ACCENT1, 0);
-                    } else {
-                        lv_label_set_text(lbl, "ENCENDER CFAN");
-                        lv_obj_set_style_bg_color(ui_btn_comp_fan, COLOR_SECONDARY, 0);
-                    }
-                }
-            }
-            else if (strncmp(msg, "PUMP:", 5) == 0) {
-                char *v = msg + 5;
-                while (*v == ' ' || *v == '\t') v++;
-                bool on = (strstr(v, "ON") != NULL);
-
-                // Sincronizar estado local de la bomba
-                pumpState = on;
-
-                if (ui_btn_pump) {
-                    lv_obj_t *lbl = lv_obj_get_child(ui_btn_pump, 0);
-                    if (on) {
-                        lv_label_set_text(lbl, "APAGAR BOMB");
-                        lv_obj_set_style_bg_color(ui_btn_pump, COLOR_ACCENT1, 0);
-                    } else {
-                        lv_label_set_text(lbl, "ENCENDER BOMB");
-                        lv_obj_set_style_bg_color(ui_btn_pump, COLOR_SECONDARY, 0);
-                    }
-                }
-            }
-            else if (strncmp(msg, "CTRL:", 5) == 0) {
-            }
-            else if (strncmp(msg, "BACKLIGHT:", 10) == 0) {
-                char *state = msg + 10;
-                while (*state == ' ' || *state == '\t') state++;
-                if (strstr(state, "ON") != NULL) {
-                    digitalWrite(TFT_BACKLIGHT_PIN, HIGH);
-                    backlightOn = true;
-                    lastActivityTime = millis();
-                } else if (strstr(state, "OFF") != NULL) {
-                    digitalWrite(TFT_BACKLIGHT_PIN, LOW);
-                    backlightOn = false;
-                }
-            }
-            else if (strncmp(msg, "SCREEN_TIMEOUT:", 15) == 0) {
-                char *timeoutStr = msg + 15;
-                while (*timeoutStr == ' ' || *timeoutStr == '\t') timeoutStr++;
-                screenTimeoutSec = atoi(timeoutStr);
-                lastActivityTime = millis();  // Reset timer al cambiar configuración
-            }
-            // Mensaje CSV completo (valores)
-            else if (buf_idx > 0) {
-                float vals[18];
-                int idx = 0;
-
-                // Hacemos una copia modificable del buffer (ya es char[])
-                char tmpBuf[256];
-                size_t copyLen = buf_idx < sizeof(tmpBuf) - 1 ? buf_idx : (sizeof(tmpBuf) - 1);
-                memcpy(tmpBuf, buffer, copyLen);
-                tmpBuf[copyLen] = '\0';
-
-                char *ptr = strtok(tmpBuf, ",");
-                while (ptr && idx < 18) {
-                    // Intentar convertir; marcar como NAN si no es numérico
-                    char *endptr = nullptr;
-                    double v = strtod(ptr, &endptr);
-                    if (endptr != ptr) {
-                        vals[idx++] = (float)v;
-                    } else {
-                        vals[idx++] = NAN;
-                    }
-                    ptr = strtok(NULL, ",");
-                }
-                // Guardar número de campos y rellenar el resto con NAN
-                int fieldCount = idx;
-                for (int i = idx; i < 18; i++) vals[i] = NAN;
-                update_labels(vals);
-            }
- 
-            // Reset del buffer para el próximo mensaje
-            buf_idx = 0;
-            buffer[0] = '\0';
-        } else {
-            // Añadir char al buffer si hay espacio; si no, descartar y resetear para evitar overflow
-            if (buf_idx < BUF_MAX) {
-                buffer[buf_idx++] = c;
-            } else {
-                // Buffer overflow - resetear para recuperar operación
-                buf_idx = 0;
-                buffer[0] = '\0';
-            }
-        }
-    }
+    uiMailbox.fetch();  // Tomar la instantánea más reciente (si llegó alguna)
+    apply_mailbox();
+    trend_record();
+
     // Gestionar timeout del backlight
     unsigned long currentTime = millis();
     if (screenTimeoutSec > 0 && backlightOn) {
@@ -912,15 +1366,24 @@ void loop() {
             Serial.println("BACKLIGHT:OFF");  // Notificar al dispositivo
         }
     }
+    report_ui_stats(currentTime);
+    ota_health(currentTime);
+
+    // Pantalla apagada: no se renderiza; solo se sondea el táctil para despertar
+    if (!backlightOn) {
+        if (!(touchscreen.tirqTouched() && touchscreen.touched())) {
+            delay(DARK_POLL_MS);
+            return;
+        }
+        wake_backlight();
+        apply_mailbox();  // Widgets pendientes de una vez, antes del primer refresco
+    }
 
-    // Procesar la UI frecuentemente para evitar "pegados"
-    lv_task_handler();
-    lv_tick_inc(5);
+    trend_sync();
 
-    // Si hay más datos pendientes, dar un pequeño respiro para mantener responsividad
-    if (Serial1.available() > 0) {
-        delay(1);
-    } else {
-        delay(2);
-    }
-}
\ No newline at end of file
+    // Procesar la UI; LVGL indica cuánto falta para su próximo temporizador
+    uint32_t wait = lv_timer_handler();
+    if (wait < 1) wait = 1;
+    if (wait > UI_MAX_WAIT_MS) wait = UI_MAX_WAIT_MS;
+    delay(wait);
+}
@@ -0,0 +1,155 @@
+#ifndef TREND_STORE_H
+#define TREND_STORE_H
+
+// Series de tendencia en memoria fija para las gráficas de la pantalla
+//
+// Cinco canales (temperatura y humedad ambiente, temperatura del evaporador, agua almacenada
+// y potencia) en dos anillos de resolución: 120 intervalos de 1 min (últimas 2 h) y 120 de
+// 12 min (últimas 24 h). Cada intervalo guarda mínimo y máximo por canal en int16 escalado;
+// al pasar de un nivel al siguiente se combinan mínimo de mínimos y máximo de máximos, de modo
+// que una caída breve de humedad sigue visible en la vista de 24 h (un promedio o una
+// selección de puntos como LTTB podría ocultarla). Total: 2 x 120 x 20 bytes = 4.8 KB.
+//
+// El tiempo viene de millis() de la pantalla (no tiene RTC): los intervalos sin muestras
+// quedan marcados como vacíos y la gráfica muestra el hueco.
+//
+// Sin dependencias de Arduino ni de LVGL: puede evaluarse en host con series sintéticas.
+
+#include <math.h>
+#include <stdint.h>
+
+enum TrendChannel : uint8_t {
+  TREND_TEMP_AMB = 0,   // Temperatura ambiente (°C)
+  TREND_HUM_AMB,        // Humedad relativa ambiente (%)
+  TREND_TEMP_EVAP,      // Temperatura del evaporador (°C)
+  TREND_WATER,          // Agua almacenada (L)
+  TREND_POWER,          // Potencia (W)
+  TREND_CHANNEL_COUNT
+};
+
+enum TrendLevel : uint8_t {
+  TREND_LEVEL_2H = 0,
+  TREND_LEVEL_24H,
+  TREND_LEVEL_COUNT
+};
+
+#define TREND_POINTS 120            // Intervalos por anillo (= puntos de la gráfica)
+#define TREND_INVALID INT16_MIN     // Intervalo sin muestras válidas
+
+static const uint32_t TREND_PERIOD_MS[TREND_LEVEL_COUNT] = { 60000UL, 720000UL };  // 1 min, 12 min
+static const char* const TREND_LEVEL_NAME[TREND_LEVEL_COUNT] = { "2 h", "24 h" };
+static const char* const TREND_CHANNEL_NAME[TREND_CHANNEL_COUNT] = { "Temp. ambiente", "Humedad ambiente", "Temp. evaporador", "Agua almacenada", "Potencia" };
+static const char* const TREND_CHANNEL_UNIT[TREND_CHANNEL_COUNT] = { "°C", "%", "°C", "L", "W" };
+static const float TREND_CHANNEL_SCALE[TREND_CHANNEL_COUNT] = { 100.0f, 100.0f, 100.0f, 10.0f, 1.0f };  // int16 = valor x escala
+
+struct TrendBucket {
+  int16_t min[TREND_CHANNEL_COUNT];
+  int16_t max[TREND_CHANNEL_COUNT];
+};
+
+class TrendStore {
+public:
+  void begin(uint32_t nowMs) {
+    for (uint8_t l = 0; l < TREND_LEVEL_COUNT; l++) {
+      head_[l] = 0;
+      count_[l] = 0;
+      closed_[l] = 0;
+      clearBucket(open_[l]);
+    }
+    openStart_ = nowMs;
+    merged_ = 0;
+  }
+
+  // Incorpora una muestra (NAN = canal sin dato). Devuelve la máscara de niveles que
+  // cerraron al menos un intervalo (bit 0: 2 h, bit 1: 24 h)
+  uint8_t sample(uint32_t nowMs, const float values[TREND_CHANNEL_COUNT]) {
+    uint8_t closedMask = advance(nowMs);
+    for (uint8_t c = 0; c < TREND_CHANNEL_COUNT; c++) {
+      if (isnan(values[c])) continue;
+      int16_t raw = toRaw((TrendChannel)c, values[c]);
+      TrendBucket& b = open_[TREND_LEVEL_2H];
+      if (b.min[c] == TREND_INVALID || raw < b.min[c]) b.min[c] = raw;
+      if (b.max[c] == TREND_INVALID || raw > b.max[c]) b.max[c] = raw;
+    }
+    return closedMask;
+  }
+
+  // Cierra los intervalos vencidos aunque no lleguen muestras (AWG desconectado)
+  uint8_t advance(uint32_t nowMs) {
+    uint8_t closedMask = 0;
+    uint32_t period = TREND_PERIOD_MS[TREND_LEVEL_2H];
+    // Tras un hueco mayor que las 24 h completas no tiene sentido cerrar intervalo por intervalo
+    uint32_t maxCloses = (uint32_t)TREND_POINTS * (TREND_PERIOD_MS[TREND_LEVEL_24H] / period) + 1;
+    while (nowMs - openStart_ >= period && maxCloses-- > 0) {
+      closedMask |= closeMinute();
+      openStart_ += period;
+    }
+    if (nowMs - openStart_ >= period) openStart_ = nowMs;
+    return closedMask;
+  }
+
+  uint16_t count(uint8_t level) const { return count_[level]; }
+  // Intervalos cerrados desde begin(); la diferencia entre dos lecturas indica cuántos puntos añadir
+  uint32_t closed(uint8_t level) const { return closed_[level]; }
+  // Intervalo i del nivel, 0 = el más antiguo
+  const TrendBucket& bucket(uint8_t level, uint16_t i) const {
+    uint16_t start = (uint16_t)((head_[level] + TREND_POINTS - count_[level]) % TREND_POINTS);
+    return ring_[level][(start + i) % TREND_POINTS];
+  }
+  // Intervalo en curso del nivel de 2 h (parcial)
+  const TrendBucket& openBucket() const { return open_[TREND_LEVEL_2H]; }
+
+  static int16_t toRaw(TrendChannel c, float value) {
+    float v = roundf(value * TREND_CHANNEL_SCALE[c]);
+    if (v > 32767.0f) return 32767;
+    if (v < -32767.0f) return -32767;
+    return (int16_t)v;
+  }
+  static float toValue(TrendChannel c, int16_t raw) {
+    return raw == TREND_INVALID ? NAN : (float)raw / TREND_CHANNEL_SCALE[c];
+  }
+
+private:
+  TrendBucket ring_[TREND_LEVEL_COUNT][TREND_POINTS];
+  uint16_t head_[TREND_LEVEL_COUNT] = { 0 };
+  uint16_t count_[TREND_LEVEL_COUNT] = { 0 };
+  uint32_t closed_[TREND_LEVEL_COUNT] = { 0 };
+  TrendBucket open_[TREND_LEVEL_COUNT];  // Intervalos en curso (el de 24 h acumula los de 1 min)
+  uint32_t openStart_ = 0;
+  uint16_t merged_ = 0;                  // Intervalos de 1 min acumulados en el de 12 min
+
+  static void clearBucket(TrendBucket& b) {
+    for (uint8_t c = 0; c < TREND_CHANNEL_COUNT; c++) b.min[c] = b.max[c] = TREND_INVALID;
+  }
+
+  // Combina conservando los extremos
+  static void mergeInto(TrendBucket& dst, const TrendBucket& src) {
+    for (uint8_t c = 0; c < TREND_CHANNEL_COUNT; c++) {
+      if (src.min[c] != TREND_INVALID && (dst.min[c] == TREND_INVALID || src.min[c] < dst.min[c])) dst.min[c] = src.min[c];
+      if (src.max[c] != TREND_INVALID && (dst.max[c] == TREND_INVALID || src.max[c] > dst.max[c])) dst.max[c] = src.max[c];
+    }
+  }
+
+  void push(uint8_t level, const TrendBucket& b) {
+    ring_[level][head_[level]] = b;
+    head_[level] = (uint16_t)((head_[level] + 1) % TREND_POINTS);
+    if (count_[level] < TREND_POINTS) count_[level]++;
+    closed_[level]++;
+  }
+
+  uint8_t closeMinute() {
+    uint8_t mask = 1 << TREND_LEVEL_2H;
+    push(TREND_LEVEL_2H, open_[TREND_LEVEL_2H]);
+    mergeInto(open_[TREND_LEVEL_24H], open_[TREND_LEVEL_2H]);
+    clearBucket(open_[TREND_LEVEL_2H]);
+    if (++merged_ >= TREND_PERIOD_MS[TREND_LEVEL_24H] / TREND_PERIOD_MS[TREND_LEVEL_2H]) {
+      push(TREND_LEVEL_24H, open_[TREND_LEVEL_24H]);
+      clearBucket(open_[TREND_LEVEL_24H]);
+      merged_ = 0;
+      mask |= 1 << TREND_LEVEL_24H;
+    }
+    return mask;
+  }
+};
+
+#endif  // TREND_STORE_H
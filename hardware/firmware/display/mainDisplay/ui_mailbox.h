@@ -0,0 +1,231 @@
+#ifndef UI_MAILBOX_H
+#define UI_MAILBOX_H
+
+// Buzón sin bloqueos entre la tarea de recepción UART y el hilo de LVGL
+//
+// La tarea UART (núcleo 0) interpreta las líneas del AWG sobre su copia de trabajo de
+// DisplayState y la publica completa en un triple buffer. LVGL (núcleo 1) toma solo el
+// estado más reciente: si llegan diez líneas CSV mientras dibuja, aplica la última y las
+// anteriores se descartan sin costo. Productor y consumidor nunca se esperan entre sí: cada
+// uno es dueño de un buffer y el tercero se intercambia con una sola operación atómica.
+//
+// Cada campo lleva un contador de secuencia (para que el consumidor aplique solo lo que
+// cambió) y la marca de tiempo de recepción (para medir la latencia byte UART -> píxel).
+//
+// Sin dependencias de Arduino ni de LVGL: puede probarse en host con dos hilos.
+
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UI_VALUE_COUNT 18        // Campos de la trama CSV del AWG
+#define UI_LINE_MAX 256          // Longitud máxima de línea (mayores se descartan)
+
+enum UiField : uint8_t {
+  UI_FIELD_VALUES = 0,       // Trama CSV completa
+  UI_FIELD_AGUA,             // "A:23.5" agua almacenada
+  UI_FIELD_MODE,             // "MODE:AUTO|MANUAL"
+  UI_FIELD_COMP,             // "COMP:ON|OFF"
+  UI_FIELD_VENT,             // "VENT:ON|OFF"
+  UI_FIELD_CFAN,             // "CFAN:ON|OFF"
+  UI_FIELD_PUMP,             // "PUMP:ON|OFF"
+  UI_FIELD_BACKLIGHT,        // "BACKLIGHT:ON|OFF" ordenado por el AWG
+  UI_FIELD_SCREEN_TIMEOUT,   // "SCREEN_TIMEOUT:seg"
+  UI_FIELD_COUNT
+};
+
+struct DisplayState {
+  uint32_t seq[UI_FIELD_COUNT];    // Actualizaciones recibidas por campo
+  uint32_t rxUs[UI_FIELD_COUNT];   // Recepción de la última actualización (µs)
+  float vals[UI_VALUE_COUNT];
+  float agua;
+  bool modeAuto;
+  bool comp, vent, cfan, pump;
+  bool backlight;
+  uint16_t screenTimeoutSec;
+};
+
+// Triple buffer de un productor y un consumidor: publish() nunca bloquea y fetch() devuelve
+// siempre una instantánea completa (nunca a medio escribir)
+template <typename T>
+class LatestMailbox {
+public:
+  // Productor: escribir en back() y publicar
+  T& back() { return buf_[back_]; }
+  void publish() {
+    uint8_t prev = middle_.exchange((uint8_t)(back_ | DIRTY), std::memory_order_acq_rel);
+    if (prev & DIRTY) coalesced_.fetch_add(1, std::memory_order_relaxed);  // El consumidor no llegó a verlo
+    back_ = prev & INDEX;
+    published_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Consumidor: true si hay una instantánea nueva en front()
+  bool fetch() {
+    if (!(middle_.load(std::memory_order_relaxed) & DIRTY)) return false;
+    uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = prev & INDEX;
+    return true;
+  }
+  const T& front() const { return buf_[front_]; }
+
+  uint32_t published() const { return published_.load(std::memory_order_relaxed); }
+  uint32_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+
+private:
+  static const uint8_t INDEX = 0x03;
+  static const uint8_t DIRTY = 0x04;
+  T buf_[3] = {};
+  uint8_t back_ = 0;                     // Solo productor
+  uint8_t front_ = 1;                    // Solo consumidor
+  std::atomic<uint8_t> middle_{ 2 };     // Intercambio (índice + bit de nuevo)
+  std::atomic<uint32_t> published_{ 0 };
+  std::atomic<uint32_t> coalesced_{ 0 };
+};
+
+// Interpreta las líneas del AWG sobre un DisplayState y las publica en el buzón
+class UiLineParser {
+public:
+  explicit UiLineParser(LatestMailbox<DisplayState>& mailbox) : mailbox_(mailbox) {
+    memset(&state_, 0, sizeof(state_));
+    for (int i = 0; i < UI_VALUE_COUNT; i++) state_.vals[i] = NAN;
+    state_.agua = NAN;
+    state_.backlight = true;
+  }
+
+  // Consume bytes recibidos en rxUs. Devuelve true si alguna línea cambió el estado
+  bool feed(const uint8_t* data, size_t len, uint32_t rxUs) {
+    bool changed = false;
+    for (size_t i = 0; i < len; i++) {
+      char c = (char)data[i];
+      if (c == '\r') continue;
+      if (c == '\n') {
+        if (overflow_) {
+          overflow_ = false;
+          droppedLines_++;
+        } else if (len_ > 0) {
+          line_[len_] = '\0';
+          if (parseLine(line_, lineStartUs_)) changed = true;
+        }
+        len_ = 0;
+        continue;
+      }
+      if (len_ == 0) lineStartUs_ = rxUs;
+      if (len_ < UI_LINE_MAX - 1) {
+        line_[len_++] = c;
+      } else {
+        overflow_ = true;  // Se descarta hasta el próximo fin de línea
+      }
+    }
+    return changed;
+  }
+
+  // Copia el estado de trabajo al buzón (una vez por ráfaga, no por línea)
+  void publish() {
+    mailbox_.back() = state_;
+    mailbox_.publish();
+  }
+
+  uint32_t lines() const { return lines_; }
+  uint32_t droppedLines() const { return droppedLines_; }
+
+private:
+  LatestMailbox<DisplayState>& mailbox_;
+  DisplayState state_;
+  char line_[UI_LINE_MAX];
+  size_t len_ = 0;
+  bool overflow_ = false;
+  uint32_t lineStartUs_ = 0;
+  uint32_t lines_ = 0;
+  uint32_t droppedLines_ = 0;
+
+  void touch(UiField f, uint32_t rxUs) {
+    state_.seq[f]++;
+    state_.rxUs[f] = rxUs;
+  }
+
+  static const char* skipBlank(const char* p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+  }
+
+  static bool isOn(const char* v) { return strstr(v, "ON") != NULL; }
+
+  bool parseLine(char* line, uint32_t rxUs) {
+    lines_++;
+    const char* msg = skipBlank(line);
+    // Mensaje rápido de agua almacenada: "A:23.5"
+    if (msg[0] == 'A' && msg[1] == ':') {
+      char* endptr = NULL;
+      float agua = strtof(msg + 2, &endptr);
+      if (endptr == msg + 2) return false;
+      state_.agua = agua;
+      touch(UI_FIELD_AGUA, rxUs);
+      return true;
+    }
+    if (strncmp(msg, "AWG_INIT:", 9) == 0 || strncmp(msg, "CTRL:", 5) == 0) return false;
+    if (strncmp(msg, "MODE:", 5) == 0) {
+      state_.modeAuto = strstr(skipBlank(msg + 5), "AUTO") != NULL;
+      touch(UI_FIELD_MODE, rxUs);
+      return true;
+    }
+    if (strncmp(msg, "COMP:", 5) == 0) return setFlag(state_.comp, UI_FIELD_COMP, msg + 5, rxUs);
+    if (strncmp(msg, "VENT:", 5) == 0) return setFlag(state_.vent, UI_FIELD_VENT, msg + 5, rxUs);
+    if (strncmp(msg, "CFAN:", 5) == 0) return setFlag(state_.cfan, UI_FIELD_CFAN, msg + 5, rxUs);
+    if (strncmp(msg, "PUMP:", 5) == 0) return setFlag(state_.pump, UI_FIELD_PUMP, msg + 5, rxUs);
+    if (strncmp(msg, "BACKLIGHT:", 10) == 0) {
+      const char* v = skipBlank(msg + 10);
+      if (strstr(v, "ON") != NULL) {
+        state_.backlight = true;
+      } else if (strstr(v, "OFF") != NULL) {
+        state_.backlight = false;
+      } else {
+        return false;
+      }
+      touch(UI_FIELD_BACKLIGHT, rxUs);
+      return true;
+    }
+    if (strncmp(msg, "SCREEN_TIMEOUT:", 15) == 0) {
+      state_.screenTimeoutSec = (uint16_t)atoi(skipBlank(msg + 15));
+      touch(UI_FIELD_SCREEN_TIMEOUT, rxUs);
+      return true;
+    }
+    // Trama CSV completa; los campos no numéricos quedan en NAN
+    int idx = 0;
+    char* save = NULL;
+    for (char* tok = strtok_r(line, ",", &save); tok && idx < UI_VALUE_COUNT; tok = strtok_r(NULL, ",", &save)) {
+      char* endptr = NULL;
+      float v = strtof(tok, &endptr);
+      state_.vals[idx++] = (endptr != tok) ? v : NAN;
+    }
+    for (int i = idx; i < UI_VALUE_COUNT; i++) state_.vals[i] = NAN;
+    touch(UI_FIELD_VALUES, rxUs);
+    return true;
+  }
+
+  bool setFlag(bool& flag, UiField f, const char* v, uint32_t rxUs) {
+    flag = isOn(skipBlank(v));
+    touch(f, rxUs);
+    return true;
+  }
+};
+
+// Estadística de latencia (µs): última, media y máxima desde el último reset
+struct LatencyStats {
+  uint32_t last = 0;
+  uint32_t max = 0;
+  uint32_t count = 0;
+  uint64_t sum = 0;
+
+  void add(uint32_t us) {
+    last = us;
+    if (us > max) max = us;
+    sum += us;
+    count++;
+  }
+  uint32_t average() const { return count > 0 ? (uint32_t)(sum / count) : 0; }
+  void reset() { *this = LatencyStats(); }
+};
+
+#endif  // UI_MAILBOX_H
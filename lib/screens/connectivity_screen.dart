@@ -69,6 +69,95 @@ class _ConnectivityScreenState extends State<ConnectivityScreen> {
     });
   }
 
+  /// Cambia al equipo elegido en el listado de equipos descubiertos
+  Future<void> _followDevice(String deviceId) async {
+    setState(() {
+      isConnecting = true;
+    });
+    try {
+      await SingletonMqttService().followDevice(deviceId);
+      await _loadSavedMqttConfig();
+    } catch (e) {
+      print('[CONNECTIVITY] Error cambiando al equipo $deviceId: $e');
+      ScaffoldMessenger.of(context).showSnackBar(
+        SnackBar(content: Text('No se pudo seguir a $deviceId: $e')),
+      );
+    }
+    setState(() {
+      isConnecting = false;
+    });
+  }
+
+  /// Equipos que publican presencia en el broker. El firmware actual usa tópicos
+  /// dropster/<id>/...: con el tópico plano dropster/data la app solo ve equipos en modo
+  /// legacy, así que se ofrece cada id para seguirlo
+  Widget _buildDiscoveredDevices(Color colorAccent) {
+    final service = SingletonMqttService().mqttClientService;
+    return ValueListenableBuilder<Map<String, bool>>(
+      valueListenable: service.discoveredDevices,
+      builder: (context, devices, child) {
+        final followed = service.followedDeviceId;
+        final ids = devices.keys.toList()..sort();
+        return Card(
+          shape:
+              RoundedRectangleBorder(borderRadius: BorderRadius.circular(12)),
+          elevation: 2,
+          child: Padding(
+            padding: const EdgeInsets.all(16),
+            child: Column(
+              crossAxisAlignment: CrossAxisAlignment.start,
+              children: [
+                Row(
+                  children: [
+                    Icon(Icons.devices, color: colorAccent, size: 28),
+                    SizedBox(width: 12),
+                    Text(
+                      'Equipos en el broker',
+                      style: TextStyle(
+                        fontSize: 18,
+                        fontWeight: FontWeight.bold,
+                        color: Colors.white,
+                      ),
+                    ),
+                  ],
+                ),
+                SizedBox(height: 8),
+                _buildNetworkInfo('Equipo seguido',
+                    followed ?? 'tópicos planos (dropster/data)'),
+                if (ids.isEmpty)
+                  Padding(
+                    padding: const EdgeInsets.only(top: 8),
+                    child: Text(
+                      'Ningún equipo anunció presencia (los equipos en modo legacy no la publican)',
+                      style: TextStyle(fontSize: 13, color: Colors.white70),
+                    ),
+                  ),
+                for (final id in ids)
+                  ListTile(
+                    contentPadding: EdgeInsets.zero,
+                    dense: true,
+                    leading: Icon(Icons.circle,
+                        size: 12,
+                        color: devices[id]! ? Colors.green : Colors.grey),
+                    title: Text(id, style: TextStyle(color: Colors.white)),
+                    subtitle: Text(devices[id]! ? 'En línea' : 'Desconectado',
+                        style: TextStyle(color: Colors.white70)),
+                    trailing: id == followed
+                        ? Icon(Icons.check, color: colorAccent)
+                        : TextButton(
+                            onPressed:
+                                isConnecting ? null : () => _followDevice(id),
+                            child: Text('Seguir'),
+                          ),
+                  ),
+              ],
+            ),
+          ),
+        );
+      },
+    );
+  }
+
   Future<void> _disconnectMQTT() async {
     await SingletonMqttService().disconnect();
     setState(() {});
@@ -313,6 +402,8 @@ class _ConnectivityScreenState extends State<ConnectivityScreen> {
                       ),
                     ),
                   ),
+                  SizedBox(height: 24),
+                  _buildDiscoveredDevices(colorAccent),
                 ],
               ),
             ),
@@ -321,7 +321,7 @@ class _MqttConfigScreenState extends State<MqttConfigScreen> {
               controller: _topicController,
               decoration: const InputDecoration(
                 labelText: 'Tópico',
-                hintText: 'dropster/data',
+                hintText: 'dropster/<id>/data (o dropster/data en legacy)',
                 border: OutlineInputBorder(),
               ),
               validator: (value) {
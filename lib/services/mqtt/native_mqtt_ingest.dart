@@ -0,0 +1,310 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/scheduler.dart';
+import 'package:flutter/services.dart';
+
+/// Estado de actuadores y modo de un dispositivo, decodificado en nativo
+class NativeStatus {
+  final String device;
+  final int? compressor;
+  final int? ventilador;
+  final int? pump;
+  final int? compressorFan;
+  final String? mode;
+
+  NativeStatus(this.device, this.compressor, this.ventilador, this.pump,
+      this.compressorFan, this.mode);
+}
+
+typedef _TakeBatchNative = Pointer<Uint8> Function();
+typedef _TakeBatch = Pointer<Uint8> Function();
+
+/// Ingesta MQTT nativa del escritorio Linux (linux/runner/mqtt_ingest_plugin.cc).
+///
+/// El runner mantiene su propia conexión con el broker, decodifica dropster/data, status y
+/// alerts en su hilo de red y coalesce por dispositivo: cuando hay un lote listo avisa con
+/// "batchReady" (como máximo una vez por cuadro) y aquí se lee por FFI directamente de la
+/// memoria nativa, sin copiar ni volver a parsear JSON en el isolate de la UI.
+///
+/// El formato del lote está descrito en linux/runner/mqtt_ingest_batcher.h y
+/// mqtt_ingest_decoder.h; los desplazamientos de abajo deben coincidir con esos structs.
+class NativeMqttIngest {
+  static const MethodChannel _channel = MethodChannel('dropster/mqtt_ingest');
+
+  // Cabecera del lote (IngestBatchHeader, 32 bytes)
+  static const int _batchMagic = 0x42495244;
+  static const int _headerSize = 32;
+  static const int _offTotalBytes = 8;
+  static const int _offRecordCount = 12;
+  static const int _offMessages = 16;
+  static const int _offDroppedEvents = 20;
+
+  // Registro (IngestRecord, 216 bytes)
+  static const int _recordSize = 216;
+  static const int _offKind = 0;
+  static const int _offTopic = 1;
+  static const int _offPresent = 16;
+  static const int _offTextLen = 20;
+  static const int _offDevice = 24;
+  static const int _deviceLen = 32;
+  static const int _offValues = 56;
+
+  static const int _kindData = 1;
+  static const int _kindStatus = 2;
+  static const int _kindEvent = 3;
+  static const int topicStatus = 1;
+  static const int topicAlerts = 2;
+
+  // Claves en el orden de IngestDataField / IngestStatusField
+  static const List<String> _dataKeys = [
+    't', 'h', 'p', 'w', 'wr', 'wu', 'tank_capacity', 'te', 'he', 'tc', //
+    'dp', 'ha', 'v', 'c', 'po', 'e', 'cs', 'calibrated', 'ts',
+  ];
+  static const int _dataCs = 16;
+  static const int _dataCalibrated = 17;
+  static const int _dataTs = 18;
+  static const List<String> _modeNames = [
+    'MANUAL', 'AUTO', 'AUTO_PID', 'AUTO_TIME', 'AUTO_ADAPTIVE', //
+  ];
+
+  /// Datos de sensores: un mapa por dispositivo con las claves abreviadas del AWG
+  /// (el mismo formato que el JSON de dropster/data)
+  void Function(List<Map<String, dynamic>> batch)? onData;
+
+  /// Estados de actuadores y modo, uno por dispositivo
+  void Function(List<NativeStatus> batch)? onStatus;
+
+  /// Mensajes no coalescidos, en orden: alertas y mensajes de estado que no son estado
+  /// (config_ack, system_status, pump_error...)
+  void Function(int topic, String device, String payload)? onEvent;
+
+  _TakeBatch? _takeBatch;
+  bool _active = false;
+
+  // Métricas del lado Dart
+  int _batches = 0;
+  int _records = 0;
+  int _messages = 0;
+  int _droppedEvents = 0;
+  int _drainMicros = 0;
+  int _maxDrainMicros = 0;
+  int _frames = 0;
+  int _slowFrames = 0;
+  int _maxBuildMicros = 0;
+  int _maxRasterMicros = 0;
+
+  void _log(String message) {
+    if (kDebugMode) {
+      debugPrint('[MQTT-NATIVE] $message');
+    }
+  }
+
+  bool get isActive => _active;
+
+  /// Solo el runner de Linux incluye el plugin
+  static bool get isSupported => !kIsWeb && Platform.isLinux;
+
+  /// Inicia la conexión nativa. Devuelve false si el plugin no está disponible (otra
+  /// plataforma o runner sin compilar con libmosquitto): se sigue con el cliente Dart
+  Future<bool> start({
+    required String broker,
+    required int port,
+    required String dataTopic,
+    String user = '',
+    String password = '',
+    bool useTls = false,
+  }) async {
+    if (!isSupported) return false;
+    try {
+      _takeBatch ??= DynamicLibrary.process()
+          .lookupFunction<_TakeBatchNative, _TakeBatch>(
+              'dropster_ingest_take_batch');
+      _channel.setMethodCallHandler(_onMethodCall);
+      await _channel.invokeMethod('start', {
+        'broker': broker,
+        'port': port,
+        'user': user,
+        'password': password,
+        'tls': useTls,
+        'dataTopic': dataTopic,
+        'clientId': 'dropster_native_${DateTime.now().millisecondsSinceEpoch}',
+      });
+    } on MissingPluginException {
+      _log('Plugin nativo no disponible');
+      return false;
+    } on ArgumentError catch (e) {
+      _log('Símbolo nativo no encontrado: $e');
+      return false;
+    } on PlatformException catch (e) {
+      _log('Error iniciando ingesta nativa: ${e.message}');
+      return false;
+    }
+    if (!_active) {
+      SchedulerBinding.instance.addTimingsCallback(_onFrameTimings);
+    }
+    _active = true;
+    _drain(); // Por si quedó un lote de una conexión anterior
+    _log('Ingesta nativa activa en $broker:$port');
+    return true;
+  }
+
+  /// Detiene la conexión nativa
+  Future<void> stop() async {
+    if (!_active) return;
+    _active = false;
+    SchedulerBinding.instance.removeTimingsCallback(_onFrameTimings);
+    try {
+      await _channel.invokeMethod('stop');
+    } catch (e) {
+      _log('Error deteniendo ingesta nativa: $e');
+    }
+  }
+
+  Future<dynamic> _onMethodCall(MethodCall call) async {
+    if (call.method == 'batchReady' && _active) {
+      _drain();
+    }
+    return null;
+  }
+
+  /// Lee el lote pendiente directamente de la memoria nativa. La vista solo es válida
+  /// hasta la siguiente llamada a dropster_ingest_take_batch(), así que todo se procesa
+  /// de forma síncrona aquí
+  void _drain() {
+    final take = _takeBatch;
+    if (take == null) return;
+    final sw = Stopwatch()..start();
+    final ptr = take();
+    if (ptr == nullptr) return;
+
+    final totalBytes = ptr.cast<Uint32>()[_offTotalBytes ~/ 4];
+    final view = ptr.asTypedList(totalBytes);
+    final bytes = ByteData.sublistView(view);
+    if (bytes.getUint32(0, Endian.little) != _batchMagic) {
+      _log('Lote nativo con formato desconocido');
+      return;
+    }
+    final recordCount = bytes.getUint32(_offRecordCount, Endian.little);
+    _messages += bytes.getUint32(_offMessages, Endian.little);
+    _droppedEvents += bytes.getUint32(_offDroppedEvents, Endian.little);
+
+    final data = <Map<String, dynamic>>[];
+    final statuses = <NativeStatus>[];
+    final events = <(int, String, String)>[];
+    for (var i = 0; i < recordCount; i++) {
+      final base = _headerSize + i * _recordSize;
+      final kind = bytes.getUint8(base + _offKind);
+      final device = _readDevice(view, base + _offDevice);
+      if (kind == _kindData) {
+        data.add(_readData(bytes, base, device));
+      } else if (kind == _kindStatus) {
+        statuses.add(_readStatus(bytes, base, device));
+      } else if (kind == _kindEvent) {
+        final offset = bytes.getUint32(base + _offValues, Endian.little);
+        final len = bytes.getUint32(base + _offTextLen, Endian.little);
+        final payload = utf8.decode(
+            Uint8List.sublistView(view, offset, offset + len),
+            allowMalformed: true);
+        events.add((bytes.getUint8(base + _offTopic), device, payload));
+      }
+    }
+
+    // Entregar una vez por lote
+    if (data.isNotEmpty) onData?.call(data);
+    if (statuses.isNotEmpty) onStatus?.call(statuses);
+    for (final (topic, device, payload) in events) {
+      onEvent?.call(topic, device, payload);
+    }
+
+    sw.stop();
+    _batches++;
+    _records += recordCount;
+    _drainMicros += sw.elapsedMicroseconds;
+    if (sw.elapsedMicroseconds > _maxDrainMicros) {
+      _maxDrainMicros = sw.elapsedMicroseconds;
+    }
+  }
+
+  String _readDevice(Uint8List view, int offset) {
+    var end = offset;
+    while (end < offset + _deviceLen && view[end] != 0) {
+      end++;
+    }
+    return utf8.decode(Uint8List.sublistView(view, offset, end),
+        allowMalformed: true);
+  }
+
+  Map<String, dynamic> _readData(ByteData bytes, int base, String device) {
+    final present = bytes.getUint32(base + _offPresent, Endian.little);
+    final map = <String, dynamic>{'id': device};
+    for (var f = 0; f < _dataKeys.length; f++) {
+      if (present & (1 << f) == 0) continue;
+      final value = bytes.getFloat64(base + _offValues + f * 8, Endian.little);
+      if (f == _dataCs || f == _dataTs) {
+        map[_dataKeys[f]] = value.toInt();
+      } else if (f == _dataCalibrated) {
+        map[_dataKeys[f]] = value != 0;
+      } else {
+        map[_dataKeys[f]] = value;
+      }
+    }
+    return map;
+  }
+
+  NativeStatus _readStatus(ByteData bytes, int base, String device) {
+    final present = bytes.getUint32(base + _offPresent, Endian.little);
+    int? field(int f) => present & (1 << f) != 0
+        ? bytes.getFloat64(base + _offValues + f * 8, Endian.little).toInt()
+        : null;
+    final mode = field(4);
+    return NativeStatus(
+      device,
+      field(0),
+      field(1),
+      field(2),
+      field(3),
+      mode != null && mode >= 0 && mode < _modeNames.length
+          ? _modeNames[mode]
+          : null,
+    );
+  }
+
+  void _onFrameTimings(List<FrameTiming> timings) {
+    for (final t in timings) {
+      final build = t.buildDuration.inMicroseconds;
+      final raster = t.rasterDuration.inMicroseconds;
+      _frames++;
+      if (build + raster > 16667) _slowFrames++;
+      if (build > _maxBuildMicros) _maxBuildMicros = build;
+      if (raster > _maxRasterMicros) _maxRasterMicros = raster;
+    }
+  }
+
+  /// Métricas de la ingesta: las del runner (mensajes, coalescencia, decodificación, espera
+  /// hasta el lote) más las del lado Dart (lectura de lotes y tiempos de cuadro)
+  Future<Map<String, dynamic>> stats() async {
+    Map<String, dynamic> native = {};
+    try {
+      final result = await _channel.invokeMapMethod<String, dynamic>('getStats');
+      native = result ?? {};
+    } catch (e) {
+      _log('Error leyendo métricas nativas: $e');
+    }
+    return {
+      ...native,
+      'dartBatches': _batches,
+      'dartRecords': _records,
+      'dartMessages': _messages,
+      'dartDroppedEvents': _droppedEvents,
+      'drainAvgUs': _batches > 0 ? _drainMicros ~/ _batches : 0,
+      'drainMaxUs': _maxDrainMicros,
+      'frames': _frames,
+      'slowFrames': _slowFrames,
+      'maxBuildUs': _maxBuildMicros,
+      'maxRasterUs': _maxRasterMicros,
+    };
+  }
+}
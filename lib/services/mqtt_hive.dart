@@ -54,6 +54,56 @@ class MqttHiveService {
     return last?.cast<String, dynamic>();
   }
 
+  /// Convierte un JSON del AWG ya decodificado (claves abreviadas) al formato de la app.
+  /// Lo usan parseAwgJson y la ingesta nativa de Linux, que entrega los campos ya decodificados.
+  static Map<String, dynamic> mapAwgJson(Map<String, dynamic> jsonData,
+      {String source = "MQTT"}) {
+    return {
+      // === DATOS PRINCIPALES ===
+      'temperaturaAmbiente': jsonData['t'] ?? 0.0, // t = temperatura ambiente
+      'presionAtmosferica': jsonData['p'] ?? 0.0, // p = presión atmosférica
+      'humedadRelativa':
+          jsonData['h'] ?? 0.0, // h = humedad relativa ambiente
+      'aguaAlmacenada': double.tryParse(jsonData['w']?.toString() ?? '0.0') ??
+          0.0, // w = agua almacenada
+      'tasaProduccion': double.tryParse(jsonData['wr']?.toString() ?? '') ??
+          0.0, // wr = tasa de producción filtrada (L/h)
+      'incertidumbreAgua': double.tryParse(jsonData['wu']?.toString() ?? '') ??
+          0.0, // wu = incertidumbre del volumen (L)
+      'tank_capacity':
+          double.tryParse(jsonData['tank_capacity']?.toString() ?? '0.0') ??
+              0.0, // capacidad del tanque
+
+      // === SENSORES ADICIONALES ===
+      'sht1Temp': jsonData['te'] ?? 0.0, // te = temperatura evaporador
+      'sht1Hum': jsonData['he'] ?? 0.0, // he = humedad evaporador
+      'compressorTemp': jsonData['tc'] ?? 0.0, // tc = temperatura compresor
+
+      // === CÁLCULOS DERIVADOS ===
+      'puntoRocio': jsonData['dp'] ?? 0.0, // dp = punto de rocío
+      'humedadAbsoluta': jsonData['ha'] ?? 0.0, // ha = humedad absoluta
+
+      // === DATOS ELÉCTRICOS ===
+      'voltaje': jsonData['v'] ?? 0.0, // v = voltaje
+      'corriente': jsonData['c'] ?? 0.0, // c = corriente
+      'potencia': jsonData['po'] ?? 0.0, // po = potencia
+      'energia': jsonData['e'] ?? 0.0, // e = energia en kWh
+
+      // === ESTADO DEL COMPRESOR ===
+      'estadoCompresor':
+          jsonData['cs'] ?? 0, // cs = estado compresor (0=OFF, 1=ON)
+
+      // === ESTADO DE CALIBRACIÓN ===
+      'calibrated': jsonData['calibrated'] ??
+          false, // calibrated = estado de calibración
+
+      // === TIMESTAMP ===
+      'datetime': jsonData['ts']?.toString() ?? '', // ts = timestamp unix
+      'timestamp': DateTime.now().millisecondsSinceEpoch,
+      'source': source,
+    };
+  }
+
   /// Parsea datos JSON del AWG ESP32 a un mapa con claves semánticas.
   /// El parámetro "source" indica el origen ("MQTT" o "BLE").
   static Map<String, dynamic> parseAwgJson(String jsonString,
@@ -76,46 +126,7 @@ class MqttHiveService {
       }
 
       // Mapear datos del AWG ESP32 (nombres abreviados) al formato esperado por la app
-      final parsedData = {
-        // === DATOS PRINCIPALES ===
-        'temperaturaAmbiente': jsonData['t'] ?? 0.0, // t = temperatura ambiente
-        'presionAtmosferica': jsonData['p'] ?? 0.0, // p = presión atmosférica
-        'humedadRelativa':
-            jsonData['h'] ?? 0.0, // h = humedad relativa ambiente
-        'aguaAlmacenada': double.tryParse(jsonData['w']?.toString() ?? '0.0') ??
-            0.0, // w = agua almacenada
-        'tank_capacity':
-            double.tryParse(jsonData['tank_capacity']?.toString() ?? '0.0') ??
-                0.0, // capacidad del tanque
-
-        // === SENSORES ADICIONALES ===
-        'sht1Temp': jsonData['te'] ?? 0.0, // te = temperatura evaporador
-        'sht1Hum': jsonData['he'] ?? 0.0, // he = humedad evaporador
-        'compressorTemp': jsonData['tc'] ?? 0.0, // tc = temperatura compresor
-
-        // === CÁLCULOS DERIVADOS ===
-        'puntoRocio': jsonData['dp'] ?? 0.0, // dp = punto de rocío
-        'humedadAbsoluta': jsonData['ha'] ?? 0.0, // ha = humedad absoluta
-
-        // === DATOS ELÉCTRICOS ===
-        'voltaje': jsonData['v'] ?? 0.0, // v = voltaje
-        'corriente': jsonData['c'] ?? 0.0, // c = corriente
-        'potencia': jsonData['po'] ?? 0.0, // po = potencia
-        'energia': jsonData['e'] ?? 0.0, // e = energia en kWh
-
-        // === ESTADO DEL COMPRESOR ===
-        'estadoCompresor':
-            jsonData['cs'] ?? 0, // cs = estado compresor (0=OFF, 1=ON)
-
-        // === ESTADO DE CALIBRACIÓN ===
-        'calibrated': jsonData['calibrated'] ??
-            false, // calibrated = estado de calibración
-
-        // === TIMESTAMP ===
-        'datetime': jsonData['ts']?.toString() ?? '', // ts = timestamp unix
-        'timestamp': DateTime.now().millisecondsSinceEpoch,
-        'source': source,
-      };
+      final parsedData = mapAwgJson(jsonData, source: source);
 
       // Verificar que energia se mapeó correctamente
       final energiaValue = parsedData['energia'];
@@ -315,6 +326,24 @@ class MqttHiveService {
     debugPrint('[MQTT DEBUG] ===== FIN PROCESAMIENTO DATOS =====');
   }
 
+  /// Guarda un lote de la ingesta nativa (un registro por dispositivo, claves abreviadas)
+  /// y actualiza el notifier una sola vez por lote en lugar de una vez por mensaje.
+  void onNativeDataBatch(List<Map<String, dynamic>> batch) {
+    if (batch.isEmpty) return;
+    var merged = <String, dynamic>{};
+    for (final raw in batch) {
+      final data = mapAwgJson(raw, source: "MQTT");
+      if (isSavingEnabled() && dataBox != null) {
+        dataBox!.add(data);
+      }
+      merged = {...merged, ...data};
+    }
+    SingletonMqttService().notifier.value = {
+      ...SingletonMqttService().notifier.value,
+      ...merged,
+    };
+  }
+
   /// Obtener estado del compresor (0=OFF, 1=ON)
   int getCompressorState() {
     return SingletonMqttService().notifier.value['estadoCompresor'] ?? 0;
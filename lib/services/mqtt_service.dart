@@ -7,6 +7,7 @@ import 'package:mqtt_client/mqtt_client.dart';
 import 'package:mqtt_client/mqtt_server_client.dart';
 import 'package:hive_flutter/hive_flutter.dart';
 import 'mqtt_hive.dart';
+import 'mqtt/native_mqtt_ingest.dart';
 import 'notification_service.dart';
 import 'singleton_mqtt_service.dart';
 import 'package:flutter_secure_storage/flutter_secure_storage.dart';
@@ -29,6 +30,8 @@ class MqttService {
   final FlutterSecureStorage _secureStorage = FlutterSecureStorage();
 
   MqttServerClient? client;
+  // En Linux, datos, estado y alertas llegan por la ingesta nativa del runner
+  final NativeMqttIngest _nativeIngest = NativeMqttIngest();
   Timer? _reconnectTimer;
   Timer? _connectionCheckTimer;
   Timer? _pingTimer;
@@ -60,6 +63,26 @@ class MqttService {
   Stream<Map<String, dynamic>> get pumpErrorStream =>
       _pumpErrorController.stream;
 
+  // Confirmaciones de configuración recibidas por STATUS (las usa _waitForConfigAck
+  // cuando STATUS llega por la ingesta nativa y no por el cliente Dart)
+  final StreamController<Map<String, dynamic>> _configAckController =
+      StreamController<Map<String, dynamic>>.broadcast();
+
+  /// Equipos que anuncian presencia retenida en dropster/<id>/presence (id -> online). El
+  /// firmware actual publica en dropster/<id>/...; con este listado la app ofrece el id en
+  /// vez de exigir que el usuario escriba el tópico (ver followDevice)
+  final ValueNotifier<Map<String, bool>> discoveredDevices = ValueNotifier({});
+  static final RegExp _presenceTopic = RegExp(r'^dropster/([^/]+)/presence$');
+
+  /// Tópico de datos de un equipo con tópicos por equipo
+  static String deviceDataTopic(String deviceId) => 'dropster/$deviceId/data';
+
+  /// Id del equipo que sigue la app, o null con el tópico plano de versiones anteriores
+  String? get followedDeviceId {
+    final parts = topic.split('/');
+    return parts.length == 3 && parts[2] == 'data' ? parts[1] : null;
+  }
+
   /// Función helper para logs condicionales (solo en debug mode)
   void _log(String message) {
     if (kDebugMode) {
@@ -506,7 +529,7 @@ class MqttService {
       final clientId = 'dropster_${DateTime.now().millisecondsSinceEpoch}';
       client!.connectionMessage = MqttConnectMessage()
           .withClientIdentifier(clientId)
-          .withWillTopic('dropster/system')
+          .withWillTopic(_siblingTopic('system'))
           .withWillMessage('ESP32_AWG_OFFLINE')
           .withWillQos(MqttQos.atLeastOnce)
           .startClean();
@@ -547,6 +570,9 @@ class MqttService {
           '[MQTT DEBUG] ✅ Conexión exitosa al broker $brokerAddress:$brokerPort');
       debugPrint('[MQTT DEBUG] 📡 Client ID: $clientId');
 
+      // En Linux la recepción de alto volumen pasa al runner (si el plugin está disponible)
+      await _startNativeIngest(brokerAddress, brokerPort, hiveService);
+
       // Configurar listener siempre, pero solo procesar datos si hay hiveService
       _setupMessageListener(hiveService);
 
@@ -592,6 +618,15 @@ class MqttService {
       _log('Mensaje recibido en tópico $topicReceived');
 
       try {
+        // Presencia de cualquier equipo del broker: alimenta el listado de equipos
+        final presence = _presenceTopic.firstMatch(topicReceived);
+        if (presence != null) {
+          discoveredDevices.value = {
+            ...discoveredDevices.value,
+            presence.group(1)!: payload.trim() == 'online',
+          };
+        }
+
         // Si el mensaje es del tópico esperado (datos)
         if (topicReceived == topic) {
           debugPrint(
@@ -612,163 +647,9 @@ class MqttService {
           }
         }
         // Si el mensaje viene por el tópico de estado, procesar modo/estado
-        else if (topicReceived == 'dropster/status') {
+        else if (topicReceived == _siblingTopic('status')) {
           debugPrint('[MQTT DEBUG] Mensaje de STATUS recibido: $payload');
-
-          // Procesar confirmación de configuración
-          if (payload.contains('"type":"config_ack"')) {
-            try {
-              final jsonData = jsonDecode(payload);
-              if (jsonData is Map<String, dynamic> &&
-                  jsonData['type'] == 'config_ack') {
-                debugPrint(
-                    '[MQTT CONFIG] ✅ Confirmación de configuración recibida por STATUS: ${jsonData['changes']} cambios aplicados');
-                debugPrint('[MQTT CONFIG] 📊 Estado: ${jsonData['status']}');
-                debugPrint(
-                    '[MQTT CONFIG] ⏱️  Timestamp: ${jsonData['timestamp']}');
-                debugPrint(
-                    '[MQTT CONFIG] 🔋 Uptime ESP32: ${jsonData['uptime']} segundos');
-                // Siempre marcar como config_saved=true independientemente de si hay cambios o no
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'config_saved': true,
-                  'config_ack_data': jsonData,
-                };
-              }
-            } catch (e) {
-              debugPrint(
-                  '[MQTT DEBUG] Error procesando confirmación de configuración: $e');
-            }
-          }
-          // Procesar heartbeat del ESP32 (system_status)
-          else if (payload.contains('"type":"system_status"')) {
-            try {
-              final jsonData = jsonDecode(payload);
-              if (jsonData is Map<String, dynamic> &&
-                  jsonData['type'] == 'system_status') {
-                debugPrint(
-                    '[MQTT HEARTBEAT] 💓 Heartbeat recibido del dispositivo - uptime: ${jsonData['uptime']}');
-                // Marcar dispositivo como online
-                SingletonMqttService().deviceConnectionNotifier.value = true;
-              }
-            } catch (e) {
-              debugPrint('[MQTT DEBUG] Error procesando heartbeat: $e');
-            }
-          } else {
-            try {
-              final Map<String, dynamic> json = jsonDecode(payload);
-
-              // Procesar errores de bomba
-              if (json.containsKey('type') && json['type'] == 'pump_error') {
-                debugPrint('[MQTT DEBUG] Error de bomba recibido: $json');
-                _pumpErrorController.add(json);
-                return; // No procesar otros campos para este mensaje
-              }
-
-              if (json.containsKey('mode')) {
-                final String mode = json['mode'].toString();
-                debugPrint('[MQTT DEBUG] Modo recibido: $mode');
-                _modeController.add(mode);
-                // Actualizar notifier con el modo
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'mode': mode,
-                };
-              }
-              // Procesar estados individuales de relés si están en JSON
-              if (json.containsKey('compressor')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cs': json['compressor'],
-                };
-              }
-              if (json.containsKey('ventilador')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'vs': json['ventilador'],
-                };
-              }
-              if (json.containsKey('pump')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'ps': json['pump'],
-                };
-              }
-              if (json.containsKey('compressor_fan')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cfs': json['compressor_fan'] ?? 0,
-                };
-              }
-            } catch (e) {
-              // Si no es JSON, aceptar payloads simples como "MODE_AUTO" o "MODE_MANUAL"
-              if (payload.contains('MODE_AUTO')) {
-                _modeController.add('AUTO');
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'mode': 'AUTO',
-                };
-              } else if (payload.contains('MODE_MANUAL')) {
-                _modeController.add('MANUAL');
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'mode': 'MANUAL',
-                };
-              }
-              // Procesar estados individuales de relés
-              else if (payload.contains('COMP_ON')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cs': 1,
-                };
-              } else if (payload.contains('COMP_OFF')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cs': 0,
-                };
-              } else if (payload.contains('VENT_ON')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'vs': 1,
-                };
-              } else if (payload.contains('VENT_OFF')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'vs': 0,
-                };
-              } else if (payload.contains('PUMP_ON')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'ps': 1,
-                };
-              } else if (payload.contains('PUMP_OFF')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'ps': 0,
-                };
-              } else if (payload.contains('CFAN_ON')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cfs': 1,
-                };
-              } else if (payload.contains('CFAN_OFF')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cfs': 0,
-                };
-              } else if (payload.contains('AUTO_COMP_ON')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cs': 1,
-                };
-              } else if (payload.contains('AUTO_COMP_OFF')) {
-                SingletonMqttService().notifier.value = {
-                  ...SingletonMqttService().notifier.value,
-                  'cs': 0,
-                };
-              }
-            }
-          }
+          _handleStatusPayload(payload);
         }
         // Si el mensaje viene por el tópico de alertas, procesar alertas
         else if (topicReceived.contains('/alerts')) {
@@ -781,7 +662,7 @@ class MqttService {
           _processErrorData(payload);
         }
         // Si el mensaje viene por el tópico de sistema, procesar estado del sistema
-        else if (topicReceived == 'dropster/system') {
+        else if (topicReceived == _siblingTopic('system')) {
           debugPrint('[MQTT SYSTEM] Mensaje de SISTEMA recibido: $payload');
 
           // Procesar backup de configuración desde SYSTEM
@@ -803,38 +684,234 @@ class MqttService {
           } else {
             _processSystemData(payload);
           }
-        } else {
+        }
+        // Presencia del equipo (tópicos por dispositivo): retenido, "offline" es su last will
+        else if (topicReceived == _siblingTopic('presence')) {
+          debugPrint('[MQTT SYSTEM] Presencia del dispositivo: $payload');
+          SingletonMqttService().deviceConnectionNotifier.value =
+              payload.trim() == 'online';
+        } else if (presence == null) {
           debugPrint(
-              '[MQTT DEBUG] Mensaje ignorado - tópico: $topicReceived, esperado: $topic, dropster/status, dropster/alerts, dropster/errors o dropster/system');
+              '[MQTT DEBUG] Mensaje ignorado - tópico: $topicReceived, esperado: $topic y sus tópicos hermanos');
         }
       } catch (e) {
         debugPrint('[MQTT DEBUG] Error procesando mensaje MQTT: $e');
       }
     });
 
-    // Se suscribe al tópico de datos de energía con QoS 1 (atLeastOnce) para mayor fiabilidad
-    // Nota: Ya se suscribió arriba, aquí solo se registra el log
-    debugPrint('[MQTT DEBUG] Suscrito al tópico $topic (QoS 1)');
-
-    // Suscribirse al tópico de datos (principal)
-    client!.subscribe(topic, MqttQos.atLeastOnce);
-    debugPrint('[MQTT DEBUG] Suscrito al tópico $topic (QoS 1)');
+    // Datos, estado y alertas: los atiende el runner si la ingesta nativa está activa
+    if (_nativeIngest.isActive) {
+      debugPrint(
+          '[MQTT DEBUG] Datos, estado y alertas por ingesta nativa; Dart solo atiende errores y sistema');
+    } else {
+      // Suscribirse al tópico de datos (principal) con QoS 1 (atLeastOnce) para mayor fiabilidad
+      client!.subscribe(topic, MqttQos.atLeastOnce);
+      debugPrint('[MQTT DEBUG] Suscrito al tópico $topic (QoS 1)');
 
-    // Suscribirse al tópico de estado para recibir modo y otros estados
-    client!.subscribe('dropster/status', MqttQos.atLeastOnce);
-    debugPrint('[MQTT DEBUG] Suscrito al tópico dropster/status (QoS 1)');
+      // Suscribirse al tópico de estado para recibir modo y otros estados
+      client!.subscribe(_siblingTopic('status'), MqttQos.atLeastOnce);
+      debugPrint(
+          '[MQTT DEBUG] Suscrito al tópico ${_siblingTopic('status')} (QoS 1)');
 
-    // Suscribirse al tópico de alertas para recibir alertas del ESP32
-    client!.subscribe('dropster/alerts', MqttQos.atLeastOnce);
-    debugPrint('[MQTT DEBUG] Suscrito al tópico dropster/alerts (QoS 1)');
+      // Suscribirse al tópico de alertas para recibir alertas del ESP32
+      client!.subscribe(_siblingTopic('alerts'), MqttQos.atLeastOnce);
+      debugPrint(
+          '[MQTT DEBUG] Suscrito al tópico ${_siblingTopic('alerts')} (QoS 1)');
+    }
 
     // Suscribirse al tópico de errores para recibir mensajes de error del ESP32
-    client!.subscribe('dropster/errors', MqttQos.atLeastOnce);
-    debugPrint('[MQTT DEBUG] Suscrito al tópico dropster/errors (QoS 1)');
+    client!.subscribe(_siblingTopic('errors'), MqttQos.atLeastOnce);
+    debugPrint(
+        '[MQTT DEBUG] Suscrito al tópico ${_siblingTopic('errors')} (QoS 1)');
 
     // Suscribirse al tópico de sistema para recibir estado general y backups del ESP32
-    client!.subscribe('dropster/system', MqttQos.atLeastOnce);
-    debugPrint('[MQTT DEBUG] Suscrito al tópico dropster/system (QoS 1)');
+    client!.subscribe(_siblingTopic('system'), MqttQos.atLeastOnce);
+    debugPrint(
+        '[MQTT DEBUG] Suscrito al tópico ${_siblingTopic('system')} (QoS 1)');
+
+    // Presencia retenida de todos los equipos (incluye la del seguido); los equipos en
+    // tópicos planos (legacy) no la publican
+    client!.subscribe('dropster/+/presence', MqttQos.atLeastOnce);
+  }
+
+  /// Sigue a otro equipo: guarda dropster/<id>/data como tópico de datos y reconecta
+  Future<void> followDevice(
+      String deviceId, MqttHiveService? hiveService) async {
+    if (!Hive.isBoxOpen('settings')) {
+      await Hive.openBox('settings');
+    }
+    await Hive.box('settings').put('mqttTopic', deviceDataTopic(deviceId));
+    debugPrint('[MQTT DEBUG] Siguiendo al equipo $deviceId');
+    await reconnectWithNewConfig(hiveService);
+  }
+
+  /// Tópico hermano del tópico de datos configurado: con "dropster/<id>/data" devuelve
+  /// "dropster/<id>/<leaf>" y con el tópico plano de versiones anteriores ("dropster/data"),
+  /// "dropster/<leaf>". Así la app sigue a un solo equipo aunque compartan broker.
+  String _siblingTopic(String leaf) {
+    final slash = topic.lastIndexOf('/');
+    final base = slash > 0 ? topic.substring(0, slash) : 'dropster';
+    return '$base/$leaf';
+  }
+
+  /// Procesa un mensaje de dropster/status: confirmaciones de configuración, heartbeat,
+  /// errores de bomba, modo y estados de relés (JSON o mensajes simples)
+  void _handleStatusPayload(String payload) {
+    // Procesar confirmación de configuración
+    if (payload.contains('"type":"config_ack"')) {
+      try {
+        final jsonData = jsonDecode(payload);
+        if (jsonData is Map<String, dynamic> &&
+            jsonData['type'] == 'config_ack') {
+          debugPrint(
+              '[MQTT CONFIG] ✅ Confirmación de configuración recibida por STATUS: ${jsonData['changes']} cambios aplicados');
+          debugPrint('[MQTT CONFIG] 📊 Estado: ${jsonData['status']}');
+          debugPrint(
+              '[MQTT CONFIG] ⏱️  Timestamp: ${jsonData['timestamp']}');
+          debugPrint(
+              '[MQTT CONFIG] 🔋 Uptime ESP32: ${jsonData['uptime']} segundos');
+          // Siempre marcar como config_saved=true independientemente de si hay cambios o no
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'config_saved': true,
+            'config_ack_data': jsonData,
+          };
+          _configAckController.add(jsonData);
+        }
+      } catch (e) {
+        debugPrint(
+            '[MQTT DEBUG] Error procesando confirmación de configuración: $e');
+      }
+    }
+    // Procesar heartbeat del ESP32 (system_status)
+    else if (payload.contains('"type":"system_status"')) {
+      try {
+        final jsonData = jsonDecode(payload);
+        if (jsonData is Map<String, dynamic> &&
+            jsonData['type'] == 'system_status') {
+          debugPrint(
+              '[MQTT HEARTBEAT] 💓 Heartbeat recibido del dispositivo - uptime: ${jsonData['uptime']}');
+          // Marcar dispositivo como online
+          SingletonMqttService().deviceConnectionNotifier.value = true;
+        }
+      } catch (e) {
+        debugPrint('[MQTT DEBUG] Error procesando heartbeat: $e');
+      }
+    } else {
+      try {
+        final Map<String, dynamic> json = jsonDecode(payload);
+
+        // Procesar errores de bomba
+        if (json.containsKey('type') && json['type'] == 'pump_error') {
+          debugPrint('[MQTT DEBUG] Error de bomba recibido: $json');
+          _pumpErrorController.add(json);
+          return; // No procesar otros campos para este mensaje
+        }
+
+        if (json.containsKey('mode')) {
+          final String mode = json['mode'].toString();
+          debugPrint('[MQTT DEBUG] Modo recibido: $mode');
+          _modeController.add(mode);
+          // Actualizar notifier con el modo
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'mode': mode,
+          };
+        }
+        // Procesar estados individuales de relés si están en JSON
+        if (json.containsKey('compressor')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cs': json['compressor'],
+          };
+        }
+        if (json.containsKey('ventilador')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'vs': json['ventilador'],
+          };
+        }
+        if (json.containsKey('pump')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'ps': json['pump'],
+          };
+        }
+        if (json.containsKey('compressor_fan')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cfs': json['compressor_fan'] ?? 0,
+          };
+        }
+      } catch (e) {
+        // Si no es JSON, aceptar payloads simples como "MODE_AUTO" o "MODE_MANUAL"
+        if (payload.contains('MODE_AUTO')) {
+          _modeController.add('AUTO');
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'mode': 'AUTO',
+          };
+        } else if (payload.contains('MODE_MANUAL')) {
+          _modeController.add('MANUAL');
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'mode': 'MANUAL',
+          };
+        }
+        // Procesar estados individuales de relés
+        else if (payload.contains('COMP_ON')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cs': 1,
+          };
+        } else if (payload.contains('COMP_OFF')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cs': 0,
+          };
+        } else if (payload.contains('VENT_ON')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'vs': 1,
+          };
+        } else if (payload.contains('VENT_OFF')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'vs': 0,
+          };
+        } else if (payload.contains('PUMP_ON')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'ps': 1,
+          };
+        } else if (payload.contains('PUMP_OFF')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'ps': 0,
+          };
+        } else if (payload.contains('CFAN_ON')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cfs': 1,
+          };
+        } else if (payload.contains('CFAN_OFF')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cfs': 0,
+          };
+        } else if (payload.contains('AUTO_COMP_ON')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cs': 1,
+          };
+        } else if (payload.contains('AUTO_COMP_OFF')) {
+          SingletonMqttService().notifier.value = {
+            ...SingletonMqttService().notifier.value,
+            'cs': 0,
+          };
+        }
+      }
+    }
   }
 
   /// Publica un comando al tópico de control del ESP32
@@ -843,7 +920,7 @@ class MqttService {
       try {
         final builder = MqttClientPayloadBuilder();
         builder.addString(command);
-        client!.publishMessage('dropster/control', MqttQos.atLeastOnce,
+        client!.publishMessage(_siblingTopic('control'), MqttQos.atLeastOnce,
             builder.payload!); // Topic corregido, usar QoS 1 para fiabilidad
         debugPrint('[MQTT DEBUG] Comando enviado: $command');
       } catch (e) {
@@ -980,7 +1057,7 @@ class MqttService {
         final builder1 = MqttClientPayloadBuilder();
         builder1.addString(part1);
         client!.publishMessage(
-            'dropster/control', MqttQos.atLeastOnce, builder1.payload!);
+            _siblingTopic('control'), MqttQos.atLeastOnce, builder1.payload!);
 
         await Future.delayed(const Duration(milliseconds: 300));
 
@@ -992,7 +1069,7 @@ class MqttService {
         final builder2 = MqttClientPayloadBuilder();
         builder2.addString(part2);
         client!.publishMessage(
-            'dropster/control', MqttQos.atLeastOnce, builder2.payload!);
+            _siblingTopic('control'), MqttQos.atLeastOnce, builder2.payload!);
 
         await Future.delayed(const Duration(milliseconds: 300));
 
@@ -1004,7 +1081,7 @@ class MqttService {
         final builder3 = MqttClientPayloadBuilder();
         builder3.addString(part3);
         client!.publishMessage(
-            'dropster/control', MqttQos.atLeastOnce, builder3.payload!);
+            _siblingTopic('control'), MqttQos.atLeastOnce, builder3.payload!);
 
         await Future.delayed(const Duration(milliseconds: 300));
 
@@ -1016,7 +1093,7 @@ class MqttService {
         final builder4 = MqttClientPayloadBuilder();
         builder4.addString(part4);
         client!.publishMessage(
-            'dropster/control', MqttQos.atLeastOnce, builder4.payload!);
+            _siblingTopic('control'), MqttQos.atLeastOnce, builder4.payload!);
 
         await Future.delayed(const Duration(milliseconds: 300));
 
@@ -1027,7 +1104,7 @@ class MqttService {
         final builderFinal = MqttClientPayloadBuilder();
         builderFinal.addString(finalCmd);
         client!.publishMessage(
-            'dropster/control', MqttQos.atLeastOnce, builderFinal.payload!);
+            _siblingTopic('control'), MqttQos.atLeastOnce, builderFinal.payload!);
 
         debugPrint(
             '[MQTT CONFIG] ✅ Configuración enviada al ESP32 (intento $attempt). Esperando confirmación...');
@@ -1063,6 +1140,17 @@ class MqttService {
 
   /// Espera confirmación de configuración del ESP32
   Future<bool> _waitForConfigAck(Duration timeout) async {
+    // Con ingesta nativa el cliente Dart no está suscrito a STATUS
+    if (_nativeIngest.isActive) {
+      return _configAckController.stream
+          .firstWhere((ack) => ack['status'] == 'success')
+          .then((_) => true)
+          .timeout(timeout, onTimeout: () {
+        debugPrint('[MQTT CONFIG] ⏰ Timeout esperando confirmación del ESP32');
+        return false;
+      });
+    }
+
     final completer = Completer<bool>();
     Timer? timer;
 
@@ -1073,7 +1161,7 @@ class MqttService {
         .listen((List<MqttReceivedMessage<MqttMessage>> messages) {
       for (final message in messages) {
         final topic = message.topic;
-        if (topic == 'dropster/status') {
+        if (topic == _siblingTopic('status')) {
           // Esperar confirmación en STATUS (donde el ESP32 envía confirmaciones)
           final payload = MqttPublishPayload.bytesToStringAsString(
               (message.payload as MqttPublishMessage).payload.message);
@@ -1109,10 +1197,72 @@ class MqttService {
 
   /// Desconecta el cliente del broker MQTT y limpia el objeto cliente.
   void disconnect() {
+    _nativeIngest.stop();
     client?.disconnect();
     client = null;
   }
 
+  /// Inicia la ingesta nativa (solo Linux) y conecta sus lotes con Hive, el notifier y
+  /// las notificaciones. Si el plugin no está disponible se sigue con el cliente Dart
+  Future<void> _startNativeIngest(String brokerAddress, int brokerPort,
+      MqttHiveService? hiveService) async {
+    if (!NativeMqttIngest.isSupported) return;
+
+    _nativeIngest.onData = (batch) {
+      _lastMessageTime = DateTime.now();
+      if (hiveService == null) return;
+      hiveService.onNativeDataBatch(batch);
+      for (final raw in batch) {
+        NotificationService().processSensorData(raw);
+      }
+    };
+    _nativeIngest.onStatus = (batch) {
+      _lastMessageTime = DateTime.now();
+      final updates = <String, dynamic>{};
+      for (final status in batch) {
+        if (status.mode != null) {
+          updates['mode'] = status.mode;
+          _modeController.add(status.mode!);
+        }
+        if (status.compressor != null) updates['cs'] = status.compressor;
+        if (status.ventilador != null) updates['vs'] = status.ventilador;
+        if (status.pump != null) updates['ps'] = status.pump;
+        if (status.compressorFan != null) updates['cfs'] = status.compressorFan;
+      }
+      if (updates.isNotEmpty) {
+        SingletonMqttService().notifier.value = {
+          ...SingletonMqttService().notifier.value,
+          ...updates,
+        };
+      }
+    };
+    _nativeIngest.onEvent = (topicKind, device, payload) {
+      _lastMessageTime = DateTime.now();
+      if (topicKind == NativeMqttIngest.topicAlerts) {
+        _processAlertData(payload);
+      } else if (topicKind == NativeMqttIngest.topicStatus) {
+        _handleStatusPayload(payload);
+      }
+    };
+
+    final started = await _nativeIngest.start(
+      broker: brokerAddress,
+      port: brokerPort,
+      dataTopic: topic,
+      user: mqttUser,
+      password: mqttPass,
+      useTls: useTls,
+    );
+    debugPrint(
+        '[MQTT DEBUG] Ingesta nativa: ${started ? 'activa' : 'no disponible, se usa el cliente Dart'}');
+  }
+
+  /// Métricas de la ingesta nativa (vacío si no está activa)
+  Future<Map<String, dynamic>> getNativeIngestStats() async {
+    if (!_nativeIngest.isActive) return {};
+    return _nativeIngest.stats();
+  }
+
   /// Procesa los datos MQTT para activar notificaciones
   void _processNotificationData(String payload) {
     try {
@@ -1180,6 +1330,7 @@ class MqttService {
       'broker': broker,
       'port': port,
       'topic': topic,
+      'nativeIngest': _nativeIngest.isActive,
     };
   }
 
@@ -80,6 +80,12 @@ class SingletonMqttService {
     });
   }
 
+  /// Sigue al equipo `deviceId` (descubierto por su presencia) y reconecta
+  Future<void> followDevice(String deviceId) async {
+    await mqttClientService.followDevice(deviceId, mqttService);
+    connectionNotifier.value = mqttClientService.isConnected;
+  }
+
   /// Desconecta del broker MQTT
   Future<void> disconnect() async {
     mqttClientService.stopConnectionMonitoring();
@@ -0,0 +1,237 @@
+#ifndef RUNNER_MQTT_INGEST_BATCHER_H_
+#define RUNNER_MQTT_INGEST_BATCHER_H_
+
+// Coalescencia por dispositivo y por cuadro de los mensajes decodificados
+//
+// El hilo de red de mosquitto agrega registros; el hilo principal toma un lote por cuadro.
+// Datos y estado se combinan por dispositivo (los campos presentes en el mensaje nuevo
+// reemplazan a los anteriores y los ausentes se conservan, igual que el firmware omite los
+// sensores sin lectura). Con INGEST_MAX_DEVICES dispositivos pendientes los registros de un
+// dispositivo nuevo se descartan y se cuentan aparte (dropped_states). Los eventos (alertas, confirmaciones) se conservan todos y en orden,
+// hasta INGEST_MAX_EVENTS por lote.
+//
+// Formato del lote, leído por Dart sin copiar (Pointer.asTypedList):
+//   IngestBatchHeader | IngestRecord[record_count] | texto de los eventos
+// El puntero devuelto por Take() vale hasta la siguiente llamada a Take().
+//
+// Sin dependencias de GTK ni de mosquitto: puede probarse en host con varios hilos.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mqtt_ingest_decoder.h"
+
+#define INGEST_BATCH_MAGIC 0x42495244u  // "DRIB" en little endian
+#define INGEST_BATCH_VERSION 1
+#define INGEST_MAX_DEVICES 1024         // Dispositivos distintos por lote
+#define INGEST_MAX_EVENTS 256           // Eventos por lote (el resto se descarta y se cuenta)
+#define INGEST_MAX_EVENT_LEN 4096       // Eventos más largos se descartan
+
+struct IngestBatchHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t total_bytes;
+  uint32_t record_count;
+  uint32_t messages;        // Mensajes MQTT incluidos en el lote
+  uint32_t dropped_events;  // Eventos descartados por desborde desde el lote anterior
+  uint32_t sequence;        // Número de lote
+  uint32_t reserved;
+};
+
+static_assert(sizeof(IngestBatchHeader) == 32, "IngestBatchHeader cambió: actualizar el lector en Dart");
+
+// Estadísticas acumuladas desde Start() (lectura desde el hilo principal)
+struct IngestStats {
+  uint64_t messages = 0;        // Mensajes recibidos
+  uint64_t decode_errors = 0;   // Payloads de datos no decodificables
+  uint64_t coalesced = 0;       // Mensajes absorbidos por otro del mismo dispositivo
+  uint64_t dropped_states = 0;  // Datos/estado descartados con la tabla de dispositivos llena
+  uint64_t events = 0;          // Eventos entregados
+  uint64_t dropped_events = 0;  // Eventos descartados por desborde
+  uint64_t batches = 0;         // Lotes entregados
+  uint64_t decode_ns = 0;       // Tiempo total de decodificación
+  uint32_t max_records = 0;     // Registros en el lote más grande
+  uint64_t take_ns = 0;         // Tiempo total armando lotes (hilo principal)
+  uint32_t max_take_ns = 0;
+  uint64_t age_us = 0;          // Suma de la espera del mensaje más antiguo de cada lote
+  uint32_t max_age_us = 0;
+};
+
+class IngestBatcher {
+ public:
+  IngestBatcher() { Reset(); }
+
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    events_.clear();
+    text_.clear();
+    slots_.clear();
+    pending_messages_ = 0;
+    pending_dropped_ = 0;
+    sequence_ = 0;
+    stats_ = IngestStats();
+  }
+
+  // Agrega un registro de datos o estado ya decodificado. Devuelve true si el lote estaba
+  // vacío (quien llama debe programar la entrega al hilo principal)
+  bool AddState(const IngestRecord& rec, uint64_t decode_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool was_empty = IsEmptyLocked();
+    if (was_empty) first_ = std::chrono::steady_clock::now();
+    pending_messages_++;
+    stats_.messages++;
+    stats_.decode_ns += decode_ns;
+    std::string key(rec.device);
+    key.push_back((char)rec.kind);
+    auto it = slots_.find(key);
+    if (it == slots_.end()) {
+      if (slots_.size() >= INGEST_MAX_DEVICES) {
+        stats_.dropped_states++;  // Sin lugar: se conserva lo ya pendiente
+        return was_empty;
+      }
+      slots_.emplace(key, pending_.size());
+      pending_.push_back(rec);
+      pending_.back().merged = 1;
+      return was_empty;
+    }
+    IngestRecord& dst = pending_[it->second];
+    for (uint8_t f = 0; f < INGEST_VALUE_COUNT; f++) {
+      if (rec.present & (1u << f)) dst.values[f] = rec.values[f];
+    }
+    dst.present |= rec.present;
+    dst.received_ms = rec.received_ms;
+    dst.merged++;
+    stats_.coalesced++;
+    return was_empty;
+  }
+
+  // Agrega un evento con su texto. Devuelve true si el lote estaba vacío
+  bool AddEvent(const char* device, IngestTopic topic, const char* text, size_t len, int64_t received_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool was_empty = IsEmptyLocked();
+    if (was_empty) first_ = std::chrono::steady_clock::now();
+    pending_messages_++;
+    stats_.messages++;
+    if (events_.size() >= INGEST_MAX_EVENTS || len > INGEST_MAX_EVENT_LEN) {
+      pending_dropped_++;
+      stats_.dropped_events++;
+      return was_empty;
+    }
+    IngestRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.kind = INGEST_KIND_EVENT;
+    rec.topic = topic;
+    rec.merged = 1;
+    rec.received_ms = received_ms;
+    IngestCopyDevice(rec.device, device, strlen(device));
+    rec.text_offset = (uint32_t)text_.size();  // Relativo a la zona de texto; Take() lo corrige
+    rec.text_len = (uint32_t)len;
+    text_.insert(text_.end(), text, text + len);
+    events_.push_back(rec);
+    stats_.events++;
+    return was_empty;
+  }
+
+  // Arma el lote con todo lo pendiente. Devuelve nullptr si no hay nada
+  const uint8_t* Take(uint32_t* size) {
+    auto start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (IsEmptyLocked()) {
+        if (size) *size = 0;
+        return nullptr;
+      }
+      // Intercambiar con los buffers de trabajo para soltar el candado cuanto antes
+      taken_.swap(pending_);
+      taken_events_.swap(events_);
+      taken_text_.swap(text_);
+      pending_.clear();
+      events_.clear();
+      text_.clear();
+      slots_.clear();
+      header_.magic = INGEST_BATCH_MAGIC;
+      header_.version = INGEST_BATCH_VERSION;
+      header_.record_size = (uint16_t)sizeof(IngestRecord);
+      header_.messages = pending_messages_;
+      header_.dropped_events = pending_dropped_;
+      header_.sequence = ++sequence_;
+      header_.reserved = 0;
+      pending_messages_ = 0;
+      pending_dropped_ = 0;
+      uint32_t age_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(start - first_).count();
+      stats_.age_us += age_us;
+      if (age_us > stats_.max_age_us) stats_.max_age_us = age_us;
+    }
+
+    uint32_t records = (uint32_t)(taken_.size() + taken_events_.size());
+    uint32_t text_start = (uint32_t)(sizeof(IngestBatchHeader) + records * sizeof(IngestRecord));
+    header_.record_count = records;
+    header_.total_bytes = text_start + (uint32_t)taken_text_.size();
+    batch_.resize(header_.total_bytes);
+    uint8_t* out = batch_.data();
+    memcpy(out, &header_, sizeof(header_));
+    out += sizeof(header_);
+    if (!taken_.empty()) {
+      memcpy(out, taken_.data(), taken_.size() * sizeof(IngestRecord));
+      out += taken_.size() * sizeof(IngestRecord);
+    }
+    for (IngestRecord& ev : taken_events_) {
+      ev.text_offset += text_start;
+      memcpy(out, &ev, sizeof(ev));
+      out += sizeof(ev);
+    }
+    if (!taken_text_.empty()) memcpy(out, taken_text_.data(), taken_text_.size());
+
+    uint32_t take_ns = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.batches++;
+    stats_.take_ns += take_ns;
+    if (take_ns > stats_.max_take_ns) stats_.max_take_ns = take_ns;
+    if (records > stats_.max_records) stats_.max_records = records;
+    if (size) *size = header_.total_bytes;
+    return batch_.data();
+  }
+
+  // Cuenta un payload que no se pudo decodificar
+  void CountDecodeError() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.messages++;
+    stats_.decode_errors++;
+  }
+
+  IngestStats stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  std::mutex mutex_;
+  // Lado del productor (protegido por mutex_)
+  std::vector<IngestRecord> pending_;
+  std::vector<IngestRecord> events_;
+  std::vector<char> text_;
+  std::unordered_map<std::string, size_t> slots_;  // dispositivo + tipo -> índice en pending_
+  uint32_t pending_messages_ = 0;
+  uint32_t pending_dropped_ = 0;
+  uint32_t sequence_ = 0;
+  std::chrono::steady_clock::time_point first_;  // Primer mensaje del lote pendiente
+  IngestStats stats_;
+  // Lado del consumidor (solo hilo principal)
+  std::vector<IngestRecord> taken_;
+  std::vector<IngestRecord> taken_events_;
+  std::vector<char> taken_text_;
+  std::vector<uint8_t> batch_;
+  IngestBatchHeader header_;
+
+  bool IsEmptyLocked() const { return pending_messages_ == 0; }
+};
+
+#endif  // RUNNER_MQTT_INGEST_BATCHER_H_
@@ -0,0 +1,424 @@
+#ifndef RUNNER_MQTT_INGEST_DECODER_H_
+#define RUNNER_MQTT_INGEST_DECODER_H_
+
+// Decodificación nativa de los mensajes MQTT del AWG para el runner de Linux
+//
+// Los payloads de dropster/data y dropster/status son objetos JSON planos con claves
+// abreviadas ("t", "h", "po"...) y valores numéricos o numéricos entre comillas (el
+// firmware serializa con floatToString2Decimals). En vez de construir un árbol JSON por
+// mensaje, se recorren los pares clave/valor una sola vez y se vuelcan a un registro de
+// tamaño fijo (IngestRecord) que Dart lee directamente desde memoria nativa.
+//
+// El número se interpreta a mano y no con strtod: GTK llama setlocale() y con una
+// configuración regional en español strtod esperaría coma decimal.
+//
+// Sin dependencias de GTK ni de mosquitto: puede probarse en host con payloads de ejemplo.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define INGEST_DEVICE_LEN 32     // Identificador de dispositivo (incluye el NUL)
+#define INGEST_DEFAULT_DEVICE "dropster"
+
+// Tipo de registro dentro de un lote
+enum IngestKind : uint8_t {
+  INGEST_KIND_DATA = 1,    // Último dato de sensores del dispositivo (coalescido)
+  INGEST_KIND_STATUS = 2,  // Estado de actuadores y modo (coalescido)
+  INGEST_KIND_EVENT = 3,   // Mensaje que no se coalesce: alertas, confirmaciones, errores
+};
+
+// Tópico de origen (últimos segmentos del tópico)
+enum IngestTopic : uint8_t {
+  INGEST_TOPIC_DATA = 0,
+  INGEST_TOPIC_STATUS,
+  INGEST_TOPIC_ALERTS,
+  INGEST_TOPIC_OTHER,
+};
+
+// Campos de dropster/data, en el orden de IngestRecord::values
+enum IngestDataField : uint8_t {
+  INGEST_DATA_T = 0,          // Temperatura ambiente
+  INGEST_DATA_H,              // Humedad relativa ambiente
+  INGEST_DATA_P,              // Presión atmosférica
+  INGEST_DATA_W,              // Agua almacenada
+  INGEST_DATA_WR,             // Tasa de producción
+  INGEST_DATA_WU,             // Incertidumbre del volumen
+  INGEST_DATA_TANK_CAPACITY,  // Capacidad del tanque
+  INGEST_DATA_TE,             // Temperatura del evaporador
+  INGEST_DATA_HE,             // Humedad del evaporador
+  INGEST_DATA_TC,             // Temperatura del compresor
+  INGEST_DATA_DP,             // Punto de rocío
+  INGEST_DATA_HA,             // Humedad absoluta
+  INGEST_DATA_V,              // Voltaje
+  INGEST_DATA_C,              // Corriente
+  INGEST_DATA_PO,             // Potencia
+  INGEST_DATA_E,              // Energía
+  INGEST_DATA_CS,             // Estado del compresor
+  INGEST_DATA_CALIBRATED,     // Calibración (1/0)
+  INGEST_DATA_TS,             // Marca de tiempo del dispositivo
+  INGEST_DATA_FIELD_COUNT
+};
+
+static const char* const kIngestDataKeys[INGEST_DATA_FIELD_COUNT] = {
+    "t", "h", "p", "w", "wr", "wu", "tank_capacity", "te", "he", "tc",
+    "dp", "ha", "v", "c", "po", "e", "cs", "calibrated", "ts"};
+
+// Campos de estado de dropster/status (JSON o mensajes simples como "COMP_ON")
+enum IngestStatusField : uint8_t {
+  INGEST_STATUS_COMPRESSOR = 0,
+  INGEST_STATUS_VENTILADOR,
+  INGEST_STATUS_PUMP,
+  INGEST_STATUS_COMPRESSOR_FAN,
+  INGEST_STATUS_MODE,          // Índice en kIngestModeNames
+  INGEST_STATUS_UPTIME,
+  INGEST_STATUS_TANK_CAPACITY,
+  INGEST_STATUS_FIELD_COUNT
+};
+
+static const char* const kIngestStatusKeys[INGEST_STATUS_FIELD_COUNT] = {
+    "compressor", "ventilador", "pump", "compressor_fan", "mode", "uptime",
+    "tank_capacity"};
+
+// Modos de operación que publica el firmware (el índice viaja en values[INGEST_STATUS_MODE])
+#define INGEST_MODE_COUNT 5
+static const char* const kIngestModeNames[INGEST_MODE_COUNT] = {
+    "MANUAL", "AUTO", "AUTO_PID", "AUTO_TIME", "AUTO_ADAPTIVE"};
+
+#define INGEST_VALUE_COUNT 20  // >= INGEST_DATA_FIELD_COUNT y INGEST_STATUS_FIELD_COUNT
+
+// Registro de tamaño fijo que Dart lee sin copiar (ver lib/services/mqtt/native_mqtt_ingest.dart).
+// Los eventos guardan su texto en la zona de texto del lote (offset y longitud)
+struct IngestRecord {
+  uint8_t kind;                    // IngestKind
+  uint8_t topic;                   // IngestTopic
+  uint16_t reserved;
+  uint32_t merged;                 // Mensajes combinados en este registro
+  int64_t received_ms;             // Recepción del último mensaje (ms desde epoch)
+  uint32_t present;                // Bit i: values[i] válido
+  uint32_t text_len;               // Solo eventos
+  char device[INGEST_DEVICE_LEN];  // Terminado en NUL
+  union {
+    double values[INGEST_VALUE_COUNT];
+    uint32_t text_offset;          // Solo eventos, relativo al inicio del lote
+  };
+};
+
+static_assert(sizeof(IngestRecord) == 216, "IngestRecord cambió: actualizar el lector en Dart");
+static_assert(INGEST_DATA_FIELD_COUNT <= INGEST_VALUE_COUNT, "values[] demasiado pequeño");
+
+// Número JSON (o cadena numérica) independiente de la configuración regional
+inline bool IngestParseNumber(const char* p, size_t n, double* out) {
+  size_t i = 0;
+  while (i < n && (p[i] == ' ' || p[i] == '\t')) i++;
+  bool negative = false;
+  if (i < n && (p[i] == '-' || p[i] == '+')) negative = p[i++] == '-';
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; i < n && p[i] >= '0' && p[i] <= '9'; i++, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(p[i] - '0');
+      if (mantissa) digits++;
+    } else {
+      exponent++;
+    }
+  }
+  if (i < n && p[i] == '.') {
+    for (i++; i < n && p[i] >= '0' && p[i] <= '9'; i++, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(p[i] - '0');
+        if (mantissa) digits++;
+        exponent--;
+      }
+    }
+  }
+  if (!any) return false;
+  if (i < n && (p[i] == 'e' || p[i] == 'E')) {
+    i++;
+    bool expNegative = false;
+    if (i < n && (p[i] == '-' || p[i] == '+')) expNegative = p[i++] == '-';
+    int e = 0;
+    bool expAny = false;
+    for (; i < n && p[i] >= '0' && p[i] <= '9'; i++, expAny = true) {
+      if (e < 1000) e = e * 10 + (p[i] - '0');
+    }
+    if (!expAny) return false;
+    exponent += expNegative ? -e : e;
+  }
+  while (i < n && (p[i] == ' ' || p[i] == '\t')) i++;
+  if (i != n) return false;  // Basura al final: no es un número
+
+  static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  double value = (double)mantissa;
+  while (exponent > 22) {
+    value *= 1e22;
+    exponent -= 22;
+  }
+  while (exponent < -22) {
+    value /= 1e22;
+    exponent += 22;
+  }
+  value = exponent >= 0 ? value * kPow10[exponent] : value / kPow10[-exponent];
+  *out = negative ? -value : value;
+  return true;
+}
+
+// Valor de un par clave/valor del objeto raíz
+struct IngestJsonValue {
+  enum Type { kNumber, kString, kBool, kNull, kOther } type;
+  const char* text;  // Cadena sin comillas (sin desescapar) o texto del número
+  size_t len;
+  bool boolean;
+};
+
+// Recorre los pares clave/valor de un objeto JSON plano. Objetos y listas anidados se
+// saltan enteros (se informan como kOther)
+class IngestJsonReader {
+ public:
+  IngestJsonReader(const char* data, size_t len) : p_(data), end_(data + len) {
+    SkipSpace();
+    if (p_ < end_ && *p_ == '{') {
+      p_++;
+      ok_ = true;
+    }
+  }
+
+  bool ok() const { return ok_; }
+
+  // Siguiente par; false al cerrar el objeto o ante JSON inválido (ok() pasa a false)
+  bool Next(const char** key, size_t* key_len, IngestJsonValue* value) {
+    if (!ok_ || done_) return false;
+    SkipSpace();
+    if (p_ < end_ && *p_ == '}') {
+      done_ = true;
+      return false;
+    }
+    if (!first_) {
+      if (p_ >= end_ || *p_ != ',') return Fail();
+      p_++;
+      SkipSpace();
+    }
+    first_ = false;
+    if (!ReadString(key, key_len)) return Fail();
+    SkipSpace();
+    if (p_ >= end_ || *p_ != ':') return Fail();
+    p_++;
+    SkipSpace();
+    if (p_ >= end_) return Fail();
+
+    value->boolean = false;
+    char c = *p_;
+    if (c == '"') {
+      value->type = IngestJsonValue::kString;
+      if (!ReadString(&value->text, &value->len)) return Fail();
+    } else if (c == '{' || c == '[') {
+      value->type = IngestJsonValue::kOther;
+      value->text = p_;
+      if (!SkipNested()) return Fail();
+      value->len = (size_t)(p_ - value->text);
+    } else if (Match("true")) {
+      value->type = IngestJsonValue::kBool;
+      value->boolean = true;
+    } else if (Match("false")) {
+      value->type = IngestJsonValue::kBool;
+    } else if (Match("null")) {
+      value->type = IngestJsonValue::kNull;
+    } else {
+      value->type = IngestJsonValue::kNumber;
+      value->text = p_;
+      while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ' ' && *p_ != '\n' && *p_ != '\r' && *p_ != '\t') p_++;
+      value->len = (size_t)(p_ - value->text);
+      if (value->len == 0) return Fail();
+    }
+    return true;
+  }
+
+ private:
+  const char* p_;
+  const char* end_;
+  bool ok_ = false;
+  bool done_ = false;
+  bool first_ = true;
+
+  bool Fail() {
+    ok_ = false;
+    return false;
+  }
+
+  void SkipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) p_++;
+  }
+
+  bool Match(const char* word) {
+    size_t n = strlen(word);
+    if ((size_t)(end_ - p_) < n || memcmp(p_, word, n) != 0) return false;
+    p_ += n;
+    return true;
+  }
+
+  bool ReadString(const char** text, size_t* len) {
+    if (p_ >= end_ || *p_ != '"') return false;
+    const char* start = ++p_;
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ == '\\') p_++;
+      p_++;
+    }
+    if (p_ >= end_) return false;
+    *text = start;
+    *len = (size_t)(p_ - start);
+    p_++;
+    return true;
+  }
+
+  bool SkipNested() {
+    int depth = 0;
+    while (p_ < end_) {
+      char c = *p_;
+      if (c == '"') {
+        const char* ignored;
+        size_t ignored_len;
+        if (!ReadString(&ignored, &ignored_len)) return false;
+        continue;
+      }
+      if (c == '{' || c == '[') depth++;
+      if (c == '}' || c == ']') depth--;
+      p_++;
+      if (depth == 0) return true;
+    }
+    return false;
+  }
+};
+
+inline bool IngestKeyIs(const char* key, size_t len, const char* name) {
+  return strlen(name) == len && memcmp(key, name, len) == 0;
+}
+
+// Valor numérico de un par: números, cadenas numéricas y booleanos (1/0)
+inline bool IngestValueAsNumber(const IngestJsonValue& v, double* out) {
+  switch (v.type) {
+    case IngestJsonValue::kNumber:
+    case IngestJsonValue::kString:
+      return IngestParseNumber(v.text, v.len, out);
+    case IngestJsonValue::kBool:
+      *out = v.boolean ? 1.0 : 0.0;
+      return true;
+    default:
+      return false;
+  }
+}
+
+inline void IngestCopyDevice(char* dst, const char* src, size_t len) {
+  if (len >= INGEST_DEVICE_LEN) len = INGEST_DEVICE_LEN - 1;
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+// Clasifica el tópico y extrae el dispositivo: "dropster/<id>/data" -> <id>; los tópicos
+// globales ("dropster/data") quedan con el dispositivo por defecto. data_topic es el tópico
+// de datos configurado en la app (puede no terminar en /data)
+inline IngestTopic IngestClassifyTopic(const char* topic, const char* data_topic, char device[INGEST_DEVICE_LEN]) {
+  IngestCopyDevice(device, INGEST_DEFAULT_DEVICE, strlen(INGEST_DEFAULT_DEVICE));
+  const char* last = strrchr(topic, '/');
+  const char* leaf = last ? last + 1 : topic;
+  const char* first = strchr(topic, '/');
+  if (first && last && first != last) IngestCopyDevice(device, first + 1, (size_t)(last - first - 1));
+  if (data_topic && strcmp(topic, data_topic) == 0) return INGEST_TOPIC_DATA;
+  if (strcmp(leaf, "data") == 0) return INGEST_TOPIC_DATA;
+  if (strcmp(leaf, "status") == 0) return INGEST_TOPIC_STATUS;
+  if (strcmp(leaf, "alerts") == 0) return INGEST_TOPIC_ALERTS;
+  return INGEST_TOPIC_OTHER;
+}
+
+// Decodifica dropster/data. Si el payload trae "id" o "device" reemplaza al del tópico
+inline bool IngestDecodeData(const char* payload, size_t len, IngestRecord* rec) {
+  IngestJsonReader reader(payload, len);
+  if (!reader.ok()) return false;
+  rec->kind = INGEST_KIND_DATA;
+  rec->present = 0;
+  const char* key;
+  size_t key_len;
+  IngestJsonValue value;
+  while (reader.Next(&key, &key_len, &value)) {
+    if ((IngestKeyIs(key, key_len, "id") || IngestKeyIs(key, key_len, "device")) &&
+        value.type == IngestJsonValue::kString && value.len > 0) {
+      IngestCopyDevice(rec->device, value.text, value.len);
+      continue;
+    }
+    for (uint8_t f = 0; f < INGEST_DATA_FIELD_COUNT; f++) {
+      if (!IngestKeyIs(key, key_len, kIngestDataKeys[f])) continue;
+      double number;
+      if (IngestValueAsNumber(value, &number)) {
+        rec->values[f] = number;
+        rec->present |= 1u << f;
+      }
+      break;
+    }
+  }
+  return reader.ok();
+}
+
+// Decodifica un estado de dropster/status. Devuelve false si el mensaje no es de estado
+// (config_ack, system_status, pump_error...): esos viajan como eventos sin coalescer
+inline bool IngestDecodeStatus(const char* payload, size_t len, IngestRecord* rec) {
+  rec->kind = INGEST_KIND_STATUS;
+  rec->present = 0;
+  IngestJsonReader reader(payload, len);
+  if (!reader.ok()) {
+    // Mensajes simples heredados: "MODE_AUTO", "COMP_ON", "AUTO_COMP_OFF"...
+    struct Simple {
+      const char* text;
+      uint8_t field;
+      double value;
+    };
+    static const Simple kSimple[] = {
+        {"MODE_AUTO", INGEST_STATUS_MODE, 1},        {"MODE_MANUAL", INGEST_STATUS_MODE, 0},
+        {"COMP_ON", INGEST_STATUS_COMPRESSOR, 1},    {"COMP_OFF", INGEST_STATUS_COMPRESSOR, 0},
+        {"VENT_ON", INGEST_STATUS_VENTILADOR, 1},    {"VENT_OFF", INGEST_STATUS_VENTILADOR, 0},
+        {"PUMP_ON", INGEST_STATUS_PUMP, 1},          {"PUMP_OFF", INGEST_STATUS_PUMP, 0},
+        {"CFAN_ON", INGEST_STATUS_COMPRESSOR_FAN, 1}, {"CFAN_OFF", INGEST_STATUS_COMPRESSOR_FAN, 0},
+    };
+    for (const Simple& s : kSimple) {
+      size_t n = strlen(s.text);
+      for (size_t i = 0; i + n <= len; i++) {
+        if (memcmp(payload + i, s.text, n) == 0) {
+          rec->values[s.field] = s.value;
+          rec->present = 1u << s.field;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  const char* key;
+  size_t key_len;
+  IngestJsonValue value;
+  while (reader.Next(&key, &key_len, &value)) {
+    if (IngestKeyIs(key, key_len, "type")) return false;
+    if (IngestKeyIs(key, key_len, "mode")) {
+      // Un modo desconocido se entrega como evento para que Dart lo reciba tal cual
+      if (value.type != IngestJsonValue::kString) return false;
+      uint8_t m = 0;
+      while (m < INGEST_MODE_COUNT && !IngestKeyIs(value.text, value.len, kIngestModeNames[m])) m++;
+      if (m == INGEST_MODE_COUNT) return false;
+      rec->values[INGEST_STATUS_MODE] = m;
+      rec->present |= 1u << INGEST_STATUS_MODE;
+      continue;
+    }
+    for (uint8_t f = 0; f < INGEST_STATUS_FIELD_COUNT; f++) {
+      if (f == INGEST_STATUS_MODE || !IngestKeyIs(key, key_len, kIngestStatusKeys[f])) continue;
+      double number;
+      if (IngestValueAsNumber(value, &number)) {
+        rec->values[f] = number;
+        rec->present |= 1u << f;
+      }
+      break;
+    }
+  }
+  return reader.ok() && rec->present != 0;
+}
+
+#endif  // RUNNER_MQTT_INGEST_DECODER_H_
@@ -0,0 +1,251 @@
+#include "mqtt_ingest_plugin.h"
+
+#include <mosquitto.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "mqtt_ingest_batcher.h"
+
+#define INGEST_CHANNEL "dropster/mqtt_ingest"
+#define INGEST_FRAME_MS 16          // Como máximo un aviso "batchReady" por cuadro
+#define INGEST_RENOTIFY_MS 1000     // Reaviso si Dart no retiró un lote pendiente
+#define INGEST_KEEPALIVE_S 120      // Igual que MqttService.keepAlivePeriod
+#define INGEST_RECONNECT_MIN_S 2
+#define INGEST_RECONNECT_MAX_S 300
+#define INGEST_CA_PATH "/etc/ssl/certs"
+
+// Tópicos de flota, cuando la app no indica un tópico de datos. Con tópico de datos se
+// atiende solo a ese equipo (ver subscribe_topics). Errores y sistema siguen en el cliente
+// Dart, que también publica los comandos
+static const char* const kIngestTopics[] = {
+    "dropster/data",   "dropster/+/data",   "dropster/status",
+    "dropster/+/status", "dropster/alerts", "dropster/+/alerts"};
+
+// Vive hasta el fin del proceso: los temporizadores de GLib programados desde el hilo de
+// red pueden dispararse después de mqtt_ingest_plugin_shutdown()
+struct MqttIngestPlugin {
+  FlMethodChannel* channel = nullptr;
+  struct mosquitto* mosq = nullptr;
+  std::string data_topic;
+  IngestBatcher batcher;
+  std::atomic<bool> connected{false};
+  std::atomic<bool> closing{false};
+  std::atomic<bool> notify_scheduled{false};
+  std::atomic<int64_t> last_notify_us{0};
+  std::atomic<uint32_t> connects{0};
+  std::atomic<int> last_error{MOSQ_ERR_SUCCESS};
+};
+
+static MqttIngestPlugin* g_plugin = nullptr;
+
+// Hilo principal: avisa a Dart que hay un lote listo
+static gboolean on_frame(gpointer user_data) {
+  MqttIngestPlugin* self = static_cast<MqttIngestPlugin*>(user_data);
+  self->notify_scheduled = false;
+  if (self->closing) return G_SOURCE_REMOVE;
+  self->last_notify_us = g_get_monotonic_time();
+  fl_method_channel_invoke_method(self->channel, "batchReady", nullptr, nullptr, nullptr, nullptr);
+  return G_SOURCE_REMOVE;
+}
+
+// Hilo de red: programa el aviso respetando el intervalo de cuadro
+static void schedule_notify(MqttIngestPlugin* self, bool batch_was_empty) {
+  int64_t now = g_get_monotonic_time();
+  int64_t since = now - self->last_notify_us;
+  if (!batch_was_empty && since < INGEST_RENOTIFY_MS * 1000) return;
+  bool expected = false;
+  if (!self->notify_scheduled.compare_exchange_strong(expected, true)) return;
+  int64_t wait_ms = INGEST_FRAME_MS - since / 1000;
+  if (wait_ms < 0) wait_ms = 0;
+  g_timeout_add((guint)wait_ms, on_frame, self);
+}
+
+// El tópico de datos configurado y sus hermanos: "dropster/<id>/data" -> "dropster/<id>/status"
+// y "dropster/<id>/alerts". Con tópicos por dispositivo la app no recibe los retenidos de
+// los demás equipos del broker; con el plano "dropster/data" queda como antes
+static void subscribe_topics(MqttIngestPlugin* self, struct mosquitto* mosq) {
+  if (self->data_topic.empty()) {
+    for (const char* topic : kIngestTopics) mosquitto_subscribe(mosq, nullptr, topic, 1);
+    return;
+  }
+  size_t slash = self->data_topic.rfind('/');
+  std::string base = (slash != std::string::npos && slash > 0) ? self->data_topic.substr(0, slash) : "dropster";
+  mosquitto_subscribe(mosq, nullptr, self->data_topic.c_str(), 1);
+  mosquitto_subscribe(mosq, nullptr, (base + "/status").c_str(), 1);
+  mosquitto_subscribe(mosq, nullptr, (base + "/alerts").c_str(), 1);
+}
+
+static void on_connect(struct mosquitto* mosq, void* obj, int rc) {
+  MqttIngestPlugin* self = static_cast<MqttIngestPlugin*>(obj);
+  self->last_error = rc;
+  if (rc != 0) {
+    g_warning("MQTT ingest: conexión rechazada (%d)", rc);
+    return;
+  }
+  self->connected = true;
+  self->connects++;
+  subscribe_topics(self, mosq);
+}
+
+static void on_disconnect(struct mosquitto*, void* obj, int rc) {
+  MqttIngestPlugin* self = static_cast<MqttIngestPlugin*>(obj);
+  self->connected = false;
+  self->last_error = rc;
+}
+
+static void on_message(struct mosquitto*, void* obj, const struct mosquitto_message* msg) {
+  MqttIngestPlugin* self = static_cast<MqttIngestPlugin*>(obj);
+  if (msg->payloadlen <= 0) return;
+  auto start = std::chrono::steady_clock::now();
+  const char* payload = static_cast<const char*>(msg->payload);
+  size_t len = (size_t)msg->payloadlen;
+
+  IngestRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.received_ms = g_get_real_time() / 1000;
+  IngestTopic topic = IngestClassifyTopic(msg->topic, self->data_topic.c_str(), rec.device);
+  rec.topic = topic;
+
+  bool was_empty;
+  if (topic == INGEST_TOPIC_DATA) {
+    if (!IngestDecodeData(payload, len, &rec)) {
+      self->batcher.CountDecodeError();
+      return;
+    }
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    was_empty = self->batcher.AddState(rec, ns);
+  } else if (topic == INGEST_TOPIC_STATUS && IngestDecodeStatus(payload, len, &rec)) {
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    was_empty = self->batcher.AddState(rec, ns);
+  } else {
+    was_empty = self->batcher.AddEvent(rec.device, topic, payload, len, rec.received_ms);
+  }
+  schedule_notify(self, was_empty);
+}
+
+static void stop_connection(MqttIngestPlugin* self) {
+  if (self->mosq == nullptr) return;
+  mosquitto_disconnect(self->mosq);
+  mosquitto_loop_stop(self->mosq, false);
+  mosquitto_destroy(self->mosq);
+  self->mosq = nullptr;
+  self->connected = false;
+}
+
+static const gchar* lookup_string(FlValue* args, const char* key, const gchar* fallback) {
+  FlValue* v = fl_value_lookup_string(args, key);
+  return (v != nullptr && fl_value_get_type(v) == FL_VALUE_TYPE_STRING) ? fl_value_get_string(v) : fallback;
+}
+
+static int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* v = fl_value_lookup_string(args, key);
+  return (v != nullptr && fl_value_get_type(v) == FL_VALUE_TYPE_INT) ? fl_value_get_int(v) : fallback;
+}
+
+static bool lookup_bool(FlValue* args, const char* key) {
+  FlValue* v = fl_value_lookup_string(args, key);
+  return v != nullptr && fl_value_get_type(v) == FL_VALUE_TYPE_BOOL && fl_value_get_bool(v);
+}
+
+// start: {broker, port, user, password, tls, dataTopic, clientId}
+static FlMethodResponse* start_connection(MqttIngestPlugin* self, FlValue* args) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("bad_args", "Se esperaba un mapa", nullptr));
+  }
+  const gchar* broker = lookup_string(args, "broker", nullptr);
+  if (broker == nullptr || broker[0] == '\0') {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("bad_args", "Falta el broker", nullptr));
+  }
+  stop_connection(self);
+  self->batcher.Reset();
+  self->data_topic = lookup_string(args, "dataTopic", "");
+  self->mosq = mosquitto_new(lookup_string(args, "clientId", nullptr), true, self);
+  if (self->mosq == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("mosquitto", "No se pudo crear el cliente", nullptr));
+  }
+  mosquitto_connect_callback_set(self->mosq, on_connect);
+  mosquitto_disconnect_callback_set(self->mosq, on_disconnect);
+  mosquitto_message_callback_set(self->mosq, on_message);
+  mosquitto_reconnect_delay_set(self->mosq, INGEST_RECONNECT_MIN_S, INGEST_RECONNECT_MAX_S, true);
+
+  const gchar* user = lookup_string(args, "user", "");
+  if (user[0] != '\0') mosquitto_username_pw_set(self->mosq, user, lookup_string(args, "password", ""));
+  if (lookup_bool(args, "tls")) mosquitto_tls_set(self->mosq, nullptr, INGEST_CA_PATH, nullptr, nullptr, nullptr);
+
+  int rc = mosquitto_connect_async(self->mosq, broker, (int)lookup_int(args, "port", 1883), INGEST_KEEPALIVE_S);
+  if (rc == MOSQ_ERR_SUCCESS) rc = mosquitto_loop_start(self->mosq);
+  self->last_error = rc;
+  if (rc != MOSQ_ERR_SUCCESS) {
+    stop_connection(self);
+    return FL_METHOD_RESPONSE(fl_method_error_response_new("mosquitto", mosquitto_strerror(rc), nullptr));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(TRUE)));
+}
+
+static FlMethodResponse* get_stats(MqttIngestPlugin* self) {
+  IngestStats s = self->batcher.stats();
+  g_autoptr(FlValue) map = fl_value_new_map();
+  fl_value_set_string_take(map, "connected", fl_value_new_bool(self->connected));
+  fl_value_set_string_take(map, "connects", fl_value_new_int(self->connects));
+  fl_value_set_string_take(map, "lastError", fl_value_new_int(self->last_error));
+  fl_value_set_string_take(map, "messages", fl_value_new_int((int64_t)s.messages));
+  fl_value_set_string_take(map, "decodeErrors", fl_value_new_int((int64_t)s.decode_errors));
+  fl_value_set_string_take(map, "coalesced", fl_value_new_int((int64_t)s.coalesced));
+  fl_value_set_string_take(map, "droppedStates", fl_value_new_int((int64_t)s.dropped_states));
+  fl_value_set_string_take(map, "events", fl_value_new_int((int64_t)s.events));
+  fl_value_set_string_take(map, "droppedEvents", fl_value_new_int((int64_t)s.dropped_events));
+  fl_value_set_string_take(map, "batches", fl_value_new_int((int64_t)s.batches));
+  fl_value_set_string_take(map, "maxRecords", fl_value_new_int(s.max_records));
+  uint64_t decoded = s.messages - s.decode_errors - s.events - s.dropped_events;
+  fl_value_set_string_take(map, "decodeAvgNs", fl_value_new_int(decoded > 0 ? (int64_t)(s.decode_ns / decoded) : 0));
+  fl_value_set_string_take(map, "takeAvgNs", fl_value_new_int(s.batches > 0 ? (int64_t)(s.take_ns / s.batches) : 0));
+  fl_value_set_string_take(map, "takeMaxNs", fl_value_new_int(s.max_take_ns));
+  fl_value_set_string_take(map, "ageAvgUs", fl_value_new_int(s.batches > 0 ? (int64_t)(s.age_us / s.batches) : 0));
+  fl_value_set_string_take(map, "ageMaxUs", fl_value_new_int(s.max_age_us));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(map));
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call, gpointer user_data) {
+  MqttIngestPlugin* self = static_cast<MqttIngestPlugin*>(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, "start") == 0) {
+    response = start_connection(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "stop") == 0) {
+    stop_connection(self);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (strcmp(method, "getStats") == 0) {
+    response = get_stats(self);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("MQTT ingest: no se pudo responder %s: %s", method, error->message);
+  }
+}
+
+void mqtt_ingest_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  if (g_plugin != nullptr) return;
+  mosquitto_lib_init();
+  g_plugin = new MqttIngestPlugin();
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_plugin->channel = fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                                            INGEST_CHANNEL, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(g_plugin->channel, method_call_cb, g_plugin, nullptr);
+}
+
+void mqtt_ingest_plugin_shutdown() {
+  if (g_plugin == nullptr) return;
+  g_plugin->closing = true;
+  stop_connection(g_plugin);
+  mosquitto_lib_cleanup();
+}
+
+const uint8_t* dropster_ingest_take_batch() {
+  if (g_plugin == nullptr || g_plugin->closing) return nullptr;
+  return g_plugin->batcher.Take(nullptr);
+}
@@ -0,0 +1,26 @@
+#ifndef RUNNER_MQTT_INGEST_PLUGIN_H_
+#define RUNNER_MQTT_INGEST_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <stdint.h>
+
+// Plugin de ingesta MQTT nativa del escritorio Linux.
+//
+// Mantiene su propia conexión con el broker (libmosquitto, hilo de red propio), decodifica
+// dropster/data, dropster/status y dropster/alerts fuera del hilo de la UI y entrega a Dart
+// un lote por cuadro. El control (start, stop, getStats) viaja por el canal de métodos
+// "dropster/mqtt_ingest"; el aviso "batchReady" llega por el mismo canal y Dart lee el lote
+// por FFI con dropster_ingest_take_batch(), sin copiar.
+void mqtt_ingest_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+// Detiene la conexión y libera el plugin (al cerrar la aplicación).
+void mqtt_ingest_plugin_shutdown();
+
+extern "C" {
+// Lote pendiente (ver mqtt_ingest_batcher.h) o nullptr si no hay nada. El puntero es válido
+// hasta la siguiente llamada; se invoca desde Dart por FFI.
+__attribute__((visibility("default"))) const uint8_t* dropster_ingest_take_batch();
+}
+
+#endif  // RUNNER_MQTT_INGEST_PLUGIN_H_
@@ -6,6 +6,9 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#ifdef DROPSTER_NATIVE_INGEST
+#include "mqtt_ingest_plugin.h"
+#endif
 
 struct _MyApplication {
   GtkApplication parent_instance;
@@ -59,6 +62,13 @@ static void my_application_activate(GApplication* application) {
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
 
+#ifdef DROPSTER_NATIVE_INGEST
+  // Native MQTT ingestion lives in the runner rather than in a package.
+  g_autoptr(FlPluginRegistrar) mqtt_ingest_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view), "MqttIngestPlugin");
+  mqtt_ingest_plugin_register_with_registrar(mqtt_ingest_registrar);
+#endif
+
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
@@ -95,6 +105,9 @@ static void my_application_shutdown(GApplication* application) {
   //MyApplication* self = MY_APPLICATION(object);
 
   // Perform any actions required at application shutdown.
+#ifdef DROPSTER_NATIVE_INGEST
+  mqtt_ingest_plugin_shutdown();
+#endif
 
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
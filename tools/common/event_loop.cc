@@ -0,0 +1,142 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+namespace dropster {
+
+#define EVENT_LOOP_MAX_EVENTS 256
+#define EVENT_LOOP_MAX_WAIT_MS 1000
+
+EventLoop::EventLoop() { epoll_fd_ = epoll_create1(EPOLL_CLOEXEC); }
+
+EventLoop::~EventLoop() {
+  if (signal_fd_ >= 0) close(signal_fd_);
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+bool EventLoop::Add(int fd, uint32_t events, Handler handler) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+  handlers_[fd] = std::make_shared<Handler>(std::move(handler));
+  return true;
+}
+
+bool EventLoop::Modify(int fd, uint32_t events) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::Remove(int fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  handlers_.erase(fd);
+}
+
+EventLoop::TimerId EventLoop::After(int64_t delay_ms, std::function<void()> callback) {
+  TimerId id = next_timer_++;
+  timers_[id] = Timer{std::move(callback), 0};
+  deadlines_.push(Deadline{NowMs() + (delay_ms > 0 ? delay_ms : 0), id});
+  return id;
+}
+
+EventLoop::TimerId EventLoop::Every(int64_t interval_ms, std::function<void()> callback) {
+  if (interval_ms < 1) interval_ms = 1;
+  TimerId id = next_timer_++;
+  timers_[id] = Timer{std::move(callback), interval_ms};
+  deadlines_.push(Deadline{NowMs() + interval_ms, id});
+  return id;
+}
+
+void EventLoop::Cancel(TimerId id) { timers_.erase(id); }  // La entrada en deadlines_ se descarta al vencer
+
+bool EventLoop::StopOnSignals() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0) return false;
+  signal(SIGPIPE, SIG_IGN);  // Escribir en un socket cerrado no debe terminar el proceso
+  signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd_ < 0) return false;
+  return Add(signal_fd_, EPOLLIN, [this](uint32_t) {
+    struct signalfd_siginfo info;
+    while (read(signal_fd_, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+      fprintf(stderr, "Señal %u recibida, deteniendo\n", info.ssi_signo);
+      running_ = false;
+    }
+  });
+}
+
+int EventLoop::NextTimeoutMs() const {
+  if (deadlines_.empty()) return EVENT_LOOP_MAX_WAIT_MS;
+  int64_t wait = deadlines_.top().at_ms - NowMs();
+  if (wait < 0) return 0;
+  return wait > EVENT_LOOP_MAX_WAIT_MS ? EVENT_LOOP_MAX_WAIT_MS : (int)wait;
+}
+
+void EventLoop::RunTimers() {
+  int64_t now = NowMs();
+  while (!deadlines_.empty() && deadlines_.top().at_ms <= now) {
+    Deadline d = deadlines_.top();
+    deadlines_.pop();
+    auto it = timers_.find(d.id);
+    if (it == timers_.end()) continue;  // Cancelado
+    std::function<void()> callback = it->second.callback;  // Copia: el callback puede cancelarse a sí mismo
+    if (it->second.interval_ms > 0) {
+      // Sin acumular atraso: si el bucle se retrasó, el próximo vence un intervalo después de ahora
+      int64_t next = d.at_ms + it->second.interval_ms;
+      deadlines_.push(Deadline{next > now ? next : now + it->second.interval_ms, d.id});
+    } else {
+      timers_.erase(it);
+    }
+    callback();
+  }
+}
+
+void EventLoop::Run() {
+  running_ = true;
+  struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+  while (running_) {
+    int n = epoll_wait(epoll_fd_, events, EVENT_LOOP_MAX_EVENTS, NextTimeoutMs());
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      auto it = handlers_.find(events[i].data.fd);
+      if (it == handlers_.end()) continue;  // Eliminado por un handler anterior de esta vuelta
+      std::shared_ptr<Handler> handler = it->second;
+      (*handler)(events[i].events);
+    }
+    RunTimers();
+  }
+}
+
+int64_t EventLoop::NowMs() { return NowUs() / 1000; }
+
+int64_t EventLoop::NowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t EventLoop::WallMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+}  // namespace dropster
@@ -0,0 +1,72 @@
+#ifndef DROPSTER_TOOLS_EVENT_LOOP_H_
+#define DROPSTER_TOOLS_EVENT_LOOP_H_
+
+// Bucle de eventos de un solo hilo (epoll + temporizadores) para las herramientas de
+// escritorio: el historiador y el simulador de flota atienden miles de sockets desde un
+// único hilo sin bloquear.
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace dropster {
+
+class EventLoop {
+ public:
+  using Handler = std::function<void(uint32_t events)>;  // Máscara EPOLLIN/EPOLLOUT/...
+  using TimerId = uint64_t;
+
+  EventLoop();
+  ~EventLoop();
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  // Descriptores: el handler se invoca con los eventos listos
+  bool Add(int fd, uint32_t events, Handler handler);
+  bool Modify(int fd, uint32_t events);
+  void Remove(int fd);
+
+  // Temporizadores (ms monotónicos). Every() repite hasta Cancel()
+  TimerId After(int64_t delay_ms, std::function<void()> callback);
+  TimerId Every(int64_t interval_ms, std::function<void()> callback);
+  void Cancel(TimerId id);
+
+  // Corre hasta Stop() o hasta recibir SIGINT/SIGTERM si se llamó StopOnSignals()
+  void Run();
+  void Stop() { running_ = false; }
+  bool StopOnSignals();
+
+  static int64_t NowMs();   // Reloj monotónico
+  static int64_t NowUs();
+  static int64_t WallMs();  // Tiempo real (ms desde epoch)
+
+ private:
+  struct Timer {
+    std::function<void()> callback;
+    int64_t interval_ms;  // 0 = una sola vez
+  };
+  struct Deadline {
+    int64_t at_ms;
+    TimerId id;
+    bool operator>(const Deadline& o) const { return at_ms > o.at_ms || (at_ms == o.at_ms && id > o.id); }
+  };
+
+  int epoll_fd_ = -1;
+  int signal_fd_ = -1;
+  bool running_ = false;
+  TimerId next_timer_ = 1;
+  std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+  std::unordered_map<TimerId, Timer> timers_;
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+
+  int NextTimeoutMs() const;
+  void RunTimers();
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_TOOLS_EVENT_LOOP_H_
@@ -0,0 +1,153 @@
+#ifndef DROPSTER_TOOLS_FLAT_JSON_H_
+#define DROPSTER_TOOLS_FLAT_JSON_H_
+
+// Lectura de objetos JSON planos como los que publica el AWG ({"t":"24.31","ts":1712...}).
+// Recorre los miembros de primer nivel sin construir un árbol; los objetos o arreglos
+// anidados se saltan completos. Suficiente para dropster/data, status y alerts.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace dropster {
+
+struct JsonValue {
+  enum Kind { kString, kNumber, kBool, kNull, kNested };
+  Kind kind;
+  const char* begin;  // Texto crudo (sin comillas para strings; sin procesar escapes)
+  size_t length;
+
+  std::string Text() const { return std::string(begin, length); }
+
+  // Número desde un valor numérico o un string numérico ("24.31", "nan"). NAN si no es número
+  double AsNumber() const {
+    if (kind == kBool) return (length == 4) ? 1.0 : 0.0;
+    if (kind != kNumber && kind != kString) return NAN;
+    char buf[40];
+    if (length == 0 || length >= sizeof(buf)) return NAN;
+    memcpy(buf, begin, length);
+    buf[length] = '\0';
+    char* end = nullptr;
+    double value = strtod(buf, &end);  // Las herramientas no cambian el locale: '.' decimal
+    return (end == buf + length) ? value : NAN;
+  }
+};
+
+namespace flat_json_internal {
+
+inline const char* SkipSpace(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+  return p;
+}
+
+// Avanza hasta después del string que empieza en p (p apunta a la comilla de apertura)
+inline const char* SkipString(const char* p, const char* end) {
+  for (p++; p < end; p++) {
+    if (*p == '\\') {
+      p++;
+    } else if (*p == '"') {
+      return p + 1;
+    }
+  }
+  return nullptr;
+}
+
+// Salta un objeto o arreglo anidado completo
+inline const char* SkipNested(const char* p, const char* end) {
+  int depth = 0;
+  while (p < end) {
+    if (*p == '"') {
+      p = SkipString(p, end);
+      if (!p) return nullptr;
+      continue;
+    }
+    if (*p == '{' || *p == '[') depth++;
+    if (*p == '}' || *p == ']') {
+      if (--depth == 0) return p + 1;
+    }
+    p++;
+  }
+  return nullptr;
+}
+
+}  // namespace flat_json_internal
+
+// Llama visit(key, keyLength, value) por cada miembro. Devuelve false si el JSON está mal
+// formado (los miembros anteriores al error ya se visitaron)
+template <typename Visitor>
+bool ForEachJsonMember(const char* json, size_t length, Visitor visit) {
+  using namespace flat_json_internal;
+  const char* p = json;
+  const char* end = json + length;
+  p = SkipSpace(p, end);
+  if (p >= end || *p != '{') return false;
+  p = SkipSpace(p + 1, end);
+  if (p < end && *p == '}') return true;
+  while (p < end) {
+    if (*p != '"') return false;
+    const char* key = p + 1;
+    const char* after = SkipString(p, end);
+    if (!after) return false;
+    size_t key_len = (size_t)(after - 1 - key);
+    p = SkipSpace(after, end);
+    if (p >= end || *p != ':') return false;
+    p = SkipSpace(p + 1, end);
+    if (p >= end) return false;
+
+    JsonValue value;
+    if (*p == '"') {
+      const char* close = SkipString(p, end);
+      if (!close) return false;
+      value = JsonValue{JsonValue::kString, p + 1, (size_t)(close - 1 - (p + 1))};
+      p = close;
+    } else if (*p == '{' || *p == '[') {
+      const char* close = SkipNested(p, end);
+      if (!close) return false;
+      value = JsonValue{JsonValue::kNested, p, (size_t)(close - p)};
+      p = close;
+    } else {
+      const char* start = p;
+      while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') p++;
+      size_t len = (size_t)(p - start);
+      JsonValue::Kind kind = JsonValue::kNumber;
+      if ((len == 4 && memcmp(start, "true", 4) == 0) || (len == 5 && memcmp(start, "false", 5) == 0)) {
+        kind = JsonValue::kBool;
+      } else if (len == 4 && memcmp(start, "null", 4) == 0) {
+        kind = JsonValue::kNull;
+      }
+      value = JsonValue{kind, start, len};
+    }
+    visit(key, key_len, value);
+
+    p = SkipSpace(p, end);
+    if (p < end && *p == ',') {
+      p = SkipSpace(p + 1, end);
+      continue;
+    }
+    return p < end && *p == '}';
+  }
+  return false;
+}
+
+// Escapa un string para incluirlo entre comillas en JSON
+inline void AppendJsonEscaped(std::string& out, const std::string& text) {
+  for (unsigned char ch : text) {
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+      out += (char)ch;
+    } else if (ch < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", ch);
+      out += buf;
+    } else {
+      out += (char)ch;
+    }
+  }
+}
+
+}  // namespace dropster
+
+#endif  // DROPSTER_TOOLS_FLAT_JSON_H_
@@ -0,0 +1,408 @@
+#include "mqtt_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace dropster {
+
+#define MQTT_READ_CHUNK 16384
+#define MQTT_MAX_PACKET (256 * 1024)  // Más que suficiente para los JSON del AWG
+
+// Tipos de paquete (nibble alto del primer byte)
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82  // Con los flags reservados 0010
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+namespace {
+
+void AppendU16(std::string& out, uint16_t value) {
+  out += (char)(value >> 8);
+  out += (char)(value & 0xFF);
+}
+
+void AppendField(std::string& out, const std::string& text) {
+  AppendU16(out, (uint16_t)text.size());
+  out += text;
+}
+
+uint16_t ReadU16(const char* p) { return (uint16_t)(((uint8_t)p[0] << 8) | (uint8_t)p[1]); }
+
+}  // namespace
+
+MqttClient::MqttClient(EventLoop& loop, MqttOptions options) : loop_(loop), options_(std::move(options)) {
+  backoff_ms_ = options_.reconnect_min_ms;
+}
+
+MqttClient::~MqttClient() {
+  stopped_ = true;
+  if (reconnect_timer_) loop_.Cancel(reconnect_timer_);
+  if (keepalive_timer_) loop_.Cancel(keepalive_timer_);
+  if (fd_ >= 0) {
+    loop_.Remove(fd_);
+    close(fd_);
+  }
+}
+
+void MqttClient::Connect() {
+  if (state_ != kIdle) return;
+  stopped_ = false;
+  reconnect_timer_ = 0;
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  std::string port = std::to_string(options_.port);
+  int rc = getaddrinfo(options_.host.c_str(), port.c_str(), &hints, &result);
+  if (rc != 0 || !result) {
+    Close(std::string("no se pudo resolver ") + options_.host + ": " + gai_strerror(rc), true);
+    return;
+  }
+
+  fd_ = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    freeaddrinfo(result);
+    Close(std::string("socket: ") + strerror(errno), true);
+    return;
+  }
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Mensajes pequeños: sin Nagle
+
+  rc = connect(fd_, result->ai_addr, result->ai_addrlen);
+  freeaddrinfo(result);
+  if (rc != 0 && errno != EINPROGRESS) {
+    Close(std::string("connect: ") + strerror(errno), true);
+    return;
+  }
+
+  state_ = kConnecting;
+  want_write_ = true;
+  loop_.Add(fd_, EPOLLIN | EPOLLOUT, [this](uint32_t events) { OnEvents(events); });
+}
+
+void MqttClient::Disconnect() {
+  stopped_ = true;
+  if (reconnect_timer_) {
+    loop_.Cancel(reconnect_timer_);
+    reconnect_timer_ = 0;
+  }
+  if (state_ == kConnected) {
+    QueuePacket(MQTT_DISCONNECT, std::string());
+    FlushOutput();
+  }
+  Close("desconexión solicitada", false);
+}
+
+void MqttClient::Drop() { Close("cierre abrupto", false); }
+
+void MqttClient::OnEvents(uint32_t events) {
+  if (state_ == kConnecting) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+    if (error != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+      Close(std::string("connect: ") + strerror(error ? error : ECONNREFUSED), true);
+      return;
+    }
+    if (events & EPOLLOUT) OnSocketConnected();
+    return;
+  }
+  if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+    ReadAvailable();
+    if (fd_ < 0) return;
+  }
+  if (events & EPOLLOUT) FlushOutput();
+}
+
+void MqttClient::OnSocketConnected() {
+  state_ = kAwaitingConnack;
+
+  std::string body;
+  AppendField(body, "MQTT");
+  body += (char)4;  // Nivel de protocolo 3.1.1
+  uint8_t flags = 0;
+  if (options_.clean_session) flags |= 0x02;
+  if (!options_.will_topic.empty()) {
+    flags |= 0x04 | (uint8_t)((options_.will_qos & 0x03) << 3);
+    if (options_.will_retain) flags |= 0x20;
+  }
+  if (!options_.username.empty()) {
+    flags |= 0x80;
+    if (!options_.password.empty()) flags |= 0x40;
+  }
+  body += (char)flags;
+  AppendU16(body, (uint16_t)options_.keepalive_s);
+  AppendField(body, options_.client_id);
+  if (!options_.will_topic.empty()) {
+    AppendField(body, options_.will_topic);
+    AppendField(body, options_.will_payload);
+  }
+  if (!options_.username.empty()) {
+    AppendField(body, options_.username);
+    if (!options_.password.empty()) AppendField(body, options_.password);
+  }
+
+  last_received_ms_ = EventLoop::NowMs();
+  QueuePacket(MQTT_CONNECT, body);
+  FlushOutput();
+}
+
+void MqttClient::ReadAvailable() {
+  char buf[MQTT_READ_CHUNK];
+  for (;;) {
+    ssize_t n = read(fd_, buf, sizeof(buf));
+    if (n > 0) {
+      in_.append(buf, (size_t)n);
+      last_received_ms_ = EventLoop::NowMs();
+      if ((size_t)n < sizeof(buf)) break;
+      continue;
+    }
+    if (n == 0) {
+      Close("conexión cerrada por el broker", true);
+      return;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+    if (errno == EINTR) continue;
+    Close(std::string("read: ") + strerror(errno), true);
+    return;
+  }
+  if (!ParsePackets()) Close("paquete MQTT inválido", true);
+}
+
+bool MqttClient::ParsePackets() {
+  size_t pos = 0;
+  while (fd_ >= 0) {
+    if (in_.size() - pos < 2) break;
+    // Longitud restante: entero variable de hasta 4 bytes
+    size_t length = 0;
+    size_t used = 1;
+    int shift = 0;
+    bool complete = false;
+    while (pos + used < in_.size() && used <= 4) {
+      uint8_t byte = (uint8_t)in_[pos + used];
+      length |= (size_t)(byte & 0x7F) << shift;
+      used++;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (used > 4) return false;
+      break;
+    }
+    if (length > MQTT_MAX_PACKET) return false;
+    if (in_.size() - pos - used < length) break;
+    uint8_t header = (uint8_t)in_[pos];
+    const char* body = in_.data() + pos + used;
+    pos += used + length;
+    HandlePacket(header, body, length);
+  }
+  if (fd_ >= 0) in_.erase(0, pos);
+  return true;
+}
+
+void MqttClient::HandlePacket(uint8_t header, const char* body, size_t length) {
+  switch (header & 0xF0) {
+    case MQTT_CONNACK: {
+      if (state_ != kAwaitingConnack || length < 2) return;
+      uint8_t code = (uint8_t)body[1];
+      if (code != 0) {
+        // Credenciales o id rechazados: reintentar con backoff por si el broker se reconfigura
+        Close("CONNACK rechazado, código " + std::to_string(code), true);
+        return;
+      }
+      state_ = kConnected;
+      backoff_ms_ = options_.reconnect_min_ms;
+      if (options_.keepalive_s > 0) {
+        int64_t half = (int64_t)options_.keepalive_s * 500;
+        keepalive_timer_ = loop_.Every(half, [this, half]() {
+          int64_t now = EventLoop::NowMs();
+          if (now - last_received_ms_ > 3 * half) {  // 1,5 × keepalive sin respuesta
+            Close("keepalive vencido", true);
+            return;
+          }
+          // También si solo se publica: sin tráfico entrante el PINGRESP es lo que prueba la sesión
+          if (now - last_sent_ms_ >= half || now - last_received_ms_ >= half) {
+            QueuePacket(MQTT_PINGREQ, std::string());
+          }
+        });
+      }
+      if (on_connect) on_connect();
+      return;
+    }
+    case MQTT_PUBLISH: {
+      if (length < 2) return;
+      int qos = (header >> 1) & 0x03;
+      uint16_t topic_len = ReadU16(body);
+      size_t offset = 2 + topic_len;
+      if (offset > length) return;
+      std::string topic(body + 2, topic_len);
+      if (qos > 0) {
+        if (offset + 2 > length) return;
+        uint16_t packet_id = ReadU16(body + offset);
+        offset += 2;
+        std::string ack;
+        AppendU16(ack, packet_id);
+        QueuePacket(MQTT_PUBACK, ack);
+        if (fd_ < 0) return;  // La escritura falló y Close() vació in_
+      }
+      if (on_message) on_message(topic, body + offset, length - offset);
+      return;
+    }
+    case MQTT_PUBACK:
+      if (length >= 2 && on_puback) on_puback(ReadU16(body));
+      return;
+    case MQTT_SUBACK:
+    case MQTT_PINGRESP:
+    default:
+      return;
+  }
+}
+
+bool MqttClient::Subscribe(const std::string& filter, int qos) {
+  if (state_ != kConnected) return false;
+  std::string body;
+  AppendU16(body, NextPacketId());
+  AppendField(body, filter);
+  body += (char)std::min(qos, 1);
+  QueuePacket(MQTT_SUBSCRIBE, body);
+  return true;
+}
+
+bool MqttClient::Publish(const std::string& topic, const char* payload, size_t length, int qos, bool retain,
+                         uint16_t* packet_id) {
+  if (state_ != kConnected || pending_output() > options_.max_output_bytes) return false;
+  qos = std::min(qos, 1);
+  std::string body;
+  body.reserve(topic.size() + length + 4);
+  AppendField(body, topic);
+  if (qos > 0) {
+    uint16_t id = NextPacketId();
+    AppendU16(body, id);
+    if (packet_id) *packet_id = id;
+  }
+  body.append(payload, length);
+  QueuePacket((uint8_t)(MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0)), body);
+  return true;
+}
+
+void MqttClient::QueuePacket(uint8_t header, const std::string& body) {
+  if (fd_ < 0) return;
+  out_ += (char)header;
+  size_t length = body.size();
+  do {
+    uint8_t byte = length & 0x7F;
+    length >>= 7;
+    if (length > 0) byte |= 0x80;
+    out_ += (char)byte;
+  } while (length > 0);
+  out_ += body;
+  last_sent_ms_ = EventLoop::NowMs();
+  // Escritura inmediata: en el caso común el socket acepta todo y no hace falta EPOLLOUT
+  if (state_ != kConnecting) FlushOutput();
+}
+
+void MqttClient::FlushOutput() {
+  while (fd_ >= 0 && out_pos_ < out_.size()) {
+    ssize_t n = write(fd_, out_.data() + out_pos_, out_.size() - out_pos_);
+    if (n > 0) {
+      out_pos_ += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    Close(std::string("write: ") + strerror(errno), true);
+    return;
+  }
+  if (fd_ < 0) return;
+  if (out_pos_ == out_.size()) {
+    out_.clear();
+    out_pos_ = 0;
+  } else if (out_pos_ > (64 << 10)) {
+    out_.erase(0, out_pos_);  // Compactar de vez en cuando, no en cada escritura parcial
+    out_pos_ = 0;
+  }
+  bool want_write = out_pos_ < out_.size();
+  if (want_write != want_write_) {
+    want_write_ = want_write;
+    loop_.Modify(fd_, EPOLLIN | (want_write ? (uint32_t)EPOLLOUT : 0u));
+  }
+}
+
+void MqttClient::Close(const std::string& reason, bool reconnect) {
+  bool was_connected = state_ == kConnected;
+  if (keepalive_timer_) {
+    loop_.Cancel(keepalive_timer_);
+    keepalive_timer_ = 0;
+  }
+  if (fd_ >= 0) {
+    loop_.Remove(fd_);
+    close(fd_);
+    fd_ = -1;
+  }
+  state_ = kIdle;
+  want_write_ = false;
+  in_.clear();
+  out_.clear();
+  out_pos_ = 0;
+  if (was_connected || reconnect) {
+    if (on_disconnect) on_disconnect(reason);
+  }
+  if (reconnect && !stopped_) ScheduleReconnect();
+}
+
+void MqttClient::ScheduleReconnect() {
+  if (options_.reconnect_min_ms <= 0 || reconnect_timer_) return;
+  int delay = backoff_ms_;
+  backoff_ms_ = std::min(backoff_ms_ * 2, options_.reconnect_max_ms);
+  reconnect_timer_ = loop_.After(delay, [this]() {
+    reconnect_timer_ = 0;
+    Connect();
+  });
+}
+
+uint16_t MqttClient::NextPacketId() {
+  uint16_t id = next_packet_id_++;
+  if (next_packet_id_ == 0) next_packet_id_ = 1;  // 0 no es un id válido
+  return id;
+}
+
+bool MqttClient::TopicMatches(const std::string& filter, const std::string& topic) {
+  size_t f = 0;
+  size_t t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;  // Coincide con el resto, incluido el nivel padre
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') t++;
+      f++;
+    } else {
+      if (t >= topic.size() || filter[f] != topic[t]) {
+        // "a/#" también coincide con "a"
+        return t == topic.size() && filter.compare(f, std::string::npos, "/#") == 0;
+      }
+      f++;
+      t++;
+    }
+  }
+  return t == topic.size();
+}
+
+}  // namespace dropster
@@ -0,0 +1,106 @@
+#ifndef DROPSTER_TOOLS_MQTT_CLIENT_H_
+#define DROPSTER_TOOLS_MQTT_CLIENT_H_
+
+// Cliente MQTT 3.1.1 mínimo y no bloqueante sobre EventLoop.
+//
+// Cubre lo que usan el AWG y la app: CONNECT con usuario/contraseña y last will,
+// SUBSCRIBE, PUBLISH QoS 0/1 (con PUBACK en ambos sentidos) y keepalive. Sin TLS ni
+// QoS 2 (se suscribe con QoS <= 1, así que el broker nunca entrega QoS 2). Cada cliente
+// es un socket en el bucle: un solo hilo puede mantener miles de sesiones, que es lo que
+// necesita el simulador de flota y de paso evita depender de libmosquitto en el historiador.
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "event_loop.h"
+
+namespace dropster {
+
+struct MqttOptions {
+  std::string host = "localhost";
+  int port = 1883;
+  std::string client_id;
+  std::string username;
+  std::string password;
+  int keepalive_s = 60;
+  bool clean_session = true;
+  std::string will_topic;  // Vacío = sin last will
+  std::string will_payload;
+  int will_qos = 0;
+  bool will_retain = false;
+  int reconnect_min_ms = 1000;  // Backoff exponencial; 0 = no reconectar
+  int reconnect_max_ms = 30000;
+  size_t max_output_bytes = 1 << 20;  // Publish() rechaza mensajes si el socket no drena
+};
+
+class MqttClient {
+ public:
+  MqttClient(EventLoop& loop, MqttOptions options);
+  ~MqttClient();
+  MqttClient(const MqttClient&) = delete;
+  MqttClient& operator=(const MqttClient&) = delete;
+
+  // Conexión asíncrona: on_connect se llama al recibir CONNACK aceptado
+  void Connect();
+  // Cierre ordenado (DISCONNECT): el broker no publica el last will y no se reconecta
+  void Disconnect();
+  // Cierre abrupto del socket sin DISCONNECT: el broker publicará el last will
+  void Drop();
+
+  bool connected() const { return state_ == kConnected; }
+  const MqttOptions& options() const { return options_; }
+  size_t pending_output() const { return out_.size() - out_pos_; }
+
+  // Devuelven false si no hay sesión o el buffer de salida está lleno
+  bool Subscribe(const std::string& filter, int qos);
+  // packet_id recibe el id del mensaje QoS 1 (para correlacionar con on_puback)
+  bool Publish(const std::string& topic, const char* payload, size_t length, int qos, bool retain,
+               uint16_t* packet_id = nullptr);
+  bool Publish(const std::string& topic, const std::string& payload, int qos, bool retain) {
+    return Publish(topic, payload.data(), payload.size(), qos, retain);
+  }
+
+  std::function<void()> on_connect;
+  std::function<void(const std::string& reason)> on_disconnect;
+  std::function<void(const std::string& topic, const char* payload, size_t length)> on_message;
+  std::function<void(uint16_t packet_id)> on_puback;
+
+  // Filtros con comodines + y # según MQTT 3.1.1
+  static bool TopicMatches(const std::string& filter, const std::string& topic);
+
+ private:
+  enum State { kIdle, kConnecting, kAwaitingConnack, kConnected };
+
+  EventLoop& loop_;
+  MqttOptions options_;
+  State state_ = kIdle;
+  int fd_ = -1;
+  bool stopped_ = false;  // Disconnect() explícito: no reconectar
+  bool want_write_ = false;
+  uint16_t next_packet_id_ = 1;
+  int backoff_ms_ = 0;
+  int64_t last_sent_ms_ = 0;
+  int64_t last_received_ms_ = 0;
+  EventLoop::TimerId keepalive_timer_ = 0;
+  EventLoop::TimerId reconnect_timer_ = 0;
+  std::string in_;
+  std::string out_;
+  size_t out_pos_ = 0;
+
+  void OnEvents(uint32_t events);
+  void OnSocketConnected();
+  void ReadAvailable();
+  void FlushOutput();
+  bool ParsePackets();
+  void HandlePacket(uint8_t header, const char* body, size_t length);
+  void Close(const std::string& reason, bool reconnect);
+  void ScheduleReconnect();
+  void QueuePacket(uint8_t header, const std::string& body);
+  uint16_t NextPacketId();
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_TOOLS_MQTT_CLIENT_H_
@@ -0,0 +1,161 @@
+#include "adaptive_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "adaptive_control.h"
+#include "check.h"
+
+namespace dropster {
+namespace {
+
+const int64_t kStepMs = 10000;            // Muestreo del control
+const int64_t kDayMs = 86400000;
+const double kCompressorKw = 0.45;        // Consumo medio con el ciclo de trabajo del control
+const double kEtaMax = 1.8;               // L/kWh en el óptimo con AH = kAhRef
+const double kAhRef = 12.0;               // g/m3
+const double kVolumeNoiseL = 0.03;        // Ruido del sensor ultrasónico
+const int64_t kPumpEveryMs = 3 * kDayMs;
+const int64_t kPumpRunMs = 300000;
+
+// Curvatura de la eficiencia alrededor del óptimo (1/°C²) por parámetro
+const double kCurvature[ADAPT_PARAM_COUNT] = {0.08, 0.06, 0.10, 0.12};
+
+// Defaults del modo PID (config.h): punto de partida sin datos guardados
+const float kPidDefaults[ADAPT_PARAM_COUNT] = {0.0f, 3.0f, 1.0f, 0.5f};  // CONTROL_DEADBAND_DEFAULT, EVAP_FAN_TEMP_*_OFFSET_DEFAULT
+
+struct Plant {
+  double optimum[ADAPT_PARAM_COUNT];
+  double volumeL = 0.0;
+  double energyKWh = 0.0;
+  uint32_t rng = 12345;
+
+  // Fracción de la eficiencia máxima con los parámetros aplicados
+  double Factor(const AdaptiveController& c, bool base) const {
+    double loss = 0.0;
+    for (int i = 0; i < ADAPT_PARAM_COUNT; i++) {
+      double p = base ? c.base((AdaptParam)i) : c.param((AdaptParam)i);
+      loss += kCurvature[i] * (p - optimum[i]) * (p - optimum[i]);
+    }
+    return exp(-loss);
+  }
+
+  // Ruido uniforme de varianza kVolumeNoiseL² (LCG determinista)
+  double Noise() {
+    rng = rng * 1664525u + 1013904223u;
+    return ((double)(rng >> 8) / 16777216.0 - 0.5) * kVolumeNoiseL * 3.4641;
+  }
+};
+
+double AbsHumidity(int64_t tMs) {
+  return kAhRef + 3.0 * sin(2.0 * M_PI * (double)(tMs % kDayMs) / (double)kDayMs);
+}
+
+struct RunStats {
+  int updates = 0;
+  int rejected = 0;
+};
+
+// Simula de fromMs a toMs alimentando update() como lo hace processControl()
+RunStats Simulate(Plant& plant, AdaptiveController& c, int64_t fromMs, int64_t toMs, int64_t energyResetAtMs) {
+  RunStats stats;
+  uint16_t rejectedBefore = c.rejectedWindows();
+  for (int64_t t = fromMs; t < toMs; t += kStepMs) {
+    bool pumpOn = (t % kPumpEveryMs) < kPumpRunMs && t >= kPumpEveryMs;
+    double ah = AbsHumidity(t);
+    double dE = kCompressorKw * (double)kStepMs / 3600000.0;
+    plant.energyKWh += dE;
+    plant.volumeL += kEtaMax * plant.Factor(c, false) * ah / kAhRef * dE;
+    if (pumpOn) plant.volumeL = 0.0;
+    if (energyResetAtMs >= 0 && t >= energyResetAtMs && t < energyResetAtMs + kStepMs) plant.energyKWh = 0.0;
+    AdaptEvent evt = c.update((uint32_t)t, (float)(plant.volumeL + plant.Noise()), (float)plant.energyKWh, (float)ah, pumpOn);
+    if (evt == ADAPT_EVT_PARAMS_UPDATED) stats.updates++;
+  }
+  stats.rejected = c.rejectedWindows() - rejectedBefore;
+  return stats;
+}
+
+void PrintParams(const char* label, const AdaptiveController& c, const Plant& plant) {
+  printf("    %-8s", label);
+  for (int i = 0; i < ADAPT_PARAM_COUNT; i++) {
+    printf(" %5.2f (óptimo %5.2f)", c.base((AdaptParam)i), plant.optimum[i]);
+  }
+  printf("  eficiencia %.1f %%\n", 100.0 * plant.Factor(c, true));
+}
+
+// La base debe quedar a menos de una perturbación del óptimo en cada parámetro
+void ExpectConverged(Check& check, const char* scenario, const AdaptiveController& c, const Plant& plant) {
+  for (int i = 0; i < ADAPT_PARAM_COUNT; i++) {
+    double err = fabs(c.base((AdaptParam)i) - plant.optimum[i]);
+    check.Expect(err <= ADAPT_PARAM_DELTA[i] + 1e-4,
+                 std::string(scenario) + ": parámetro " + std::to_string(i) + " lejos del óptimo");
+  }
+  check.Expect(plant.Factor(c, true) >= 0.95, std::string(scenario) + ": eficiencia < 95 % del óptimo");
+}
+
+void FromDefaults(Check& check) {
+  Plant plant = {{-1.5, 2.0, 2.0, 1.1}};
+  AdaptiveController c;
+  c.begin(kPidDefaults);
+  RunStats stats = Simulate(plant, c, 0, 40 * kDayMs, 20 * kDayMs + 7200000);
+  printf("  desde los defaults PID, 40 días: %d iteraciones, %d ventanas descartadas (último motivo %s)\n",
+         stats.updates, stats.rejected, c.lastRejectReason());
+  PrintParams("base", c, plant);
+  ExpectConverged(check, "defaults", c, plant);
+  // 13 bombeos y un reinicio de energía: cada uno descarta al menos una ventana
+  check.Expect(stats.rejected >= 14, "defaults: ventanas con bomba o reinicio de energía no descartadas");
+  check.Expect(c.efficiency() > 0.0f && !isnan(c.efficiency()), "defaults: sin eficiencia publicada");
+}
+
+void FromCorner(Check& check) {
+  Plant plant = {{-1.5, 2.0, 2.0, 1.1}};
+  AdaptiveController c;
+  const float corner[ADAPT_PARAM_COUNT] = {2.0f, 6.0f, 0.0f, 0.0f};
+  c.begin(corner);
+  RunStats stats = Simulate(plant, c, 0, 40 * kDayMs, -1);
+  printf("  desde el extremo opuesto, 40 días: %d iteraciones\n", stats.updates);
+  PrintParams("base", c, plant);
+  ExpectConverged(check, "extremo", c, plant);
+}
+
+// Cambio de estación: el óptimo se mueve y el control lo sigue. Cruza el desborde de millis()
+void Tracking(Check& check) {
+  Plant plant = {{-1.5, 2.0, 2.0, 1.1}};
+  AdaptiveController c;
+  c.begin(kPidDefaults);
+  Simulate(plant, c, 0, 40 * kDayMs, -1);
+  plant.optimum[0] = 0.5;
+  plant.optimum[1] = 4.0;
+  plant.optimum[2] = 1.0;
+  plant.optimum[3] = 0.4;
+  RunStats stats = Simulate(plant, c, 40 * kDayMs, 80 * kDayMs, -1);
+  printf("  óptimo movido el día 40, 40 días más: %d iteraciones\n", stats.updates);
+  PrintParams("base", c, plant);
+  ExpectConverged(check, "seguimiento", c, plant);
+}
+
+void Benchmark() {
+  AdaptiveController c;
+  c.begin(kPidDefaults);
+  double ns = NsPerCall(2000000, [&](long i) {
+    c.update((uint32_t)(i * kStepMs), 0.001f * (float)i, 0.00125f * (float)i, 12.0f, false);
+  });
+  KeepValue(c);
+  printf("  update() %.1f ns/llamada\n", ns);
+}
+
+}  // namespace
+
+int RunAdaptiveCheck() {
+  Check check("adaptive");
+  FromDefaults(check);
+  FromCorner(check);
+  Tracking(check);
+  Benchmark();
+  return check.Report();
+}
+
+}  // namespace dropster
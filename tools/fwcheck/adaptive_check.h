@@ -0,0 +1,20 @@
+#ifndef DROPSTER_FWCHECK_ADAPTIVE_CHECK_H_
+#define DROPSTER_FWCHECK_ADAPTIVE_CHECK_H_
+
+// Evaluación de adaptive_control.h contra un modelo de planta (dropster-fwcheck adaptive).
+//
+// La planta produce agua a razón de eta(p) * AH / AH_ref litros por kWh, con eta máxima en un
+// óptimo conocido de los cuatro parámetros y cayendo de forma cuadrática en el exponente a su
+// alrededor. La humedad absoluta sigue un ciclo diario, el sensor de volumen tiene ruido, la
+// bomba vacía el tanque cada tres días y el contador de energía se reinicia una vez. Se verifica
+// que la base aprendida termine a menos de una perturbación del óptimo, también tras moverlo,
+// y que las ventanas contaminadas se descarten.
+
+namespace dropster {
+
+// Devuelve 0 si todos los escenarios convergen
+int RunAdaptiveCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_ADAPTIVE_CHECK_H_
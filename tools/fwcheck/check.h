@@ -0,0 +1,53 @@
+#ifndef DROPSTER_FWCHECK_CHECK_H_
+#define DROPSTER_FWCHECK_CHECK_H_
+
+// Resultado de una verificación de dropster-fwcheck: cada Expect() fallido queda anotado
+// y Report() imprime el resumen con el mismo formato que dropster-sim safety.
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace dropster {
+
+class Check {
+ public:
+  explicit Check(const char* name) : name_(name) {}
+
+  bool Expect(bool ok, const std::string& what) {
+    if (!ok) failures_.push_back(what);
+    return ok;
+  }
+
+  // Imprime el resultado y devuelve el código de salida
+  int Report() const {
+    for (const std::string& what : failures_) printf("  FALLO: %s\n", what.c_str());
+    printf("  resultado de %s: %s\n", name_, failures_.empty() ? "OK" : "FALLO");
+    return failures_.empty() ? 0 : 1;
+  }
+
+ private:
+  const char* name_;
+  std::vector<std::string> failures_;
+};
+
+// ns por llamada de `fn` repetida `iterations` veces
+template <typename Fn>
+double NsPerCall(long iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) fn(i);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / (double)iterations;
+}
+
+// Evita que el compilador descarte un resultado medido
+template <typename T>
+inline void KeepValue(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_CHECK_H_
@@ -0,0 +1,257 @@
+#include "duty_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "duty_scheduler.h"
+
+namespace dropster {
+namespace {
+
+const int64_t kStepSec = 10;           // DUTY_SAMPLE_INTERVAL
+const uint32_t kOnSec = 900;           // TIME_MODE_COMPRESSOR_ON_TIME_DEFAULT
+const uint32_t kOffSec = 450;          // TIME_MODE_COMPRESSOR_OFF_TIME_DEFAULT
+const uint32_t kMinOffSec = 120;       // CONTROL_MIN_OFF_DEFAULT
+const float kBudgetHours = 16.0f;      // DUTY_BUDGET_HOURS_DEFAULT
+const double kPumpAtL = 10.0;          // El tanque se vacía al llegar a este volumen
+const double kVolumeNoiseL = 0.02;
+const int kSyntheticDays = 14;
+
+// Humedad absoluta por hora desde el inicio de la traza (g/m3)
+struct Trace {
+  std::vector<double> hourly;
+
+  int Days() const { return (int)(hourly.size() / 24); }
+
+  double At(int64_t sec) const {
+    double h = (double)sec / 3600.0;
+    size_t i = (size_t)h;
+    if (i + 1 >= hourly.size()) return hourly.back();
+    double f = h - (double)i;
+    return hourly[i] * (1.0 - f) + hourly[i + 1] * f;
+  }
+};
+
+uint32_t NextRandom(uint32_t& state) {
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+// Ciclo diario (máximo al amanecer, mínimo a media tarde), variación entre días y una racha húmeda
+Trace SyntheticTrace() {
+  Trace trace;
+  uint32_t rng = 2024;
+  for (int d = 0; d < kSyntheticDays; d++) {
+    double dayOffset = ((double)NextRandom(rng) / 16777216.0 - 0.5) * 3.0;
+    if (d >= 6 && d < 9) dayOffset += 4.0;
+    for (int h = 0; h < 24; h++) {
+      double daily = 5.0 * cos(2.0 * M_PI * (h - 5) / 24.0);
+      double noise = ((double)NextRandom(rng) / 16777216.0 - 0.5) * 1.0;
+      trace.hourly.push_back(14.0 + daily + dayOffset + noise);
+    }
+  }
+  return trace;
+}
+
+// Litros por hora de compresor: el evaporador no condensa por debajo de ~6 g/m3
+double YieldRate(double absHumidity) {
+  return absHumidity > 6.0 ? 0.11 * (absHumidity - 6.0) : 0.0;
+}
+
+struct ReplayResult {
+  std::vector<double> water;        // L por día
+  std::vector<double> runtimeHours; // Horas de compresor por día
+  std::vector<double> expected;     // Litros esperados al empezar cada día (NAN sin plan)
+  double runtimeByHour[DUTY_HOURS] = {0};
+  double total(int fromDay) const {
+    double sum = 0.0;
+    for (size_t d = (size_t)fromDay; d < water.size(); d++) sum += water[d];
+    return sum;
+  }
+};
+
+// El ciclo de MODE_AUTO_TIME de processControl(), con o sin planificador
+ReplayResult Replay(const Trace& trace, bool scheduled, const DutyTariff* tariff) {
+  ReplayResult result;
+  int days = trace.Days();
+  result.water.assign(days, 0.0);
+  result.runtimeHours.assign(days, 0.0);
+  result.expected.assign(days, NAN);
+
+  DutyScheduler scheduler;
+  scheduler.begin(kBudgetHours);
+  if (tariff) scheduler.setTariff(0, tariff->startHour, tariff->endHour, tariff->weight);
+
+  uint32_t rng = 77;
+  double volume = 0.0;
+  bool compressorOn = false;
+  int64_t cycleStart = -1;
+  for (int64_t t = 0; t < (int64_t)days * 86400; t += kStepSec) {
+    int day = (int)(t / 86400);
+    uint32_t secondOfDay = (uint32_t)(t % 86400);
+    double ah = trace.At(t);
+    bool pumpOn = volume >= kPumpAtL;
+    if (pumpOn) volume = 0.0;
+    float noisy = (float)(volume + ((double)NextRandom(rng) / 16777216.0 - 0.5) * 2.0 * kVolumeNoiseL);
+    scheduler.sample(secondOfDay, (uint32_t)day, t == 0 ? 0.0f : (float)kStepSec, (float)ah, noisy, compressorOn, pumpOn);
+    if (secondOfDay == 0 && scheduler.ready()) result.expected[day] = scheduler.expectedToday();
+
+    bool planned = scheduled && scheduler.ready();
+    uint64_t offSec = kOffSec;
+    if (planned) offSec = scheduler.offTimeSec(kOnSec, kMinOffSec);
+    if (cycleStart < 0) {
+      cycleStart = t;
+      compressorOn = !(planned && offSec == UINT32_MAX);
+    } else {
+      uint64_t target = compressorOn ? kOnSec : offSec;
+      if ((uint64_t)(t - cycleStart) >= target) {
+        compressorOn = !compressorOn;
+        cycleStart = t;
+      }
+    }
+
+    if (compressorOn) {
+      volume += YieldRate(ah) * (double)kStepSec / 3600.0;
+      result.water[day] += YieldRate(ah) * (double)kStepSec / 3600.0;
+      result.runtimeHours[day] += (double)kStepSec / 3600.0;
+      result.runtimeByHour[secondOfDay / 3600] += (double)kStepSec / 3600.0;
+    }
+  }
+  return result;
+}
+
+// Presupuesto respetado todos los días (un ciclo de encendido de tolerancia en el corte)
+void ExpectBudget(Check& check, const char* label, const ReplayResult& r) {
+  double worst = 0.0;
+  for (double hours : r.runtimeHours) worst = hours > worst ? hours : worst;
+  printf("  %s: máximo %.2f h de compresor en un día (presupuesto %.1f h)\n", label, worst, kBudgetHours);
+  check.Expect(worst <= kBudgetHours + kOnSec / 3600.0, std::string(label) + ": presupuesto diario excedido");
+}
+
+void Compare(Check& check, const Trace& trace, bool strict) {
+  ReplayResult fixed = Replay(trace, false, nullptr);
+  ReplayResult planned = Replay(trace, true, nullptr);
+  // El primer día solo construye el perfil: se compara desde el segundo
+  double fixedL = fixed.total(1), plannedL = planned.total(1);
+  double gain = fixedL > 0.0 ? 100.0 * (plannedL / fixedL - 1.0) : 0.0;
+  printf("  %d días: ciclo fijo %.1f L, planificado %.1f L (%+.1f %%) con el mismo presupuesto\n",
+         trace.Days(), fixedL, plannedL, gain);
+  ExpectBudget(check, "planificado", planned);
+
+  double errSum = 0.0;
+  int errDays = 0;
+  for (size_t d = 1; d < planned.water.size(); d++) {
+    if (isnan(planned.expected[d]) || planned.water[d] <= 0.0) continue;
+    errSum += fabs(planned.expected[d] - planned.water[d]) / planned.water[d];
+    errDays++;
+  }
+  double meanErr = errDays > 0 ? 100.0 * errSum / errDays : 0.0;
+  printf("  litros esperados al empezar el día frente a logrados: error medio %.1f %% en %d días\n", meanErr, errDays);
+  if (!strict) return;
+
+  check.Expect(gain >= 5.0, "planificado no supera al ciclo fijo en al menos 5 %");
+  // El perfil no anticipa el cambio de clima entre días (±1.5 g/m3 y la racha húmeda)
+  check.Expect(errDays >= kSyntheticDays - 2 && meanErr <= 25.0, "litros esperados lejos de los logrados");
+}
+
+// Una ventana cara de 18 a 22 h debe recibir menos horas de compresor
+void Tariff(Check& check, const Trace& trace) {
+  DutyTariff expensive;
+  expensive.startHour = 18;
+  expensive.endHour = 22;
+  expensive.weight = 3.0f;
+  ReplayResult plain = Replay(trace, true, nullptr);
+  ReplayResult priced = Replay(trace, true, &expensive);
+  double plainPeak = 0.0, pricedPeak = 0.0;
+  for (int h = 18; h < 22; h++) {
+    plainPeak += plain.runtimeByHour[h];
+    pricedPeak += priced.runtimeByHour[h];
+  }
+  printf("  tarifa x3 de 18 a 22 h: %.1f h de compresor en la ventana, %.1f h sin tarifa\n", pricedPeak, plainPeak);
+  ExpectBudget(check, "con tarifa", priced);
+  check.Expect(pricedPeak < 0.5 * plainPeak, "la ventana cara no reduce las horas de compresor");
+}
+
+// Un resto mínimo del presupuesto deja una fracción residual en las horas siguientes: el
+// apagado derivado no puede desbordar uint32 (ni los ms del firmware) y la hora no arranca
+void Residual(Check& check) {
+  DutyScheduler scheduler;
+  DutyProfile profile;
+  for (int h = 0; h < DUTY_HOURS; h++) profile.absHumidity[h] = 10.0f;
+  scheduler.begin(1.0f, &profile);
+  scheduler.sample(0, 0, 0.0f, NAN, NAN, true, false);
+  for (uint32_t s = 599; s <= 6 * 599; s += 599) scheduler.sample(s, 0, 599.0f, NAN, NAN, true, false);
+  scheduler.sample(3599, 0, 5.9997f, NAN, NAN, true, false);  // 3599.9998 s: queda 1 ulp de float
+  scheduler.sample(3600, 0, 1.0f, NAN, NAN, false, false);    // Nueva hora: replanifica con el resto
+  float duty = scheduler.currentDuty();
+  uint32_t offSec = scheduler.offTimeSec(kOnSec, kMinOffSec);
+  printf("  resto del presupuesto: fracción %.3g, apagado %s\n", duty,
+         offSec == UINT32_MAX ? "sin asignación" : std::to_string(offSec).c_str());
+  check.Expect(duty > 0.0f && duty < 1e-6f, "el escenario no deja una fracción residual");
+  check.Expect(offSec == UINT32_MAX, "una fracción residual no se trata como hora sin asignación");
+
+  // Fracciones válidas: el apagado queda acotado y cabe en ms
+  DutyScheduler low;
+  low.begin(0.5f, &profile);
+  low.sample(3000, 0, 0.0f, NAN, NAN, false, false);  // 600 s de hora: 0.5 h no caben, fracción máxima
+  uint32_t longOn = low.offTimeSec(UINT32_MAX / 2, kMinOffSec);
+  check.Expect(longOn <= (uint32_t)DUTY_MAX_OFF_SEC, "apagado sin acotar con ciclos largos");
+}
+
+bool LoadTrace(const char* path, Trace& trace) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  // Promedio por hora de las muestras de cada hora
+  std::vector<double> sum, count;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    double sec, ah;
+    if (sscanf(line, "%lf,%lf", &sec, &ah) != 2 || sec < 0.0 || isnan(ah)) continue;
+    size_t hour = (size_t)(sec / 3600.0);
+    if (hour >= sum.size()) {
+      sum.resize(hour + 1, 0.0);
+      count.resize(hour + 1, 0.0);
+    }
+    sum[hour] += ah;
+    count[hour] += 1.0;
+  }
+  fclose(f);
+  // Horas sin muestras heredan la anterior; se descarta el día final incompleto
+  double last = NAN;
+  for (size_t h = 0; h < sum.size(); h++) {
+    if (count[h] > 0.0) last = sum[h] / count[h];
+    if (!isnan(last)) trace.hourly.push_back(last);
+  }
+  trace.hourly.resize((trace.hourly.size() / 24) * 24);
+  return trace.Days() >= 2;
+}
+
+}  // namespace
+
+int RunDutyCheck() {
+  Check check("duty");
+  Trace trace = SyntheticTrace();
+  Compare(check, trace, true);
+  Tariff(check, trace);
+  Residual(check);
+  return check.Report();
+}
+
+int RunDutyReplay(const char* tracePath) {
+  Trace trace;
+  if (!LoadTrace(tracePath, trace)) {
+    fprintf(stderr, "no se pudo leer una traza de al menos 2 días en %s\n", tracePath);
+    return 2;
+  }
+  Check check("duty");
+  Compare(check, trace, false);
+  return check.Report();
+}
+
+}  // namespace dropster
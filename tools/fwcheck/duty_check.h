@@ -0,0 +1,24 @@
+#ifndef DROPSTER_FWCHECK_DUTY_CHECK_H_
+#define DROPSTER_FWCHECK_DUTY_CHECK_H_
+
+// Reproducción de trazas meteorológicas de varios días sobre duty_scheduler.h
+// (dropster-fwcheck duty [traza.csv]).
+//
+// Un AWG simulado corre MODE_AUTO_TIME como processControl(): ciclo fijo de 900/450 s o,
+// con el perfil listo, tiempo apagado derivado de la asignación horaria (una hora sin
+// asignación deja el compresor apagado). La producción por hora de compresor crece con la
+// humedad absoluta de la traza. Sin argumento se usa una traza sintética de 14 días y se
+// verifica que el mismo presupuesto produzca más agua que el ciclo fijo, que no se exceda el
+// presupuesto diario, que una ventana de tarifa cara reciba menos horas y que los litros
+// esperados al empezar el día se acerquen a los logrados. Con una traza grabada (CSV de
+// `segundo,humedad_absoluta`) solo se verifica el presupuesto y se informa la comparación.
+
+namespace dropster {
+
+// Devuelve 0 si todas las verificaciones se cumplen
+int RunDutyCheck();
+int RunDutyReplay(const char* tracePath);
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_DUTY_CHECK_H_
@@ -0,0 +1,313 @@
+#include "ingest_check.h"
+
+#include <locale.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mqtt_ingest_batcher.h"
+#include "mqtt_ingest_decoder.h"
+
+namespace dropster {
+namespace {
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+bool Parse(const char* text, double* out) {
+  return IngestParseNumber(text, strlen(text), out);
+}
+
+IngestRecord Blank(const char* device) {
+  IngestRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  IngestCopyDevice(rec.device, device, strlen(device));
+  return rec;
+}
+
+IngestRecord Data(const char* device, double temp) {
+  IngestRecord rec = Blank(device);
+  rec.kind = INGEST_KIND_DATA;
+  rec.values[INGEST_DATA_T] = temp;
+  rec.present = 1u << INGEST_DATA_T;
+  return rec;
+}
+
+const IngestRecord* RecordAt(const uint8_t* batch, uint32_t i) {
+  return (const IngestRecord*)(batch + sizeof(IngestBatchHeader) + i * sizeof(IngestRecord));
+}
+
+// Números JSON y cadenas numéricas, también con coma decimal en la configuración regional
+void Numbers(Scenario& sc) {
+  const struct {
+    const char* text;
+    double value;
+  } good[] = {
+      {"21.5", 21.5}, {"-3.25e2", -325.0}, {"1e-3", 0.001}, {" 7 ", 7.0},
+      {"+0.50", 0.5}, {"12345678901234567890123", 1.2345678901234568e22}, {"2.5E+1", 25.0},
+  };
+  const char* bad[] = {"", "abc", "1.2x", "1e", "-", ".", "1 2"};
+  // GTK llama setlocale(): con coma decimal strtod leería "21" de "21.5"
+  const char* spanish = setlocale(LC_NUMERIC, "es_ES.UTF-8");
+  for (int pass = 0; pass < 2; pass++) {
+    for (const auto& g : good) {
+      double v = NAN;
+      sc.Expect(Parse(g.text, &v) && fabs(v - g.value) <= fabs(g.value) * 1e-15,
+                std::string("\"") + g.text + "\" mal interpretado");
+    }
+    for (const char* b : bad) {
+      double v;
+      sc.Expect(!Parse(b, &v), std::string("\"") + b + "\" aceptado como número");
+    }
+    if (!spanish) break;
+    setlocale(LC_NUMERIC, "C");
+  }
+}
+
+// Tópicos globales, con dispositivo, tópico de datos configurado e identificadores largos
+void Topics(Scenario& sc) {
+  char device[INGEST_DEVICE_LEN];
+  sc.Expect(IngestClassifyTopic("dropster/data", "dropster/data", device) == INGEST_TOPIC_DATA &&
+                strcmp(device, INGEST_DEFAULT_DEVICE) == 0,
+            "dropster/data no es datos del dispositivo por defecto");
+  sc.Expect(IngestClassifyTopic("dropster/awg-a1b2c3/status", "dropster/data", device) == INGEST_TOPIC_STATUS &&
+                strcmp(device, "awg-a1b2c3") == 0,
+            "estado con dispositivo mal clasificado");
+  sc.Expect(IngestClassifyTopic("dropster/awg-a1b2c3/alerts", nullptr, device) == INGEST_TOPIC_ALERTS,
+            "alertas mal clasificadas");
+  sc.Expect(IngestClassifyTopic("dropster/awg-a1b2c3/data", "dropster/data", device) == INGEST_TOPIC_DATA,
+            "datos con dispositivo mal clasificados");
+  sc.Expect(IngestClassifyTopic("dropster/control", "dropster/data", device) == INGEST_TOPIC_OTHER,
+            "control clasificado como datos");
+  sc.Expect(IngestClassifyTopic("casa/sensores", "casa/sensores", device) == INGEST_TOPIC_DATA &&
+                strcmp(device, INGEST_DEFAULT_DEVICE) == 0,
+            "tópico de datos configurado no reconocido");
+  std::string longTopic = "dropster/" + std::string(60, 'x') + "/data";
+  IngestClassifyTopic(longTopic.c_str(), nullptr, device);
+  sc.Expect(strlen(device) == INGEST_DEVICE_LEN - 1, "identificador largo no truncado");
+}
+
+// dropster/data: comillas, booleanos, anidados, identificador en el payload y JSON inválido
+void DecodeData(Scenario& sc) {
+  const char* payload =
+      "{\"t\":\"21.50\", \"h\":55,\"cs\":true,\"id\":\"awg-01\",\"extra\":{\"a\":[1,\"}\"]},"
+      "\"x\":null,\"calibrated\":false}";
+  IngestRecord rec = Blank("dropster");
+  sc.Expect(IngestDecodeData(payload, strlen(payload), &rec), "payload válido rechazado");
+  uint32_t expected = (1u << INGEST_DATA_T) | (1u << INGEST_DATA_H) | (1u << INGEST_DATA_CS) |
+                      (1u << INGEST_DATA_CALIBRATED);
+  sc.Expect(rec.present == expected, "campos presentes incorrectos");
+  sc.Expect(rec.values[INGEST_DATA_T] == 21.5 && rec.values[INGEST_DATA_H] == 55.0 &&
+                rec.values[INGEST_DATA_CS] == 1.0 && rec.values[INGEST_DATA_CALIBRATED] == 0.0,
+            "valores decodificados incorrectos");
+  sc.Expect(strcmp(rec.device, "awg-01") == 0, "\"id\" del payload no reemplaza al dispositivo");
+  const char* broken[] = {"{\"t\":", "{\"t\" 1}", "[1,2]", "{\"t\":1,}", "{\"t\":1"};
+  for (const char* b : broken) {
+    IngestRecord r = Blank("dropster");
+    sc.Expect(!IngestDecodeData(b, strlen(b), &r), std::string("JSON inválido aceptado: ") + b);
+  }
+}
+
+// dropster/status: JSON de estado, mensajes simples heredados y mensajes que viajan como eventos
+void DecodeStatus(Scenario& sc) {
+  IngestRecord rec = Blank("dropster");
+  const char* json = "{\"compressor\":1,\"pump\":\"0\",\"mode\":\"AUTO_PID\",\"uptime\":3600}";
+  sc.Expect(IngestDecodeStatus(json, strlen(json), &rec) && rec.values[INGEST_STATUS_MODE] == 2 &&
+                rec.values[INGEST_STATUS_COMPRESSOR] == 1 && rec.values[INGEST_STATUS_PUMP] == 0 &&
+                rec.values[INGEST_STATUS_UPTIME] == 3600,
+            "estado JSON mal decodificado");
+  rec = Blank("dropster");
+  sc.Expect(IngestDecodeStatus("AUTO_COMP_OFF", 13, &rec) && rec.present == (1u << INGEST_STATUS_COMPRESSOR) &&
+                rec.values[INGEST_STATUS_COMPRESSOR] == 0,
+            "mensaje simple heredado no decodificado");
+  const char* events[] = {"{\"type\":\"config_ack\",\"ok\":true}", "{\"mode\":\"TURBO\"}", "{}",
+                          "{\"uptime\":\"n/a\"}", "hola"};
+  for (const char* e : events) {
+    IngestRecord r = Blank("dropster");
+    sc.Expect(!IngestDecodeStatus(e, strlen(e), &r), std::string("no es estado y se coalesce: ") + e);
+  }
+}
+
+// Cabecera, registros coalescidos, desplazamiento del texto de los eventos y lote vacío
+void BatchLayout(Scenario& sc) {
+  IngestBatcher batcher;
+  sc.Expect(batcher.AddState(Data("a", 20.0), 100), "el primer mensaje no avisa lote nuevo");
+  IngestRecord humid = Blank("a");
+  humid.kind = INGEST_KIND_DATA;
+  humid.values[INGEST_DATA_H] = 60.0;
+  humid.present = 1u << INGEST_DATA_H;
+  sc.Expect(!batcher.AddState(humid, 100), "un lote pendiente vuelve a avisar");
+  batcher.AddState(Data("a", 21.0), 100);
+  IngestRecord status = Blank("a");
+  status.kind = INGEST_KIND_STATUS;
+  status.present = 1u << INGEST_STATUS_PUMP;
+  status.values[INGEST_STATUS_PUMP] = 1;
+  batcher.AddState(status, 100);
+  batcher.AddEvent("a", INGEST_TOPIC_ALERTS, "alerta", 6, 1);
+  batcher.AddEvent("b", INGEST_TOPIC_STATUS, "{\"type\":\"x\"}", 12, 2);
+
+  uint32_t size = 0;
+  const uint8_t* batch = batcher.Take(&size);
+  if (!batch) {
+    sc.Expect(false, "Take() sin lote");
+    return;
+  }
+  IngestBatchHeader header;
+  memcpy(&header, batch, sizeof(header));
+  sc.Expect(header.magic == INGEST_BATCH_MAGIC && header.version == INGEST_BATCH_VERSION &&
+                header.record_size == sizeof(IngestRecord) && header.sequence == 1,
+            "cabecera incorrecta");
+  sc.Expect(header.record_count == 4 && header.messages == 6 && header.dropped_events == 0,
+            "conteos de la cabecera incorrectos");
+  sc.Expect(header.total_bytes == size && size == sizeof(header) + 4 * sizeof(IngestRecord) + 18,
+            "tamaño del lote incorrecto");
+  const IngestRecord* data = RecordAt(batch, 0);
+  sc.Expect(data->kind == INGEST_KIND_DATA && data->merged == 3 && data->values[INGEST_DATA_T] == 21.0 &&
+                data->values[INGEST_DATA_H] == 60.0 &&
+                data->present == ((1u << INGEST_DATA_T) | (1u << INGEST_DATA_H)),
+            "datos coalescidos incorrectos");
+  sc.Expect(RecordAt(batch, 1)->kind == INGEST_KIND_STATUS, "estado fuera de su lugar");
+  const IngestRecord* second = RecordAt(batch, 3);
+  sc.Expect(second->kind == INGEST_KIND_EVENT && second->text_offset + second->text_len <= size &&
+                memcmp(batch + second->text_offset, "{\"type\":\"x\"}", 12) == 0 &&
+                memcmp(batch + RecordAt(batch, 2)->text_offset, "alerta", 6) == 0,
+            "texto de los eventos fuera de lugar");
+  IngestStats stats = batcher.stats();
+  sc.Expect(stats.messages == 6 && stats.coalesced == 2 && stats.events == 2 && stats.batches == 1,
+            "estadísticas incorrectas");
+  sc.Expect(batcher.Take(&size) == nullptr && size == 0, "Take() sin pendientes devuelve un lote");
+}
+
+// Más de INGEST_MAX_EVENTS eventos, eventos demasiado largos y la tabla de dispositivos llena
+void Overflow(Scenario& sc) {
+  IngestBatcher batcher;
+  for (int i = 0; i < INGEST_MAX_EVENTS + 3; i++) batcher.AddEvent("a", INGEST_TOPIC_ALERTS, "x", 1, i);
+  std::string huge(INGEST_MAX_EVENT_LEN + 1, 'y');
+  batcher.AddEvent("a", INGEST_TOPIC_ALERTS, huge.c_str(), huge.size(), 0);
+  uint32_t size;
+  const uint8_t* batch = batcher.Take(&size);
+  IngestBatchHeader header;
+  memcpy(&header, batch, sizeof(header));
+  sc.Expect(header.record_count == INGEST_MAX_EVENTS && header.dropped_events == 4,
+            "eventos descartados: " + std::to_string(header.dropped_events) + " en vez de 4");
+
+  char name[16];
+  for (int i = 0; i < INGEST_MAX_DEVICES + 5; i++) {
+    snprintf(name, sizeof(name), "awg-%d", i);
+    batcher.AddState(Data(name, i), 0);
+  }
+  batcher.AddState(Data("awg-0", -1.0), 0);  // Ya pendiente: se coalesce aunque la tabla esté llena
+  batch = batcher.Take(&size);
+  memcpy(&header, batch, sizeof(header));
+  IngestStats stats = batcher.stats();
+  sc.Expect(header.record_count == INGEST_MAX_DEVICES && header.messages == INGEST_MAX_DEVICES + 6,
+            "registros con la tabla llena incorrectos");
+  sc.Expect(stats.dropped_states == 5 && stats.coalesced == 1,
+            "descartados " + std::to_string(stats.dropped_states) + " y coalescidos " +
+                std::to_string(stats.coalesced) + " en vez de 5 y 1");
+  sc.Expect(RecordAt(batch, 0)->values[INGEST_DATA_T] == -1.0, "dispositivo pendiente no actualizado");
+}
+
+// Cuatro hilos de red contra el hilo principal: nada se pierde sin contarse ni se cuenta dos veces
+void Threads(Scenario& sc) {
+  const int kProducers = 4;
+  const int kMessages = 20000;
+  IngestBatcher batcher;
+  std::atomic<int> running(kProducers);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&batcher, &running, p] {
+      char name[16];
+      for (int i = 0; i < kMessages; i++) {
+        if (i % 10 == 0) {
+          batcher.AddEvent("ev", INGEST_TOPIC_ALERTS, "e", 1, i);
+          continue;
+        }
+        snprintf(name, sizeof(name), "awg-%d", (p * 7 + i) % 8);
+        batcher.AddState(Data(name, i), 0);
+      }
+      running--;
+    });
+  }
+  uint64_t messages = 0;
+  uint64_t merged = 0;
+  uint64_t events = 0;
+  uint64_t dropped = 0;
+  uint32_t sequence = 0;
+  bool valid = true;
+  for (;;) {
+    bool done = running.load() == 0;
+    uint32_t size = 0;
+    const uint8_t* batch = batcher.Take(&size);
+    if (batch) {
+      IngestBatchHeader header;
+      memcpy(&header, batch, sizeof(header));
+      valid = valid && header.magic == INGEST_BATCH_MAGIC && header.total_bytes == size &&
+              header.sequence == ++sequence;
+      messages += header.messages;
+      dropped += header.dropped_events;
+      for (uint32_t i = 0; i < header.record_count; i++) {
+        const IngestRecord* rec = RecordAt(batch, i);
+        if (rec->kind == INGEST_KIND_EVENT) {
+          events++;
+          valid = valid && rec->text_offset + rec->text_len <= size && batch[rec->text_offset] == 'e';
+        } else {
+          merged += rec->merged;
+        }
+      }
+    } else if (done) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (std::thread& t : producers) t.join();
+  const uint64_t total = (uint64_t)kProducers * kMessages;
+  IngestStats stats = batcher.stats();
+  sc.Expect(valid, "lote con cabecera, secuencia o texto inválidos");
+  sc.Expect(messages == total && stats.messages == total, "mensajes perdidos o duplicados");
+  // Si el consumidor se atrasa más de INGEST_MAX_EVENTS eventos, el resto se descarta y se cuenta
+  sc.Expect(events + dropped == total / 10 && dropped == stats.dropped_events, "eventos perdidos o duplicados");
+  sc.Expect(merged == total - total / 10 && stats.dropped_states == 0, "datos perdidos o duplicados");
+}
+
+}  // namespace
+
+int RunIngestCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"números sin configuración regional", Numbers},
+      {"clasificación de tópicos", Topics},
+      {"decodificación de dropster/data", DecodeData},
+      {"decodificación de dropster/status", DecodeStatus},
+      {"formato del lote", BatchLayout},
+      {"desbordes de eventos y dispositivos", Overflow},
+      {"productores concurrentes", Threads},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
@@ -0,0 +1,18 @@
+#ifndef DROPSTER_FWCHECK_INGEST_CHECK_H_
+#define DROPSTER_FWCHECK_INGEST_CHECK_H_
+
+// Escenarios sobre la ingesta MQTT nativa del runner de Linux (dropster-fwcheck ingest).
+//
+// Compila mqtt_ingest_decoder.h y mqtt_ingest_batcher.h (linux/runner, sin GTK ni mosquitto)
+// y verifica el número independiente de la configuración regional, la clasificación de
+// tópicos, la decodificación de data/status, el formato del lote que lee Dart, los desbordes
+// de eventos y de dispositivos, y varios hilos productores contra Take().
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunIngestCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_INGEST_CHECK_H_
@@ -0,0 +1,193 @@
+#include "level_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <string>
+
+#include "check.h"
+#include "level_estimator.h"
+
+namespace dropster {
+namespace {
+
+const double kStepSec = 2.0;             // SENSOR_READ_INTERVAL
+const double kHours = 48.0;
+const double kLitresPerCm = 0.4;
+const double kEmptyDistanceCm = 60.0;    // Distancia del sensor al fondo
+const double kPingSigmaCm = 0.4;
+const double kEchoProbability = 0.03;
+const double kPumpFlowLph = 150.0;
+const double kPumpStartL = 15.0;
+const double kPumpStopL = 2.0;
+const double kExtractionAtH = 30.0;
+const double kExtractionL = 5.0;
+const double kOnSec = 900.0, kOffSec = 450.0;
+const double kOldEmaAlpha = 0.7;         // CONTROL_SMOOTHING_ALPHA
+const double kOldRateWindowSec = 600.0;
+// Tras la extracción y los bombeos ningún método sigue al nivel en el acto: esas muestras no cuentan
+const double kSettleSec = 120.0;
+
+// Cotas de la validación del filtro (L y L/h)
+const double kMaxVolumeRms = 0.05;
+const double kMaxRateRms = 0.4;
+const double kMaxPumpFlowError = 0.15;
+
+struct Random {
+  uint32_t state = 4242;
+  double Uniform() {
+    state = state * 1664525u + 1013904223u;
+    return ((double)(state >> 8) + 0.5) / 16777216.0;
+  }
+  double Gaussian() {
+    return sqrt(-2.0 * log(Uniform())) * cos(2.0 * M_PI * Uniform());
+  }
+};
+
+// Ping del sensor: distancia real con ruido, o un eco que cae en cualquier lado
+double Ping(Random& rng, double volume) {
+  double distance = kEmptyDistanceCm - volume / kLitresPerCm;
+  if (rng.Uniform() < kEchoProbability) return distance + (rng.Uniform() < 0.5 ? -1.0 : 1.0) * (5.0 + 25.0 * rng.Uniform());
+  return distance + kPingSigmaCm * rng.Gaussian();
+}
+
+double ToVolume(double distance) {
+  return (kEmptyDistanceCm - distance) * kLitresPerCm;
+}
+
+double Median3(double a, double b, double c) {
+  if (a > b) { double t = a; a = b; b = t; }
+  if (b > c) b = c;
+  return a > b ? a : b;
+}
+
+struct Rms {
+  double sum = 0.0;
+  long n = 0;
+  void Add(double err) { sum += err * err; n++; }
+  double Value() const { return n > 0 ? sqrt(sum / (double)n) : NAN; }
+};
+
+struct Result {
+  Rms volume, rate, oldVolume, oldRate;
+  bool extractionTracked = false;
+  uint16_t resets = 0;
+  uint32_t rejected = 0;
+  float pumpFlow = 0.0f;
+  int pumpCycles = 0;
+};
+
+Result Run() {
+  Result result;
+  Random rng;
+  LevelEstimator filter;
+  filter.begin();
+
+  double volume = 5.0, rate = 0.0;
+  bool compressorOn = true, pumpOn = false;
+  double cycleSec = 0.0, quietUntil = 0.0;
+  double oldDistance = NAN;
+  std::deque<double> oldHistory;  // Volumen viejo de los últimos 10 min, un valor por paso
+  bool extracted = false;
+
+  for (double t = 0.0; t < kHours * 3600.0; t += kStepSec) {
+    // El intervalo que termina lo rigieron los relés de antes (como updateLevelEstimate)
+    filter.predict((float)kStepSec, compressorOn, pumpOn);
+
+    // Planta: producción que varía en el día, decae al apagar; bomba por nivel
+    double target = 1.2 + 0.4 * sin(2.0 * M_PI * t / 86400.0);
+    if (compressorOn) rate += (target - rate) * (1.0 - exp(-kStepSec / 120.0));
+    else rate *= exp(-kStepSec / LEVEL_RATE_DECAY_S);
+    volume += rate * kStepSec / 3600.0;
+    if (pumpOn) volume -= kPumpFlowLph * kStepSec / 3600.0;
+    if (!extracted && t >= kExtractionAtH * 3600.0) {
+      volume -= kExtractionL;
+      extracted = true;
+      quietUntil = t + kSettleSec;
+    }
+
+    double p1 = Ping(rng, volume), p2 = Ping(rng, volume), p3 = Ping(rng, volume);
+    double median = Median3(p1, p2, p3);
+    double sigma = kLitresPerCm * LEVEL_DISTANCE_SIGMA_CM;
+    filter.update((float)ToVolume(median), (float)(sigma * sigma));
+
+    // Firmware anterior: promedio de 5 pings (ecos incluidos) en un EMA; tasa por diferencia a 10 min
+    double average = 0.0;
+    for (int i = 0; i < 5; i++) average += Ping(rng, volume);
+    average /= 5.0;
+    oldDistance = isnan(oldDistance) ? average : kOldEmaAlpha * average + (1.0 - kOldEmaAlpha) * oldDistance;
+    double oldVolume = ToVolume(oldDistance);
+    oldHistory.push_back(oldVolume);
+    size_t window = (size_t)(kOldRateWindowSec / kStepSec);
+    if (oldHistory.size() > window + 1) oldHistory.pop_front();
+
+    if (t > 600.0 && t >= quietUntil && !pumpOn) {
+      result.volume.Add(filter.volume() - volume);
+      result.rate.Add(filter.rate() - rate);
+      result.oldVolume.Add(oldVolume - volume);
+      if (oldHistory.size() == window + 1) {
+        result.oldRate.Add((oldHistory.back() - oldHistory.front()) / (kOldRateWindowSec / 3600.0) - rate);
+      }
+    }
+    if (extracted && !result.extractionTracked && t >= quietUntil - kSettleSec + 30.0) {
+      result.extractionTracked = fabs(filter.volume() - volume) < 0.2;
+    }
+
+    // Relés para el próximo intervalo
+    cycleSec += kStepSec;
+    if (cycleSec >= (compressorOn ? kOnSec : kOffSec)) {
+      compressorOn = !compressorOn;
+      cycleSec = 0.0;
+    }
+    if (!pumpOn && volume >= kPumpStartL) {
+      pumpOn = true;
+      result.pumpCycles++;
+    } else if (pumpOn && volume <= kPumpStopL) {
+      pumpOn = false;
+      quietUntil = t + kOldRateWindowSec;  // La diferencia a 10 min vieja arrastra el bombeo
+      oldHistory.clear();
+    }
+  }
+  result.resets = filter.resets();
+  result.rejected = filter.rejectedTotal();
+  result.pumpFlow = filter.pumpFlow();
+  return result;
+}
+
+void Benchmark() {
+  LevelEstimator filter;
+  filter.begin();
+  double ns = NsPerCall(4000000, [&](long i) {
+    filter.predict(2.0f, (i & 512) != 0, false);
+    filter.update(5.0f + 0.0001f * (float)(i & 1023), 0.0144f);
+  });
+  KeepValue(filter);
+  printf("  predict+update %.1f ns/paso\n", ns);
+}
+
+}  // namespace
+
+int RunLevelCheck() {
+  Check check("level");
+  Result r = Run();
+  printf("  %.0f h, %d ciclos de bomba, %u mediciones rechazadas, %u reinicios\n",
+         kHours, r.pumpCycles, (unsigned)r.rejected, (unsigned)r.resets);
+  printf("  volumen RMS %.3f L (promedio + EMA anterior %.3f L), cota %.3f L\n",
+         r.volume.Value(), r.oldVolume.Value(), kMaxVolumeRms);
+  printf("  tasa RMS %.2f L/h (diferencia a 10 min anterior %.2f L/h), cota %.2f L/h\n",
+         r.rate.Value(), r.oldRate.Value(), kMaxRateRms);
+  printf("  caudal de bomba aprendido %.1f L/h (real %.0f)\n", r.pumpFlow, kPumpFlowLph);
+  check.Expect(r.volume.Value() <= kMaxVolumeRms, "volumen RMS fuera de cota");
+  check.Expect(r.volume.Value() < 0.5 * r.oldVolume.Value(), "volumen no mejora al menos a la mitad frente al método anterior");
+  check.Expect(r.rate.Value() <= kMaxRateRms, "tasa RMS fuera de cota");
+  check.Expect(r.rate.Value() < r.oldRate.Value(), "tasa no mejora frente a la diferencia a 10 min");
+  check.Expect(r.resets >= 1 && r.extractionTracked, "extracción manual no seguida en 30 s");
+  check.Expect(r.pumpCycles >= 3, "la traza no ejercita la bomba");
+  check.Expect(fabs(r.pumpFlow - kPumpFlowLph) <= kMaxPumpFlowError * kPumpFlowLph, "caudal de bomba no aprendido");
+  Benchmark();
+  return check.Report();
+}
+
+}  // namespace dropster
@@ -0,0 +1,20 @@
+#ifndef DROPSTER_FWCHECK_LEVEL_CHECK_H_
+#define DROPSTER_FWCHECK_LEVEL_CHECK_H_
+
+// Validación de level_estimator.h con trazas sintéticas (dropster-fwcheck level).
+//
+// 48 h de un tanque de 0.4 L/cm leído cada SENSOR_READ_INTERVAL: compresor en ciclos de
+// 15/7.5 min con producción que varía en el día, bomba real de 150 L/h (el filtro parte de
+// 120), una extracción manual de 5 L, pings con 0.4 cm de ruido y 3 % de ecos. El filtro
+// (mediana de 3 pings) se compara con el promedio de 5 pings + EMA y la diferencia a 10 min
+// que usaba el firmware antes. Se exigen las cotas de error RMS de volumen y tasa, la
+// detección de la extracción y el caudal de bomba aprendido, y se mide ns por paso.
+
+namespace dropster {
+
+// Devuelve 0 si todas las cotas se cumplen
+int RunLevelCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_LEVEL_CHECK_H_
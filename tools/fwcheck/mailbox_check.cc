@@ -0,0 +1,186 @@
+#include "mailbox_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ui_mailbox.h"
+
+namespace dropster {
+namespace {
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+bool Feed(UiLineParser& parser, const std::string& text, uint32_t rxUs) {
+  return parser.feed((const uint8_t*)text.data(), text.size(), rxUs);
+}
+
+// El estado que ve LVGL tras publicar
+const DisplayState& Published(UiLineParser& parser, LatestMailbox<DisplayState>& mailbox) {
+  parser.publish();
+  mailbox.fetch();
+  return mailbox.front();
+}
+
+// Cada mensaje del AWG actualiza su campo, su secuencia y su marca de recepción
+void Messages(Scenario& sc) {
+  LatestMailbox<DisplayState> mailbox;
+  UiLineParser parser(mailbox);
+  sc.Expect(Feed(parser, "A:23.5\r\nMODE:AUTO\nCOMP:ON\nVENT:OFF\nCFAN: ON\nPUMP:ON\n", 100), "mensajes de estado sin efecto");
+  sc.Expect(Feed(parser, "BACKLIGHT:OFF\nSCREEN_TIMEOUT: 45\n", 200), "luz de fondo o tiempo de pantalla sin efecto");
+  const DisplayState& s = Published(parser, mailbox);
+  sc.Expect(s.agua == 23.5f && s.seq[UI_FIELD_AGUA] == 1 && s.rxUs[UI_FIELD_AGUA] == 100, "A: agua");
+  sc.Expect(s.modeAuto && s.seq[UI_FIELD_MODE] == 1, "MODE:AUTO");
+  sc.Expect(s.comp && !s.vent && s.cfan && s.pump, "COMP/VENT/CFAN/PUMP");
+  sc.Expect(!s.backlight && s.seq[UI_FIELD_BACKLIGHT] == 1 && s.rxUs[UI_FIELD_BACKLIGHT] == 200, "BACKLIGHT:OFF");
+  sc.Expect(s.screenTimeoutSec == 45 && s.seq[UI_FIELD_SCREEN_TIMEOUT] == 1, "SCREEN_TIMEOUT");
+
+  // Ignoradas o inválidas: no cambian nada ni cuentan secuencia
+  sc.Expect(!Feed(parser, "AWG_INIT:1.0\nCTRL: evap=3.0 dew=5.0\nBACKLIGHT:DIM\nA:x\n\n", 300),
+            "línea ignorada o inválida cambió el estado");
+  sc.Expect(Feed(parser, "MODE:MANUAL\n", 400), "MODE:MANUAL sin efecto");
+  const DisplayState& t = Published(parser, mailbox);
+  sc.Expect(!t.modeAuto && t.seq[UI_FIELD_MODE] == 2 && t.seq[UI_FIELD_BACKLIGHT] == 1 && t.agua == 23.5f,
+            "MODE:MANUAL o línea inválida aplicada");
+  sc.Expect(parser.lines() == 13, "cuenta de líneas");
+
+  // Trama CSV: campos no numéricos y faltantes quedan en NAN
+  sc.Expect(Feed(parser, " 1.5,2,abc,-4\n", 500), "trama CSV sin efecto");
+  const DisplayState& u = Published(parser, mailbox);
+  sc.Expect(u.vals[0] == 1.5f && u.vals[1] == 2.0f && isnan(u.vals[2]) && u.vals[3] == -4.0f, "valores de la trama CSV");
+  bool rest = true;
+  for (int i = 4; i < UI_VALUE_COUNT; i++) rest = rest && isnan(u.vals[i]);
+  sc.Expect(rest && u.seq[UI_FIELD_VALUES] == 1 && u.rxUs[UI_FIELD_VALUES] == 500, "campos faltantes de la trama CSV");
+
+  // Línea partida entre lecturas: la marca es la del primer byte
+  sc.Expect(!Feed(parser, "COMP:O", 600), "línea incompleta aplicada");
+  sc.Expect(Feed(parser, "FF\n", 700), "línea partida sin efecto");
+  const DisplayState& v = Published(parser, mailbox);
+  sc.Expect(!v.comp && v.seq[UI_FIELD_COMP] == 2 && v.rxUs[UI_FIELD_COMP] == 600, "línea partida entre lecturas");
+}
+
+// Una línea de UI_LINE_MAX bytes o más se descarta entera hasta el fin de línea
+void Oversized(Scenario& sc) {
+  LatestMailbox<DisplayState> mailbox;
+  UiLineParser parser(mailbox);
+  std::string longest = "A:7" + std::string(UI_LINE_MAX - 4, ' ');  // UI_LINE_MAX - 1 bytes: cabe
+  sc.Expect(Feed(parser, longest + "\n", 10), "línea de UI_LINE_MAX - 1 bytes descartada");
+  std::string tooLong = "A:9" + std::string(UI_LINE_MAX, '0');
+  sc.Expect(!Feed(parser, tooLong.substr(0, 100), 20), "línea larga aplicada antes del fin");
+  sc.Expect(!Feed(parser, tooLong.substr(100) + "\n", 30), "línea larga aplicada");
+  sc.Expect(Feed(parser, "A:8\n", 40), "la línea siguiente a una larga se pierde");
+  const DisplayState& s = Published(parser, mailbox);
+  sc.Expect(parser.droppedLines() == 1 && parser.lines() == 2, "cuenta de líneas descartadas");
+  sc.Expect(s.agua == 8.0f && s.seq[UI_FIELD_AGUA] == 2 && s.rxUs[UI_FIELD_AGUA] == 40, "estado tras la línea larga");
+}
+
+// Índices siempre distintos, DIRTY solo hasta el primer fetch y publicaciones no vistas contadas
+void Handshake(Scenario& sc) {
+  LatestMailbox<int> mailbox;
+  sc.Expect(!mailbox.fetch(), "fetch sin publicar devuelve algo");
+  const int* seen[3] = {};
+  int distinct = 0;
+  for (int i = 1; i <= 6; i++) {
+    sc.Expect(&mailbox.back() != &mailbox.front(), "productor y consumidor comparten buffer");
+    bool known = false;
+    for (int k = 0; k < distinct; k++) known = known || seen[k] == &mailbox.back();
+    if (!known && distinct < 3) seen[distinct++] = &mailbox.back();
+    mailbox.back() = i;
+    mailbox.publish();
+    sc.Expect(mailbox.fetch() && mailbox.front() == i, "la publicación no llega al consumidor");
+    sc.Expect(!mailbox.fetch(), "la misma instantánea se entrega dos veces");
+  }
+  sc.Expect(distinct == 3, "el productor no rota por los tres buffers");
+
+  mailbox.back() = 10;
+  mailbox.publish();
+  mailbox.back() = 11;
+  mailbox.publish();
+  mailbox.back() = 12;
+  mailbox.publish();
+  sc.Expect(mailbox.fetch() && mailbox.front() == 12, "no se entrega la última publicación");
+  sc.Expect(mailbox.published() == 9 && mailbox.coalesced() == 2, "publicaciones o descartes mal contados");
+}
+
+// Productor y consumidor en hilos distintos: instantáneas completas, en orden y sin pérdidas
+void Threads(Scenario& sc) {
+  const uint32_t kPublishes = 2000000;
+  LatestMailbox<DisplayState> mailbox;
+  std::atomic<bool> ready{false}, done{false};
+  std::thread producer([&]() {
+    while (!ready.load(std::memory_order_acquire)) std::this_thread::yield();  // Sin ventaja de arranque
+    for (uint32_t i = 1; i <= kPublishes; i++) {
+      DisplayState& s = mailbox.back();
+      s.seq[UI_FIELD_VALUES] = i;
+      s.rxUs[UI_FIELD_VALUES] = i;
+      for (int k = 0; k < UI_VALUE_COUNT; k++) s.vals[k] = (float)i;  // Exacto hasta 2^24
+      mailbox.publish();
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t last = 0, fetches = 0;
+  bool torn = false, ordered = true;
+  ready.store(true, std::memory_order_release);
+  for (;;) {
+    bool finished = done.load(std::memory_order_acquire);
+    if (!mailbox.fetch()) {
+      if (finished) break;
+      continue;  // Sin ceder: el consumidor compite con cada publicación
+    }
+    fetches++;
+    const DisplayState& s = mailbox.front();
+    uint32_t i = s.seq[UI_FIELD_VALUES];
+    if (s.rxUs[UI_FIELD_VALUES] != i) torn = true;
+    for (int k = 0; k < UI_VALUE_COUNT; k++) torn = torn || s.vals[k] != (float)i;
+    if (i <= last) ordered = false;
+    last = i;
+  }
+  producer.join();
+  printf("  %u publicaciones: %u vistas por el consumidor, %u descartadas\n", mailbox.published(), fetches,
+         mailbox.coalesced());
+  sc.Expect(!torn, "instantánea a medio escribir");
+  sc.Expect(ordered, "instantánea repetida o fuera de orden");
+  sc.Expect(last == kPublishes, "la última publicación no llega");
+  sc.Expect(mailbox.published() == kPublishes && fetches + mailbox.coalesced() == kPublishes,
+            "publicaciones vistas más descartadas no suman el total");
+}
+
+}  // namespace
+
+int RunMailboxCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"mensajes del AWG", Messages},
+      {"línea mayor que UI_LINE_MAX", Oversized},
+      {"índices y bit DIRTY", Handshake},
+      {"productor y consumidor concurrentes", Threads},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
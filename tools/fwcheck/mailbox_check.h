@@ -0,0 +1,19 @@
+#ifndef DROPSTER_FWCHECK_MAILBOX_CHECK_H_
+#define DROPSTER_FWCHECK_MAILBOX_CHECK_H_
+
+// Escenarios del buzón entre la recepción UART y LVGL de la pantalla, ui_mailbox.h
+// (dropster-fwcheck mailbox).
+//
+// Pasa por UiLineParser::feed cada tipo de línea del AWG (también partidas entre lecturas y
+// una más larga que UI_LINE_MAX), verifica el intercambio de índices y el bit DIRTY del triple
+// buffer y publica 2 millones de estados desde un hilo mientras otro los consume: cada
+// instantánea debe llegar completa y en orden. Pensado para correr también con TSan.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunMailboxCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_MAILBOX_CHECK_H_
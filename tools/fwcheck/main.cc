@@ -0,0 +1,75 @@
+// dropster-fwcheck: verificaciones en el host de los headers del firmware
+//
+//   dropster-fwcheck psychrometrics   barrido de precisión y benchmark de psychrometrics.h
+//   dropster-fwcheck adaptive         convergencia de adaptive_control.h contra un modelo de planta
+//   dropster-fwcheck duty [traza.csv]  reproducción de días de clima sobre duty_scheduler.h
+//   dropster-fwcheck level            trazas sintéticas del tanque sobre level_estimator.h
+//   dropster-fwcheck rollup           escenarios de los agregados por minuto/hora/día de rollup.h
+//   dropster-fwcheck power            plazos, desborde de millis() y gobernador de power_manager.h
+//   dropster-fwcheck trend            escenarios y benchmark de trend_store.h (pantalla)
+//   dropster-fwcheck ingest           decodificador y lotes de la ingesta MQTT nativa (linux/runner)
+//   dropster-fwcheck mailbox          líneas del AWG y triple buffer de ui_mailbox.h (pantalla)
+//   dropster-fwcheck mem              anillo de tendencia, fuga y subsistemas de mem_profile.h
+//
+// Cada verificación compila el mismo header que el AWG, el display o el runner de Linux y
+// devuelve distinto de cero si alguna cota falla. Los benchmarks solo informan. Ver tools/README.md.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "adaptive_check.h"
+#include "duty_check.h"
+#include "ingest_check.h"
+#include "level_check.h"
+#include "mailbox_check.h"
+#include "mem_check.h"
+#include "power_check.h"
+#include "psychrometrics_check.h"
+#include "rollup_check.h"
+#include "trend_check.h"
+
+using namespace dropster;
+
+namespace {
+
+const struct {
+  const char* name;
+  int (*run)();
+} kChecks[] = {
+  {"psychrometrics", RunPsychrometricsCheck},
+  {"adaptive", RunAdaptiveCheck},
+  {"duty", RunDutyCheck},
+  {"level", RunLevelCheck},
+  {"rollup", RunRollupCheck},
+  {"power", RunPowerCheck},
+  {"trend", RunTrendCheck},
+  {"ingest", RunIngestCheck},
+  {"mailbox", RunMailboxCheck},
+  {"mem", RunMemCheck},
+};
+
+int Usage() {
+  fprintf(stderr, "uso: dropster-fwcheck <verificación>|all\n"
+                  "     dropster-fwcheck duty <traza.csv>\n");
+  for (const auto& check : kChecks) fprintf(stderr, "  %s\n", check.name);
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Traza grabada: una línea `segundo,humedad_absoluta` por muestra
+  if (argc == 3 && strcmp(argv[1], "duty") == 0) return RunDutyReplay(argv[2]);
+  if (argc != 2) return Usage();
+  bool all = strcmp(argv[1], "all") == 0;
+  int failed = 0;
+  bool found = false;
+  for (const auto& check : kChecks) {
+    if (!all && strcmp(argv[1], check.name) != 0) continue;
+    found = true;
+    printf("%s\n", check.name);
+    if (check.run() != 0) failed++;
+  }
+  if (!found) return Usage();
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include "mem_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "mem_profile.h"
+
+namespace dropster {
+namespace {
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+MemTrendSample Sample(uint16_t boot, uint32_t uptimeMin, uint32_t freeMin) {
+  MemTrendSample s = {};
+  s.boot = boot;
+  s.uptimeMin = uptimeMin;
+  s.freeMin = freeMin;
+  s.largestMin = freeMin / 2;
+  return s;
+}
+
+// El anillo conserva las MEM_TREND_SLOTS más recientes en orden y rechaza cabeceras inválidas
+void Ring(Scenario& sc) {
+  MemTrend trend;
+  trend.reset();
+  sc.Expect(trend.valid() && trend.count == 0, "anillo vacío inválido");
+  const int pushed = MEM_TREND_SLOTS + 12;
+  for (int i = 0; i < pushed; i++) trend.push(Sample(1, (uint32_t)i * 60, 200000));
+  sc.Expect(trend.valid() && trend.count == MEM_TREND_SLOTS && trend.head == 12, "cuenta o cabeza tras la vuelta");
+  bool ordered = true;
+  for (int i = 0; i < trend.count; i++) ordered = ordered && trend.at(i).uptimeMin == (uint32_t)(12 + i) * 60;
+  sc.Expect(ordered, "muestras fuera de orden tras la vuelta");
+
+  MemTrend bad = trend;
+  bad.head = MEM_TREND_SLOTS;
+  sc.Expect(!bad.valid(), "cabeza fuera del anillo aceptada");
+  bad = trend;
+  bad.count = MEM_TREND_SLOTS + 1;
+  sc.Expect(!bad.valid(), "cuenta mayor que el anillo aceptada");
+  bad = trend;
+  bad.version = MEM_TREND_VERSION + 1;
+  sc.Expect(!bad.valid(), "versión desconocida aceptada");
+}
+
+// Pendiente por mínimos cuadrados del arranque pedido, en bytes por hora
+void Leak(Scenario& sc) {
+  MemTrend trend;
+  trend.reset();
+  for (uint32_t h = 0; h < 10; h++) trend.push(Sample(2, h * 60, 150000 + h * 900));  // Arranque anterior, recupera
+  for (uint32_t h = 0; h < 20; h++) trend.push(Sample(3, h * 60, 200000 - h * 120 + (h % 2) * 40));
+  float leak = trend.leakBytesPerHour(3);
+  printf("  fuga: %.1f B/h en el arranque 3, %.1f B/h en el 2\n", leak, trend.leakBytesPerHour(2));
+  sc.Expect(fabsf(leak - 120.0f) < 1.0f, "pendiente del arranque actual");
+  sc.Expect(trend.leakBytesPerHour(2) < -899.0f, "pendiente de otro arranque mezclada");
+  sc.Expect(trend.leakBytesPerHour(4) == 0.0f, "pendiente sin muestras");
+
+  MemTrend few;
+  few.reset();
+  few.push(Sample(1, 0, 1000));
+  few.push(Sample(1, 60, 900));
+  sc.Expect(few.leakBytesPerHour(1) == 0.0f, "pendiente con menos de MEM_LEAK_MIN_SAMPLES muestras");
+  MemTrend flat;
+  flat.reset();
+  for (int i = 0; i < 4; i++) flat.push(Sample(1, 60, 1000 - i * 100));
+  sc.Expect(flat.leakBytesPerHour(1) == 0.0f, "pendiente con todas las muestras en el mismo minuto");
+
+  // Después de la vuelta del anillo, con las muestras retenidas a ambos lados de los 71582 min
+  // (2^32 ms) de uptime
+  MemTrend wrap;
+  wrap.reset();
+  const uint32_t start = 67000;
+  for (uint32_t h = 0; h < MEM_TREND_SLOTS * 2; h++) wrap.push(Sample(5, start + h * 60, 180000 - h * 50));
+  sc.Expect(wrap.at(0).uptimeMin < 71582 && wrap.at(wrap.count - 1).uptimeMin > 71582,
+            "el escenario no cruza la vuelta de millis()");
+  sc.Expect(fabsf(wrap.leakBytesPerHour(5) - 50.0f) < 0.5f, "pendiente tras la vuelta del anillo o de millis()");
+  // Los mismos minutos desde millis() de 32 bits vuelven a cero y la recta deja de servir
+  MemTrend wrapped;
+  wrapped.reset();
+  for (uint32_t h = 0; h < MEM_TREND_SLOTS * 2; h++) {
+    uint32_t ms = (uint32_t)((uint64_t)(start + h * 60) * 60000u);
+    wrapped.push(Sample(5, ms / 60000u, 180000 - h * 50));
+  }
+  sc.Expect(fabsf(wrapped.leakBytesPerHour(5) - 50.0f) > 5.0f, "millis() de 32 bits no afecta al escenario");
+}
+
+// Lo retenido por una entrada anidada se cuenta en su subsistema y no en el exterior
+void Scopes(Scenario& sc) {
+  MemProfiler p;
+  p.enter(MEM_SYS_COMMAND, 100000);
+  p.enter(MEM_SYS_JSON, 99000);  // processCommand() retuvo 1000 antes de la configuración
+  sc.Expect(p.current() == MEM_SYS_JSON, "subsistema en curso dentro del anidado");
+  p.leave(98000);
+  p.leave(97500);
+  sc.Expect(p.current() == MEM_SYS_OTHER, "subsistema en curso fuera de toda entrada");
+  const MemSubsystemStats& command = p.stats(MEM_SYS_COMMAND);
+  const MemSubsystemStats& json = p.stats(MEM_SYS_JSON);
+  sc.Expect(json.scopes == 1 && json.netBytes == 1000 && json.worstBytes == 1000, "retención del anidado");
+  sc.Expect(command.scopes == 1 && command.netBytes == 1500 && command.worstBytes == 1500, "retención del exterior");
+
+  // Una entrada que libera más de lo que toma resta y no cambia el peor caso
+  p.enter(MEM_SYS_COMMAND, 97500);
+  p.leave(98500);
+  sc.Expect(command.scopes == 2 && command.netBytes == 500 && command.worstBytes == 1500, "entrada que libera");
+
+  // Más profundo que MEM_SCOPE_DEPTH: los niveles extra no cuentan ni desbalancean la pila
+  const int deep = MEM_SCOPE_DEPTH + 2;
+  for (int i = 0; i < deep; i++) p.enter(i < MEM_SCOPE_DEPTH ? MEM_SYS_LOG : MEM_SYS_MQTT, 90000);
+  sc.Expect(p.current() == MEM_SYS_LOG, "subsistema en curso más allá de MEM_SCOPE_DEPTH");
+  for (int i = 0; i < deep; i++) p.leave(90000);
+  p.leave(80000);  // Salida sin entrada: se ignora
+  sc.Expect(p.stats(MEM_SYS_LOG).scopes == MEM_SCOPE_DEPTH && p.stats(MEM_SYS_MQTT).scopes == 0, "entradas contadas");
+  sc.Expect(p.current() == MEM_SYS_OTHER && p.stats(MEM_SYS_LOG).netBytes == 0, "pila desbalanceada");
+  p.resetCounters();
+  sc.Expect(p.stats(MEM_SYS_COMMAND).scopes == 0 && p.stats(MEM_SYS_COMMAND).netBytes == 0, "reinicio de contadores");
+}
+
+// Mínimos del intervalo y fragmentación de la muestra
+void Window(Scenario& sc) {
+  MemProfiler p;
+  MemTrendSample s;
+  sc.Expect(!p.closeWindow(1, 0, 0, &s), "intervalo sin lecturas cerrado");
+  p.observe(120000, 60000);
+  p.observe(110000, 80000);
+  p.observe(130000, 40000);
+  sc.Expect(p.closeWindow(7, 3, 90, &s), "intervalo con lecturas no cerrado");
+  sc.Expect(s.boot == 7 && s.resetReason == 3 && s.uptimeMin == 90, "cabecera de la muestra");
+  sc.Expect(s.freeMin == 110000 && s.largestMin == 40000 && s.fragPct == 64, "mínimos o fragmentación");
+  sc.Expect(!p.closeWindow(7, 3, 95, &s), "el intervalo no se reinicia al cerrarse");
+  sc.Expect(MemProfiler::fragmentationPct(0, 0) == 0 && MemProfiler::fragmentationPct(100, 200) == 0 &&
+                MemProfiler::fragmentationPct(4000000000u, 1) == 100,
+            "fragmentación en los extremos");
+}
+
+}  // namespace
+
+int RunMemCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"anillo de tendencia", Ring},
+      {"pendiente de fuga", Leak},
+      {"entradas anidadas", Scopes},
+      {"intervalo de tendencia", Window},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
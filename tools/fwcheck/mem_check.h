@@ -0,0 +1,18 @@
+#ifndef DROPSTER_FWCHECK_MEM_CHECK_H_
+#define DROPSTER_FWCHECK_MEM_CHECK_H_
+
+// Escenarios del perfil de memoria del AWG, mem_profile.h (dropster-fwcheck mem).
+//
+// Verifica la vuelta del anillo de tendencia persistido, la pendiente de leakBytesPerHour()
+// (solo el arranque pedido, también pasados los 49,7 días en que millis() da la vuelta) y la
+// atribución por subsistema de las entradas anidadas de MemScope, más los mínimos del
+// intervalo y la fragmentación de cada muestra.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunMemCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_MEM_CHECK_H_
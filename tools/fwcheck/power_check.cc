@@ -0,0 +1,217 @@
+#include "power_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "power_manager.h"
+
+namespace dropster {
+namespace {
+
+// Intervalos de la tabla de managePower() (config.h)
+const uint32_t kSensorMs = 2000;     // SENSOR_READ_INTERVAL
+const uint32_t kTransmitMs = 5000;   // UART_TRANSMIT_INTERVAL
+const uint32_t kLedMs = 200;         // LED_UPDATE_INTERVAL
+const uint32_t kMqttMs = 5000;       // MQTT_TRANSMIT_INTERVAL
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+std::string Ms(uint32_t value) {
+  return std::to_string(value) + " ms";
+}
+
+// Plazo = lo que falta al trabajo más próximo, acotado por el máximo y nulo por debajo del mínimo
+void Budget(Scenario& sc) {
+  PowerJob jobs[] = {{2000, kSensorMs, true}, {2900, kLedMs, true}, {0, kTransmitMs, true}};
+  uint32_t b = PowerManager::idleBudget(3000, jobs, 3);
+  sc.Expect(b == POWER_MAX_IDLE_MS, "sin plazos cercanos no devuelve POWER_MAX_IDLE_MS: " + Ms(b));
+  b = PowerManager::idleBudget(3080, jobs, 3);
+  sc.Expect(b == 20, "LED a 20 ms: " + Ms(b));
+  b = PowerManager::idleBudget(3099, jobs, 3);
+  sc.Expect(b == 0, "1 ms restante (< POWER_MIN_IDLE_MS) no devuelve 0: " + Ms(b));
+  b = PowerManager::idleBudget(3100, jobs, 3);
+  sc.Expect(b == 0, "trabajo vencido no devuelve 0: " + Ms(b));
+  b = PowerManager::idleBudget(3000, jobs, 3, POWER_ACTIVE_IDLE_MS);
+  sc.Expect(b == POWER_ACTIVE_IDLE_MS, "no respeta el máximo con actividad serie: " + Ms(b));
+  b = PowerManager::idleBudget(3000, jobs, 0);
+  sc.Expect(b == POWER_MAX_IDLE_MS, "tabla vacía: " + Ms(b));
+}
+
+// millis() desborda a los 49.7 días: la resta sin signo debe seguir dando el plazo correcto
+void MillisWrap(Scenario& sc) {
+  PowerJob jobs[] = {{UINT32_MAX - 1499, kSensorMs, true}, {UINT32_MAX - 188, kLedMs, true}};
+  // 1500 ms desde la lectura (quedan 500) y 189 ms desde el LED (quedan 11)
+  uint32_t b = PowerManager::idleBudget(0, jobs, 2);
+  sc.Expect(b == 11, "plazo al desbordar: " + Ms(b) + " en vez de 11 ms");
+  jobs[1].last = 0;
+  b = PowerManager::idleBudget(30, jobs, 2);
+  sc.Expect(b == POWER_MAX_IDLE_MS, "plazo después de desbordar: " + Ms(b));
+  b = PowerManager::idleBudget(500, jobs, 2);
+  sc.Expect(b == 0, "lectura vencida tras desbordar no devuelve 0: " + Ms(b));
+
+  // Un trabajo que corre a tiempo a través del desborde no cuenta como plazo perdido
+  PowerManager pm;
+  pm.begin();
+  PowerJob job = {UINT32_MAX - 999, kSensorMs, true};
+  pm.trackJobs(&job, 1);
+  job.last += kSensorMs + 40;  // 1040 ms después del desborde, 40 ms tarde
+  pm.trackJobs(&job, 1);
+  sc.Expect(pm.jobRuns() == 1 && pm.missedDeadlines() == 0 && pm.maxLatenessMs() == 40,
+            "retraso a través del desborde: " + Ms(pm.maxLatenessMs()));
+}
+
+// Un trabajo deshabilitado no acota el plazo, y al rehabilitarse no se le cobra el tiempo apagado
+void DisabledJobs(Scenario& sc) {
+  PowerJob jobs[] = {{0, kSensorMs, true}, {0, kMqttMs, false}};
+  uint32_t b = PowerManager::idleBudget(10000, jobs, 2);
+  sc.Expect(b == 0, "la lectura vencida no devuelve 0");
+  jobs[0].last = 10000;
+  b = PowerManager::idleBudget(10000, jobs, 2);
+  sc.Expect(b == POWER_MAX_IDLE_MS, "el trabajo deshabilitado y vencido acota el plazo: " + Ms(b));
+
+  PowerManager pm;
+  pm.begin();
+  PowerJob mqtt = {1000, kMqttMs, true};
+  pm.trackJobs(&mqtt, 1);
+  mqtt.last = 6000;
+  pm.trackJobs(&mqtt, 1);
+  mqtt.enabled = false;  // MQTT caído 10 min
+  pm.trackJobs(&mqtt, 1);
+  mqtt.enabled = true;
+  mqtt.last = 606000;  // Reconectado: publica en cuanto puede
+  pm.trackJobs(&mqtt, 1);
+  mqtt.last = 611000;
+  pm.trackJobs(&mqtt, 1);
+  sc.Expect(pm.missedDeadlines() == 0 && pm.maxLatenessMs() == 0,
+            "el tiempo deshabilitado cuenta como retraso: " + Ms(pm.maxLatenessMs()));
+  sc.Expect(pm.jobRuns() == 2, "ejecuciones contadas: " + std::to_string(pm.jobRuns()) + " en vez de 2");
+}
+
+// Plazos perdidos: solo un retraso mayor que POWER_DEADLINE_TOLERANCE_MS
+void Lateness(Scenario& sc) {
+  PowerManager pm;
+  pm.begin();
+  PowerJob jobs[] = {{0, kSensorMs, true}, {0, kLedMs, true}};
+  pm.trackJobs(jobs, 2);
+  jobs[0].last = kSensorMs + POWER_DEADLINE_TOLERANCE_MS;       // En el límite
+  jobs[1].last = kLedMs - 5;                                     // Adelantado
+  pm.trackJobs(jobs, 2);
+  sc.Expect(pm.missedDeadlines() == 0, "retraso en el límite contado como perdido");
+  jobs[0].last += kSensorMs + POWER_DEADLINE_TOLERANCE_MS + 1;
+  pm.trackJobs(jobs, 2);
+  pm.trackJobs(jobs, 2);  // Sin cambios: no cuenta de nuevo
+  sc.Expect(pm.missedDeadlines() == 1 && pm.jobRuns() == 3, "plazo perdido no contado una sola vez");
+  sc.Expect(pm.maxLatenessMs() == POWER_DEADLINE_TOLERANCE_MS + 1, "retraso máximo: " + Ms(pm.maxLatenessMs()));
+}
+
+// El gobernador sube sobre POWER_LOAD_HIGH, baja bajo POWER_LOAD_LOW y se queda en el medio
+void Governor(Scenario& sc) {
+  PowerManager pm;
+  pm.begin(0);
+  uint32_t now = 0;
+  // Ventana con 60 % de carga: 80 -> 160 MHz
+  for (int i = 0; i < 100; i++, now += 100) pm.accountBusy(now, 60000);
+  sc.Expect(!pm.govern(now - 100), "la ventana se cierra antes de POWER_LOAD_WINDOW_MS");
+  sc.Expect(pm.govern(now) && pm.freqMhz() == 160, "60 % de carga no sube a 160 MHz");
+  // 30 %: dentro de la histéresis
+  for (int i = 0; i < 100; i++, now += 100) pm.accountBusy(now, 30000);
+  sc.Expect(!pm.govern(now) && pm.freqMhz() == 160, "30 % de carga cambia la frecuencia");
+  sc.Expect(fabsf(pm.load() - 0.30f) < 0.01f, "carga medida " + std::to_string(pm.load()));
+  // 100 % dos ventanas: 240 y se queda
+  for (int w = 0; w < 2; w++) {
+    for (int i = 0; i < 100; i++, now += 100) pm.accountBusy(now, 100000);
+    pm.govern(now);
+  }
+  sc.Expect(pm.freqMhz() == 240, "carga plena no llega a 240 MHz");
+  // 5 %: baja de a un escalón por ventana hasta 80, nunca por debajo
+  for (int w = 0; w < 3; w++) {
+    for (int i = 0; i < 100; i++, now += 100) pm.accountBusy(now, 5000);
+    pm.govern(now);
+    if (w == 0) sc.Expect(pm.freqMhz() == 160, "baja más de un escalón por ventana");
+  }
+  sc.Expect(pm.freqMhz() == 80 && pm.freqStep() == 0, "carga baja no queda en 80 MHz");
+  sc.Expect(pm.freqChanges() == 4, "cambios de frecuencia: " + std::to_string(pm.freqChanges()));
+}
+
+// Corriente media ponderada por tiempo en cada estado y latencia de despertar
+void Metrics(Scenario& sc) {
+  PowerManager pm;
+  pm.begin(0);
+  pm.accountBusy(0, 100000);              // 0.1 s a 80 MHz
+  pm.accountIdle(400, 400000, true);      // 0.4 s en sueño ligero, sin retraso
+  pm.accountIdle(490, 500000, false);     // 0.5 s en espera, 10 ms tarde
+  float expected = (0.1f * POWER_CURRENT_ACTIVE_MA[0] + 0.4f * POWER_CURRENT_SLEEP_MA + 0.5f * POWER_CURRENT_IDLE_MA) / 1.0f;
+  sc.Expect(fabsf(pm.averageCurrentMa() - expected) < 0.01f, "corriente media " + std::to_string(pm.averageCurrentMa()));
+  sc.Expect(fabsf(pm.sleepFraction() - 0.4f) < 1e-4f && fabsf(pm.busyFraction() - 0.1f) < 1e-4f, "fracciones de tiempo");
+  sc.Expect(pm.wakeCount() == 2 && pm.wakeLatencyMaxUs() == 10000 && pm.wakeLatencyAvgUs() == 5000, "latencia de despertar");
+  pm.resetStats();
+  sc.Expect(pm.averageCurrentMa() == 0.0f && pm.wakeCount() == 0 && pm.missedDeadlines() == 0, "resetStats no limpia");
+}
+
+// Loop simulado durante 60 s que cruza el desborde: cede según idleBudget y no pierde plazos
+void SimulatedLoop(Scenario& sc) {
+  PowerManager pm;
+  pm.begin();
+  uint32_t now = UINT32_MAX - 30000;
+  PowerJob jobs[] = {{now, kSensorMs, true}, {now, kLedMs, true}, {now, kTransmitMs, true}, {now, kMqttMs, true}};
+  uint32_t sleptMs = 0, iterations = 0;
+  for (uint32_t elapsed = 0; elapsed < 60000; iterations++) {
+    for (PowerJob& job : jobs) {
+      if (now - job.last >= job.interval) job.last = now;  // El loop ejecuta lo vencido
+    }
+    if (elapsed > 20000 && elapsed < 40000) jobs[3].enabled = false;  // MQTT caído 20 s
+    else jobs[3].enabled = true;
+    pm.trackJobs(jobs, 4);
+    uint32_t step = 1;  // Iteración ocupada de 1 ms
+    uint32_t idle = PowerManager::idleBudget(now + step, jobs, 4);
+    step += idle;
+    sleptMs += idle;
+    now += step;
+    elapsed += step;
+  }
+  printf("        %u iteraciones en 60 s, %.0f %% cedido, retraso máximo %u ms\n", (unsigned)iterations,
+         100.0 * sleptMs / 60000.0, (unsigned)pm.maxLatenessMs());
+  sc.Expect(pm.missedDeadlines() == 0, "plazos perdidos: " + std::to_string(pm.missedDeadlines()));
+  sc.Expect(pm.maxLatenessMs() <= 2, "retraso máximo " + Ms(pm.maxLatenessMs()));
+  sc.Expect(sleptMs > 50000, "cede menos del 83 % del tiempo: " + Ms(sleptMs));
+}
+
+}  // namespace
+
+int RunPowerCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"plazo del próximo trabajo", Budget},
+      {"desborde de millis()", MillisWrap},
+      {"trabajos deshabilitados y rehabilitados", DisabledJobs},
+      {"plazos perdidos", Lateness},
+      {"gobernador de frecuencia", Governor},
+      {"corriente media y latencia", Metrics},
+      {"loop simulado", SimulatedLoop},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
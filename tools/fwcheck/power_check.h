@@ -0,0 +1,18 @@
+#ifndef DROPSTER_FWCHECK_POWER_CHECK_H_
+#define DROPSTER_FWCHECK_POWER_CHECK_H_
+
+// Escenarios sobre el cálculo de plazos, el gobernador y las métricas de power_manager.h
+// (dropster-fwcheck power).
+//
+// Cada escenario llama a PowerManager (el mismo header del AWG) con tablas de trabajos y
+// tiempos simulados, incluido el desborde de millis() a los 49.7 días y trabajos que se
+// deshabilitan y vuelven a habilitarse, como la publicación MQTT al perder la conexión.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunPowerCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_POWER_CHECK_H_
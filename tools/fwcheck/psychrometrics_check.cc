@@ -0,0 +1,163 @@
+#include "psychrometrics_check.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "check.h"
+#include "psychrometrics.h"
+
+namespace dropster {
+namespace {
+
+const double kPressureHpa = 1013.25;
+
+// Cotas del header con un margen para diferencias de libm entre plataformas
+const double kMaxEsRel = 1.0e-6;       // 9.1e-7 documentado
+const double kMaxDewC = 5.0e-5;        // 0.00002 °C
+const double kMaxAbsHumRel = 3.0e-6;   // 2.3e-6
+const double kMaxWetBulbC = 0.004;     // 0.0029 °C
+const double kMaxEnthalpy = 0.0006;    // 0.00044 kJ/kg
+
+struct Reference {
+  double es, e, dew, absHum, wetBulb, mixingRatio, enthalpy;
+};
+
+double SatPressure(double t) {
+  return 6.112 * exp(17.62 * t / (243.12 + t));
+}
+
+// Newton en double sobre la ecuación psicrométrica WMO hasta converger
+double WetBulb(double t, double e, double dew, double p) {
+  double tw = t - (t - dew) / 3.0;
+  double ap = 6.53e-4 * p;
+  for (int i = 0; i < 50; i++) {
+    double den = 243.12 + tw;
+    double es = SatPressure(tw);
+    double f = es - ap * (1.0 + 9.44e-4 * tw) * (t - tw) - e;
+    double df = es * 17.62 * 243.12 / (den * den) + ap * (1.0 + 9.44e-4 * (2.0 * tw - t));
+    double step = f / df;
+    tw -= step;
+    if (fabs(step) < 1e-12) break;
+  }
+  return tw;
+}
+
+Reference Compute(double t, double rh, double p, bool wetBulb) {
+  Reference r;
+  r.es = SatPressure(t);
+  r.e = r.es * rh / 100.0;
+  double gamma = log(rh / 100.0) + 17.62 * t / (243.12 + t);
+  r.dew = 243.12 * gamma / (17.62 - gamma);
+  r.absHum = 216.685 * r.e / (t + 273.15);
+  r.wetBulb = wetBulb ? WetBulb(t, r.e, r.dew, p) : NAN;
+  double w = 0.621945 * r.e / (p - r.e);
+  r.mixingRatio = 1000.0 * w;
+  r.enthalpy = 1.006 * t + w * (2501.0 + 1.86 * t);
+  return r;
+}
+
+struct MaxError {
+  double value = 0.0;
+  float temp = 0.0f, hum = 0.0f;
+  void Update(double err, float t, float rh) {
+    if (err > value) { value = err; temp = t; hum = rh; }
+  }
+};
+
+void ExpectBound(Check& check, const char* name, const MaxError& err, double bound) {
+  printf("  max %-9.3g cota %-7.3g %s (T=%.2f HR=%.2f)\n", err.value, bound, name, err.temp, err.hum);
+  check.Expect(err.value <= bound, std::string(name) + " fuera de cota");
+}
+
+void Sweep(Check& check) {
+  MaxError es, dew, absHum, wetBulb, enthalpy;
+  long points = 0;
+  bool statusOk = true;
+  for (int i = 0; i <= 7000; i++) {
+    float t = (float)(-10.0 + i * 0.01);
+    for (int j = 0; j <= 1900; j++) {
+      float rh = (float)(5.0 + j * 0.05);
+      // El bulbo húmedo de referencia es caro: se barre con paso 0.5 %RH
+      bool withWetBulb = (j % 10) == 0;
+      PsyState s = psyCompute(t, rh, (float)kPressureHpa);
+      Reference r = Compute(t, rh, kPressureHpa, withWetBulb);
+      statusOk = statusOk && s.status == PSY_OK;
+      es.Update(fabs(s.satPressure - r.es) / r.es, t, rh);
+      es.Update(fabs(s.vaporPressure - r.e) / r.e, t, rh);
+      dew.Update(fabs(s.dewPoint - r.dew), t, rh);
+      absHum.Update(fabs(s.absHumidity - r.absHum) / r.absHum, t, rh);
+      if (withWetBulb) wetBulb.Update(fabs(s.wetBulb - r.wetBulb), t, rh);
+      enthalpy.Update(fabs(s.enthalpy - r.enthalpy), t, rh);
+      points++;
+    }
+  }
+  printf("  %ld puntos en la envolvente\n", points);
+  check.Expect(statusOk, "punto de la envolvente no marcado PSY_OK");
+  ExpectBound(check, "presión de vapor", es, kMaxEsRel);
+  ExpectBound(check, "punto de rocío", dew, kMaxDewC);
+  ExpectBound(check, "humedad absoluta", absHum, kMaxAbsHumRel);
+  ExpectBound(check, "bulbo húmedo", wetBulb, kMaxWetBulbC);
+  ExpectBound(check, "entalpía", enthalpy, kMaxEnthalpy);
+}
+
+// Las funciones sueltas deben coincidir con psyCompute (comparten fórmulas)
+void Consistency(Check& check) {
+  bool ok = true;
+  for (float t = -10.0f; t <= 60.0f; t += 0.73f) {
+    for (float rh = 5.0f; rh <= 100.0f; rh += 1.9f) {
+      PsyState s = psyCompute(t, rh, (float)kPressureHpa);
+      ok = ok && fabsf(psyDewPoint(t, rh) - s.dewPoint) <= 1e-5f;
+      ok = ok && fabsf(psyAbsHumidity(t, rh) - s.absHumidity) <= 1e-5f;
+      ok = ok && fabsf(psyWetBulb(t, rh, (float)kPressureHpa) - s.wetBulb) <= 1e-5f;
+      ok = ok && fabsf(psyMixingRatio(t, rh, (float)kPressureHpa) - s.mixingRatio) <= 1e-4f;
+      ok = ok && fabsf(psyEnthalpy(t, rh, (float)kPressureHpa) - s.enthalpy) <= 1e-3f;
+    }
+  }
+  check.Expect(ok, "funciones sueltas distintas de psyCompute");
+}
+
+void InvalidInputs(Check& check) {
+  check.Expect(psyCompute(NAN, 50.0f, 1013.25f).status == PSY_INVALID_INPUT, "T NaN aceptada");
+  check.Expect(psyCompute(25.0f, NAN, 1013.25f).status == PSY_INVALID_INPUT, "HR NaN aceptada");
+  check.Expect(psyCompute(25.0f, 0.0f, 1013.25f).status == PSY_INVALID_INPUT, "HR 0 aceptada");
+  check.Expect(psyCompute(25.0f, 100.5f, 1013.25f).status == PSY_INVALID_INPUT, "HR > 100 aceptada");
+  check.Expect(psyCompute(90.0f, 50.0f, 1013.25f).status == PSY_INVALID_INPUT, "T 90 aceptada");
+  check.Expect(isnan(psyDewPoint(25.0f, -1.0f)), "rocío con HR negativa no es NAN");
+  check.Expect(psyCompute(-20.0f, 50.0f, 1013.25f).status == PSY_OUT_OF_ENVELOPE, "-20 °C sin marcar fuera de envolvente");
+  check.Expect(psyCompute(25.0f, 2.0f, 1013.25f).status == PSY_OUT_OF_ENVELOPE, "HR 2 sin marcar fuera de envolvente");
+  PsyState s = psyCompute(25.0f, 50.0f, 200.0f);
+  check.Expect(s.status == PSY_OK && !isnan(s.dewPoint) && isnan(s.wetBulb) && isnan(s.enthalpy),
+               "presión inválida no anula solo las magnitudes que dependen de ella");
+}
+
+void Benchmark() {
+  const long kCalls = 2000000;
+  float sink = 0.0f;
+  double single = NsPerCall(kCalls, [&](long i) {
+    PsyState s = psyCompute(-10.0f + (float)(i % 7000) * 0.01f, 5.0f + (float)(i % 950) * 0.1f, 1013.25f);
+    sink += s.wetBulb + s.enthalpy;
+  });
+  KeepValue(sink);
+  double dsink = 0.0;
+  double reference = NsPerCall(kCalls, [&](long i) {
+    Reference r = Compute(-10.0 + (double)(i % 7000) * 0.01, 5.0 + (double)(i % 950) * 0.1, kPressureHpa, true);
+    dsink += r.wetBulb + r.enthalpy;
+  });
+  KeepValue(dsink);
+  printf("  psyCompute %.1f ns/llamada, referencia double %.1f ns/llamada\n", single, reference);
+}
+
+}  // namespace
+
+int RunPsychrometricsCheck() {
+  Check check("psychrometrics");
+  Sweep(check);
+  Consistency(check);
+  InvalidInputs(check);
+  Benchmark();
+  return check.Report();
+}
+
+}  // namespace dropster
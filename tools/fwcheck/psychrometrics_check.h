@@ -0,0 +1,19 @@
+#ifndef DROPSTER_FWCHECK_PSYCHROMETRICS_CHECK_H_
+#define DROPSTER_FWCHECK_PSYCHROMETRICS_CHECK_H_
+
+// Barrido exhaustivo de psychrometrics.h (dropster-fwcheck psychrometrics).
+//
+// Recorre la envolvente documentada (-10..60 °C paso 0.01, 5..100 %RH paso 0.05, 1013.25 hPa)
+// comparando psyCompute() en float contra las mismas fórmulas evaluadas en double con libm;
+// el bulbo húmedo de referencia se resuelve por Newton hasta converger. Falla si algún error
+// supera la cota del header. También verifica el manejo de entradas inválidas y mide ns por
+// llamada frente a la versión en double.
+
+namespace dropster {
+
+// Devuelve 0 si todas las cotas se cumplen
+int RunPsychrometricsCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_PSYCHROMETRICS_CHECK_H_
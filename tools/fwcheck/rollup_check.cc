@@ -0,0 +1,256 @@
+#include "rollup_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rollup.h"
+
+namespace dropster {
+namespace {
+
+const uint32_t kEpoch = 1767225600;  // 2026-01-01 00:00:00, múltiplo de un día
+const uint32_t kStepS = 10;          // El firmware muestrea cada SENSOR_READ_INTERVAL; el paso no cambia la aritmética
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+// El motor ocupa unos 8 KB: en el heap como en un equipo de RAM justa
+std::unique_ptr<RollupEngine> Started() {
+  std::unique_ptr<RollupEngine> engine(new RollupEngine());
+  engine->begin();
+  return engine;
+}
+
+RollupSample Sample(float temp, float energy, float rate, bool compressorOn) {
+  RollupSample s;
+  s.values[ROLLUP_TEMP] = temp;
+  s.values[ROLLUP_HUM] = 50.0f;
+  s.values[ROLLUP_ABS_HUM] = 12.0f;
+  s.values[ROLLUP_VOLUME] = 4.0f;
+  s.values[ROLLUP_POWER] = compressorOn ? 450.0f : 5.0f;
+  s.energyKWh = energy;
+  s.productionRate = rate;
+  s.compressorOn = compressorOn;
+  return s;
+}
+
+bool Near(float a, float b, float tol) {
+  return fabsf(a - b) <= tol;
+}
+
+// Un minuto de 6 muestras: mín/máx/media/último, métrica ausente, fracción de compresor
+void MinuteAggregates(Scenario& sc) {
+  auto engine = Started();
+  const float temps[6] = {20.0f, 22.5f, 19.25f, 21.0f, 23.0f, 20.5f};
+  for (int i = 0; i < 6; i++) {
+    RollupSample s = Sample(temps[i], NAN, 1.2f, i < 3);
+    s.values[ROLLUP_HUM] = NAN;  // Sensor de humedad caído todo el minuto
+    engine->sample(kEpoch + (uint32_t)i * kStepS, s);
+  }
+  uint8_t closed = engine->sample(kEpoch + 60, Sample(30.0f, NAN, 1.2f, false));
+  sc.Expect(closed == (1 << ROLLUP_MINUTE), "el cambio de minuto no cierra solo el minuto");
+  const RollupRecord* r = engine->latest(ROLLUP_MINUTE);
+  if (!r) {
+    sc.Expect(false, "sin registro de minuto");
+    return;
+  }
+  sc.Expect(r->start == kEpoch && r->samples == 6, "inicio o muestras del minuto incorrectos");
+  sc.Expect(Near(rollupDecode(r->minV[ROLLUP_TEMP], ROLLUP_TEMP), 19.25f, 0.005f), "mínimo incorrecto");
+  sc.Expect(Near(rollupDecode(r->maxV[ROLLUP_TEMP], ROLLUP_TEMP), 23.0f, 0.005f), "máximo incorrecto");
+  sc.Expect(Near(rollupDecode(r->meanV[ROLLUP_TEMP], ROLLUP_TEMP), 21.0417f, 0.006f), "media incorrecta");
+  sc.Expect(Near(rollupDecode(r->lastV[ROLLUP_TEMP], ROLLUP_TEMP), 20.5f, 0.005f), "último incorrecto");
+  sc.Expect(r->meanV[ROLLUP_HUM] == ROLLUP_NO_VALUE && isnan(rollupDecode(r->lastV[ROLLUP_HUM], ROLLUP_HUM)),
+            "métrica sin muestras no queda como ROLLUP_NO_VALUE");
+  // 50 s integrados (la primera muestra no tiene paso); cada paso toma el estado de la muestra
+  // que lo cierra, así que las muestras 1 y 2 aportan 20 s de compresor encendido
+  sc.Expect(r->duty == 4000, "fracción de compresor " + std::to_string(r->duty) + " en vez de 4000");
+  sc.Expect(Near(r->waterL, 1.2f * 50.0f / 3600.0f, 1e-5f), "agua integrada incorrecta");
+  sc.Expect(isnan(r->energyKWh) == false && r->energyKWh == 0.0f, "energía sin contador no es cero");
+
+  RollupRecord open = {};
+  sc.Expect(engine->openRecord(ROLLUP_MINUTE, open) && open.start == kEpoch + 60 && open.samples == 1,
+            "el minuto siguiente no queda abierto con la muestra que cerró el anterior");
+  sc.Expect(engine->openRecord(ROLLUP_HOUR, open) && open.samples == 7, "la hora no acumula las mismas muestras");
+}
+
+// Escalado a int16: redondeo, saturación y valores negativos
+void Encoding(Scenario& sc) {
+  sc.Expect(rollupEncode(21.236f, ROLLUP_TEMP) == 2124, "redondeo a 0.01 °C");
+  sc.Expect(rollupEncode(-5.5f, ROLLUP_TEMP) == -550, "temperatura negativa");
+  sc.Expect(rollupEncode(5000.0f, ROLLUP_POWER) == 5000 && rollupEncode(1e6f, ROLLUP_POWER) == 32767, "saturación positiva");
+  sc.Expect(rollupEncode(-1e6f, ROLLUP_TEMP) == -32767, "la saturación negativa no debe chocar con ROLLUP_NO_VALUE");
+  sc.Expect(rollupEncode(NAN, ROLLUP_VOLUME) == ROLLUP_NO_VALUE, "NaN no se guarda como ROLLUP_NO_VALUE");
+}
+
+// RESET_ENERGY: el contador vuelve a cero y el retroceso no resta ni suma
+void EnergyRollback(Scenario& sc) {
+  auto engine = Started();
+  const float counter[] = {10.0f, 10.1f, 10.25f, 0.0f, 0.05f, 0.1f};
+  for (int i = 0; i < 6; i++) engine->sample(kEpoch + (uint32_t)i * kStepS, Sample(20.0f, counter[i], 0.0f, true));
+  // Un NaN del PZEM no corta la cadena: la próxima lectura se compara con la última válida
+  engine->sample(kEpoch + 6 * kStepS, Sample(20.0f, NAN, 0.0f, true));
+  engine->sample(kEpoch + 7 * kStepS, Sample(20.0f, 0.2f, 0.0f, true));
+  RollupRecord open = {};
+  sc.Expect(engine->openRecord(ROLLUP_HOUR, open), "sin hora abierta");
+  sc.Expect(Near(open.energyKWh, 0.25f + 0.2f, 1e-5f), "energía " + std::to_string(open.energyKWh) + " kWh en vez de 0.45");
+}
+
+// Saltos de reloj: un hueco largo o un reloj que retrocede no integran energía, agua ni tiempo
+void ClockGaps(Scenario& sc) {
+  auto engine = Started();
+  uint32_t t = kEpoch;
+  engine->sample(t, Sample(20.0f, 1.0f, 3.6f, true));
+  engine->sample(t += kStepS, Sample(20.0f, 1.01f, 3.6f, true));       // 10 s integrados
+  engine->sample(t += ROLLUP_MAX_GAP_S + 1, Sample(20.0f, 2.0f, 3.6f, true));  // Reinicio: no suma
+  engine->sample(t += kStepS, Sample(20.0f, 2.01f, 3.6f, true));       // 10 s más
+  engine->sample(t -= 30, Sample(20.0f, 2.02f, 3.6f, true));           // SET_TIME hacia atrás: no suma
+  engine->sample(t += kStepS, Sample(20.0f, 2.03f, 3.6f, true));       // 10 s más
+  RollupRecord open = {};
+  sc.Expect(engine->openRecord(ROLLUP_HOUR, open), "sin hora abierta");
+  sc.Expect(Near(open.energyKWh, 0.03f, 1e-4f), "energía " + std::to_string(open.energyKWh) + " kWh en vez de 0.03");
+  sc.Expect(Near(open.waterL, 3.6f * 30.0f / 3600.0f, 1e-5f), "agua integrada a través del salto");
+  sc.Expect(open.duty == 10000 && open.samples == 6, "fracción o muestras alteradas por el salto");
+
+  // Un salto que se lleva varios intervalos cierra solo el abierto, sin registros vacíos
+  uint8_t closed = engine->sample(t + 5 * 3600, Sample(20.0f, 2.03f, 0.0f, false));
+  sc.Expect((closed & (1 << ROLLUP_HOUR)) && engine->count(ROLLUP_HOUR) == 1, "un salto de 5 h no deja un único registro de hora");
+  sc.Expect(engine->sample(0, Sample(20.0f, 2.03f, 0.0f, false)) == 0, "una muestra sin RTC (epoch 0) se agrega");
+}
+
+// 130 minutos en la tabla de 60: quedan los últimos 60 en orden y la hora se cierra dos veces
+void RingWrap(Scenario& sc) {
+  auto engine = Started();
+  for (uint32_t t = kEpoch; t <= kEpoch + 130 * 60; t += kStepS) {
+    uint32_t minute = (t - kEpoch) / 60;
+    engine->sample(t, Sample((float)minute, NAN, 0.0f, false));
+  }
+  sc.Expect(engine->count(ROLLUP_MINUTE) == ROLLUP_MINUTE_BUCKETS, "la tabla de minutos no queda llena");
+  bool ordered = true;
+  for (uint16_t i = 0; i < engine->count(ROLLUP_MINUTE); i++) {
+    const RollupRecord& r = engine->record(ROLLUP_MINUTE, i);
+    uint32_t minute = 70 + i;
+    ordered = ordered && r.start == kEpoch + minute * 60 && r.lastV[ROLLUP_TEMP] == rollupEncode((float)minute, ROLLUP_TEMP);
+  }
+  sc.Expect(ordered, "los minutos no van del 70 al 129 en orden");
+  sc.Expect(engine->count(ROLLUP_HOUR) == 2 && engine->latest(ROLLUP_HOUR)->start == kEpoch + 3600, "horas cerradas incorrectas");
+  sc.Expect(engine->count(ROLLUP_DAY) == 0, "un día cerrado antes de tiempo");
+
+  // 40 días en la tabla de 31 (una muestra por hora basta para cerrar días)
+  for (uint32_t t = kEpoch + 3 * 3600; t <= kEpoch + 40 * 86400; t += 3600) engine->sample(t, Sample(1.0f, NAN, 0.0f, false));
+  sc.Expect(engine->count(ROLLUP_DAY) == ROLLUP_DAY_BUCKETS && engine->record(ROLLUP_DAY, 0).start == kEpoch + 9 * 86400,
+            "la tabla de días no conserva del día 9 al 39");
+  sc.Expect(engine->count(ROLLUP_HOUR) == ROLLUP_HOUR_BUCKETS, "la tabla de horas no queda llena");
+}
+
+// Lo que guarda el firmware en NVS: cabecera + bloque de registros por tabla y los acumuladores
+struct Stored {
+  RollupTableHeader header[ROLLUP_LEVEL_COUNT];
+  std::vector<uint8_t> table[ROLLUP_LEVEL_COUNT];
+  std::vector<uint8_t> accumulators;
+};
+
+Stored Save(RollupEngine& engine) {
+  Stored s;
+  for (uint8_t l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+    s.header[l] = engine.header(l);
+    const uint8_t* data = (const uint8_t*)engine.tableData(l);
+    s.table[l].assign(data, data + engine.tableBytes(l));
+  }
+  const uint8_t* acc = (const uint8_t*)engine.accumulators();
+  s.accumulators.assign(acc, acc + engine.accumulatorBytes());
+  return s;
+}
+
+bool Load(RollupEngine& engine, const Stored& s) {
+  bool ok = true;
+  for (uint8_t l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+    memcpy(engine.tableData(l), s.table[l].data(), s.table[l].size());
+    ok = engine.restoreTable(s.header[l]) && ok;
+  }
+  RollupAccumulator acc[ROLLUP_LEVEL_COUNT];
+  memcpy(acc, s.accumulators.data(), sizeof(acc));
+  engine.restoreAccumulators(acc);
+  return ok;
+}
+
+void PersistenceRoundTrip(Scenario& sc) {
+  auto engine = Started();
+  uint32_t t = kEpoch;
+  for (; t < kEpoch + 90 * 60 + 25; t += kStepS) engine->sample(t, Sample((float)((t / 60) % 7), 1.0f + (t - kEpoch) * 1e-5f, 1.0f, true));
+  Stored stored = Save(*engine);
+
+  auto restored = Started();
+  sc.Expect(Load(*restored, stored), "las cabeceras guardadas no se aceptan");
+  bool same = true;
+  for (uint8_t l = 0; l < ROLLUP_LEVEL_COUNT; l++) {
+    same = same && restored->count(l) == engine->count(l);
+    for (uint16_t i = 0; same && i < engine->count(l); i++) {
+      same = memcmp(&restored->record(l, i), &engine->record(l, i), sizeof(RollupRecord)) == 0;
+    }
+  }
+  sc.Expect(same, "los registros restaurados difieren");
+
+  // El minuto en curso sigue acumulando tras el reinicio
+  RollupRecord before = {}, after = {};
+  engine->openRecord(ROLLUP_MINUTE, before);
+  restored->sample(t, Sample(3.0f, NAN, 1.0f, true));
+  sc.Expect(restored->openRecord(ROLLUP_MINUTE, after) && after.start == before.start && after.samples == before.samples + 1, "el intervalo abierto no continúa tras restaurar");
+
+  // Una cabecera de otra versión o con índices fuera de rango se rechaza
+  auto other = Started();
+  RollupTableHeader bad = stored.header[ROLLUP_HOUR];
+  bad.version = ROLLUP_STORE_VERSION + 1;
+  sc.Expect(!other->restoreTable(bad), "cabecera de otra versión aceptada");
+  bad = stored.header[ROLLUP_MINUTE];
+  bad.count = ROLLUP_MINUTE_BUCKETS + 1;
+  sc.Expect(!other->restoreTable(bad), "cabecera con más registros que la tabla aceptada");
+  sc.Expect(other->count(ROLLUP_MINUTE) == 0, "una cabecera rechazada altera la tabla");
+
+  // Un acumulador corrupto (inicio desalineado) se descarta en vez de cerrarse como registro
+  RollupAccumulator acc[ROLLUP_LEVEL_COUNT];
+  memcpy(acc, stored.accumulators.data(), sizeof(acc));
+  acc[ROLLUP_HOUR].start += 17;
+  other->restoreAccumulators(acc);
+  other->sample(t + 2 * 3600, Sample(3.0f, NAN, 0.0f, false));
+  sc.Expect(other->count(ROLLUP_HOUR) == 0, "acumulador desalineado cerrado como registro");
+}
+
+}  // namespace
+
+int RunRollupCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"agregados de un minuto", MinuteAggregates},
+      {"escalado a int16", Encoding},
+      {"retroceso de energía", EnergyRollback},
+      {"saltos de reloj", ClockGaps},
+      {"desborde de las tablas", RingWrap},
+      {"ida y vuelta por NVS", PersistenceRoundTrip},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
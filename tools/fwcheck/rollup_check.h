@@ -0,0 +1,18 @@
+#ifndef DROPSTER_FWCHECK_ROLLUP_CHECK_H_
+#define DROPSTER_FWCHECK_ROLLUP_CHECK_H_
+
+// Escenarios sobre los agregados por minuto, hora y día de rollup.h (dropster-fwcheck rollup).
+//
+// Cada escenario alimenta RollupEngine (el mismo header del AWG) con muestras de hora
+// conocida y compara los registros cerrados con los valores esperados: mín/máx/media/último
+// y fracción de compresor, retroceso del contador de energía, saltos de reloj, desborde de
+// las tablas circulares y el ida y vuelta por el formato que se guarda en NVS.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunRollupCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_ROLLUP_CHECK_H_
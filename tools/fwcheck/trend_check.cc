@@ -0,0 +1,167 @@
+#include "trend_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "trend_store.h"
+
+namespace dropster {
+namespace {
+
+const uint32_t kFrameMs = 5000;  // UART_TRANSMIT_INTERVAL del AWG: una trama cada 5 s
+const uint32_t kMinuteMs = 60000;
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+std::unique_ptr<TrendStore> Started(uint32_t nowMs) {
+  std::unique_ptr<TrendStore> store(new TrendStore());
+  store->begin(nowMs);
+  return store;
+}
+
+void Values(float out[TREND_CHANNEL_COUNT], float hum) {
+  out[TREND_TEMP_AMB] = 24.0f;
+  out[TREND_HUM_AMB] = hum;
+  out[TREND_TEMP_EVAP] = 8.5f;
+  out[TREND_WATER] = 6.2f;
+  out[TREND_POWER] = 450.0f;
+}
+
+// Una caída de humedad de 20 s a las 10 h sigue en la vista de 24 h como mínimo de su intervalo
+void DipPreserved(Scenario& sc) {
+  auto store = Started(0);
+  float v[TREND_CHANNEL_COUNT];
+  const uint32_t dipAt = 10 * 3600000UL;
+  for (uint32_t t = 0; t < 24 * 3600000UL; t += kFrameMs) {
+    bool dip = t >= dipAt && t < dipAt + 20000;
+    Values(v, dip ? 31.0f : 60.0f + 5.0f * sinf((float)t / 3600000.0f));
+    store->sample(t, v);
+  }
+  sc.Expect(store->count(TREND_LEVEL_24H) == TREND_POINTS - 1, "24 h no dejan 119 intervalos de 12 min cerrados");
+  float lowest = 100.0f;
+  int lowestAt = -1;
+  for (uint16_t i = 0; i < store->count(TREND_LEVEL_24H); i++) {
+    float m = TrendStore::toValue(TREND_HUM_AMB, store->bucket(TREND_LEVEL_24H, i).min[TREND_HUM_AMB]);
+    if (m < lowest) {
+      lowest = m;
+      lowestAt = i;
+    }
+  }
+  sc.Expect(lowest == 31.0f, "mínimo de 24 h " + std::to_string(lowest) + " en vez de 31");
+  sc.Expect(lowestAt == (int)(dipAt / 720000UL), "la caída cae en el intervalo " + std::to_string(lowestAt));
+  const TrendBucket& b = store->bucket(TREND_LEVEL_24H, (uint16_t)lowestAt);
+  sc.Expect(TrendStore::toValue(TREND_HUM_AMB, b.max[TREND_HUM_AMB]) > 54.0f, "el máximo del intervalo no conserva el nivel normal");
+  sc.Expect(store->closed(TREND_LEVEL_2H) == 24 * 60 - 1 && store->count(TREND_LEVEL_2H) == TREND_POINTS,
+            "el anillo de 2 h no queda lleno");
+}
+
+// AWG desconectado 30 min: advance() cierra los intervalos vacíos y el canal NaN queda vacío
+void Gaps(Scenario& sc) {
+  auto store = Started(0);
+  float v[TREND_CHANNEL_COUNT];
+  Values(v, 55.0f);
+  v[TREND_POWER] = NAN;  // PZEM ausente
+  for (uint32_t t = 0; t < 10 * kMinuteMs; t += kFrameMs) store->sample(t, v);
+  uint8_t mask = store->advance(40 * kMinuteMs);
+  sc.Expect(mask & (1 << TREND_LEVEL_2H), "advance() no informa intervalos cerrados");
+  sc.Expect(store->count(TREND_LEVEL_2H) == 40, "intervalos tras el hueco: " + std::to_string(store->count(TREND_LEVEL_2H)));
+  const TrendBucket& before = store->bucket(TREND_LEVEL_2H, 9);
+  const TrendBucket& during = store->bucket(TREND_LEVEL_2H, 25);
+  sc.Expect(before.min[TREND_HUM_AMB] == TrendStore::toRaw(TREND_HUM_AMB, 55.0f), "intervalo con datos alterado");
+  sc.Expect(during.min[TREND_HUM_AMB] == TREND_INVALID && during.max[TREND_HUM_AMB] == TREND_INVALID, "intervalo del hueco no queda vacío");
+  sc.Expect(before.min[TREND_POWER] == TREND_INVALID, "canal NaN no queda vacío");
+  // El de 12 min que abarca datos y hueco conserva los datos
+  sc.Expect(store->bucket(TREND_LEVEL_24H, 0).min[TREND_HUM_AMB] != TREND_INVALID, "el intervalo de 12 min pierde los datos previos al hueco");
+  sc.Expect(store->bucket(TREND_LEVEL_24H, 2).min[TREND_HUM_AMB] == TREND_INVALID, "el intervalo de 12 min del hueco no queda vacío");
+}
+
+// millis() desborda a los 49.7 días en la pantalla: los intervalos siguen cerrándose de a uno
+void MillisWrap(Scenario& sc) {
+  uint32_t start = UINT32_MAX - 5 * kMinuteMs + 1;
+  auto store = Started(start);
+  float v[TREND_CHANNEL_COUNT];
+  uint32_t t = start;
+  for (int i = 0; i < 10 * 60000 / (int)kFrameMs; i++, t += kFrameMs) {
+    Values(v, (float)(40 + i / 12));  // Un valor por minuto
+    store->sample(t, v);
+  }
+  sc.Expect(store->count(TREND_LEVEL_2H) == 9, "intervalos cerrados a través del desborde: " + std::to_string(store->count(TREND_LEVEL_2H)));
+  bool ordered = true;
+  for (uint16_t i = 0; i < store->count(TREND_LEVEL_2H); i++) {
+    ordered = ordered && store->bucket(TREND_LEVEL_2H, i).max[TREND_HUM_AMB] == TrendStore::toRaw(TREND_HUM_AMB, (float)(40 + i));
+  }
+  sc.Expect(ordered, "los minutos no quedan en orden a través del desborde");
+}
+
+// Un hueco de días no recorre intervalo por intervalo más allá de las 24 h
+void LongGap(Scenario& sc) {
+  auto store = Started(0);
+  float v[TREND_CHANNEL_COUNT];
+  Values(v, 50.0f);
+  store->sample(1000, v);
+  store->advance(3 * 86400000UL);
+  uint32_t closes = store->closed(TREND_LEVEL_2H);
+  sc.Expect(closes <= TREND_POINTS * 12 + 1, "hueco de 3 días cierra " + std::to_string(closes) + " intervalos");
+  store->sample(3 * 86400000UL + 1000, v);
+  store->advance(3 * 86400000UL + kMinuteMs + 1000);
+  sc.Expect(store->closed(TREND_LEVEL_2H) == closes + 1, "tras el hueco el próximo minuto no cierra un solo intervalo");
+  const TrendBucket& last = store->bucket(TREND_LEVEL_2H, store->count(TREND_LEVEL_2H) - 1);
+  sc.Expect(last.min[TREND_HUM_AMB] == TrendStore::toRaw(TREND_HUM_AMB, 50.0f), "la muestra posterior al hueco no queda en el último intervalo");
+}
+
+void Benchmark() {
+  auto store = Started(0);
+  float v[TREND_CHANNEL_COUNT];
+  Values(v, 55.0f);
+  // Una trama cada 5 s: el costo incluye el cierre de minutos y la reducción a 12 min
+  double perSample = NsPerCall(4000000, [&](long i) {
+    v[TREND_HUM_AMB] = 50.0f + (float)(i & 63) * 0.1f;
+    store->sample((uint32_t)(i * (long)kFrameMs), v);
+  });
+  KeepValue(*store);
+  // Reducción sola: cerrar y combinar 24 h de minutos vacíos de una vez
+  auto idle = Started(0);
+  double perDay = NsPerCall(2000, [&](long i) { idle->advance((uint32_t)((i + 1) * 86400000UL)); });
+  KeepValue(*idle);
+  printf("        sample() %.1f ns/muestra, reducción de 24 h (1440 -> 120) %.1f µs\n", perSample, perDay / 1000.0);
+}
+
+}  // namespace
+
+int RunTrendCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"caída breve en la vista de 24 h", DipPreserved},
+      {"huecos y canales sin dato", Gaps},
+      {"desborde de millis()", MillisWrap},
+      {"hueco de varios días", LongGap},
+  };
+  int failed = 0;
+  for (const auto& entry : scenarios) {
+    Scenario scenario = {entry.name, {}};
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  Benchmark();
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
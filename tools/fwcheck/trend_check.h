@@ -0,0 +1,19 @@
+#ifndef DROPSTER_FWCHECK_TREND_CHECK_H_
+#define DROPSTER_FWCHECK_TREND_CHECK_H_
+
+// Escenarios y benchmark del almacén de tendencias de la pantalla, trend_store.h
+// (dropster-fwcheck trend).
+//
+// Alimenta TrendStore (el mismo header de mainDisplay) con series sintéticas al ritmo de las
+// tramas del AWG y verifica que la reducción a 12 min conserve los extremos, que los huecos
+// queden marcados, que el desborde de millis() y un hueco de más de 24 h no rompan los
+// anillos, y mide ns por muestra y el costo de la reducción.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunTrendCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_FWCHECK_TREND_CHECK_H_
@@ -0,0 +1,263 @@
+#ifndef DROPSTER_HISTORIAN_GORILLA_H_
+#define DROPSTER_HISTORIAN_GORILLA_H_
+
+// Compresión de series temporales estilo Gorilla (Pelkonen et al., VLDB 2015):
+// - Tiempos: delta-of-delta con prefijos de longitud variable. Con muestras cada 5 s y
+//   algunos ms de jitter la mayoría cae en los códigos de 9 o 12 bits en lugar de 64.
+// - Valores: XOR con el valor anterior; si no cambia cuesta 1 bit y si cambia se guardan
+//   solo los bits significativos, reutilizando la ventana anterior cuando cabe.
+//
+// Todo es aritmética uint64 para que los tiempos "ausentes" (INT64_MIN) y los saltos grandes
+// no provoquen desbordamientos con signo: codificar y decodificar envuelven igual.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+namespace dropster {
+
+class BitWriter {
+ public:
+  // bits en [1, 64]; se escriben los bits bajos de value, el más significativo primero
+  void Write(uint64_t value, int bits) {
+    if (bits < 64) value &= (1ULL << bits) - 1;
+    int space = 64 - fill_;
+    if (bits < space) {
+      acc_ |= value << (space - bits);
+      fill_ += bits;
+      return;
+    }
+    int rest = bits - space;
+    acc_ |= rest > 0 ? value >> rest : value;
+    FlushWord();
+    if (rest > 0) {
+      acc_ = value << (64 - rest);
+      fill_ = rest;
+    }
+  }
+
+  void WriteBit(bool bit) { Write(bit ? 1 : 0, 1); }
+
+  // Vuelca los bits pendientes (relleno con ceros) y devuelve el buffer
+  const std::vector<uint8_t>& Finish() {
+    for (int shift = 56; fill_ > 0; shift -= 8, fill_ -= 8) bytes_.push_back((uint8_t)(acc_ >> shift));
+    fill_ = 0;
+    acc_ = 0;
+    return bytes_;
+  }
+
+  size_t bit_count() const { return bytes_.size() * 8 + (size_t)fill_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  uint64_t acc_ = 0;
+  int fill_ = 0;
+
+  void FlushWord() {
+    for (int shift = 56; shift >= 0; shift -= 8) bytes_.push_back((uint8_t)(acc_ >> shift));
+    acc_ = 0;
+    fill_ = 0;
+  }
+};
+
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t length) : data_(data), length_(length) {}
+
+  uint64_t Read(int bits) {
+    uint64_t value = 0;
+    while (bits > 0) {
+      size_t byte = pos_ >> 3;
+      if (byte >= length_) {
+        overflow_ = true;
+        return bits >= 64 ? 0 : value << bits;
+      }
+      int avail = 8 - (int)(pos_ & 7);
+      int take = bits < avail ? bits : avail;
+      uint64_t chunk = ((uint64_t)data_[byte] >> (avail - take)) & ((1u << take) - 1);
+      value = (value << take) | chunk;
+      bits -= take;
+      pos_ += (size_t)take;
+    }
+    return value;
+  }
+
+  bool ReadBit() { return Read(1) != 0; }
+  bool overflow() const { return overflow_; }
+
+ private:
+  const uint8_t* data_;
+  size_t length_;
+  size_t pos_ = 0;
+  bool overflow_ = false;
+};
+
+// Extiende el signo de un campo de `bits` bits
+inline int64_t GorillaSignExtend(uint64_t value, int bits) {
+  uint64_t sign = 1ULL << (bits - 1);
+  return (int64_t)((value ^ sign) - sign);
+}
+
+// Prefijos delta-of-delta: 0 | 10+7 | 110+9 | 1110+12 | 11110+32 | 11111+64
+class TimestampEncoder {
+ public:
+  void Append(int64_t value) {
+    uint64_t v = (uint64_t)value;
+    if (count_++ == 0) {
+      out_.Write(v, 64);
+      prev_ = v;
+      return;
+    }
+    uint64_t delta = v - prev_;
+    int64_t dod = (int64_t)(delta - prev_delta_);
+    prev_ = v;
+    prev_delta_ = delta;
+    if (dod == 0) {
+      out_.WriteBit(false);
+    } else if (dod >= -64 && dod <= 63) {
+      out_.Write(0x2, 2);
+      out_.Write((uint64_t)dod, 7);
+    } else if (dod >= -256 && dod <= 255) {
+      out_.Write(0x6, 3);
+      out_.Write((uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+      out_.Write(0xE, 4);
+      out_.Write((uint64_t)dod, 12);
+    } else if (dod >= INT32_MIN && dod <= INT32_MAX) {
+      out_.Write(0x1E, 5);
+      out_.Write((uint64_t)dod, 32);
+    } else {
+      out_.Write(0x1F, 5);
+      out_.Write((uint64_t)dod, 64);
+    }
+  }
+
+  const std::vector<uint8_t>& Finish() { return out_.Finish(); }
+  size_t bit_count() const { return out_.bit_count(); }
+
+ private:
+  BitWriter out_;
+  uint32_t count_ = 0;
+  uint64_t prev_ = 0;
+  uint64_t prev_delta_ = 0;
+};
+
+class TimestampDecoder {
+ public:
+  TimestampDecoder(const uint8_t* data, size_t length) : in_(data, length) {}
+
+  int64_t Next() {
+    if (count_++ == 0) {
+      prev_ = in_.Read(64);
+      return (int64_t)prev_;
+    }
+    int64_t dod = 0;
+    if (in_.ReadBit()) {
+      if (!in_.ReadBit()) {
+        dod = GorillaSignExtend(in_.Read(7), 7);
+      } else if (!in_.ReadBit()) {
+        dod = GorillaSignExtend(in_.Read(9), 9);
+      } else if (!in_.ReadBit()) {
+        dod = GorillaSignExtend(in_.Read(12), 12);
+      } else if (!in_.ReadBit()) {
+        dod = GorillaSignExtend(in_.Read(32), 32);
+      } else {
+        dod = (int64_t)in_.Read(64);
+      }
+    }
+    prev_delta_ += (uint64_t)dod;
+    prev_ += prev_delta_;
+    return (int64_t)prev_;
+  }
+
+  bool overflow() const { return in_.overflow(); }
+
+ private:
+  BitReader in_;
+  uint32_t count_ = 0;
+  uint64_t prev_ = 0;
+  uint64_t prev_delta_ = 0;
+};
+
+// XOR de doubles: 0 (igual) | 10 + bits en la ventana anterior | 11 + 5 bits ceros a la
+// izquierda + 6 bits de longitud (0 = 64) + bits significativos
+class ValueEncoder {
+ public:
+  void Append(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (count_++ == 0) {
+      out_.Write(bits, 64);
+      prev_ = bits;
+      return;
+    }
+    uint64_t x = bits ^ prev_;
+    prev_ = bits;
+    if (x == 0) {
+      out_.WriteBit(false);
+      return;
+    }
+    int leading = __builtin_clzll(x);
+    int trailing = __builtin_ctzll(x);
+    if (leading > 31) leading = 31;  // Solo hay 5 bits para guardarlo
+    if (prev_leading_ >= 0 && leading >= prev_leading_ && trailing >= prev_trailing_) {
+      out_.Write(0x2, 2);
+      out_.Write(x >> prev_trailing_, 64 - prev_leading_ - prev_trailing_);
+      return;
+    }
+    int significant = 64 - leading - trailing;
+    out_.Write(0x3, 2);
+    out_.Write((uint64_t)leading, 5);
+    out_.Write((uint64_t)(significant & 63), 6);
+    out_.Write(x >> trailing, significant);
+    prev_leading_ = leading;
+    prev_trailing_ = trailing;
+  }
+
+  const std::vector<uint8_t>& Finish() { return out_.Finish(); }
+  size_t bit_count() const { return out_.bit_count(); }
+
+ private:
+  BitWriter out_;
+  uint32_t count_ = 0;
+  uint64_t prev_ = 0;
+  int prev_leading_ = -1;
+  int prev_trailing_ = 0;
+};
+
+class ValueDecoder {
+ public:
+  ValueDecoder(const uint8_t* data, size_t length) : in_(data, length) {}
+
+  double Next() {
+    if (count_++ == 0) {
+      prev_ = in_.Read(64);
+    } else if (in_.ReadBit()) {
+      if (in_.ReadBit()) {
+        prev_leading_ = (int)in_.Read(5);
+        int significant = (int)in_.Read(6);
+        if (significant == 0) significant = 64;
+        prev_trailing_ = 64 - prev_leading_ - significant;
+      }
+      int significant = 64 - prev_leading_ - prev_trailing_;
+      prev_ ^= in_.Read(significant) << prev_trailing_;
+    }
+    double value;
+    memcpy(&value, &prev_, sizeof(value));
+    return value;
+  }
+
+  bool overflow() const { return in_.overflow(); }
+
+ private:
+  BitReader in_;
+  uint32_t count_ = 0;
+  uint64_t prev_ = 0;
+  int prev_leading_ = 0;
+  int prev_trailing_ = 0;
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_HISTORIAN_GORILLA_H_
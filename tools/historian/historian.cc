@@ -0,0 +1,404 @@
+#include "historian.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+#include "event_loop.h"
+#include "flat_json.h"
+
+namespace dropster {
+
+namespace {
+
+void AppendNumber(std::string& out, double value) {
+  if (std::isnan(value) || std::isinf(value)) {
+    out += "null";
+    return;
+  }
+  // Representación más corta que vuelve al mismo double: "24.31" y no "24.309999999999999"
+  char buf[32];
+  std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, (size_t)(result.ptr - buf));
+}
+
+void AppendInt(std::string& out, int64_t value) {
+  char buf[24];
+  std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, (size_t)(result.ptr - buf));
+}
+
+bool ParseInt(const HttpServer::Query& query, const char* key, int64_t fallback, int64_t* out) {
+  auto it = query.find(key);
+  if (it == query.end() || it->second.empty()) {
+    *out = fallback;
+    return true;
+  }
+  char* end = nullptr;
+  long long value = strtoll(it->second.c_str(), &end, 10);
+  if (*end != '\0') return false;
+  *out = value;
+  return true;
+}
+
+int Error(std::string* body, int status, const std::string& message) {
+  *body = "{\"error\":\"";
+  AppendJsonEscaped(*body, message);
+  *body += "\"}";
+  return status;
+}
+
+}  // namespace
+
+Historian::Historian(SeriesStore& store, std::string data_topic)
+    : store_(store), data_topic_(std::move(data_topic)), started_ms_(EventLoop::NowMs()) {}
+
+void Historian::OnMessage(const std::string& topic, const char* payload, size_t length, int64_t now_ms) {
+  stats_.messages++;
+
+  // Mismo criterio que el runner de Linux: dropster/<id>/data o el tópico de datos configurado
+  size_t last = topic.rfind('/');
+  std::string leaf = last == std::string::npos ? topic : topic.substr(last + 1);
+  if (topic != data_topic_ && leaf != "data") return;
+  stats_.data_messages++;
+  stats_.payload_bytes += length;
+
+  int64_t start_us = EventLoop::NowUs();
+  std::string device = HISTORIAN_DEFAULT_DEVICE;
+  size_t first = topic.find('/');
+  if (first != std::string::npos && last != std::string::npos && first != last) {
+    device = topic.substr(first + 1, last - first - 1);
+  }
+
+  Sample sample;
+  sample.time_ms = now_ms;
+  sample.device_ts_ms = HISTORIAN_NO_DEVICE_TS;
+  for (double& value : sample.values) value = std::numeric_limits<double>::quiet_NaN();
+  bool any = false;
+  bool ok = ForEachJsonMember(payload, length, [&](const char* key, size_t key_len, const JsonValue& value) {
+    if ((key_len == 2 && memcmp(key, "id", 2) == 0) || (key_len == 6 && memcmp(key, "device", 6) == 0)) {
+      if (value.kind == JsonValue::kString && value.length > 0) device = value.Text();
+      return;
+    }
+    if (key_len == 2 && memcmp(key, "ts", 2) == 0) {
+      // unixtime del RTC (entero) o uptime en segundos con 2 decimales si no hay RTC
+      double ts = value.AsNumber();
+      if (!std::isnan(ts)) sample.device_ts_ms = llround(ts * 1000.0);
+      return;
+    }
+    int field = HistorianFieldIndex(key, key_len);
+    if (field < 0) return;  // mqtt_broker, mqtt_port, mqtt_topic, mqtt_connected...
+    sample.values[field] = value.AsNumber();
+    any = true;
+  });
+  if (!ok || !any) {
+    stats_.decode_errors++;
+    return;
+  }
+
+  std::string error;
+  DeviceSeries* series = store_.Get(device, true, &error);
+  if (!series) {
+    stats_.write_errors++;
+    fprintf(stderr, "[%s] %s\n", device.c_str(), error.c_str());
+    return;
+  }
+  if (series->Append(sample, &error)) {
+    stats_.samples++;
+    rate_slot_samples_++;
+  } else if (error.empty()) {
+    stats_.duplicates++;
+  } else {
+    stats_.write_errors++;
+    fprintf(stderr, "[%s] %s\n", device.c_str(), error.c_str());
+  }
+
+  int64_t elapsed = EventLoop::NowUs() - start_us;
+  stats_.ingest_us_total += elapsed;
+  if (elapsed > stats_.ingest_us_max) stats_.ingest_us_max = elapsed;
+}
+
+void Historian::Tick() {
+  rate_window_[rate_slot_] = rate_slot_samples_;
+  rate_slot_samples_ = 0;
+  rate_slot_ = (rate_slot_ + 1) % HISTORIAN_RATE_WINDOW_S;
+  if (rate_slots_filled_ < HISTORIAN_RATE_WINDOW_S) rate_slots_filled_++;
+
+  std::string error;
+  for (const auto& entry : store_.series()) {
+    if (!entry.second->SyncWal(&error)) {
+      stats_.write_errors++;
+      fprintf(stderr, "[%s] %s\n", entry.first.c_str(), error.c_str());
+    }
+  }
+}
+
+double Historian::recent_rate() const {
+  if (rate_slots_filled_ == 0) return 0;
+  uint64_t total = 0;
+  for (size_t i = 0; i < HISTORIAN_RATE_WINDOW_S; i++) total += rate_window_[i];
+  return (double)total / (double)rate_slots_filled_;
+}
+
+int Historian::HandleHttp(const std::string& path, const HttpServer::Query& query, std::string* body) {
+  int64_t start_us = EventLoop::NowUs();
+  int status;
+  if (path == "/api/devices") {
+    status = Devices(body);
+  } else if (path == "/api/range") {
+    status = Range(query, body);
+  } else if (path == "/api/rollup") {
+    status = Rollup(query, body);
+  } else if (path == "/api/stats") {
+    return Stats(body);  // No cuenta como consulta
+  } else {
+    return Error(body, 404, "ruta desconocida: " + path);
+  }
+  int64_t elapsed = EventLoop::NowUs() - start_us;
+  stats_.queries++;
+  stats_.query_us_total += elapsed;
+  if (elapsed > stats_.query_us_max) stats_.query_us_max = elapsed;
+  return status;
+}
+
+bool Historian::ParseFields(const HttpServer::Query& query, std::vector<int>* fields, std::string* error) const {
+  fields->clear();
+  auto it = query.find("fields");
+  if (it == query.end() || it->second.empty()) {
+    for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) fields->push_back(f);
+    return true;
+  }
+  const std::string& list = it->second;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t comma = list.find(',', start);
+    std::string key = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+    int field = HistorianFieldIndex(key.c_str(), key.size());
+    if (field < 0) {
+      *error = "campo desconocido: " + key;
+      return false;
+    }
+    fields->push_back(field);
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+  return true;
+}
+
+int Historian::Devices(std::string* body) const {
+  std::string& out = *body;
+  out = "{\"devices\":[";
+  bool first = true;
+  for (const auto& entry : store_.series()) {
+    const DeviceSeries& series = *entry.second;
+    if (!first) out += ',';
+    first = false;
+    out += "{\"id\":\"";
+    AppendJsonEscaped(out, series.device());
+    out += "\",\"samples\":";
+    AppendInt(out, (int64_t)series.sample_count());
+    out += ",\"blocks\":";
+    AppendInt(out, (int64_t)series.block_count());
+    out += ",\"from\":";
+    if (series.sample_count() > 0) {
+      AppendInt(out, series.first_ms());
+    } else {
+      out += "null";
+    }
+    out += ",\"to\":";
+    if (series.sample_count() > 0) {
+      AppendInt(out, series.last_ms());
+    } else {
+      out += "null";
+    }
+    out += ",\"fields\":[";
+    bool first_field = true;
+    for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+      if (!(series.field_mask() & (1u << f))) continue;
+      if (!first_field) out += ',';
+      first_field = false;
+      out += '"';
+      out += kHistorianFields[f];
+      out += '"';
+    }
+    out += "]}";
+  }
+  out += "]}";
+  return 200;
+}
+
+int Historian::Range(const HttpServer::Query& query, std::string* body) const {
+  auto device_it = query.find("device");
+  DeviceSeries* series = store_.Get(device_it == query.end() ? HISTORIAN_DEFAULT_DEVICE : device_it->second, false,
+                                    nullptr);
+  if (!series) return Error(body, 404, "dispositivo desconocido");
+  int64_t now = EventLoop::WallMs();
+  int64_t to, from, limit;
+  std::vector<int> fields;
+  std::string error;
+  if (!ParseInt(query, "to", now, &to) || !ParseInt(query, "from", to - 3600000LL, &from) ||
+      !ParseInt(query, "limit", HISTORIAN_RANGE_DEFAULT_LIMIT, &limit) || limit <= 0) {
+    return Error(body, 400, "from, to y limit deben ser enteros");
+  }
+  if (!ParseFields(query, &fields, &error)) return Error(body, 400, error);
+
+  std::vector<int64_t> times;
+  std::vector<std::vector<double>> columns;
+  QueryCost cost;
+  series->Range(from, to, fields, (size_t)limit, &times, &columns, &cost);
+
+  std::string& out = *body;
+  out = "{\"device\":\"";
+  AppendJsonEscaped(out, series->device());
+  out += "\",\"count\":";
+  AppendInt(out, (int64_t)times.size());
+  out += ",\"truncated\":";
+  out += times.size() >= (size_t)limit ? "true" : "false";
+  out += ",\"ts\":[";
+  for (size_t i = 0; i < times.size(); i++) {
+    if (i) out += ',';
+    AppendInt(out, times[i]);
+  }
+  out += ']';
+  for (size_t k = 0; k < fields.size(); k++) {
+    out += ",\"";
+    out += kHistorianFields[fields[k]];
+    out += "\":[";
+    for (size_t i = 0; i < columns[k].size(); i++) {
+      if (i) out += ',';
+      AppendNumber(out, columns[k][i]);
+    }
+    out += ']';
+  }
+  out += ",\"blocksScanned\":";
+  AppendInt(out, cost.blocks_scanned);
+  out += '}';
+  return 200;
+}
+
+int Historian::Rollup(const HttpServer::Query& query, std::string* body) const {
+  auto device_it = query.find("device");
+  DeviceSeries* series = store_.Get(device_it == query.end() ? HISTORIAN_DEFAULT_DEVICE : device_it->second, false,
+                                    nullptr);
+  if (!series) return Error(body, 404, "dispositivo desconocido");
+  int64_t now = EventLoop::WallMs();
+  int64_t to, from, step, tz_minutes;
+  std::vector<int> fields;
+  std::string error;
+  if (!ParseInt(query, "to", now, &to) || !ParseInt(query, "from", to - 86400000LL, &from) ||
+      !ParseInt(query, "step", 3600000LL, &step) || !ParseInt(query, "tz", 0, &tz_minutes) || step <= 0) {
+    return Error(body, 400, "from, to, step y tz deben ser enteros");
+  }
+  if (!ParseFields(query, &fields, &error)) return Error(body, 400, error);
+
+  std::vector<RollupBucket> buckets;
+  QueryCost cost;
+  if (!series->Rollup(from, to, step, tz_minutes * 60000LL, fields, HISTORIAN_ROLLUP_MAX_BUCKETS, &buckets, &cost)) {
+    return Error(body, 400, "rango vacío o demasiados intervalos para ese step");
+  }
+
+  std::string& out = *body;
+  out = "{\"device\":\"";
+  AppendJsonEscaped(out, series->device());
+  out += "\",\"step\":";
+  AppendInt(out, step);
+  out += ",\"start\":[";
+  for (size_t i = 0; i < buckets.size(); i++) {
+    if (i) out += ',';
+    AppendInt(out, buckets[i].start_ms);
+  }
+  out += "],\"samples\":[";
+  for (size_t i = 0; i < buckets.size(); i++) {
+    if (i) out += ',';
+    AppendInt(out, buckets[i].samples);
+  }
+  out += ']';
+  for (size_t k = 0; k < fields.size(); k++) {
+    out += ",\"";
+    out += kHistorianFields[fields[k]];
+    out += "\":{";
+    const char* names[3] = {"min", "max", "mean"};
+    for (int m = 0; m < 3; m++) {
+      if (m) out += ',';
+      out += '"';
+      out += names[m];
+      out += "\":[";
+      for (size_t i = 0; i < buckets.size(); i++) {
+        if (i) out += ',';
+        const FieldStats& stats = buckets[i].fields[k];
+        if (stats.count == 0) {
+          out += "null";
+        } else {
+          AppendNumber(out, m == 0 ? stats.min : m == 1 ? stats.max : stats.sum / stats.count);
+        }
+      }
+      out += ']';
+    }
+    out += '}';
+  }
+  out += ",\"blocksScanned\":";
+  AppendInt(out, cost.blocks_scanned);
+  out += ",\"blocksSummary\":";
+  AppendInt(out, cost.blocks_summary);
+  out += '}';
+  return 200;
+}
+
+int Historian::Stats(std::string* body) const {
+  uint64_t sealed_samples = 0;
+  uint64_t sealed_bytes = 0;
+  uint64_t wal_bytes = 0;
+  for (const auto& entry : store_.series()) {
+    sealed_samples += entry.second->sealed_samples();
+    sealed_bytes += entry.second->sealed_bytes();
+    wal_bytes += entry.second->wal_bytes();
+  }
+  double uptime_s = (double)(EventLoop::NowMs() - started_ms_) / 1000.0;
+  std::string& out = *body;
+  out = "{\"uptimeS\":";
+  AppendNumber(out, uptime_s);
+  out += ",\"devices\":";
+  AppendInt(out, (int64_t)store_.series().size());
+  out += ",\"messages\":";
+  AppendInt(out, (int64_t)stats_.messages);
+  out += ",\"dataMessages\":";
+  AppendInt(out, (int64_t)stats_.data_messages);
+  out += ",\"samples\":";
+  AppendInt(out, (int64_t)stats_.samples);
+  out += ",\"duplicates\":";
+  AppendInt(out, (int64_t)stats_.duplicates);
+  out += ",\"decodeErrors\":";
+  AppendInt(out, (int64_t)stats_.decode_errors);
+  out += ",\"writeErrors\":";
+  AppendInt(out, (int64_t)stats_.write_errors);
+  out += ",\"ingestRate\":";
+  AppendNumber(out, recent_rate());
+  out += ",\"ingestAvgUs\":";
+  AppendNumber(out, stats_.data_messages ? (double)stats_.ingest_us_total / stats_.data_messages : 0);
+  out += ",\"ingestMaxUs\":";
+  AppendInt(out, stats_.ingest_us_max);
+  out += ",\"sealedSamples\":";
+  AppendInt(out, (int64_t)sealed_samples);
+  out += ",\"sealedBytes\":";
+  AppendInt(out, (int64_t)sealed_bytes);
+  out += ",\"bytesPerSample\":";
+  AppendNumber(out, sealed_samples ? (double)sealed_bytes / sealed_samples : 0);
+  out += ",\"jsonBytesPerSample\":";
+  AppendNumber(out, stats_.data_messages ? (double)stats_.payload_bytes / stats_.data_messages : 0);
+  out += ",\"walBytes\":";
+  AppendInt(out, (int64_t)wal_bytes);
+  out += ",\"queries\":";
+  AppendInt(out, (int64_t)stats_.queries);
+  out += ",\"queryAvgUs\":";
+  AppendNumber(out, stats_.queries ? (double)stats_.query_us_total / stats_.queries : 0);
+  out += ",\"queryMaxUs\":";
+  AppendInt(out, stats_.query_us_max);
+  out += '}';
+  return 200;
+}
+
+}  // namespace dropster
@@ -0,0 +1,80 @@
+#ifndef DROPSTER_HISTORIAN_HISTORIAN_H_
+#define DROPSTER_HISTORIAN_HISTORIAN_H_
+
+// Servicio historiador: convierte los mensajes de dropster/data en muestras del almacén y
+// atiende la API local de consultas.
+//
+// API (GET, JSON; tiempos en ms desde epoch):
+//   /api/devices                         dispositivos, campos con datos, rango de tiempo
+//   /api/range?device=&from=&to=&fields=t,h&limit=
+//   /api/rollup?device=&from=&to=&step=&tz=&fields=
+//                                        min/max/media por intervalo (tz = minutos respecto
+//                                        de UTC para alinear los días de los reportes)
+//   /api/stats                           ritmo de ingesta, bytes por muestra, latencias
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "http_server.h"
+#include "series_store.h"
+
+namespace dropster {
+
+#define HISTORIAN_DEFAULT_DEVICE "dropster"  // Igual que el runner de Linux
+#define HISTORIAN_RATE_WINDOW_S 10
+#define HISTORIAN_RANGE_DEFAULT_LIMIT 20000
+#define HISTORIAN_ROLLUP_MAX_BUCKETS 20000
+
+struct HistorianStats {
+  uint64_t messages = 0;       // Todo lo recibido bajo dropster/#
+  uint64_t data_messages = 0;  // dropster/data y dropster/<id>/data
+  uint64_t samples = 0;        // Muestras escritas
+  uint64_t duplicates = 0;     // Mismo "ts" que la muestra anterior (retenido al reconectar)
+  uint64_t decode_errors = 0;
+  uint64_t write_errors = 0;
+  int64_t ingest_us_total = 0;  // Decodificar + escribir, por mensaje de datos
+  int64_t ingest_us_max = 0;
+  uint64_t queries = 0;
+  int64_t query_us_total = 0;
+  int64_t query_us_max = 0;
+  uint64_t payload_bytes = 0;  // JSON de los mensajes de datos, para comparar con el disco
+};
+
+class Historian {
+ public:
+  Historian(SeriesStore& store, std::string data_topic);
+
+  // Un mensaje MQTT; now_ms es el tiempo de recepción (reloj de pared)
+  void OnMessage(const std::string& topic, const char* payload, size_t length, int64_t now_ms);
+
+  // Llamar una vez por segundo: ritmo de ingesta de la ventana reciente y fdatasync de los WAL
+  void Tick();
+
+  // Ruteo de la API local (HttpServer::Handler)
+  int HandleHttp(const std::string& path, const HttpServer::Query& query, std::string* body);
+
+  const HistorianStats& stats() const { return stats_; }
+  double recent_rate() const;  // Muestras/s en los últimos HISTORIAN_RATE_WINDOW_S segundos
+
+ private:
+  SeriesStore& store_;
+  std::string data_topic_;
+  HistorianStats stats_;
+  int64_t started_ms_;
+  uint64_t rate_window_[HISTORIAN_RATE_WINDOW_S] = {};
+  uint64_t rate_slot_samples_ = 0;
+  size_t rate_slot_ = 0;
+  size_t rate_slots_filled_ = 0;
+
+  bool ParseFields(const HttpServer::Query& query, std::vector<int>* fields, std::string* error) const;
+  int Devices(std::string* body) const;
+  int Range(const HttpServer::Query& query, std::string* body) const;
+  int Rollup(const HttpServer::Query& query, std::string* body) const;
+  int Stats(std::string* body) const;
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_HISTORIAN_HISTORIAN_H_
@@ -0,0 +1,190 @@
+#include "http_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace dropster {
+
+#define HTTP_MAX_REQUEST 8192
+
+namespace {
+
+std::string UrlDecode(const std::string& text) {
+  std::string out;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      out += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1]) &&
+               isxdigit((unsigned char)text[i + 2])) {
+      out += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      out += text[i];
+    }
+  }
+  return out;
+}
+
+const char* StatusText(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Request Entity Too Large";
+    default: return "Internal Server Error";
+  }
+}
+
+}  // namespace
+
+HttpServer::~HttpServer() {
+  for (auto& entry : connections_) {
+    loop_.Remove(entry.first);
+    close(entry.first);
+  }
+  if (listen_fd_ >= 0) {
+    loop_.Remove(listen_fd_);
+    close(listen_fd_);
+  }
+}
+
+bool HttpServer::Listen(const std::string& address, int port, std::string* error) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    *error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    *error = "dirección inválida: " + address;
+    return false;
+  }
+  if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 64) != 0) {
+    *error = address + ":" + std::to_string(port) + ": " + strerror(errno);
+    return false;
+  }
+  return loop_.Add(listen_fd_, EPOLLIN, [this](uint32_t) { Accept(); });
+}
+
+void HttpServer::Accept() {
+  for (;;) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    connections_[fd] = Connection();
+    loop_.Add(fd, EPOLLIN, [this, fd](uint32_t events) {
+      if (events & EPOLLOUT) {
+        OnWritable(fd);
+      } else if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        OnReadable(fd);
+      }
+    });
+  }
+}
+
+void HttpServer::OnReadable(int fd) {
+  Connection& conn = connections_[fd];
+  char buf[4096];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      conn.in.append(buf, (size_t)n);
+      if (conn.in.size() > HTTP_MAX_REQUEST) {
+        Respond(fd, 413, "{\"error\":\"petición demasiado grande\"}");
+        return;
+      }
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    CloseConnection(fd);  // Cerrada antes de terminar la petición
+    return;
+  }
+  if (conn.in.find("\r\n\r\n") == std::string::npos && conn.in.find("\n\n") == std::string::npos) return;
+
+  // Línea de petición: GET /ruta?a=1&b=2 HTTP/1.1
+  size_t line_end = conn.in.find_first_of("\r\n");
+  std::string line = conn.in.substr(0, line_end);
+  size_t sp1 = line.find(' ');
+  size_t sp2 = line.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos) {
+    Respond(fd, 400, "{\"error\":\"petición inválida\"}");
+    return;
+  }
+  if (line.compare(0, sp1, "GET") != 0) {
+    Respond(fd, 405, "{\"error\":\"solo GET\"}");
+    return;
+  }
+  std::string target = line.substr(sp1 + 1, sp2 == std::string::npos ? std::string::npos : sp2 - sp1 - 1);
+  std::string path = target;
+  Query query;
+  size_t qmark = target.find('?');
+  if (qmark != std::string::npos) {
+    path = target.substr(0, qmark);
+    std::string rest = target.substr(qmark + 1);
+    size_t start = 0;
+    while (start <= rest.size()) {
+      size_t amp = rest.find('&', start);
+      std::string pair = rest.substr(start, amp == std::string::npos ? std::string::npos : amp - start);
+      size_t eq = pair.find('=');
+      if (!pair.empty()) {
+        query[UrlDecode(pair.substr(0, eq))] = eq == std::string::npos ? std::string() : UrlDecode(pair.substr(eq + 1));
+      }
+      if (amp == std::string::npos) break;
+      start = amp + 1;
+    }
+  }
+
+  std::string body;
+  int status = handler_(UrlDecode(path), query, &body);
+  Respond(fd, status, body);
+}
+
+void HttpServer::Respond(int fd, int status, const std::string& body) {
+  Connection& conn = connections_[fd];
+  char header[256];
+  snprintf(header, sizeof(header),
+           "HTTP/1.0 %d %s\r\nContent-Type: application/json; charset=utf-8\r\nContent-Length: %zu\r\n"
+           "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+           status, StatusText(status), body.size());
+  conn.out = header;
+  conn.out += body;
+  conn.sent = 0;
+  conn.in.clear();
+  loop_.Modify(fd, EPOLLOUT);
+  OnWritable(fd);
+}
+
+void HttpServer::OnWritable(int fd) {
+  Connection& conn = connections_[fd];
+  while (conn.sent < conn.out.size()) {
+    ssize_t n = write(fd, conn.out.data() + conn.sent, conn.out.size() - conn.sent);
+    if (n > 0) {
+      conn.sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    break;
+  }
+  CloseConnection(fd);
+}
+
+void HttpServer::CloseConnection(int fd) {
+  loop_.Remove(fd);
+  close(fd);
+  connections_.erase(fd);
+}
+
+}  // namespace dropster
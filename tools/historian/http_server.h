@@ -0,0 +1,51 @@
+#ifndef DROPSTER_HISTORIAN_HTTP_SERVER_H_
+#define DROPSTER_HISTORIAN_HTTP_SERVER_H_
+
+// Servidor HTTP/1.0 mínimo para la API local del historiador: solo GET, una petición por
+// conexión y respuestas JSON. Corre en el mismo EventLoop que la ingesta MQTT, así que las
+// consultas y la escritura nunca se pisan y no hace falta ningún lock.
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "event_loop.h"
+
+namespace dropster {
+
+class HttpServer {
+ public:
+  using Query = std::map<std::string, std::string>;
+  // Devuelve el código HTTP y deja el cuerpo JSON en *body
+  using Handler = std::function<int(const std::string& path, const Query& query, std::string* body)>;
+
+  HttpServer(EventLoop& loop, Handler handler) : loop_(loop), handler_(std::move(handler)) {}
+  ~HttpServer();
+  HttpServer(const HttpServer&) = delete;
+  HttpServer& operator=(const HttpServer&) = delete;
+
+  bool Listen(const std::string& address, int port, std::string* error);
+
+ private:
+  struct Connection {
+    std::string in;
+    std::string out;
+    size_t sent = 0;
+  };
+
+  EventLoop& loop_;
+  Handler handler_;
+  int listen_fd_ = -1;
+  std::unordered_map<int, Connection> connections_;
+
+  void Accept();
+  void OnReadable(int fd);
+  void OnWritable(int fd);
+  void Respond(int fd, int status, const std::string& body);
+  void CloseConnection(int fd);
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_HISTORIAN_HTTP_SERVER_H_
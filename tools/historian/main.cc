@@ -0,0 +1,488 @@
+// dropster-historian: historiador local de la telemetría Dropster.
+//
+//   dropster-historian [opciones]         servicio: se suscribe a dropster/# y sirve la API
+//   dropster-historian bench [opciones]   benchmark de ingesta, bytes por muestra y consultas
+//
+// Ver tools/README.md para la API y el formato de almacenamiento.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "historian.h"
+#include "http_server.h"
+#include "mqtt_client.h"
+#include "series_store.h"
+
+using namespace dropster;
+
+namespace {
+
+struct Options {
+  MqttOptions mqtt;
+  std::string topic = "dropster/#";
+  std::string data_topic = "dropster/data";  // MQTT_TOPIC_DATA del firmware
+  std::string data_dir;
+  std::string http_address = "127.0.0.1";
+  int http_port = 8095;
+  bool broker_given = false;
+  // bench
+  int devices = 10;
+  int samples = 17280;  // Un día a un mensaje cada 5 s
+  int queries = 200;
+};
+
+void Usage() {
+  fprintf(stderr,
+          "Uso: dropster-historian [bench] [opciones]\n"
+          "  --broker HOST         broker MQTT (localhost)\n"
+          "  --port N              puerto MQTT (1883)\n"
+          "  --user U --password P credenciales MQTT\n"
+          "  --client-id ID        id de cliente (dropster_historian_<pid>)\n"
+          "  --topic FILTRO        suscripción (dropster/#)\n"
+          "  --data-topic TOPICO   tópico de datos sin id de dispositivo (dropster/data)\n"
+          "  --data-dir DIR        almacén (~/.local/share/dropster-historian)\n"
+          "  --http HOST:PUERTO    API local (127.0.0.1:8095)\n"
+          "bench:\n"
+          "  --devices N           dispositivos simulados (10)\n"
+          "  --samples N           muestras por dispositivo (17280 = 1 día a 5 s)\n"
+          "  --queries N           repeticiones por tipo de consulta (200)\n"
+          "  --broker HOST         además, medir la ingesta pasando por ese broker\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  static const struct option long_options[] = {
+      {"broker", required_argument, nullptr, 'b'},   {"port", required_argument, nullptr, 'p'},
+      {"user", required_argument, nullptr, 'u'},     {"password", required_argument, nullptr, 'P'},
+      {"client-id", required_argument, nullptr, 'i'}, {"topic", required_argument, nullptr, 't'},
+      {"data-topic", required_argument, nullptr, 'T'}, {"data-dir", required_argument, nullptr, 'd'},
+      {"http", required_argument, nullptr, 'H'},     {"devices", required_argument, nullptr, 'n'},
+      {"samples", required_argument, nullptr, 's'},  {"queries", required_argument, nullptr, 'q'},
+      {"help", no_argument, nullptr, 'h'},           {nullptr, 0, nullptr, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+    switch (opt) {
+      case 'b':
+        options->mqtt.host = optarg;
+        options->broker_given = true;
+        break;
+      case 'p': options->mqtt.port = atoi(optarg); break;
+      case 'u': options->mqtt.username = optarg; break;
+      case 'P': options->mqtt.password = optarg; break;
+      case 'i': options->mqtt.client_id = optarg; break;
+      case 't': options->topic = optarg; break;
+      case 'T': options->data_topic = optarg; break;
+      case 'd': options->data_dir = optarg; break;
+      case 'H': {
+        std::string value = optarg;
+        size_t colon = value.rfind(':');
+        if (colon == std::string::npos) return false;
+        options->http_address = value.substr(0, colon);
+        options->http_port = atoi(value.c_str() + colon + 1);
+        break;
+      }
+      case 'n': options->devices = std::max(1, atoi(optarg)); break;
+      case 's': options->samples = std::max(2, atoi(optarg)); break;
+      case 'q': options->queries = std::max(1, atoi(optarg)); break;
+      default: return false;
+    }
+  }
+  if (options->mqtt.client_id.empty()) options->mqtt.client_id = "dropster_historian_" + std::to_string(getpid());
+  return true;
+}
+
+std::string DefaultDataDir() {
+  const char* xdg = getenv("XDG_DATA_HOME");
+  if (xdg && *xdg) return std::string(xdg) + "/dropster-historian";
+  const char* home = getenv("HOME");
+  std::string base = std::string(home ? home : ".") + "/.local/share";
+  mkdir((std::string(home ? home : ".") + "/.local").c_str(), 0755);
+  mkdir(base.c_str(), 0755);
+  return base + "/dropster-historian";
+}
+
+int RunService(Options& options) {
+  if (options.data_dir.empty()) options.data_dir = DefaultDataDir();
+  SeriesStore store(options.data_dir);
+  std::string error;
+  if (!store.Open(&error)) {
+    fprintf(stderr, "No se pudo abrir el almacén: %s\n", error.c_str());
+    return 1;
+  }
+
+  EventLoop loop;
+  loop.StopOnSignals();
+  Historian historian(store, options.data_topic);
+
+  HttpServer http(loop, [&historian](const std::string& path, const HttpServer::Query& query, std::string* body) {
+    return historian.HandleHttp(path, query, body);
+  });
+  if (!http.Listen(options.http_address, options.http_port, &error)) {
+    fprintf(stderr, "No se pudo abrir la API: %s\n", error.c_str());
+    return 1;
+  }
+
+  MqttClient mqtt(loop, options.mqtt);
+  mqtt.on_connect = [&]() {
+    fprintf(stderr, "Conectado a %s:%d, suscrito a %s\n", options.mqtt.host.c_str(), options.mqtt.port,
+            options.topic.c_str());
+    mqtt.Subscribe(options.topic, 1);
+  };
+  mqtt.on_disconnect = [](const std::string& reason) { fprintf(stderr, "MQTT desconectado: %s\n", reason.c_str()); };
+  mqtt.on_message = [&historian](const std::string& topic, const char* payload, size_t length) {
+    historian.OnMessage(topic, payload, length, EventLoop::WallMs());
+  };
+  mqtt.Connect();
+
+  loop.Every(1000, [&historian]() { historian.Tick(); });
+  fprintf(stderr, "Historiador: %zu dispositivos en %s, API en http://%s:%d/api/\n", store.series().size(),
+          options.data_dir.c_str(), options.http_address.c_str(), options.http_port);
+  loop.Run();
+  mqtt.Disconnect();
+  return 0;
+}
+
+// ---------------------------------------------------------------------------------------
+// Benchmark
+
+// Genera los mensajes tal como los arma transmitMQTTData(): strings con 2 decimales, "ts"
+// entero con RTC o uptime con 2 decimales sin RTC
+class PayloadGenerator {
+ public:
+  PayloadGenerator(int device, uint32_t seed) : device_(device), rng_(seed) {
+    t_ = 22 + device % 8;
+    h_ = 60 + device % 20;
+    w_ = 2.0;
+    e_ = 10.0 * device;
+    rtc_ = device % 2 == 0;
+  }
+
+  std::string Next(int index, int64_t time_ms, double* expected) {
+    std::normal_distribution<double> noise(0.0, 1.0);
+    t_ += 0.02 * noise(rng_);
+    h_ = std::min(99.0, std::max(20.0, h_ + 0.05 * noise(rng_)));
+    bool compressor = (index / 120) % 3 != 0;  // Ciclos de 10 min encendido / 5 apagado
+    double rate = compressor ? 0.45 + 0.01 * noise(rng_) : 0.0;
+    w_ = std::min(20.0, w_ + rate * 5.0 / 3600.0);
+    double power = compressor ? 310.0 + 4.0 * noise(rng_) : 6.5;
+    e_ += power * 5.0 / 3600000.0;
+    double te = compressor ? 4.0 + 0.3 * noise(rng_) : t_ - 1.0;
+
+    double values[HISTORIAN_FIELD_COUNT] = {
+        t_, h_, 1012.5 + 0.3 * std::sin(index / 720.0), w_, rate, 0.08,
+        te, compressor ? 95.0 : h_, compressor ? 55.0 + noise(rng_) : t_ + 2.0,
+        t_ - 6.0, 14.2 + 0.05 * noise(rng_), 121.0 + 0.5 * noise(rng_),
+        power / 120.0, power, e_, 20.0,
+    };
+    // El firmware publica float con 2 decimales: lo esperado es exactamente lo que viaja
+    char text[HISTORIAN_FIELD_COUNT][24];
+    for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+      snprintf(text[f], sizeof(text[f]), "%.2f", (double)(float)values[f]);
+      if (expected) expected[f] = strtod(text[f], nullptr);
+    }
+    char ts[32];
+    if (rtc_) {
+      snprintf(ts, sizeof(ts), "%lld", (long long)(time_ms / 1000));
+    } else {
+      snprintf(ts, sizeof(ts), "\"%.2f\"", (double)index * 5.0 + 12.0);
+    }
+    char payload[768];
+    snprintf(payload, sizeof(payload),
+             "{\"t\":\"%s\",\"h\":\"%s\",\"p\":\"%s\",\"w\":\"%s\",\"wr\":\"%s\",\"wu\":\"%s\",\"te\":\"%s\","
+             "\"he\":\"%s\",\"tc\":\"%s\",\"dp\":\"%s\",\"ha\":\"%s\",\"v\":\"%s\",\"c\":\"%s\",\"po\":\"%s\","
+             "\"e\":\"%s\",\"mqtt_broker\":\"192.168.1.10\",\"mqtt_port\":1883,\"mqtt_topic\":\"dropster/data\","
+             "\"mqtt_connected\":true,\"tank_capacity\":\"%s\",\"ts\":%s}",
+             text[0], text[1], text[2], text[3], text[4], text[5], text[6], text[7], text[8], text[9], text[10],
+             text[11], text[12], text[13], text[14], text[15], ts);
+    return payload;
+  }
+
+ private:
+  int device_;
+  std::mt19937 rng_;
+  double t_, h_, w_, e_;
+  bool rtc_;
+};
+
+std::string DeviceName(int device) {
+  char name[32];
+  snprintf(name, sizeof(name), "awg-%03d", device);
+  return name;
+}
+
+struct LatencySummary {
+  double avg_us, p50_us, p99_us, max_us;
+};
+
+LatencySummary Summarize(std::vector<int64_t>& samples) {
+  std::sort(samples.begin(), samples.end());
+  double total = 0;
+  for (int64_t v : samples) total += (double)v;
+  size_t n = samples.size();
+  return LatencySummary{total / (double)n, (double)samples[n / 2], (double)samples[std::min(n - 1, n * 99 / 100)],
+                        (double)samples[n - 1]};
+}
+
+void PrintLatency(const char* label, std::vector<int64_t>& samples) {
+  LatencySummary s = Summarize(samples);
+  printf("  %-34s media %8.1f µs  p50 %8.1f  p99 %8.1f  máx %8.1f\n", label, s.avg_us, s.p50_us, s.p99_us, s.max_us);
+}
+
+// Publica los mensajes generados a través del broker y los ingiere desde la suscripción
+bool IngestThroughBroker(Options& options, Historian& historian, const std::vector<std::vector<std::string>>& payloads,
+                         double* seconds) {
+  EventLoop loop;
+  MqttOptions sub_options = options.mqtt;
+  sub_options.client_id = options.mqtt.client_id + "_sub";
+  sub_options.reconnect_min_ms = 0;
+  MqttOptions pub_options = options.mqtt;
+  pub_options.client_id = options.mqtt.client_id + "_pub";
+  pub_options.reconnect_min_ms = 0;
+  MqttClient sub(loop, sub_options);
+  MqttClient pub(loop, pub_options);
+
+  size_t total = payloads.size() * payloads[0].size();
+  size_t received = 0;
+  size_t next = 0;
+  int64_t first_us = 0;
+  int64_t last_us = 0;
+  bool failed = false;
+  bool subscribed = false;
+
+  sub.on_message = [&](const std::string& topic, const char* payload, size_t length) {
+    int64_t now = EventLoop::NowUs();
+    if (received == 0) first_us = now;
+    last_us = now;
+    // Tiempo de recepción sintético: el mismo que en la ingesta local, para comparar bytes
+    size_t index = received;
+    int64_t time_ms = EventLoop::WallMs() - (int64_t)payloads[0].size() * 5000 +
+                      (int64_t)(index / payloads.size()) * 5000;
+    historian.OnMessage(topic, payload, length, time_ms);
+    if (++received == total) loop.Stop();
+  };
+  auto pump = [&]() {
+    // Publicar al ritmo que drena el socket, intercalando dispositivos como una flota real
+    while (next < total && pub.pending_output() < (256u << 10)) {
+      size_t device = next % payloads.size();
+      size_t index = next / payloads.size();
+      std::string topic = "dropster/" + DeviceName((int)device) + "/data";
+      if (!pub.Publish(topic, payloads[device][index], 0, false)) break;
+      next++;
+    }
+  };
+  sub.on_connect = [&]() {
+    sub.Subscribe("dropster/#", 1);
+    // El SUBACK no se expone: un margen corto antes de publicar alcanza en un broker local
+    loop.After(200, [&]() {
+      subscribed = true;
+      pub.Connect();
+    });
+  };
+  pub.on_connect = [&]() { pump(); };
+  auto on_fail = [&](const std::string& reason) {
+    fprintf(stderr, "Broker: %s\n", reason.c_str());
+    failed = true;
+    loop.Stop();
+  };
+  sub.on_disconnect = on_fail;
+  pub.on_disconnect = on_fail;
+  loop.Every(1, [&]() {
+    if (subscribed && pub.connected()) pump();
+  });
+  loop.After(120000, [&]() {
+    fprintf(stderr, "Broker: tiempo agotado con %zu de %zu mensajes\n", received, total);
+    loop.Stop();
+  });
+
+  sub.Connect();
+  loop.Run();
+  sub.on_disconnect = nullptr;
+  pub.on_disconnect = nullptr;
+  *seconds = (double)(last_us - first_us) / 1e6;
+  return !failed && received == total;
+}
+
+int RunBench(Options& options) {
+  bool temporary = options.data_dir.empty();
+  if (temporary) {
+    char pattern[] = "/tmp/dropster-historian-bench-XXXXXX";
+    if (!mkdtemp(pattern)) {
+      perror("mkdtemp");
+      return 1;
+    }
+    options.data_dir = pattern;
+  }
+  SeriesStore store(options.data_dir);
+  std::string error;
+  if (!store.Open(&error)) {
+    fprintf(stderr, "No se pudo abrir el almacén: %s\n", error.c_str());
+    return 1;
+  }
+  Historian historian(store, options.data_topic);
+
+  int devices = options.devices;
+  int samples = options.samples;
+  printf("Generando %d dispositivos × %d muestras (%.1f días a 5 s)...\n", devices, samples, samples * 5.0 / 86400.0);
+  int64_t base_ms = EventLoop::WallMs() - (int64_t)samples * 5000;
+  std::vector<std::vector<std::string>> payloads(devices);
+  std::vector<std::vector<int64_t>> times(devices);
+  std::vector<std::vector<double>> expected(devices);  // Para verificar la ida y vuelta
+  std::mt19937 jitter(7);
+  std::uniform_int_distribution<int> jitter_ms(-40, 40);
+  size_t json_bytes = 0;
+  for (int d = 0; d < devices; d++) {
+    PayloadGenerator generator(d, 1000 + d);
+    payloads[d].reserve(samples);
+    expected[d].resize((size_t)samples * HISTORIAN_FIELD_COUNT);
+    for (int i = 0; i < samples; i++) {
+      int64_t t = base_ms + (int64_t)i * 5000 + jitter_ms(jitter);
+      times[d].push_back(t);
+      payloads[d].push_back(generator.Next(i, t, &expected[d][(size_t)i * HISTORIAN_FIELD_COUNT]));
+      json_bytes += payloads[d].back().size();
+    }
+  }
+  size_t total = (size_t)devices * samples;
+
+  // Ingesta: intercalada por dispositivo, como llega de una flota
+  double ingest_s;
+  const char* ingest_label;
+  if (options.broker_given) {
+    ingest_label = "vía broker";
+    if (!IngestThroughBroker(options, historian, payloads, &ingest_s)) return 1;
+  } else {
+    ingest_label = "local";
+    int64_t start = EventLoop::NowUs();
+    for (int i = 0; i < samples; i++) {
+      for (int d = 0; d < devices; d++) {
+        historian.OnMessage("dropster/" + DeviceName(d) + "/data", payloads[d][i].data(), payloads[d][i].size(),
+                            times[d][i]);
+      }
+    }
+    ingest_s = (double)(EventLoop::NowUs() - start) / 1e6;
+  }
+  const HistorianStats& stats = historian.stats();
+  printf("\nIngesta (%s)\n", ingest_label);
+  printf("  %zu mensajes en %.3f s: %.0f mensajes/s\n", total, ingest_s, (double)total / ingest_s);
+  printf("  decodificar + escribir: media %.2f µs, máx %lld µs por mensaje\n",
+         (double)stats.ingest_us_total / (double)std::max<uint64_t>(1, stats.data_messages),
+         (long long)stats.ingest_us_max);
+  printf("  muestras %llu, duplicados %llu, errores %llu/%llu\n", (unsigned long long)stats.samples,
+         (unsigned long long)stats.duplicates, (unsigned long long)stats.decode_errors,
+         (unsigned long long)stats.write_errors);
+
+  // Almacenamiento: sellar los bloques abiertos para medir solo el formato comprimido
+  uint64_t sealed_bytes = 0;
+  uint64_t sealed_samples = 0;
+  for (const auto& entry : store.series()) {
+    if (!entry.second->SealOpenBlock(&error)) fprintf(stderr, "%s\n", error.c_str());
+    sealed_bytes += entry.second->sealed_bytes();
+    sealed_samples += entry.second->sealed_samples();
+  }
+  double per_sample = (double)sealed_bytes / (double)std::max<uint64_t>(1, sealed_samples);
+  double raw = 8.0 * (HISTORIAN_FIELD_COUNT + 2);
+  printf("\nAlmacenamiento (%d campos + 2 tiempos por muestra)\n", HISTORIAN_FIELD_COUNT);
+  printf("  %.2f bytes/muestra en disco (%.2f bits por valor)\n", per_sample,
+         per_sample * 8.0 / (HISTORIAN_FIELD_COUNT + 2));
+  printf("  JSON %.1f bytes/muestra (%.1fx), columnas sin comprimir %.0f bytes/muestra (%.1fx)\n",
+         (double)json_bytes / (double)total, (double)json_bytes / (double)total / per_sample, raw, raw / per_sample);
+
+  // Verificación de ida y vuelta sobre el almacén sellado
+  std::vector<int> all_fields;
+  for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) all_fields.push_back(f);
+  size_t mismatches = 0;
+  for (int d = 0; d < devices; d++) {
+    DeviceSeries* series = store.Get(DeviceName(d), false, nullptr);
+    std::vector<int64_t> got_times;
+    std::vector<std::vector<double>> got;
+    QueryCost cost;
+    series->Range(INT64_MIN, INT64_MAX, all_fields, (size_t)samples + 1, &got_times, &got, &cost);
+    if (got_times.size() != (size_t)samples) {
+      mismatches++;
+      continue;
+    }
+    for (int i = 0; i < samples; i++) {
+      if (got_times[i] != times[d][i]) mismatches++;
+      for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+        if (got[f][i] != expected[d][(size_t)i * HISTORIAN_FIELD_COUNT + f]) mismatches++;
+      }
+    }
+  }
+  // Vía broker el tiempo de recepción es el de llegada, no el generado
+  if (!options.broker_given) printf("  verificación: %s\n", mismatches == 0 ? "OK, sin pérdidas" : "DIFERENCIAS");
+
+  // Consultas a través de la API, como las haría la app
+  std::mt19937 rng(42);
+  int64_t end_ms = base_ms + (int64_t)samples * 5000;
+  int64_t span_ms = end_ms - base_ms;
+  struct QueryKind {
+    const char* label;
+    int64_t window_ms;
+    int64_t step_ms;  // 0 = rango crudo
+    const char* fields;
+  };
+  const QueryKind kinds[] = {
+      {"rango 1 h, 3 campos", 3600000LL, 0, "t,h,w"},
+      {"rango 1 h, todos los campos", 3600000LL, 0, ""},
+      {"rollup 24 h por hora (reporte)", 86400000LL, 3600000LL, ""},
+      {"rollup 24 h cada 5 min, 3 campos", 86400000LL, 300000LL, "t,h,w"},
+      {"rollup todo por día", span_ms + 1, 86400000LL, ""},
+  };
+  printf("\nConsultas (%d repeticiones, dispositivo y ventana al azar)\n", options.queries);
+  for (const QueryKind& kind : kinds) {
+    std::vector<int64_t> latencies;
+    size_t bytes = 0;
+    for (int q = 0; q < options.queries; q++) {
+      int device = (int)(rng() % (uint32_t)devices);
+      int64_t window = std::min(kind.window_ms, span_ms + 1);
+      int64_t from = base_ms + (int64_t)(rng() % (uint64_t)(span_ms - window + 2));
+      HttpServer::Query query;
+      query["device"] = DeviceName(device);
+      query["from"] = std::to_string(from);
+      query["to"] = std::to_string(from + window);
+      if (kind.fields[0]) query["fields"] = kind.fields;
+      if (kind.step_ms) query["step"] = std::to_string(kind.step_ms);
+      std::string body;
+      int64_t start = EventLoop::NowUs();
+      int status = historian.HandleHttp(kind.step_ms ? "/api/rollup" : "/api/range", query, &body);
+      latencies.push_back(EventLoop::NowUs() - start);
+      bytes += body.size();
+      if (status != 200) fprintf(stderr, "Consulta fallida: %s\n", body.c_str());
+    }
+    PrintLatency(kind.label, latencies);
+  }
+
+  printf("\nDatos en %s%s\n", options.data_dir.c_str(), temporary ? " (temporal)" : "");
+  if (temporary) {
+    for (const auto& entry : store.series()) {
+      std::string stem = options.data_dir + "/" + SeriesStore::FileStem(entry.first);
+      unlink((stem + ".dhs").c_str());
+      unlink((stem + ".wal").c_str());
+    }
+    rmdir(options.data_dir.c_str());
+  }
+  return mismatches == 0 || options.broker_given ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+  Options options;
+  if (!ParseOptions(bench ? argc - 1 : argc, bench ? argv + 1 : argv, &options)) {
+    Usage();
+    return 2;
+  }
+  return bench ? RunBench(options) : RunService(options);
+}
@@ -0,0 +1,569 @@
+#include "series_store.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "gorilla.h"
+
+namespace dropster {
+
+#define HISTORIAN_BLOCK_MAGIC 0x31424844u  // "DHB1"
+#define HISTORIAN_BLOCK_VERSION 1
+
+const char* const kHistorianFields[HISTORIAN_FIELD_COUNT] = {
+    "t", "h", "p", "w", "wr", "wu", "te", "he", "tc", "dp", "ha", "v", "c", "po", "e", "tank_capacity",
+};
+
+int HistorianFieldIndex(const char* key, size_t length) {
+  for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+    if (strlen(kHistorianFields[f]) == length && memcmp(kHistorianFields[f], key, length) == 0) return f;
+  }
+  return -1;
+}
+
+namespace {
+
+// Formato en disco (little endian, como la máquina que lo escribe)
+struct BlockHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t columns;
+  uint32_t count;
+  uint32_t payload_bytes;  // Directorio + datos de columnas
+  int64_t first_ms;
+  int64_t last_ms;
+  uint32_t crc;  // CRC-32 del payload
+  uint32_t reserved;
+};
+static_assert(sizeof(BlockHeader) == 40, "BlockHeader es parte del formato en disco");
+
+struct ColumnEntry {
+  uint32_t bytes;
+  uint32_t count;  // Valores no NaN (0 en las columnas de tiempo)
+  double min;
+  double max;
+  double sum;
+};
+static_assert(sizeof(ColumnEntry) == 32, "ColumnEntry es parte del formato en disco");
+
+#define HISTORIAN_DIRECTORY_BYTES (HISTORIAN_COLUMN_COUNT * sizeof(ColumnEntry))
+
+uint32_t Crc32(const uint8_t* data, size_t length) {
+  static uint32_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    ready = true;
+  }
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < length; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+bool PreadAll(int fd, void* buf, size_t length, uint64_t offset) {
+  uint8_t* p = (uint8_t*)buf;
+  while (length > 0) {
+    ssize_t n = pread(fd, p, length, (off_t)offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    offset += (uint64_t)n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+bool PwriteAll(int fd, const void* buf, size_t length, uint64_t offset) {
+  const uint8_t* p = (const uint8_t*)buf;
+  while (length > 0) {
+    ssize_t n = pwrite(fd, p, length, (off_t)offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    offset += (uint64_t)n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  if ((a % b != 0) && ((a < 0) != (b < 0))) q--;
+  return q;
+}
+
+}  // namespace
+
+void FieldStats::Reset() {
+  min = std::numeric_limits<double>::infinity();
+  max = -std::numeric_limits<double>::infinity();
+  sum = 0;
+  count = 0;
+}
+
+void FieldStats::Add(double value) {
+  if (std::isnan(value)) return;
+  if (value < min) min = value;
+  if (value > max) max = value;
+  sum += value;
+  count++;
+}
+
+void FieldStats::Merge(const FieldStats& other) {
+  if (other.count == 0) return;
+  if (other.min < min) min = other.min;
+  if (other.max > max) max = other.max;
+  sum += other.sum;
+  count += other.count;
+}
+
+DeviceSeries::DeviceSeries(std::string device, std::string path_prefix)
+    : device_(std::move(device)), dhs_path_(path_prefix + ".dhs"), wal_path_(path_prefix + ".wal") {}
+
+DeviceSeries::~DeviceSeries() {
+  if (wal_) fclose(wal_);
+  if (dhs_fd_ >= 0) close(dhs_fd_);
+}
+
+bool DeviceSeries::Open(std::string* error) {
+  dhs_fd_ = open(dhs_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (dhs_fd_ < 0) {
+    *error = dhs_path_ + ": " + strerror(errno);
+    return false;
+  }
+  return LoadBlocks(error) && ReplayWal(error);
+}
+
+bool DeviceSeries::LoadBlocks(std::string* error) {
+  struct stat st;
+  if (fstat(dhs_fd_, &st) != 0) {
+    *error = dhs_path_ + ": " + strerror(errno);
+    return false;
+  }
+  uint64_t size = (uint64_t)st.st_size;
+  uint64_t offset = 0;
+  ColumnEntry directory[HISTORIAN_COLUMN_COUNT];
+  while (offset + sizeof(BlockHeader) <= size) {
+    BlockHeader header;
+    if (!PreadAll(dhs_fd_, &header, sizeof(header), offset)) break;
+    if (header.magic != HISTORIAN_BLOCK_MAGIC || header.version != HISTORIAN_BLOCK_VERSION ||
+        header.columns != HISTORIAN_COLUMN_COUNT || header.payload_bytes < HISTORIAN_DIRECTORY_BYTES ||
+        offset + sizeof(header) + header.payload_bytes > size) {
+      break;
+    }
+    if (!PreadAll(dhs_fd_, directory, sizeof(directory), offset + sizeof(header))) break;
+    for (int c = 0; c < HISTORIAN_FIELD_COUNT; c++) {
+      if (directory[HISTORIAN_COLUMN_FIRST_FIELD + c].count > 0) field_mask_ |= 1u << c;
+    }
+    blocks_.push_back(BlockRef{offset, header.payload_bytes, header.count, header.first_ms, header.last_ms});
+    sealed_samples_ += header.count;
+    offset += sizeof(header) + header.payload_bytes;
+  }
+
+  // Solo el último bloque puede haber quedado a medias (corte durante la escritura)
+  if (!blocks_.empty()) {
+    std::vector<uint8_t> payload;
+    BlockHeader header;
+    const BlockRef& last = blocks_.back();
+    if (!ReadBlock(last, &payload) || !PreadAll(dhs_fd_, &header, sizeof(header), last.offset) ||
+        Crc32(payload.data(), payload.size()) != header.crc) {
+      fprintf(stderr, "[%s] Último bloque dañado, se descarta\n", device_.c_str());
+      offset = last.offset;
+      sealed_samples_ -= last.count;
+      blocks_.pop_back();
+    }
+  }
+  if (offset < size) {
+    fprintf(stderr, "[%s] Truncando %llu bytes incompletos de %s\n", device_.c_str(),
+            (unsigned long long)(size - offset), dhs_path_.c_str());
+    if (ftruncate(dhs_fd_, (off_t)offset) != 0) {
+      *error = dhs_path_ + ": " + strerror(errno);
+      return false;
+    }
+  }
+  sealed_bytes_ = offset;
+
+  if (!blocks_.empty()) {
+    last_time_ms_ = blocks_.back().last_ms;
+    // El ts del dispositivo de la última muestra, para descartar el retenido al reconectar
+    std::vector<uint8_t> payload;
+    if (ReadBlock(blocks_.back(), &payload)) {
+      const ColumnEntry* dir = (const ColumnEntry*)payload.data();
+      const uint8_t* data = payload.data() + HISTORIAN_DIRECTORY_BYTES + dir[HISTORIAN_COLUMN_TIME].bytes;
+      TimestampDecoder decoder(data, dir[HISTORIAN_COLUMN_DEVICE_TS].bytes);
+      for (uint32_t i = 0; i < blocks_.back().count; i++) last_device_ts_ = decoder.Next();
+    }
+  }
+  return true;
+}
+
+bool DeviceSeries::ReplayWal(std::string* error) {
+  FILE* in = fopen(wal_path_.c_str(), "rb");
+  if (in) {
+    Sample sample;
+    int64_t sealed_last = blocks_.empty() ? INT64_MIN : blocks_.back().last_ms;
+    while (fread(&sample, sizeof(sample), 1, in) == 1) {
+      // Un corte entre escribir el bloque y vaciar el WAL deja muestras ya selladas
+      if (sample.time_ms <= sealed_last) continue;
+      open_.push_back(sample);
+      last_time_ms_ = sample.time_ms;
+      if (sample.device_ts_ms != HISTORIAN_NO_DEVICE_TS) last_device_ts_ = sample.device_ts_ms;
+      for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+        if (!std::isnan(sample.values[f])) field_mask_ |= 1u << f;
+      }
+    }
+    fclose(in);
+  }
+  wal_ = fopen(wal_path_.c_str(), "ab");
+  if (!wal_) {
+    *error = wal_path_ + ": " + strerror(errno);
+    return false;
+  }
+  // Descartar un registro parcial al final y lo que ya está sellado
+  struct stat st;
+  if (fstat(fileno(wal_), &st) == 0 && (uint64_t)st.st_size != open_.size() * sizeof(Sample)) {
+    if (ftruncate(fileno(wal_), 0) != 0) {
+      *error = wal_path_ + ": " + strerror(errno);
+      return false;
+    }
+    for (const Sample& sample : open_) fwrite(&sample, sizeof(sample), 1, wal_);
+    if (fflush(wal_) != 0 || fdatasync(fileno(wal_)) != 0) {
+      *error = wal_path_ + ": " + strerror(errno);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DeviceSeries::Append(Sample sample, std::string* error) {
+  if (sample.device_ts_ms != HISTORIAN_NO_DEVICE_TS && sample.device_ts_ms == last_device_ts_) return false;
+  // El tiempo de recepción debe crecer: si el reloj del sistema retrocede se avanza 1 ms
+  if (sample.time_ms <= last_time_ms_) sample.time_ms = last_time_ms_ + 1;
+
+  // Bloques alineados a la hora: un rollup por hora o por día los resuelve con el directorio
+  if (!open_.empty() && (open_.size() >= HISTORIAN_BLOCK_MAX_SAMPLES ||
+                         FloorDiv(sample.time_ms, HISTORIAN_BLOCK_MAX_SPAN_MS) !=
+                             FloorDiv(open_.front().time_ms, HISTORIAN_BLOCK_MAX_SPAN_MS))) {
+    if (!WriteBlock(error)) return false;
+  }
+
+  if (fwrite(&sample, sizeof(sample), 1, wal_) != 1 || fflush(wal_) != 0) {
+    *error = wal_path_ + ": " + strerror(errno);
+    return false;
+  }
+  wal_dirty_ = true;
+  open_.push_back(sample);
+  last_time_ms_ = sample.time_ms;
+  if (sample.device_ts_ms != HISTORIAN_NO_DEVICE_TS) last_device_ts_ = sample.device_ts_ms;
+  for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+    if (!std::isnan(sample.values[f])) field_mask_ |= 1u << f;
+  }
+  return true;
+}
+
+bool DeviceSeries::SyncWal(std::string* error) {
+  if (!wal_dirty_) return true;
+  if (fdatasync(fileno(wal_)) != 0) {
+    *error = wal_path_ + ": " + strerror(errno);
+    return false;
+  }
+  wal_dirty_ = false;
+  return true;
+}
+
+bool DeviceSeries::SealOpenBlock(std::string* error) { return open_.empty() || WriteBlock(error); }
+
+bool DeviceSeries::WriteBlock(std::string* error) {
+  ColumnEntry directory[HISTORIAN_COLUMN_COUNT];
+  memset(directory, 0, sizeof(directory));
+  std::vector<uint8_t> data;
+  data.reserve(open_.size() * 24);
+
+  TimestampEncoder times;
+  TimestampEncoder device_ts;
+  for (const Sample& sample : open_) {
+    times.Append(sample.time_ms);
+    device_ts.Append(sample.device_ts_ms);
+  }
+  const std::vector<uint8_t>& time_bytes = times.Finish();
+  const std::vector<uint8_t>& device_ts_bytes = device_ts.Finish();
+  directory[HISTORIAN_COLUMN_TIME].bytes = (uint32_t)time_bytes.size();
+  directory[HISTORIAN_COLUMN_DEVICE_TS].bytes = (uint32_t)device_ts_bytes.size();
+  data.insert(data.end(), time_bytes.begin(), time_bytes.end());
+  data.insert(data.end(), device_ts_bytes.begin(), device_ts_bytes.end());
+
+  for (int f = 0; f < HISTORIAN_FIELD_COUNT; f++) {
+    ValueEncoder encoder;
+    FieldStats stats;
+    stats.Reset();
+    for (const Sample& sample : open_) {
+      // NaN canónico: el firmware puede producir distintos patrones y cada uno rompería la racha
+      double value = std::isnan(sample.values[f]) ? std::numeric_limits<double>::quiet_NaN() : sample.values[f];
+      encoder.Append(value);
+      stats.Add(value);
+    }
+    const std::vector<uint8_t>& bytes = encoder.Finish();
+    ColumnEntry& entry = directory[HISTORIAN_COLUMN_FIRST_FIELD + f];
+    entry.bytes = (uint32_t)bytes.size();
+    entry.count = stats.count;
+    entry.min = stats.count ? stats.min : 0;
+    entry.max = stats.count ? stats.max : 0;
+    entry.sum = stats.sum;
+    data.insert(data.end(), bytes.begin(), bytes.end());
+  }
+
+  std::vector<uint8_t> payload(HISTORIAN_DIRECTORY_BYTES + data.size());
+  memcpy(payload.data(), directory, HISTORIAN_DIRECTORY_BYTES);
+  memcpy(payload.data() + HISTORIAN_DIRECTORY_BYTES, data.data(), data.size());
+
+  BlockHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = HISTORIAN_BLOCK_MAGIC;
+  header.version = HISTORIAN_BLOCK_VERSION;
+  header.columns = HISTORIAN_COLUMN_COUNT;
+  header.count = (uint32_t)open_.size();
+  header.payload_bytes = (uint32_t)payload.size();
+  header.first_ms = open_.front().time_ms;
+  header.last_ms = open_.back().time_ms;
+  header.crc = Crc32(payload.data(), payload.size());
+
+  uint64_t offset = sealed_bytes_;
+  if (!PwriteAll(dhs_fd_, &header, sizeof(header), offset) ||
+      !PwriteAll(dhs_fd_, payload.data(), payload.size(), offset + sizeof(header)) || fdatasync(dhs_fd_) != 0) {
+    *error = dhs_path_ + ": " + strerror(errno);
+    return false;
+  }
+  blocks_.push_back(BlockRef{offset, header.payload_bytes, header.count, header.first_ms, header.last_ms});
+  sealed_bytes_ = offset + sizeof(header) + payload.size();
+  sealed_samples_ += open_.size();
+  open_.clear();
+
+  // Recién ahora el WAL sobra; si se corta antes, ReplayWal() descarta lo ya sellado
+  if (ftruncate(fileno(wal_), 0) != 0) {
+    *error = wal_path_ + ": " + strerror(errno);
+    return false;
+  }
+  wal_dirty_ = false;  // Todo lo pendiente quedó en el bloque, ya sincronizado
+  return true;
+}
+
+bool DeviceSeries::ReadBlock(const BlockRef& block, std::vector<uint8_t>* payload) const {
+  payload->resize(block.payload_bytes);
+  return PreadAll(dhs_fd_, payload->data(), payload->size(), block.offset + sizeof(BlockHeader));
+}
+
+bool DeviceSeries::DecodeBlock(const BlockRef& block, const std::vector<int>& fields, std::vector<int64_t>* times,
+                               std::vector<std::vector<double>>* columns) const {
+  ColumnEntry directory[HISTORIAN_COLUMN_COUNT];
+  uint64_t base = block.offset + sizeof(BlockHeader);
+  if (!PreadAll(dhs_fd_, directory, sizeof(directory), base)) return false;
+  uint64_t offsets[HISTORIAN_COLUMN_COUNT];
+  uint64_t offset = HISTORIAN_DIRECTORY_BYTES;
+  for (int c = 0; c < HISTORIAN_COLUMN_COUNT; c++) {
+    offsets[c] = offset;
+    offset += directory[c].bytes;
+  }
+  if (offset > block.payload_bytes) return false;
+
+  // Columnar: solo se leen y descomprimen el tiempo y los campos pedidos
+  std::vector<uint8_t> bytes(directory[HISTORIAN_COLUMN_TIME].bytes);
+  if (!PreadAll(dhs_fd_, bytes.data(), bytes.size(), base + offsets[HISTORIAN_COLUMN_TIME])) return false;
+  times->resize(block.count);
+  TimestampDecoder time_decoder(bytes.data(), bytes.size());
+  for (uint32_t i = 0; i < block.count; i++) (*times)[i] = time_decoder.Next();
+
+  columns->resize(fields.size());
+  for (size_t k = 0; k < fields.size(); k++) {
+    int column = HISTORIAN_COLUMN_FIRST_FIELD + fields[k];
+    bytes.resize(directory[column].bytes);
+    if (!PreadAll(dhs_fd_, bytes.data(), bytes.size(), base + offsets[column])) return false;
+    ValueDecoder decoder(bytes.data(), bytes.size());
+    std::vector<double>& values = (*columns)[k];
+    values.resize(block.count);
+    for (uint32_t i = 0; i < block.count; i++) values[i] = decoder.Next();
+  }
+  return true;
+}
+
+size_t DeviceSeries::FirstBlockEndingAfter(int64_t from_ms) const {
+  auto it = std::lower_bound(blocks_.begin(), blocks_.end(), from_ms,
+                             [](const BlockRef& block, int64_t t) { return block.last_ms < t; });
+  return (size_t)(it - blocks_.begin());
+}
+
+int64_t DeviceSeries::first_ms() const {
+  if (!blocks_.empty()) return blocks_.front().first_ms;
+  return open_.empty() ? INT64_MIN : open_.front().time_ms;
+}
+
+void DeviceSeries::Range(int64_t from_ms, int64_t to_ms, const std::vector<int>& fields, size_t limit,
+                         std::vector<int64_t>* times, std::vector<std::vector<double>>* columns,
+                         QueryCost* cost) const {
+  times->clear();
+  columns->assign(fields.size(), std::vector<double>());
+  std::vector<int64_t> block_times;
+  std::vector<std::vector<double>> block_columns;
+  for (size_t b = FirstBlockEndingAfter(from_ms); b < blocks_.size() && blocks_[b].first_ms <= to_ms; b++) {
+    if (!DecodeBlock(blocks_[b], fields, &block_times, &block_columns)) continue;
+    cost->blocks_scanned++;
+    cost->samples_decoded += blocks_[b].count;
+    for (size_t i = 0; i < block_times.size(); i++) {
+      if (block_times[i] < from_ms || block_times[i] > to_ms) continue;
+      if (times->size() >= limit) return;
+      times->push_back(block_times[i]);
+      for (size_t k = 0; k < fields.size(); k++) (*columns)[k].push_back(block_columns[k][i]);
+    }
+  }
+  for (const Sample& sample : open_) {
+    if (sample.time_ms < from_ms || sample.time_ms > to_ms) continue;
+    if (times->size() >= limit) return;
+    times->push_back(sample.time_ms);
+    for (size_t k = 0; k < fields.size(); k++) (*columns)[k].push_back(sample.values[fields[k]]);
+  }
+}
+
+bool DeviceSeries::Rollup(int64_t from_ms, int64_t to_ms, int64_t step_ms, int64_t offset_ms,
+                          const std::vector<int>& fields, size_t max_buckets, std::vector<RollupBucket>* out,
+                          QueryCost* cost) const {
+  out->clear();
+  if (step_ms <= 0 || to_ms < from_ms) return false;
+  auto bucket_of = [&](int64_t t) { return FloorDiv(t + offset_ms, step_ms); };
+  int64_t first_bucket = bucket_of(from_ms);
+  int64_t bucket_span = bucket_of(to_ms) - first_bucket + 1;
+  if (bucket_span <= 0 || (uint64_t)bucket_span > max_buckets) return false;
+
+  std::vector<RollupBucket> buckets((size_t)bucket_span);
+  for (size_t i = 0; i < buckets.size(); i++) {
+    buckets[i].start_ms = (first_bucket + (int64_t)i) * step_ms - offset_ms;
+    buckets[i].samples = 0;
+    buckets[i].fields.resize(fields.size());
+    for (FieldStats& stats : buckets[i].fields) stats.Reset();
+  }
+
+  std::vector<int64_t> block_times;
+  std::vector<std::vector<double>> block_columns;
+  ColumnEntry directory[HISTORIAN_COLUMN_COUNT];
+  for (size_t b = FirstBlockEndingAfter(from_ms); b < blocks_.size() && blocks_[b].first_ms <= to_ms; b++) {
+    const BlockRef& block = blocks_[b];
+    int64_t bucket = bucket_of(block.first_ms);
+    if (block.first_ms >= from_ms && block.last_ms <= to_ms && bucket == bucket_of(block.last_ms) &&
+        PreadAll(dhs_fd_, directory, sizeof(directory), block.offset + sizeof(BlockHeader))) {
+      // El bloque cae entero en un bucket: basta su directorio
+      RollupBucket& target = buckets[(size_t)(bucket - first_bucket)];
+      target.samples += block.count;
+      for (size_t k = 0; k < fields.size(); k++) {
+        const ColumnEntry& entry = directory[HISTORIAN_COLUMN_FIRST_FIELD + fields[k]];
+        target.fields[k].Merge(FieldStats{entry.min, entry.max, entry.sum, entry.count});
+      }
+      cost->blocks_summary++;
+      continue;
+    }
+    if (!DecodeBlock(block, fields, &block_times, &block_columns)) continue;
+    cost->blocks_scanned++;
+    cost->samples_decoded += block.count;
+    for (size_t i = 0; i < block_times.size(); i++) {
+      if (block_times[i] < from_ms || block_times[i] > to_ms) continue;
+      RollupBucket& target = buckets[(size_t)(bucket_of(block_times[i]) - first_bucket)];
+      target.samples++;
+      for (size_t k = 0; k < fields.size(); k++) target.fields[k].Add(block_columns[k][i]);
+    }
+  }
+  for (const Sample& sample : open_) {
+    if (sample.time_ms < from_ms || sample.time_ms > to_ms) continue;
+    RollupBucket& target = buckets[(size_t)(bucket_of(sample.time_ms) - first_bucket)];
+    target.samples++;
+    for (size_t k = 0; k < fields.size(); k++) target.fields[k].Add(sample.values[fields[k]]);
+  }
+
+  for (RollupBucket& bucket : buckets) {
+    if (bucket.samples > 0) out->push_back(std::move(bucket));
+  }
+  return true;
+}
+
+std::string SeriesStore::FileStem(const std::string& device) {
+  // Codificación reversible tipo URL: el id original se recupera del nombre al abrir
+  std::string stem;
+  for (unsigned char ch : device) {
+    if (isalnum(ch) || ch == '_' || ch == '-') {
+      stem += (char)ch;
+    } else {
+      char buf[4];
+      snprintf(buf, sizeof(buf), "%%%02X", ch);
+      stem += buf;
+    }
+  }
+  return stem.empty() ? std::string("%") : stem;
+}
+
+namespace {
+
+std::string DeviceFromStem(const std::string& stem) {
+  if (stem == "%") return std::string();
+  std::string device;
+  for (size_t i = 0; i < stem.size(); i++) {
+    if (stem[i] == '%' && i + 2 < stem.size() && isxdigit((unsigned char)stem[i + 1]) &&
+        isxdigit((unsigned char)stem[i + 2])) {
+      device += (char)strtol(stem.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      device += stem[i];
+    }
+  }
+  return device;
+}
+
+}  // namespace
+
+bool SeriesStore::Open(std::string* error) {
+  if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    *error = directory_ + ": " + strerror(errno);
+    return false;
+  }
+  DIR* dir = opendir(directory_.c_str());
+  if (!dir) {
+    *error = directory_ + ": " + strerror(errno);
+    return false;
+  }
+  std::vector<std::string> stems;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".dhs") == 0 || name.compare(name.size() - 4, 4, ".wal") == 0)) {
+      stems.push_back(name.substr(0, name.size() - 4));
+    }
+  }
+  closedir(dir);
+  std::sort(stems.begin(), stems.end());
+  stems.erase(std::unique(stems.begin(), stems.end()), stems.end());
+  for (const std::string& stem : stems) {
+    if (!Get(DeviceFromStem(stem), true, error)) return false;
+  }
+  return true;
+}
+
+DeviceSeries* SeriesStore::Get(const std::string& device, bool create, std::string* error) {
+  auto it = series_.find(device);
+  if (it != series_.end()) return it->second.get();
+  if (!create) return nullptr;
+  std::unique_ptr<DeviceSeries> series(new DeviceSeries(device, directory_ + "/" + FileStem(device)));
+  if (!series->Open(error)) return nullptr;
+  DeviceSeries* raw = series.get();
+  series_[device] = std::move(series);
+  return raw;
+}
+
+}  // namespace dropster
@@ -0,0 +1,170 @@
+#ifndef DROPSTER_HISTORIAN_SERIES_STORE_H_
+#define DROPSTER_HISTORIAN_SERIES_STORE_H_
+
+// Almacén columnar append-only de la telemetría del AWG.
+//
+// Por dispositivo hay dos archivos en el directorio de datos:
+// - <id>.dhs: bloques cerrados. Cada bloque guarda hasta HISTORIAN_BLOCK_MAX_SAMPLES muestras
+//   de una misma hora (UTC) como columnas independientes comprimidas con
+//   Gorilla: el tiempo de recepción y el "ts" del dispositivo con delta-of-delta y cada campo
+//   de transmitMQTTData() con XOR. Un directorio por bloque guarda min/max/suma/cuenta por
+//   columna, así los rollups que abarcan un bloque entero no necesitan descomprimirlo.
+// - <id>.wal: las muestras del bloque abierto, sin comprimir. Se vacía al cerrar el bloque y
+//   se reproduce al arrancar. Cada muestra se escribe al archivo al llegar (sobrevive a la
+//   caída del proceso) y SyncWal() la pasa al disco por lotes: un corte de energía pierde
+//   como mucho lo recibido desde la última sincronización.
+//
+// Los campos ausentes en un mensaje (sensor offline) se guardan como NaN: en XOR una racha
+// de NaN cuesta 1 bit por muestra y las consultas los ignoran.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dropster {
+
+// Claves numéricas de transmitMQTTData() (hardware/firmware/awg/mainAWG/mainAWG.ino)
+#define HISTORIAN_FIELD_COUNT 16
+extern const char* const kHistorianFields[HISTORIAN_FIELD_COUNT];
+int HistorianFieldIndex(const char* key, size_t length);
+
+// Columnas de un bloque: 0 = recepción (ms), 1 = "ts" del dispositivo (ms), 2.. = campos
+#define HISTORIAN_COLUMN_TIME 0
+#define HISTORIAN_COLUMN_DEVICE_TS 1
+#define HISTORIAN_COLUMN_FIRST_FIELD 2
+#define HISTORIAN_COLUMN_COUNT (HISTORIAN_COLUMN_FIRST_FIELD + HISTORIAN_FIELD_COUNT)
+
+#define HISTORIAN_BLOCK_MAX_SAMPLES 720       // 1 h a un mensaje cada 5 s
+#define HISTORIAN_BLOCK_MAX_SPAN_MS 3600000LL  // Y nunca cruza un múltiplo de este intervalo
+#define HISTORIAN_NO_DEVICE_TS INT64_MIN       // Mensaje sin "ts"
+
+struct Sample {
+  int64_t time_ms;       // Recepción (reloj del historiador, monotónico por dispositivo)
+  int64_t device_ts_ms;  // "ts" del AWG: unixtime del RTC o uptime si no hay RTC
+  double values[HISTORIAN_FIELD_COUNT];  // NaN = no vino en el mensaje
+};
+
+struct FieldStats {
+  double min;
+  double max;
+  double sum;
+  uint32_t count;  // Muestras no NaN
+
+  void Reset();
+  void Add(double value);
+  void Merge(const FieldStats& other);
+};
+
+struct RollupBucket {
+  int64_t start_ms;
+  uint32_t samples;
+  std::vector<FieldStats> fields;  // En el orden pedido
+};
+
+struct QueryCost {
+  uint32_t blocks_scanned = 0;   // Descomprimidos
+  uint32_t blocks_summary = 0;   // Resueltos con el directorio del bloque
+  uint32_t samples_decoded = 0;
+};
+
+class DeviceSeries {
+ public:
+  DeviceSeries(std::string device, std::string path_prefix);
+  ~DeviceSeries();
+  DeviceSeries(const DeviceSeries&) = delete;
+  DeviceSeries& operator=(const DeviceSeries&) = delete;
+
+  // Carga el índice de bloques (truncando una cola incompleta) y reproduce el WAL
+  bool Open(std::string* error);
+
+  // Devuelve false si la muestra es un duplicado (mismo "ts" que la anterior: el mensaje
+  // retenido que el broker reenvía al reconectar) o si falló la escritura
+  bool Append(Sample sample, std::string* error);
+
+  // fdatasync del WAL si hubo escrituras desde la última llamada. El historiador la llama en
+  // cada Tick() (1 s): un fsync por muestra costaría un acceso al disco por mensaje
+  bool SyncWal(std::string* error);
+
+  // Cierra el bloque abierto aunque no esté lleno (benchmarks y herramientas)
+  bool SealOpenBlock(std::string* error);
+
+  // Muestras en [from_ms, to_ms], como máximo `limit`
+  void Range(int64_t from_ms, int64_t to_ms, const std::vector<int>& fields, size_t limit,
+             std::vector<int64_t>* times, std::vector<std::vector<double>>* columns, QueryCost* cost) const;
+
+  // Agregados min/max/media por intervalo de step_ms, alineados a múltiplos de step_ms
+  // desplazados offset_ms (zona horaria de los reportes diarios). Solo buckets con datos
+  bool Rollup(int64_t from_ms, int64_t to_ms, int64_t step_ms, int64_t offset_ms, const std::vector<int>& fields,
+              size_t max_buckets, std::vector<RollupBucket>* out, QueryCost* cost) const;
+
+  const std::string& device() const { return device_; }
+  uint64_t sample_count() const { return sealed_samples_ + open_.size(); }
+  uint64_t sealed_samples() const { return sealed_samples_; }
+  uint64_t sealed_bytes() const { return sealed_bytes_; }
+  uint64_t wal_bytes() const { return open_.size() * sizeof(Sample); }
+  size_t block_count() const { return blocks_.size(); }
+  int64_t first_ms() const;
+  int64_t last_ms() const { return last_time_ms_; }
+  uint32_t field_mask() const { return field_mask_; }  // Campos que alguna vez tuvieron valor
+
+ private:
+  struct BlockRef {
+    uint64_t offset;  // Del encabezado en el .dhs
+    uint32_t payload_bytes;
+    uint32_t count;
+    int64_t first_ms;
+    int64_t last_ms;
+  };
+
+  std::string device_;
+  std::string dhs_path_;
+  std::string wal_path_;
+  int dhs_fd_ = -1;
+  FILE* wal_ = nullptr;
+  bool wal_dirty_ = false;  // Escrituras en el WAL todavía sin fdatasync
+  std::vector<BlockRef> blocks_;
+  std::vector<Sample> open_;
+  uint64_t sealed_samples_ = 0;
+  uint64_t sealed_bytes_ = 0;
+  int64_t last_time_ms_ = INT64_MIN;
+  int64_t last_device_ts_ = HISTORIAN_NO_DEVICE_TS;
+  uint32_t field_mask_ = 0;
+
+  bool LoadBlocks(std::string* error);
+  bool ReplayWal(std::string* error);
+  bool WriteBlock(std::string* error);
+  bool ReadBlock(const BlockRef& block, std::vector<uint8_t>* payload) const;
+  // Descomprime las columnas pedidas de un bloque; times siempre
+  bool DecodeBlock(const BlockRef& block, const std::vector<int>& fields, std::vector<int64_t>* times,
+                   std::vector<std::vector<double>>* columns) const;
+  size_t FirstBlockEndingAfter(int64_t from_ms) const;
+};
+
+class SeriesStore {
+ public:
+  explicit SeriesStore(std::string directory) : directory_(std::move(directory)) {}
+
+  // Crea el directorio si hace falta y abre las series existentes
+  bool Open(std::string* error);
+
+  // Serie del dispositivo; la crea si no existe. nullptr si no se pudo abrir
+  DeviceSeries* Get(const std::string& device, bool create, std::string* error);
+
+  const std::map<std::string, std::unique_ptr<DeviceSeries>>& series() const { return series_; }
+  const std::string& directory() const { return directory_; }
+
+  // Nombre de archivo seguro para un id de dispositivo arbitrario
+  static std::string FileStem(const std::string& device);
+
+ private:
+  std::string directory_;
+  std::map<std::string, std::unique_ptr<DeviceSeries>> series_;
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_HISTORIAN_SERIES_STORE_H_
@@ -0,0 +1,231 @@
+#include "file_server.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace dropster {
+
+#define FILE_SERVER_MAX_REQUEST 8192
+#define FILE_SERVER_TICK_MS 10
+
+FileServer::~FileServer() {
+  if (rate_timer_) loop_.Cancel(rate_timer_);
+  for (auto& entry : connections_) {
+    loop_.Remove(entry.first);
+    close(entry.first);
+  }
+  if (listen_fd_ >= 0) {
+    loop_.Remove(listen_fd_);
+    close(listen_fd_);
+  }
+}
+
+bool FileServer::Listen(const std::string& address, int port, std::string* error) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    *error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    *error = "dirección inválida: " + address;
+    return false;
+  }
+  if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 64) != 0) {
+    *error = address + ":" + std::to_string(port) + ": " + strerror(errno);
+    return false;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+  port_ = ntohs(addr.sin_port);  // Puerto 0 = uno libre (check)
+
+  if (options_.rate_bytes_per_s > 0) {
+    rate_timer_ = loop_.Every(FILE_SERVER_TICK_MS, [this]() {
+      budget_ = options_.rate_bytes_per_s * FILE_SERVER_TICK_MS / 1000;
+      std::vector<int> active;
+      for (auto& entry : connections_) {
+        if (entry.second.responding) active.push_back(entry.first);
+      }
+      for (int fd : active) {
+        loop_.Modify(fd, EPOLLOUT);
+        Pump(fd);
+      }
+    });
+  }
+  return loop_.Add(listen_fd_, EPOLLIN, [this](uint32_t) { Accept(); });
+}
+
+void FileServer::Accept() {
+  for (;;) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    connections_[fd] = Connection();
+    loop_.Add(fd, EPOLLIN, [this, fd](uint32_t events) {
+      if (events & EPOLLOUT) {
+        Pump(fd);
+      } else if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        OnReadable(fd);
+      }
+    });
+  }
+}
+
+void FileServer::OnReadable(int fd) {
+  Connection& conn = connections_[fd];
+  char buf[4096];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      conn.in.append(buf, (size_t)n);
+      if (conn.in.size() > FILE_SERVER_MAX_REQUEST) {
+        CloseConnection(fd);
+        return;
+      }
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    CloseConnection(fd);
+    return;
+  }
+  if (conn.responding || conn.in.find("\r\n\r\n") == std::string::npos) return;
+
+  stats_.requests++;
+  size_t line_end = conn.in.find("\r\n");
+  std::string line = conn.in.substr(0, line_end);
+  size_t sp1 = line.find(' ');
+  size_t sp2 = line.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos || line.compare(0, sp1, "GET") != 0) {
+    Respond(fd, 405, "Method Not Allowed", "", nullptr, 0, 0);
+    return;
+  }
+  std::string path = line.substr(sp1 + 1, sp2 == std::string::npos ? std::string::npos : sp2 - sp1 - 1);
+  auto file = files_.find(path.substr(0, path.find('?')));
+  if (file == files_.end()) {
+    Respond(fd, 404, "Not Found", "", nullptr, 0, 0);
+    return;
+  }
+  const std::vector<uint8_t>& data = file->second;
+
+  // Range: bytes=N- o bytes=N-M (un solo rango, lo que pide el AWG al reanudar)
+  size_t start = 0, end = data.size();
+  bool ranged = false;
+  size_t pos = line_end;
+  while (pos != std::string::npos && pos + 2 < conn.in.size()) {
+    size_t next = conn.in.find("\r\n", pos + 2);
+    std::string header = conn.in.substr(pos + 2, next == std::string::npos ? std::string::npos : next - pos - 2);
+    if (header.empty()) break;
+    if (strncasecmp(header.c_str(), "Range: bytes=", 13) == 0) {
+      const char* spec = header.c_str() + 13;
+      char* dash = nullptr;
+      unsigned long long first = strtoull(spec, &dash, 10);
+      if (dash == spec || *dash != '-') {
+        Respond(fd, 416, "Range Not Satisfiable", "", nullptr, 0, 0);
+        return;
+      }
+      start = (size_t)first;
+      if (isdigit((unsigned char)dash[1])) end = std::min<size_t>(data.size(), (size_t)strtoull(dash + 1, nullptr, 10) + 1);
+      ranged = true;
+    }
+    pos = next;
+  }
+  if (start > data.size() || start > end) {
+    Respond(fd, 416, "Range Not Satisfiable", "Content-Range: bytes */" + std::to_string(data.size()) + "\r\n",
+            nullptr, 0, 0);
+    return;
+  }
+  if (ranged) {
+    stats_.range_requests++;
+    std::string range = "Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(end - 1) + "/" +
+                        std::to_string(data.size()) + "\r\n";
+    Respond(fd, 206, "Partial Content", range, &data, start, end);
+  } else {
+    Respond(fd, 200, "OK", "", &data, start, end);
+  }
+}
+
+void FileServer::Respond(int fd, int status, const std::string& reason, const std::string& extra_headers,
+                         const std::vector<uint8_t>* body, size_t start, size_t end) {
+  Connection& conn = connections_[fd];
+  conn.head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Type: application/octet-stream\r\n" +
+              "Content-Length: " + std::to_string(body ? end - start : 0) + "\r\nAccept-Ranges: bytes\r\n" +
+              extra_headers + "Connection: close\r\n\r\n";
+  conn.body = body;
+  conn.body_pos = start;
+  conn.body_end = body ? end : 0;
+  conn.head_sent = 0;
+  conn.responding = true;
+  loop_.Modify(fd, EPOLLOUT);
+  Pump(fd);
+}
+
+void FileServer::Pump(int fd) {
+  auto it = connections_.find(fd);
+  if (it == connections_.end()) return;
+  Connection& conn = it->second;
+  while (conn.head_sent < conn.head.size()) {
+    ssize_t n = write(fd, conn.head.data() + conn.head_sent, conn.head.size() - conn.head_sent);
+    if (n > 0) {
+      conn.head_sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    CloseConnection(fd);
+    return;
+  }
+  while (conn.body_pos < conn.body_end) {
+    size_t chunk = std::min<size_t>(conn.body_end - conn.body_pos, 16384);
+    if (options_.rate_bytes_per_s > 0) {
+      if (budget_ <= 0) {
+        loop_.Modify(fd, 0);  // Sin EPOLLOUT hasta el próximo tick: el socket escribible no gira en vacío
+        return;
+      }
+      chunk = std::min<size_t>(chunk, (size_t)budget_);
+    }
+    if (options_.cut_every_bytes > 0) {
+      int64_t left = options_.cut_every_bytes - conn.sent_total;
+      if (left <= 0) {
+        stats_.cuts++;
+        CloseConnection(fd);  // Corte a mitad de la respuesta, como un WiFi que se cae
+        return;
+      }
+      chunk = std::min<size_t>(chunk, (size_t)left);
+    }
+    ssize_t n = write(fd, conn.body->data() + conn.body_pos, chunk);
+    if (n > 0) {
+      conn.body_pos += (size_t)n;
+      conn.sent_total += n;
+      stats_.bytes_sent += (uint64_t)n;
+      if (options_.rate_bytes_per_s > 0) budget_ -= n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    break;
+  }
+  CloseConnection(fd);
+}
+
+void FileServer::CloseConnection(int fd) {
+  loop_.Remove(fd);
+  close(fd);
+  connections_.erase(fd);
+}
+
+}  // namespace dropster
@@ -0,0 +1,76 @@
+#ifndef DROPSTER_OTA_FILE_SERVER_H_
+#define DROPSTER_OTA_FILE_SERVER_H_
+
+// Servidor HTTP/1.1 de paquetes OTA para pruebas locales: GET con Range (bytes=N- y N-M),
+// una petición por conexión. Puede limitar el ancho de banda para acercarse al WiFi del
+// AWG y cortar la conexión cada cierta cantidad de bytes para ejercitar la reanudación.
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.h"
+
+namespace dropster {
+
+struct FileServerOptions {
+  int64_t rate_bytes_per_s = 0;  // 0 = sin límite
+  int64_t cut_every_bytes = 0;   // Cierra sin terminar tras enviar esta cantidad; 0 = nunca
+};
+
+struct FileServerStats {
+  uint64_t requests = 0;
+  uint64_t range_requests = 0;
+  uint64_t bytes_sent = 0;  // Cuerpo, sin encabezados
+  uint64_t cuts = 0;
+};
+
+class FileServer {
+ public:
+  FileServer(EventLoop& loop, FileServerOptions options) : loop_(loop), options_(options) {}
+  ~FileServer();
+  FileServer(const FileServer&) = delete;
+  FileServer& operator=(const FileServer&) = delete;
+
+  // Contenido servido en /<name>
+  void AddFile(const std::string& name, std::vector<uint8_t> data) { files_["/" + name] = std::move(data); }
+  bool Listen(const std::string& address, int port, std::string* error);
+  int port() const { return port_; }
+  const FileServerStats& stats() const { return stats_; }
+
+ private:
+  struct Connection {
+    std::string in;
+    std::string head;  // Encabezados de la respuesta
+    const std::vector<uint8_t>* body = nullptr;
+    size_t body_pos = 0;
+    size_t body_end = 0;
+    size_t head_sent = 0;
+    int64_t sent_total = 0;  // Para el corte simulado
+    bool responding = false;
+  };
+
+  EventLoop& loop_;
+  FileServerOptions options_;
+  FileServerStats stats_;
+  std::map<std::string, std::vector<uint8_t>> files_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::unordered_map<int, Connection> connections_;
+  int64_t budget_ = 0;  // Bytes que aún se pueden enviar en este tick del limitador
+  EventLoop::TimerId rate_timer_ = 0;
+
+  void Accept();
+  void OnReadable(int fd);
+  void Respond(int fd, int status, const std::string& reason, const std::string& extra_headers,
+               const std::vector<uint8_t>* body, size_t start, size_t end);
+  void Pump(int fd);
+  void CloseConnection(int fd);
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_OTA_FILE_SERVER_H_
@@ -0,0 +1,858 @@
+// dropster-ota: paquetes de firmware firmados para el AWG y la pantalla, y su entrega.
+//
+//   dropster-ota keygen --out clave.key          clave de firma (Ed25519) y la pública para config.h
+//   dropster-ota pack --key K --version V IN OUT comprime y firma una imagen .bin
+//   dropster-ota inspect [--pubkey HEX] PKG      encabezado, firma y decodificación completa
+//   dropster-ota serve [opciones] PKG...         servidor HTTP con Range para OTA_URL / OTA_PULL
+//   dropster-ota pull --url URL --pubkey HEX     el cliente del AWG en el escritorio (reanudación)
+//   dropster-ota push --device ID PKG            envío por MQTT (OTA_PUSH)
+//   dropster-ota check                           prueba de punta a punta contra un servidor local
+//
+// Ver tools/README.md.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "file_server.h"
+#include "mqtt_topics.h"
+#include "package_builder.h"
+#include "pull_client.h"
+#include "push_client.h"
+
+using namespace dropster;
+
+namespace {
+
+#define CHECKPOINT_EVERY_BYTES 65536  // OTA_CHECKPOINT_EVERY_BYTES del firmware
+#define DEFAULT_MAX_IMAGE (16u << 20)
+
+struct Options {
+  std::string key_path;
+  std::string pubkey_hex;
+  std::string out_path;
+  std::string version;
+  std::string url;
+  std::string image_path;
+  uint8_t target = OTA_TARGET_AWG;
+  uint32_t block_size = OTA_MAX_BLOCK_SIZE;
+  bool compress = true;
+  uint32_t max_image = DEFAULT_MAX_IMAGE;
+  // serve
+  std::string listen = "0.0.0.0";
+  int port = 8080;
+  FileServerOptions server;
+  // push
+  MqttOptions mqtt;
+  std::string device;
+  std::string root = "dropster";
+  bool legacy_topics = false;
+  double wait_s = 600.0;
+  std::vector<std::string> files;
+};
+
+void Usage() {
+  fprintf(stderr,
+          "Uso: dropster-ota <keygen|pack|inspect|serve|pull|push|check> [opciones] [archivos]\n"
+          "keygen:\n"
+          "  --out ARCHIVO          semilla privada (hex, modo 600); no sobrescribe\n"
+          "pack IMAGEN PAQUETE:\n"
+          "  --key ARCHIVO          semilla de keygen\n"
+          "  --version V            versión (hasta 31 caracteres)\n"
+          "  --target awg|display   destino (awg)\n"
+          "  --block N              bytes de imagen por bloque, múltiplo de 4096 (16384)\n"
+          "  --no-compress          bloques sin comprimir\n"
+          "inspect PAQUETE, pull:\n"
+          "  --pubkey HEX | --key ARCHIVO   clave para verificar la firma\n"
+          "  --target awg|display   destino esperado (el del paquete en inspect)\n"
+          "  --max-size N           tamaño de la partición (16 MB)\n"
+          "  --url URL              (pull) http://host[:puerto]/ruta\n"
+          "  --out ARCHIVO          (pull) imagen descargada\n"
+          "serve PAQUETE...:\n"
+          "  --listen ADDR --port N dirección de escucha (0.0.0.0:8080); cada archivo en /<nombre>\n"
+          "  --rate B               límite de bytes/s (sin límite)\n"
+          "  --cut-every B          corta cada respuesta tras B bytes, para probar la reanudación\n"
+          "push PAQUETE:\n"
+          "  --broker HOST --port N --user U --password P   broker MQTT (localhost:1883)\n"
+          "  --device ID            id del equipo (awg-xxxxxxxxxxxx o SET_DEVICE_ID)\n"
+          "  --root R               raíz de tópicos (dropster)\n"
+          "  --legacy-topics        tópicos planos dropster/<hoja>\n"
+          "  --wait S               espera máxima del resultado (600)\n"
+          "check:\n"
+          "  --image ARCHIVO        imagen de prueba (el propio ejecutable)\n"
+          "  --rate B               límite de bytes/s de la descarga medida (sin límite)\n");
+}
+
+bool ParseTarget(const char* text, uint8_t* target) {
+  if (strcmp(text, "awg") == 0) {
+    *target = OTA_TARGET_AWG;
+  } else if (strcmp(text, "display") == 0) {
+    *target = OTA_TARGET_DISPLAY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* TargetName(uint8_t target) {
+  return target == OTA_TARGET_AWG ? "awg" : target == OTA_TARGET_DISPLAY ? "display" : "?";
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  static const struct option long_options[] = {
+      {"key", required_argument, nullptr, 'k'},      {"pubkey", required_argument, nullptr, 'K'},
+      {"out", required_argument, nullptr, 'o'},      {"version", required_argument, nullptr, 'v'},
+      {"target", required_argument, nullptr, 't'},   {"block", required_argument, nullptr, 'B'},
+      {"no-compress", no_argument, nullptr, 'N'},    {"max-size", required_argument, nullptr, 'm'},
+      {"url", required_argument, nullptr, 'U'},      {"image", required_argument, nullptr, 'i'},
+      {"listen", required_argument, nullptr, 'l'},   {"port", required_argument, nullptr, 'p'},
+      {"rate", required_argument, nullptr, 'r'},     {"cut-every", required_argument, nullptr, 'c'},
+      {"broker", required_argument, nullptr, 'b'},   {"user", required_argument, nullptr, 'u'},
+      {"password", required_argument, nullptr, 'P'}, {"device", required_argument, nullptr, 'd'},
+      {"root", required_argument, nullptr, 'R'},     {"legacy-topics", no_argument, nullptr, 'T'},
+      {"wait", required_argument, nullptr, 'w'},     {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  bool port_set = false;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+    switch (opt) {
+      case 'k': options->key_path = optarg; break;
+      case 'K': options->pubkey_hex = optarg; break;
+      case 'o': options->out_path = optarg; break;
+      case 'v': options->version = optarg; break;
+      case 't':
+        if (!ParseTarget(optarg, &options->target)) return false;
+        break;
+      case 'B': options->block_size = (uint32_t)strtoul(optarg, nullptr, 0); break;
+      case 'N': options->compress = false; break;
+      case 'm': options->max_image = (uint32_t)strtoul(optarg, nullptr, 0); break;
+      case 'U': options->url = optarg; break;
+      case 'i': options->image_path = optarg; break;
+      case 'l': options->listen = optarg; break;
+      case 'p':
+        options->port = atoi(optarg);
+        port_set = true;
+        break;
+      case 'r': options->server.rate_bytes_per_s = atoll(optarg); break;
+      case 'c': options->server.cut_every_bytes = atoll(optarg); break;
+      case 'b': options->mqtt.host = optarg; break;
+      case 'u': options->mqtt.username = optarg; break;
+      case 'P': options->mqtt.password = optarg; break;
+      case 'd': options->device = optarg; break;
+      case 'R': options->root = optarg; break;
+      case 'T': options->legacy_topics = true; break;
+      case 'w': options->wait_s = atof(optarg); break;
+      default: return false;
+    }
+  }
+  if (port_set) options->mqtt.port = options->port;
+  for (int i = optind; i < argc; i++) options->files.push_back(argv[i]);
+  return true;
+}
+
+bool ReadSeed(const std::string& path, uint8_t seed[ED25519_KEY_SIZE]) {
+  std::vector<uint8_t> text;
+  if (!ReadFile(path, &text)) {
+    fprintf(stderr, "No se puede leer la clave %s\n", path.c_str());
+    return false;
+  }
+  if (!ParseHex(std::string(text.begin(), text.end()), seed, ED25519_KEY_SIZE)) {
+    fprintf(stderr, "%s no contiene una semilla de 32 bytes en hex\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Clave pública desde --pubkey (hex o el arreglo de config.h) o derivada de --key
+bool LoadPublicKey(const Options& options, uint8_t pk[ED25519_KEY_SIZE]) {
+  if (!options.pubkey_hex.empty()) {
+    if (ParseHex(options.pubkey_hex, pk, ED25519_KEY_SIZE)) return true;
+    fprintf(stderr, "--pubkey: se esperan 32 bytes en hex\n");
+    return false;
+  }
+  if (!options.key_path.empty()) {
+    uint8_t seed[ED25519_KEY_SIZE];
+    if (!ReadSeed(options.key_path, seed)) return false;
+    Ed25519::publicKey(seed, pk);
+    return true;
+  }
+  fprintf(stderr, "Falta --pubkey o --key\n");
+  return false;
+}
+
+std::string CArray(const uint8_t* data, size_t len) {
+  std::string out = "{";
+  char byte[8];
+  for (size_t i = 0; i < len; i++) {
+    snprintf(byte, sizeof(byte), "%s0x%02x", i ? ", " : "", data[i]);
+    out += byte;
+  }
+  return out + "}";
+}
+
+// Flash en memoria con la semántica de la NOR del ESP32: escribir solo baja bits, así que
+// un bloque sin borrar antes (tras reanudar) se detecta al comparar
+class MemoryFlash : public OtaSink {
+ public:
+  explicit MemoryFlash(uint32_t size) : data(size, 0xFF) {}
+
+  bool writeBlock(uint32_t offset, const uint8_t* block, size_t len) override {
+    if (offset % OTA_SECTOR_SIZE != 0 || offset + len > data.size()) return false;
+    size_t erase_end = std::min<size_t>(data.size(), (offset + len + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE);
+    if (erase) std::fill(data.begin() + offset, data.begin() + erase_end, 0xFF);
+    for (size_t i = 0; i < len; i++) data[offset + i] &= block[i];
+    writes++;
+    return memcmp(data.data() + offset, block, len) == 0;
+  }
+
+  // Igual que el firmware: persiste cada CHECKPOINT_EVERY_BYTES de imagen y al terminar
+  void checkpoint(const OtaCheckpoint& cp) override {
+    if (cp.imageOffset - saved.imageOffset < CHECKPOINT_EVERY_BYTES && cp.imageOffset != final_size) return;
+    saved = cp;
+    saves++;
+  }
+
+  std::vector<uint8_t> data;
+  bool erase = true;          // false: simula un sink que no borra (debe fallar al reanudar)
+  uint32_t final_size = 0;
+  OtaCheckpoint saved = {};   // Lo que quedaría en NVS
+  int writes = 0;
+  int saves = 0;
+};
+
+std::vector<uint8_t> LoadImage(const Options& options) {
+  std::vector<uint8_t> image;
+  const std::string path = options.image_path.empty() ? "/proc/self/exe" : options.image_path;
+  if (!ReadFile(path, &image) || image.empty()) fprintf(stderr, "No se puede leer la imagen %s\n", path.c_str());
+  return image;
+}
+
+// ---------------------------------------------------------------------------------------
+// keygen, pack, inspect
+
+int RunKeygen(const Options& options) {
+  if (options.out_path.empty()) {
+    Usage();
+    return 2;
+  }
+  uint8_t seed[ED25519_KEY_SIZE];
+  int random = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (random < 0 || read(random, seed, sizeof(seed)) != (ssize_t)sizeof(seed)) {
+    fprintf(stderr, "No se pudo leer /dev/urandom\n");
+    return 1;
+  }
+  close(random);
+  int fd = open(options.out_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s (no se sobrescribe una clave existente)\n", options.out_path.c_str(), strerror(errno));
+    return 1;
+  }
+  std::string text = Hex(seed, sizeof(seed)) + "\n";
+  bool ok = write(fd, text.data(), text.size()) == (ssize_t)text.size();
+  close(fd);
+  if (!ok) return 1;
+  uint8_t pk[ED25519_KEY_SIZE];
+  Ed25519::publicKey(seed, pk);
+  printf("Clave privada en %s (guardarla fuera del repositorio)\n", options.out_path.c_str());
+  printf("Pública: %s\n", Hex(pk, sizeof(pk)).c_str());
+  printf("Para config.h del AWG (verifica también los paquetes de la pantalla):\n#define OTA_SIGNING_PUBLIC_KEY %s\n", CArray(pk, sizeof(pk)).c_str());
+  return 0;
+}
+
+int RunPack(const Options& options) {
+  if (options.files.size() != 2 || options.key_path.empty() || options.version.empty()) {
+    Usage();
+    return 2;
+  }
+  if (options.version.size() >= OTA_VERSION_MAX) {
+    fprintf(stderr, "La versión admite hasta %d caracteres\n", OTA_VERSION_MAX - 1);
+    return 2;
+  }
+  if (options.block_size == 0 || options.block_size > OTA_MAX_BLOCK_SIZE || options.block_size % OTA_SECTOR_SIZE) {
+    fprintf(stderr, "--block debe ser múltiplo de %d y no mayor que %d\n", OTA_SECTOR_SIZE, OTA_MAX_BLOCK_SIZE);
+    return 2;
+  }
+  uint8_t seed[ED25519_KEY_SIZE];
+  if (!ReadSeed(options.key_path, seed)) return 1;
+  std::vector<uint8_t> image;
+  if (!ReadFile(options.files[0], &image) || image.empty()) {
+    fprintf(stderr, "No se puede leer %s\n", options.files[0].c_str());
+    return 1;
+  }
+  PackageOptions package_options;
+  package_options.target = options.target;
+  package_options.version = options.version;
+  package_options.block_size = options.block_size;
+  package_options.compress = options.compress;
+  PackageStats stats;
+  int64_t start = EventLoop::NowUs();
+  std::vector<uint8_t> package = BuildPackage(image, package_options, seed, &stats);
+  int64_t elapsed = EventLoop::NowUs() - start;
+  if (!WriteFile(options.files[1], package)) {
+    fprintf(stderr, "No se puede escribir %s\n", options.files[1].c_str());
+    return 1;
+  }
+  printf("%s: %s %s, imagen %zu bytes → paquete %zu bytes (%.1f %%), %zu bloques (%zu sin comprimir), %.0f ms\n",
+         options.files[1].c_str(), TargetName(options.target), options.version.c_str(), image.size(), package.size(),
+         100.0 * (double)package.size() / (double)image.size(), stats.blocks, stats.raw_blocks, (double)elapsed / 1000.0);
+  return 0;
+}
+
+int RunInspect(const Options& options) {
+  if (options.files.size() != 1) {
+    Usage();
+    return 2;
+  }
+  std::vector<uint8_t> package;
+  if (!ReadFile(options.files[0], &package)) {
+    fprintf(stderr, "No se puede leer %s\n", options.files[0].c_str());
+    return 1;
+  }
+  OtaPackageInfo info;
+  if (package.size() < OTA_HEADER_SIZE || !info.parse(package.data())) {
+    printf("Encabezado inválido\n");
+    return 1;
+  }
+  printf("destino %s  versión %s  compresión %s  bloque %u\n", TargetName(info.target), info.version,
+         info.compression == OTA_COMPRESSION_LZSS ? "lzss" : "ninguna", info.blockSize);
+  printf("imagen %u bytes  payload %u bytes  paquete %zu bytes (esperado %u)\n", info.imageSize, info.payloadSize,
+         package.size(), OTA_HEADER_SIZE + info.payloadSize);
+  printf("sha256 %s\n", Hex(info.imageSha256, sizeof(info.imageSha256)).c_str());
+  if (options.pubkey_hex.empty() && options.key_path.empty()) {
+    printf("firma sin verificar (falta --pubkey)\n");
+    return 0;
+  }
+  uint8_t pk[ED25519_KEY_SIZE];
+  if (!LoadPublicKey(options, pk)) return 2;
+  MemoryFlash flash(info.imageSize);
+  flash.final_size = info.imageSize;
+  std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+  OtaSession session;
+  session.begin(&flash, pk, info.target, info.imageSize, buffer.data());
+  OtaResult result = session.feed(package.data(), package.size());
+  printf("resultado: %s\n", otaResultName(result));
+  return result == OTA_DONE ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------------------
+// serve, pull, push
+
+std::string BaseName(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+int RunServe(const Options& options) {
+  if (options.files.empty()) {
+    Usage();
+    return 2;
+  }
+  EventLoop loop;
+  loop.StopOnSignals();
+  FileServer server(loop, options.server);
+  for (const std::string& path : options.files) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, &data)) {
+      fprintf(stderr, "No se puede leer %s\n", path.c_str());
+      return 1;
+    }
+    server.AddFile(BaseName(path), std::move(data));
+  }
+  std::string error;
+  if (!server.Listen(options.listen, options.port, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  for (const std::string& path : options.files) {
+    printf("http://%s:%d/%s\n", options.listen.c_str(), server.port(), BaseName(path).c_str());
+  }
+  fflush(stdout);
+  loop.Run();
+  const FileServerStats& stats = server.stats();
+  printf("\n%llu peticiones (%llu con Range), %.1f MB enviados, %llu cortes\n", (unsigned long long)stats.requests,
+         (unsigned long long)stats.range_requests, (double)stats.bytes_sent / 1048576.0,
+         (unsigned long long)stats.cuts);
+  return 0;
+}
+
+int RunPull(const Options& options) {
+  if (options.url.empty()) {
+    Usage();
+    return 2;
+  }
+  uint8_t pk[ED25519_KEY_SIZE];
+  if (!LoadPublicKey(options, pk)) return 2;
+  EventLoop loop;
+  loop.StopOnSignals();
+  MemoryFlash flash(options.max_image);
+  std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+  OtaSession session;
+  session.begin(&flash, pk, options.target, options.max_image, buffer.data());
+  PullClient client(loop, options.url, session);
+  OtaResult final_result = OTA_CONTINUE;
+  std::string detail;
+  client.on_finish = [&](OtaResult result, const std::string& text) {
+    final_result = result;
+    detail = text;
+    loop.Stop();
+  };
+  loop.Every(1000, [&]() {
+    if (session.headerVerified()) {
+      printf("  %u / %u bytes del paquete\n", session.resumeOffset(), session.packageSize());
+      fflush(stdout);
+    }
+  });
+  client.Start();
+  loop.Run();
+
+  const PullStats& stats = client.stats();
+  double seconds = (double)(std::max(stats.finished_ms, EventLoop::NowMs()) - stats.started_ms) / 1000.0;
+  printf("%s: %s  %d intentos (%d reanudados), %.1f KB recibidos en %.1f s (%.0f KB/s)\n", otaResultName(final_result),
+         detail.c_str(), stats.attempts, stats.resumes, (double)stats.bytes_received / 1024.0, seconds,
+         (double)stats.bytes_received / 1024.0 / std::max(0.001, seconds));
+  if (final_result != OTA_DONE) return 1;
+  printf("versión %s, imagen %u bytes\n", session.info().version, session.info().imageSize);
+  if (!options.out_path.empty()) {
+    std::vector<uint8_t> image(flash.data.begin(), flash.data.begin() + session.info().imageSize);
+    if (!WriteFile(options.out_path, image)) return 1;
+  }
+  return 0;
+}
+
+int RunPush(Options& options) {
+  if (options.files.size() != 1 || !mqttDeviceIdValid(options.device.c_str())) {
+    Usage();
+    return 2;
+  }
+  std::vector<uint8_t> package;
+  OtaPackageInfo info;
+  if (!ReadFile(options.files[0], &package) || package.size() < OTA_HEADER_SIZE || !info.parse(package.data())) {
+    fprintf(stderr, "%s no es un paquete OTA\n", options.files[0].c_str());
+    return 1;
+  }
+  MqttTopics topics;
+  topics.build(options.root.c_str(), options.device.c_str(), options.legacy_topics);
+  options.mqtt.client_id = "dropster-ota-" + std::to_string(getpid());
+  options.mqtt.reconnect_min_ms = 1000;
+
+  EventLoop loop;
+  loop.StopOnSignals();
+  PushClient client(loop, options.mqtt, PushTopics{topics.control, topics.status, topics.ota}, package);
+  bool ok = false;
+  std::string detail = "sin respuesta";
+  std::string last_state;
+  uint32_t last_percent = 101;
+  client.on_progress = [&](const std::string& state, uint32_t offset, const std::string& payload) {
+    uint32_t percent = (uint32_t)(100.0 * offset / package.size());
+    if (state == last_state && (state == "receiving" || state == "display") && percent / 10 == last_percent / 10) return;
+    printf("  %s\n", payload.c_str());
+    fflush(stdout);
+    last_state = state;
+    last_percent = percent;
+  };
+  client.on_finish = [&](bool success, const std::string& text) {
+    ok = success;
+    detail = text;
+    loop.Stop();
+  };
+  loop.After((int64_t)(options.wait_s * 1000.0), [&loop]() { loop.Stop(); });
+  printf("Enviando %s (%s %s, %zu bytes) a %s\n", options.files[0].c_str(), TargetName(info.target), info.version,
+         package.size(), topics.ota);
+  client.Start();
+  loop.Run();
+
+  const PushStats& stats = client.stats();
+  double seconds = (double)(std::max(stats.finished_ms, EventLoop::NowMs()) - stats.started_ms) / 1000.0;
+  printf("%s%s%s  %.1f KB enviados en %.1f s, %d naks, %d reenvíos por silencio\n", ok ? "listo" : "falló",
+         ok ? "" : ": ", ok ? "" : detail.c_str(), (double)stats.bytes_sent / 1024.0, seconds, stats.naks,
+         stats.timeouts);
+  return ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------------------
+// Verificación de punta a punta
+
+struct Check {
+  int failures = 0;
+  void Expect(bool ok, const std::string& what) {
+    // Relleno por caracteres, no por bytes: las tildes y flechas ocupan más de uno en UTF-8
+    size_t chars = 0;
+    for (unsigned char ch : what) chars += (ch & 0xC0) != 0x80;
+    printf("  %s%*s %s\n", what.c_str(), (int)(chars < 62 ? 62 - chars : 0), "", ok ? "ok" : "FALLO");
+    if (!ok) failures++;
+  }
+};
+
+// Descarga por HTTP a través del servidor local, con la sesión tal como venga (nueva o restaurada)
+struct PullRun {
+  OtaResult result = OTA_CONTINUE;
+  PullStats pull;
+  FileServerStats server;
+};
+
+PullRun PullOnce(const std::vector<uint8_t>& package, FileServerOptions server_options, OtaSession& session) {
+  PullRun run;
+  EventLoop loop;
+  FileServer server(loop, server_options);
+  server.AddFile("awg.ota", package);
+  std::string error;
+  if (!server.Listen("127.0.0.1", 0, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return run;
+  }
+  PullClient client(loop, "http://127.0.0.1:" + std::to_string(server.port()) + "/awg.ota", session);
+  client.set_retry_min_ms(5);
+  client.on_finish = [&](OtaResult result, const std::string&) {
+    run.result = result;
+    loop.Stop();
+  };
+  loop.After(120000, [&loop]() { loop.Stop(); });
+  client.Start();
+  loop.Run();
+  run.pull = client.stats();
+  run.server = server.stats();
+  return run;
+}
+
+OtaResult FeedAll(const std::vector<uint8_t>& package, const uint8_t pk[ED25519_KEY_SIZE], uint8_t target,
+                  uint32_t max_image, MemoryFlash* flash) {
+  std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+  OtaSession session;
+  session.begin(flash, pk, target, max_image, buffer.data());
+  return session.feed(package.data(), package.size());
+}
+
+bool ImageMatches(const MemoryFlash& flash, const std::vector<uint8_t>& image) {
+  return flash.data.size() >= image.size() && memcmp(flash.data.data(), image.data(), image.size()) == 0;
+}
+
+// Vectores conocidos de las primitivas: FIPS 180-4 (ejemplos del NIST) para SHA-256 y SHA-512
+// y RFC 8032 §7.1 (pruebas 1-3) para Ed25519. El resto de la verificación solo comprueba que
+// el firmador y el verificador coinciden entre sí; esto los ata a las especificaciones
+void CheckKnownAnswers(Check& check) {
+  const struct {
+    const char* message;
+    const char* digest;
+  } sha256[] = {
+      {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+      {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+      {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+       "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+  };
+  for (const auto& v : sha256) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256 sha;
+    sha.begin();
+    sha.update((const uint8_t*)v.message, strlen(v.message));
+    sha.finish(digest);
+    check.Expect(Hex(digest, sizeof(digest)) == v.digest,
+                 "SHA-256 de " + std::to_string(strlen(v.message)) + " bytes");
+  }
+  {
+    // Un millón de 'a' en trozos de tamaños variables: cruza los bordes de bloque de update()
+    std::vector<uint8_t> a(1000000, 'a');
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256 sha;
+    sha.begin();
+    for (size_t offset = 0, step = 1; offset < a.size(); offset += step, step = step * 5 % 191 + 1) {
+      sha.update(a.data() + offset, std::min(step, a.size() - offset));
+    }
+    sha.finish(digest);
+    check.Expect(Hex(digest, sizeof(digest)) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+                 "SHA-256 de un millón de 'a' en trozos");
+  }
+  {
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    Sha512 sha;
+    sha.begin();
+    sha.update((const uint8_t*)"abc", 3);
+    sha.finish(digest);
+    check.Expect(Hex(digest, sizeof(digest)) ==
+                     "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                     "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+                 "SHA-512 de 3 bytes");
+  }
+
+  const struct {
+    const char* secret;
+    const char* public_key;
+    const char* message;
+    const char* signature;
+  } ed25519[] = {
+      {"9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+       "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a", "",
+       "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e06522490155"
+       "5fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b"},
+      {"4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+       "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c", "72",
+       "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da"
+       "085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"},
+      {"c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7",
+       "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025", "af82",
+       "6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac"
+       "18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a"},
+  };
+  // Orden del grupo L en little endian, para armar una firma con S + L (no canónica)
+  static const uint8_t kOrder[32] = {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7,
+                                     0xa2, 0xde, 0xf9, 0xde, 0x14, 0,    0,    0,    0,    0,    0,
+                                     0,    0,    0,    0,    0,    0,    0,    0,    0,    0x10};
+  int test = 1;
+  for (const auto& v : ed25519) {
+    uint8_t seed[ED25519_KEY_SIZE], pk[ED25519_KEY_SIZE], expected[ED25519_SIGNATURE_SIZE];
+    size_t len = strlen(v.message) / 2;
+    std::vector<uint8_t> message(len);
+    ParseHex(v.secret, seed, sizeof(seed));
+    ParseHex(v.signature, expected, sizeof(expected));
+    if (len > 0) ParseHex(v.message, message.data(), len);
+    std::string name = "Ed25519 RFC 8032 prueba " + std::to_string(test++);
+
+    Ed25519::publicKey(seed, pk);
+    check.Expect(Hex(pk, sizeof(pk)) == v.public_key, name + ": clave pública");
+    uint8_t signature[ED25519_SIGNATURE_SIZE];
+    Ed25519::sign(signature, message.data(), len, seed);
+    check.Expect(memcmp(signature, expected, sizeof(expected)) == 0, name + ": firma");
+    check.Expect(Ed25519::verify(expected, message.data(), len, pk), name + ": verifica");
+
+    uint8_t bad[ED25519_SIGNATURE_SIZE];
+    memcpy(bad, expected, sizeof(bad));
+    bad[0] ^= 0x01;  // R alterado
+    bool rejected = !Ed25519::verify(bad, message.data(), len, pk);
+    memcpy(bad, expected, sizeof(bad));
+    unsigned carry = 0;
+    for (int i = 0; i < 32; i++) {
+      unsigned sum = bad[32 + i] + kOrder[i] + carry;
+      bad[32 + i] = (uint8_t)sum;
+      carry = sum >> 8;
+    }
+    rejected = rejected && !Ed25519::verify(bad, message.data(), len, pk);  // S + L
+    std::vector<uint8_t> other = message;
+    other.push_back(0x00);
+    rejected = rejected && !Ed25519::verify(expected, other.data(), other.size(), pk);
+    check.Expect(rejected, name + ": rechaza R, S + L y otro mensaje");
+  }
+}
+
+int RunCheck(const Options& options) {
+  std::vector<uint8_t> image = LoadImage(options);
+  if (image.empty()) return 1;
+  Check check;
+  const uint32_t size = (uint32_t)image.size();
+
+  // Semilla fija: el paquete de la prueba es reproducible
+  uint8_t seed[ED25519_KEY_SIZE], pk[ED25519_KEY_SIZE];
+  for (int i = 0; i < ED25519_KEY_SIZE; i++) seed[i] = (uint8_t)(i * 7 + 1);
+  Ed25519::publicKey(seed, pk);
+
+  PackageOptions package_options;
+  package_options.version = "check-1";
+  PackageStats stats;
+  int64_t start = EventLoop::NowUs();
+  std::vector<uint8_t> package = BuildPackage(image, package_options, seed, &stats);
+  double pack_ms = (double)(EventLoop::NowUs() - start) / 1000.0;
+  package_options.compress = false;
+  std::vector<uint8_t> plain = BuildPackage(image, package_options, seed, nullptr);
+
+  printf("Imagen %u bytes → paquete %zu bytes (%.1f %%), %zu bloques (%zu sin comprimir), armado %.0f ms\n", size,
+         package.size(), 100.0 * (double)package.size() / size, stats.blocks, stats.raw_blocks, pack_ms);
+
+  printf("\nVectores conocidos\n");
+  CheckKnownAnswers(check);
+
+  printf("\nFormato\n");
+  {
+    MemoryFlash flash(size);
+    flash.final_size = size;
+    start = EventLoop::NowUs();
+    OtaResult result = FeedAll(package, pk, OTA_TARGET_AWG, size, &flash);
+    double decode_ms = (double)(EventLoop::NowUs() - start) / 1000.0;
+    check.Expect(result == OTA_DONE && ImageMatches(flash, image),
+                 "LZSS + firma + SHA-256 (" + std::to_string((int)decode_ms) + " ms)");
+    MemoryFlash raw(size);
+    check.Expect(FeedAll(plain, pk, OTA_TARGET_AWG, size, &raw) == OTA_DONE && ImageMatches(raw, image),
+                 "paquete sin comprimir");
+  }
+  {
+    // Trozos de 1-3000 bytes, duplicados y con un hueco, como por MQTT
+    MemoryFlash flash(size);
+    std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+    OtaSession session;
+    session.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    OtaResult result = OTA_CONTINUE;
+    bool gap_rejected = false;
+    uint32_t offset = 0, step = 1;
+    while (offset < package.size() && (result == OTA_CONTINUE || result == OTA_ERR_OFFSET)) {
+      uint32_t len = std::min<uint32_t>(step, (uint32_t)package.size() - offset);
+      if (offset > 100000 && !gap_rejected) {
+        gap_rejected = session.feedAt(offset + 5000, package.data() + offset + 5000, 100) == OTA_ERR_OFFSET;
+      }
+      session.feedAt(offset > 500 ? offset - 500 : 0, package.data() + (offset > 500 ? offset - 500 : 0), 500);
+      result = session.feedAt(offset, package.data() + offset, len);
+      offset += len;
+      step = step * 7 % 3001 + 1;
+    }
+    check.Expect(result == OTA_DONE && gap_rejected && ImageMatches(flash, image),
+                 "trozos con offset: duplicados ignorados, hueco rechazado");
+  }
+
+  printf("\nRechazos (sin escribir la flash)\n");
+  auto expect_reject = [&](std::vector<uint8_t> bad, uint8_t target, uint32_t max_image, const uint8_t* key,
+                           OtaResult expected, const std::string& what) {
+    MemoryFlash flash(size);
+    OtaResult result = FeedAll(bad, key, target, max_image, &flash);
+    check.Expect(result == expected && flash.writes == 0, what + " → " + otaResultName(result));
+  };
+  {
+    std::vector<uint8_t> bad = package;
+    bad[OTA_SIGNED_SIZE + 5] ^= 0x01;
+    expect_reject(bad, OTA_TARGET_AWG, size, pk, OTA_ERR_SIGNATURE, "firma alterada");
+    bad = package;
+    bad[20] ^= 0x01;  // Versión
+    expect_reject(bad, OTA_TARGET_AWG, size, pk, OTA_ERR_SIGNATURE, "encabezado alterado");
+    bad = package;
+    bad[52] ^= 0x80;  // SHA-256 declarado
+    expect_reject(bad, OTA_TARGET_AWG, size, pk, OTA_ERR_SIGNATURE, "hash declarado alterado");
+    uint8_t other_seed[ED25519_KEY_SIZE], other_pk[ED25519_KEY_SIZE];
+    memcpy(other_seed, seed, sizeof(seed));
+    other_seed[0] ^= 0xFF;
+    Ed25519::publicKey(other_seed, other_pk);
+    expect_reject(package, OTA_TARGET_AWG, size, other_pk, OTA_ERR_SIGNATURE, "otra clave");
+    uint8_t zero[ED25519_KEY_SIZE] = {0};
+    expect_reject(package, OTA_TARGET_AWG, size, zero, OTA_ERR_NO_KEY, "sin clave configurada");
+    expect_reject(package, OTA_TARGET_DISPLAY, size, pk, OTA_ERR_TARGET, "paquete de otro destino");
+    expect_reject(package, OTA_TARGET_AWG, size - 1, pk, OTA_ERR_TOO_LARGE, "imagen mayor que la partición");
+  }
+  {
+    // Payload alterado a mitad: el bloque no decodifica o el hash final no coincide
+    std::vector<uint8_t> bad = package;
+    bad[package.size() / 2] ^= 0x55;
+    MemoryFlash flash(size);
+    OtaResult result = FeedAll(bad, pk, OTA_TARGET_AWG, size, &flash);
+    check.Expect(result == OTA_ERR_CORRUPT || result == OTA_ERR_HASH,
+                 std::string("payload alterado → ") + otaResultName(result));
+    bad = plain;
+    bad[plain.size() - 10] ^= 0x01;  // Sin comprimir: solo el SHA-256 lo detecta
+    MemoryFlash raw(size);
+    result = FeedAll(bad, pk, OTA_TARGET_AWG, size, &raw);
+    check.Expect(result == OTA_ERR_HASH, std::string("byte alterado sin comprimir → ") + otaResultName(result));
+  }
+
+  printf("\nDescarga HTTP local\n");
+  {
+    MemoryFlash flash(size);
+    std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+    OtaSession session;
+    session.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    PullRun run = PullOnce(package, FileServerOptions(), session);
+    check.Expect(run.result == OTA_DONE && run.pull.attempts == 1 && ImageMatches(flash, image),
+                 "de una vez (" + std::to_string(run.pull.finished_ms - run.pull.started_ms) + " ms)");
+  }
+  {
+    // Cortes cada 40 KB: cada intento retoma desde el último bloque escrito
+    MemoryFlash flash(size);
+    std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+    OtaSession session;
+    session.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    FileServerOptions cuts;
+    cuts.cut_every_bytes = 40000;
+    PullRun run = PullOnce(package, cuts, session);
+    double overhead = 100.0 * ((double)run.server.bytes_sent / (double)package.size() - 1.0);
+    char text[120];
+    snprintf(text, sizeof(text), "cortes cada 40 KB: %d intentos, %.1f %% de bytes repetidos", run.pull.attempts,
+             overhead);
+    check.Expect(run.result == OTA_DONE && run.pull.resumes > 0 && run.server.range_requests > 0 &&
+                     ImageMatches(flash, image),
+                 text);
+  }
+  {
+    // Reinicio a mitad: una sesión nueva sigue desde el punto de control "en NVS"
+    MemoryFlash flash(size);
+    flash.final_size = size;
+    std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+    {
+      OtaSession first;
+      first.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+      first.feed(package.data(), package.size() * 3 / 5);
+    }
+    OtaSession second;
+    second.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    bool restored = second.restore(flash.saved);
+    uint32_t resumed_at = second.resumeOffset();
+    PullRun run = PullOnce(package, FileServerOptions(), second);
+    char text[120];
+    snprintf(text, sizeof(text), "reinicio: retoma en %u de %zu (%.0f %% ya escrito)", resumed_at, package.size(),
+             100.0 * resumed_at / package.size());
+    check.Expect(restored && resumed_at > OTA_HEADER_SIZE && run.result == OTA_DONE &&
+                     run.server.bytes_sent == package.size() - resumed_at && ImageMatches(flash, image),
+                 text);
+    OtaCheckpoint tampered = flash.saved;
+    tampered.header[OTA_SIGNED_SIZE] ^= 0x01;
+    OtaSession third;
+    third.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    check.Expect(!third.restore(tampered), "punto de control con firma inválida descartado");
+  }
+  {
+    // Un sink que no borra antes de escribir corrompe los bloques repetidos tras un corte
+    MemoryFlash flash(size);
+    std::fill(flash.data.begin(), flash.data.end(), 0x00);
+    flash.erase = false;
+    std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+    OtaSession session;
+    session.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+    OtaResult result = session.feed(package.data(), package.size());
+    check.Expect(result == OTA_ERR_WRITE, "escritura sin borrar detectada");
+  }
+
+  if (options.server.rate_bytes_per_s > 0) {
+    // Tiempo de descarga al ancho de banda dado: comprimido frente a sin comprimir
+    printf("\nTiempo de descarga a %.0f KB/s\n", (double)options.server.rate_bytes_per_s / 1024.0);
+    for (const std::vector<uint8_t>* pkg : {&package, &plain}) {
+      MemoryFlash flash(size);
+      std::vector<uint8_t> buffer(OTA_MAX_BLOCK_SIZE);
+      OtaSession session;
+      session.begin(&flash, pk, OTA_TARGET_AWG, size, buffer.data());
+      FileServerOptions limited;
+      limited.rate_bytes_per_s = options.server.rate_bytes_per_s;
+      PullRun run = PullOnce(*pkg, limited, session);
+      printf("  %-14s %8zu bytes  %6.1f s\n", pkg == &package ? "comprimido" : "sin comprimir", pkg->size(),
+             (double)(run.pull.finished_ms - run.pull.started_ms) / 1000.0);
+      if (run.result != OTA_DONE) check.failures++;
+    }
+  }
+
+  printf("\n%s\n", check.failures ? "FALLÓ" : "OK");
+  return check.failures ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    Usage();
+    return 2;
+  }
+  std::string command = argv[1];
+  Options options;
+  if (!ParseOptions(argc - 1, argv + 1, &options)) {
+    Usage();
+    return 2;
+  }
+  if (command == "keygen") return RunKeygen(options);
+  if (command == "pack") return RunPack(options);
+  if (command == "inspect") return RunInspect(options);
+  if (command == "serve") return RunServe(options);
+  if (command == "pull") return RunPull(options);
+  if (command == "push") return RunPush(options);
+  if (command == "check") return RunCheck(options);
+  Usage();
+  return 2;
+}
@@ -0,0 +1,161 @@
+#include "package_builder.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace dropster {
+
+namespace {
+
+const int kHashBits = 13;
+const int kMaxChain = 64;  // Candidatos por posición: compresión casi igual que 256, bastante más rápido
+
+uint32_t Hash3(const uint8_t* p) { return ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u >> (32 - kHashBits); }
+
+}  // namespace
+
+std::vector<uint8_t> LzssCompress(const uint8_t* data, size_t len) {
+  std::vector<uint8_t> out;
+  out.reserve(len + len / 8 + 1);
+  std::vector<int32_t> head(1 << kHashBits, -1);
+  std::vector<int32_t> prev(len, -1);
+  auto insert = [&](size_t pos) {
+    if (pos + OTA_LZSS_MIN_MATCH > len) return;
+    uint32_t h = Hash3(data + pos);
+    prev[pos] = head[h];
+    head[h] = (int32_t)pos;
+  };
+
+  size_t flag_pos = 0;
+  int items = 8;
+  size_t pos = 0;
+  while (pos < len) {
+    if (items == 8) {
+      flag_pos = out.size();
+      out.push_back(0);
+      items = 0;
+    }
+    size_t best_len = 0, best_off = 0;
+    if (pos + OTA_LZSS_MIN_MATCH <= len) {
+      size_t limit = std::min<size_t>(OTA_LZSS_MAX_MATCH, len - pos);
+      int chain = kMaxChain;
+      for (int32_t cand = head[Hash3(data + pos)]; cand >= 0 && chain-- > 0; cand = prev[cand]) {
+        size_t off = pos - (size_t)cand;
+        if (off > OTA_LZSS_WINDOW) break;
+        size_t n = 0;
+        while (n < limit && data[cand + n] == data[pos + n]) n++;
+        if (n > best_len) {
+          best_len = n;
+          best_off = off;
+          if (n == limit) break;
+        }
+      }
+    }
+    if (best_len >= OTA_LZSS_MIN_MATCH) {
+      uint32_t o = (uint32_t)best_off - 1;
+      out.push_back((uint8_t)(o & 0xFF));
+      out.push_back((uint8_t)(((o >> 4) & 0xF0) | (best_len - OTA_LZSS_MIN_MATCH)));
+      for (size_t i = 0; i < best_len; i++) insert(pos + i);
+      pos += best_len;
+    } else {
+      out[flag_pos] |= (uint8_t)(1 << items);
+      out.push_back(data[pos]);
+      insert(pos);
+      pos++;
+    }
+    items++;
+  }
+  return out;
+}
+
+std::vector<uint8_t> BuildPackage(const std::vector<uint8_t>& image, const PackageOptions& options,
+                                  const uint8_t seed[ED25519_KEY_SIZE], PackageStats* stats) {
+  std::vector<uint8_t> payload;
+  PackageStats local;
+  for (size_t start = 0; start < image.size(); start += options.block_size) {
+    size_t len = std::min<size_t>(options.block_size, image.size() - start);
+    std::vector<uint8_t> packed;
+    if (options.compress) packed = LzssCompress(image.data() + start, len);
+    bool raw = !options.compress || packed.size() >= len;
+    uint32_t word = (uint32_t)(raw ? len : packed.size()) | (raw && options.compress ? OTA_BLOCK_RAW_FLAG : 0);
+    uint8_t prefix[4];
+    otaWriteU32(prefix, word);
+    payload.insert(payload.end(), prefix, prefix + 4);
+    if (raw) {
+      payload.insert(payload.end(), image.begin() + start, image.begin() + start + len);
+      local.raw_blocks++;
+    } else {
+      payload.insert(payload.end(), packed.begin(), packed.end());
+    }
+    local.blocks++;
+  }
+
+  std::vector<uint8_t> package(OTA_HEADER_SIZE, 0);
+  uint8_t* h = package.data();
+  memcpy(h, OTA_PACKAGE_MAGIC, 4);
+  h[4] = OTA_PACKAGE_FORMAT;
+  h[5] = options.target;
+  h[6] = options.compress ? OTA_COMPRESSION_LZSS : OTA_COMPRESSION_NONE;
+  otaWriteU32(h + 8, (uint32_t)image.size());
+  otaWriteU32(h + 12, (uint32_t)payload.size());
+  otaWriteU32(h + 16, options.block_size);
+  memcpy(h + 20, options.version.data(), std::min<size_t>(options.version.size(), OTA_VERSION_MAX - 1));
+  Sha256 sha;
+  sha.begin();
+  sha.update(image.data(), image.size());
+  sha.finish(h + 52);
+  Ed25519::sign(h + OTA_SIGNED_SIZE, h, OTA_SIGNED_SIZE, seed);
+  package.insert(package.end(), payload.begin(), payload.end());
+  if (stats) *stats = local;
+  return package;
+}
+
+std::string Hex(const uint8_t* data, size_t len) {
+  std::string out;
+  char byte[3];
+  for (size_t i = 0; i < len; i++) {
+    snprintf(byte, sizeof(byte), "%02x", data[i]);
+    out += byte;
+  }
+  return out;
+}
+
+bool ParseHex(const std::string& text, uint8_t* out, size_t len) {
+  // Acepta "a1b2...", "a1 b2 ..." y el arreglo de config.h ("0xa1, 0xb2, ...")
+  std::string digits;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '0' && i + 1 < text.size() && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+      i++;
+    } else if (isxdigit((unsigned char)text[i])) {
+      digits += text[i];
+    }
+  }
+  if (digits.size() != len * 2) return false;
+  for (size_t i = 0; i < len; i++) out[i] = (uint8_t)strtoul(digits.substr(2 * i, 2).c_str(), nullptr, 16);
+  return true;
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  data->clear();
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data->insert(data->end(), buf, buf + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+}  // namespace dropster
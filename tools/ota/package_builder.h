@@ -0,0 +1,42 @@
+#ifndef DROPSTER_OTA_PACKAGE_BUILDER_H_
+#define DROPSTER_OTA_PACKAGE_BUILDER_H_
+
+// Armado de paquetes OTA (ota_package.h del firmware): compresión LZSS por bloques,
+// encabezado y firma Ed25519.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "ota_package.h"
+
+namespace dropster {
+
+struct PackageOptions {
+  uint8_t target = OTA_TARGET_AWG;
+  std::string version;
+  uint32_t block_size = OTA_MAX_BLOCK_SIZE;
+  bool compress = true;
+};
+
+struct PackageStats {
+  size_t blocks = 0;
+  size_t raw_blocks = 0;  // Bloques que no comprimían y van tal cual
+};
+
+// LZSS de un bloque en el formato que decodifica OtaSession
+std::vector<uint8_t> LzssCompress(const uint8_t* data, size_t len);
+
+std::vector<uint8_t> BuildPackage(const std::vector<uint8_t>& image, const PackageOptions& options,
+                                  const uint8_t seed[ED25519_KEY_SIZE], PackageStats* stats);
+
+std::string Hex(const uint8_t* data, size_t len);
+bool ParseHex(const std::string& text, uint8_t* out, size_t len);
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data);
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data);
+
+}  // namespace dropster
+
+#endif  // DROPSTER_OTA_PACKAGE_BUILDER_H_
@@ -0,0 +1,212 @@
+#include "pull_client.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace dropster {
+
+#define PULL_MAX_HEAD 8192
+
+bool ParseHttpUrl(const std::string& url, std::string* host, int* port, std::string* path) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) return false;
+  size_t host_start = scheme.size();
+  size_t slash = url.find('/', host_start);
+  std::string authority = url.substr(host_start, slash == std::string::npos ? std::string::npos : slash - host_start);
+  *path = slash == std::string::npos ? "/" : url.substr(slash);
+  size_t colon = authority.rfind(':');
+  *port = 80;
+  if (colon != std::string::npos) {
+    *port = atoi(authority.c_str() + colon + 1);
+    authority.resize(colon);
+  }
+  *host = authority;
+  return !host->empty() && *port > 0 && *port < 65536;
+}
+
+PullClient::PullClient(EventLoop& loop, const std::string& url, OtaSession& session) : loop_(loop), session_(session) {
+  url_ok_ = ParseHttpUrl(url, &host_, &port_, &path_);
+}
+
+PullClient::~PullClient() {
+  if (retry_timer_) loop_.Cancel(retry_timer_);
+  if (watchdog_timer_) loop_.Cancel(watchdog_timer_);
+  CloseSocket();
+}
+
+void PullClient::Start() {
+  if (!url_ok_) {
+    Finish(OTA_ERR_HEADER, "URL inválida (solo http://host[:puerto]/ruta)");
+    return;
+  }
+  stats_.started_ms = EventLoop::NowMs();
+  backoff_ms_ = retry_min_ms_;
+  watchdog_timer_ = loop_.Every(1000, [this]() {
+    if (fd_ >= 0 && EventLoop::NowMs() - last_data_ms_ > OTA_PULL_TIMEOUT_MS) Fail("sin datos");
+  });
+  Attempt();
+}
+
+void PullClient::Attempt() {
+  retry_timer_ = 0;
+  stats_.attempts++;
+  attempt_start_ = session_.resumeOffset();
+  if (attempt_start_ > 0) stats_.resumes++;
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* res = nullptr;
+  if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &res) != 0 || !res) {
+    Fail("no se resuelve " + host_);
+    return;
+  }
+  fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int rc = fd_ >= 0 ? connect(fd_, res->ai_addr, res->ai_addrlen) : -1;
+  freeaddrinfo(res);
+  if (fd_ < 0 || (rc != 0 && errno != EINPROGRESS)) {
+    Fail(std::string("connect: ") + strerror(errno));
+    return;
+  }
+  out_ = "GET " + path_ + " HTTP/1.1\r\nHost: " + host_ + "\r\nUser-Agent: dropster-ota\r\n";
+  if (attempt_start_ > 0) out_ += "Range: bytes=" + std::to_string(attempt_start_) + "-\r\n";
+  out_ += "Connection: close\r\n\r\n";
+  out_pos_ = 0;
+  head_.clear();
+  in_body_ = false;
+  skip_ = 0;
+  last_data_ms_ = EventLoop::NowMs();
+  loop_.Add(fd_, EPOLLOUT | EPOLLIN, [this](uint32_t events) { OnEvents(events); });
+}
+
+void PullClient::OnEvents(uint32_t events) {
+  if (events & EPOLLOUT) {
+    while (out_pos_ < out_.size()) {
+      ssize_t n = send(fd_, out_.data() + out_pos_, out_.size() - out_pos_, MSG_NOSIGNAL);
+      if (n > 0) {
+        out_pos_ += (size_t)n;
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+      Fail(std::string("send: ") + strerror(errno));
+      return;
+    }
+    loop_.Modify(fd_, EPOLLIN);
+  }
+  if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+  uint8_t buf[16384];
+  for (;;) {
+    ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+    if (n > 0) {
+      last_data_ms_ = EventLoop::NowMs();
+      stats_.bytes_received += (uint64_t)n;
+      if (in_body_) {
+        HandleBody(buf, (size_t)n);
+      } else {
+        head_.append((const char*)buf, (size_t)n);
+        size_t end = head_.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          if (head_.size() > PULL_MAX_HEAD) Fail("encabezado HTTP demasiado largo");
+          if (fd_ < 0) return;
+          continue;
+        }
+        std::string rest = head_.substr(end + 4);
+        head_.resize(end);
+        if (!HandleHead()) return;
+        in_body_ = true;
+        HandleBody((const uint8_t*)rest.data(), rest.size());
+      }
+      if (fd_ < 0 || finished_) return;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    Fail(n == 0 ? "conexión cerrada" : std::string("recv: ") + strerror(errno));
+    return;
+  }
+}
+
+bool PullClient::HandleHead() {
+  int status = 0;
+  if (sscanf(head_.c_str(), "HTTP/%*d.%*d %d", &status) != 1) {
+    Fail("respuesta HTTP inválida");
+    return false;
+  }
+  if (status == 206) {
+    // Content-Range debe empezar donde se pidió
+    size_t pos = 0;
+    bool ok = false;
+    while ((pos = head_.find("\r\n", pos)) != std::string::npos) {
+      pos += 2;
+      if (strncasecmp(head_.c_str() + pos, "Content-Range: bytes ", 21) == 0) {
+        ok = strtoull(head_.c_str() + pos + 21, nullptr, 10) == attempt_start_;
+      }
+    }
+    if (!ok) {
+      Finish(OTA_ERR_OFFSET, "Content-Range no coincide con el Range pedido");
+      return false;
+    }
+  } else if (status == 200) {
+    skip_ = attempt_start_;  // El servidor ignoró el Range
+  } else {
+    Fail("HTTP " + std::to_string(status));
+    return false;
+  }
+  return true;
+}
+
+void PullClient::HandleBody(const uint8_t* data, size_t len) {
+  if (skip_ > 0) {
+    size_t n = (size_t)std::min<uint64_t>(skip_, len);
+    skip_ -= n;
+    data += n;
+    len -= n;
+  }
+  if (len == 0) return;
+  OtaResult result = session_.feed(data, len);
+  if (result != OTA_CONTINUE) Finish(result, otaResultName(result));
+}
+
+void PullClient::Fail(const std::string& reason) {
+  CloseSocket();
+  if (finished_) return;
+  // Un intento que escribió al menos un bloque reinicia el backoff y la cuenta de intentos
+  session_.rewind();
+  if (session_.resumeOffset() > attempt_start_) {
+    stalled_ = 0;
+    backoff_ms_ = retry_min_ms_;
+  } else if (++stalled_ >= OTA_PULL_MAX_STALLED) {
+    Finish(OTA_CONTINUE, "sin avance tras " + std::to_string(stalled_) + " intentos (" + reason + ")");
+    return;
+  }
+  retry_timer_ = loop_.After(backoff_ms_, [this]() { Attempt(); });
+  backoff_ms_ = std::min<int64_t>(backoff_ms_ * 2, OTA_PULL_RETRY_MAX_MS);
+}
+
+void PullClient::Finish(OtaResult result, const std::string& detail) {
+  CloseSocket();
+  if (finished_) return;
+  finished_ = true;
+  stats_.finished_ms = EventLoop::NowMs();
+  if (watchdog_timer_) loop_.Cancel(watchdog_timer_);
+  watchdog_timer_ = 0;
+  if (on_finish) on_finish(result, detail);
+}
+
+void PullClient::CloseSocket() {
+  if (fd_ < 0) return;
+  loop_.Remove(fd_);
+  close(fd_);
+  fd_ = -1;
+}
+
+}  // namespace dropster
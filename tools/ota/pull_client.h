@@ -0,0 +1,83 @@
+#ifndef DROPSTER_OTA_PULL_CLIENT_H_
+#define DROPSTER_OTA_PULL_CLIENT_H_
+
+// Descarga de un paquete OTA por HTTP con reanudación, igual que otaPullTask() del AWG:
+// cada intento pide "Range: bytes=<resumeOffset>-", entrega el cuerpo a OtaSession y, si
+// la conexión se corta o se queda muda, vuelve al último bloque escrito (rewind) y
+// reintenta con backoff. Un intento que avanzó reinicia el backoff; sin avance durante
+// OTA_PULL_MAX_STALLED intentos se abandona. Solo http:// (el paquete va firmado).
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "event_loop.h"
+#include "ota_package.h"
+
+namespace dropster {
+
+// Mismos valores que config.h del AWG
+#define OTA_PULL_RETRY_MIN_MS 2000
+#define OTA_PULL_RETRY_MAX_MS 30000
+#define OTA_PULL_MAX_STALLED 8
+#define OTA_PULL_TIMEOUT_MS 15000
+
+struct PullStats {
+  int attempts = 0;
+  int resumes = 0;           // Intentos que retomaron desde un punto de control
+  uint64_t bytes_received = 0;
+  int64_t started_ms = 0;
+  int64_t finished_ms = 0;
+};
+
+bool ParseHttpUrl(const std::string& url, std::string* host, int* port, std::string* path);
+
+class PullClient {
+ public:
+  PullClient(EventLoop& loop, const std::string& url, OtaSession& session);
+  ~PullClient();
+  PullClient(const PullClient&) = delete;
+  PullClient& operator=(const PullClient&) = delete;
+
+  void Start();
+  void set_retry_min_ms(int64_t ms) { retry_min_ms_ = ms; }
+
+  const PullStats& stats() const { return stats_; }
+  // Resultado final: OTA_DONE, un error de la sesión u OTA_CONTINUE si se agotaron los intentos
+  std::function<void(OtaResult result, const std::string& detail)> on_finish;
+
+ private:
+  EventLoop& loop_;
+  OtaSession& session_;
+  std::string host_, path_;
+  int port_ = 80;
+  bool url_ok_ = false;
+  int fd_ = -1;
+  std::string out_;
+  size_t out_pos_ = 0;
+  std::string head_;
+  bool in_body_ = false;
+  uint64_t skip_ = 0;  // Respuesta 200 a un Range: descarta lo ya recibido
+  uint32_t attempt_start_ = 0;
+  int stalled_ = 0;
+  int64_t retry_min_ms_ = OTA_PULL_RETRY_MIN_MS;
+  int64_t backoff_ms_ = OTA_PULL_RETRY_MIN_MS;
+  int64_t last_data_ms_ = 0;
+  PullStats stats_;
+  EventLoop::TimerId retry_timer_ = 0;
+  EventLoop::TimerId watchdog_timer_ = 0;
+  bool finished_ = false;
+
+  void Attempt();
+  void OnEvents(uint32_t events);
+  bool HandleHead();
+  void HandleBody(const uint8_t* data, size_t len);
+  void Fail(const std::string& reason);
+  void Finish(OtaResult result, const std::string& detail);
+  void CloseSocket();
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_OTA_PULL_CLIENT_H_
@@ -0,0 +1,138 @@
+#include "push_client.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "flat_json.h"
+#include "ota_package.h"
+
+namespace dropster {
+
+#define PUSH_TICK_MS 500
+#define PUSH_READY_RETRY_MS 5000
+#define PUSH_MAX_PENDING_OUTPUT 65536
+
+PushClient::PushClient(EventLoop& loop, MqttOptions mqtt, PushTopics topics, std::vector<uint8_t> package)
+    : loop_(loop), topics_(std::move(topics)), package_(std::move(package)) {
+  client_.reset(new MqttClient(loop_, std::move(mqtt)));
+  // Destino y primeros 4 bytes del SHA-256 de la imagen: el equipo solo retoma un punto de
+  // control del mismo paquete
+  char sha[9] = "";
+  if (package_.size() >= OTA_HEADER_SIZE) {
+    snprintf(sha, sizeof(sha), "%02x%02x%02x%02x", package_[52], package_[53], package_[54], package_[55]);
+  }
+  bool display = package_.size() > 5 && package_[5] == OTA_TARGET_DISPLAY;
+  command_ = std::string("OTA_PUSH ") + (display ? "display " : "awg ") + sha;
+}
+
+PushClient::~PushClient() {
+  if (timer_) loop_.Cancel(timer_);
+}
+
+void PushClient::Start() {
+  stats_.started_ms = EventLoop::NowMs();
+  client_->on_connect = [this]() {
+    client_->Subscribe(topics_.status, 1);
+    ready_ = false;
+    last_ack_ms_ = EventLoop::NowMs();
+    client_->Publish(topics_.control, command_, 1, false);
+  };
+  client_->on_message = [this](const std::string& topic, const char* payload, size_t length) {
+    if (topic == topics_.status) OnStatus(payload, length);
+  };
+  client_->on_disconnect = [this](const std::string&) { ready_ = false; };
+
+  timer_ = loop_.Every(PUSH_TICK_MS, [this]() {
+    if (finished_ || !client_->connected()) return;
+    int64_t idle = EventLoop::NowMs() - last_ack_ms_;
+    if (!ready_) {
+      // El equipo puede no haber visto OTA_PUSH (recién conectado, o reiniciando)
+      if (idle > PUSH_READY_RETRY_MS) {
+        last_ack_ms_ = EventLoop::NowMs();
+        client_->Publish(topics_.control, command_, 1, false);
+      }
+      return;
+    }
+    if (next_ > acked_ && idle > OTA_PUSH_ACK_TIMEOUT_MS) {
+      // Trozos perdidos sin que el equipo viera el hueco (QoS 0): reenviar desde la confirmación
+      stats_.timeouts++;
+      next_ = acked_;
+      last_ack_ms_ = EventLoop::NowMs();
+    }
+    Pump();  // También retoma si el buffer de salida estaba lleno
+  });
+  client_->Connect();
+}
+
+void PushClient::OnStatus(const char* payload, size_t length) {
+  std::string type, state, reason;
+  double offset = -1;
+  ForEachJsonMember(payload, length, [&](const char* key, size_t key_len, const JsonValue& value) {
+    std::string name(key, key_len);
+    if (name == "type") {
+      type = value.Text();
+    } else if (name == "state") {
+      state = value.Text();
+    } else if (name == "offset") {
+      offset = value.AsNumber();
+    } else if (name == "reason") {
+      reason = value.Text();
+    }
+  });
+  if (type != "ota" || finished_) return;
+  uint32_t at = offset >= 0 ? (uint32_t)offset : acked_;
+  if (on_progress) on_progress(state, at, std::string(payload, length));
+
+  if (state == "ready") {
+    ready_ = true;
+    acked_ = next_ = std::min<uint32_t>(at, (uint32_t)package_.size());
+    last_ack_ms_ = EventLoop::NowMs();
+    Pump();
+  } else if (state == "receiving") {
+    if (at > acked_) acked_ = at;
+    if (next_ < acked_) next_ = acked_;
+    last_ack_ms_ = EventLoop::NowMs();
+    Pump();
+  } else if (state == "nak") {
+    stats_.naks++;
+    acked_ = next_ = at;
+    last_ack_ms_ = EventLoop::NowMs();
+    Pump();
+  } else if (state == "done") {
+    Finish(true, "");
+  } else if (state == "error") {
+    Finish(false, reason.empty() ? "error" : reason);
+  }
+  // "staged" y "display" solo informan el avance del relevo a la pantalla
+}
+
+void PushClient::Pump() {
+  std::string message;
+  while (ready_ && client_->connected() && next_ < package_.size() && next_ - acked_ < OTA_PUSH_WINDOW &&
+         client_->pending_output() < PUSH_MAX_PENDING_OUTPUT) {
+    size_t len = std::min<size_t>(OTA_PUSH_CHUNK, package_.size() - next_);
+    message.resize(4 + len);
+    message[0] = (char)(next_ & 0xFF);
+    message[1] = (char)((next_ >> 8) & 0xFF);
+    message[2] = (char)((next_ >> 16) & 0xFF);
+    message[3] = (char)((next_ >> 24) & 0xFF);
+    memcpy(&message[4], package_.data() + next_, len);
+    if (!client_->Publish(topics_.ota, message.data(), message.size(), 0, false)) return;
+    next_ += (uint32_t)len;
+    stats_.bytes_sent += len;
+  }
+}
+
+void PushClient::Finish(bool ok, const std::string& detail) {
+  if (finished_) return;
+  finished_ = true;
+  stats_.finished_ms = EventLoop::NowMs();
+  if (timer_) loop_.Cancel(timer_);
+  timer_ = 0;
+  client_->Disconnect();
+  if (on_finish) on_finish(ok, detail);
+}
+
+}  // namespace dropster
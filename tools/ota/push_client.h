@@ -0,0 +1,81 @@
+#ifndef DROPSTER_OTA_PUSH_CLIENT_H_
+#define DROPSTER_OTA_PUSH_CLIENT_H_
+
+// Envío de un paquete OTA por MQTT a un AWG (protocolo de otaHandleChunk() del firmware).
+//
+//   1. "OTA_PUSH <awg|display> <sha>" en <raíz>/<id>/control (sha: 4 primeros bytes del
+//      SHA-256 de la imagen, en hex); el equipo responde en status con
+//      {"type":"ota","state":"ready","offset":N} (N > 0 si hay una descarga a medias)
+//   2. trozos en <raíz>/<id>/ota: offset u32 little-endian + datos, con a lo sumo
+//      `window` bytes sin confirmar
+//   3. el equipo confirma cada bloque escrito ("receiving", offset) y pide repetir desde el
+//      último bloque si ve un hueco ("nak", offset); sin confirmación en 5 s se reenvía
+//      desde la última
+//   4. "done" o "error" terminan; para la pantalla, "staged" y luego "display" con el
+//      avance por UART
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "mqtt_client.h"
+
+namespace dropster {
+
+#define OTA_PUSH_CHUNK 2048       // OTA_MQTT_CHUNK del firmware
+#define OTA_PUSH_WINDOW 32768     // Dos bloques de 16 KB en vuelo
+#define OTA_PUSH_ACK_TIMEOUT_MS 5000
+
+struct PushTopics {
+  std::string control;
+  std::string status;
+  std::string ota;
+};
+
+struct PushStats {
+  uint64_t bytes_sent = 0;
+  int naks = 0;
+  int timeouts = 0;
+  int64_t started_ms = 0;
+  int64_t finished_ms = 0;
+};
+
+class PushClient {
+ public:
+  PushClient(EventLoop& loop, MqttOptions mqtt, PushTopics topics, std::vector<uint8_t> package);
+  ~PushClient();
+  PushClient(const PushClient&) = delete;
+  PushClient& operator=(const PushClient&) = delete;
+
+  void Start();
+  const PushStats& stats() const { return stats_; }
+
+  std::function<void(const std::string& state, uint32_t offset, const std::string& payload)> on_progress;
+  std::function<void(bool ok, const std::string& detail)> on_finish;
+
+ private:
+  EventLoop& loop_;
+  PushTopics topics_;
+  std::vector<uint8_t> package_;
+  std::unique_ptr<MqttClient> client_;
+  std::string command_;  // OTA_PUSH con destino y hash
+  PushStats stats_;
+  bool ready_ = false;
+  bool finished_ = false;
+  uint32_t acked_ = 0;  // Último offset confirmado por el equipo
+  uint32_t next_ = 0;   // Próximo byte a enviar
+  int64_t last_ack_ms_ = 0;
+  EventLoop::TimerId timer_ = 0;
+
+  void OnStatus(const char* payload, size_t length);
+  void Pump();
+  void Finish(bool ok, const std::string& detail);
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_OTA_PUSH_CLIENT_H_
@@ -0,0 +1,712 @@
+#include "device_model.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+
+#include "firmware_format.h"
+
+namespace dropster {
+
+const char* const kSimTopicLeaves[kTopicCount] = {"data", "status", "alerts", "system", "control", "ack"};
+
+namespace {
+
+// Constantes de config.h que gobiernan lo que se publica
+const int64_t kControlSamplingMs = 7000;       // CONTROL_SAMPLING_DEFAULT
+const int64_t kControlMinOffMs = 120000;       // CONTROL_MIN_OFF_DEFAULT
+const int64_t kControlMaxOnMs = 7200000;       // CONTROL_MAX_ON_DEFAULT
+const float kControlDeadband = 3.0f;           // CONTROL_DEADBAND_DEFAULT
+const float kSmoothingAlpha = 0.7f;            // CONTROL_SMOOTHING_ALPHA
+const float kFanOnOffset = 1.0f;               // EVAP_FAN_TEMP_ON_OFFSET_DEFAULT
+const float kFanOffOffset = 0.5f;              // EVAP_FAN_TEMP_OFF_OFFSET_DEFAULT
+const int64_t kTimeModeOnMs = 900000;          // TIME_MODE_COMPRESSOR_ON_TIME_DEFAULT
+const int64_t kTimeModeOffMs = 450000;         // TIME_MODE_COMPRESSOR_OFF_TIME_DEFAULT
+const float kMaxCompressorTemp = 95.0f;        // MAX_COMPRESSOR_TEMP
+const float kAlertTankFull = 90.0f;            // ALERT_TANK_FULL_DEFAULT
+const float kAlertVoltageLow = 100.0f;         // ALERT_VOLTAGE_LOW_DEFAULT
+const float kAlertHumidityLow = 40.0f;         // ALERT_HUMIDITY_LOW_DEFAULT
+const float kPumpMinLevel = 2.0f;              // PUMP_MIN_LEVEL_DEFAULT
+const int64_t kCommandDebounceMs = 1000;       // COMMAND_DEBOUNCE
+const int64_t kCommandTimeoutMs = 5000;        // COMMAND_TIMEOUT
+const size_t kStatusBufferSize = 200;          // statusBuffer de publishState() y buffer de sendAlert()
+const size_t kConsolidatedBufferSize = 512;    // publishConsolidatedStatus()
+const size_t kDataBufferSize = 1024;           // mqttBuffer (MQTT_BUFFER_SIZE)
+
+// Física del equipo
+const double kAirflowFan = 120.0;         // m³/h por el evaporador con ventilador
+const double kAirflowNatural = 15.0;      // Convección sin ventilador
+const double kCondensingEfficiency = 0.35;
+const double kPumpLitersPerMinute = 1.5;
+
+double SaturationPressure(double temp_c) { return 6.112 * std::exp(17.62 * temp_c / (243.12 + temp_c)); }
+
+// g/m³ a partir de la presión de vapor (hPa)
+double AbsoluteHumidity(double vapor_hpa, double temp_c) { return 216.7 * vapor_hpa / (273.15 + temp_c); }
+
+double DewPoint(double temp_c, double rh) {
+  double gamma = std::log(std::max(rh, 0.1) / 100.0) + 17.62 * temp_c / (243.12 + temp_c);
+  return 243.12 * gamma / (17.62 - gamma);
+}
+
+double Approach(double value, double target, double dt_s, double tau_s) {
+  return value + (target - value) * (1.0 - std::exp(-dt_s / tau_s));
+}
+
+const char* ModeName(SimMode mode) {
+  switch (mode) {
+    case kModeManual: return "MANUAL";
+    case kModeAutoPid: return "AUTO_PID";
+    case kModeAutoTime: return "AUTO_TIME";
+    case kModeAutoAdaptive: return "AUTO_ADAPTIVE";
+  }
+  return "UNKNOWN";
+}
+
+float RoundCents(double value) { return roundf((float)value * 100.0f) / 100.0f; }
+
+}  // namespace
+
+DeviceProfile MakeFleetProfile(int index, uint32_t seed) {
+  std::mt19937 rng(seed * 7919u + (uint32_t)index);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  DeviceProfile profile;
+  profile.index = index;
+  profile.seed = rng();
+  profile.rtc_online = unit(rng) < 0.85;
+  profile.bme_online = unit(rng) < 0.97;
+  profile.sht_online = unit(rng) < 0.97;
+  profile.pzem_online = unit(rng) < 0.92;
+
+  double mode = unit(rng);
+  profile.mode = mode < 0.6 ? kModeAutoPid : mode < 0.8 ? kModeAutoTime : mode < 0.9 ? kModeAutoAdaptive : kModeManual;
+  static const float kCapacities[] = {20.0f, 20.0f, 20.0f, 40.0f, 100.0f};
+  profile.tank_capacity = kCapacities[rng() % 5];
+
+  // Sitios típicos: costa húmeda, interior, montaña y zona seca
+  struct Climate {
+    double weight, temp_mean, amplitude, dew;
+  };
+  static const Climate kClimates[] = {{0.4, 27.5, 3.5, 22.5}, {0.3, 29.0, 6.0, 18.5}, {0.2, 19.0, 5.0, 13.0},
+                                      {0.1, 32.0, 7.0, 11.0}};
+  double pick = unit(rng);
+  const Climate* climate = &kClimates[0];
+  for (const Climate& c : kClimates) {
+    climate = &c;
+    if (pick < c.weight) break;
+    pick -= c.weight;
+  }
+  profile.temp_mean = climate->temp_mean + (unit(rng) - 0.5) * 2.0;
+  profile.temp_amplitude = climate->amplitude * (0.8 + 0.4 * unit(rng));
+  profile.dew_mean = climate->dew + (unit(rng) - 0.5) * 2.0;
+  return profile;
+}
+
+DeviceModel::DeviceModel(const DeviceProfile& profile)
+    : profile_(profile), rng_(profile.seed), mode_(profile.mode), tank_capacity_(profile.tank_capacity) {
+  selected_auto_mode_ = mode_ == kModeManual ? kModeAutoPid : mode_;
+  ambient_temp_ = profile_.temp_mean;
+  ambient_dew_ = std::min(profile_.dew_mean, ambient_temp_ - 0.5);
+  evap_temp_ = ambient_temp_;
+  comp_temp_ = ambient_temp_ + 1.0;
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  water_true_ = tank_capacity_ * 0.6 * unit(rng_);
+  energy_total_ = 300.0 * unit(rng_);  // El contador del PZEM viene de antes
+  energy_start_ = energy_total_;
+  sim_ms_ = 1500;  // setup() tarda lo suyo: millis() nunca es 0 en el primer ciclo
+  t_ = h_ = p_ = te_ = he_ = tc_ = dp_ = ha_ = water_ = rate_ = rate_sd_ = v_ = c_ = po_ = energy_ = NAN;
+}
+
+double DeviceModel::Gaussian(double sigma) { return std::normal_distribution<double>(0.0, sigma)(rng_); }
+
+bool DeviceModel::Chance(double events_per_hour, int64_t dt_ms) {
+  double p = 1.0 - std::exp(-events_per_hour * (double)dt_ms / 3600000.0);
+  return std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < p;
+}
+
+void DeviceModel::StepPhysics(int64_t dt_ms, int64_t sim_wall_ms) {
+  double dt_s = (double)dt_ms / 1000.0;
+  double dt_h = dt_s / 3600.0;
+  int64_t local_s = sim_wall_ms / 1000 + (int64_t)(profile_.utc_offset_h * 3600.0);
+  double hour = (double)(((local_s % 86400) + 86400) % 86400) / 3600.0;
+  int day = (int)(local_s / 86400);
+  if (day != sim_day_) {
+    if (sim_day_ >= 0) {
+      produced_yesterday_ = produced_today_;
+      produced_today_ = 0.0;
+      energy_today_ = 0.0;
+    }
+    sim_day_ = day;
+  }
+
+  // Ambiente: ciclo diario (máximo a las 15 h) más deriva lenta
+  ambient_noise_ += -ambient_noise_ * dt_h / 2.0 + 0.6 * std::sqrt(dt_h) * Gaussian(1.0);
+  dew_noise_ += -dew_noise_ * dt_h / 6.0 + 0.5 * std::sqrt(dt_h) * Gaussian(1.0);
+  ambient_temp_ = profile_.temp_mean + profile_.temp_amplitude * std::cos(2.0 * M_PI * (hour - 15.0) / 24.0) +
+                  ambient_noise_;
+  ambient_dew_ = std::min(profile_.dew_mean + 0.8 * std::cos(2.0 * M_PI * (hour - 14.0) / 24.0) + dew_noise_,
+                          ambient_temp_ - 0.5);
+  pressure_ = 1011.0 + 1.2 * std::cos(2.0 * M_PI * (hour - 10.0) / 12.0) + 0.02 * Gaussian(1.0);
+
+  // Evaporador y carcasa del compresor
+  double evap_target;
+  if (compressor_) {
+    evap_target = ambient_dew_ - 6.0 - (ventilador_ ? 0.0 : 4.0) + 0.15 * (ambient_temp_ - 27.0);
+  } else {
+    evap_target = ventilador_ ? ambient_temp_ - 0.3 : ambient_temp_;
+  }
+  evap_temp_ = Approach(evap_temp_, evap_target, dt_s, compressor_ ? 150.0 : 300.0);
+  double comp_target = compressor_ ? ambient_temp_ + (compressor_fan_ ? 33.0 : 75.0) : ambient_temp_ + 1.5;
+  comp_temp_ = Approach(comp_temp_, comp_target, dt_s, compressor_ ? 420.0 : 900.0);
+
+  // Condensado: el aire que pasa deja el exceso sobre la saturación de la superficie fría
+  production_ = 0.0;
+  if (compressor_ && evap_temp_ < ambient_dew_) {
+    double airflow = ventilador_ ? kAirflowFan : kAirflowNatural;
+    double ambient_ah = AbsoluteHumidity(SaturationPressure(ambient_dew_), ambient_temp_);
+    double surface = evap_temp_ - 1.5;
+    double surface_ah = AbsoluteHumidity(SaturationPressure(surface), surface);
+    production_ = std::max(0.0, airflow * (ambient_ah - surface_ah) * kCondensingEfficiency / 1000.0);
+  }
+  double produced = production_ * dt_h;
+  water_true_ = std::min((double)tank_capacity_, water_true_ + produced);
+  produced_today_ += produced;
+  produced_total_ += produced;
+  if (pump_) water_true_ = std::max(0.0, water_true_ - kPumpLitersPerMinute * dt_s / 60.0);
+
+  // El usuario retira agua: a menudo si el tanque está lleno, de vez en cuando si no
+  if (water_true_ >= tank_capacity_ * kAlertTankFull / 100.0) {
+    if (full_since_ms_ < 0) full_since_ms_ = sim_ms_;
+  } else {
+    full_since_ms_ = -1;
+  }
+  if (water_true_ > 1.0 && Chance(full_since_ms_ >= 0 ? 1.5 : 0.15, dt_ms)) {
+    water_true_ *= 1.0 - std::uniform_real_distribution<double>(0.3, 0.9)(rng_);
+  }
+
+  double rate_alpha = 1.0 - std::exp(-dt_s / 600.0);
+  rate_estimate_ += (production_ - rate_estimate_) * rate_alpha;
+
+  // Red eléctrica y consumo
+  if (sim_ms_ >= sag_until_ms_ && Chance(1.0 / 36.0, dt_ms)) {
+    sag_until_ms_ = sim_ms_ + std::uniform_int_distribution<int64_t>(20000, 120000)(rng_);
+  }
+  voltage_ = sim_ms_ < sag_until_ms_ ? 93.0 + Gaussian(1.5) : 120.0 + Gaussian(0.7);
+  power_ = 4.5 + (ventilador_ ? 18.0 : 0.0) + (compressor_fan_ ? 12.0 : 0.0) + (pump_ ? 35.0 : 0.0);
+  if (compressor_) power_ += 270.0 + 3.0 * (ambient_temp_ - 27.0) + Gaussian(3.0);
+  double energy = power_ * dt_s / 3.6e6;
+  energy_total_ += energy;
+  energy_today_ += energy;
+}
+
+void DeviceModel::ReadSensors() {
+  if (profile_.bme_online) {
+    double rh = std::min(99.5, 100.0 * SaturationPressure(ambient_dew_) / SaturationPressure(ambient_temp_));
+    t_ = (float)(ambient_temp_ + Gaussian(0.05));
+    h_ = (float)std::min(100.0, std::max(0.0, rh + Gaussian(0.3)));
+    p_ = (float)pressure_;
+    // Como el firmware: rocío y humedad absoluta se derivan de la lectura del BME280
+    dp_ = (float)DewPoint(t_, h_);
+    ha_ = (float)AbsoluteHumidity(SaturationPressure(t_) * h_ / 100.0, t_);
+  } else {
+    t_ = h_ = p_ = dp_ = ha_ = NAN;
+  }
+  if (profile_.sht_online) {
+    double vapor = SaturationPressure(ambient_dew_);
+    double rh = evap_temp_ <= ambient_dew_ ? 96.0 + 2.0 * std::uniform_real_distribution<double>(0.0, 1.0)(rng_)
+                                           : std::min(99.0, 100.0 * vapor / SaturationPressure(evap_temp_));
+    te_ = (float)(evap_temp_ + Gaussian(0.05));
+    he_ = (float)std::min(100.0, rh + Gaussian(0.3));
+  } else {
+    te_ = he_ = NAN;
+  }
+  tc_ = (float)(comp_temp_ + Gaussian(0.1));
+  water_ = (float)std::max(0.0, water_true_ + Gaussian(0.02));
+  water_percent_ = std::min(100.0f, std::max(0.0f, water_ / tank_capacity_ * 100.0f));
+  // El estimador de nivel necesita unas lecturas antes de dar tasa
+  if (rate_samples_ < 3) {
+    rate_samples_++;
+    rate_ = rate_sd_ = NAN;
+  } else {
+    rate_ = (float)(rate_estimate_ + Gaussian(0.005));
+    rate_sd_ = (float)(0.04 + std::fabs(Gaussian(0.01)));
+  }
+  if (profile_.pzem_online) {
+    v_ = (float)voltage_;
+    double power_factor = compressor_ ? 0.92 : 0.6;
+    c_ = (float)(power_ / (voltage_ * power_factor));
+    po_ = (float)power_;
+    energy_ = (float)energy_total_;
+  } else {
+    v_ = c_ = po_ = energy_ = NAN;
+  }
+}
+
+void DeviceModel::ReadCycle(int64_t dt_ms, int64_t sim_wall_ms, int64_t uptime_ms, int64_t wall_ms,
+                            std::vector<Outgoing>* out) {
+  sim_ms_ += dt_ms;
+  StepPhysics(dt_ms, sim_wall_ms);
+  ReadSensors();
+  CheckAlerts(uptime_ms, wall_ms, out);
+  ProcessControl(out);
+  PublishState(out);
+}
+
+bool DeviceModel::IsTankFull() const {
+  if (std::isnan(water_)) return false;
+  return water_percent_ >= kAlertTankFull;
+}
+
+void DeviceModel::SetCompressor(bool on) {
+  if (on && !compressor_) compressor_starts_++;
+  compressor_ = on;
+}
+
+void DeviceModel::PublishState(std::vector<Outgoing>* out) const {
+  out->push_back(Outgoing{kTopicStatus, StatePayload(), true});
+}
+
+std::string DeviceModel::StatePayload() const {
+  FirmwareJson doc;
+  doc.Int("compressor", compressor_ ? 1 : 0)
+      .Int("ventilador", ventilador_ ? 1 : 0)
+      .Int("compressor_fan", compressor_fan_ ? 1 : 0)
+      .Int("pump", pump_ ? 1 : 0)
+      .String("mode", mode_ == kModeManual ? "MANUAL" : "AUTO");  // Ambos automáticos se muestran como AUTO
+  return doc.Serialize(kStatusBufferSize);
+}
+
+void DeviceModel::SendAlert(const char* type, const char* message, float value, int64_t uptime_ms, int64_t wall_ms,
+                            std::vector<Outgoing>* out) {
+  FirmwareJson doc;
+  doc.String("type", type).String("message", message).String("value", FirmwareFloat2(value));
+  doc.Int("timestamp", profile_.rtc_online ? wall_ms / 1000 : uptime_ms / 1000);
+  out->push_back(Outgoing{kTopicAlerts, doc.Serialize(kStatusBufferSize), true});
+  alerts_sent_++;
+}
+
+void DeviceModel::CheckAlerts(int64_t uptime_ms, int64_t wall_ms, std::vector<Outgoing>* out) {
+  // voltage_zero no se simula: un equipo sin alimentación tampoco publica
+  if (!std::isnan(v_) && v_ >= 0) {
+    bool low = v_ < kAlertVoltageLow;
+    if (low && !alert_voltage_low_) {
+      SendAlert("voltage_low", "Voltaje bajo detectado.", v_, uptime_ms, wall_ms, out);
+      alert_voltage_low_ = true;
+    } else if (!low && alert_voltage_low_) {
+      alert_voltage_low_ = false;
+    }
+  }
+
+  if (water_ >= 0) {
+    bool full = water_percent_ >= kAlertTankFull;
+    if (full && !alert_tank_full_) {
+      SendAlert("tank_full", "Tanque lleno detectado", water_percent_, uptime_ms, wall_ms, out);
+      alert_tank_full_ = true;
+    } else if (!full && alert_tank_full_) {
+      alert_tank_full_ = false;
+    }
+  }
+
+  if (profile_.bme_online && h_ > 0) {
+    bool low = h_ < kAlertHumidityLow;
+    if (low && !alert_humidity_low_) {
+      SendAlert("humidity_low",
+                "Humedad baja detectada. Operar el dispositivo Dropster AWG a este nivel de humedad puede presentar "
+                "baja eficiencia.",
+                h_, uptime_ms, wall_ms, out);
+      alert_humidity_low_ = true;
+    } else if (!low && alert_humidity_low_) {
+      alert_humidity_low_ = false;
+    }
+  }
+
+  // Protección de la bomba por nivel bajo
+  if (pump_ && !std::isnan(water_) && water_ <= kPumpMinLevel) {
+    if (!alert_pump_low_) {
+      SendAlert("pump_low_level", "Nivel de agua crítico - Bomba apagada por seguridad.", water_, uptime_ms, wall_ms,
+                out);
+      alert_pump_low_ = true;
+    }
+    pump_ = false;  // setPumpState(false)
+    PublishState(out);
+  } else if (!pump_ && alert_pump_low_) {
+    alert_pump_low_ = false;
+  }
+
+  if (tc_ > 0) {
+    bool high = tc_ >= kMaxCompressorTemp;
+    if (high && !alert_compressor_temp_) {
+      SendAlert("compressor_temp_high", "Temperatura del compresor demasiado alta.", tc_, uptime_ms, wall_ms, out);
+      alert_compressor_temp_ = true;
+      temp_protection_ = true;
+      SetCompressor(false);
+      out->push_back(Outgoing{kTopicStatus, "COMP_OFF", false});
+      PublishState(out);
+    } else if (!high && alert_compressor_temp_) {
+      alert_compressor_temp_ = false;
+    }
+  }
+}
+
+void DeviceModel::ProcessControl(std::vector<Outgoing>* out) {
+  if (mode_ == kModeManual) return;
+  int64_t now = sim_ms_;
+
+  if (temp_protection_) {
+    if (tc_ <= kMaxCompressorTemp - 20.0f) {
+      temp_protection_ = false;
+    } else {
+      return;
+    }
+  }
+
+  if (mode_ == kModeAutoTime) {
+    // Ventiladores siempre encendidos; ciclo fijo sin perfil horario
+    if (!ventilador_) {
+      ventilador_ = true;
+      PublishState(out);
+    }
+    if (!compressor_fan_) {
+      compressor_fan_ = true;
+      PublishState(out);
+    }
+    if (time_cycle_start_ == 0) {
+      time_cycle_start_ = now;
+      time_compressor_state_ = true;
+      if (IsTankFull()) return;
+      SetCompressor(true);
+      PublishState(out);
+      compressor_on_start_ = now;
+      return;
+    }
+    int64_t target = time_compressor_state_ ? kTimeModeOnMs : kTimeModeOffMs;
+    if (now - time_cycle_start_ >= target) {
+      time_compressor_state_ = !time_compressor_state_;
+      time_cycle_start_ = now;
+      if (time_compressor_state_) {
+        if (IsTankFull()) return;
+        SetCompressor(true);
+        PublishState(out);
+        compressor_on_start_ = now;
+      } else {
+        SetCompressor(false);
+        PublishState(out);
+        compressor_off_start_ = now;
+        compressor_on_start_ = 0;
+      }
+    }
+    return;
+  }
+
+  // PID y adaptativo: histéresis del evaporador alrededor del punto de rocío
+  if (!profile_.sht_online) return;
+  if (now - last_control_sample_ < kControlSamplingMs) return;
+  last_control_sample_ = now;
+  if (!compressor_fan_) {
+    compressor_fan_ = true;
+    PublishState(out);
+  }
+  float raw = te_;
+  if (raw == 0.0f) return;
+  if (!evap_smoothed_init_) {
+    evap_smoothed_ = raw;
+    evap_smoothed_init_ = true;
+  } else {
+    evap_smoothed_ = kSmoothingAlpha * raw + (1.0f - kSmoothingAlpha) * evap_smoothed_;
+  }
+  // Sin punto de rocío solo rigen el máximo encendido y el mínimo apagado
+  float dew = dp_;
+  bool dew_valid = !std::isnan(dew);
+
+  float on_threshold = dew + kControlDeadband / 2.0f;
+  float off_threshold = dew - kControlDeadband / 2.0f;
+  if (compressor_) {
+    if (compressor_on_start_ == 0) compressor_on_start_ = now;
+    if (now - compressor_on_start_ >= kControlMaxOnMs || (dew_valid && evap_smoothed_ <= off_threshold)) {
+      SetCompressor(false);
+      PublishState(out);
+      compressor_off_start_ = now;
+      compressor_on_start_ = 0;
+    }
+  } else {
+    if (compressor_off_start_ == 0) compressor_off_start_ = now;
+    bool min_off_elapsed = now - compressor_off_start_ >= kControlMinOffMs || force_start_;
+    if (dew_valid && min_off_elapsed && evap_smoothed_ >= on_threshold) {
+      if (IsTankFull()) return;
+      SetCompressor(true);
+      PublishState(out);
+      compressor_on_start_ = now;
+      compressor_off_start_ = 0;
+      force_start_ = false;
+    }
+  }
+
+  if (!dew_valid) return;
+  if (ventilador_) {
+    if (evap_smoothed_ >= dew + kFanOffOffset) {
+      ventilador_ = false;
+      PublishState(out);
+    }
+  } else if (evap_smoothed_ <= dew - kFanOnOffset) {
+    ventilador_ = true;
+    PublishState(out);
+  }
+}
+
+std::string DeviceModel::DataPayload(int64_t uptime_ms, int64_t wall_ms) const {
+  float safe_water = water_;
+  if (!std::isnan(safe_water) && safe_water < 0.0f) safe_water = 0.0f;
+  float safe_energy = energy_;
+  if (!std::isnan(safe_energy) && safe_energy < 0.0f) safe_energy = 0.0f;
+
+  FirmwareJson doc;
+  if (profile_.bme_online) {
+    doc.String("t", FirmwareFloat2(t_)).String("h", FirmwareFloat2(h_)).String("p", FirmwareFloat2(p_));
+  }
+  doc.String("w", FirmwareFloat2(safe_water));
+  if (!std::isnan(rate_)) {
+    doc.String("wr", FirmwareFloat2(std::max(0.0f, rate_))).String("wu", FirmwareFloat2(rate_sd_));
+  }
+  if (profile_.sht_online) doc.String("te", FirmwareFloat2(te_)).String("he", FirmwareFloat2(he_));
+  doc.String("tc", FirmwareFloat2(tc_));
+  if (!std::isnan(dp_)) doc.String("dp", FirmwareFloat2(dp_));
+  if (!std::isnan(ha_)) doc.String("ha", FirmwareFloat2(ha_));
+  if (profile_.pzem_online) {
+    if (v_ > 0) doc.String("v", FirmwareFloat2(v_));
+    if (c_ >= 0) doc.String("c", FirmwareFloat2(c_));
+    if (po_ >= 0) doc.String("po", FirmwareFloat2(po_));
+  }
+  if (safe_energy >= 0) doc.String("e", FirmwareFloat2(safe_energy));
+  doc.String("mqtt_broker", profile_.broker)
+      .Int("mqtt_port", profile_.broker_port)
+      .String("mqtt_topic", profile_.data_topic)
+      .Bool("mqtt_connected", true)
+      .String("tank_capacity", FirmwareFloat2(tank_capacity_));
+  if (profile_.rtc_online) {
+    doc.Int("ts", wall_ms / 1000);
+  } else {
+    doc.String("ts", FirmwareDtostrf((double)uptime_ms / 1000.0, 2));
+  }
+  return doc.Serialize(kDataBufferSize);
+}
+
+std::string DeviceModel::ConsolidatedStatus(int64_t uptime_ms, int64_t /*wall_ms*/) const {
+  FirmwareJson doc;
+  doc.String("type", "system_status")
+      .String("status", "online")
+      .Int("compressor", compressor_ ? 1 : 0)
+      .Int("ventilador", ventilador_ ? 1 : 0)
+      .Int("compressor_fan", compressor_fan_ ? 1 : 0)
+      .Int("pump", pump_ ? 1 : 0)
+      .String("mode", ModeName(mode_))
+      .Float("tank_capacity", tank_capacity_)
+      .Int("uptime", uptime_ms / 1000)
+      .String("broker", profile_.broker)
+      .Int("port", profile_.broker_port)
+      .String("topic", profile_.status_topic)
+      .String("device_id", profile_.device_id)
+      .Bool("wifi_connected", true);
+  // Eficiencia (L/kWh): NAN hasta que el controlador adaptativo tiene una ventana válida
+  double used = energy_total_ - energy_start_;
+  if (profile_.pzem_online && used > 0.05) doc.Float("efficiency", RoundCents(produced_total_ / used));
+  if (mode_ == kModeAutoAdaptive && profile_.pzem_online && energy_today_ > 0.05) {
+    doc.Float("efficiency_live", RoundCents(produced_today_ / energy_today_));
+  }
+  if (profile_.rtc_online) {
+    doc.Float("expected_lpd", RoundCents(produced_yesterday_)).Float("achieved_lpd", RoundCents(produced_today_));
+  }
+  return doc.Serialize(kConsolidatedBufferSize);
+}
+
+namespace {
+
+// micros() del equipo: reloj monótono truncado a 32 bits, con las mismas vueltas
+uint32_t Micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+void DeviceModel::CommandArrived() { tracer_.arrived(Micros(), 0); }
+
+void DeviceModel::ProcessCommand(const char* payload, size_t length, int64_t uptime_ms, int64_t /*wall_ms*/,
+                                 std::vector<Outgoing>* out) {
+  // CommandTraceScope del firmware: el acuse sale por cualquier retorno
+  tracer_.begin(Micros());
+  if (length > 0) {
+    std::string cmd(payload, length);
+    // String::trim()
+    size_t first = cmd.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos) {
+      cmd = cmd.substr(first, cmd.find_last_not_of(" \t\r\n") - first + 1);
+      size_t envelope = tracer_.takeEnvelope(cmd.c_str());
+      cmd.erase(0, envelope);
+      if (cmd.empty()) {
+        tracer_.reject(CMD_REJECT_UNKNOWN);
+      } else {
+        RunCommand(std::move(cmd), uptime_ms, out);
+      }
+    }
+  }
+  CommandAck ack;
+  if (tracer_.end(Micros(), (uint32_t)uptime_ms, &ack)) {
+    char buffer[CMD_ACK_MAX];
+    if (ack.toJson(buffer, sizeof(buffer)) > 0) out->push_back(Outgoing{kTopicAck, buffer, false});
+  }
+}
+
+void DeviceModel::RunCommand(std::string cmd, int64_t uptime_ms, std::vector<Outgoing>* out) {
+  if (cmd.find("\"type\":\"config_ack\"") != std::string::npos) return;
+  for (char& ch : cmd) ch = (char)tolower((unsigned char)ch);  // String::toLowerCase()
+
+  int64_t now = uptime_ms;
+  if (cmd == last_command_ && now - last_command_ms_ < kCommandDebounceMs) {
+    tracer_.reject(CMD_REJECT_DEBOUNCE);
+    return;
+  }
+  if (processing_command_) {
+    if (now - last_command_ms_ < kCommandTimeoutMs) {
+      tracer_.reject(CMD_REJECT_LOCKED);
+      return;
+    }
+    processing_command_ = false;
+  }
+
+  auto starts_with = [&cmd](const char* prefix) { return cmd.compare(0, strlen(prefix), prefix) == 0; };
+  auto config_ack = [out]() {
+    FirmwareJson ack;
+    ack.String("type", "config_ack").String("status", "success");
+    out->push_back(Outgoing{kTopicStatus, ack.Serialize(50), false});
+  };
+
+  // Configuración fragmentada: no pasa por el debounce ni por el bloqueo
+  for (int part = 0; part < 4; part++) {
+    std::string prefix = "update_config_part" + std::to_string(part + 1);
+    if (starts_with(prefix.c_str())) {
+      for (int previous = 0; previous < part; previous++) {
+        if (!config_fragments_[previous]) return;  // Fuera de orden
+      }
+      config_fragments_[part] = true;
+      return;
+    }
+  }
+  if (cmd == "update_config_assemble") {
+    bool complete = config_fragments_[0] && config_fragments_[1] && config_fragments_[2] && config_fragments_[3];
+    for (bool& fragment : config_fragments_) fragment = false;
+    if (complete) config_ack();  // processUnifiedConfig() con cambios
+    return;
+  }
+
+  bool critical = starts_with("update_config") || starts_with("mode") || cmd == "on" || cmd == "off" ||
+                  starts_with("calib_");
+  if (critical) processing_command_ = true;
+  last_command_ = cmd;
+  last_command_ms_ = now;
+  tracer_.dispatch(Micros());
+
+  // Las salidas tempranas dejan processing_command_ en true hasta COMMAND_TIMEOUT, igual
+  // que en el firmware: durante 5 s se ignora cualquier otro comando
+  auto set_auto_mode = [&](SimMode mode, const char* status) {
+    mode_ = mode;
+    out->push_back(Outgoing{kTopicStatus, status, false});
+    SetCompressor(true);
+    tracer_.actuate(Micros());
+    ventilador_ = true;
+    PublishState(out);  // setVentiladorState(true)
+    compressor_fan_ = true;
+    PublishState(out);  // setCompressorFanState(true)
+    if (mode == kModeAutoTime) {
+      time_cycle_start_ = sim_ms_;
+      time_compressor_state_ = true;
+    } else {
+      force_start_ = true;
+    }
+    PublishState(out);
+  };
+
+  if (cmd == "on") {
+    if (tc_ >= kMaxCompressorTemp) {
+      tracer_.reject(CMD_REJECT_COMPRESSOR_TEMP);
+      return;
+    }
+    if (IsTankFull()) {
+      tracer_.reject(CMD_REJECT_TANK_FULL);
+      return;
+    }
+    mode_ = kModeManual;
+    SetCompressor(true);
+    tracer_.actuate(Micros());
+    out->push_back(Outgoing{kTopicStatus, "COMP_ON", false});
+    PublishState(out);
+  } else if (cmd == "off") {
+    mode_ = kModeManual;
+    SetCompressor(false);
+    tracer_.actuate(Micros());
+    out->push_back(Outgoing{kTopicStatus, "COMP_OFF", false});
+    PublishState(out);
+  } else if (cmd == "onv" || cmd == "offv") {
+    ventilador_ = cmd == "onv";
+    tracer_.actuate(Micros());
+    PublishState(out);
+  } else if (cmd == "oncf" || cmd == "offcf") {
+    compressor_fan_ = cmd == "oncf";
+    tracer_.actuate(Micros());
+    PublishState(out);
+  } else if (cmd == "onb") {
+    mode_ = kModeManual;
+    if (water_ < kPumpMinLevel) {
+      out->push_back(Outgoing{kTopicData, "{\"ps\":0}", false});  // publishImmediateUpdate("ps", 0)
+      tracer_.reject(CMD_REJECT_PUMP_LOW);
+      return;
+    }
+    pump_ = true;
+    tracer_.actuate(Micros());
+    PublishState(out);
+  } else if (cmd == "offb") {
+    mode_ = kModeManual;
+    pump_ = false;
+    tracer_.actuate(Micros());
+    PublishState(out);
+  } else if (cmd == "mode auto" || cmd == "mode_auto" || cmd == "mode:auto") {
+    set_auto_mode(selected_auto_mode_, selected_auto_mode_ == kModeAutoTime       ? "MODE_AUTO_TIME"
+                                       : selected_auto_mode_ == kModeAutoAdaptive ? "MODE_AUTO_ADAPTIVE"
+                                                                                  : "MODE_AUTO_PID");
+  } else if (cmd == "mode auto_pid" || cmd == "mode_auto_pid" || cmd == "mode:auto_pid") {
+    selected_auto_mode_ = kModeAutoPid;
+    set_auto_mode(kModeAutoPid, "MODE_AUTO_PID");
+  } else if (cmd == "mode auto_adaptive" || cmd == "mode_auto_adaptive" || cmd == "mode:auto_adaptive") {
+    selected_auto_mode_ = kModeAutoAdaptive;
+    set_auto_mode(kModeAutoAdaptive, "MODE_AUTO_ADAPTIVE");
+  } else if (cmd == "mode auto_time" || cmd == "mode_auto_time" || cmd == "mode:auto_time") {
+    selected_auto_mode_ = kModeAutoTime;
+    set_auto_mode(kModeAutoTime, "MODE_AUTO_TIME");
+  } else if (cmd == "mode manual" || cmd == "mode_manual" || cmd == "mode:manual") {
+    mode_ = kModeManual;
+    out->push_back(Outgoing{kTopicStatus, "MODE_MANUAL", false});
+    force_start_ = false;
+    PublishState(out);
+  } else if (starts_with("set_tank_capacity")) {
+    float capacity = strtof(cmd.c_str() + 17, nullptr);
+    if (capacity > 0 && capacity <= 10000) tank_capacity_ = capacity;
+  } else if (starts_with("update_config")) {
+    if (cmd.size() <= 13) return;  // Payload vacío
+    config_ack();
+  } else if (cmd == "cmd_stats") {
+    char buffer[CMD_STATS_MAX];
+    if (tracer_.statsJson(buffer, sizeof(buffer)) > 0) out->push_back(Outgoing{kTopicAck, buffer, false});
+  } else if (cmd == "cmd_stats_reset") {
+    tracer_.resetStats();
+  }
+  // El resto de los comandos solo escriben en Serial o en preferencias (sin "no reconocido":
+  // el modelo no conoce la lista completa)
+
+  if (critical) processing_command_ = false;
+}
+
+}  // namespace dropster
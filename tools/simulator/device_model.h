@@ -0,0 +1,182 @@
+#ifndef DROPSTER_SIMULATOR_DEVICE_MODEL_H_
+#define DROPSTER_SIMULATOR_DEVICE_MODEL_H_
+
+// Modelo de un AWG Dropster: física del equipo más la lógica del firmware que decide qué se
+// publica (hardware/firmware/awg/mainAWG/mainAWG.ino). No hace E/S: cada llamada devuelve
+// los mensajes que el firmware habría publicado, así el mismo modelo sirve para la sesión
+// MQTT del simulador y para la verificación offline (dropster-sim check).
+//
+// Física (un paso por ciclo de lectura, SENSOR_READ_INTERVAL):
+// - Ambiente: temperatura con ciclo diario, punto de rocío del sitio casi constante, presión
+//   con la marea barométrica semidiurna. La humedad relativa sale de ambos.
+// - Evaporador: primer orden hacia (rocío - 6 °C) con compresor, hacia el ambiente sin él.
+// - Condensado: caudal de aire × (humedad absoluta ambiente - saturación en la superficie
+//   fría); el tanque se llena con eso y el usuario retira agua de vez en cuando.
+// - Compresor: temperatura de carcasa de primer orden; sin su ventilador sobrecalienta.
+// - Red: 120 V con ruido y huecos de tensión ocasionales; energía acumulada en kWh.
+//
+// Firmware reproducido: control PID/TIME/ADAPTIVE sobre el evaporador (umbrales, tiempos
+// mínimo apagado/máximo encendido, ventiladores), checkAlerts(), processCommand() con su
+// debounce y bloqueo de comandos críticos (con el acuse de command_trace.h), y el formato
+// exacto de cada payload.
+
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "command_trace.h"
+
+namespace dropster {
+
+enum SimMode { kModeManual, kModeAutoPid, kModeAutoTime, kModeAutoAdaptive };
+
+// Tópicos del firmware (config.h); la sesión decide el prefijo
+enum SimTopic { kTopicData, kTopicStatus, kTopicAlerts, kTopicSystem, kTopicControl, kTopicAck, kTopicCount };
+extern const char* const kSimTopicLeaves[kTopicCount];  // "data", "status", ...
+
+struct Outgoing {
+  SimTopic topic;
+  std::string payload;
+  bool retain;
+};
+
+// Lo que distingue a un equipo de otro: sitio, sensores presentes y configuración guardada
+struct DeviceProfile {
+  int index = 0;
+  uint32_t seed = 1;
+  bool rtc_online = true;  // Sin RTC: "ts" es el uptime con 2 decimales
+  bool bme_online = true;
+  bool sht_online = true;
+  bool pzem_online = true;
+  SimMode mode = kModeAutoPid;
+  float tank_capacity = 20.0f;  // TANK_CAPACITY_DEFAULT
+  double temp_mean = 27.0;      // Clima del sitio (°C)
+  double temp_amplitude = 4.0;
+  double dew_mean = 20.0;
+  double utc_offset_h = -4.0;
+  // Valores que el firmware copia dentro de los payloads
+  std::string broker = "localhost";
+  int broker_port = 1883;
+  std::string data_topic = "dropster/data";
+  std::string status_topic = "dropster/status";
+  std::string device_id = "awg-240ac4000000";
+};
+
+// Perfil variado y reproducible para el dispositivo `index` de una flota
+DeviceProfile MakeFleetProfile(int index, uint32_t seed);
+
+class DeviceModel {
+ public:
+  explicit DeviceModel(const DeviceProfile& profile);
+
+  // Un ciclo de lectura del loop(): avanza la física dt_ms de tiempo simulado y corre
+  // readSensors() -> checkAlerts() -> processControl() -> publishState().
+  // sim_wall_ms es la hora simulada (ciclo diario); uptime_ms y wall_ms, los reales
+  void ReadCycle(int64_t dt_ms, int64_t sim_wall_ms, int64_t uptime_ms, int64_t wall_ms, std::vector<Outgoing>* out);
+
+  // Payloads periódicos
+  std::string DataPayload(int64_t uptime_ms, int64_t wall_ms) const;         // transmitMQTTData()
+  std::string ConsolidatedStatus(int64_t uptime_ms, int64_t wall_ms) const;  // publishConsolidatedStatus()
+  std::string StatePayload() const;                                          // publishState()
+
+  // onMqttMessage(): marca la llegada por MQTT antes de ProcessCommand(). El simulador no
+  // tiene la espera de mqttClient.loop() (el bucle de eventos lee en cuanto hay datos): poll = 0
+  void CommandArrived();
+
+  // onMqttMessage() -> processCommand() para un mensaje de dropster/control. Con prefijo
+  // "@<cid>[:<ts>] " agrega el acuse en kTopicAck, igual que el firmware
+  void ProcessCommand(const char* payload, size_t length, int64_t uptime_ms, int64_t wall_ms,
+                      std::vector<Outgoing>* out);
+
+  const DeviceProfile& profile() const { return profile_; }
+  SimMode mode() const { return mode_; }
+  bool compressor_on() const { return compressor_; }
+  float water_volume() const { return water_; }
+  float energy_kwh() const { return energy_; }
+  uint32_t compressor_starts() const { return compressor_starts_; }
+  uint32_t alerts_sent() const { return alerts_sent_; }
+  const CommandTracer& tracer() const { return tracer_; }
+
+ private:
+  // Ambiente "verdadero" y estado físico (double); lo publicado pasa por float como en el AWG
+  DeviceProfile profile_;
+  std::mt19937 rng_;
+  double ambient_noise_ = 0.0;  // Proceso de Ornstein-Uhlenbeck sobre la temperatura
+  double dew_noise_ = 0.0;
+  double ambient_temp_;
+  double ambient_dew_;
+  double pressure_ = 1011.0;
+  double voltage_ = 120.0;
+  double power_ = 0.0;
+  double production_ = 0.0;  // L/h instantáneos
+  double evap_temp_;
+  double comp_temp_;
+  double water_true_;
+  double produced_today_ = 0.0;
+  double produced_yesterday_ = 0.0;
+  double produced_total_ = 0.0;
+  double energy_total_;
+  double energy_start_;
+  double energy_today_ = 0.0;
+  double rate_estimate_ = 0.0;  // Estimador de producción (L/h), como level_estimator.h
+  int rate_samples_ = 0;
+  int64_t sag_until_ms_ = 0;     // Hueco de tensión en curso (tiempo simulado)
+  int64_t full_since_ms_ = -1;   // Tanque lleno desde (para el retiro del usuario)
+  int64_t sim_ms_ = 0;           // Tiempo simulado desde el arranque
+  int sim_day_ = -1;
+
+  // SensorData publicado (float, NAN = sin lectura)
+  float t_, h_, p_, te_, he_, tc_, dp_, ha_, water_, rate_, rate_sd_, v_, c_, po_, energy_;
+  float water_percent_ = 0.0f;
+
+  // Estado del firmware
+  SimMode mode_;
+  SimMode selected_auto_mode_;
+  bool compressor_ = false;
+  bool ventilador_ = false;
+  bool compressor_fan_ = false;
+  bool pump_ = false;
+  float tank_capacity_;
+  int64_t compressor_on_start_ = 0;  // ms simulados; 0 = sin marcar, como en el firmware
+  int64_t compressor_off_start_ = 0;
+  int64_t last_control_sample_ = 0;
+  int64_t time_cycle_start_ = 0;
+  bool time_compressor_state_ = false;
+  bool force_start_ = false;
+  bool evap_smoothed_init_ = false;
+  float evap_smoothed_ = 0.0f;
+  bool temp_protection_ = false;
+  bool alert_voltage_low_ = false;
+  bool alert_tank_full_ = false;
+  bool alert_humidity_low_ = false;
+  bool alert_pump_low_ = false;
+  bool alert_compressor_temp_ = false;
+  // processCommand(): debounce y bloqueo de comandos críticos (ms de uptime)
+  std::string last_command_;
+  int64_t last_command_ms_ = -1000000;
+  bool processing_command_ = false;
+  bool config_fragments_[4] = {};
+  CommandTracer tracer_;
+
+  uint32_t compressor_starts_ = 0;
+  uint32_t alerts_sent_ = 0;
+
+  double Gaussian(double sigma);
+  bool Chance(double events_per_hour, int64_t dt_ms);
+  void StepPhysics(int64_t dt_ms, int64_t sim_wall_ms);
+  void ReadSensors();
+  void CheckAlerts(int64_t uptime_ms, int64_t wall_ms, std::vector<Outgoing>* out);
+  void ProcessControl(std::vector<Outgoing>* out);
+  void SetCompressor(bool on);
+  void RunCommand(std::string cmd, int64_t uptime_ms, std::vector<Outgoing>* out);
+  void PublishState(std::vector<Outgoing>* out) const;
+  void SendAlert(const char* type, const char* message, float value, int64_t uptime_ms, int64_t wall_ms,
+                 std::vector<Outgoing>* out);
+  bool IsTankFull() const;
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_SIMULATOR_DEVICE_MODEL_H_
@@ -0,0 +1,170 @@
+#include "firmware_format.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace dropster {
+
+std::string FirmwareDtostrf(double number, unsigned decimals) {
+  if (std::isnan(number)) return "nan";
+  if (std::isinf(number)) return "inf";
+
+  std::string out;
+  if (number < 0.0) {
+    out += '-';
+    number = -number;
+  }
+  // Redondeo del core: suma media unidad del último decimal y luego trunca
+  double rounding = 2.0;
+  for (unsigned i = 0; i < decimals; i++) rounding *= 10.0;
+  number += 1.0 / rounding;
+
+  double tenpow = 1.0;
+  unsigned digits = 1;
+  while (number >= 10.0 * tenpow) {
+    tenpow *= 10.0;
+    digits++;
+  }
+  number /= tenpow;
+
+  digits += decimals;
+  while (digits-- > 0) {
+    int digit = (int)number;
+    if (digit > 9) digit = 9;
+    out += (char)('0' + digit);
+    if (digits == decimals && decimals > 0) out += '.';
+    number -= digit;
+    number *= 10.0;
+  }
+  return out;
+}
+
+namespace {
+
+// FloatTraits<double> de ArduinoJson: potencias binarias de diez
+const double kPositivePowers[9] = {1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256};
+const double kNegativePowers[9] = {1e-1, 1e-2, 1e-4, 1e-8, 1e-16, 1e-32, 1e-64, 1e-128, 1e-256};
+const double kNegativePowersPlusOne[9] = {1e0, 1e-1, 1e-3, 1e-7, 1e-15, 1e-31, 1e-63, 1e-127, 1e-255};
+
+int Normalize(double& value) {
+  int powers = 0;
+  int index = 8;
+  int bit = 1 << index;
+  if (value >= 1e7) {
+    for (; index >= 0; index--) {
+      if (value >= kPositivePowers[index]) {
+        value *= kNegativePowers[index];
+        powers += bit;
+      }
+      bit >>= 1;
+    }
+  }
+  if (value > 0 && value <= 1e-5) {
+    for (; index >= 0; index--) {
+      if (value < kNegativePowersPlusOne[index]) {
+        value *= kPositivePowers[index];
+        powers -= bit;
+      }
+      bit >>= 1;
+    }
+  }
+  return powers;
+}
+
+}  // namespace
+
+std::string ArduinoJsonFloat(double value) {
+  if (std::isnan(value) || std::isinf(value)) return "null";  // ARDUINOJSON_ENABLE_NAN/INFINITY = 0
+  std::string out;
+  if (value < 0.0) {
+    out += '-';
+    value = -value;
+  }
+  // FloatParts<double>
+  uint32_t max_decimal = 1000000000;
+  int places = 9;
+  int exponent = Normalize(value);
+  uint32_t integral = (uint32_t)value;
+  for (uint32_t tmp = integral; tmp >= 10; tmp /= 10) {
+    max_decimal /= 10;
+    places--;
+  }
+  double remainder = (value - (double)integral) * (double)max_decimal;
+  uint32_t decimal = (uint32_t)remainder;
+  remainder -= (double)decimal;
+  decimal += (uint32_t)(remainder * 2);
+  if (decimal >= max_decimal) {
+    decimal = 0;
+    integral++;
+    if (exponent && integral >= 10) {
+      exponent++;
+      integral = 1;
+    }
+  }
+  while (decimal % 10 == 0 && places > 0) {
+    decimal /= 10;
+    places--;
+  }
+
+  out += std::to_string(integral);
+  if (places > 0) {
+    char digits[16];
+    snprintf(digits, sizeof(digits), ".%0*u", places, decimal);
+    out += digits;
+  }
+  if (exponent) out += "e" + std::to_string(exponent);
+  return out;
+}
+
+void FirmwareJson::Key(const char* key) {
+  if (text_.size() > 1) text_ += ',';
+  text_ += '"';
+  text_ += key;
+  text_ += "\":";
+}
+
+FirmwareJson& FirmwareJson::String(const char* key, const std::string& value) {
+  Key(key);
+  text_ += '"';
+  for (char ch : value) {
+    // EscapeSequence de ArduinoJson: solo estas secuencias, el resto se copia tal cual
+    switch (ch) {
+      case '"': text_ += "\\\""; break;
+      case '\\': text_ += "\\\\"; break;
+      case '\b': text_ += "\\b"; break;
+      case '\f': text_ += "\\f"; break;
+      case '\n': text_ += "\\n"; break;
+      case '\r': text_ += "\\r"; break;
+      case '\t': text_ += "\\t"; break;
+      default: text_ += ch;
+    }
+  }
+  text_ += '"';
+  return *this;
+}
+
+FirmwareJson& FirmwareJson::Int(const char* key, int64_t value) {
+  Key(key);
+  text_ += std::to_string(value);
+  return *this;
+}
+
+FirmwareJson& FirmwareJson::Bool(const char* key, bool value) {
+  Key(key);
+  text_ += value ? "true" : "false";
+  return *this;
+}
+
+FirmwareJson& FirmwareJson::Float(const char* key, float value) {
+  Key(key);
+  text_ += ArduinoJsonFloat(value);
+  return *this;
+}
+
+std::string FirmwareJson::Serialize(size_t buffer_size) const {
+  std::string out = text_ + "}";
+  if (buffer_size > 0 && out.size() > buffer_size - 1) out.resize(buffer_size - 1);
+  return out;
+}
+
+}  // namespace dropster
@@ -0,0 +1,51 @@
+#ifndef DROPSTER_SIMULATOR_FIRMWARE_FORMAT_H_
+#define DROPSTER_SIMULATOR_FIRMWARE_FORMAT_H_
+
+// Formato de texto idéntico al del AWG, para que el simulador publique los mismos bytes.
+//
+// El firmware arma sus mensajes con ArduinoJson 6 (StaticJsonDocument + serializeJson) y
+// convierte la mayoría de los números con dtostrf(valor, 1, 2, buf) del core ESP32. Ambos
+// tienen particularidades que la app y el historiador ya toleran y que un generador con
+// printf no reproduce:
+// - dtostrf redondea sumando 0.005 y trunca dígito a dígito: -0.001 -> "-0.00", NaN -> "nan".
+// - ArduinoJson guarda los float como double y los escribe con 9 dígitos significativos sin
+//   ceros finales: 20.0f -> 20, 1.23f -> 1.230000019.
+// - serializeJson sobre un char[N] trunca en N-1 bytes sin avisar; el firmware publica el
+//   resultado truncado (sendAlert solo verifica len > 0).
+
+#include <stdint.h>
+
+#include <string>
+
+namespace dropster {
+
+// dtostrf(value, 1, decimals, buf) de arduino-esp32 (cores/esp32/stdlib_noniso.c)
+std::string FirmwareDtostrf(double value, unsigned decimals);
+
+// Un float con 2 decimales, como floatToString2Decimals() en mainAWG.ino
+inline std::string FirmwareFloat2(float value) { return FirmwareDtostrf(value, 2); }
+
+// Objeto JSON plano serializado como ArduinoJson 6: miembros en orden de inserción, sin
+// espacios, escapes mínimos. Las claves son literales del firmware y no se escapan
+class FirmwareJson {
+ public:
+  FirmwareJson& String(const char* key, const std::string& value);
+  FirmwareJson& Int(const char* key, int64_t value);
+  FirmwareJson& Bool(const char* key, bool value);
+  FirmwareJson& Float(const char* key, float value);  // Valor numérico, no string
+
+  // serializeJson(doc, buffer, buffer_size): como mucho buffer_size - 1 bytes
+  std::string Serialize(size_t buffer_size) const;
+  size_t full_length() const { return text_.size() + 1; }  // Con la llave de cierre
+
+ private:
+  std::string text_ = "{";
+  void Key(const char* key);
+};
+
+// Texto de un double como lo escribe ArduinoJson 6 (TextFormatter::writeFloat)
+std::string ArduinoJsonFloat(double value);
+
+}  // namespace dropster
+
+#endif  // DROPSTER_SIMULATOR_FIRMWARE_FORMAT_H_
@@ -0,0 +1,440 @@
+#include "fleet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string_view>
+
+#include "mqtt_topics.h"
+
+namespace dropster {
+
+namespace {
+
+const int64_t kInFlightTimeoutUs = 30000000;  // Sin entrega en 30 s se cuenta como perdido
+const int64_t kSetupMs = 1500;                // millis() al terminar setup()
+
+enum TimerSlot { kTimerRead, kTimerData, kTimerHeartbeat, kTimerPing, kTimerReconnect, kTimerCount };
+
+}  // namespace
+
+struct Fleet::Device {
+  int index;
+  std::string id;
+  std::string topics[kTopicCount];
+  std::string presence_topic;  // Vacío con tópicos planos
+  std::string shared_control_topic;  // dropster/control con MQTT_SHARED_CONTROL; si no, vacío
+  std::unique_ptr<DeviceModel> model;
+  std::unique_ptr<MqttClient> client;
+  EventLoop::TimerId timers[kTimerCount] = {};
+  int64_t boot_ms = 0;
+  int64_t connect_started_us = 0;
+  bool session_up = false;
+  bool connecting = false;
+  // Estado de reconexión del loop() del firmware
+  int64_t last_attempt_ms = 0;
+  int64_t backoff_ms = SIM_MQTT_RECONNECT_DELAY_MS;
+  int64_t session_start_ms = 0;
+  uint32_t reconnect_count = 0;   // mqttReconnectCount: histórico, no se reinicia al conectar
+  uint32_t reconnect_streak = 0;  // mqttReconnectStreak: intentos desde la última sesión estable
+  int64_t wifi_back_ms = 0;       // Corte simulado de WiFi hasta este instante
+  std::vector<Outgoing> outgoing;
+};
+
+std::string SimDeviceId(int index) {
+  // 0x9E3779 es impar: multiplicar módulo 2^24 es una biyección y no repite MAC en la flota
+  uint32_t nic = ((uint32_t)index * 0x9E3779u) & 0xFFFFFFu;
+  uint8_t mac[6] = {0x24, 0x0A, 0xC4, (uint8_t)(nic >> 16), (uint8_t)(nic >> 8), (uint8_t)nic};
+  char id[MQTT_DEVICE_ID_MAX + 1];
+  mqttDeviceIdFromMac(mac, id);
+  return id;
+}
+
+bool ParseRamp(const std::string& text, std::vector<RampStage>* stages) {
+  stages->clear();
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t comma = text.find(',', start);
+    std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+    size_t at = item.find('@');
+    if (at == std::string::npos) return false;
+    RampStage stage{atoi(item.c_str()), atof(item.c_str() + at + 1)};
+    if (stage.devices <= 0 || stage.at_s < 0) return false;
+    if (!stages->empty() && (stage.at_s < stages->back().at_s || stage.devices < stages->back().devices)) return false;
+    stages->push_back(stage);
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+  return !stages->empty();
+}
+
+Fleet::Fleet(EventLoop& loop, FleetOptions options) : loop_(loop), options_(std::move(options)), rng_(options_.seed) {}
+
+Fleet::~Fleet() {
+  for (auto& device : devices_) {
+    for (EventLoop::TimerId id : device->timers) {
+      if (id) loop_.Cancel(id);
+    }
+  }
+  if (ramp_timer_) loop_.Cancel(ramp_timer_);
+  if (probe_timer_) loop_.Cancel(probe_timer_);
+  if (expire_timer_) loop_.Cancel(expire_timer_);
+}
+
+int64_t Fleet::SimWallMs() const {
+  return sim_origin_wall_ms_ + (int64_t)((double)(EventLoop::NowMs() - started_ms_) * options_.speed);
+}
+
+int Fleet::RampTarget(double elapsed_s) const {
+  if (options_.ramp.empty()) {
+    return std::min(options_.devices, 1 + (int)std::floor(options_.ramp_rate * elapsed_s));
+  }
+  double previous_s = 0.0;
+  int previous_devices = 0;
+  for (const RampStage& stage : options_.ramp) {
+    if (elapsed_s < stage.at_s) {
+      double span = stage.at_s - previous_s;
+      double fraction = span > 0 ? (elapsed_s - previous_s) / span : 1.0;
+      return previous_devices + (int)std::floor((stage.devices - previous_devices) * fraction);
+    }
+    previous_s = stage.at_s;
+    previous_devices = stage.devices;
+  }
+  return std::min(options_.devices, previous_devices);
+}
+
+uint64_t Fleet::MessageKey(const std::string& topic, const char* payload, size_t length) {
+  uint64_t topic_hash = std::hash<std::string_view>()(std::string_view(topic));
+  uint64_t payload_hash = std::hash<std::string_view>()(std::string_view(payload, length));
+  return topic_hash * 0x9E3779B97F4A7C15ULL ^ payload_hash;
+}
+
+void Fleet::Start() {
+  started_ms_ = EventLoop::NowMs();
+  sim_origin_wall_ms_ = EventLoop::WallMs();
+
+  if (options_.monitor) {
+    MqttOptions monitor_options = options_.mqtt;
+    monitor_options.client_id = "dropster_sim_monitor_" + std::to_string(getpid());
+    monitor_options.max_output_bytes = 1 << 16;
+    monitor_ = std::make_unique<MqttClient>(loop_, monitor_options);
+    monitor_->on_connect = [this]() { monitor_->Subscribe(options_.topic_root + "/#", 0); };
+    monitor_->on_message = [this](const std::string& topic, const char* payload, size_t length) {
+      stats_.monitored++;
+      size_t slash = topic.rfind('/');
+      if (slash == std::string::npos || topic.compare(slash + 1, std::string::npos, "data") != 0) return;
+      auto it = in_flight_.find(MessageKey(topic, payload, length));
+      if (it == in_flight_.end()) return;
+      stats_.delivery_us.Record(EventLoop::NowUs() - it->second);
+      stats_.delivered++;
+      in_flight_.erase(it);
+    };
+    monitor_->Connect();
+    expire_timer_ = loop_.Every(5000, [this]() { ExpireInFlight(); });
+  }
+  if (options_.probe_interval_ms > 0) {
+    MqttOptions probe_options = options_.mqtt;
+    probe_options.client_id = "dropster_sim_probe_" + std::to_string(getpid());
+    probe_ = std::make_unique<MqttClient>(loop_, probe_options);
+    probe_->Connect();
+    probe_timer_ = loop_.Every(options_.probe_interval_ms, [this]() { SendProbe(); });
+  }
+
+  ramp_timer_ = loop_.Every(10, [this]() {
+    int target = RampTarget((double)(EventLoop::NowMs() - started_ms_) / 1000.0);
+    while ((int)devices_.size() < target) StartDevice((int)devices_.size());
+    if (ramp_done()) {
+      loop_.Cancel(ramp_timer_);
+      ramp_timer_ = 0;
+    }
+  });
+}
+
+void Fleet::Stop() {
+  if (ramp_timer_) loop_.Cancel(ramp_timer_);
+  if (probe_timer_) loop_.Cancel(probe_timer_);
+  if (expire_timer_) loop_.Cancel(expire_timer_);
+  ramp_timer_ = probe_timer_ = expire_timer_ = 0;
+  for (auto& device : devices_) {
+    for (EventLoop::TimerId& id : device->timers) {
+      if (id) loop_.Cancel(id);
+      id = 0;
+    }
+    if (device->client) {
+      device->client->on_disconnect = nullptr;
+      device->client->Disconnect();
+    }
+    device->session_up = false;
+  }
+  if (monitor_) monitor_->Disconnect();
+  if (probe_) probe_->Disconnect();
+}
+
+int Fleet::connected() const {
+  int count = 0;
+  for (const auto& device : devices_) count += device->session_up ? 1 : 0;
+  return count;
+}
+
+void Fleet::StartDevice(int index) {
+  auto owned = std::make_unique<Device>();
+  Device& device = *owned;
+  devices_.push_back(std::move(owned));
+  device.index = index;
+  device.id = SimDeviceId(index);
+  MqttTopics topics;
+  topics.build(options_.topic_root.c_str(), device.id.c_str(), options_.legacy_topics || options_.old_firmware);
+  device.topics[kTopicData] = topics.data;
+  device.topics[kTopicStatus] = topics.status;
+  device.topics[kTopicAlerts] = topics.alerts;
+  device.topics[kTopicSystem] = topics.system;
+  device.topics[kTopicControl] = topics.control;
+  device.topics[kTopicAck] = topics.ack;
+  device.presence_topic = topics.presence;
+  if (options_.shared_control) device.shared_control_topic = topics.sharedControl;
+
+  DeviceProfile profile = MakeFleetProfile(index, options_.seed);
+  profile.broker = options_.mqtt.host;
+  profile.broker_port = options_.mqtt.port;
+  profile.data_topic = device.topics[kTopicData];
+  profile.status_topic = device.topics[kTopicStatus];
+  profile.device_id = device.id;
+  device.model = std::make_unique<DeviceModel>(profile);
+  device.boot_ms = EventLoop::NowMs() - kSetupMs;
+
+  // Cada equipo arrancó en otro momento: fases al azar para no publicar todos a la vez
+  auto schedule = [this, &device](int slot, int64_t interval_ms, std::function<void()> tick) {
+    int64_t phase = std::uniform_int_distribution<int64_t>(0, interval_ms - 1)(rng_);
+    device.timers[slot] = loop_.After(phase, [this, &device, slot, interval_ms, tick]() {
+      device.timers[slot] = loop_.Every(interval_ms, tick);
+      tick();
+    });
+  };
+  schedule(kTimerRead, SIM_SENSOR_READ_INTERVAL_MS, [this, &device]() { ReadCycle(device); });
+  schedule(kTimerData, SIM_MQTT_TRANSMIT_INTERVAL_MS, [this, &device]() {
+    if (!device.session_up) return;
+    int64_t uptime = EventLoop::NowMs() - device.boot_ms;
+    Send(device, kTopicData, device.model->DataPayload(uptime, EventLoop::WallMs()), true);
+  });
+  schedule(kTimerHeartbeat, SIM_HEARTBEAT_INTERVAL_MS, [this, &device]() {
+    if (!device.session_up) return;
+    int64_t uptime = EventLoop::NowMs() - device.boot_ms;
+    Send(device, kTopicStatus, device.model->ConsolidatedStatus(uptime, EventLoop::WallMs()), true);
+  });
+  schedule(kTimerPing, SIM_MQTT_PING_INTERVAL_MS, [this, &device]() {
+    if (device.session_up) Send(device, kTopicSystem, "PING", false);
+  });
+
+  Connect(device);
+}
+
+void Fleet::Connect(Device& device) {
+  device.timers[kTimerReconnect] = 0;
+  device.connecting = true;
+  stats_.connect_attempts++;
+  MqttOptions mqtt = options_.mqtt;
+  bool legacy = device.presence_topic.empty();
+  if (options_.old_firmware) {
+    // String(MQTT_CLIENT_ID) + "_" + String(random(1000, 9999)): choca con otro equipo de la
+    // flota en cuanto hay más de unas decenas y el broker expulsa a la sesión anterior
+    mqtt.client_id = "Dropster_AWG_" + std::to_string(std::uniform_int_distribution<int>(1000, 9998)(rng_));
+  } else {
+    mqtt.client_id = "Dropster_AWG_" + device.id;
+  }
+  mqtt.keepalive_s = SIM_MQTT_KEEPALIVE_S;
+  mqtt.will_topic = legacy ? device.topics[kTopicSystem] : device.presence_topic;
+  mqtt.will_payload = legacy ? MQTT_LEGACY_WILL_MESSAGE : MQTT_PRESENCE_OFFLINE;
+  mqtt.will_qos = 1;
+  mqtt.will_retain = true;
+  mqtt.reconnect_min_ms = 0;  // El backoff es el del firmware, no el del cliente
+  mqtt.max_output_bytes = 64 << 10;
+
+  device.client = std::make_unique<MqttClient>(loop_, mqtt);
+  MqttClient& client = *device.client;
+  client.on_connect = [this, &device, legacy]() {
+    device.session_up = true;
+    device.connecting = false;
+    device.session_start_ms = EventLoop::NowMs();
+    if (options_.old_firmware) device.backoff_ms = SIM_MQTT_RECONNECT_DELAY_MS;  // Reset mientras está conectado
+    stats_.connects++;
+    stats_.connect_us.Record(EventLoop::NowUs() - device.connect_started_us);
+    device.client->Subscribe(device.topics[kTopicControl], 0);
+    if (!device.shared_control_topic.empty()) device.client->Subscribe(device.shared_control_topic, 0);
+    if (legacy) {
+      Send(device, kTopicSystem, "AWG_ONLINE", true);
+    } else if (device.client->Publish(device.presence_topic, MQTT_PRESENCE_ONLINE, 0, true)) {
+      stats_.published_bytes += strlen(MQTT_PRESENCE_ONLINE);
+    }
+  };
+  client.on_disconnect = [this, &device](const std::string&) { OnDisconnected(device); };
+  client.on_message = [this, &device](const std::string& topic, const char* payload, size_t length) {
+    if (topic != device.topics[kTopicControl] && (device.shared_control_topic.empty() || topic != device.shared_control_topic)) {
+      return;
+    }
+    device.model->CommandArrived();
+    stats_.commands_received++;
+    auto probe = probes_in_flight_.find(topic);
+    if (probe != probes_in_flight_.end() && std::string_view(payload, length) == SIM_PROBE_COMMAND) {
+      if (probe->second.target == device.index) {
+        stats_.command_us.Record(EventLoop::NowUs() - probe->second.sent_us);
+      } else {
+        stats_.commands_fanout++;
+      }
+    }
+    int64_t uptime = EventLoop::NowMs() - device.boot_ms;
+    device.outgoing.clear();
+    device.model->ProcessCommand(payload, length, uptime, EventLoop::WallMs(), &device.outgoing);
+    for (const Outgoing& message : device.outgoing) Send(device, message);
+  };
+  device.connect_started_us = EventLoop::NowUs();
+  client.Connect();
+}
+
+void Fleet::OnDisconnected(Device& device) {
+  int64_t now = EventLoop::NowMs();
+  if (device.session_up) {
+    stats_.disconnects++;
+    // Sin corte simulado en curso, el socket lo cerró el broker
+    if (now >= device.wifi_back_ms) stats_.kicked++;
+  } else {
+    stats_.connect_failures++;
+  }
+  device.session_up = false;
+  device.connecting = false;
+  // Racha: solo una sesión que duró MQTT_STABLE_SESSION_MS la devuelve a cero
+  if (!options_.old_firmware && device.session_start_ms > 0 &&
+      now - device.session_start_ms >= SIM_MQTT_STABLE_SESSION_MS) {
+    device.reconnect_streak = 0;
+    device.backoff_ms = SIM_MQTT_RECONNECT_DELAY_MS;
+  }
+  device.session_start_ms = 0;
+  ScheduleReconnect(device);
+}
+
+void Fleet::ScheduleReconnect(Device& device) {
+  if (device.timers[kTimerReconnect]) return;
+  // loop(): un intento cuando pasó el backoff desde el anterior; tras un corte de WiFi, el
+  // primer intento espera a que vuelva la red
+  int64_t now = EventLoop::NowMs();
+  int64_t at = std::max(device.last_attempt_ms + device.backoff_ms, device.wifi_back_ms);
+  device.timers[kTimerReconnect] = loop_.After(std::max<int64_t>(0, at - now), [this, &device]() {
+    device.timers[kTimerReconnect] = 0;
+    if (device.session_up || device.connecting) return;
+    device.last_attempt_ms = EventLoop::NowMs();
+    device.backoff_ms = BackoffFor(device);
+    Connect(device);
+  });
+}
+
+int64_t Fleet::BackoffFor(Device& device) {
+  device.reconnect_count++;
+  if (options_.old_firmware) {
+    // Tramos por el contador histórico y jitter solo a partir del cuarto
+    if (device.reconnect_count <= 3) return SIM_MQTT_RECONNECT_DELAY_MS;
+    if (device.reconnect_count <= 7) return SIM_MQTT_RECONNECT_DELAY_MS * 2;
+    if (device.reconnect_count <= 12) return SIM_MQTT_RECONNECT_DELAY_MS * 4;
+    int64_t base = SIM_MQTT_RECONNECT_DELAY_MS * 8;
+    int64_t jitter = std::uniform_int_distribution<int64_t>(0, base / 4 - 1)(rng_);
+    return std::min<int64_t>(base + jitter, SIM_MQTT_MAX_BACKOFF_MS);
+  }
+  // mqttBackoffFor()
+  uint32_t streak = ++device.reconnect_streak;
+  int64_t base;
+  if (streak <= 3) {
+    base = SIM_MQTT_RECONNECT_DELAY_MS;
+  } else if (streak <= 7) {
+    base = SIM_MQTT_RECONNECT_DELAY_MS * 2;
+  } else if (streak <= 12) {
+    base = SIM_MQTT_RECONNECT_DELAY_MS * 4;
+  } else {
+    int doublings = (int)std::min<uint32_t>(streak - 13, 8);
+    base = std::min<int64_t>((int64_t)SIM_MQTT_RECONNECT_DELAY_MS * 8 << doublings, SIM_MQTT_MAX_BACKOFF_MS);
+  }
+  int64_t jitter = std::uniform_int_distribution<int64_t>(0, base * SIM_MQTT_BACKOFF_JITTER_PCT / 100)(rng_);
+  return std::min<int64_t>(base + jitter, SIM_MQTT_MAX_BACKOFF_MS);
+}
+
+void Fleet::ReadCycle(Device& device) {
+  int64_t now = EventLoop::NowMs();
+  int64_t dt_ms = (int64_t)(SIM_SENSOR_READ_INTERVAL_MS * options_.speed);
+  device.outgoing.clear();
+  device.model->ReadCycle(dt_ms, SimWallMs(), now - device.boot_ms, EventLoop::WallMs(), &device.outgoing);
+  for (const Outgoing& message : device.outgoing) Send(device, message);
+
+  // Firmware anterior: publishState() pasaba por ensureMqttConnected(), que llamaba a
+  // connectMQTT() en cada ciclo sin mirar el backoff
+  if (options_.old_firmware && !device.session_up && !device.connecting && now >= device.wifi_back_ms) {
+    if (device.timers[kTimerReconnect]) loop_.Cancel(device.timers[kTimerReconnect]);
+    device.timers[kTimerReconnect] = 0;
+    Connect(device);
+    return;
+  }
+
+  // Corte de WiFi: el socket muere sin DISCONNECT y el broker publica el last will
+  if (options_.drops_per_hour > 0 && device.session_up) {
+    double p = 1.0 - std::exp(-options_.drops_per_hour * SIM_SENSOR_READ_INTERVAL_MS / 3600000.0);
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < p) {
+      stats_.drops++;
+      device.wifi_back_ms = now + std::uniform_int_distribution<int64_t>(5000, 60000)(rng_);
+      device.client->Drop();
+    }
+  }
+}
+
+void Fleet::Send(Device& device, const Outgoing& message) {
+  Send(device, message.topic, message.payload, message.retain);
+}
+
+void Fleet::Send(Device& device, SimTopic topic, const std::string& payload, bool retain) {
+  if (!device.session_up) return;  // El firmware verifica mqttClient.connected() antes de publicar
+  const std::string& name = device.topics[topic];
+  if (!device.client->Publish(name, payload.data(), payload.size(), 0, retain)) {
+    stats_.publish_failures++;
+    return;
+  }
+  stats_.published[topic]++;
+  stats_.published_bytes += payload.size();
+  if (topic == kTopicData && monitor_ && monitor_->connected()) {
+    in_flight_.emplace(MessageKey(name, payload.data(), payload.size()), EventLoop::NowUs());
+  }
+}
+
+void Fleet::SendProbe() {
+  if (!probe_ || !probe_->connected() || devices_.empty()) return;
+  // Un dispositivo conectado al azar; con tópicos planos el comando llega a toda la flota
+  for (int attempt = 0; attempt < 8; attempt++) {
+    Device& device = *devices_[rng_() % devices_.size()];
+    if (!device.session_up) continue;
+    // Con el control compartido, una sonda de cada dos va por dropster/control como la mandaría
+    // una app anterior a su equipo
+    bool flat = !device.shared_control_topic.empty() && stats_.probes_sent % 2 == 1;
+    const std::string& topic = flat ? device.shared_control_topic : device.topics[kTopicControl];
+    if (probe_->Publish(topic, SIM_PROBE_COMMAND, 0, false)) {
+      probes_in_flight_[topic] = Probe{EventLoop::NowUs(), device.index};
+      stats_.probes_sent++;
+    }
+    return;
+  }
+}
+
+void Fleet::ExpireInFlight() {
+  int64_t limit = EventLoop::NowUs() - kInFlightTimeoutUs;
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (it->second < limit) {
+      stats_.lost++;
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = probes_in_flight_.begin(); it != probes_in_flight_.end();) {
+    it = it->second.sent_us < limit ? probes_in_flight_.erase(it) : std::next(it);
+  }
+}
+
+}  // namespace dropster
@@ -0,0 +1,158 @@
+#ifndef DROPSTER_SIMULATOR_FLEET_H_
+#define DROPSTER_SIMULATOR_FLEET_H_
+
+// Flota simulada: una sesión MQTT por dispositivo sobre un único EventLoop.
+//
+// Cada sesión se comporta como el loop() del AWG: lectura + control + publishState() cada
+// SENSOR_READ_INTERVAL (2 s), transmitMQTTData() cada 5 s, publishConsolidatedStatus() cada
+// 30 s y "PING" en system cada 45 s. Cada equipo tiene el id que el firmware deriva de la MAC
+// (awg-<12 hex>) y su client id estable Dropster_AWG_<id>; con tópicos por equipo conecta con
+// last will "offline" retenido en dropster/<id>/presence y publica "online" al conectar, en
+// modo legacy usa dropster/<hoja> y AWG_OFFLINE/AWG_ONLINE en dropster/system. Al perder la
+// conexión reintenta con mqttBackoffFor(): 3/6/12/24 s... con jitter del 25 % y una racha
+// que solo vuelve a cero tras MQTT_STABLE_SESSION_MS conectado. Todo lo que el firmware
+// publica con PubSubClient sale con QoS 0.
+//
+// --old-firmware reproduce el comportamiento anterior para comparar: tópicos planos, client
+// id Dropster_AWG_<random(1000, 9999)> nuevo en cada intento, reconexión síncrona desde cada
+// publicación (ensureMqttConnected) y backoff por el contador histórico, sin jitter.
+//
+// Métricas: un monitor suscrito a dropster/# mide la latencia de entrega de cada mensaje de
+// datos (publicación -> recepción, emparejados por contenido) y una sonda envía comandos
+// y mide cuánto tardan en llegar al dispositivo.
+
+#include <stdint.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "device_model.h"
+#include "event_loop.h"
+#include "latency_histogram.h"
+#include "mqtt_client.h"
+
+namespace dropster {
+
+#define SIM_SENSOR_READ_INTERVAL_MS 2000  // SENSOR_READ_INTERVAL
+#define SIM_MQTT_TRANSMIT_INTERVAL_MS 5000
+#define SIM_HEARTBEAT_INTERVAL_MS 30000
+#define SIM_MQTT_PING_INTERVAL_MS 45000
+#define SIM_MQTT_RECONNECT_DELAY_MS 3000
+#define SIM_MQTT_MAX_BACKOFF_MS 300000
+#define SIM_MQTT_STABLE_SESSION_MS 60000  // MQTT_STABLE_SESSION_MS
+#define SIM_MQTT_BACKOFF_JITTER_PCT 25
+#define SIM_MQTT_KEEPALIVE_S 90
+#define SIM_PROBE_COMMAND "oncf"  // Inocuo: el ventilador del compresor ya va encendido en automático
+
+// Un tramo de la rampa: `devices` sesiones arrancadas a los `at_s` segundos
+struct RampStage {
+  int devices;
+  double at_s;
+};
+
+struct FleetOptions {
+  MqttOptions mqtt;  // host, puerto y credenciales comunes
+  int devices = 100;
+  std::vector<RampStage> ramp;  // Vacío = todas en ramp_rate por segundo
+  double ramp_rate = 50.0;
+  std::string topic_root = "dropster";
+  bool legacy_topics = false;  // SET_MQTT_LEGACY ON: dropster/<hoja>, sin presence
+  bool old_firmware = false;   // Identidad y reconexión anteriores (implica tópicos planos)
+  bool shared_control = false;  // MQTT_SHARED_CONTROL true: también escucha dropster/control
+  double speed = 1.0;          // Aceleración de la física (los intervalos MQTT son reales)
+  double drops_per_hour = 0.0;       // Cortes de WiFi por dispositivo y hora
+  uint32_t seed = 1;
+  bool monitor = true;
+  int probe_interval_ms = 5000;  // 0 = sin sonda de comandos
+};
+
+struct FleetStats {
+  uint64_t published[kTopicCount] = {};
+  uint64_t published_bytes = 0;
+  uint64_t publish_failures = 0;  // Sin sesión o buffer de salida lleno
+  uint64_t connect_attempts = 0;
+  uint64_t connects = 0;
+  uint64_t connect_failures = 0;
+  uint64_t disconnects = 0;
+  uint64_t drops = 0;   // Cortes simulados
+  uint64_t kicked = 0;  // Sesiones cerradas por el broker (client id repetido, keepalive)
+  uint64_t commands_fanout = 0;  // Comandos de la sonda recibidos por un equipo que no era el destino
+  uint64_t commands_received = 0;
+  uint64_t probes_sent = 0;
+  uint64_t monitored = 0;  // Recibido por el monitor
+  uint64_t delivered = 0;  // Mensajes de datos emparejados con su publicación
+  uint64_t lost = 0;       // Publicados y no vistos por el monitor en 30 s
+  LatencyHistogram connect_us;
+  LatencyHistogram delivery_us;
+  LatencyHistogram command_us;
+};
+
+class Fleet {
+ public:
+  Fleet(EventLoop& loop, FleetOptions options);
+  ~Fleet();
+  Fleet(const Fleet&) = delete;
+  Fleet& operator=(const Fleet&) = delete;
+
+  // Empieza la rampa; las sesiones arrancan a medida que avanza el tiempo
+  void Start();
+  // Cierre ordenado de todas las sesiones (sin last will)
+  void Stop();
+
+  int started() const { return (int)devices_.size(); }
+  int connected() const;
+  bool ramp_done() const { return (int)devices_.size() >= options_.devices; }
+  const FleetStats& stats() const { return stats_; }
+  FleetStats& mutable_stats() { return stats_; }
+  const FleetOptions& options() const { return options_; }
+
+ private:
+  struct Device;
+
+  EventLoop& loop_;
+  FleetOptions options_;
+  FleetStats stats_;
+  std::mt19937 rng_;
+  std::vector<std::unique_ptr<Device>> devices_;
+  std::unique_ptr<MqttClient> monitor_;
+  std::unique_ptr<MqttClient> probe_;
+  // Mensajes de datos en vuelo: hash(tópico + payload) -> instante de publicación (µs)
+  std::unordered_multimap<uint64_t, int64_t> in_flight_;
+  struct Probe {
+    int64_t sent_us;
+    int target;  // Índice del equipo al que iba el comando
+  };
+  std::unordered_map<std::string, Probe> probes_in_flight_;  // Tópico de control -> sonda
+  int64_t started_ms_ = 0;
+  int64_t sim_origin_wall_ms_ = 0;
+  EventLoop::TimerId ramp_timer_ = 0;
+  EventLoop::TimerId probe_timer_ = 0;
+  EventLoop::TimerId expire_timer_ = 0;
+
+  int RampTarget(double elapsed_s) const;
+  void StartDevice(int index);
+  void Connect(Device& device);
+  void OnDisconnected(Device& device);
+  void ReadCycle(Device& device);
+  void Send(Device& device, const Outgoing& message);
+  void Send(Device& device, SimTopic topic, const std::string& payload, bool retain);
+  void ScheduleReconnect(Device& device);
+  int64_t BackoffFor(Device& device);
+  int64_t SimWallMs() const;
+  void SendProbe();
+  void ExpireInFlight();
+  static uint64_t MessageKey(const std::string& topic, const char* payload, size_t length);
+};
+
+// Id que el firmware derivaría de la MAC del equipo `index` (OUI de Espressif, sin repetir)
+std::string SimDeviceId(int index);
+
+// "100@10,1000@60": 100 dispositivos a los 10 s, 1000 a los 60 s (interpolación lineal)
+bool ParseRamp(const std::string& text, std::vector<RampStage>* stages);
+
+}  // namespace dropster
+
+#endif  // DROPSTER_SIMULATOR_FLEET_H_
@@ -0,0 +1,615 @@
+// dropster-sim: simulador de flota AWG y generador de carga MQTT.
+//
+//   dropster-sim [opciones]         N dispositivos contra un broker, con rampa y métricas
+//   dropster-sim check [opciones]   verificación offline del modelo y del formato de los payloads
+//   dropster-sim trace [opciones]   latencia de comandos por etapa con acuses (command_trace.h)
+//   dropster-sim safety             escenarios de fallas del supervisor de seguridad (safety_supervisor.h)
+//
+// Ver tools/README.md.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "device_model.h"
+#include "event_loop.h"
+#include "firmware_format.h"
+#include "flat_json.h"
+#include "fleet.h"
+#include "latency_histogram.h"
+#include "mqtt_topics.h"
+#include "safety_check.h"
+#include "trace_probe.h"
+
+using namespace dropster;
+
+namespace {
+
+struct Options {
+  FleetOptions fleet;
+  double duration_s = 0.0;  // 0 = hasta Ctrl-C
+  double report_s = 5.0;
+  // check
+  double hours = 24.0;
+  // trace
+  std::string device_id;  // Vacío = un equipo simulado en este proceso
+  int trace_count = 100;
+  int trace_interval_ms = 1100;  // Más que COMMAND_DEBOUNCE: repetir el comando no se descarta
+  std::string trace_commands = SIM_PROBE_COMMAND;
+};
+
+enum Subcommand { kRunFleet, kRunCheck, kRunTrace };
+
+void Usage() {
+  fprintf(stderr,
+          "Uso: dropster-sim [check|trace|safety] [opciones]\n"
+          "  --broker HOST          broker MQTT (localhost)\n"
+          "  --port N               puerto MQTT (1883)\n"
+          "  --user U --password P  credenciales MQTT\n"
+          "  --devices N            dispositivos simulados (100)\n"
+          "  --ramp R               arranques por segundo (50) o tramos \"100@10,1000@60\"\n"
+          "  --duration S           segundos de simulación, 0 = hasta Ctrl-C (0)\n"
+          "  --report S             intervalo del reporte (5)\n"
+          "  --legacy-topics        tópicos planos dropster/<hoja> (SET_MQTT_LEGACY ON)\n"
+          "  --old-firmware         identidad y reconexión del firmware anterior, para comparar\n"
+          "  --shared-control       también dropster/control por equipo (MQTT_SHARED_CONTROL true)\n"
+          "  --speed K              acelera K veces la física y el control (1)\n"
+          "  --drops R              cortes de WiFi por dispositivo y hora (0)\n"
+          "  --probe MS             intervalo de la sonda de comandos, 0 = sin sonda (5000)\n"
+          "  --no-monitor           no medir la entrega de los mensajes de datos\n"
+          "  --seed N               semilla de la flota (1)\n"
+          "check:\n"
+          "  --devices N            dispositivos (50)\n"
+          "  --hours H              horas simuladas (24)\n"
+          "trace:\n"
+          "  --device ID            equipo a medir; sin él, uno simulado en este proceso\n"
+          "  --count N              comandos a enviar (100)\n"
+          "  --interval MS          intervalo entre comandos (1100)\n"
+          "  --command C1,C2        comandos enviados en ciclo (" SIM_PROBE_COMMAND ")\n");
+}
+
+bool ParseOptions(int argc, char** argv, Subcommand subcommand, Options* options) {
+  static const struct option long_options[] = {
+      {"broker", required_argument, nullptr, 'b'},    {"port", required_argument, nullptr, 'p'},
+      {"user", required_argument, nullptr, 'u'},      {"password", required_argument, nullptr, 'P'},
+      {"devices", required_argument, nullptr, 'n'},   {"ramp", required_argument, nullptr, 'r'},
+      {"duration", required_argument, nullptr, 'd'},  {"report", required_argument, nullptr, 'R'},
+      {"legacy-topics", no_argument, nullptr, 'T'},  {"old-firmware", no_argument, nullptr, 'F'},
+      {"speed", required_argument, nullptr, 's'},     {"drops", required_argument, nullptr, 'D'},
+      {"probe", required_argument, nullptr, 'x'},     {"no-monitor", no_argument, nullptr, 'M'},
+      {"seed", required_argument, nullptr, 'S'},      {"hours", required_argument, nullptr, 'H'},
+      {"device", required_argument, nullptr, 'i'},    {"count", required_argument, nullptr, 'c'},
+      {"interval", required_argument, nullptr, 'I'},  {"command", required_argument, nullptr, 'C'},
+      {"shared-control", no_argument, nullptr, 'G'},  {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  FleetOptions& fleet = options->fleet;
+  if (subcommand == kRunCheck) fleet.devices = 50;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+    switch (opt) {
+      case 'b': fleet.mqtt.host = optarg; break;
+      case 'p': fleet.mqtt.port = atoi(optarg); break;
+      case 'u': fleet.mqtt.username = optarg; break;
+      case 'P': fleet.mqtt.password = optarg; break;
+      case 'n': fleet.devices = std::max(1, atoi(optarg)); break;
+      case 'r':
+        if (strchr(optarg, '@')) {
+          if (!ParseRamp(optarg, &fleet.ramp)) return false;
+          fleet.devices = fleet.ramp.back().devices;
+        } else {
+          fleet.ramp_rate = std::max(0.1, atof(optarg));
+        }
+        break;
+      case 'd': options->duration_s = std::max(0.0, atof(optarg)); break;
+      case 'R': options->report_s = std::max(0.5, atof(optarg)); break;
+      case 'T': fleet.legacy_topics = true; break;
+      case 'F': fleet.old_firmware = true; break;
+      case 'G': fleet.shared_control = true; break;
+      case 's': fleet.speed = std::max(0.1, atof(optarg)); break;
+      case 'D': fleet.drops_per_hour = std::max(0.0, atof(optarg)); break;
+      case 'x': fleet.probe_interval_ms = std::max(0, atoi(optarg)); break;
+      case 'M': fleet.monitor = false; break;
+      case 'S': fleet.seed = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 'H': options->hours = std::max(0.1, atof(optarg)); break;
+      case 'i': options->device_id = optarg; break;
+      case 'c': options->trace_count = std::max(1, atoi(optarg)); break;
+      case 'I': options->trace_interval_ms = std::max(10, atoi(optarg)); break;
+      case 'C': options->trace_commands = optarg; break;
+      default: return false;
+    }
+  }
+  return true;
+}
+
+// Una sesión por socket: miles de dispositivos necesitan más descriptores que el límite usual
+void RaiseFileLimit(int devices) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+  rlim_t wanted = (rlim_t)devices + 64;
+  if (limit.rlim_cur >= wanted) return;
+  limit.rlim_cur = std::min(wanted, limit.rlim_max);
+  setrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < wanted) {
+    fprintf(stderr, "Aviso: límite de descriptores %llu, menor que %d sesiones (ulimit -n)\n",
+            (unsigned long long)limit.rlim_cur, devices);
+  }
+}
+
+std::string Ms(int64_t us) {
+  char text[32];
+  snprintf(text, sizeof(text), us < 10000 ? "%.2f" : "%.0f", (double)us / 1000.0);
+  return text;
+}
+
+void PrintHistogram(const char* label, const LatencyHistogram& h) {
+  if (h.count() == 0) {
+    printf("  %-24s sin muestras\n", label);
+    return;
+  }
+  printf("  %-24s n=%-8llu media %s ms  p50 %s  p90 %s  p99 %s  p99.9 %s  máx %s\n", label,
+         (unsigned long long)h.count(), Ms((int64_t)h.mean()).c_str(), Ms(h.Percentile(50)).c_str(),
+         Ms(h.Percentile(90)).c_str(), Ms(h.Percentile(99)).c_str(), Ms(h.Percentile(99.9)).c_str(),
+         Ms(h.max()).c_str());
+}
+
+uint64_t TotalPublished(const FleetStats& stats) {
+  uint64_t total = 0;
+  for (int t = 0; t < kTopicCount; t++) total += stats.published[t];
+  return total;
+}
+
+int RunFleet(Options& options) {
+  RaiseFileLimit(options.fleet.devices);
+  EventLoop loop;
+  loop.StopOnSignals();
+  Fleet fleet(loop, options.fleet);
+
+  const FleetOptions& fo = fleet.options();
+  const char* mode = fo.old_firmware     ? "firmware anterior"
+                     : fo.legacy_topics  ? "tópicos planos"
+                     : fo.shared_control ? "tópicos por equipo y control compartido"
+                                         : "tópicos por equipo";
+  printf("Simulando %d dispositivos contra %s:%d (%s, rampa %s, física ×%.1f)\n", fo.devices, fo.mqtt.host.c_str(),
+         fo.mqtt.port, mode,
+         fo.ramp.empty() ? (std::to_string((int)fo.ramp_rate) + "/s").c_str() : "por tramos", fo.speed);
+
+  // Los histogramas de la flota son la ventana del reporte; aquí se acumula el total
+  LatencyHistogram total_connect, total_delivery, total_command;
+  uint64_t last_published = 0, last_bytes = 0, last_monitored = 0;
+  int64_t last_report_ms = EventLoop::NowMs();
+  int64_t start_ms = last_report_ms;
+  auto report = [&]() {
+    FleetStats& stats = fleet.mutable_stats();
+    int64_t now = EventLoop::NowMs();
+    double window_s = std::max(0.001, (double)(now - last_report_ms) / 1000.0);
+    uint64_t published = TotalPublished(stats);
+    if (now - last_report_ms >= 500) {  // El cierre justo después de un reporte no repite la línea
+      printf("%7.1f s  sesiones %d/%d  pub %.0f/s (%.0f KB/s)  monitor %.0f/s  entrega p50 %s p99 %s ms  "
+             "conexión p99 %s ms  comando p99 %s ms  reconexiones %llu  fallos %llu\n",
+             (double)(now - start_ms) / 1000.0, fleet.connected(), fleet.started(),
+             (double)(published - last_published) / window_s,
+             (double)(stats.published_bytes - last_bytes) / 1024.0 / window_s,
+             (double)(stats.monitored - last_monitored) / window_s, Ms(stats.delivery_us.Percentile(50)).c_str(),
+             Ms(stats.delivery_us.Percentile(99)).c_str(), Ms(stats.connect_us.Percentile(99)).c_str(),
+             Ms(stats.command_us.Percentile(99)).c_str(), (unsigned long long)stats.disconnects,
+             (unsigned long long)(stats.publish_failures + stats.connect_failures));
+    }
+    fflush(stdout);
+    total_connect.Merge(stats.connect_us);
+    total_delivery.Merge(stats.delivery_us);
+    total_command.Merge(stats.command_us);
+    stats.connect_us.Reset();
+    stats.delivery_us.Reset();
+    stats.command_us.Reset();
+    last_published = published;
+    last_bytes = stats.published_bytes;
+    last_monitored = stats.monitored;
+    last_report_ms = now;
+  };
+  loop.Every((int64_t)(options.report_s * 1000.0), report);
+  if (options.duration_s > 0) loop.After((int64_t)(options.duration_s * 1000.0), [&loop]() { loop.Stop(); });
+
+  fleet.Start();
+  loop.Run();
+  report();
+  double elapsed_s = (double)(EventLoop::NowMs() - start_ms) / 1000.0;
+  fleet.Stop();
+
+  const FleetStats& stats = fleet.stats();
+  uint64_t published = TotalPublished(stats);
+  printf("\nResumen (%.1f s)\n", elapsed_s);
+  printf("  sesiones: %d arrancadas, %llu intentos (%.1f/s), %llu conexiones, %llu intentos fallidos, "
+         "%llu desconexiones, %llu cortes, %llu cerradas por el broker\n",
+         fleet.started(), (unsigned long long)stats.connect_attempts, (double)stats.connect_attempts / elapsed_s,
+         (unsigned long long)stats.connects, (unsigned long long)stats.connect_failures,
+         (unsigned long long)stats.disconnects, (unsigned long long)stats.drops, (unsigned long long)stats.kicked);
+  printf("  publicado: %llu mensajes, %.1f MB (%.0f mensajes/s)  datos %llu  estado %llu  alertas %llu  sistema %llu\n",
+         (unsigned long long)published, (double)stats.published_bytes / 1048576.0, (double)published / elapsed_s,
+         (unsigned long long)stats.published[kTopicData], (unsigned long long)stats.published[kTopicStatus],
+         (unsigned long long)stats.published[kTopicAlerts], (unsigned long long)stats.published[kTopicSystem]);
+  printf("  fallos de publicación: %llu  comandos recibidos: %llu (%llu sondas, %llu entregas a otros equipos)\n",
+         (unsigned long long)stats.publish_failures, (unsigned long long)stats.commands_received,
+         (unsigned long long)stats.probes_sent, (unsigned long long)stats.commands_fanout);
+  if (fo.monitor) {
+    printf("  monitor: %llu mensajes, %llu datos emparejados, %llu sin entregar en 30 s\n",
+           (unsigned long long)stats.monitored, (unsigned long long)stats.delivered, (unsigned long long)stats.lost);
+  }
+  printf("\nLatencias\n");
+  PrintHistogram("conexión (CONNACK)", total_connect);
+  PrintHistogram("entrega de datos", total_delivery);
+  PrintHistogram("comando hasta el equipo", total_command);
+  return 0;
+}
+
+// ---------------------------------------------------------------------------------------
+// Traza de comandos
+
+int RunTrace(Options& options) {
+  EventLoop loop;
+  loop.StopOnSignals();
+  std::vector<std::string> commands;
+  size_t start = 0;
+  while (start <= options.trace_commands.size()) {
+    size_t comma = options.trace_commands.find(',', start);
+    if (comma == std::string::npos) comma = options.trace_commands.size();
+    if (comma > start) commands.push_back(options.trace_commands.substr(start, comma - start));
+    start = comma + 1;
+  }
+  if (commands.empty()) commands.push_back(SIM_PROBE_COMMAND);
+
+  // Sin --device: un equipo del simulador, con el mismo processCommand() y acuse que el AWG
+  std::unique_ptr<Fleet> fleet;
+  std::string device_id = options.device_id;
+  if (device_id.empty()) {
+    FleetOptions fleet_options = options.fleet;
+    fleet_options.devices = 1;
+    fleet_options.probe_interval_ms = 0;
+    fleet_options.monitor = false;
+    fleet = std::make_unique<Fleet>(loop, fleet_options);
+    device_id = SimDeviceId(0);
+  }
+  MqttTopics topics;
+  topics.build(options.fleet.topic_root.c_str(), device_id.c_str(), options.fleet.legacy_topics);
+  MqttOptions mqtt = options.fleet.mqtt;
+  mqtt.client_id = "dropster-trace-" + std::to_string(getpid());
+  TraceProbe probe(loop, mqtt, TraceTopics{topics.control, topics.ack}, commands, options.trace_count,
+                   options.trace_interval_ms);
+  probe.on_finish = [&loop]() { loop.Stop(); };
+
+  printf("Trazando %d comandos a %s (%s) cada %d ms vía %s:%d\n", options.trace_count, device_id.c_str(),
+         fleet ? "simulado" : "equipo real", options.trace_interval_ms, mqtt.host.c_str(), mqtt.port);
+  fflush(stdout);
+  if (fleet) {
+    fleet->Start();
+    // El equipo tiene que estar suscrito a control antes del primer comando
+    EventLoop::TimerId wait = 0;
+    wait = loop.Every(100, [&]() {
+      if (fleet->connected() == 0) return;
+      loop.Cancel(wait);
+      probe.Start();
+    });
+  } else {
+    probe.Start();
+  }
+  loop.Run();
+  if (fleet) fleet->Stop();
+
+  const TraceStats& stats = probe.stats();
+  printf("\nAcuses: %llu enviados, %llu respondidos, %llu perdidos (sin acuse en %d s), %llu ajenos\n",
+         (unsigned long long)stats.sent, (unsigned long long)stats.acked, (unsigned long long)stats.lost,
+         TRACE_ACK_TIMEOUT_MS / 1000, (unsigned long long)stats.stray);
+  if (!stats.rejected.empty()) {
+    printf("  rechazados:");
+    for (const auto& entry : stats.rejected) printf(" %s=%llu", entry.first.c_str(), (unsigned long long)entry.second);
+    printf("\n");
+  }
+  printf("\nLatencias (cliente)\n");
+  PrintHistogram("ida y vuelta", stats.rtt_us);
+  PrintHistogram("red y broker (rtt-done)", stats.network_us);
+  printf("Latencias en el equipo, desde la llegada\n");
+  PrintHistogram("poll (espera de loop)", stats.poll_us);
+  PrintHistogram("gate (hasta despacho)", stats.gate_us);
+  PrintHistogram("act (primer actuador)", stats.act_us);
+  PrintHistogram("done (fin del comando)", stats.done_us);
+  if (!stats.device_stats.empty()) {
+    printf("\nCMD_STATS del equipo: %s\n", stats.device_stats.c_str());
+  } else {
+    printf("\nCMD_STATS: sin respuesta del equipo\n");
+  }
+  return stats.acked > 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------------------
+// Verificación offline
+
+struct CheckTally {
+  size_t messages = 0;
+  size_t max_bytes = 0;
+  size_t total_bytes = 0;
+  size_t invalid = 0;
+};
+
+int Failures(const char* what, size_t count) {
+  if (count) printf("  FALLO: %s (%zu)\n", what, count);
+  return count ? 1 : 0;
+}
+
+// StageHistogram (4 sub-buckets por octava): percentiles dentro del 25 % del valor exacto
+size_t HistogramErrors() {
+  StageHistogram h;
+  h.reset();
+  for (uint32_t us = 1; us <= 100000; us++) h.add(us);
+  size_t errors = 0;
+  for (float p : {50.0f, 90.0f, 99.0f}) {
+    double exact = p * 1000.0;
+    uint32_t got = h.percentile(p);
+    if (got < exact || got > exact * 1.25) errors++;
+  }
+  if (h.percentile(100) != 100000 || h.max != 100000 || h.count != 100000) errors++;
+  h.reset();
+  h.add(0xFFFFFFFFu);  // Fuera de rango: último bucket, acotado por el máximo
+  if (h.percentile(50) != 0xFFFFFFFFu) errors++;
+  return errors;
+}
+
+int RunCheck(Options& options) {
+  int failures = 0;
+
+  // Formatos del firmware contra valores conocidos de dtostrf (ESP32) y ArduinoJson 6
+  struct FormatCase {
+    std::string got;
+    const char* expected;
+  };
+  const FormatCase cases[] = {
+      {FirmwareFloat2(24.315f), "24.32"},  {FirmwareFloat2(1.999f), "2.00"},
+      {FirmwareFloat2(-0.001f), "-0.00"},  {FirmwareFloat2(0.0f), "0.00"},
+      {FirmwareFloat2(NAN), "nan"},        {FirmwareDtostrf(86400.125, 2), "86400.12"},  // Trunca tras sumar 0.005
+      {ArduinoJsonFloat(20.0f), "20"},     {ArduinoJsonFloat(1.4f), "1.399999976"},
+      {ArduinoJsonFloat(0.5), "0.5"},      {ArduinoJsonFloat(NAN), "null"},
+      {ArduinoJsonFloat(12345678.0), "1.2345678e7"},
+  };
+  size_t format_errors = 0;
+  for (const FormatCase& c : cases) {
+    if (c.got != c.expected) {
+      printf("  formato: \"%s\" (se esperaba \"%s\")\n", c.got.c_str(), c.expected);
+      format_errors++;
+    }
+  }
+  failures += Failures("formatos numéricos", format_errors);
+
+  // Orden de claves de transmitMQTTData()
+  static const char* const kDataKeys[] = {"t",  "h",  "p", "w",  "wr", "wu", "te",          "he",        "tc",
+                                          "dp", "ha", "v", "c",  "po", "e",  "mqtt_broker", "mqtt_port", "mqtt_topic",
+                                          "mqtt_connected", "tank_capacity", "ts"};
+  const int key_count = (int)(sizeof(kDataKeys) / sizeof(kDataKeys[0]));
+
+  int devices = options.fleet.devices;
+  int64_t steps = (int64_t)(options.hours * 3600.0 * 1000.0 / SIM_SENSOR_READ_INTERVAL_MS);
+  const int64_t wall_origin = 1767225600000LL;  // 2026-01-01 00:00 UTC: resultado reproducible
+  std::map<std::string, CheckTally> tallies;
+  std::map<std::string, size_t> alerts_by_type;
+  size_t order_errors = 0, value_errors = 0, energy_errors = 0, water_errors = 0, command_errors = 0, ack_errors = 0;
+  double water_produced = 0.0;
+  uint64_t compressor_starts = 0;
+  int auto_devices = 0, idle_auto_devices = 0;
+  std::vector<Outgoing> out;
+
+  auto tally = [&](const std::string& kind, const std::string& payload, size_t buffer_size) {
+    CheckTally& t = tallies[kind];
+    t.messages++;
+    t.total_bytes += payload.size();
+    t.max_bytes = std::max(t.max_bytes, payload.size());
+    bool json = !payload.empty() && payload[0] == '{';  // MODE_*, COMP_ON... van como texto plano
+    bool ok = payload.size() < buffer_size - 1 &&
+              (!json || ForEachJsonMember(payload.data(), payload.size(), [](const char*, size_t, const JsonValue&) {}));
+    if (!ok) t.invalid++;
+  };
+  auto tally_outgoing = [&](const std::vector<Outgoing>& messages) {
+    for (const Outgoing& m : messages) {
+      if (m.topic == kTopicAlerts) {
+        tally("alerta", m.payload, 200);
+        ForEachJsonMember(m.payload.data(), m.payload.size(), [&](const char* key, size_t len, const JsonValue& v) {
+          if (len == 4 && memcmp(key, "type", 4) == 0) alerts_by_type[v.Text()]++;
+        });
+      } else if (m.topic == kTopicStatus && m.payload[0] == '{') {
+        tally("estado", m.payload, 200);
+      } else {
+        tally("otros", m.payload, 1024);
+      }
+    }
+  };
+
+  // Identidad: ids válidos y sin repetir, tópicos completos (snprintf no truncó), comodines
+  // de flota que los cubren y el control plano compartido de la migración
+  std::set<std::string> ids;
+  size_t identity_errors = 0;
+  for (int d = 0; d < devices; d++) {
+    std::string id = SimDeviceId(d);
+    if (!mqttDeviceIdValid(id.c_str()) || !ids.insert(id).second) identity_errors++;
+    MqttTopics topics;
+    topics.build(options.fleet.topic_root.c_str(), id.c_str(), false);
+    std::string expected = options.fleet.topic_root + "/" + id + "/" MQTT_LEAF_PRESENCE;
+    if (expected != topics.presence || strcmp(topics.willTopic(), topics.presence) != 0) identity_errors++;
+    if (!MqttClient::TopicMatches(options.fleet.topic_root + "/+/data", topics.data)) identity_errors++;
+    if (options.fleet.topic_root + "/" MQTT_LEAF_CONTROL != topics.sharedControl) identity_errors++;
+  }
+
+  // Entrega de comandos con las suscripciones de connectMQTT(): un comando al control de un
+  // equipo y uno al control plano de las apps anteriores, contando quién los recibe
+  std::vector<std::vector<std::string>> subscriptions(devices);
+  for (int d = 0; d < devices; d++) {
+    MqttTopics topics;
+    topics.build(options.fleet.topic_root.c_str(), SimDeviceId(d).c_str(), false);
+    subscriptions[d].push_back(topics.control);
+    if (options.fleet.shared_control) subscriptions[d].push_back(topics.sharedControl);
+  }
+  auto receivers = [&](const std::string& topic) {
+    size_t count = 0;
+    for (const std::vector<std::string>& filters : subscriptions) {
+      for (const std::string& filter : filters) {
+        if (MqttClient::TopicMatches(filter, topic)) {
+          count++;
+          break;
+        }
+      }
+    }
+    return count;
+  };
+  size_t misdelivered = 0, flat_receivers = receivers(options.fleet.topic_root + "/" MQTT_LEAF_CONTROL);
+  for (const std::vector<std::string>& filters : subscriptions) misdelivered += receivers(filters[0]) - 1;
+  printf("  entrega de comandos: %zu a otro equipo, el control plano llega a %zu de %d (%s)\n", misdelivered,
+         flat_receivers, devices, options.fleet.shared_control ? "control compartido" : "sin control compartido");
+  if (flat_receivers > 1) misdelivered += flat_receivers - 1;  // La app anterior quería un solo equipo
+
+  for (int d = 0; d < devices; d++) {
+    DeviceProfile profile = MakeFleetProfile(d, options.fleet.seed);
+    profile.device_id = SimDeviceId(d);
+    DeviceModel model(profile);
+    bool automatic = model.mode() != kModeManual;
+    auto_devices += automatic ? 1 : 0;
+    double last_energy = -1.0;
+    for (int64_t step = 1; step <= steps; step++) {
+      int64_t uptime = step * SIM_SENSOR_READ_INTERVAL_MS;
+      int64_t wall = wall_origin + uptime;
+      out.clear();
+      model.ReadCycle(SIM_SENSOR_READ_INTERVAL_MS, wall, uptime, wall, &out);
+      tally_outgoing(out);
+      if (uptime % SIM_MQTT_TRANSMIT_INTERVAL_MS < SIM_SENSOR_READ_INTERVAL_MS) {
+        std::string data = model.DataPayload(uptime, wall);
+        tally("datos", data, 1024);
+        int next_key = 0;
+        bool order_ok = true, values_ok = true;
+        double energy = NAN;
+        ForEachJsonMember(data.data(), data.size(), [&](const char* key, size_t len, const JsonValue& value) {
+          std::string name(key, len);
+          while (next_key < key_count && name != kDataKeys[next_key]) next_key++;
+          if (next_key == key_count) order_ok = false;
+          if (name.size() <= 2 || name == "tank_capacity") {
+            double number = value.AsNumber();
+            bool nan_text = value.length == 3 && memcmp(value.begin, "nan", 3) == 0;
+            if (std::isnan(number) && !nan_text) values_ok = false;
+            if (name == "e") energy = number;
+            if (name == "w" && (number < 0 || number > model.profile().tank_capacity + 0.01)) water_errors++;
+          }
+        });
+        order_errors += order_ok ? 0 : 1;
+        value_errors += values_ok ? 0 : 1;
+        if (!std::isnan(energy)) {
+          if (energy + 0.005 < last_energy) energy_errors++;
+          last_energy = energy;
+        }
+      }
+      if (uptime % SIM_HEARTBEAT_INTERVAL_MS < SIM_SENSOR_READ_INTERVAL_MS) {
+        tally("estado consolidado", model.ConsolidatedStatus(uptime, wall), 512);
+      }
+    }
+    compressor_starts += model.compressor_starts();
+    if (automatic && model.compressor_starts() == 0) idle_auto_devices++;
+    water_produced += model.water_volume();
+
+    // Comandos de la app: respuesta, debounce y bloqueo de comandos críticos
+    int64_t uptime = steps * SIM_SENSOR_READ_INTERVAL_MS + 10000;
+    auto command = [&](const char* text, int64_t at_ms) {
+      out.clear();
+      model.ProcessCommand(text, strlen(text), at_ms, wall_origin + at_ms, &out);
+      tally_outgoing(out);
+      return out;
+    };
+    std::vector<Outgoing> r = command("MODE MANUAL", uptime);
+    if (r.empty() || r[0].payload != "MODE_MANUAL" || r.back().payload.find("\"mode\":\"MANUAL\"") == std::string::npos) {
+      command_errors++;
+    }
+    r = command("offb", uptime + 6000);
+    if (r.size() != 1 || r[0].payload.find("\"pump\":0,\"mode\":\"MANUAL\"}") == std::string::npos) {
+      command_errors++;
+    }
+    if (!command("offb", uptime + 6500).empty()) command_errors++;  // Debounce de 1 s
+    r = command("mode auto_time", uptime + 8000);
+    if (r.size() != 4 || r[0].payload != "MODE_AUTO_TIME" || r[3].payload.find("\"compressor\":1") == std::string::npos) {
+      command_errors++;
+    }
+    r = command("update_config {\"alerts\":{}}", uptime + 14000);
+    if (r.size() != 1 || r[0].payload != "{\"type\":\"config_ack\",\"status\":\"success\"}") command_errors++;
+
+    // Acuses: cid y marca devueltos, rechazo con motivo y CMD_STATS solo con lo llegado por MQTT
+    auto traced = [&](const char* text, int64_t at_ms) {
+      model.CommandArrived();
+      return command(text, at_ms);
+    };
+    auto ack_has = [](const std::vector<Outgoing>& messages, const char* text) {
+      return !messages.empty() && messages.back().topic == kTopicAck &&
+             messages.back().payload.find(text) != std::string::npos;
+    };
+    r = traced("@App-1:1767225600123 OFFV", uptime + 20000);
+    if (r.size() != 2 || !ack_has(r, "{\"cid\":\"App-1\",\"ts\":1767225600123,\"result\":\"ok\",\"poll_us\":0,") ||
+        !ack_has(r, "\"act_us\":") || r[0].payload.find("\"ventilador\":0") == std::string::npos) {
+      ack_errors++;
+    }
+    r = traced("@a2 offv", uptime + 20500);
+    if (r.size() != 1 || !ack_has(r, "\"result\":\"rejected\",\"reason\":\"debounce\"") || ack_has(r, "gate_us")) {
+      ack_errors++;
+    }
+    if (!command("@bad! offcf", uptime + 22000).empty()) ack_errors++;  // Prefijo inválido: comando desconocido
+    if (!command("offcf", uptime + 23000).empty() && out.back().topic == kTopicAck) ack_errors++;  // Sin cid, sin acuse
+    r = command("cmd_stats", uptime + 24000);
+    if (r.size() != 1 || r[0].topic != kTopicAck ||
+        r[0].payload.find("{\"type\":\"cmd_stats\",\"n\":2,\"results\":{\"ok\":1,\"debounce\":1,") != 0) {
+      ack_errors++;
+    }
+  }
+
+  printf("Verificación: %d dispositivos × %.1f h simuladas\n", devices, options.hours);
+  printf("  %-20s %10s %10s %10s %8s\n", "payload", "mensajes", "media B", "máx B", "inválidos");
+  for (const auto& entry : tallies) {
+    const CheckTally& t = entry.second;
+    printf("  %-20s %10zu %10.1f %10zu %8zu\n", entry.first.c_str(), t.messages,
+           (double)t.total_bytes / (double)std::max<size_t>(1, t.messages), t.max_bytes, t.invalid);
+    failures += Failures(("payload truncado o mal formado: " + entry.first).c_str(), t.invalid);
+  }
+  printf("  alertas:");
+  for (const auto& entry : alerts_by_type) printf(" %s=%zu", entry.first.c_str(), entry.second);
+  printf("\n  arranques de compresor: %llu (%d de %d equipos automáticos sin arrancar)\n",
+         (unsigned long long)compressor_starts, idle_auto_devices, auto_devices);
+  failures += Failures("identidad MQTT (id o tópicos)", identity_errors);
+  failures += Failures("comandos entregados a otro equipo", misdelivered);
+  failures += Failures("orden de claves de dropster/data", order_errors);
+  failures += Failures("valores no numéricos en dropster/data", value_errors);
+  failures += Failures("energía decreciente", energy_errors);
+  failures += Failures("volumen fuera del tanque", water_errors);
+  failures += Failures("respuestas a comandos", command_errors);
+  failures += Failures("acuses de comandos (command_trace.h)", ack_errors);
+  failures += Failures("percentiles del histograma de etapas", HistogramErrors());
+  failures += Failures("sin ciclos de compresor en modo automático", compressor_starts == 0 ? 1 : 0);
+  printf("  resultado: %s\n", failures ? "FALLO" : "OK");
+  (void)water_produced;
+  return failures ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "safety") == 0) return RunSafetyCheck() ? 1 : 0;
+  Subcommand subcommand = kRunFleet;
+  if (argc > 1 && strcmp(argv[1], "check") == 0) subcommand = kRunCheck;
+  if (argc > 1 && strcmp(argv[1], "trace") == 0) subcommand = kRunTrace;
+  Options options;
+  bool shifted = subcommand != kRunFleet;
+  if (!ParseOptions(shifted ? argc - 1 : argc, shifted ? argv + 1 : argv, subcommand, &options)) {
+    Usage();
+    return 2;
+  }
+  if (subcommand == kRunCheck) return RunCheck(options);
+  return subcommand == kRunTrace ? RunTrace(options) : RunFleet(options);
+}
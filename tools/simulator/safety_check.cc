@@ -0,0 +1,401 @@
+#include "safety_check.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "safety_supervisor.h"
+
+namespace dropster {
+
+namespace {
+
+// Valores de config.h
+const uint32_t kPeriodMs = 200;            // SAFETY_PERIOD_MS
+const uint32_t kStaleMs = 30000;           // SAFETY_STALE_MS
+const uint32_t kLoopStallMs = 60000;       // SAFETY_LOOP_STALL_MS
+const uint32_t kMaxOnGraceMs = 60000;      // SAFETY_MAX_ON_GRACE_MS
+const uint32_t kControlMaxOnMs = 7200000;  // CONTROL_MAX_ON_DEFAULT
+const uint32_t kControlMinOffMs = 120000;  // CONTROL_MIN_OFF_DEFAULT
+const uint32_t kReadIntervalMs = 2000;     // SENSOR_READ_INTERVAL
+const uint32_t kLoopIterationMs = 50;      // POWER_MAX_IDLE_MS: una iteración del loop en reposo
+const uint32_t kStepMs = 10;
+const uint32_t kTickPhaseMs = 130;         // Tarea y loop no están en fase
+
+SafetyLimits DefaultLimits() {
+  SafetyLimits limits;
+  limits.compressorTempMax = 95.0f;  // MAX_COMPRESSOR_TEMP
+  limits.tempHysteresis = 5.0f;      // SAFETY_TEMP_HYSTERESIS_C
+  limits.tankFullPct = 90.0f;        // ALERT_TANK_FULL_DEFAULT
+  limits.tankHysteresisPct = 2.0f;   // SAFETY_TANK_HYSTERESIS_PCT
+  limits.maxOnMs = kControlMaxOnMs + kMaxOnGraceMs;  // Modo automático
+  limits.restartDelayMs = kControlMinOffMs;
+  limits.pumpMinLiters = 2.0f;       // PUMP_MIN_LEVEL_DEFAULT
+  limits.pumpHysteresisLiters = 0.5f;  // SAFETY_PUMP_HYSTERESIS_L
+  limits.staleMs = kStaleMs;
+  limits.loopStallMs = kLoopStallMs;
+  return limits;
+}
+
+// Loop, tarea del supervisor y relés sobre un reloj simulado. El loop late en cada
+// iteración y publica la muestra cada ciclo de lectura, como safetyPublishSample()
+class Bench {
+ public:
+  Bench() : limits(DefaultLimits()) {
+    sample.atMs = 0;
+    sample.compressorTemp = 60.0f;
+    sample.tankPercent = 40.0f;
+    sample.waterLiters = 8.0f;
+  }
+
+  SafetySupervisor supervisor;
+  SafetyLimits limits;
+  SafetySample sample;         // Lo que los sensores medirían ahora
+  bool loop_alive = true;      // false: loop trabado (broker, portal)
+  bool sensors_alive = true;   // false: el loop late pero la lectura no vuelve (Modbus)
+  bool compressor = false;     // Relés: el supervisor los abre
+  bool pump = false;
+  uint32_t now_ms = 10000;
+  uint32_t published = 0;
+  uint32_t last_published_ms = 0;
+  uint32_t fed_ticks = 0;
+  uint32_t held_ticks = 0;
+  uint32_t last_feed_ms = 0;
+  std::vector<SafetyEvent> events;
+
+  void Run(uint32_t ms) {
+    uint32_t end = now_ms + ms;
+    while (now_ms < end) {
+      now_ms += kStepMs;
+      if (loop_alive && now_ms % kLoopIterationMs == 0) LoopIteration();
+      if (now_ms % kPeriodMs == kTickPhaseMs) Tick();
+    }
+  }
+
+  // Hasta que el loop publique la muestra actual
+  void RunUntilPublished() {
+    uint32_t before = published;
+    while (published == before) Run(kStepMs);
+  }
+
+  // Encendidos del loop, que consultan al supervisor
+  bool StartCompressor() {
+    if (!supervisor.compressorAllowed()) return false;
+    compressor = true;
+    return true;
+  }
+  bool StartPump() {
+    if (!supervisor.pumpAllowed()) return false;
+    pump = true;
+    return true;
+  }
+
+  size_t EventsOf(uint8_t trip) const {
+    size_t n = 0;
+    for (const SafetyEvent& e : events) n += e.trip == trip ? 1 : 0;
+    return n;
+  }
+
+  uint32_t MaxReactionMs() const {
+    uint32_t max = 0;
+    for (const SafetyEvent& e : events) max = e.reactionMs > max ? e.reactionMs : max;
+    return max;
+  }
+
+ private:
+  uint32_t beat_ms_ = 0;
+  uint32_t last_read_ms_ = 0;
+
+  void LoopIteration() {
+    beat_ms_ = now_ms;
+    if (!sensors_alive || now_ms - last_read_ms_ < kReadIntervalMs) return;
+    last_read_ms_ = now_ms;
+    sample.atMs = now_ms;
+    supervisor.configure(limits);
+    supervisor.publish(sample);
+    published++;
+    last_published_ms = now_ms;
+  }
+
+  void Tick() {
+    SafetyInputs in = { now_ms, beat_ms_, compressor, pump };
+    SafetyActions actions = supervisor.tick(in);
+    if (actions.compressorOff) compressor = false;
+    if (actions.pumpOff) pump = false;
+    if (actions.feedWatchdog) {
+      fed_ticks++;
+      last_feed_ms = now_ms;
+    } else {
+      held_ticks++;
+    }
+    SafetyEvent event;
+    while (supervisor.popEvent(&event)) events.push_back(event);
+  }
+};
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> failures;
+
+  void Expect(bool ok, const std::string& what) {
+    if (!ok) failures.push_back(what);
+  }
+};
+
+// Bench arrancado, con el primer ciclo de lectura ya publicado
+Bench Started() {
+  Bench bench;
+  bench.RunUntilPublished();
+  bench.Run(kPeriodMs);
+  return bench;
+}
+
+void NormalOperation(Scenario& s) {
+  Bench b = Started();
+  s.Expect(b.StartCompressor() && b.StartPump(), "arranque permitido");
+  b.Run(600000);
+  s.Expect(b.events.empty(), "sin intervenciones");
+  s.Expect(b.compressor && b.pump, "actuadores encendidos");
+  s.Expect(b.held_ticks == 0, "watchdog alimentado en cada período");
+  s.Expect(b.supervisor.maxTickGapMs() == kPeriodMs, "período fijo");
+}
+
+// El loop publica la temperatura alta y se traba antes de llegar a checkAlerts()
+void OverTempLoopStalled(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.Run(5000);
+  b.sample.compressorTemp = 97.0f;
+  b.RunUntilPublished();
+  b.loop_alive = false;
+  b.Run(1000);
+  s.Expect(!b.compressor, "compresor apagado con el loop trabado");
+  s.Expect(b.EventsOf(SAFETY_TRIP_OVER_TEMP) == 1, "una intervención over_temp");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción <= un período");
+  b.loop_alive = true;
+  b.sample.compressorTemp = 92.0f;  // Dentro de la histéresis
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(!b.StartCompressor(), "rearranque bloqueado dentro de la histéresis");
+  b.sample.compressorTemp = 89.0f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(b.StartCompressor(), "rearranque permitido bajo la histéresis");
+}
+
+// Loop trabado del todo: stale apaga ambos y el watchdog deja de alimentarse
+void LoopStalled(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.StartPump();
+  b.Run(3000);
+  b.loop_alive = false;
+  uint32_t stall_ms = b.now_ms;
+  uint32_t last_sample_ms = b.last_published_ms;
+  b.Run(kStaleMs + 2000);
+  s.Expect(!b.compressor && !b.pump, "compresor y bomba apagados por stale");
+  s.Expect(b.EventsOf(SAFETY_TRIP_STALE) == 2, "dos intervenciones stale");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción <= un período desde el vencimiento");
+  s.Expect(b.events.size() == 2 && b.events[0].atMs >= last_sample_ms + kStaleMs &&
+               b.events[0].atMs <= last_sample_ms + kStaleMs + kPeriodMs,
+           "corte al vencer la muestra");
+  s.Expect(b.held_ticks == 0, "watchdog aún alimentado antes de SAFETY_LOOP_STALL_MS");
+  b.Run(kLoopStallMs);
+  s.Expect(b.held_ticks > 0, "watchdog retenido con el loop trabado");
+  s.Expect(b.last_feed_ms - stall_ms < kLoopStallMs && b.last_feed_ms - stall_ms + kPeriodMs >= kLoopStallMs,
+           "última alimentación al cumplirse SAFETY_LOOP_STALL_MS");
+  uint32_t held = b.held_ticks;
+  b.loop_alive = true;
+  b.Run(kPeriodMs * 5);
+  s.Expect(b.held_ticks == held, "watchdog alimentado al volver el loop");
+}
+
+// El loop late pero la lectura de sensores no vuelve: stale, con el watchdog alimentado
+void SensorsStalled(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.sensors_alive = false;
+  b.Run(kStaleMs + 3000);
+  s.Expect(!b.compressor, "compresor apagado sin muestras");
+  s.Expect(b.EventsOf(SAFETY_TRIP_STALE) == 1, "una intervención stale");
+  s.Expect(b.held_ticks == 0, "watchdog alimentado: el loop avanza");
+  s.Expect(!b.StartCompressor(), "arranque bloqueado sin muestras");
+  b.sensors_alive = true;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(b.StartCompressor(), "arranque permitido con muestras nuevas");
+}
+
+// El tanque se llena con el compresor andando (el control solo lo mira al arrancar)
+void TankFullRunning(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  for (float pct = 85.0f; pct < 91.0f; pct += 0.5f) {
+    b.sample.tankPercent = pct;
+    b.RunUntilPublished();
+  }
+  b.Run(kPeriodMs);
+  s.Expect(!b.compressor, "compresor apagado con el tanque lleno");
+  s.Expect(b.EventsOf(SAFETY_TRIP_TANK_FULL) == 1, "una intervención tank_full");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción <= un período");
+  b.sample.tankPercent = 89.0f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(!b.StartCompressor(), "bloqueado dentro de la histéresis");
+  b.sample.tankPercent = 87.5f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(b.StartCompressor(), "permitido bajo la histéresis");
+}
+
+// El control no corta por control_max_on: corta el supervisor con el margen
+void MaxOnExceeded(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  uint32_t on_ms = b.now_ms;
+  b.Run(kControlMaxOnMs + kMaxOnGraceMs - 1000);
+  s.Expect(b.compressor, "encendido antes del límite");
+  b.Run(2000);
+  s.Expect(!b.compressor, "apagado al vencer el límite");
+  s.Expect(b.EventsOf(SAFETY_TRIP_MAX_ON) == 1, "una intervención max_on");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción <= un período");
+  s.Expect(!b.events.empty() && b.events[0].atMs - on_ms <= kControlMaxOnMs + kMaxOnGraceMs + kPeriodMs,
+           "corte dentro de un período del límite");
+  b.Run(kControlMinOffMs - 10000);
+  s.Expect(!b.StartCompressor(), "rearranque bloqueado durante control_min_off");
+  b.Run(10000 + kPeriodMs);
+  s.Expect(b.StartCompressor(), "rearranque permitido tras control_min_off");
+
+  Bench manual = Started();
+  manual.limits.maxOnMs = 0;  // Modo manual
+  manual.StartCompressor();
+  manual.Run(3 * 3600000);
+  s.Expect(manual.compressor && manual.events.empty(), "sin límite en modo manual");
+}
+
+// La bomba vacía el tanque: se corta la bomba, no el compresor
+void PumpDryRun(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.StartPump();
+  for (float liters = 4.0f; liters > 1.5f; liters -= 0.25f) {
+    b.sample.waterLiters = liters;
+    b.RunUntilPublished();
+  }
+  b.Run(kPeriodMs);
+  s.Expect(!b.pump, "bomba apagada en seco");
+  s.Expect(b.compressor, "compresor sin cambios");
+  s.Expect(b.EventsOf(SAFETY_TRIP_PUMP_DRY) == 1 && b.events.size() == 1, "solo una intervención pump_dry");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción <= un período");
+  b.sample.waterLiters = 2.3f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(!b.StartPump(), "bloqueada dentro de la histéresis");
+  b.sample.waterLiters = 2.6f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(b.StartPump(), "permitida sobre la histéresis");
+}
+
+// Termistor suelto y tanque sin calibrar: ni disparo ni liberación
+void InvalidSensors(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.sample.compressorTemp = NAN;
+  b.sample.tankPercent = NAN;
+  b.Run(120000);
+  s.Expect(b.compressor && b.events.empty(), "NaN no dispara");
+  b.sample.compressorTemp = 96.0f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(!b.compressor, "corte por temperatura");
+  b.sample.compressorTemp = NAN;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  s.Expect(!b.StartCompressor(), "NaN no libera el enclavamiento");
+}
+
+// Temperatura oscilando en el umbral y el control reintentando: un solo corte
+void ThresholdFlapping(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  for (int i = 0; i < 200; i++) {
+    b.sample.compressorTemp = i % 2 ? 95.1f : 94.8f;
+    b.RunUntilPublished();
+    b.StartCompressor();
+  }
+  b.Run(kPeriodMs);
+  s.Expect(b.EventsOf(SAFETY_TRIP_OVER_TEMP) == 1 && b.events.size() == 1, "una sola intervención");
+  s.Expect(!b.compressor, "compresor apagado");
+}
+
+// Una escritura directa del pin con el enclavamiento activo se deshace en un período
+void DirectRelayWrite(Scenario& s) {
+  Bench b = Started();
+  b.StartCompressor();
+  b.sample.tankPercent = 95.0f;
+  b.RunUntilPublished();
+  b.Run(kPeriodMs);
+  b.Run(10000);
+  b.compressor = true;  // Sin pasar por startCompressorRelay()
+  b.Run(kPeriodMs);
+  s.Expect(!b.compressor, "reapagado en un período");
+  s.Expect(b.EventsOf(SAFETY_TRIP_TANK_FULL) == 2, "dos intervenciones tank_full");
+  s.Expect(b.MaxReactionMs() <= kPeriodMs, "reacción contada desde el encendido");
+}
+
+// Intervenciones sin drenar: se pisan las más viejas y se cuentan
+void EventOverflow(Scenario& s) {
+  SafetySupervisor supervisor;
+  SafetyLimits limits = DefaultLimits();
+  supervisor.configure(limits);
+  SafetySample sample = { 1000, 99.0f, 40.0f, 8.0f };
+  supervisor.publish(sample);
+  for (uint32_t i = 0; i < SAFETY_EVENT_SLOTS + 3; i++) {
+    SafetyInputs in = { 1000 + i * kPeriodMs, 1000 + i * kPeriodMs, true, false };
+    supervisor.tick(in);
+  }
+  size_t drained = 0;
+  SafetyEvent event;
+  while (supervisor.popEvent(&event)) drained++;
+  s.Expect(drained == SAFETY_EVENT_SLOTS, "anillo lleno");
+  s.Expect(supervisor.droppedEvents() == 3, "descartadas contadas");
+  s.Expect(supervisor.stats(SAFETY_TRIP_OVER_TEMP).count == SAFETY_EVENT_SLOTS + 3, "estadística completa");
+}
+
+}  // namespace
+
+int RunSafetyCheck() {
+  static const struct {
+    const char* name;
+    void (*run)(Scenario&);
+  } scenarios[] = {
+      {"operación normal", NormalOperation},
+      {"sobretemperatura con el loop trabado", OverTempLoopStalled},
+      {"loop trabado", LoopStalled},
+      {"sensores sin respuesta", SensorsStalled},
+      {"tanque lleno en marcha", TankFullRunning},
+      {"tiempo máximo encendido", MaxOnExceeded},
+      {"bomba en seco", PumpDryRun},
+      {"sensores inválidos (NaN)", InvalidSensors},
+      {"umbral oscilante", ThresholdFlapping},
+      {"escritura directa del relé", DirectRelayWrite},
+      {"desborde de intervenciones", EventOverflow},
+  };
+  int failed = 0;
+  printf("dropster-sim safety: supervisor de seguridad (período %u ms)\n", (unsigned)kPeriodMs);
+  for (const auto& entry : scenarios) {
+    Scenario scenario = { entry.name, {} };
+    entry.run(scenario);
+    printf("  %-5s %s\n", scenario.failures.empty() ? "ok" : "FALLO", scenario.name);
+    for (const std::string& what : scenario.failures) printf("        - %s\n", what.c_str());
+    failed += scenario.failures.empty() ? 0 : 1;
+  }
+  printf("  resultado: %s\n", failed ? "FALLO" : "OK");
+  return failed;
+}
+
+}  // namespace dropster
@@ -0,0 +1,20 @@
+#ifndef DROPSTER_SIMULATOR_SAFETY_CHECK_H_
+#define DROPSTER_SIMULATOR_SAFETY_CHECK_H_
+
+// Escenarios de fallas contra el supervisor de seguridad del firmware (dropster-sim safety).
+//
+// Cada escenario corre SafetySupervisor (safety_supervisor.h, el mismo header del AWG) con un
+// reloj simulado: un loop que late y publica una muestra cada ciclo de lectura, la tarea del
+// supervisor cada SAFETY_PERIOD_MS y relés que obedecen sus apagados. Las fallas se inyectan
+// sobre ese banco: loop trabado, sensores que se disparan, el loop que reenciende un
+// actuador enclavado. Se verifica que el corte ocurra, que el tiempo de reacción quede
+// acotado y que el watchdog se alimente solo con el loop vivo.
+
+namespace dropster {
+
+// Imprime cada escenario y devuelve cuántos fallaron
+int RunSafetyCheck();
+
+}  // namespace dropster
+
+#endif  // DROPSTER_SIMULATOR_SAFETY_CHECK_H_
@@ -0,0 +1,139 @@
+#include "trace_probe.h"
+
+#include "flat_json.h"
+
+namespace dropster {
+
+TraceProbe::TraceProbe(EventLoop& loop, MqttOptions mqtt, TraceTopics topics, std::vector<std::string> commands,
+                       int count, int interval_ms)
+    : loop_(loop), topics_(std::move(topics)), commands_(std::move(commands)), count_(count), interval_ms_(interval_ms) {
+  client_.reset(new MqttClient(loop_, std::move(mqtt)));
+}
+
+TraceProbe::~TraceProbe() {
+  if (send_timer_) loop_.Cancel(send_timer_);
+  if (expire_timer_) loop_.Cancel(expire_timer_);
+}
+
+void TraceProbe::Start() {
+  client_->on_connect = [this]() {
+    client_->Subscribe(topics_.ack, 0);
+    if (started_) return;  // Reconexión: los pendientes se cuentan como perdidos al vencer
+    started_ = true;
+    send_timer_ = loop_.After(TRACE_SUBSCRIBE_SETTLE_MS, [this]() {
+      send_timer_ = loop_.Every(interval_ms_, [this]() { SendNext(); });
+      SendNext();
+    });
+  };
+  client_->on_message = [this](const std::string& topic, const char* payload, size_t length) {
+    if (topic == topics_.ack) OnAck(payload, length);
+  };
+  expire_timer_ = loop_.Every(250, [this]() { Expire(); });
+  client_->Connect();
+}
+
+void TraceProbe::SendNext() {
+  if (finished_ || draining_) return;
+  if ((int)stats_.sent >= count_) {
+    draining_ = true;
+    loop_.Cancel(send_timer_);
+    send_timer_ = 0;
+    return;
+  }
+  if (!client_->connected()) return;  // Ese intervalo se pierde; el conteo no avanza
+  const std::string& command = commands_[stats_.sent % commands_.size()];
+  std::string cid = "t" + std::to_string(stats_.sent);
+  int64_t now = EventLoop::NowUs();
+  std::string message = "@" + cid + ":" + std::to_string(now) + " " + command;
+  if (!client_->Publish(topics_.control, message, 1, false)) return;
+  pending_[cid] = now;
+  stats_.sent++;
+}
+
+void TraceProbe::OnAck(const char* payload, size_t length) {
+  int64_t now = EventLoop::NowUs();
+  std::string cid, type, result, reason;
+  double ts = -1, poll = -1, gate = -1, act = -1, done = -1;
+  ForEachJsonMember(payload, length, [&](const char* key, size_t key_len, const JsonValue& value) {
+    std::string name(key, key_len);
+    if (name == "cid") {
+      cid = value.Text();
+    } else if (name == "type") {
+      type = value.Text();
+    } else if (name == "ts") {
+      ts = value.AsNumber();
+    } else if (name == "result") {
+      result = value.Text();
+    } else if (name == "reason") {
+      reason = value.Text();
+    } else if (name == "poll_us") {
+      poll = value.AsNumber();
+    } else if (name == "gate_us") {
+      gate = value.AsNumber();
+    } else if (name == "act_us") {
+      act = value.AsNumber();
+    } else if (name == "done_us") {
+      done = value.AsNumber();
+    }
+  });
+  if (type == "cmd_stats") {
+    if (draining_ && stats_requested_ms_ && !finished_) {
+      stats_.device_stats.assign(payload, length);
+      Finish();
+    }
+    return;
+  }
+  auto it = pending_.find(cid);
+  if (cid.empty() || it == pending_.end()) {
+    stats_.stray++;
+    return;
+  }
+  pending_.erase(it);
+  stats_.acked++;
+  // La marca vuelve tal cual: la ida y vuelta no depende del registro local
+  int64_t rtt = ts >= 0 ? now - (int64_t)ts : -1;
+  if (rtt >= 0) stats_.rtt_us.Record(rtt);
+  if (rtt >= 0 && done >= 0) stats_.network_us.Record(rtt - (int64_t)done);
+  if (poll >= 0) stats_.poll_us.Record((int64_t)poll);
+  if (done >= 0) stats_.done_us.Record((int64_t)done);
+  if (result != "ok") {
+    stats_.rejected[reason.empty() ? result : reason]++;
+    return;
+  }
+  if (gate >= 0) stats_.gate_us.Record((int64_t)gate);
+  if (act >= 0) stats_.act_us.Record((int64_t)act);
+}
+
+void TraceProbe::Expire() {
+  if (finished_) return;
+  int64_t now = EventLoop::NowUs();
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    if (now - it->second > (int64_t)TRACE_ACK_TIMEOUT_MS * 1000) {
+      stats_.lost++;
+      it = pending_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (!draining_ || !pending_.empty()) return;
+  if (stats_requested_ms_ == 0) {
+    // Sin prefijo: CMD_STATS no es parte de la muestra
+    if (client_->connected() && client_->Publish(topics_.control, "CMD_STATS", 1, false)) {
+      stats_requested_ms_ = EventLoop::NowMs();
+    }
+  } else if (EventLoop::NowMs() - stats_requested_ms_ > TRACE_STATS_TIMEOUT_MS) {
+    Finish();
+  }
+}
+
+void TraceProbe::Finish() {
+  if (finished_) return;
+  finished_ = true;
+  if (send_timer_) loop_.Cancel(send_timer_);
+  if (expire_timer_) loop_.Cancel(expire_timer_);
+  send_timer_ = expire_timer_ = 0;
+  client_->Disconnect();
+  if (on_finish) on_finish();
+}
+
+}  // namespace dropster
@@ -0,0 +1,90 @@
+#ifndef DROPSTER_SIMULATOR_TRACE_PROBE_H_
+#define DROPSTER_SIMULATOR_TRACE_PROBE_H_
+
+// Traza de comandos de punta a punta (dropster-sim trace), con el acuse de command_trace.h.
+//
+//   1. cada `interval_ms` publica "@<cid>:<µs> <comando>" en <raíz>/<id>/control (QoS 1,
+//      como publishCommand() de la app); cid es t<n> y la marca, el reloj monótono local
+//   2. el equipo responde en <raíz>/<id>/ack con cid, la marca devuelta y sus tiempos:
+//      rtt = ahora - marca; red = rtt - done_us (broker y enlaces, ida y vuelta)
+//   3. un acuse que no llega en 10 s cuenta como perdido
+//   4. al terminar pide CMD_STATS: los histogramas del propio equipo, que incluyen los
+//      comandos de la app y no solo los de la traza
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.h"
+#include "latency_histogram.h"
+#include "mqtt_client.h"
+
+namespace dropster {
+
+#define TRACE_ACK_TIMEOUT_MS 10000
+#define TRACE_STATS_TIMEOUT_MS 5000
+#define TRACE_SUBSCRIBE_SETTLE_MS 500  // El SUBACK no se notifica: margen antes del primer comando
+
+struct TraceTopics {
+  std::string control;
+  std::string ack;
+};
+
+struct TraceStats {
+  uint64_t sent = 0;
+  uint64_t acked = 0;
+  uint64_t lost = 0;
+  uint64_t stray = 0;  // Acuses sin comando pendiente (tardíos o de otro cliente)
+  std::map<std::string, uint64_t> rejected;  // Por "reason"
+  LatencyHistogram rtt_us;
+  LatencyHistogram network_us;
+  LatencyHistogram poll_us;
+  LatencyHistogram gate_us;
+  LatencyHistogram act_us;
+  LatencyHistogram done_us;
+  std::string device_stats;  // JSON de CMD_STATS; vacío si no respondió
+};
+
+class TraceProbe {
+ public:
+  TraceProbe(EventLoop& loop, MqttOptions mqtt, TraceTopics topics, std::vector<std::string> commands, int count,
+             int interval_ms);
+  ~TraceProbe();
+  TraceProbe(const TraceProbe&) = delete;
+  TraceProbe& operator=(const TraceProbe&) = delete;
+
+  void Start();
+  const TraceStats& stats() const { return stats_; }
+
+  std::function<void()> on_finish;
+
+ private:
+  EventLoop& loop_;
+  TraceTopics topics_;
+  std::vector<std::string> commands_;
+  int count_;
+  int interval_ms_;
+  std::unique_ptr<MqttClient> client_;
+  std::unordered_map<std::string, int64_t> pending_;  // cid -> enviado (µs)
+  TraceStats stats_;
+  bool started_ = false;
+  bool draining_ = false;  // Todo enviado: esperando acuses y luego CMD_STATS
+  bool finished_ = false;
+  int64_t stats_requested_ms_ = 0;
+  EventLoop::TimerId send_timer_ = 0;
+  EventLoop::TimerId expire_timer_ = 0;
+
+  void SendNext();
+  void OnAck(const char* payload, size_t length);
+  void Expire();
+  void Finish();
+};
+
+}  // namespace dropster
+
+#endif  // DROPSTER_SIMULATOR_TRACE_PROBE_H_